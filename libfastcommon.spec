@@ -14,7 +14,11 @@ Source: http://github.com/happyfish100/libfastcommon/%{name}-%{version}.tar.gz
 BuildRoot: %{_tmppath}/%{name}-%{version}-%{release}-root-%(%{__id_u} -n)
 
 BuildRequires: libcurl-devel
+BuildRequires: zlib-devel
+BuildRequires: libzstd-devel
 Requires: libcurl
+Requires: zlib
+Requires: libzstd
 Requires: %__cp %__mv %__chmod %__grep %__mkdir %__install %__id
 
 %description
@@ -56,6 +60,7 @@ rm -rf %{buildroot}
 %files
 %defattr(-,root,root,-)
 /usr/lib64/libfastcommon.so*
+/usr/bin/binary_log_decoder
 
 %files devel
 %defattr(-,root,root,-)
@@ -105,6 +105,16 @@ if [ -f /usr/include/curl/curl.h ] || [ -f /usr/local/include/curl/curl.h ]; the
   LIBS="$LIBS -lcurl"
 fi
 
+if [ -f /usr/include/zlib.h ] || [ -f /usr/local/include/zlib.h ]; then
+  CFLAGS="$CFLAGS -DUSE_ZLIB"
+  LIBS="$LIBS -lz"
+fi
+
+if [ -f /usr/include/zstd.h ] || [ -f /usr/local/include/zstd.h ]; then
+  CFLAGS="$CFLAGS -DUSE_ZSTD"
+  LIBS="$LIBS -lzstd"
+fi
+
 uname=`uname`
 
 HAVE_VMMETER_H=0
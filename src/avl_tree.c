@@ -13,788 +13,645 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include "fc_memory.h"
+#include <errno.h>
 #include "avl_tree.h"
 
-int avl_tree_init(AVLTreeInfo *tree, FreeDataFunc free_data_func, \
-	CompareFunc compare_func)
+int avl_tree_init_ex(AVLTreeInfo *tree, FreeDataFunc free_data_func, \
+	CompareFunc compare_func, const int alloc_nodes_once)
 {
 	tree->root = NULL;
 	tree->free_data_func = free_data_func;
 	tree->compare_func = compare_func;
-	return 0;
+	return fast_mblock_init_ex1(&tree->node_allocator, "avl-tree-node", \
+		sizeof(AVLTreeNode), alloc_nodes_once, 0, NULL, NULL, false);
 }
 
-static void avl_tree_destroy_loop(FreeDataFunc free_data_func, \
-		AVLTreeNode *pCurrentNode)
+int avl_tree_init(AVLTreeInfo *tree, FreeDataFunc free_data_func, \
+	CompareFunc compare_func)
 {
-	if (pCurrentNode->left != NULL)
-	{
-		avl_tree_destroy_loop(free_data_func, pCurrentNode->left);
-	}
-	if (pCurrentNode->right != NULL)
+	return avl_tree_init_ex(tree, free_data_func, compare_func, \
+		AVL_TREE_DEFAULT_ALLOC_NODES_ONCE);
+}
+
+static inline AVLTreeNode *avl_tree_first_node(AVLTreeNode *node)
+{
+	if (node == NULL)
 	{
-		avl_tree_destroy_loop(free_data_func, pCurrentNode->right);
+		return NULL;
 	}
-	
-	if (free_data_func != NULL)
+
+	while (node->left != NULL)
 	{
-		free_data_func(pCurrentNode->data);
+		node = node->left;
 	}
-	free(pCurrentNode);
+	return node;
 }
 
 void avl_tree_destroy(AVLTreeInfo *tree)
 {
+	AVLTreeNode *node;
+	AVLTreeNode *parent;
+
 	if (tree == NULL)
 	{
 		return;
 	}
 
-	if (tree->root != NULL)
+	//post-order traversal by the parent pointers
+	node = tree->root;
+	while (node != NULL)
 	{
-		avl_tree_destroy_loop(tree->free_data_func, tree->root);
-		tree->root = NULL;
-	}
-}
+		if (node->left != NULL)
+		{
+			node = node->left;
+			continue;
+		}
+		if (node->right != NULL)
+		{
+			node = node->right;
+			continue;
+		}
 
-static AVLTreeNode *createTreeNode(AVLTreeNode *pParentNode, void *target_data)
-{
-	AVLTreeNode *pNewNode;
-	pNewNode = (AVLTreeNode *)fc_malloc(sizeof(AVLTreeNode));
-	if (pNewNode == NULL)
-	{
-		return NULL;
-	}
+		parent = node->parent;
+		if (parent != NULL)
+		{
+			if (parent->left == node)
+			{
+				parent->left = NULL;
+			}
+			else
+			{
+				parent->right = NULL;
+			}
+		}
 
-	pNewNode->left = pNewNode->right = NULL;
-	pNewNode->data = target_data;
-	pNewNode->balance = 0;
+		if (tree->free_data_func != NULL)
+		{
+			tree->free_data_func(node->data);
+		}
+		node = parent;
+	}
 
-	return pNewNode;
+	/* free the node trunks, the destroyed allocator is empty and
+	 * allocates the new trunks on demand when the tree is reused */
+	tree->root = NULL;
+	fast_mblock_destroy(&tree->node_allocator);
 }
 
-static void avlRotateLeft(AVLTreeNode *pRotateNode, AVLTreeNode **ppRaiseNode)
-{
-	*ppRaiseNode = pRotateNode->right;
-	pRotateNode->right = (*ppRaiseNode)->left;
-	(*ppRaiseNode)->left = pRotateNode;
-}
+#define AVL_NODE_SIZE(node) ((node) != NULL ? (node)->size : 0)
 
-static void avlRotateRight(AVLTreeNode *pRotateNode, AVLTreeNode **ppRaiseNode)
+#define AVL_UPDATE_SIZE(node) \
+	(node)->size = AVL_NODE_SIZE((node)->left) + \
+		AVL_NODE_SIZE((node)->right) + 1
+
+static inline void avl_tree_replace_child(AVLTreeInfo *tree, \
+		AVLTreeNode *parent, AVLTreeNode *old_child, \
+		AVLTreeNode *new_child)
 {
-	*ppRaiseNode = pRotateNode->left;
-	pRotateNode->left = (*ppRaiseNode)->right;
-	(*ppRaiseNode)->right = pRotateNode;
+	if (parent == NULL)
+	{
+		tree->root = new_child;
+	}
+	else if (parent->left == old_child)
+	{
+		parent->left = new_child;
+	}
+	else
+	{
+		parent->right = new_child;
+	}
 }
 
-static void avlLeftBalanceWhenInsert(AVLTreeNode **pTreeNode, int *taller)
+static AVLTreeNode *avl_tree_rotate_left(AVLTreeInfo *tree, \
+		AVLTreeNode *node)
 {
-	AVLTreeNode *leftsub;
 	AVLTreeNode *rightsub;
 
-	leftsub = (*pTreeNode)->left;
-	switch (leftsub->balance)
+	rightsub = node->right;
+	node->right = rightsub->left;
+	if (rightsub->left != NULL)
 	{
-		case -1 :
-			(*pTreeNode)->balance = leftsub->balance = 0;
-			avlRotateRight (*pTreeNode, pTreeNode);
-			*taller = 0;
-			break;
-		case 0 :
-			break;
-		case 1 :
-			rightsub = leftsub->right;
-			switch ( rightsub->balance )
-			{
-				case -1:
-					(*pTreeNode)->balance = 1;
-					leftsub->balance = 0;
-					break;
-				case 0 :
-					(*pTreeNode)->balance = leftsub->balance = 0;
-					break;
-				case 1 :
-					(*pTreeNode)->balance = 0;
-					leftsub->balance = -1;
-					break;
-			}
-
-			rightsub->balance = 0;
-			avlRotateLeft( leftsub, &((*pTreeNode)->left));
-			avlRotateRight(*pTreeNode, pTreeNode);
-			*taller = 0;
+		rightsub->left->parent = node;
 	}
+
+	rightsub->parent = node->parent;
+	avl_tree_replace_child(tree, node->parent, node, rightsub);
+	rightsub->left = node;
+	node->parent = rightsub;
+
+	rightsub->size = node->size;
+	AVL_UPDATE_SIZE(node);
+	return rightsub;
 }
 
-static void avlRightBalanceWhenInsert(AVLTreeNode **pTreeNode, int *taller)
+static AVLTreeNode *avl_tree_rotate_right(AVLTreeInfo *tree, \
+		AVLTreeNode *node)
 {
-	AVLTreeNode *rightsub;
 	AVLTreeNode *leftsub;
 
-	rightsub = (*pTreeNode)->right;
-	switch (rightsub->balance)
+	leftsub = node->left;
+	node->left = leftsub->right;
+	if (leftsub->right != NULL)
 	{
-		case 1: 
-			(*pTreeNode)->balance = rightsub->balance = 0;
-			avlRotateLeft(*pTreeNode, pTreeNode);
-			*taller = 0;
-			break;
-		case 0: 
-			break; 
-		case -1:
-			leftsub = rightsub->left;
-			switch (leftsub->balance)
-			{ 
-				case 1 :
-					(*pTreeNode)->balance = -1;
-					rightsub->balance = 0;
-					break;
-				case 0 :
-					(*pTreeNode)->balance = rightsub->balance = 0;
-					break;
-				case -1 :
-					(*pTreeNode)->balance = 0;
-					rightsub->balance = 1;
-					break;
-			}
-
-			leftsub->balance = 0;
-			avlRotateRight(rightsub, &((*pTreeNode)->right));
-			avlRotateLeft(*pTreeNode, pTreeNode);
-			*taller = 0;
+		leftsub->right->parent = node;
 	}
+
+	leftsub->parent = node->parent;
+	avl_tree_replace_child(tree, node->parent, node, leftsub);
+	leftsub->right = node;
+	node->parent = leftsub;
+
+	leftsub->size = node->size;
+	AVL_UPDATE_SIZE(node);
+	return leftsub;
 }
 
-static int avl_tree_insert_loop(CompareFunc compare_func, AVLTreeNode **pCurrentNode, \
-		void *target_data, int *taller)
+/* rebalance the node which balance is -2 or 2,
+ * the balance is the height of the right subtree minus the left one.
+ * return the new root of the subtree and set *shorter to 1
+ * when the height of the subtree decreased */
+static AVLTreeNode *avl_tree_rebalance(AVLTreeInfo *tree, \
+		AVLTreeNode *node, int *shorter)
 {
-	int nCompRes;
-	int success;
+	AVLTreeNode *child;
+	AVLTreeNode *grandson;
 
-	if (*pCurrentNode == NULL)
+	if (node->balance > 0)
 	{
-		*pCurrentNode = createTreeNode(*pCurrentNode, target_data);
-		if (*pCurrentNode != NULL)
-		{
-			*taller = 1;
-			return 1;
-		}
-		else
+		child = node->right;
+		if (child->balance >= 0)
 		{
-			return -ENOMEM;
-		}
-	}
-
-	nCompRes = compare_func((*pCurrentNode)->data, target_data);
-	if (nCompRes > 0)
-	{
-		success = avl_tree_insert_loop(compare_func, \
-				&((*pCurrentNode)->left), target_data, taller);
-		if (*taller != 0)
-		{
-			switch ((*pCurrentNode)->balance)
+			avl_tree_rotate_left(tree, node);
+			if (child->balance == 0)  //only when delete
 			{
-				case -1:
-					avlLeftBalanceWhenInsert(pCurrentNode, taller);
-					break;
-				case 0:
-					(*pCurrentNode)->balance = -1;
-					break;
-				case 1:
-					(*pCurrentNode)->balance = 0;
-					*taller = 0;
-					break;
+				node->balance = 1;
+				child->balance = -1;
+				*shorter = 0;
+			}
+			else
+			{
+				node->balance = 0;
+				child->balance = 0;
+				*shorter = 1;
 			}
+			return child;
 		}
+
+		grandson = child->left;
+		avl_tree_rotate_right(tree, child);
+		avl_tree_rotate_left(tree, node);
+		node->balance = (grandson->balance == 1) ? -1 : 0;
+		child->balance = (grandson->balance == -1) ? 1 : 0;
 	}
-	else if (nCompRes < 0)
+	else
 	{
-		success = avl_tree_insert_loop(compare_func, \
-				&((*pCurrentNode)->right), target_data, taller);
-		if (*taller != 0)
+		child = node->left;
+		if (child->balance <= 0)
 		{
-			switch ((*pCurrentNode)->balance)
+			avl_tree_rotate_right(tree, node);
+			if (child->balance == 0)  //only when delete
 			{
-				case -1: 
-					(*pCurrentNode)->balance = 0;
-					*taller = 0;
-					break;
-				case 0:
-					(*pCurrentNode)->balance = 1; 
-					break;
-				case 1:
-					avlRightBalanceWhenInsert(pCurrentNode, taller);
-					break;
+				node->balance = -1;
+				child->balance = 1;
+				*shorter = 0;
+			}
+			else
+			{
+				node->balance = 0;
+				child->balance = 0;
+				*shorter = 1;
 			}
+			return child;
 		}
-	}
-	else
-	{
-		return 0;
-	}
-
-	return success;
-}
 
-int avl_tree_insert(AVLTreeInfo *tree, void *data)
-{
-	int taller;
+		grandson = child->right;
+		avl_tree_rotate_left(tree, child);
+		avl_tree_rotate_right(tree, node);
+		node->balance = (grandson->balance == -1) ? 1 : 0;
+		child->balance = (grandson->balance == 1) ? -1 : 0;
+	}
 
-	taller = 0;
-	return avl_tree_insert_loop(tree->compare_func, &(tree->root), \
-				data, &taller);
+	grandson->balance = 0;
+	*shorter = 1;
+	return grandson;
 }
 
-static int avl_tree_replace_loop(CompareFunc compare_func, \
-		FreeDataFunc free_data_func, AVLTreeNode **pCurrentNode, \
-		void *target_data, int *taller)
+static int avl_tree_do_insert(AVLTreeInfo *tree, void *data, \
+		const bool replace)
 {
+	AVLTreeNode *parent;
+	AVLTreeNode *node;
+	AVLTreeNode **link;
 	int nCompRes;
-	int success;
+	int shorter;
 
-	if (*pCurrentNode == NULL )
+	parent = NULL;
+	link = &tree->root;
+	while (*link != NULL)
 	{
-		*pCurrentNode = createTreeNode(*pCurrentNode, target_data);
-		if (*pCurrentNode != NULL)
+		parent = *link;
+		nCompRes = tree->compare_func(parent->data, data);
+		if (nCompRes > 0)
 		{
-			*taller = 1;
-			return 1;
+			link = &parent->left;
 		}
-		else
+		else if (nCompRes < 0)
 		{
-			return -ENOMEM;
+			link = &parent->right;
 		}
-	}
-
-	nCompRes = compare_func((*pCurrentNode)->data, target_data);
-	if (nCompRes > 0)
-	{
-		success = avl_tree_replace_loop(compare_func, free_data_func, 
-				&((*pCurrentNode)->left), target_data, taller);
-		if (*taller != 0)
+		else
 		{
-			switch ((*pCurrentNode)->balance)
+			if (replace)
 			{
-				case -1:
-					avlLeftBalanceWhenInsert(pCurrentNode, taller);
-					break;
-				case 0:
-					(*pCurrentNode)->balance = -1;
-					break;
-				case 1:
-					(*pCurrentNode)->balance = 0;
-					*taller = 0;
-					break;
+				if (tree->free_data_func != NULL)
+				{
+					tree->free_data_func(parent->data);
+				}
+				parent->data = data;
 			}
+			return 0;
 		}
 	}
-	else if (nCompRes < 0)
+
+	node = (AVLTreeNode *)fast_mblock_alloc_object(&tree->node_allocator);
+	if (node == NULL)
 	{
-		success = avl_tree_replace_loop(compare_func, free_data_func, 
-				&((*pCurrentNode)->right), target_data, taller);
-		if (*taller != 0) 
-		{
-			switch ((*pCurrentNode)->balance)
-			{
-				case -1 : 
-					(*pCurrentNode)->balance = 0;
-					*taller = 0;
-					break;
-				case 0 :
-					(*pCurrentNode)->balance = 1; 
-					break;
-				case 1 :
-					avlRightBalanceWhenInsert(pCurrentNode, taller);
-					break;
-			}
-		}
+		return -ENOMEM;
 	}
-	else
+
+	node->data = data;
+	node->left = node->right = NULL;
+	node->parent = parent;
+	node->size = 1;
+	node->balance = 0;
+	*link = node;
+
+	for (parent=node->parent; parent!=NULL; parent=parent->parent)
 	{
-		if (free_data_func != NULL)
+		parent->size++;
+	}
+
+	//retrace: stop when the height of the subtree is unchanged
+	parent = node->parent;
+	while (parent != NULL)
+	{
+		if (parent->left == node)
 		{
-			free_data_func((*pCurrentNode)->data);
+			parent->balance--;
 		}
-		(*pCurrentNode)->data = target_data;
-		return 0;
+		else
+		{
+			parent->balance++;
+		}
+
+		if (parent->balance == 0)
+		{
+			break;
+		}
+		if (parent->balance == 2 || parent->balance == -2)
+		{
+			avl_tree_rebalance(tree, parent, &shorter);
+			break;
+		}
+
+		node = parent;
+		parent = node->parent;
 	}
 
-	return success;
+	return 1;
 }
 
-int avl_tree_replace(AVLTreeInfo *tree, void *data)
+int avl_tree_insert(AVLTreeInfo *tree, void *data)
 {
-	int taller;
+	return avl_tree_do_insert(tree, data, false);
+}
 
-	taller = 0;
-	return avl_tree_replace_loop(tree->compare_func, \
-			tree->free_data_func, &(tree->root), data, &taller);
+int avl_tree_replace(AVLTreeInfo *tree, void *data)
+{
+	return avl_tree_do_insert(tree, data, true);
 }
 
-static AVLTreeNode *avl_tree_find_loop(CompareFunc compare_func, \
-		AVLTreeNode *pCurrentNode, void *target_data)
+static AVLTreeNode *avl_tree_find_node(AVLTreeInfo *tree, void *target_data)
 {
+	AVLTreeNode *node;
 	int nCompRes;
-	nCompRes = compare_func(pCurrentNode->data, target_data);
-	if (nCompRes > 0)
+
+	node = tree->root;
+	while (node != NULL)
 	{
-		if (pCurrentNode->left == NULL)
+		nCompRes = tree->compare_func(node->data, target_data);
+		if (nCompRes > 0)
 		{
-			return NULL;
+			node = node->left;
 		}
-		else
-		{
-			return avl_tree_find_loop(compare_func, \
-				pCurrentNode->left, target_data);
-		}
-	}
-	else if (nCompRes < 0)
-	{
-		if (pCurrentNode->right == NULL)
+		else if (nCompRes < 0)
 		{
-			return NULL;
+			node = node->right;
 		}
 		else
 		{
-			return avl_tree_find_loop(compare_func, \
-				pCurrentNode->right, target_data);
+			return node;
 		}
 	}
-	else
-	{
-		return pCurrentNode;
-	}
+
+	return NULL;
 }
 
-static void *avl_tree_find_ge_loop(CompareFunc compare_func, \
-		AVLTreeNode *pCurrentNode, void *target_data)
+/* find the first node >= target_data when equal is true,
+ * otherwise find the first node > target_data */
+static AVLTreeNode *avl_tree_find_lower_bound(AVLTreeInfo *tree, \
+		void *target_data, const bool equal)
 {
+	AVLTreeNode *node;
+	AVLTreeNode *found;
 	int nCompRes;
-	void *found;
 
-	nCompRes = compare_func(pCurrentNode->data, target_data);
-	if (nCompRes > 0)
+	found = NULL;
+	node = tree->root;
+	while (node != NULL)
 	{
-		if (pCurrentNode->left == NULL)
+		nCompRes = tree->compare_func(node->data, target_data);
+		if (nCompRes > 0 || (nCompRes == 0 && equal))
 		{
-			return pCurrentNode->data;
-		}
-
-		found = avl_tree_find_ge_loop(compare_func, \
-				pCurrentNode->left, target_data);
-		return found != NULL ? found : pCurrentNode->data;
-	}
-	else if (nCompRes < 0)
-	{
-		if (pCurrentNode->right == NULL)
-		{
-			return NULL;
+			found = node;
+			if (nCompRes == 0)
+			{
+				break;
+			}
+			node = node->left;
 		}
 		else
 		{
-			return avl_tree_find_ge_loop(compare_func, \
-				pCurrentNode->right, target_data);
+			node = node->right;
 		}
 	}
-	else
-	{
-		return pCurrentNode->data;
-	}
+
+	return found;
 }
 
 void *avl_tree_find(AVLTreeInfo *tree, void *target_data)
 {
 	AVLTreeNode *found;
 
-	if (tree->root == NULL)
-	{
-		return NULL;
-	}
-
-	found = avl_tree_find_loop(tree->compare_func, \
-			tree->root, target_data);
-
+	found = avl_tree_find_node(tree, target_data);
 	return found != NULL ? found->data : NULL;
 }
 
 void *avl_tree_find_ge(AVLTreeInfo *tree, void *target_data)
 {
-	void *found;
-
-	if (tree->root == NULL)
-	{
-		found = NULL;
-	}
-	else
-	{
-		found = avl_tree_find_ge_loop(tree->compare_func, \
-			tree->root, target_data);
-	}
+	AVLTreeNode *found;
 
-	return found;
+	found = avl_tree_find_lower_bound(tree, target_data, true);
+	return found != NULL ? found->data : NULL;
 }
 
-static void avlLeftBalanceWhenDelete(AVLTreeNode **pTreeNode, int *shorter)
+int avl_tree_delete(AVLTreeInfo *tree, void *data)
 {
-	AVLTreeNode *leftsub;
-	AVLTreeNode *rightsub;
+	AVLTreeNode *node;
+	AVLTreeNode *child;
+	AVLTreeNode *parent;
+	AVLTreeNode *current;
+	bool is_left;
+	int shorter;
 
-	leftsub = (*pTreeNode)->left;
-	switch (leftsub->balance)
+	if ((node=avl_tree_find_node(tree, data)) == NULL)
 	{
-		case -1:
-			(*pTreeNode)->balance = leftsub->balance = 0;
-			avlRotateRight (*pTreeNode, pTreeNode);
-			break;
-		case 0:
-			leftsub->balance = 1;
-			avlRotateRight(*pTreeNode, pTreeNode);
-			*shorter = 0;
-			break;
-		case 1:
-			rightsub = leftsub->right;
-			switch ( rightsub->balance )
-			{
-				case -1:
-					(*pTreeNode)->balance = 1;
-					leftsub->balance = 0;
-					break;
-				case 0 :
-					(*pTreeNode)->balance = leftsub->balance = 0;
-					break;
-				case 1 :
-					(*pTreeNode)->balance = 0;
-					leftsub->balance = -1;
-					break;
-			}
-
-			rightsub->balance = 0;
-			avlRotateLeft( leftsub, &((*pTreeNode)->left));
-			avlRotateRight(*pTreeNode, pTreeNode);
-			break;
+		return 0;
 	}
-}
 
-static void avlRightBalanceWhenDelete(AVLTreeNode **pTreeNode, int *shorter)
-{
-	AVLTreeNode *rightsub;
-	AVLTreeNode *leftsub;
-
-	rightsub = (*pTreeNode)->right;
-	switch (rightsub->balance)
+	if (tree->free_data_func != NULL)
 	{
-		case 1:
-			(*pTreeNode)->balance = rightsub->balance = 0;
-			avlRotateLeft(*pTreeNode, pTreeNode);
-			break;
-		case 0:
-			rightsub->balance = -1;
-			avlRotateLeft(*pTreeNode, pTreeNode);
-			*shorter = 0;
-			break;
-		case -1:
-			leftsub = rightsub->left;
-			switch (leftsub->balance)
-			{
-				case 1:
-					(*pTreeNode)->balance = -1;
-					rightsub->balance = 0;
-					break;
-				case 0:
-					(*pTreeNode)->balance = rightsub->balance = 0;
-					break;
-				case -1:
-					(*pTreeNode)->balance = 0;
-					rightsub->balance = 1;
-					break;
-			}
-
-			leftsub->balance = 0;
-			avlRotateRight(rightsub, &((*pTreeNode)->right));
-			avlRotateLeft(*pTreeNode, pTreeNode);
-			break;
+		tree->free_data_func(node->data);
 	}
-}
-
-static int avl_tree_delete_loop(AVLTreeInfo *tree, AVLTreeNode **pCurrentNode,\
-		 void *target_data, int *shorter, AVLTreeNode *pDeletedDataNode)
-{
-	int nCompRes;
-	bool result;
-	AVLTreeNode *leftsub;
-	AVLTreeNode *rightsub;
 
-	if (pDeletedDataNode != NULL)
+	if (node->left != NULL && node->right != NULL)
 	{
-		if ((*pCurrentNode)->right == NULL)
+		//move the data of the predecessor and remove the predecessor
+		current = node->left;
+		while (current->right != NULL)
 		{
-			pDeletedDataNode->data = (*pCurrentNode)->data;
-			leftsub = (*pCurrentNode)->left;
-
-			free(*pCurrentNode);
-			*pCurrentNode = leftsub;
-			*shorter = 1;
-			return 1;
+			current = current->right;
 		}
-
-		nCompRes = -1;
+		node->data = current->data;
+		node = current;
 	}
-	else
+
+	child = (node->left != NULL) ? node->left : node->right;
+	parent = node->parent;
+	is_left = (parent != NULL && parent->left == node);
+	if (child != NULL)
 	{
-		nCompRes = tree->compare_func((*pCurrentNode)->data, target_data);
+		child->parent = parent;
 	}
+	avl_tree_replace_child(tree, parent, node, child);
+	fast_mblock_free_object(&tree->node_allocator, node);
 
-	if (nCompRes > 0)
+	for (current=parent; current!=NULL; current=current->parent)
 	{
-		if ((*pCurrentNode)->left == NULL)
-		{
-			return 0;
-		}
-
-		result = avl_tree_delete_loop(tree, &((*pCurrentNode)->left), \
-				target_data, shorter, pDeletedDataNode);
-		if (*shorter != 0)
-		{
-			switch ((*pCurrentNode)->balance)
-			{
-			  case -1:
-				(*pCurrentNode)->balance = 0;
-				break;
-			  case 0:
-				(*pCurrentNode)->balance = 1;
-				*shorter = 0;
-				break;
-			  case 1:
-				avlRightBalanceWhenDelete(pCurrentNode, shorter);
-				break;
-			}
-		}
-		return result;
+		current->size--;
 	}
-	else if (nCompRes < 0)
-	{
-		if ((*pCurrentNode)->right == NULL)
-		{
-			return 0;
-		}
 
-		result = avl_tree_delete_loop(tree, &((*pCurrentNode)->right), \
-				target_data, shorter, pDeletedDataNode);
-		if (*shorter != 0)
-		{
-			switch ((*pCurrentNode)->balance)
-			{
-				case -1:
-		          		avlLeftBalanceWhenDelete(pCurrentNode, shorter);
-		          		break;
-		        	case 0:
-		          		(*pCurrentNode)->balance = -1;
-				  	*shorter = 0;
-		          		break;
-		        	case 1:
-		  	        	(*pCurrentNode)->balance = 0;
-		        	  	break;
-		    	}
-		}
-		return result;
-	}
-	else
+	//retrace: stop when the height of the subtree is unchanged
+	current = parent;
+	while (current != NULL)
 	{
-		if (tree->free_data_func != NULL)
+		if (is_left)
 		{
-			tree->free_data_func((*pCurrentNode)->data);
+			current->balance++;
 		}
-
-		leftsub = (*pCurrentNode)->left;
-		rightsub = (*pCurrentNode)->right;
-		if (leftsub == NULL)
+		else
 		{
-			free(*pCurrentNode);
-			*pCurrentNode = rightsub;
+			current->balance--;
 		}
-		else if (rightsub == NULL)
+
+		if (current->balance == 1 || current->balance == -1)
 		{
-			free(*pCurrentNode);
-			*pCurrentNode = leftsub;
+			break;
 		}
-		else
+		if (current->balance != 0)
 		{
-			avl_tree_delete_loop(tree, &((*pCurrentNode)->left), \
-				target_data, shorter, *pCurrentNode);
-
-			if (*shorter != 0)
+			current = avl_tree_rebalance(tree, current, &shorter);
+			if (!shorter)
 			{
-				switch ((*pCurrentNode)->balance)
-				{
-				  case -1:
-					(*pCurrentNode)->balance = 0;
-					break;
-				  case 0:
-					(*pCurrentNode)->balance = 1;
-					*shorter = 0;
-					break;
-				  case 1:
-					avlRightBalanceWhenDelete(pCurrentNode, shorter);
-					break;
-				}
+				break;
 			}
-			return 1;
 		}
 
-		*shorter = 1;
-		return 1;
-	}
-}
-
-int avl_tree_delete(AVLTreeInfo *tree, void *data)
-{
-	int shorter;
-
-	if (tree->root == NULL)
-	{
-		return 0;
+		parent = current->parent;
+		if (parent != NULL)
+		{
+			is_left = (parent->left == current);
+		}
+		current = parent;
 	}
 
-	shorter = 0;
-	return avl_tree_delete_loop(tree, &(tree->root), data, &shorter, NULL);
+	return 1;
 }
 
-static int avl_tree_walk_loop(DataOpFunc data_op_func, \
-		AVLTreeNode *pCurrentNode, void *args)
+int avl_tree_walk(AVLTreeInfo *tree, DataOpFunc data_op_func, void *args)
 {
+	AVLTreeIterator iterator;
+	AVLTreeNode *node;
 	int result;
 
-	if (pCurrentNode->left != NULL)
+	avl_tree_iterator(tree, &iterator);
+	while ((node=avl_tree_next_node(&iterator)) != NULL)
 	{
-		result = avl_tree_walk_loop(data_op_func, \
-				pCurrentNode->left, args);
-		if (result != 0)
+		if ((result=data_op_func(node->data, args)) != 0)
 		{
 			return result;
 		}
 	}
 
-	if ((result=data_op_func(pCurrentNode->data, args)) != 0)
-	{
-		return result;
-	}
-
-	/*
-	if (pCurrentNode->balance >= -1 && pCurrentNode->balance <= 1)
-	{
-		//printf("==%d\n", pCurrentNode->balance);
-	}
-	else
-	{
-		printf("==bad %d!!!!!!!!!!!!\n", pCurrentNode->balance);
-	}
-	*/
-
-	if (pCurrentNode->right != NULL)
-	{
-		result = avl_tree_walk_loop(data_op_func, \
-				pCurrentNode->right, args);
-	}
-
-	return result;
+	return 0;
 }
 
-int avl_tree_walk(AVLTreeInfo *tree, DataOpFunc data_op_func, void *args)
+int avl_tree_depth(AVLTreeInfo *tree)
 {
+	int depth;
+	AVLTreeNode *pNode;
+
 	if (tree->root == NULL)
 	{
 		return 0;
 	}
-	else
+
+	depth = 0;
+	pNode = tree->root;
+	while (pNode != NULL)
 	{
-		return avl_tree_walk_loop(data_op_func, tree->root, args);
+		if (pNode->balance == -1)
+		{
+			pNode = pNode->left;
+		}
+		else
+		{
+			pNode = pNode->right;
+		}
+		depth++;
 	}
+
+	return depth;
 }
 
-static void avl_tree_count_loop(AVLTreeNode *pCurrentNode, int *count)
+int avl_tree_count(AVLTreeInfo *tree)
 {
-	if (pCurrentNode->left != NULL)
-	{
-		avl_tree_count_loop(pCurrentNode->left, count);
-	}
+	return AVL_NODE_SIZE(tree->root);
+}
 
-	(*count)++;
+/* the count of the data < target_data when equal is false,
+ * otherwise the count of the data <= target_data */
+static int avl_tree_rank_ex(AVLTreeInfo *tree, void *target_data, \
+		const bool equal)
+{
+	AVLTreeNode *node;
+	int nCompRes;
+	int rank;
 
-	if (pCurrentNode->right != NULL)
+	rank = 0;
+	node = tree->root;
+	while (node != NULL)
 	{
-		avl_tree_count_loop(pCurrentNode->right, count);
+		nCompRes = tree->compare_func(node->data, target_data);
+		if (nCompRes < 0 || (nCompRes == 0 && equal))
+		{
+			rank += AVL_NODE_SIZE(node->left) + 1;
+			node = node->right;
+		}
+		else
+		{
+			node = node->left;
+		}
 	}
+
+	return rank;
 }
 
-int avl_tree_count(AVLTreeInfo *tree)
+int avl_tree_rank(AVLTreeInfo *tree, void *target_data)
 {
-	int count;
-	if (tree->root == NULL)
-	{
-		return 0;
-	}
-
-	count = 0;
-	avl_tree_count_loop(tree->root, &count);
-	return count;
+	return avl_tree_rank_ex(tree, target_data, false);
 }
 
-int avl_tree_depth(AVLTreeInfo *tree)
+void *avl_tree_nth(AVLTreeInfo *tree, const int index)
 {
-	int depth;
-	AVLTreeNode *pNode;
+	AVLTreeNode *node;
+	int left_size;
+	int remain;
 
-	if (tree->root == NULL)
+	if (index < 0 || index >= avl_tree_count(tree))
 	{
-		return 0;
+		return NULL;
 	}
 
-	depth = 0;
-	pNode = tree->root;
-	while (pNode != NULL)
+	remain = index;
+	node = tree->root;
+	while (node != NULL)
 	{
-		if (pNode->balance == -1)
+		left_size = AVL_NODE_SIZE(node->left);
+		if (remain < left_size)
 		{
-			pNode = pNode->left;
+			node = node->left;
+		}
+		else if (remain > left_size)
+		{
+			remain -= left_size + 1;
+			node = node->right;
 		}
 		else
 		{
-			pNode = pNode->right;
+			return node->data;
 		}
-		depth++;
 	}
 
-	return depth;
+	return NULL;
 }
 
-/*
-static void avl_tree_print_loop(AVLTreeNode *pCurrentNode)
+int avl_tree_count_range(AVLTreeInfo *tree, void *start_data, \
+		void *end_data)
 {
-	printf("%ld  left: %ld, right: %ld, balance: %d\n", pCurrentNode->data, 
-		pCurrentNode->left != NULL ? pCurrentNode->left->data : 0,
-		pCurrentNode->right != NULL ? pCurrentNode->right->data : 0,
-		pCurrentNode->balance);
-
-	if (pCurrentNode->left != NULL)
+	if (tree->compare_func(start_data, end_data) > 0)
 	{
-		avl_tree_print_loop(pCurrentNode->left);
+		return 0;
 	}
 
-	if (pCurrentNode->right != NULL)
-	{
-		avl_tree_print_loop(pCurrentNode->right);
-	}
+	return avl_tree_rank_ex(tree, end_data, true) -
+		avl_tree_rank_ex(tree, start_data, false);
 }
 
-void avl_tree_print(AVLTreeInfo *tree)
+void avl_tree_iterator(AVLTreeInfo *tree, AVLTreeIterator *iterator)
 {
-	if (tree->root == NULL)
+	iterator->current = avl_tree_first_node(tree->root);
+	iterator->end = NULL;
+}
+
+int avl_tree_iterator_at(AVLTreeInfo *tree, void *start_data, \
+		AVLTreeIterator *iterator)
+{
+	iterator->current = avl_tree_find_lower_bound(tree, start_data, true);
+	iterator->end = NULL;
+	return iterator->current != NULL ? 0 : ENOENT;
+}
+
+int avl_tree_find_range(AVLTreeInfo *tree, void *start_data, \
+		void *end_data, AVLTreeIterator *iterator)
+{
+	if (tree->compare_func(start_data, end_data) > 0)
 	{
-		return;
+		iterator->current = iterator->end = NULL;
+		return EINVAL;
 	}
 
-	avl_tree_print_loop(tree->root);
-}
-*/
+	iterator->current = avl_tree_find_lower_bound(tree, start_data, true);
+	if (iterator->current == NULL)
+	{
+		iterator->end = NULL;
+		return ENOENT;
+	}
 
+	iterator->end = avl_tree_find_lower_bound(tree, end_data, false);
+	if (iterator->current == iterator->end)
+	{
+		return ENOENT;
+	}
+	return 0;
+}
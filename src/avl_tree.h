@@ -21,11 +21,16 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include "common_define.h"
+#include "fast_mblock.h"
+
+#define AVL_TREE_DEFAULT_ALLOC_NODES_ONCE  1024
 
 typedef struct tagAVLTreeNode {
 	void *data;
 	struct tagAVLTreeNode *left;
 	struct tagAVLTreeNode *right;
+	struct tagAVLTreeNode *parent;
+	int size;   //the node count of the subtree rooted at this node
 	byte balance;
 } AVLTreeNode;
 
@@ -35,14 +40,40 @@ typedef struct tagAVLTreeInfo {
 	AVLTreeNode *root;
 	FreeDataFunc free_data_func;
 	CompareFunc compare_func;
+	struct fast_mblock_man node_allocator;
 } AVLTreeInfo;
 
+typedef struct tagAVLTreeIterator {
+	AVLTreeNode *current;
+	AVLTreeNode *end;    //the first node NOT belongs to the range
+} AVLTreeIterator;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+avl tree init, the nodes are allocated from the fast_mblock of the tree
+parameters:
+	tree: the avl tree
+	free_data_func: the function to free the data, can be NULL
+	compare_func: the data compare function
+	alloc_nodes_once: the node count to alloc once by the allocator
+return error no, 0 for success, != 0 fail
+*/
+int avl_tree_init_ex(AVLTreeInfo *tree, FreeDataFunc free_data_func, \
+	CompareFunc compare_func, const int alloc_nodes_once);
+
 int avl_tree_init(AVLTreeInfo *tree, FreeDataFunc free_data_func, \
 	CompareFunc compare_func);
+
+/**
+destroy the avl tree and release the node memory, the tree can be
+reused without avl_tree_init as before
+parameters:
+	tree: the avl tree
+return none
+*/
 void avl_tree_destroy(AVLTreeInfo *tree);
 
 int avl_tree_insert(AVLTreeInfo *tree, void *data);
@@ -51,10 +82,125 @@ int avl_tree_delete(AVLTreeInfo *tree, void *data);
 void *avl_tree_find(AVLTreeInfo *tree, void *target_data);
 void *avl_tree_find_ge(AVLTreeInfo *tree, void *target_data);
 int avl_tree_walk(AVLTreeInfo *tree, DataOpFunc data_op_func, void *args);
-int avl_tree_count(AVLTreeInfo *tree);
 int avl_tree_depth(AVLTreeInfo *tree);
 //void avl_tree_print(AVLTreeInfo *tree);
 
+/**
+get the data count of the tree in O(1)
+parameters:
+	tree: the avl tree
+return the data count
+*/
+int avl_tree_count(AVLTreeInfo *tree);
+
+/**
+get the rank of the target data in O(log n)
+parameters:
+	tree: the avl tree
+	target_data: the data to rank, need not exist in the tree
+return the count of the data less than the target data
+*/
+int avl_tree_rank(AVLTreeInfo *tree, void *target_data);
+
+/**
+get the data by the index of the sorted sequence in O(log n)
+parameters:
+	tree: the avl tree
+	index: the 0 based index
+return the data, NULL for index out of bounds
+*/
+void *avl_tree_nth(AVLTreeInfo *tree, const int index);
+
+/**
+get the data count of the range [start_data, end_data] in O(log n)
+parameters:
+	tree: the avl tree
+	start_data: the start data (inclusive)
+	end_data: the end data (inclusive)
+return the data count
+*/
+int avl_tree_count_range(AVLTreeInfo *tree, void *start_data, \
+		void *end_data);
+
+/**
+init the iterator to traverse all data in order
+parameters:
+	tree: the avl tree
+	iterator: the iterator to init
+return none
+*/
+void avl_tree_iterator(AVLTreeInfo *tree, AVLTreeIterator *iterator);
+
+/**
+init the iterator to start at avl_tree_find_ge(tree, start_data)
+parameters:
+	tree: the avl tree
+	start_data: the start data
+	iterator: the iterator to init
+return error no, 0 for success, ENOENT for no data
+*/
+int avl_tree_iterator_at(AVLTreeInfo *tree, void *start_data, \
+		AVLTreeIterator *iterator);
+
+/**
+init the iterator to traverse the range [start_data, end_data]
+parameters:
+	tree: the avl tree
+	start_data: the start data (inclusive)
+	end_data: the end data (inclusive)
+	iterator: the iterator to init
+return error no, 0 for success, ENOENT for no data,
+	EINVAL for start_data > end_data
+*/
+int avl_tree_find_range(AVLTreeInfo *tree, void *start_data, \
+		void *end_data, AVLTreeIterator *iterator);
+
+/**
+get the next node of the iterator, the tree must NOT be modified
+during the iteration
+parameters:
+	iterator: the iterator
+return the node, NULL for the end
+*/
+static inline AVLTreeNode *avl_tree_next_node(AVLTreeIterator *iterator)
+{
+	AVLTreeNode *node;
+	AVLTreeNode *next;
+
+	if ((node=iterator->current) == iterator->end)
+	{
+		return NULL;
+	}
+
+	if (node->right != NULL)
+	{
+		next = node->right;
+		while (next->left != NULL)
+		{
+			next = next->left;
+		}
+	}
+	else
+	{
+		next = node;
+		while (next->parent != NULL && next->parent->right == next)
+		{
+			next = next->parent;
+		}
+		next = next->parent;
+	}
+
+	iterator->current = next;
+	return node;
+}
+
+static inline void *avl_tree_next(AVLTreeIterator *iterator)
+{
+	AVLTreeNode *node;
+	node = avl_tree_next_node(iterator);
+	return node != NULL ? node->data : NULL;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//binary_log_decoder.c: decode the binary log files to the text log format
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "logger.h"
+#include "binary_logger.h"
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-p s|ms|us|none] [-o output_file] "
+            "<binary_log_file> ...\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+    LogContext text_context;
+    const char *output_file;
+    int time_precision;
+    int64_t message_count;
+    int result;
+    int ch;
+    int i;
+
+    output_file = NULL;
+    time_precision = LOG_TIME_PRECISION_SECOND;
+    while ((ch=getopt(argc, argv, "p:o:h")) != -1) {
+        switch (ch) {
+            case 'p':
+                if (strcmp(optarg, "s") == 0) {
+                    time_precision = LOG_TIME_PRECISION_SECOND;
+                } else if (strcmp(optarg, "ms") == 0) {
+                    time_precision = LOG_TIME_PRECISION_MSECOND;
+                } else if (strcmp(optarg, "us") == 0) {
+                    time_precision = LOG_TIME_PRECISION_USECOND;
+                } else if (strcmp(optarg, "none") == 0) {
+                    time_precision = LOG_TIME_PRECISION_NONE;
+                } else {
+                    usage(argv[0]);
+                    return EINVAL;
+                }
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EINVAL;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    if ((result=log_init_ex(&text_context)) != 0) {
+        return result;
+    }
+    if (output_file != NULL) {
+        if ((result=log_set_filename_ex(&text_context, output_file)) != 0) {
+            return result;
+        }
+    } else {
+        text_context.log_fd = STDOUT_FILENO;
+    }
+    log_set_time_precision(&text_context, time_precision);
+    log_set_cache_ex(&text_context, true);
+
+    for (i=optind; i<argc; i++) {
+        if ((result=binary_log_decode_file(argv[i], &text_context,
+                        &message_count)) != 0)
+        {
+            fprintf(stderr, "decode %s fail, decoded message count: "
+                    "%"PRId64", errno: %d, error info: %s\n", argv[i],
+                    message_count, result, STRERROR(result));
+            break;
+        }
+    }
+
+    log_destroy_ex(&text_context);
+    return result;
+}
@@ -0,0 +1,1181 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//binary_logger.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include "shared_func.h"
+#include "pthread_func.h"
+#include "binary_logger.h"
+
+#define BINARY_LOG_ALIGN(len)  (((len) + 7) & (~7))
+#define BINARY_LOG_RECORD_HEADER      'H'
+#define BINARY_LOG_MAX_RECORD_SIZE    (8 * 1024)
+#define BINARY_LOG_MAX_SPEC_SIZE      64
+
+typedef struct binary_log_spec {
+    const char *start;    //the '%'
+    const char *length;   //the length modifier
+    int length_len;
+    char conversion;
+    bool star_width;
+    bool star_precision;
+    int precision;        //the literal precision, -1 for none
+    unsigned char type;   //the arg type, 0 for none
+} BinaryLogSpec;
+
+typedef struct binary_log_format_registry {
+    pthread_mutex_t lock;
+    BinaryLogFormat **formats;  //indexed by id - 1
+    int count;
+    int alloc;
+} BinaryLogFormatRegistry;
+
+BinaryLogContext g_binary_log_context = {LOG_INFO, -1};
+
+static BinaryLogFormatRegistry format_registry = {
+    PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0};
+
+/* parse the next conversion spec, return the position after the spec,
+ * NULL for the end of the format */
+static const char *binary_log_next_spec(const char *p, BinaryLogSpec *spec)
+{
+    unsigned char length_type;
+    bool long_double;
+
+    while (*p != '%') {
+        if (*p == '\0') {
+            return NULL;
+        }
+        p++;
+    }
+
+    spec->start = p++;
+    spec->star_width = false;
+    spec->star_precision = false;
+    spec->precision = -1;
+    spec->type = 0;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->star_width = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->star_precision = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                if (spec->precision <= BINARY_LOG_MAX_STRING_LEN) {
+                    spec->precision = spec->precision * 10 + (*p - '0');
+                }
+                p++;
+            }
+        }
+    }
+
+    spec->length = p;
+    length_type = BINARY_LOG_ARG_INT;
+    long_double = false;
+    switch (*p) {
+        case 'h':
+            p += (*(p + 1) == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            if (*(p + 1) == 'l') {
+                length_type = BINARY_LOG_ARG_LLONG;
+                p += 2;
+            } else {
+                length_type = BINARY_LOG_ARG_LONG;
+                p++;
+            }
+            break;
+        case 'q':
+        case 'L':
+            length_type = BINARY_LOG_ARG_LLONG;
+            long_double = true;
+            p++;
+            break;
+        case 'j':
+            length_type = BINARY_LOG_ARG_INTMAX;
+            p++;
+            break;
+        case 'z':
+        case 'Z':
+            length_type = BINARY_LOG_ARG_SIZE;
+            p++;
+            break;
+        case 't':
+            length_type = BINARY_LOG_ARG_PTRDIFF;
+            p++;
+            break;
+        default:
+            break;
+    }
+    spec->length_len = p - spec->length;
+
+    spec->conversion = *p;
+    switch (*p) {
+        case 'd':
+        case 'i':
+            spec->type = length_type;
+            break;
+        case 'c':  //int or wint_t, keep the length modifier when format
+            spec->type = BINARY_LOG_ARG_INT;
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            spec->type = length_type | BINARY_LOG_ARG_UNSIGNED;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = long_double ? BINARY_LOG_ARG_LDOUBLE :
+                BINARY_LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = BINARY_LOG_ARG_STRING;
+            break;
+        case 'p':
+        case 'n':
+            spec->type = BINARY_LOG_ARG_POINTER;
+            break;
+        case 'm':
+            spec->type = BINARY_LOG_ARG_ERRNO;
+            break;
+        case '%':
+            break;
+        default:   //invalid conversion
+            spec->conversion = '\0';
+            return p;
+    }
+
+    return p + 1;
+}
+
+int binary_log_parse_format(const char *format, unsigned char *arg_types,
+        int *arg_count)
+{
+    return binary_log_parse_format_ex(format, arg_types, NULL, arg_count);
+}
+
+int binary_log_parse_format_ex(const char *format, unsigned char *arg_types,
+        short *arg_precisions, int *arg_count)
+{
+    BinaryLogSpec spec;
+    const char *p;
+    int need;
+
+    *arg_count = 0;
+    p = format;
+    while ((p=binary_log_next_spec(p, &spec)) != NULL) {
+        if (spec.conversion == '\0') {
+            return EINVAL;
+        }
+
+        need = (spec.star_width ? 1 : 0) + (spec.star_precision ? 1 : 0) +
+            (spec.type != 0 ? 1 : 0);
+        if (*arg_count + need > BINARY_LOG_MAX_ARGS) {
+            return EOVERFLOW;
+        }
+        if (spec.star_width) {
+            if (arg_precisions != NULL) {
+                arg_precisions[*arg_count] = BINARY_LOG_PRECISION_NONE;
+            }
+            arg_types[(*arg_count)++] = BINARY_LOG_ARG_INT;
+        }
+        if (spec.star_precision) {
+            if (arg_precisions != NULL) {
+                arg_precisions[*arg_count] = BINARY_LOG_PRECISION_NONE;
+            }
+            arg_types[(*arg_count)++] = BINARY_LOG_ARG_INT;
+        }
+        if (spec.type != 0) {
+            if (arg_precisions != NULL) {
+                if (spec.type != BINARY_LOG_ARG_STRING) {
+                    arg_precisions[*arg_count] = BINARY_LOG_PRECISION_NONE;
+                } else if (spec.star_precision) {
+                    arg_precisions[*arg_count] = BINARY_LOG_PRECISION_STAR;
+                } else {
+                    arg_precisions[*arg_count] = FC_MIN(spec.precision,
+                            BINARY_LOG_MAX_STRING_LEN);
+                }
+            }
+            arg_types[(*arg_count)++] = spec.type;
+        }
+    }
+
+    return 0;
+}
+
+static int binary_log_register(BinaryLogFormat *format)
+{
+    BinaryLogFormat **formats;
+    int result;
+    int alloc;
+
+    result = 0;
+    pthread_mutex_lock(&format_registry.lock);
+    do {
+        if (format->id != 0) {
+            break;
+        }
+
+        if ((result=binary_log_parse_format_ex(format->format,
+                        format->arg_types, format->arg_precisions,
+                        &format->arg_count)) != 0)
+        {
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "unsupported format: \"%s\" of %s:%d, errno: %d\n",
+                    __LINE__, format->format, format->file,
+                    format->line, result);
+            break;
+        }
+
+        if (format_registry.count == format_registry.alloc) {
+            alloc = format_registry.alloc > 0 ?
+                format_registry.alloc * 2 : 256;
+            formats = (BinaryLogFormat **)realloc(format_registry.formats,
+                    sizeof(BinaryLogFormat *) * alloc);
+            if (formats == NULL) {
+                result = ENOMEM;
+                break;
+            }
+            format_registry.formats = formats;
+            format_registry.alloc = alloc;
+        }
+
+        format_registry.formats[format_registry.count++] = format;
+        __atomic_store_n(&format->id, format_registry.count,
+                __ATOMIC_RELEASE);
+    } while (0);
+    pthread_mutex_unlock(&format_registry.lock);
+
+    return result;
+}
+
+static BinaryLogFormat *binary_log_get_format(const int id)
+{
+    BinaryLogFormat *format;
+
+    pthread_mutex_lock(&format_registry.lock);
+    if (id > 0 && id <= format_registry.count) {
+        format = format_registry.formats[id - 1];
+    } else {
+        format = NULL;
+    }
+    pthread_mutex_unlock(&format_registry.lock);
+    return format;
+}
+
+#define BINARY_LOG_ENCODE(p, end, value) \
+    do { \
+        if ((p) + sizeof(value) > (end)) { \
+            return -1; \
+        } \
+        memcpy(p, &(value), sizeof(value)); \
+        (p) += sizeof(value); \
+    } while (0)
+
+int binary_log_encode_args(const BinaryLogFormat *format,
+        const int err_no, va_list ap, char *buff, const int size)
+{
+    char *p;
+    char *end;
+    const char *str;
+    int64_t n64;
+    int n32;
+    int max_len;
+    double d;
+    unsigned short len;
+    int i;
+
+    p = buff;
+    end = buff + size;
+    n32 = 0;
+    for (i=0; i<format->arg_count; i++) {
+        switch (format->arg_types[i]) {
+            case BINARY_LOG_ARG_INT:
+            case BINARY_LOG_ARG_INT | BINARY_LOG_ARG_UNSIGNED:
+                n32 = va_arg(ap, int);
+                BINARY_LOG_ENCODE(p, end, n32);
+                continue;
+            case BINARY_LOG_ARG_LONG:
+                n64 = va_arg(ap, long);
+                break;
+            case BINARY_LOG_ARG_LONG | BINARY_LOG_ARG_UNSIGNED:
+                n64 = va_arg(ap, unsigned long);
+                break;
+            case BINARY_LOG_ARG_LLONG:
+            case BINARY_LOG_ARG_LLONG | BINARY_LOG_ARG_UNSIGNED:
+                n64 = va_arg(ap, long long);
+                break;
+            case BINARY_LOG_ARG_SIZE:
+            case BINARY_LOG_ARG_SIZE | BINARY_LOG_ARG_UNSIGNED:
+                n64 = va_arg(ap, size_t);
+                if (format->arg_types[i] == BINARY_LOG_ARG_SIZE) {
+                    n64 = (ssize_t)n64;
+                }
+                break;
+            case BINARY_LOG_ARG_INTMAX:
+            case BINARY_LOG_ARG_INTMAX | BINARY_LOG_ARG_UNSIGNED:
+                n64 = va_arg(ap, intmax_t);
+                break;
+            case BINARY_LOG_ARG_PTRDIFF:
+            case BINARY_LOG_ARG_PTRDIFF | BINARY_LOG_ARG_UNSIGNED:
+                n64 = va_arg(ap, ptrdiff_t);
+                break;
+            case BINARY_LOG_ARG_POINTER:
+                n64 = (int64_t)(uintptr_t)va_arg(ap, void *);
+                break;
+            case BINARY_LOG_ARG_ERRNO:
+                BINARY_LOG_ENCODE(p, end, err_no);
+                continue;
+            case BINARY_LOG_ARG_DOUBLE:
+                d = va_arg(ap, double);
+                BINARY_LOG_ENCODE(p, end, d);
+                continue;
+            case BINARY_LOG_ARG_LDOUBLE:
+                d = va_arg(ap, long double);
+                BINARY_LOG_ENCODE(p, end, d);
+                continue;
+            case BINARY_LOG_ARG_STRING:
+                if ((str=va_arg(ap, const char *)) == NULL) {
+                    str = "(null)";
+                }
+
+                /* never read beyond the precision because the string
+                 * of %.*s need not be NUL terminated, such as string_t */
+                max_len = format->arg_precisions[i];
+                if (max_len == BINARY_LOG_PRECISION_STAR) {
+                    max_len = n32;  //the previous int arg
+                }
+                if (max_len < 0 || max_len > BINARY_LOG_MAX_STRING_LEN) {
+                    max_len = BINARY_LOG_MAX_STRING_LEN;
+                }
+                len = strnlen(str, max_len);
+                if (p + sizeof(len) + len + 1 > end) {
+                    return -1;
+                }
+                memcpy(p, &len, sizeof(len));
+                p += sizeof(len);
+                memcpy(p, str, len);
+                p += len;
+                *p++ = '\0';
+                continue;
+            default:
+                return -1;
+        }
+
+        BINARY_LOG_ENCODE(p, end, n64);
+    }
+
+    return p - buff;
+}
+
+#define BINARY_LOG_DECODE(p, end, value) \
+    do { \
+        if ((p) + sizeof(value) > (end)) { \
+            return -EINVAL; \
+        } \
+        memcpy(&(value), p, sizeof(value)); \
+        (p) += sizeof(value); \
+    } while (0)
+
+#define BINARY_LOG_SNPRINTF(value) \
+    do { \
+        if (spec.star_width && spec.star_precision) { \
+            len = snprintf(out, out_end - out, fmt, width, \
+                    precision, value); \
+        } else if (spec.star_width) { \
+            len = snprintf(out, out_end - out, fmt, width, value); \
+        } else if (spec.star_precision) { \
+            len = snprintf(out, out_end - out, fmt, precision, value); \
+        } else { \
+            len = snprintf(out, out_end - out, fmt, value); \
+        } \
+    } while (0)
+
+int binary_log_format_args(const BinaryLogFormat *format, const char *args,
+        const int args_len, char *buff, const int size)
+{
+    BinaryLogSpec spec;
+    char fmt[BINARY_LOG_MAX_SPEC_SIZE];
+    const char *p;
+    const char *next;
+    const char *end;
+    const char *str;
+    char *out;
+    char *out_end;
+    int64_t n64;
+    int n32;
+    int width;
+    int precision;
+    double d;
+    unsigned short slen;
+    int prefix_len;
+    int len;
+
+    if (size <= 0) {
+        return -EINVAL;
+    }
+
+    out = buff;
+    out_end = buff + size;
+    end = args + args_len;
+    p = format->format;
+    while (out < out_end - 1) {
+        if ((next=binary_log_next_spec(p, &spec)) == NULL) {
+            len = strlen(p);
+        } else {
+            len = spec.start - p;
+        }
+        if (len > out_end - 1 - out) {
+            len = out_end - 1 - out;
+        }
+        memcpy(out, p, len);
+        out += len;
+        if (next == NULL || out == out_end - 1) {
+            break;
+        }
+
+        p = next;
+        if (spec.conversion == '\0') {
+            return -EINVAL;
+        }
+        if (spec.conversion == '%' || spec.conversion == 'n') {
+            if (spec.conversion == 'n') {
+                BINARY_LOG_DECODE(args, end, n64);
+            } else {
+                *out++ = '%';
+            }
+            continue;
+        }
+
+        width = precision = 0;
+        if (spec.star_width) {
+            BINARY_LOG_DECODE(args, end, width);
+        }
+        if (spec.star_precision) {
+            BINARY_LOG_DECODE(args, end, precision);
+        }
+
+        //rewrite the length modifier as the encoded type
+        prefix_len = spec.length - spec.start;
+        if (prefix_len + 4 > sizeof(fmt)) {
+            return -EINVAL;
+        }
+        memcpy(fmt, spec.start, prefix_len);
+        switch (spec.type & (~BINARY_LOG_ARG_UNSIGNED)) {
+            case BINARY_LOG_ARG_INT:
+                memcpy(fmt + prefix_len, spec.length, spec.length_len);
+                prefix_len += spec.length_len;
+                break;
+            case BINARY_LOG_ARG_DOUBLE:
+            case BINARY_LOG_ARG_LDOUBLE:
+            case BINARY_LOG_ARG_STRING:
+            case BINARY_LOG_ARG_POINTER:
+            case BINARY_LOG_ARG_ERRNO:
+                break;
+            default:
+                fmt[prefix_len++] = 'l';
+                fmt[prefix_len++] = 'l';
+                break;
+        }
+        fmt[prefix_len++] = (spec.type == BINARY_LOG_ARG_ERRNO) ?
+            's' : spec.conversion;
+        fmt[prefix_len] = '\0';
+
+        switch (spec.type & (~BINARY_LOG_ARG_UNSIGNED)) {
+            case BINARY_LOG_ARG_INT:
+                BINARY_LOG_DECODE(args, end, n32);
+                BINARY_LOG_SNPRINTF(n32);
+                break;
+            case BINARY_LOG_ARG_DOUBLE:
+            case BINARY_LOG_ARG_LDOUBLE:
+                BINARY_LOG_DECODE(args, end, d);
+                BINARY_LOG_SNPRINTF(d);
+                break;
+            case BINARY_LOG_ARG_STRING:
+                BINARY_LOG_DECODE(args, end, slen);
+                if (args + slen + 1 > end) {
+                    return -EINVAL;
+                }
+                str = args;
+                args += slen + 1;
+                BINARY_LOG_SNPRINTF(str);
+                break;
+            case BINARY_LOG_ARG_POINTER:
+                BINARY_LOG_DECODE(args, end, n64);
+                BINARY_LOG_SNPRINTF((void *)(uintptr_t)n64);
+                break;
+            case BINARY_LOG_ARG_ERRNO:
+                BINARY_LOG_DECODE(args, end, n32);
+                BINARY_LOG_SNPRINTF(STRERROR(n32));
+                break;
+            default:
+                BINARY_LOG_DECODE(args, end, n64);
+                BINARY_LOG_SNPRINTF((long long)n64);
+                break;
+        }
+
+        if (len < 0) {
+            return -EINVAL;
+        }
+        if (len >= out_end - out) {
+            out = out_end - 1;
+        } else {
+            out += len;
+        }
+    }
+
+    *out = '\0';
+    return out - buff;
+}
+
+static int binary_log_output_message(LogContext *text_context,
+        const BinaryLogFormat *format, const BinaryLogMessageBody *body,
+        const int args_len)
+{
+    char text[LINE_MAX];
+    struct timeval tv;
+    int len;
+
+    if ((len=binary_log_format_args(format, (const char *)(body + 1),
+                    args_len, text, sizeof(text))) < 0)
+    {
+        return -1 * len;
+    }
+
+    tv.tv_sec = body->timestamp / 1000000;
+    tv.tv_usec = body->timestamp % 1000000;
+    log_it_ex3(text_context, &tv, log_get_priority_caption(format->level),
+            text, len, false, true);
+    return 0;
+}
+
+static void binary_log_write_to_text(BinaryLogContext *pContext,
+        const char *buff, const int length)
+{
+    const BinaryLogRecordHeader *header;
+    const BinaryLogMessageBody *body;
+    BinaryLogFormat *format;
+    const char *p;
+    const char *end;
+
+    p = buff;
+    end = buff + length;
+    while (p < end) {
+        header = (const BinaryLogRecordHeader *)p;
+        p += sizeof(BinaryLogRecordHeader) + BINARY_LOG_ALIGN(header->length);
+        if (header->type != BINARY_LOG_RECORD_MESSAGE) {
+            continue;
+        }
+
+        body = (const BinaryLogMessageBody *)(header + 1);
+        if ((format=binary_log_get_format(body->id)) == NULL) {
+            continue;
+        }
+        binary_log_output_message(pContext->text_context, format, body,
+                header->length - sizeof(BinaryLogMessageBody));
+    }
+}
+
+static void binary_log_do_flush(BinaryLogContext *pContext,
+        BinaryLogBuffer *buffer)
+{
+    int result;
+
+    if (pContext->fd >= 0 && fc_safe_write(pContext->fd,
+                buffer->buff, buffer->length) != buffer->length)
+    {
+        result = errno != 0 ? errno : EIO;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "write to binary log file: %s fail, "
+                "errno: %d, error info: %s\n", __LINE__,
+                pContext->filename, result, STRERROR(result));
+    }
+
+    if (pContext->text_context != NULL) {
+        binary_log_write_to_text(pContext, buffer->buff, buffer->length);
+    }
+}
+
+static void *binary_log_flusher_func(void *arg)
+{
+    BinaryLogContext *pContext;
+    BinaryLogBuffer *buffer;
+    struct timespec ts;
+    int64_t expire_us;
+
+    pContext = (BinaryLogContext *)arg;
+    pthread_mutex_lock(&pContext->lcp.lock);
+    while (pContext->running || pContext->active->length > 0) {
+        if (pContext->active->length == 0) {
+            expire_us = get_current_time_us() +
+                pContext->flush_interval_ms * 1000;
+            ts.tv_sec = expire_us / 1000000;
+            ts.tv_nsec = (expire_us % 1000000) * 1000;
+            pthread_cond_timedwait(&pContext->lcp.cond,
+                    &pContext->lcp.lock, &ts);
+            if (pContext->active->length == 0) {
+                continue;
+            }
+        }
+
+        buffer = pContext->active;
+        pContext->active = pContext->standby;
+        pContext->standby = buffer;
+        pContext->flushing = true;
+        pthread_mutex_unlock(&pContext->lcp.lock);
+
+        binary_log_do_flush(pContext, buffer);
+
+        pthread_mutex_lock(&pContext->lcp.lock);
+        pContext->write_bytes += buffer->length;
+        buffer->length = 0;
+        pContext->flushing = false;
+        pthread_cond_broadcast(&pContext->lcp.cond);
+    }
+    pthread_mutex_unlock(&pContext->lcp.lock);
+
+    return NULL;
+}
+
+static int binary_log_open(BinaryLogContext *pContext, const char *filename)
+{
+    struct {
+        BinaryLogRecordHeader header;
+        BinaryLogFileHeader body;
+    } record;
+    int result;
+
+    snprintf(pContext->filename, sizeof(pContext->filename), "%s", filename);
+    if ((pContext->fd=open(filename, O_WRONLY | O_CREAT | O_APPEND |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        result = errno != 0 ? errno : EACCES;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open binary log file: %s fail, "
+                "errno: %d, error info: %s\n",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    //the header record resets the format ids of the decoder
+    memset(&record, 0, sizeof(record));
+    record.header.type = BINARY_LOG_RECORD_HEADER;
+    record.header.length = sizeof(BinaryLogFileHeader);
+    memcpy(record.body.magic, BINARY_LOG_FILE_MAGIC,
+            BINARY_LOG_FILE_MAGIC_LEN);
+    record.body.version = BINARY_LOG_FILE_VERSION;
+    if (fc_safe_write(pContext->fd, (const char *)&record,
+                sizeof(record)) != sizeof(record))
+    {
+        result = errno != 0 ? errno : EIO;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "write to binary log file: %s fail, "
+                "errno: %d, error info: %s\n",
+                __LINE__, filename, result, STRERROR(result));
+        close(pContext->fd);
+        pContext->fd = -1;
+        return result;
+    }
+
+    return 0;
+}
+
+int binary_log_init_ex(BinaryLogContext *pContext, const char *filename,
+        LogContext *text_context, const int buffer_size,
+        const int flush_interval_ms)
+{
+    int result;
+
+    if (filename == NULL && text_context == NULL) {
+        return EINVAL;
+    }
+
+    memset(pContext, 0, sizeof(BinaryLogContext));
+    pContext->log_level = LOG_INFO;
+    pContext->fd = -1;
+    pContext->text_context = text_context;
+    pContext->buffer_size = buffer_size > 0 ? buffer_size :
+        BINARY_LOG_DEFAULT_BUFFER_SIZE;
+    if (pContext->buffer_size < BINARY_LOG_MAX_RECORD_SIZE) {
+        pContext->buffer_size = BINARY_LOG_MAX_RECORD_SIZE;
+    }
+    pContext->flush_interval_ms = flush_interval_ms > 0 ?
+        flush_interval_ms : BINARY_LOG_DEFAULT_FLUSH_INTERVAL;
+
+    if ((pContext->buffers[0].buff=(char *)fc_malloc(
+                    pContext->buffer_size * 2)) == NULL)
+    {
+        return ENOMEM;
+    }
+    pContext->buffers[1].buff = pContext->buffers[0].buff +
+        pContext->buffer_size;
+    pContext->active = pContext->buffers + 0;
+    pContext->standby = pContext->buffers + 1;
+
+    if (filename != NULL && (result=binary_log_open(
+                    pContext, filename)) != 0)
+    {
+        free(pContext->buffers[0].buff);
+        return result;
+    }
+
+    if ((result=init_pthread_lock_cond_pair(&pContext->lcp)) != 0) {
+        binary_log_destroy_ex(pContext);
+        return result;
+    }
+
+    pContext->running = true;
+    if ((result=pthread_create(&pContext->flusher_tid, NULL,
+                    binary_log_flusher_func, pContext)) != 0)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "create thread failed, errno: %d, error info: %s\n",
+                __LINE__, result, STRERROR(result));
+        pContext->running = false;
+        destroy_pthread_lock_cond_pair(&pContext->lcp);
+        binary_log_destroy_ex(pContext);
+        return result;
+    }
+
+    return 0;
+}
+
+void binary_log_destroy_ex(BinaryLogContext *pContext)
+{
+    if (pContext->running) {
+        pthread_mutex_lock(&pContext->lcp.lock);
+        pContext->running = false;
+        pthread_cond_broadcast(&pContext->lcp.cond);
+        pthread_mutex_unlock(&pContext->lcp.lock);
+        pthread_join(pContext->flusher_tid, NULL);
+        destroy_pthread_lock_cond_pair(&pContext->lcp);
+    }
+
+    if (pContext->fd >= 0) {
+        close(pContext->fd);
+        pContext->fd = -1;
+    }
+    if (pContext->buffers[0].buff != NULL) {
+        free(pContext->buffers[0].buff);
+        pContext->buffers[0].buff = NULL;
+    }
+    if (pContext->format_written != NULL) {
+        free(pContext->format_written);
+        pContext->format_written = NULL;
+    }
+}
+
+/* reserve the space of the active buffer, must be locked */
+static char *binary_log_reserve(BinaryLogContext *pContext, const int size)
+{
+    char *p;
+
+    if (size > pContext->buffer_size) {
+        return NULL;
+    }
+
+    while (pContext->active->length + size > pContext->buffer_size) {
+        if (!pContext->running) {
+            return NULL;
+        }
+        pthread_cond_broadcast(&pContext->lcp.cond);
+        pthread_cond_wait(&pContext->lcp.cond, &pContext->lcp.lock);
+    }
+
+    p = pContext->active->buff + pContext->active->length;
+    pContext->active->length += size;
+    return p;
+}
+
+/* append the format record once per context, must be locked */
+static int binary_log_append_format(BinaryLogContext *pContext,
+        const BinaryLogFormat *format)
+{
+    BinaryLogRecordHeader *header;
+    BinaryLogFormatBody *body;
+    char *written;
+    char *p;
+    int file_len;
+    int format_len;
+    int length;
+    int size;
+
+    if (format->id < pContext->format_written_size &&
+            pContext->format_written[format->id])
+    {
+        return 0;
+    }
+
+    if (format->id >= pContext->format_written_size) {
+        size = pContext->format_written_size > 0 ?
+            pContext->format_written_size : 256;
+        while (size <= format->id) {
+            size *= 2;
+        }
+        if ((written=(char *)realloc(pContext->format_written,
+                        size)) == NULL)
+        {
+            return ENOMEM;
+        }
+        memset(written + pContext->format_written_size, 0,
+                size - pContext->format_written_size);
+        pContext->format_written = written;
+        pContext->format_written_size = size;
+    }
+
+    if (pContext->fd >= 0) {
+        file_len = strlen(format->file);
+        format_len = strlen(format->format);
+        if (file_len > USHRT_MAX || format_len > USHRT_MAX) {
+            return EOVERFLOW;
+        }
+        length = sizeof(BinaryLogFormatBody) + file_len + format_len + 2;
+        if ((p=binary_log_reserve(pContext, sizeof(BinaryLogRecordHeader) +
+                        BINARY_LOG_ALIGN(length))) == NULL)
+        {
+            return EOVERFLOW;
+        }
+
+        header = (BinaryLogRecordHeader *)p;
+        header->type = BINARY_LOG_RECORD_FORMAT;
+        header->level = format->level;
+        header->padding = 0;
+        header->length = length;
+        body = (BinaryLogFormatBody *)(header + 1);
+        body->id = format->id;
+        body->line = format->line;
+        body->file_len = file_len;
+        body->format_len = format_len;
+        p = (char *)(body + 1);
+        memcpy(p, format->file, file_len + 1);
+        p += file_len + 1;
+        memcpy(p, format->format, format_len + 1);
+    }
+
+    pContext->format_written[format->id] = 1;
+    return 0;
+}
+
+int binary_log_write(BinaryLogContext *pContext,
+        BinaryLogFormat *format, ...)
+{
+    char buff[BINARY_LOG_MAX_RECORD_SIZE];
+    BinaryLogRecordHeader *header;
+    BinaryLogMessageBody *body;
+    char *p;
+    va_list ap;
+    int err_no;
+    int args_len;
+    int length;
+    int result;
+
+    err_no = errno;  //for %m
+    if (__atomic_load_n(&format->id, __ATOMIC_ACQUIRE) == 0) {
+        if ((result=binary_log_register(format)) != 0) {
+            return result;
+        }
+    }
+
+    header = (BinaryLogRecordHeader *)buff;
+    body = (BinaryLogMessageBody *)(header + 1);
+    va_start(ap, format);
+    args_len = binary_log_encode_args(format, err_no, ap,
+            (char *)(body + 1), sizeof(buff) - ((char *)(body + 1) - buff));
+    va_end(ap);
+    if (args_len < 0) {
+        return EOVERFLOW;
+    }
+
+    header->type = BINARY_LOG_RECORD_MESSAGE;
+    header->level = format->level;
+    header->padding = 0;
+    header->length = sizeof(BinaryLogMessageBody) + args_len;
+    body->id = format->id;
+    body->padding = 0;
+    body->timestamp = get_current_time_us();
+    length = sizeof(BinaryLogRecordHeader) + header->length;
+
+    pthread_mutex_lock(&pContext->lcp.lock);
+    if ((result=binary_log_append_format(pContext, format)) == 0) {
+        if ((p=binary_log_reserve(pContext, sizeof(BinaryLogRecordHeader) +
+                        BINARY_LOG_ALIGN(header->length))) != NULL)
+        {
+            memcpy(p, buff, length);
+            pContext->message_count++;
+        } else {
+            result = EOVERFLOW;
+        }
+    }
+    pthread_mutex_unlock(&pContext->lcp.lock);
+
+    return result;
+}
+
+int binary_log_flush(BinaryLogContext *pContext)
+{
+    if (!pContext->running) {
+        return EINVAL;
+    }
+
+    pthread_mutex_lock(&pContext->lcp.lock);
+    while (pContext->active->length > 0 || pContext->flushing) {
+        pthread_cond_broadcast(&pContext->lcp.cond);
+        pthread_cond_wait(&pContext->lcp.cond, &pContext->lcp.lock);
+    }
+    pthread_mutex_unlock(&pContext->lcp.lock);
+
+    return 0;
+}
+
+static void binary_log_free_formats(BinaryLogFormat **formats,
+        const int count)
+{
+    int i;
+
+    for (i=0; i<count; i++) {
+        if (formats[i] != NULL) {
+            free(formats[i]);
+            formats[i] = NULL;
+        }
+    }
+}
+
+static int binary_log_load_format(const char *filename,
+        const BinaryLogRecordHeader *header, BinaryLogFormat ***formats,
+        int *alloc)
+{
+    const BinaryLogFormatBody *body;
+    BinaryLogFormat *format;
+    BinaryLogFormat **new_formats;
+    const char *file;
+    int size;
+    int result;
+
+    body = (const BinaryLogFormatBody *)(header + 1);
+    if (header->length < sizeof(BinaryLogFormatBody) || body->id <= 0 ||
+            header->length != sizeof(BinaryLogFormatBody) +
+            body->file_len + body->format_len + 2)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "binary log file: %s, invalid format record\n",
+                __LINE__, filename);
+        return EINVAL;
+    }
+
+    if (body->id >= *alloc) {
+        size = *alloc > 0 ? *alloc * 2 : 256;
+        while (size <= body->id) {
+            size *= 2;
+        }
+        if ((new_formats=(BinaryLogFormat **)realloc(*formats,
+                        sizeof(BinaryLogFormat *) * size)) == NULL)
+        {
+            return ENOMEM;
+        }
+        memset(new_formats + *alloc, 0, sizeof(BinaryLogFormat *) *
+                (size - *alloc));
+        *formats = new_formats;
+        *alloc = size;
+    }
+
+    //the file and the format strings follow the struct
+    size = sizeof(BinaryLogFormat) + body->file_len + body->format_len + 2;
+    if ((format=(BinaryLogFormat *)fc_malloc(size)) == NULL) {
+        return ENOMEM;
+    }
+    memset(format, 0, sizeof(BinaryLogFormat));
+    file = (const char *)(body + 1);
+    memcpy(format + 1, file, body->file_len + body->format_len + 2);
+    format->id = body->id;
+    format->level = header->level;
+    format->line = body->line;
+    format->file = (const char *)(format + 1);
+    format->format = format->file + body->file_len + 1;
+    if ((result=binary_log_parse_format_ex(format->format,
+                    format->arg_types, format->arg_precisions,
+                    &format->arg_count)) != 0)
+    {
+        free(format);
+        return result;
+    }
+
+    if ((*formats)[body->id] != NULL) {
+        free((*formats)[body->id]);
+    }
+    (*formats)[body->id] = format;
+    return 0;
+}
+
+int binary_log_decode_file(const char *filename,
+        LogContext *text_context, int64_t *message_count)
+{
+    FILE *fp;
+    BinaryLogRecordHeader *header;
+    BinaryLogMessageBody *body;
+    BinaryLogFileHeader *file_header;
+    BinaryLogFormat **formats;
+    char *buff;
+    char *new_buff;
+    int buff_size;
+    int alloc;
+    int length;
+    int result;
+    int64_t count;
+    bool header_found;
+
+    if ((fp=fopen(filename, "rb")) == NULL) {
+        result = errno != 0 ? errno : ENOENT;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open file: %s fail, errno: %d, error info: %s\n",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    buff_size = BINARY_LOG_MAX_RECORD_SIZE;
+    if ((buff=(char *)fc_malloc(buff_size)) == NULL) {
+        fclose(fp);
+        return ENOMEM;
+    }
+
+    formats = NULL;
+    alloc = 0;
+    count = 0;
+    result = 0;
+    header_found = false;
+    header = (BinaryLogRecordHeader *)buff;
+    while (fread(header, sizeof(BinaryLogRecordHeader), 1, fp) == 1) {
+        if ((!header_found && header->type != BINARY_LOG_RECORD_HEADER)
+                || header->length < 0)
+        {
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "file: %s, not a binary log file\n",
+                    __LINE__, filename);
+            result = EINVAL;
+            break;
+        }
+        length = BINARY_LOG_ALIGN(header->length);
+        if (sizeof(BinaryLogRecordHeader) + length > buff_size) {
+            buff_size = sizeof(BinaryLogRecordHeader) + length;
+            if ((new_buff=(char *)realloc(buff, buff_size)) == NULL) {
+                result = ENOMEM;
+                break;
+            }
+            buff = new_buff;
+            header = (BinaryLogRecordHeader *)buff;
+        }
+        if (length > 0 && fread(header + 1, length, 1, fp) != 1) {
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "binary log file: %s, the last record is truncated\n",
+                    __LINE__, filename);
+            break;
+        }
+
+        if (header->type == BINARY_LOG_RECORD_MESSAGE) {
+            body = (BinaryLogMessageBody *)(header + 1);
+            if (header->length < sizeof(BinaryLogMessageBody) ||
+                    body->id <= 0 || body->id >= alloc ||
+                    formats[body->id] == NULL)
+            {
+                fprintf(stderr, "file: "__FILE__", line: %d, "
+                        "binary log file: %s, invalid message record\n",
+                        __LINE__, filename);
+                result = EINVAL;
+                break;
+            }
+            if ((result=binary_log_output_message(text_context,
+                            formats[body->id], body, header->length -
+                            sizeof(BinaryLogMessageBody))) != 0)
+            {
+                break;
+            }
+            count++;
+        } else if (header->type == BINARY_LOG_RECORD_FORMAT) {
+            if ((result=binary_log_load_format(filename, header,
+                            &formats, &alloc)) != 0)
+            {
+                break;
+            }
+        } else if (header->type == BINARY_LOG_RECORD_HEADER) {
+            file_header = (BinaryLogFileHeader *)(header + 1);
+            if (header->length != sizeof(BinaryLogFileHeader) ||
+                    memcmp(file_header->magic, BINARY_LOG_FILE_MAGIC,
+                        BINARY_LOG_FILE_MAGIC_LEN) != 0 ||
+                    file_header->version != BINARY_LOG_FILE_VERSION)
+            {
+                fprintf(stderr, "file: "__FILE__", line: %d, "
+                        "binary log file: %s, invalid file header\n",
+                        __LINE__, filename);
+                result = EINVAL;
+                break;
+            }
+
+            //a new writer appended, the format ids restart
+            binary_log_free_formats(formats, alloc);
+            header_found = true;
+        } else {
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "binary log file: %s, invalid record type: %d\n",
+                    __LINE__, filename, header->type);
+            result = EINVAL;
+            break;
+        }
+
+    }
+
+    if (formats != NULL) {
+        binary_log_free_formats(formats, alloc);
+        free(formats);
+    }
+    if (buff != NULL) {
+        free(buff);
+    }
+    fclose(fp);
+
+    if (message_count != NULL) {
+        *message_count = count;
+    }
+    log_sync_func(text_context);
+    return result;
+}
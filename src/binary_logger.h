@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//binary_logger.h: the deferred formatting logger, the hot path records
+//the format id, the timestamp and the raw arguments only
+
+#ifndef _BINARY_LOGGER_H
+#define _BINARY_LOGGER_H
+
+#include <stdarg.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "logger.h"
+
+#define BINARY_LOG_FILE_MAGIC      "FCBINLOG"
+#define BINARY_LOG_FILE_MAGIC_LEN  8
+#define BINARY_LOG_FILE_VERSION    1
+
+#define BINARY_LOG_RECORD_FORMAT   'F'
+#define BINARY_LOG_RECORD_MESSAGE  'M'
+
+#define BINARY_LOG_MAX_ARGS        32
+#define BINARY_LOG_MAX_STRING_LEN  1024   //the max bytes of a string arg
+#define BINARY_LOG_DEFAULT_BUFFER_SIZE     (256 * 1024)
+#define BINARY_LOG_DEFAULT_FLUSH_INTERVAL  100   //milliseconds
+
+//the arg types, the unsigned flag for the integer conversions o, u, x, X
+#define BINARY_LOG_ARG_INT        1
+#define BINARY_LOG_ARG_LONG       2
+#define BINARY_LOG_ARG_LLONG      3
+#define BINARY_LOG_ARG_SIZE       4
+#define BINARY_LOG_ARG_INTMAX     5
+#define BINARY_LOG_ARG_PTRDIFF    6
+#define BINARY_LOG_ARG_DOUBLE     7
+#define BINARY_LOG_ARG_LDOUBLE    8
+#define BINARY_LOG_ARG_STRING     9
+#define BINARY_LOG_ARG_POINTER   10
+#define BINARY_LOG_ARG_ERRNO     11   //%m, the errno of the call, no va_arg
+#define BINARY_LOG_ARG_UNSIGNED  0x80
+
+//the precision of the string args, the others are BINARY_LOG_PRECISION_NONE
+#define BINARY_LOG_PRECISION_NONE  -1
+#define BINARY_LOG_PRECISION_STAR  -2   //the previous int arg
+
+typedef struct binary_log_format {
+    volatile int id;   //assigned when first used, 0 for unregistered
+    int level;
+    int line;
+    const char *file;
+    const char *format;
+    int arg_count;
+    unsigned char arg_types[BINARY_LOG_MAX_ARGS];
+    short arg_precisions[BINARY_LOG_MAX_ARGS];
+} BinaryLogFormat;
+
+typedef struct binary_log_file_header {
+    char magic[BINARY_LOG_FILE_MAGIC_LEN];
+    int version;
+    int padding;
+} BinaryLogFileHeader;
+
+typedef struct binary_log_record_header {
+    unsigned char type;   //BINARY_LOG_RECORD_FORMAT or MESSAGE
+    unsigned char level;
+    unsigned short padding;
+    int length;           //the body length
+} BinaryLogRecordHeader;
+
+/* the body of the format record is followed by the file and the format */
+typedef struct binary_log_format_body {
+    int id;
+    int line;
+    unsigned short file_len;
+    unsigned short format_len;
+} BinaryLogFormatBody;
+
+/* the body of the message record is followed by the encoded args */
+typedef struct binary_log_message_body {
+    int id;
+    int padding;
+    int64_t timestamp;   //in microseconds
+} BinaryLogMessageBody;
+
+typedef struct binary_log_buffer {
+    char *buff;
+    int length;
+} BinaryLogBuffer;
+
+typedef struct binary_log_context {
+    int log_level;
+    int fd;                   //the binary log file, -1 for none
+    LogContext *text_context; //format in the flusher thread, NULL for none
+    int buffer_size;
+    int flush_interval_ms;
+    volatile bool running;
+    bool flushing;            //the flusher thread is writing the standby
+    pthread_t flusher_tid;
+    pthread_lock_cond_pair_t lcp;
+    BinaryLogBuffer buffers[2];
+    BinaryLogBuffer *active;  //appended by the logging threads
+    BinaryLogBuffer *standby; //written by the flusher thread
+    char *format_written;     //the format records written flags by id
+    int format_written_size;
+    int64_t message_count;
+    int64_t write_bytes;
+    char filename[MAX_PATH_SIZE];
+} BinaryLogContext;
+
+extern BinaryLogContext g_binary_log_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* for the format check of the compiler only, never called */
+static inline void binary_log_check_format(const char *format, ...)
+    __gcc_attribute__ ((format (printf, 1, 2)));
+
+static inline void binary_log_check_format(const char *format, ...)
+{
+}
+
+/* the format string is registered by the static format struct of
+ * the call site, no vsnprintf in the calling thread */
+#define blog_it_ex(pContext, level, fmt, ...) \
+    do { \
+        if ((level) <= (pContext)->log_level) { \
+            static BinaryLogFormat _binary_log_format = \
+                {0, level, __LINE__, __FILE__, fmt, 0}; \
+            if (0) binary_log_check_format(fmt, ##__VA_ARGS__); \
+            binary_log_write(pContext, &_binary_log_format, \
+                    ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define blogEmerg(fmt, ...)   blog_it_ex(&g_binary_log_context, \
+        LOG_EMERG, fmt, ##__VA_ARGS__)
+#define blogAlert(fmt, ...)   blog_it_ex(&g_binary_log_context, \
+        LOG_ALERT, fmt, ##__VA_ARGS__)
+#define blogCrit(fmt, ...)    blog_it_ex(&g_binary_log_context, \
+        LOG_CRIT, fmt, ##__VA_ARGS__)
+#define blogError(fmt, ...)   blog_it_ex(&g_binary_log_context, \
+        LOG_ERR, fmt, ##__VA_ARGS__)
+#define blogWarning(fmt, ...) blog_it_ex(&g_binary_log_context, \
+        LOG_WARNING, fmt, ##__VA_ARGS__)
+#define blogNotice(fmt, ...)  blog_it_ex(&g_binary_log_context, \
+        LOG_NOTICE, fmt, ##__VA_ARGS__)
+#define blogInfo(fmt, ...)    blog_it_ex(&g_binary_log_context, \
+        LOG_INFO, fmt, ##__VA_ARGS__)
+#define blogDebug(fmt, ...)   blog_it_ex(&g_binary_log_context, \
+        LOG_DEBUG, fmt, ##__VA_ARGS__)
+
+#define binary_log_init(filename, text_context) \
+    binary_log_init_ex(&g_binary_log_context, filename, text_context, \
+            BINARY_LOG_DEFAULT_BUFFER_SIZE, \
+            BINARY_LOG_DEFAULT_FLUSH_INTERVAL)
+
+#define binary_log_destroy() binary_log_destroy_ex(&g_binary_log_context)
+
+/**
+ * init the binary log context and start the flusher thread
+ * parameters:
+ *         pContext: the binary log context
+ *         filename: the binary log filename to append, NULL for none
+ *         text_context: the text log context to write the formatted
+ *                       messages by the flusher thread, NULL for none
+ *         buffer_size: the size of the two buffers
+ *         flush_interval_ms: the max interval to flush in milliseconds
+ * return 0 for success, != 0 for error
+*/
+int binary_log_init_ex(BinaryLogContext *pContext, const char *filename,
+        LogContext *text_context, const int buffer_size,
+        const int flush_interval_ms);
+
+/**
+ * flush the buffers and destroy the binary log context
+ * parameters:
+ *         pContext: the binary log context
+ * return none
+*/
+void binary_log_destroy_ex(BinaryLogContext *pContext);
+
+/**
+ * append the message record, called by the blog* macros
+ * parameters:
+ *         pContext: the binary log context
+ *         format: the format of the call site
+ *         ...: the args of the format
+ * return 0 for success, != 0 for error
+*/
+int binary_log_write(BinaryLogContext *pContext,
+        BinaryLogFormat *format, ...);
+
+/**
+ * flush the active buffer, wait for the flusher thread done
+ * parameters:
+ *         pContext: the binary log context
+ * return 0 for success, != 0 for error
+*/
+int binary_log_flush(BinaryLogContext *pContext);
+
+/**
+ * parse the arg types of the printf format
+ * parameters:
+ *         format: the printf format
+ *         arg_types: store the arg types
+ *         arg_count: store the arg count
+ * return 0 for success, != 0 for error, such as too many args
+*/
+int binary_log_parse_format(const char *format, unsigned char *arg_types,
+        int *arg_count);
+
+/**
+ * parse the arg types and the string precisions of the printf format
+ * parameters:
+ *         format: the printf format
+ *         arg_types: store the arg types
+ *         arg_precisions: store the precisions of the string args
+ *                         (%.Ns or %.*s), can be NULL
+ *         arg_count: store the arg count
+ * return 0 for success, != 0 for error, such as too many args
+*/
+int binary_log_parse_format_ex(const char *format, unsigned char *arg_types,
+        short *arg_precisions, int *arg_count);
+
+/**
+ * encode the args of the parsed format
+ * parameters:
+ *         format: the format struct with the parsed arg types
+ *         err_no: the errno for %m
+ *         ap: the args of the format
+ *         buff: the output buffer
+ *         size: the size of the output buffer
+ * return the encoded length, < 0 for the buffer overflow
+*/
+int binary_log_encode_args(const BinaryLogFormat *format,
+        const int err_no, va_list ap, char *buff, const int size);
+
+/**
+ * format the encoded args as vsnprintf
+ * parameters:
+ *         format: the format struct with the parsed arg types
+ *         args: the encoded args
+ *         args_len: the length of the encoded args
+ *         buff: the output buffer
+ *         size: the size of the output buffer
+ * return the formatted length, < 0 for the invalid args
+*/
+int binary_log_format_args(const BinaryLogFormat *format, const char *args,
+        const int args_len, char *buff, const int size);
+
+/**
+ * decode the binary log file to the normal text log format
+ * parameters:
+ *         filename: the binary log filename
+ *         text_context: the text log context to output
+ *         message_count: store the decoded message count, can be NULL
+ * return 0 for success, != 0 for error
+*/
+int binary_log_decode_file(const char *filename,
+        LogContext *text_context, int64_t *message_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -20,14 +20,49 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <sys/uio.h>
 #include "shared_func.h"
 #include "logger.h"
 #include "fc_memory.h"
+#include "pthread_func.h"
 #include "buffered_file_writer.h"
 
-int buffered_file_writer_open_ex(BufferedFileWriter *writer,
+typedef struct
+{
+    char *buff;
+    int length;
+} BufferedFileWriterBuffer;
+
+typedef struct buffered_file_writer_async
+{
+    BufferedFileWriterAsyncConfig config;
+    pthread_lock_cond_pair_t lcp;  //lcp.cond for notify the writer thread
+    pthread_cond_t done_cond;      //for notify the appenders and committers
+    pthread_t tid;
+    bool running;
+    bool writing;         //the writer thread is writing without the lock
+    int result;           //the write error, the later appends will fail
+    BufferedFileWriterBuffer *buffers;
+    int active;           //the index of the active buffer
+    int *free_stack;
+    int free_count;
+    int *queue;           //the full buffers in the append order
+    int queue_head;
+    int queue_count;
+    struct iovec *iov;
+    int64_t queued_offset;   //the bytes handed to the writer thread
+    int64_t written_offset;
+    int64_t synced_offset;
+    int64_t sync_target;     //the max offset requested by the committers
+    BufferedFileWriterStats stats;
+} BufferedFileWriterAsync;
+
+static int buffered_file_writer_sync_flush(BufferedFileWriter *writer);
+
+static int buffered_file_writer_do_open(BufferedFileWriter *writer,
         const char *filename, const int buffer_size,
-        const int max_written_once, const int mode)
+        const int max_written_once, const int mode, const int flags)
 {
     int result;
     int written_once;
@@ -50,7 +85,7 @@ int buffered_file_writer_open_ex(BufferedFileWriter *writer,
 
     snprintf(writer->filename, sizeof(writer->filename), "%s", filename);
     writer->fd = open(writer->filename, O_WRONLY |
-            O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+            O_CREAT | O_CLOEXEC | flags, mode);
     if (writer->fd < 0)
     {
         result = errno != 0 ? errno : EIO;
@@ -68,10 +103,386 @@ int buffered_file_writer_open_ex(BufferedFileWriter *writer,
     writer->current = writer->buff;
     writer->buff_end = writer->buff + writer->buffer_size;
     writer->water_mark = writer->buff_end - written_once;
+    writer->async = NULL;
+
+    return 0;
+}
+
+int buffered_file_writer_open_ex(BufferedFileWriter *writer,
+        const char *filename, const int buffer_size,
+        const int max_written_once, const int mode)
+{
+    return buffered_file_writer_do_open(writer, filename, buffer_size,
+            max_written_once, mode, O_TRUNC);
+}
+
+int buffered_file_writer_open_append(BufferedFileWriter *writer,
+        const char *filename, const int buffer_size,
+        const int max_written_once, const int mode)
+{
+    return buffered_file_writer_do_open(writer, filename, buffer_size,
+            max_written_once, mode, O_APPEND);
+}
+
+/* switch the active buffer to the queue of the writer thread,
+ * called with the lock of the async mode */
+static int buffered_file_writer_swap(BufferedFileWriter *writer,
+        const bool wait_free)
+{
+    BufferedFileWriterAsync *async;
+    int mark_offset;
+    int len;
+
+    async = writer->async;
+    while (async->free_count == 0 && writer->current > writer->buff)
+    {
+        if (async->result != 0)
+        {
+            return async->result;
+        }
+        if (!wait_free)
+        {
+            return EAGAIN;
+        }
+
+        async->stats.buffer_wait_count++;
+        pthread_cond_signal(&async->lcp.cond);
+        pthread_cond_wait(&async->done_cond, &async->lcp.lock);
+    }
+
+    //the active buffer maybe switched by others during the wait
+    if ((len=writer->current - writer->buff) == 0)
+    {
+        return 0;
+    }
+
+    async->buffers[async->active].length = len;
+    async->queue[(async->queue_head + async->queue_count) %
+        async->config.buffer_count] = async->active;
+    async->queue_count++;
+    async->queued_offset += len;
+
+    mark_offset = writer->water_mark - writer->buff;
+    async->active = async->free_stack[--async->free_count];
+    writer->buff = async->buffers[async->active].buff;
+    writer->current = writer->buff;
+    writer->buff_end = writer->buff + writer->buffer_size;
+    writer->water_mark = writer->buff + mark_offset;
+    pthread_cond_signal(&async->lcp.cond);
+    return 0;
+}
+
+static inline int buffered_file_writer_flush_buffer(
+        BufferedFileWriter *writer)
+{
+    if (writer->async != NULL)
+    {
+        return buffered_file_writer_swap(writer, true);
+    }
+    else
+    {
+        return buffered_file_writer_sync_flush(writer);
+    }
+}
+
+static inline int64_t buffered_file_writer_unsynced_bytes(
+        BufferedFileWriter *writer)
+{
+    return writer->async->queued_offset + (writer->current -
+            writer->buff) - writer->async->synced_offset;
+}
+
+/* wait for more committers to share the fdatasync */
+static void buffered_file_writer_group_commit_wait(BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+    struct timespec ts;
+    int64_t deadline;
+
+    async = writer->async;
+    if (async->config.sync_max_delay_us <= 0)
+    {
+        return;
+    }
+
+    deadline = get_current_time_us() + async->config.sync_max_delay_us;
+    while (async->running && (async->config.sync_bytes_threshold <= 0 ||
+                buffered_file_writer_unsynced_bytes(writer) <
+                async->config.sync_bytes_threshold))
+    {
+        if (get_current_time_us() >= deadline)
+        {
+            break;
+        }
+
+        ts.tv_sec = deadline / 1000000;
+        ts.tv_nsec = (deadline % 1000000) * 1000;
+        pthread_cond_timedwait(&async->lcp.cond, &async->lcp.lock, &ts);
+    }
+}
+
+static void *buffered_file_writer_thread_func(void *arg)
+{
+    BufferedFileWriter *writer;
+    BufferedFileWriterAsync *async;
+    int64_t start_time;
+    int64_t time_used;
+    int64_t bytes;
+    bool need_sync;
+    int result;
+    int count;
+    int index;
+    int i;
+
+    writer = (BufferedFileWriter *)arg;
+    async = writer->async;
+    pthread_mutex_lock(&async->lcp.lock);
+    while (1)
+    {
+        while (async->running && async->queue_count == 0 &&
+                async->sync_target <= async->synced_offset)
+        {
+            pthread_cond_wait(&async->lcp.cond, &async->lcp.lock);
+        }
+        if (!async->running && async->queue_count == 0 &&
+                async->sync_target <= async->synced_offset)
+        {
+            break;
+        }
+
+        need_sync = async->sync_target > async->synced_offset;
+        if (need_sync)
+        {
+            buffered_file_writer_group_commit_wait(writer);
+            buffered_file_writer_swap(writer, false);
+        }
+
+        bytes = 0;
+        count = async->queue_count;
+        for (i=0; i<count; i++)
+        {
+            index = async->queue[(async->queue_head + i) %
+                async->config.buffer_count];
+            async->iov[i].iov_base = async->buffers[index].buff;
+            async->iov[i].iov_len = async->buffers[index].length;
+            bytes += async->buffers[index].length;
+        }
+        async->writing = true;
+        pthread_mutex_unlock(&async->lcp.lock);
+
+        result = 0;
+        start_time = get_current_time_us();
+        if (count > 0 && fc_safe_writev(writer->fd,
+                    async->iov, count) != bytes)
+        {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "write to file %s fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    writer->filename, result, STRERROR(result));
+        }
+        if (need_sync && result == 0 && fdatasync(writer->fd) != 0)
+        {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "fdatasync file %s fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    writer->filename, result, STRERROR(result));
+        }
+        time_used = get_current_time_us() - start_time;
+
+        pthread_mutex_lock(&async->lcp.lock);
+        async->writing = false;
+        for (i=0; i<count; i++)
+        {
+            async->free_stack[async->free_count++] = async->queue[
+                async->queue_head];
+            async->queue_head = (async->queue_head + 1) %
+                async->config.buffer_count;
+        }
+        async->queue_count -= count;
+        async->written_offset += bytes;
+        if (result != 0)
+        {
+            if (async->result == 0)
+            {
+                async->result = result;
+            }
+        }
+        else if (need_sync)
+        {
+            async->synced_offset = async->written_offset;
+            async->stats.sync_count++;
+        }
+
+        if (count > 0)
+        {
+            async->stats.batch_count++;
+            async->stats.write_bytes += bytes;
+            if (bytes > async->stats.max_batch_bytes)
+            {
+                async->stats.max_batch_bytes = bytes;
+            }
+        }
+        async->stats.total_flush_us += time_used;
+        if (time_used > async->stats.max_flush_us)
+        {
+            async->stats.max_flush_us = time_used;
+        }
+        pthread_cond_broadcast(&async->done_cond);
+
+        if (async->result != 0)
+        {
+            //discard the pending data, wake up the waiters
+            async->sync_target = async->synced_offset;
+        }
+    }
+    pthread_mutex_unlock(&async->lcp.lock);
+
+    return NULL;
+}
+
+static void buffered_file_writer_free_async(BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+    int i;
+
+    async = writer->async;
+    if (async->buffers != NULL)
+    {
+        for (i=0; i<async->config.buffer_count; i++)
+        {
+            //the active buffer is freed as writer->buff
+            if (async->buffers[i].buff != writer->buff)
+            {
+                free(async->buffers[i].buff);
+            }
+        }
+        free(async->buffers);
+    }
+    if (async->free_stack != NULL)
+    {
+        free(async->free_stack);
+    }
+    if (async->queue != NULL)
+    {
+        free(async->queue);
+    }
+    if (async->iov != NULL)
+    {
+        free(async->iov);
+    }
+    free(async);
+    writer->async = NULL;
+}
+
+int buffered_file_writer_start_async(BufferedFileWriter *writer,
+        const BufferedFileWriterAsyncConfig *config)
+{
+    BufferedFileWriterAsync *async;
+    int result;
+    int i;
+
+    if (writer->buff == NULL)
+    {
+        return EINVAL;
+    }
+    if (writer->async != NULL)
+    {
+        return EEXIST;
+    }
+
+    async = (BufferedFileWriterAsync *)fc_calloc(1,
+            sizeof(BufferedFileWriterAsync));
+    if (async == NULL)
+    {
+        return ENOMEM;
+    }
+    if (config != NULL)
+    {
+        async->config = *config;
+    }
+    if (async->config.buffer_count < 2)
+    {
+        async->config.buffer_count = BUFFERED_FILE_WRITER_DEFAULT_BUFFER_COUNT;
+    }
+    writer->async = async;
+
+    async->buffers = (BufferedFileWriterBuffer *)fc_calloc(
+            async->config.buffer_count, sizeof(BufferedFileWriterBuffer));
+    async->free_stack = (int *)fc_malloc(sizeof(int) *
+            async->config.buffer_count);
+    async->queue = (int *)fc_malloc(sizeof(int) *
+            async->config.buffer_count);
+    async->iov = (struct iovec *)fc_malloc(sizeof(struct iovec) *
+            async->config.buffer_count);
+    if (async->buffers == NULL || async->free_stack == NULL ||
+            async->queue == NULL || async->iov == NULL)
+    {
+        buffered_file_writer_free_async(writer);
+        return ENOMEM;
+    }
+
+    //the current buffer with the pending data is the active one
+    async->buffers[0].buff = writer->buff;
+    async->active = 0;
+    for (i=1; i<async->config.buffer_count; i++)
+    {
+        async->buffers[i].buff = (char *)fc_malloc(writer->buffer_size);
+        if (async->buffers[i].buff == NULL)
+        {
+            buffered_file_writer_free_async(writer);
+            return ENOMEM;
+        }
+        async->free_stack[async->free_count++] = i;
+    }
+
+    if ((result=init_pthread_lock_cond_pair(&async->lcp)) != 0)
+    {
+        buffered_file_writer_free_async(writer);
+        return result;
+    }
+    if ((result=pthread_cond_init(&async->done_cond, NULL)) != 0)
+    {
+        destroy_pthread_lock_cond_pair(&async->lcp);
+        buffered_file_writer_free_async(writer);
+        return result;
+    }
+
+    async->running = true;
+    if ((result=fc_create_thread(&async->tid,
+                    buffered_file_writer_thread_func,
+                    writer, 64 * 1024)) != 0)
+    {
+        pthread_cond_destroy(&async->done_cond);
+        destroy_pthread_lock_cond_pair(&async->lcp);
+        buffered_file_writer_free_async(writer);
+        return result;
+    }
 
     return 0;
 }
 
+static int buffered_file_writer_stop_async(BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+    int result;
+
+    async = writer->async;
+    pthread_mutex_lock(&async->lcp.lock);
+    buffered_file_writer_swap(writer, true);
+    async->running = false;
+    pthread_cond_signal(&async->lcp.cond);
+    pthread_mutex_unlock(&async->lcp.lock);
+    pthread_join(async->tid, NULL);
+
+    result = async->result;
+    pthread_cond_destroy(&async->done_cond);
+    destroy_pthread_lock_cond_pair(&async->lcp);
+    buffered_file_writer_free_async(writer);
+    return result;
+}
+
 int buffered_file_writer_close(BufferedFileWriter *writer)
 {
     int result;
@@ -81,7 +492,14 @@ int buffered_file_writer_close(BufferedFileWriter *writer)
         return EINVAL;
     }
 
-    result = buffered_file_writer_flush(writer);
+    if (writer->async != NULL)
+    {
+        result = buffered_file_writer_stop_async(writer);
+    }
+    else
+    {
+        result = buffered_file_writer_sync_flush(writer);
+    }
     if (result == 0 && fsync(writer->fd) != 0)
     {
         result = errno != 0 ? errno : EIO;
@@ -111,7 +529,7 @@ int buffered_file_writer_close(BufferedFileWriter *writer)
     return result;
 }
 
-int buffered_file_writer_flush(BufferedFileWriter *writer)
+static int buffered_file_writer_sync_flush(BufferedFileWriter *writer)
 {
     int result;
     int len;
@@ -136,6 +554,110 @@ int buffered_file_writer_flush(BufferedFileWriter *writer)
     return 0;
 }
 
+int buffered_file_writer_flush(BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+    int64_t target;
+    int result;
+
+    if ((async=writer->async) == NULL)
+    {
+        return buffered_file_writer_sync_flush(writer);
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    if ((result=buffered_file_writer_swap(writer, true)) == 0)
+    {
+        target = async->queued_offset;
+        while (async->written_offset < target &&
+                (result=async->result) == 0)
+        {
+            pthread_cond_wait(&async->done_cond, &async->lcp.lock);
+        }
+    }
+    pthread_mutex_unlock(&async->lcp.lock);
+    return result;
+}
+
+int buffered_file_writer_commit(BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+    int64_t target;
+    int result;
+
+    if ((async=writer->async) == NULL)
+    {
+        if ((result=buffered_file_writer_sync_flush(writer)) != 0)
+        {
+            return result;
+        }
+        if (fdatasync(writer->fd) != 0)
+        {
+            result = errno != 0 ? errno : EIO;
+            logError("file: "__FILE__", line: %d, "
+                    "fdatasync file %s fail, "
+                    "errno: %d, error info: %s", __LINE__,
+                    writer->filename, result, STRERROR(result));
+            return result;
+        }
+        return 0;
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    if ((result=async->result) == 0)
+    {
+        target = async->queued_offset + (writer->current - writer->buff);
+        if (target > async->synced_offset)
+        {
+            if (target > async->sync_target)
+            {
+                async->sync_target = target;
+            }
+            async->stats.commit_count++;
+            pthread_cond_signal(&async->lcp.cond);
+            while (async->synced_offset < target &&
+                    (result=async->result) == 0)
+            {
+                pthread_cond_wait(&async->done_cond, &async->lcp.lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&async->lcp.lock);
+    return result;
+}
+
+int buffered_file_writer_get_stats(BufferedFileWriter *writer,
+        BufferedFileWriterStats *stats)
+{
+    BufferedFileWriterAsync *async;
+
+    if ((async=writer->async) == NULL)
+    {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    *stats = async->stats;
+    pthread_mutex_unlock(&async->lcp.lock);
+    return 0;
+}
+
+/* notify the writer thread when the group commit reaches the threshold */
+static inline void buffered_file_writer_check_notify(
+        BufferedFileWriter *writer)
+{
+    BufferedFileWriterAsync *async;
+
+    async = writer->async;
+    if (async->sync_target > async->synced_offset &&
+            async->config.sync_bytes_threshold > 0 &&
+            buffered_file_writer_unsynced_bytes(writer) >=
+            async->config.sync_bytes_threshold)
+    {
+        pthread_cond_signal(&async->lcp.cond);
+    }
+}
+
 int buffered_file_writer_append(BufferedFileWriter *writer,
         const char *format, ...)
 {
@@ -145,6 +667,16 @@ int buffered_file_writer_append(BufferedFileWriter *writer,
     int len;
     int i;
 
+    if (writer->async != NULL)
+    {
+        pthread_mutex_lock(&writer->async->lcp.lock);
+        if ((result=writer->async->result) != 0)
+        {
+            pthread_mutex_unlock(&writer->async->lcp.lock);
+            return result;
+        }
+    }
+
     result = 0;
     for (i=0; i<2; i++)
     {
@@ -158,7 +690,7 @@ int buffered_file_writer_append(BufferedFileWriter *writer,
             writer->current += len;
             if (writer->current > writer->water_mark)
             {
-                result = buffered_file_writer_flush(writer);
+                result = buffered_file_writer_flush_buffer(writer);
             }
 
             break;
@@ -174,23 +706,107 @@ int buffered_file_writer_append(BufferedFileWriter *writer,
         }
 
         //maybe full, try again
-        if ((result=buffered_file_writer_flush(writer)) != 0)
+        if ((result=buffered_file_writer_flush_buffer(writer)) != 0)
         {
             break;
         }
     }
 
+    if (writer->async != NULL)
+    {
+        buffered_file_writer_check_notify(writer);
+        pthread_mutex_unlock(&writer->async->lcp.lock);
+    }
     return result;
 }
 
+/* write the large buffer directly after the writer thread is idle */
+static int buffered_file_writer_async_write_large(
+        BufferedFileWriter *writer, const char *buff, const int len)
+{
+    BufferedFileWriterAsync *async;
+    int result;
+
+    async = writer->async;
+    if ((result=buffered_file_writer_swap(writer, true)) != 0)
+    {
+        return result;
+    }
+    while ((async->queue_count > 0 || async->writing) &&
+            (result=async->result) == 0)
+    {
+        pthread_cond_signal(&async->lcp.cond);
+        pthread_cond_wait(&async->done_cond, &async->lcp.lock);
+    }
+    if (result != 0)
+    {
+        return result;
+    }
+
+    if (fc_safe_write(writer->fd, buff, len) != len)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write to file %s fail, "
+                "errno: %d, error info: %s", __LINE__,
+                writer->filename, result, STRERROR(result));
+        async->result = result;
+        return result;
+    }
+    async->queued_offset += len;
+    async->written_offset += len;
+    return 0;
+}
+
+static int buffered_file_writer_async_append_buff(
+        BufferedFileWriter *writer, const char *buff, const int len)
+{
+    int result;
+
+    if (len > writer->buffer_size)
+    {
+        return buffered_file_writer_async_write_large(writer, buff, len);
+    }
+
+    //the record is not split to two buffers
+    while (writer->buff_end - writer->current < len)
+    {
+        if ((result=buffered_file_writer_swap(writer, true)) != 0)
+        {
+            return result;
+        }
+    }
+
+    memcpy(writer->current, buff, len);
+    writer->current += len;
+    if (writer->current > writer->water_mark)
+    {
+        return buffered_file_writer_swap(writer, true);
+    }
+    return 0;
+}
+
 int buffered_file_writer_append_buff(BufferedFileWriter *writer,
         const char *buff, const int len)
 {
     int result;
 
+    if (writer->async != NULL)
+    {
+        pthread_mutex_lock(&writer->async->lcp.lock);
+        if ((result=writer->async->result) == 0)
+        {
+            result = buffered_file_writer_async_append_buff(
+                    writer, buff, len);
+            buffered_file_writer_check_notify(writer);
+        }
+        pthread_mutex_unlock(&writer->async->lcp.lock);
+        return result;
+    }
+
     if (len >= writer->water_mark - writer->current)
     {
-        if ((result=buffered_file_writer_flush(writer)) != 0)
+        if ((result=buffered_file_writer_sync_flush(writer)) != 0)
         {
             return result;
         }
@@ -18,6 +18,31 @@
 
 #include "common_define.h"
 
+#define BUFFERED_FILE_WRITER_DEFAULT_BUFFER_COUNT  2
+
+typedef struct
+{
+    int buffer_count;       //the buffers to swap, >= 2
+    int sync_max_delay_us;  //the max delay of the group commit to wait
+                            //for more committers, 0 for no wait
+    int sync_bytes_threshold;  //sync without delay when the unsynced bytes
+                               //reach the threshold, 0 for no threshold
+} BufferedFileWriterAsyncConfig;
+
+typedef struct
+{
+    int64_t batch_count;      //the write batches of the writer thread
+    int64_t write_bytes;
+    int64_t max_batch_bytes;
+    int64_t sync_count;       //the fdatasync count
+    int64_t commit_count;     //the commits waiting for the fdatasync
+    int64_t total_flush_us;   //the total time of the write and fdatasync
+    int64_t max_flush_us;
+    int64_t buffer_wait_count;  //the appends waiting for the free buffer
+} BufferedFileWriterStats;
+
+struct buffered_file_writer_async;
+
 typedef struct
 {
     int fd;
@@ -27,6 +52,7 @@ typedef struct
     char *current;
     char *buff_end;
     char *water_mark;
+    struct buffered_file_writer_async *async;  //NULL for the sync mode
 } BufferedFileWriter;
 
 #ifdef __cplusplus
@@ -46,6 +72,19 @@ int buffered_file_writer_open_ex(BufferedFileWriter *writer,
         const char *filename, const int buffer_size,
         const int max_written_once, const int mode);
 
+/** open buffered file writer to append to the file, not truncate
+ *  parameters:
+ *         writer: the writer
+ *         filename: the filename to write
+ *         buffer_size: the buffer size, <= 0 for recommend 64KB
+ *         max_written_once: max written bytes per call, <= 0 for 256
+ *         mode: the file privilege such as 0644
+ *  return: error code, 0 for success, != 0 for errno
+ */
+int buffered_file_writer_open_append(BufferedFileWriter *writer,
+        const char *filename, const int buffer_size,
+        const int max_written_once, const int mode);
+
 static inline int buffered_file_writer_open(BufferedFileWriter *writer,
         const char *filename)
 {
@@ -69,8 +108,43 @@ int buffered_file_writer_append(BufferedFileWriter *writer,
 int buffered_file_writer_append_buff(BufferedFileWriter *writer,
         const char *buff, const int len);
 
+/** flush the buffer, in the async mode wait for the buffers written
+ *  by the writer thread
+ * parameters:
+ *         writer: the writer
+ *  return: error code, 0 for success, != 0 for errno
+ */
 int buffered_file_writer_flush(BufferedFileWriter *writer);
 
+/** switch to the async mode: the appenders fill the active buffer under
+ *  the lock and the full buffers are written by the writer thread,
+ *  the appends and the commits are thread safe in the async mode
+ * parameters:
+ *         writer: the opened writer
+ *         config: the async config, NULL for the default
+ *  return: error code, 0 for success, != 0 for errno
+ */
+int buffered_file_writer_start_async(BufferedFileWriter *writer,
+        const BufferedFileWriterAsyncConfig *config);
+
+/** wait for the data appended before the call durable (group commit):
+ *  the concurrent committers share one fdatasync of the writer thread.
+ *  in the sync mode flush and fdatasync directly
+ * parameters:
+ *         writer: the writer
+ *  return: error code, 0 for success, != 0 for errno
+ */
+int buffered_file_writer_commit(BufferedFileWriter *writer);
+
+/** get the stats of the async mode
+ * parameters:
+ *         writer: the writer
+ *         stats: store the stats
+ *  return: error code, 0 for success, ENOENT for the sync mode
+ */
+int buffered_file_writer_get_stats(BufferedFileWriter *writer,
+        BufferedFileWriterStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
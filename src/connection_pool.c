@@ -222,7 +222,7 @@ int conn_pool_connect_server_ex1(ConnectionInfo *conn,
 	{
         if (log_connect_error)
         {
-            logError("file: "__FILE__", line: %d, "
+            logErrorRL(10, "file: "__FILE__", line: %d, "
                     "connect to %s%sserver %s:%u fail, errno: %d, "
                     "error info: %s", __LINE__, service_name != NULL ?
                     service_name : "", service_name != NULL ?  " " : "",
@@ -322,7 +322,7 @@ static ConnectionInfo *get_connection(ConnectionPool *cp,
 				(cm->total_count >= cp->max_count_per_entry))
 			{
 				*err_no = ENOSPC;
-				logError("file: "__FILE__", line: %d, "
+				logErrorRL(10, "file: "__FILE__", line: %d, "
 					"connections: %d of %s%sserver %s:%u exceed limit: %d",
                     __LINE__, cm->total_count, service_name != NULL ?
                     service_name : "", service_name != NULL ? " " : "",
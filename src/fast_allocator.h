@@ -191,6 +191,13 @@ static inline int fast_allocator_alloc_string(struct fast_allocator_context
     return fast_allocator_alloc_string_ex(acontext, dest, src->str, src->len);
 }
 
+/* the real bytes of the allocated object, including the wrapper */
+static inline int fast_allocator_alloc_size(const void *obj)
+{
+    return ((const struct fast_allocator_wrapper *)((const char *)obj -
+                sizeof(struct fast_allocator_wrapper)))->alloc_bytes;
+}
+
 static inline int64_t fast_allocator_avail_memory(
         struct fast_allocator_context *acontext)
 {
@@ -417,13 +417,10 @@ static int fast_mblock_prealloc(struct fast_mblock_man *mblock)
             mblock->info.element_total_count;
         if (avail_count <= 0)
         {
-            if (FC_LOG_BY_LEVEL(mblock->alloc_elements.exceed_log_level))
-            {
-                log_it_ex(&g_log_context, mblock->alloc_elements.
-                        exceed_log_level, "file: "__FILE__", line: %d, "
-                        "allocated elements exceed limit: %"PRId64,
-                        __LINE__, mblock->alloc_elements.limit);
-            }
+            log_rate_limit_ex(&g_log_context, mblock->alloc_elements.
+                    exceed_log_level, 1, 10, 0, "file: "__FILE__", line: %d, "
+                    "allocated elements exceed limit: %"PRId64,
+                    __LINE__, mblock->alloc_elements.limit);
             return EOVERFLOW;
         }
 
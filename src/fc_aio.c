@@ -0,0 +1,829 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_aio.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "pthread_func.h"
+#include "fc_memory.h"
+#include "fc_queue.h"
+#include "fc_aio.h"
+
+#ifdef OS_LINUX
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+//IORING_OP_READ and IORING_OP_FALLOCATE since Linux 5.6
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define FC_AIO_USE_URING  1
+#endif
+#endif
+
+#define FC_AIO_MAX_RW_ONCE  (1024 * 1024 * 1024)
+
+#ifdef FC_AIO_USE_URING
+typedef struct fc_aio_uring {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned cq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+} FCAIOUring;
+#endif
+
+typedef struct fc_aio_context {
+#ifdef FC_AIO_USE_URING
+    FCAIOUring uring;
+    pthread_mutex_t sq_lock;
+    pthread_mutex_t cq_lock;
+    struct fc_queue_info pending;  //wait for the room, protected by sq_lock
+    unsigned ring_inflight;        //protected by sq_lock
+#endif
+    int notify_write_fd;           //the same as notify_fd for eventfd
+
+    struct {
+        struct fc_queue submit_queue;
+        struct fc_queue done_queue;
+        pthread_t *tids;
+        int count;
+        volatile bool running;
+    } threads;
+} FCAIOContext;
+
+static inline void fc_aio_notify(FCAIOContext *ctx)
+{
+    int64_t n;
+
+    n = 1;
+    if (write(ctx->notify_write_fd, &n, sizeof(n)) != sizeof(n)) {
+        if (errno != EAGAIN) {
+            logError("file: "__FILE__", line: %d, "
+                    "write to fd %d fail, errno: %d, error info: %s",
+                    __LINE__, ctx->notify_write_fd, errno, STRERROR(errno));
+        }
+    }
+}
+
+static inline void fc_aio_clear_notify(FCAIOEngine *engine)
+{
+    char buff[64];
+
+    while (read(engine->notify_fd, buff, sizeof(buff)) > 0) {
+#ifdef OS_LINUX
+        break;   //the eventfd is cleared by one read
+#endif
+    }
+}
+
+/* return true when the request is done */
+static bool fc_aio_rw_done(FCAIORequest *req, const int64_t res)
+{
+    if (res < 0) {
+        req->result = -1 * res;
+        return true;
+    }
+
+    req->bytes += res;
+    if (req->bytes >= req->length) {
+        req->result = 0;
+        return true;
+    }
+
+    if (res == 0) {  //the end of the file
+        req->result = (req->op == FC_AIO_OP_WRITE) ? EIO : 0;
+        return true;
+    }
+    return false;
+}
+
+static void fc_aio_do_sync_io(FCAIORequest *req)
+{
+    int64_t bytes;
+    int64_t res;
+
+    switch (req->op) {
+        case FC_AIO_OP_READ:
+        case FC_AIO_OP_WRITE:
+            do {
+                bytes = req->length - req->bytes;
+                if (bytes > FC_AIO_MAX_RW_ONCE) {
+                    bytes = FC_AIO_MAX_RW_ONCE;
+                }
+                if (req->op == FC_AIO_OP_READ) {
+                    res = pread(req->fd, req->buff + req->bytes,
+                            bytes, req->offset + req->bytes);
+                } else {
+                    res = pwrite(req->fd, req->buff + req->bytes,
+                            bytes, req->offset + req->bytes);
+                }
+                if (res < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    res = -1 * (errno != 0 ? errno : EIO);
+                }
+            } while (!fc_aio_rw_done(req, res));
+            break;
+        case FC_AIO_OP_FSYNC:
+            req->result = fsync(req->fd) == 0 ? 0 :
+                (errno != 0 ? errno : EIO);
+            break;
+        case FC_AIO_OP_FDATASYNC:
+            req->result = fdatasync(req->fd) == 0 ? 0 :
+                (errno != 0 ? errno : EIO);
+            break;
+        case FC_AIO_OP_FALLOCATE:
+#ifdef OS_LINUX
+            req->result = fallocate(req->fd, req->mode, req->offset,
+                    req->length) == 0 ? 0 : (errno != 0 ? errno : EIO);
+#else
+            req->result = (req->mode == 0) ? posix_fallocate(req->fd,
+                    req->offset, req->length) : EOPNOTSUPP;
+#endif
+            break;
+        default:
+            req->result = EINVAL;
+            break;
+    }
+}
+
+static void *fc_aio_thread_func(void *arg)
+{
+    FCAIOEngine *engine;
+    FCAIOContext *ctx;
+    FCAIORequest *req;
+
+    engine = (FCAIOEngine *)arg;
+    ctx = engine->ctx;
+    while (ctx->threads.running) {
+        req = (FCAIORequest *)fc_queue_timedpop_ms(
+                &ctx->threads.submit_queue, 100);
+        if (req == NULL) {
+            continue;
+        }
+
+        fc_aio_do_sync_io(req);
+        fc_queue_push_silence(&ctx->threads.done_queue, req);
+        fc_aio_notify(ctx);
+    }
+    return NULL;
+}
+
+static int fc_aio_threads_init(FCAIOEngine *engine, const int thread_count)
+{
+    FCAIOContext *ctx;
+    int result;
+    int i;
+
+    ctx = engine->ctx;
+    if ((result=fc_queue_init(&ctx->threads.submit_queue, (long)
+                    (&((FCAIORequest *)NULL)->next))) != 0)
+    {
+        return result;
+    }
+    if ((result=fc_queue_init(&ctx->threads.done_queue, (long)
+                    (&((FCAIORequest *)NULL)->next))) != 0)
+    {
+        return result;
+    }
+
+    ctx->threads.tids = (pthread_t *)fc_malloc(
+            sizeof(pthread_t) * thread_count);
+    if (ctx->threads.tids == NULL) {
+        return ENOMEM;
+    }
+
+    ctx->threads.running = true;
+    for (i=0; i<thread_count; i++) {
+        if ((result=pthread_create(ctx->threads.tids + i, NULL,
+                        fc_aio_thread_func, engine)) != 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "create thread fail, errno: %d, error info: %s",
+                    __LINE__, result, STRERROR(result));
+            break;
+        }
+        ctx->threads.count++;
+    }
+    return ctx->threads.count > 0 ? 0 : result;
+}
+
+static void fc_aio_threads_destroy(FCAIOEngine *engine)
+{
+    FCAIOContext *ctx;
+    int i;
+
+    ctx = engine->ctx;
+    ctx->threads.running = false;
+    fc_queue_terminate_all(&ctx->threads.submit_queue, ctx->threads.count);
+    for (i=0; i<ctx->threads.count; i++) {
+        pthread_join(ctx->threads.tids[i], NULL);
+    }
+    if (ctx->threads.tids != NULL) {
+        free(ctx->threads.tids);
+        ctx->threads.tids = NULL;
+    }
+    ctx->threads.count = 0;
+    fc_queue_destroy(&ctx->threads.submit_queue);
+    fc_queue_destroy(&ctx->threads.done_queue);
+}
+
+static int fc_aio_threads_reap(FCAIOEngine *engine)
+{
+    FCAIORequest *req;
+    FCAIORequest *next;
+    int count;
+
+    count = 0;
+    req = (FCAIORequest *)fc_queue_try_pop_all(
+            &engine->ctx->threads.done_queue);
+    while (req != NULL) {
+        next = req->next;   //the request maybe reused by the callback
+        __sync_sub_and_fetch(&engine->inflight, 1);
+        req->callback(req);
+        req = next;
+        count++;
+    }
+    return count;
+}
+
+#ifdef FC_AIO_USE_URING
+static inline void fc_aio_append(struct fc_queue_info *qinfo,
+        FCAIORequest *req)
+{
+    req->next = NULL;
+    if (qinfo->tail == NULL) {
+        qinfo->head = req;
+    } else {
+        ((FCAIORequest *)qinfo->tail)->next = req;
+    }
+    qinfo->tail = req;
+}
+
+static inline int fc_aio_uring_setup(unsigned entries,
+        struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int fc_aio_uring_enter(int ring_fd, unsigned to_submit,
+        unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit,
+            min_complete, flags, NULL, 0);
+}
+
+static inline int fc_aio_uring_register(int ring_fd, unsigned opcode,
+        void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static bool fc_aio_uring_probe(FCAIOUring *uring)
+{
+    const int ops[] = {IORING_OP_READ, IORING_OP_WRITE,
+        IORING_OP_FSYNC, IORING_OP_FALLOCATE};
+    struct io_uring_probe *probe;
+    bool supported;
+    int i;
+
+    probe = (struct io_uring_probe *)fc_calloc(1, sizeof(*probe) +
+            256 * sizeof(struct io_uring_probe_op));
+    if (probe == NULL) {
+        return false;
+    }
+
+    supported = (fc_aio_uring_register(uring->ring_fd,
+                IORING_REGISTER_PROBE, probe, 256) == 0);
+    for (i=0; supported && i<sizeof(ops)/sizeof(ops[0]); i++) {
+        supported = (ops[i] <= probe->last_op && (probe->ops[ops[i]].
+                    flags & IO_URING_OP_SUPPORTED) != 0);
+    }
+    free(probe);
+    return supported;
+}
+
+static void fc_aio_uring_destroy(FCAIOUring *uring)
+{
+    if (uring->sqes != NULL) {
+        munmap(uring->sqes, uring->sqes_size);
+        uring->sqes = NULL;
+    }
+    if (uring->cq_ptr != NULL && uring->cq_ptr != uring->sq_ptr) {
+        munmap(uring->cq_ptr, uring->cq_size);
+    }
+    uring->cq_ptr = NULL;
+    if (uring->sq_ptr != NULL) {
+        munmap(uring->sq_ptr, uring->sq_size);
+        uring->sq_ptr = NULL;
+    }
+    if (uring->ring_fd >= 0) {
+        close(uring->ring_fd);
+        uring->ring_fd = -1;
+    }
+}
+
+/* return 0 for success, EOPNOTSUPP for the fallback */
+static int fc_aio_uring_init(FCAIOEngine *engine, const int queue_depth)
+{
+    FCAIOUring *uring;
+    struct io_uring_params params;
+
+    uring = &engine->ctx->uring;
+    memset(&params, 0, sizeof(params));
+    if ((uring->ring_fd=fc_aio_uring_setup(queue_depth, &params)) < 0) {
+        uring->ring_fd = -1;
+        return EOPNOTSUPP;
+    }
+
+    uring->sq_entries = params.sq_entries;
+    uring->cq_entries = params.cq_entries;
+    uring->sq_size = params.sq_off.array + params.sq_entries *
+        sizeof(unsigned);
+    uring->cq_size = params.cq_off.cqes + params.cq_entries *
+        sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        if (uring->cq_size > uring->sq_size) {
+            uring->sq_size = uring->cq_size;
+        }
+        uring->cq_size = uring->sq_size;
+    }
+
+    uring->sq_ptr = mmap(NULL, uring->sq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+    if (uring->sq_ptr == MAP_FAILED) {
+        uring->sq_ptr = NULL;
+        fc_aio_uring_destroy(uring);
+        return EOPNOTSUPP;
+    }
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        uring->cq_ptr = uring->sq_ptr;
+    } else {
+        uring->cq_ptr = mmap(NULL, uring->cq_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, uring->ring_fd,
+                IORING_OFF_CQ_RING);
+        if (uring->cq_ptr == MAP_FAILED) {
+            uring->cq_ptr = NULL;
+            fc_aio_uring_destroy(uring);
+            return EOPNOTSUPP;
+        }
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = (struct io_uring_sqe *)mmap(NULL, uring->sqes_size,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            uring->ring_fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) {
+        uring->sqes = NULL;
+        fc_aio_uring_destroy(uring);
+        return EOPNOTSUPP;
+    }
+
+    uring->sq_head = (unsigned *)((char *)uring->sq_ptr +
+            params.sq_off.head);
+    uring->sq_tail = (unsigned *)((char *)uring->sq_ptr +
+            params.sq_off.tail);
+    uring->sq_mask = (unsigned *)((char *)uring->sq_ptr +
+            params.sq_off.ring_mask);
+    uring->sq_array = (unsigned *)((char *)uring->sq_ptr +
+            params.sq_off.array);
+    uring->cq_head = (unsigned *)((char *)uring->cq_ptr +
+            params.cq_off.head);
+    uring->cq_tail = (unsigned *)((char *)uring->cq_ptr +
+            params.cq_off.tail);
+    uring->cq_mask = (unsigned *)((char *)uring->cq_ptr +
+            params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ptr +
+            params.cq_off.cqes);
+
+    if (!fc_aio_uring_probe(uring) || fc_aio_uring_register(
+                uring->ring_fd, IORING_REGISTER_EVENTFD,
+                &engine->notify_fd, 1) != 0)
+    {
+        fc_aio_uring_destroy(uring);
+        return EOPNOTSUPP;
+    }
+    return 0;
+}
+
+static void fc_aio_uring_fill_sqe(struct io_uring_sqe *sqe,
+        FCAIORequest *req)
+{
+    int64_t bytes;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    sqe->user_data = (unsigned long)req;
+    switch (req->op) {
+        case FC_AIO_OP_READ:
+        case FC_AIO_OP_WRITE:
+            bytes = req->length - req->bytes;
+            if (bytes > FC_AIO_MAX_RW_ONCE) {
+                bytes = FC_AIO_MAX_RW_ONCE;
+            }
+            sqe->opcode = (req->op == FC_AIO_OP_READ) ?
+                IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (unsigned long)(req->buff + req->bytes);
+            sqe->len = bytes;
+            sqe->off = req->offset + req->bytes;
+            break;
+        case FC_AIO_OP_FSYNC:
+        case FC_AIO_OP_FDATASYNC:
+            sqe->opcode = IORING_OP_FSYNC;
+            if (req->op == FC_AIO_OP_FDATASYNC) {
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            }
+            break;
+        case FC_AIO_OP_FALLOCATE:
+            sqe->opcode = IORING_OP_FALLOCATE;
+            sqe->off = req->offset;
+            sqe->addr = req->length;
+            sqe->len = req->mode;
+            break;
+    }
+}
+
+/* submit the queued SQEs to the kernel, called with the sq_lock */
+static void fc_aio_uring_flush(FCAIOUring *uring)
+{
+    unsigned to_submit;
+    int result;
+
+    while ((to_submit=*uring->sq_tail - __atomic_load_n(
+                    uring->sq_head, __ATOMIC_ACQUIRE)) > 0)
+    {
+        if (fc_aio_uring_enter(uring->ring_fd, to_submit, 0, 0) >= 0) {
+            continue;
+        }
+
+        result = errno != 0 ? errno : EIO;
+        if (result == EINTR) {
+            continue;
+        }
+        if (result != EAGAIN && result != EBUSY) {
+            logError("file: "__FILE__", line: %d, "
+                    "io_uring_enter fail, errno: %d, error info: %s",
+                    __LINE__, result, STRERROR(result));
+        }
+        break;   //retry by the next submit or reap
+    }
+}
+
+/* queue the request to the ring, called with the sq_lock.
+ * return false when no room */
+static bool fc_aio_uring_queue(FCAIOContext *ctx, FCAIORequest *req)
+{
+    FCAIOUring *uring;
+    unsigned tail;
+    unsigned index;
+
+    uring = &ctx->uring;
+    if (ctx->ring_inflight >= uring->cq_entries) {
+        return false;
+    }
+
+    tail = *uring->sq_tail;
+    if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >=
+            uring->sq_entries)
+    {
+        fc_aio_uring_flush(uring);
+        if (tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE) >=
+                uring->sq_entries)
+        {
+            return false;
+        }
+    }
+
+    index = tail & *uring->sq_mask;
+    fc_aio_uring_fill_sqe(uring->sqes + index, req);
+    uring->sq_array[index] = index;
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ctx->ring_inflight++;
+    return true;
+}
+
+static void fc_aio_uring_submit(FCAIOContext *ctx, FCAIORequest *req)
+{
+    PTHREAD_MUTEX_LOCK(&ctx->sq_lock);
+    //keep the order when some requests are pending
+    if (ctx->pending.head != NULL || !fc_aio_uring_queue(ctx, req)) {
+        fc_aio_append(&ctx->pending, req);
+    } else {
+        fc_aio_uring_flush(&ctx->uring);
+    }
+    PTHREAD_MUTEX_UNLOCK(&ctx->sq_lock);
+}
+
+static int fc_aio_uring_reap(FCAIOEngine *engine)
+{
+    FCAIOContext *ctx;
+    FCAIOUring *uring;
+    struct io_uring_cqe *cqe;
+    struct fc_queue_info done;
+    struct fc_queue_info retry;
+    FCAIORequest *req;
+    FCAIORequest *next;
+    unsigned head;
+    unsigned tail;
+    unsigned reaped;
+    int count;
+
+    ctx = engine->ctx;
+    uring = &ctx->uring;
+    done.head = done.tail = NULL;
+    retry.head = retry.tail = NULL;
+
+    PTHREAD_MUTEX_LOCK(&ctx->cq_lock);
+    head = *uring->cq_head;
+    tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    reaped = tail - head;
+    for (; head != tail; head++) {
+        cqe = uring->cqes + (head & *uring->cq_mask);
+        req = (FCAIORequest *)(unsigned long)cqe->user_data;
+        if (req->op == FC_AIO_OP_READ || req->op == FC_AIO_OP_WRITE) {
+            if (fc_aio_rw_done(req, cqe->res)) {
+                fc_aio_append(&done, req);
+            } else {
+                fc_aio_append(&retry, req);
+            }
+        } else {
+            req->result = (cqe->res < 0) ? -1 * cqe->res : 0;
+            fc_aio_append(&done, req);
+        }
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    PTHREAD_MUTEX_UNLOCK(&ctx->cq_lock);
+
+    if (reaped > 0 || ctx->pending.head != NULL) {
+        PTHREAD_MUTEX_LOCK(&ctx->sq_lock);
+        ctx->ring_inflight -= reaped;
+
+        //the partial read / write first
+        for (req=(FCAIORequest *)retry.head; req!=NULL; req=next) {
+            next = req->next;
+            if (!fc_aio_uring_queue(ctx, req)) {
+                fc_aio_append(&ctx->pending, req);
+            }
+        }
+        while ((req=(FCAIORequest *)ctx->pending.head) != NULL &&
+                fc_aio_uring_queue(ctx, req))
+        {
+            ctx->pending.head = req->next;
+            if (ctx->pending.head == NULL) {
+                ctx->pending.tail = NULL;
+            }
+        }
+        fc_aio_uring_flush(uring);
+        PTHREAD_MUTEX_UNLOCK(&ctx->sq_lock);
+    }
+
+    count = 0;
+    for (req=(FCAIORequest *)done.head; req!=NULL; req=next) {
+        next = req->next;   //the request maybe reused by the callback
+        __sync_sub_and_fetch(&engine->inflight, 1);
+        req->callback(req);
+        count++;
+    }
+    return count;
+}
+#endif
+
+static int fc_aio_init_notify(FCAIOEngine *engine)
+{
+    int result;
+#ifdef OS_LINUX
+    if ((engine->notify_fd=eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : EMFILE;
+        logError("file: "__FILE__", line: %d, "
+                "eventfd fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+    engine->ctx->notify_write_fd = engine->notify_fd;
+#else
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        result = errno != 0 ? errno : EMFILE;
+        logError("file: "__FILE__", line: %d, "
+                "pipe fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+    engine->notify_fd = fds[0];
+    engine->ctx->notify_write_fd = fds[1];
+    fd_add_flags(fds[0], O_NONBLOCK);
+    fd_add_flags(fds[1], O_NONBLOCK);
+#endif
+    return 0;
+}
+
+int fc_aio_init(FCAIOEngine *engine, const FCAIOConfig *config)
+{
+    FCAIOConfig default_config;
+    int result;
+
+    memset(engine, 0, sizeof(FCAIOEngine));
+    engine->notify_fd = -1;
+    if (config == NULL) {
+        memset(&default_config, 0, sizeof(default_config));
+        config = &default_config;
+    }
+
+    engine->ctx = (FCAIOContext *)fc_calloc(1, sizeof(FCAIOContext));
+    if (engine->ctx == NULL) {
+        return ENOMEM;
+    }
+    engine->ctx->notify_write_fd = -1;
+    if ((result=fc_aio_init_notify(engine)) != 0) {
+        fc_aio_destroy(engine);
+        return result;
+    }
+
+#ifdef FC_AIO_USE_URING
+    engine->ctx->uring.ring_fd = -1;
+    if (!config->disable_uring && fc_aio_uring_init(engine,
+                config->queue_depth > 0 ? config->queue_depth :
+                FC_AIO_DEFAULT_QUEUE_DEPTH) == 0)
+    {
+        if ((result=init_pthread_lock(&engine->ctx->sq_lock)) != 0 ||
+                (result=init_pthread_lock(&engine->ctx->cq_lock)) != 0)
+        {
+            fc_aio_destroy(engine);
+            return result;
+        }
+        engine->mode = FC_AIO_MODE_URING;
+        return 0;
+    }
+#endif
+
+    engine->mode = FC_AIO_MODE_THREADS;
+    if ((result=fc_aio_threads_init(engine, config->thread_count > 0 ?
+                    config->thread_count : FC_AIO_DEFAULT_THREAD_COUNT)) != 0)
+    {
+        fc_aio_destroy(engine);
+        return result;
+    }
+    return 0;
+}
+
+void fc_aio_destroy(FCAIOEngine *engine)
+{
+    if (engine->ctx == NULL) {
+        return;
+    }
+
+    while (__sync_add_and_fetch(&engine->inflight, 0) > 0) {
+        fc_aio_wait(engine, 100);
+    }
+
+#ifdef FC_AIO_USE_URING
+    if (engine->mode == FC_AIO_MODE_URING) {
+        fc_aio_uring_destroy(&engine->ctx->uring);
+        pthread_mutex_destroy(&engine->ctx->sq_lock);
+        pthread_mutex_destroy(&engine->ctx->cq_lock);
+    }
+#endif
+    if (engine->mode == FC_AIO_MODE_THREADS) {
+        fc_aio_threads_destroy(engine);
+    }
+
+    if (engine->notify_fd >= 0) {
+        if (engine->ctx->notify_write_fd != engine->notify_fd) {
+            close(engine->ctx->notify_write_fd);
+        }
+        close(engine->notify_fd);
+        engine->notify_fd = -1;
+    }
+    free(engine->ctx);
+    engine->ctx = NULL;
+    engine->mode = 0;
+}
+
+int fc_aio_submit(FCAIOEngine *engine, FCAIORequest *req)
+{
+    if (req->op < FC_AIO_OP_READ || req->op > FC_AIO_OP_FALLOCATE ||
+            req->callback == NULL || ((req->op == FC_AIO_OP_READ ||
+                    req->op == FC_AIO_OP_WRITE) && req->buff == NULL))
+    {
+        return EINVAL;
+    }
+
+    req->result = 0;
+    req->bytes = 0;
+    req->next = NULL;
+    __sync_add_and_fetch(&engine->inflight, 1);
+#ifdef FC_AIO_USE_URING
+    if (engine->mode == FC_AIO_MODE_URING) {
+        fc_aio_uring_submit(engine->ctx, req);
+        return 0;
+    }
+#endif
+
+    fc_queue_push(&engine->ctx->threads.submit_queue, req);
+    return 0;
+}
+
+int fc_aio_reap(FCAIOEngine *engine)
+{
+    fc_aio_clear_notify(engine);
+#ifdef FC_AIO_USE_URING
+    if (engine->mode == FC_AIO_MODE_URING) {
+        return fc_aio_uring_reap(engine);
+    }
+#endif
+    return fc_aio_threads_reap(engine);
+}
+
+int fc_aio_wait(FCAIOEngine *engine, const int timeout_ms)
+{
+    struct pollfd pfd;
+    int count;
+
+    if ((count=fc_aio_reap(engine)) > 0) {
+        return count;
+    }
+
+    pfd.fd = engine->notify_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return 0;
+    }
+    return fc_aio_reap(engine);
+}
+
+static void fc_aio_ioevent_callback(int sock, short event, void *arg)
+{
+    fc_aio_reap(((FCAIOIOEventEntry *)arg)->engine);
+}
+
+int fc_aio_attach(FCAIOEngine *engine, IOEventPoller *ioevent)
+{
+    int result;
+
+    engine->ioevent_entry.event.fd = engine->notify_fd;
+    engine->ioevent_entry.event.callback = fc_aio_ioevent_callback;
+    engine->ioevent_entry.engine = engine;
+    if (ioevent_attach(ioevent, engine->notify_fd, IOEVENT_READ,
+                &engine->ioevent_entry) != 0)
+    {
+        result = errno != 0 ? errno : ENOMEM;
+        logError("file: "__FILE__", line: %d, "
+                "ioevent_attach fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+const char *fc_aio_get_mode_caption(const FCAIOEngine *engine)
+{
+    switch (engine->mode) {
+        case FC_AIO_MODE_URING:
+            return "io_uring";
+        case FC_AIO_MODE_THREADS:
+            return "threads";
+        default:
+            return "none";
+    }
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_aio.h: the async file I/O engine by io_uring or the worker threads,
+//          the completions are notified by the eventfd
+
+#ifndef _FC_AIO_H
+#define _FC_AIO_H
+
+#include "common_define.h"
+#include "ioevent.h"
+#include "fast_task_queue.h"
+
+#define FC_AIO_OP_READ       1
+#define FC_AIO_OP_WRITE      2
+#define FC_AIO_OP_FSYNC      3
+#define FC_AIO_OP_FDATASYNC  4
+#define FC_AIO_OP_FALLOCATE  5
+
+#define FC_AIO_MODE_URING    1
+#define FC_AIO_MODE_THREADS  2
+
+#define FC_AIO_DEFAULT_QUEUE_DEPTH   256
+#define FC_AIO_DEFAULT_THREAD_COUNT  4
+
+struct fc_aio_request;
+struct fc_aio_context;
+
+/* called by the thread which reaps the completions */
+typedef void (*fc_aio_callback)(struct fc_aio_request *req);
+
+typedef struct fc_aio_request {
+    int op;
+    int fd;
+    int mode;          //the mode of fallocate
+    char *buff;        //for read and write
+    int64_t offset;    //for read, write and fallocate
+    int64_t length;    //for read, write and fallocate
+    fc_aio_callback callback;
+    void *arg;         //the argument of the caller
+
+    /* the output fields. the read stops at the end of the file,
+     * the partial read and write are continued by the engine */
+    int result;        //error no, 0 for success
+    int64_t bytes;     //the read / written bytes
+    struct fc_aio_request *next;  //for the internal queue
+} FCAIORequest;
+
+typedef struct fc_aio_config {
+    int queue_depth;     //the io_uring entries
+    int thread_count;    //the worker threads of the fallback
+    bool disable_uring;  //use the worker threads
+} FCAIOConfig;
+
+typedef struct fc_aio_ioevent_entry {
+    IOEventEntry event;  //must first
+    struct fc_aio_engine *engine;
+} FCAIOIOEventEntry;
+
+typedef struct fc_aio_engine {
+    int mode;
+    int notify_fd;       //the eventfd, readable when completions ready
+    volatile int64_t inflight;
+    FCAIOIOEventEntry ioevent_entry;
+    struct fc_aio_context *ctx;
+} FCAIOEngine;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** init the async I/O engine, use io_uring when the kernel supports
+ *  the read, write, fsync and fallocate operations
+ *  parameters:
+ *      engine: the engine
+ *      config: the config, NULL for the default
+ *  return: error no, 0 for success
+ */
+int fc_aio_init(FCAIOEngine *engine, const FCAIOConfig *config);
+
+/** wait for the inflight requests and destroy the engine
+ *  parameters:
+ *      engine: the engine
+ *  return: none
+ */
+void fc_aio_destroy(FCAIOEngine *engine);
+
+/** submit the request without blocking on the disk I/O, thread safe.
+ *  the request should be kept until the callback is called
+ *  parameters:
+ *      engine: the engine
+ *      req: the request
+ *  return: error no, 0 for success
+ */
+int fc_aio_submit(FCAIOEngine *engine, FCAIORequest *req);
+
+/** reap the completions and call the callbacks in the current thread
+ *  parameters:
+ *      engine: the engine
+ *  return: the reaped count
+ */
+int fc_aio_reap(FCAIOEngine *engine);
+
+/** wait for the completions by poll the eventfd then reap them
+ *  parameters:
+ *      engine: the engine
+ *      timeout_ms: the timeout in milliseconds, -1 for infinite
+ *  return: the reaped count
+ */
+int fc_aio_wait(FCAIOEngine *engine, const int timeout_ms);
+
+/** attach the eventfd to the ioevent poller of the nio thread, the
+ *  completions are reaped by the ioevent loop
+ *  parameters:
+ *      engine: the engine
+ *      ioevent: the ioevent poller
+ *  return: error no, 0 for success
+ */
+int fc_aio_attach(FCAIOEngine *engine, IOEventPoller *ioevent);
+
+const char *fc_aio_get_mode_caption(const FCAIOEngine *engine);
+
+static inline void fc_aio_set_request(FCAIORequest *req, const int op,
+        const int fd, char *buff, const int64_t offset,
+        const int64_t length, fc_aio_callback callback, void *arg)
+{
+    req->op = op;
+    req->fd = fd;
+    req->mode = 0;
+    req->buff = buff;
+    req->offset = offset;
+    req->length = length;
+    req->callback = callback;
+    req->arg = arg;
+}
+
+static inline int fc_aio_submit_rw(FCAIOEngine *engine, FCAIORequest *req,
+        const int op, const int fd, char *buff, const int64_t offset,
+        const int64_t length, fc_aio_callback callback, void *arg)
+{
+    fc_aio_set_request(req, op, fd, buff, offset, length, callback, arg);
+    return fc_aio_submit(engine, req);
+}
+
+#define fc_aio_read(engine, req, fd, buff, offset, length, callback, arg) \
+    fc_aio_submit_rw(engine, req, FC_AIO_OP_READ, fd, buff, \
+            offset, length, callback, arg)
+
+#define fc_aio_write(engine, req, fd, buff, offset, length, callback, arg) \
+    fc_aio_submit_rw(engine, req, FC_AIO_OP_WRITE, fd, buff, \
+            offset, length, callback, arg)
+
+static inline int fc_aio_fsync(FCAIOEngine *engine, FCAIORequest *req,
+        const int fd, const bool datasync, fc_aio_callback callback,
+        void *arg)
+{
+    return fc_aio_submit_rw(engine, req, datasync ? FC_AIO_OP_FDATASYNC :
+            FC_AIO_OP_FSYNC, fd, NULL, 0, 0, callback, arg);
+}
+
+static inline int fc_aio_fallocate(FCAIOEngine *engine, FCAIORequest *req,
+        const int fd, const int mode, const int64_t offset,
+        const int64_t length, fc_aio_callback callback, void *arg)
+{
+    fc_aio_set_request(req, FC_AIO_OP_FALLOCATE, fd, NULL,
+            offset, length, callback, arg);
+    req->mode = mode;
+    return fc_aio_submit(engine, req);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1008 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_binlog.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shared_func.h"
+#include "logger.h"
+#include "fc_memory.h"
+#include "fc_crc32.h"
+#include "fc_binlog.h"
+
+#define FC_BINLOG_SEGMENT_HEADER_SIZE  sizeof(FCBinlogSegmentHeader)
+#define FC_BINLOG_RECORD_HEADER_SIZE   sizeof(FCBinlogRecordHeader)
+
+static inline void fc_binlog_get_filename(const char *base_path,
+        const int index, char *filename, const int size)
+{
+    snprintf(filename, size, "%s/%s.%06d", base_path,
+            FC_BINLOG_FILENAME_PREFIX, index);
+}
+
+static inline void fc_binlog_get_index_filename(const char *base_path,
+        const int index, char *filename, const int size)
+{
+    snprintf(filename, size, "%s/%s.%06d%s", base_path,
+            FC_BINLOG_FILENAME_PREFIX, index, FC_BINLOG_INDEX_EXT_STR);
+}
+
+static inline uint32_t fc_binlog_calc_crc32(const uint32_t length,
+        const void *data)
+{
+    uint32_t crc;
+
+    crc = fc_crc32_extend(FC_CRC32_INIT_VALUE, &length, sizeof(length));
+    return fc_crc32_extend(crc, data, length) ^ FC_CRC32_XOR_VALUE;
+}
+
+/* check the record at the offset of the mapped file
+ * return 0 for valid, ENOENT for the end or the incomplete record,
+ * EBADMSG for the broken record */
+static int fc_binlog_check_record(const char *map, const int64_t size,
+        const int64_t offset, const FCBinlogRecordHeader **header)
+{
+    if (offset + (int64_t)FC_BINLOG_RECORD_HEADER_SIZE > size) {
+        return ENOENT;
+    }
+
+    *header = (const FCBinlogRecordHeader *)(map + offset);
+    if ((*header)->length > FC_BINLOG_MAX_RECORD_SIZE) {
+        return EBADMSG;
+    }
+    if (offset + (int64_t)FC_BINLOG_RECORD_HEADER_SIZE +
+            (*header)->length > size)
+    {
+        return ENOENT;
+    }
+    if (fc_binlog_calc_crc32((*header)->length, *header + 1) !=
+            (*header)->crc32)
+    {
+        return EBADMSG;
+    }
+    return 0;
+}
+
+static int fc_binlog_compare_int(const void *p1, const void *p2)
+{
+    return *((const int *)p1) - *((const int *)p2);
+}
+
+/* get the segment indexes in ascending order */
+static int fc_binlog_list_segments(const char *base_path,
+        int **indexes, int *count)
+{
+    DIR *dir;
+    struct dirent *ent;
+    const char *suffix;
+    char *endptr;
+    int prefix_len;
+    int alloc;
+    int index;
+    int *new_indexes;
+    int result;
+
+    *indexes = NULL;
+    *count = 0;
+    if ((dir=opendir(base_path)) == NULL) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "opendir %s fail, errno: %d, error info: %s",
+                __LINE__, base_path, result, STRERROR(result));
+        return result;
+    }
+
+    result = 0;
+    alloc = 0;
+    prefix_len = strlen(FC_BINLOG_FILENAME_PREFIX);
+    while ((ent=readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, FC_BINLOG_FILENAME_PREFIX,
+                    prefix_len) != 0 || ent->d_name[prefix_len] != '.')
+        {
+            continue;
+        }
+        suffix = ent->d_name + prefix_len + 1;
+        index = strtol(suffix, &endptr, 10);
+        if (endptr - suffix != 6 || *endptr != '\0' || index <= 0) {
+            continue;   //such as the index file
+        }
+
+        if (*count == alloc) {
+            alloc = (alloc == 0) ? 64 : alloc * 2;
+            new_indexes = (int *)fc_realloc(*indexes, sizeof(int) * alloc);
+            if (new_indexes == NULL) {
+                result = ENOMEM;
+                break;
+            }
+            *indexes = new_indexes;
+        }
+        (*indexes)[(*count)++] = index;
+    }
+    closedir(dir);
+
+    if (result != 0) {
+        free(*indexes);
+        *indexes = NULL;
+        *count = 0;
+        return result;
+    }
+    if (*count > 1) {
+        qsort(*indexes, *count, sizeof(int), fc_binlog_compare_int);
+    }
+    return 0;
+}
+
+static int fc_binlog_read_segment_header(const char *filename,
+        FCBinlogSegmentHeader *header)
+{
+    int fd;
+    int result;
+
+    if ((fd=open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        return errno != 0 ? errno : ENOENT;
+    }
+    if (pread(fd, header, FC_BINLOG_SEGMENT_HEADER_SIZE, 0) !=
+            FC_BINLOG_SEGMENT_HEADER_SIZE)
+    {
+        result = EINVAL;
+    } else if (memcmp(header->magic, FC_BINLOG_SEGMENT_MAGIC,
+                FC_BINLOG_SEGMENT_MAGIC_LEN) != 0 ||
+            header->version != FC_BINLOG_VERSION ||
+            header->first_record_no < 0)
+    {
+        result = EINVAL;
+    } else {
+        result = 0;
+    }
+    close(fd);
+    return result;
+}
+
+/* load the entries of the index file, the incomplete tail is ignored */
+static int fc_binlog_load_index(const char *filename,
+        FCBinlogIndexEntry **entries, int *count)
+{
+    char *content;
+    int64_t file_size;
+    int result;
+
+    *entries = NULL;
+    *count = 0;
+    if (access(filename, F_OK) != 0) {
+        return 0;
+    }
+    if ((result=getFileContent(filename, &content, &file_size)) != 0) {
+        return result;
+    }
+
+    *count = file_size / sizeof(FCBinlogIndexEntry);
+    if (*count == 0) {
+        free(content);
+        return 0;
+    }
+    *entries = (FCBinlogIndexEntry *)content;
+    return 0;
+}
+
+static int fc_binlog_write_index_entry(FCBinlogWriter *writer)
+{
+    FCBinlogIndexEntry entry;
+    int result;
+
+    entry.record_no = writer->next_record_no;
+    entry.offset = writer->offset;
+    if (fc_safe_write(writer->index_fd, (const char *)&entry,
+                sizeof(entry)) != sizeof(entry))
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write index file of binlog %s/%s.%06d fail, "
+                "errno: %d, error info: %s", __LINE__, writer->base_path,
+                FC_BINLOG_FILENAME_PREFIX, writer->segment_index,
+                result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+static void fc_binlog_preallocate(FCBinlogWriter *writer)
+{
+#ifdef OS_LINUX
+    //keep the file size as the data end for the recovery and the reader
+    if (writer->config.preallocate && fallocate(writer->writer.fd,
+                FALLOC_FL_KEEP_SIZE, 0, writer->config.segment_size) < 0)
+    {
+        if (errno != EOPNOTSUPP) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "fallocate file %s fail, errno: %d, error info: %s",
+                    __LINE__, writer->writer.filename,
+                    errno, STRERROR(errno));
+        }
+    }
+#endif
+}
+
+static int fc_binlog_open_index_file(FCBinlogWriter *writer, const int flags)
+{
+    char filename[MAX_PATH_SIZE];
+    int result;
+
+    fc_binlog_get_index_filename(writer->base_path,
+            writer->segment_index, filename, sizeof(filename));
+    if ((writer->index_fd=open(filename, O_WRONLY | O_CREAT |
+                    O_CLOEXEC | flags, 0644)) < 0)
+    {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+static int fc_binlog_create_segment(FCBinlogWriter *writer,
+        const int segment_index, const int64_t first_record_no)
+{
+    FCBinlogSegmentHeader header;
+    char filename[MAX_PATH_SIZE];
+    int result;
+
+    writer->segment_index = segment_index;
+    writer->first_record_no = first_record_no;
+    writer->next_record_no = first_record_no;
+    fc_binlog_get_filename(writer->base_path, segment_index,
+            filename, sizeof(filename));
+    if ((result=buffered_file_writer_open_ex(&writer->writer, filename,
+                    writer->config.buffer_size, 0, 0644)) != 0)
+    {
+        return result;
+    }
+    if ((result=fc_binlog_open_index_file(writer, O_TRUNC)) != 0) {
+        buffered_file_writer_close(&writer->writer);
+        return result;
+    }
+    fc_binlog_preallocate(writer);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FC_BINLOG_SEGMENT_MAGIC,
+            FC_BINLOG_SEGMENT_MAGIC_LEN);
+    header.version = FC_BINLOG_VERSION;
+    header.first_record_no = first_record_no;
+    header.create_time = time(NULL);
+    writer->offset = FC_BINLOG_SEGMENT_HEADER_SIZE;
+    return buffered_file_writer_append_buff(&writer->writer,
+            (const char *)&header, sizeof(header));
+}
+
+static int fc_binlog_close_segment(FCBinlogWriter *writer)
+{
+    int result;
+
+    result = buffered_file_writer_close(&writer->writer);
+    if (writer->index_fd >= 0) {
+        close(writer->index_fd);
+        writer->index_fd = -1;
+    }
+    return result;
+}
+
+/* find the last valid index entry to start the scan */
+static int fc_binlog_find_scan_start(const char *map, const int64_t size,
+        const int64_t first_record_no, const FCBinlogIndexEntry *entries,
+        const int count)
+{
+    const FCBinlogRecordHeader *header;
+    int i;
+
+    for (i=count-1; i>=0; i--) {
+        if (entries[i].record_no >= first_record_no && entries[i].offset >=
+                (int64_t)FC_BINLOG_SEGMENT_HEADER_SIZE && (i == 0 ||
+                    entries[i].record_no > entries[i - 1].record_no) &&
+                fc_binlog_check_record(map, size, entries[i].offset,
+                    &header) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int fc_binlog_rewrite_index(const char *filename,
+        const FCBinlogIndexEntry *entries, const int count)
+{
+    int fd;
+    int bytes;
+    int result;
+
+    if ((fd=open(filename, O_WRONLY | O_CREAT | O_TRUNC |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        return errno != 0 ? errno : EACCES;
+    }
+    bytes = sizeof(FCBinlogIndexEntry) * count;
+    if (bytes > 0 && fc_safe_write(fd, (const char *)entries,
+                bytes) != bytes)
+    {
+        result = errno != 0 ? errno : EIO;
+    } else {
+        result = 0;
+    }
+    close(fd);
+    return result;
+}
+
+/* scan the tail of the segment after the last valid index entry */
+static int fc_binlog_recover_segment(FCBinlogWriter *writer,
+        const int segment_index, const FCBinlogSegmentHeader *segment_header)
+{
+    char filename[MAX_PATH_SIZE];
+    char index_filename[MAX_PATH_SIZE];
+    const FCBinlogRecordHeader *header;
+    FCBinlogIndexEntry *entries;
+    FCBinlogIndexEntry *new_entries;
+    struct stat st;
+    char *map;
+    int64_t offset;
+    int64_t record_no;
+    int entry_count;
+    int entry_alloc;
+    int start;
+    int fd;
+    int result;
+
+    fc_binlog_get_filename(writer->base_path, segment_index,
+            filename, sizeof(filename));
+    fc_binlog_get_index_filename(writer->base_path, segment_index,
+            index_filename, sizeof(index_filename));
+    if ((fd=open(filename, O_RDWR | O_CLOEXEC)) < 0 || fstat(fd, &st) != 0) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return result;
+    }
+
+    map = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        logError("file: "__FILE__", line: %d, "
+                "mmap file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        close(fd);
+        return result;
+    }
+
+    if ((result=fc_binlog_load_index(index_filename, &entries,
+                    &entry_count)) != 0)
+    {
+        munmap(map, st.st_size);
+        close(fd);
+        return result;
+    }
+
+    start = fc_binlog_find_scan_start(map, st.st_size, segment_header->
+            first_record_no, entries, entry_count);
+    if (start >= 0) {
+        offset = entries[start].offset;
+        record_no = entries[start].record_no;
+        entry_count = start + 1;
+    } else {
+        offset = FC_BINLOG_SEGMENT_HEADER_SIZE;
+        record_no = segment_header->first_record_no;
+        entry_count = 0;
+    }
+    writer->recovery.scanned_bytes = st.st_size - offset;
+
+    entry_alloc = entry_count;
+    result = 0;
+    while (fc_binlog_check_record(map, st.st_size, offset, &header) == 0) {
+        if ((record_no - segment_header->first_record_no) % writer->
+                config.index_interval == 0 && (entry_count == 0 ||
+                    record_no > entries[entry_count - 1].record_no))
+        {
+            if (entry_count == entry_alloc) {
+                entry_alloc = (entry_alloc == 0) ? 64 : entry_alloc * 2;
+                new_entries = (FCBinlogIndexEntry *)fc_realloc(entries,
+                        sizeof(FCBinlogIndexEntry) * entry_alloc);
+                if (new_entries == NULL) {
+                    result = ENOMEM;
+                    break;
+                }
+                entries = new_entries;
+            }
+            entries[entry_count].record_no = record_no;
+            entries[entry_count].offset = offset;
+            entry_count++;
+        }
+
+        offset += FC_BINLOG_RECORD_HEADER_SIZE + header->length;
+        record_no++;
+    }
+    munmap(map, st.st_size);
+
+    if (result == 0) {
+        writer->recovery.truncated_bytes = st.st_size - offset;
+        if (offset < st.st_size) {
+            logWarning("file: "__FILE__", line: %d, "
+                    "binlog file %s, truncate the torn records, "
+                    "file size: %"PRId64", valid size: %"PRId64, __LINE__,
+                    filename, (int64_t)st.st_size, offset);
+            if (ftruncate(fd, offset) != 0) {
+                result = errno != 0 ? errno : EIO;
+                logError("file: "__FILE__", line: %d, "
+                        "ftruncate file %s fail, errno: %d, "
+                        "error info: %s", __LINE__, filename,
+                        result, STRERROR(result));
+            }
+        }
+    }
+    close(fd);
+
+    if (result == 0) {
+        result = fc_binlog_rewrite_index(index_filename,
+                entries, entry_count);
+    }
+    if (entries != NULL) {
+        free(entries);
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    writer->segment_index = segment_index;
+    writer->first_record_no = segment_header->first_record_no;
+    writer->next_record_no = record_no;
+    writer->offset = offset;
+    if ((result=buffered_file_writer_open_append(&writer->writer, filename,
+                    writer->config.buffer_size, 0, 0644)) != 0)
+    {
+        return result;
+    }
+    if ((result=fc_binlog_open_index_file(writer, O_APPEND)) != 0) {
+        buffered_file_writer_close(&writer->writer);
+        return result;
+    }
+    fc_binlog_preallocate(writer);
+    return 0;
+}
+
+int fc_binlog_writer_open(FCBinlogWriter *writer, const char *base_path,
+        const FCBinlogConfig *config)
+{
+    FCBinlogSegmentHeader header;
+    char filename[MAX_PATH_SIZE];
+    char index_filename[MAX_PATH_SIZE];
+    int64_t start_time;
+    int *indexes;
+    int count;
+    int result;
+
+    memset(writer, 0, sizeof(FCBinlogWriter));
+    writer->index_fd = -1;
+    if (config != NULL) {
+        writer->config = *config;
+    }
+    if (writer->config.segment_size <= 0) {
+        writer->config.segment_size = FC_BINLOG_DEFAULT_SEGMENT_SIZE;
+    }
+    if (writer->config.index_interval <= 0) {
+        writer->config.index_interval = FC_BINLOG_DEFAULT_INDEX_INTERVAL;
+    }
+    if (writer->config.buffer_size <= 0) {
+        writer->config.buffer_size = FC_BINLOG_DEFAULT_BUFFER_SIZE;
+    }
+    snprintf(writer->base_path, sizeof(writer->base_path), "%s", base_path);
+    if ((result=fc_mkdirs(base_path, 0755)) != 0) {
+        return result;
+    }
+
+    start_time = get_current_time_us();
+    if ((result=fc_binlog_list_segments(base_path, &indexes, &count)) != 0) {
+        return result;
+    }
+
+    //the last segment with the torn header has no durable record
+    while (count > 0) {
+        fc_binlog_get_filename(base_path, indexes[count - 1],
+                filename, sizeof(filename));
+        if (fc_binlog_read_segment_header(filename, &header) == 0) {
+            break;
+        }
+
+        logWarning("file: "__FILE__", line: %d, "
+                "binlog file %s, invalid segment header, remove it",
+                __LINE__, filename);
+        fc_binlog_get_index_filename(base_path, indexes[count - 1],
+                index_filename, sizeof(index_filename));
+        unlink(filename);
+        unlink(index_filename);
+        count--;
+    }
+
+    if (count == 0) {
+        result = fc_binlog_create_segment(writer, 1, 0);
+    } else {
+        result = fc_binlog_recover_segment(writer,
+                indexes[count - 1], &header);
+    }
+    if (indexes != NULL) {
+        free(indexes);
+    }
+    writer->recovery.time_used_us = get_current_time_us() - start_time;
+    return result;
+}
+
+int fc_binlog_writer_append(FCBinlogWriter *writer, const void *data,
+        const int length, int64_t *record_no)
+{
+    FCBinlogRecordHeader header;
+    int64_t record_size;
+    int result;
+
+    if (length < 0 || length > FC_BINLOG_MAX_RECORD_SIZE) {
+        return EINVAL;
+    }
+
+    record_size = FC_BINLOG_RECORD_HEADER_SIZE + length;
+    if (writer->offset + record_size > writer->config.segment_size &&
+            writer->next_record_no > writer->first_record_no)
+    {
+        if ((result=fc_binlog_close_segment(writer)) != 0) {
+            return result;
+        }
+        if ((result=fc_binlog_create_segment(writer, writer->
+                        segment_index + 1, writer->next_record_no)) != 0)
+        {
+            return result;
+        }
+    }
+
+    if ((writer->next_record_no - writer->first_record_no) %
+            writer->config.index_interval == 0)
+    {
+        if ((result=fc_binlog_write_index_entry(writer)) != 0) {
+            return result;
+        }
+    }
+
+    header.length = length;
+    header.crc32 = fc_binlog_calc_crc32(length, data);
+    if ((result=buffered_file_writer_append_buff(&writer->writer,
+                    (const char *)&header, sizeof(header))) != 0)
+    {
+        return result;
+    }
+    if ((result=buffered_file_writer_append_buff(&writer->writer,
+                    (const char *)data, length)) != 0)
+    {
+        return result;
+    }
+
+    if (record_no != NULL) {
+        *record_no = writer->next_record_no;
+    }
+    writer->next_record_no++;
+    writer->offset += record_size;
+    return 0;
+}
+
+int fc_binlog_writer_commit(FCBinlogWriter *writer)
+{
+    return buffered_file_writer_commit(&writer->writer);
+}
+
+int fc_binlog_writer_close(FCBinlogWriter *writer)
+{
+    return fc_binlog_close_segment(writer);
+}
+
+static void fc_binlog_reader_unmap(FCBinlogReader *reader)
+{
+    if (reader->map != NULL) {
+        munmap(reader->map, reader->map_size);
+        reader->map = NULL;
+        reader->map_size = 0;
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+static int fc_binlog_reader_remap(FCBinlogReader *reader)
+{
+    struct stat st;
+    char *map;
+    int result;
+
+    if (fstat(reader->fd, &st) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+    if (st.st_size <= reader->map_size) {
+        return 0;
+    }
+
+    map = (char *)mmap(NULL, st.st_size, PROT_READ,
+            MAP_SHARED, reader->fd, 0);
+    if (map == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        logError("file: "__FILE__", line: %d, "
+                "mmap binlog %s/%s.%06d fail, errno: %d, error info: %s",
+                __LINE__, reader->base_path, FC_BINLOG_FILENAME_PREFIX,
+                reader->segments[reader->current].index,
+                result, STRERROR(result));
+        return result;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    if (reader->map != NULL) {
+        munmap(reader->map, reader->map_size);
+    }
+    reader->map = map;
+    reader->map_size = st.st_size;
+    return 0;
+}
+
+static int fc_binlog_reader_map_segment(FCBinlogReader *reader,
+        const int current)
+{
+    char filename[MAX_PATH_SIZE];
+    int result;
+
+    fc_binlog_reader_unmap(reader);
+    reader->current = current;
+    fc_binlog_get_filename(reader->base_path, reader->segments[current].
+            index, filename, sizeof(filename));
+    if ((reader->fd=open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+    if ((result=fc_binlog_reader_remap(reader)) != 0) {
+        return result;
+    }
+
+    reader->offset = FC_BINLOG_SEGMENT_HEADER_SIZE;
+    reader->record_no = reader->segments[current].first_record_no;
+    return 0;
+}
+
+static void fc_binlog_reader_free_segments(FCBinlogReader *reader)
+{
+    int i;
+
+    if (reader->segments == NULL) {
+        return;
+    }
+    for (i=0; i<reader->segment_count; i++) {
+        if (reader->segments[i].entries != NULL) {
+            free(reader->segments[i].entries);
+        }
+    }
+    free(reader->segments);
+    reader->segments = NULL;
+    reader->segment_count = 0;
+}
+
+static int fc_binlog_reader_load_segments(FCBinlogReader *reader)
+{
+    FCBinlogSegmentHeader header;
+    FCBinlogSegment *segments;
+    char filename[MAX_PATH_SIZE];
+    int *indexes;
+    int count;
+    int result;
+    int i;
+
+    if ((result=fc_binlog_list_segments(reader->base_path,
+                    &indexes, &count)) != 0)
+    {
+        return result;
+    }
+    if (count == 0) {
+        return ENOENT;
+    }
+
+    segments = (FCBinlogSegment *)fc_calloc(count, sizeof(FCBinlogSegment));
+    if (segments == NULL) {
+        free(indexes);
+        return ENOMEM;
+    }
+    for (i=0; i<count; i++) {
+        fc_binlog_get_filename(reader->base_path, indexes[i],
+                filename, sizeof(filename));
+        if ((result=fc_binlog_read_segment_header(filename,
+                        &header)) != 0)
+        {
+            if (i == count - 1) {   //the segment is being created
+                result = 0;
+                count--;
+                break;
+            }
+            logError("file: "__FILE__", line: %d, "
+                    "binlog file %s, invalid segment header",
+                    __LINE__, filename);
+            break;
+        }
+        segments[i].index = indexes[i];
+        segments[i].first_record_no = header.first_record_no;
+    }
+    free(indexes);
+
+    if (result == 0 && count == 0) {
+        result = ENOENT;
+    }
+    if (result != 0) {
+        free(segments);
+        return result;
+    }
+
+    //keep the loaded index entries
+    if (reader->segments != NULL) {
+        for (i=0; i<reader->segment_count && i<count; i++) {
+            if (reader->segments[i].index == segments[i].index) {
+                segments[i] = reader->segments[i];
+                reader->segments[i].entries = NULL;
+            }
+        }
+        fc_binlog_reader_free_segments(reader);
+    }
+    reader->segments = segments;
+    reader->segment_count = count;
+    return 0;
+}
+
+int fc_binlog_reader_open(FCBinlogReader *reader, const char *base_path)
+{
+    int result;
+
+    memset(reader, 0, sizeof(FCBinlogReader));
+    reader->fd = -1;
+    snprintf(reader->base_path, sizeof(reader->base_path), "%s", base_path);
+    if ((result=fc_binlog_reader_load_segments(reader)) != 0) {
+        return result;
+    }
+    if ((result=fc_binlog_reader_map_segment(reader, 0)) != 0) {
+        fc_binlog_reader_close(reader);
+        return result;
+    }
+    return 0;
+}
+
+static int fc_binlog_reader_load_index(FCBinlogReader *reader,
+        FCBinlogSegment *segment)
+{
+    char filename[MAX_PATH_SIZE];
+    int result;
+
+    fc_binlog_get_index_filename(reader->base_path, segment->index,
+            filename, sizeof(filename));
+    if (segment->entries != NULL) {
+        free(segment->entries);
+    }
+    if ((result=fc_binlog_load_index(filename, &segment->entries,
+                    &segment->entry_count)) != 0)
+    {
+        return result;
+    }
+    segment->index_loaded = true;
+    return 0;
+}
+
+int fc_binlog_reader_seek(FCBinlogReader *reader, const int64_t record_no)
+{
+    const FCBinlogRecordHeader *header;
+    FCBinlogSegment *segment;
+    int64_t offset;
+    int64_t current_no;
+    int low;
+    int high;
+    int mid;
+    int found;
+    int result;
+
+    if (record_no < reader->segments[0].first_record_no) {
+        return ENOENT;
+    }
+
+    //the last segment which the first record number <= record_no
+    low = 0;
+    high = reader->segment_count - 1;
+    while (low < high) {
+        mid = (low + high + 1) / 2;
+        if (reader->segments[mid].first_record_no <= record_no) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    segment = reader->segments + low;
+    if (reader->current != low || reader->map == NULL) {
+        if ((result=fc_binlog_reader_map_segment(reader, low)) != 0) {
+            return result;
+        }
+    } else if ((result=fc_binlog_reader_remap(reader)) != 0) {
+        return result;
+    }
+    if (!segment->index_loaded || (segment->entry_count > 0 &&
+                segment->entries[segment->entry_count - 1].record_no <
+                record_no && low == reader->segment_count - 1))
+    {
+        //the index of the last segment grows
+        if ((result=fc_binlog_reader_load_index(reader, segment)) != 0) {
+            return result;
+        }
+    }
+
+    //the last index entry which the record number <= record_no
+    found = -1;
+    low = 0;
+    high = segment->entry_count - 1;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (segment->entries[mid].record_no <= record_no) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (found >= 0 && segment->entries[found].record_no >=
+            segment->first_record_no && fc_binlog_check_record(reader->map,
+                reader->map_size, segment->entries[found].offset,
+                &header) == 0)
+    {
+        offset = segment->entries[found].offset;
+        current_no = segment->entries[found].record_no;
+    } else {
+        offset = FC_BINLOG_SEGMENT_HEADER_SIZE;
+        current_no = segment->first_record_no;
+    }
+
+    while (current_no < record_no) {
+        if ((result=fc_binlog_check_record(reader->map, reader->map_size,
+                        offset, &header)) != 0)
+        {
+            return result;
+        }
+        offset += FC_BINLOG_RECORD_HEADER_SIZE + header->length;
+        current_no++;
+    }
+
+    reader->offset = offset;
+    reader->record_no = current_no;
+    return 0;
+}
+
+/* switch to the next segment when the current segment is read to the end.
+ * the writer may append to the current segment after the last remap and
+ * before the roll over, so remap once more and read the tail first */
+static int fc_binlog_reader_switch(FCBinlogReader *reader)
+{
+    FCBinlogSegment *next;
+    int64_t old_size;
+    int result;
+
+    old_size = reader->map_size;
+    if ((result=fc_binlog_reader_remap(reader)) != 0) {
+        return result;
+    }
+    if (reader->map_size > old_size) {
+        return 0;
+    }
+
+    next = reader->segments + reader->current + 1;
+    if (reader->record_no != next->first_record_no) {
+        logError("file: "__FILE__", line: %d, "
+                "binlog %s/%s.%06d, the next record no: %"PRId64" != "
+                "the first record no: %"PRId64" of the next segment",
+                __LINE__, reader->base_path, FC_BINLOG_FILENAME_PREFIX,
+                reader->segments[reader->current].index,
+                reader->record_no, next->first_record_no);
+        return EBADMSG;
+    }
+    return fc_binlog_reader_map_segment(reader, reader->current + 1);
+}
+
+/* switch to the next segment or remap the growing last segment,
+ * return 0 for more data, ENOENT for the end */
+static int fc_binlog_reader_forward(FCBinlogReader *reader)
+{
+    char filename[MAX_PATH_SIZE];
+    int64_t old_size;
+    int result;
+
+    if (reader->current + 1 < reader->segment_count) {
+        return fc_binlog_reader_switch(reader);
+    }
+
+    old_size = reader->map_size;
+    if ((result=fc_binlog_reader_remap(reader)) != 0) {
+        return result;
+    }
+    if (reader->map_size > old_size) {
+        return 0;
+    }
+
+    //the writer rolls over to the new segment
+    fc_binlog_get_filename(reader->base_path, reader->segments[reader->
+            current].index + 1, filename, sizeof(filename));
+    if (access(filename, F_OK) != 0) {
+        return ENOENT;
+    }
+    if ((result=fc_binlog_reader_load_segments(reader)) != 0) {
+        return result;
+    }
+    if (reader->current + 1 < reader->segment_count) {
+        return fc_binlog_reader_switch(reader);
+    }
+    return ENOENT;
+}
+
+int fc_binlog_reader_next(FCBinlogReader *reader, FCBinlogRecord *record)
+{
+    const FCBinlogRecordHeader *header;
+    int result;
+
+    while (1) {
+        if (reader->map == NULL) {
+            return ENOENT;
+        }
+
+        result = fc_binlog_check_record(reader->map, reader->map_size,
+                reader->offset, &header);
+        if (result == 0) {
+            record->record_no = reader->record_no++;
+            record->data = (const char *)(header + 1);
+            record->length = header->length;
+            reader->offset += FC_BINLOG_RECORD_HEADER_SIZE + header->length;
+            return 0;
+        }
+
+        if (result != ENOENT) {
+            logError("file: "__FILE__", line: %d, "
+                    "binlog %s/%s.%06d, broken record at offset: %"PRId64,
+                    __LINE__, reader->base_path, FC_BINLOG_FILENAME_PREFIX,
+                    reader->segments[reader->current].index, reader->offset);
+            return result;
+        }
+        if ((result=fc_binlog_reader_forward(reader)) != 0) {
+            return result;
+        }
+    }
+}
+
+void fc_binlog_reader_close(FCBinlogReader *reader)
+{
+    fc_binlog_reader_unmap(reader);
+    fc_binlog_reader_free_segments(reader);
+}
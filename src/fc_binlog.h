@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_binlog.h: the append-only binlog of the length and CRC32 framed
+//             records, rolled over by the segment files with the sparse
+//             index files, and the zero-copy mmap reader
+
+#ifndef _FC_BINLOG_H
+#define _FC_BINLOG_H
+
+#include "common_define.h"
+#include "buffered_file_writer.h"
+
+#define FC_BINLOG_SEGMENT_MAGIC      "FCRECLOG"
+#define FC_BINLOG_SEGMENT_MAGIC_LEN  8
+#define FC_BINLOG_VERSION            1
+
+#define FC_BINLOG_FILENAME_PREFIX    "binlog"
+#define FC_BINLOG_INDEX_EXT_STR      ".idx"
+
+#define FC_BINLOG_DEFAULT_SEGMENT_SIZE    (64 * 1024 * 1024)
+#define FC_BINLOG_DEFAULT_INDEX_INTERVAL  256
+#define FC_BINLOG_DEFAULT_BUFFER_SIZE     (256 * 1024)
+#define FC_BINLOG_MAX_RECORD_SIZE         (64 * 1024 * 1024)
+
+/* the file header of the segment, the record numbers start from 0 */
+typedef struct fc_binlog_segment_header {
+    char magic[FC_BINLOG_SEGMENT_MAGIC_LEN];
+    int version;
+    int padding;
+    int64_t first_record_no;
+    int64_t create_time;
+} FCBinlogSegmentHeader;
+
+/* the record header in the host byte order, followed by the body.
+ * the crc32 is calculated by the length and the body */
+typedef struct fc_binlog_record_header {
+    uint32_t length;
+    uint32_t crc32;
+} FCBinlogRecordHeader;
+
+/* the entry of the sparse index file, every index_interval records */
+typedef struct fc_binlog_index_entry {
+    int64_t record_no;
+    int64_t offset;
+} FCBinlogIndexEntry;
+
+typedef struct fc_binlog_config {
+    int64_t segment_size;   //roll over to the next segment file
+    int index_interval;     //the records per index entry
+    int buffer_size;        //the buffer size of the file writer
+    bool preallocate;       //fallocate the segment file when created
+} FCBinlogConfig;
+
+typedef struct fc_binlog_recovery_stats {
+    int64_t scanned_bytes;    //the tail scanned by the recovery
+    int64_t truncated_bytes;  //the torn records removed
+    int64_t time_used_us;
+} FCBinlogRecoveryStats;
+
+typedef struct fc_binlog_writer {
+    FCBinlogConfig config;
+    BufferedFileWriter writer;
+    int index_fd;
+    int segment_index;        //the index of the current segment file
+    int64_t first_record_no;  //of the current segment
+    int64_t next_record_no;
+    int64_t offset;           //the end of the current segment
+    FCBinlogRecoveryStats recovery;
+    char base_path[MAX_PATH_SIZE];
+} FCBinlogWriter;
+
+typedef struct fc_binlog_record {
+    int64_t record_no;
+    const char *data;   //point to the mapped memory, valid until the
+                        //reader switches the segment or closed
+    int length;
+} FCBinlogRecord;
+
+typedef struct fc_binlog_segment {
+    int index;
+    int64_t first_record_no;
+    FCBinlogIndexEntry *entries;  //loaded when used
+    int entry_count;
+    bool index_loaded;
+} FCBinlogSegment;
+
+typedef struct fc_binlog_reader {
+    FCBinlogSegment *segments;
+    int segment_count;
+    int current;              //the index of the segments array
+    int fd;
+    char *map;                //the mapped segment file
+    int64_t map_size;
+    int64_t offset;
+    int64_t record_no;        //the record number of the next record
+    char base_path[MAX_PATH_SIZE];
+} FCBinlogReader;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** open the binlog writer, create the base path when not exist.
+ *  the recovery scans the tail of the last segment after the last valid
+ *  index entry only, and truncates the torn records
+ *  parameters:
+ *      writer: the binlog writer
+ *      base_path: the path of the segment files
+ *      config: the config, NULL for the default
+ *  return: error no, 0 for success
+ */
+int fc_binlog_writer_open(FCBinlogWriter *writer, const char *base_path,
+        const FCBinlogConfig *config);
+
+/** append the record, roll over to the next segment when the segment
+ *  is full. not thread safe, the caller should serialize the appends
+ *  parameters:
+ *      writer: the binlog writer
+ *      data: the record body
+ *      length: the body length
+ *      record_no: return the record number, can be NULL
+ *  return: error no, 0 for success
+ */
+int fc_binlog_writer_append(FCBinlogWriter *writer, const void *data,
+        const int length, int64_t *record_no);
+
+/** flush the buffer and fdatasync
+ *  parameters:
+ *      writer: the binlog writer
+ *  return: error no, 0 for success
+ */
+int fc_binlog_writer_commit(FCBinlogWriter *writer);
+
+/** flush, fsync and close the binlog writer
+ *  parameters:
+ *      writer: the binlog writer
+ *  return: error no, 0 for success
+ */
+int fc_binlog_writer_close(FCBinlogWriter *writer);
+
+/** open the binlog reader and position to the first record
+ *  parameters:
+ *      reader: the binlog reader
+ *      base_path: the path of the segment files
+ *  return: error no, 0 for success, ENOENT for no segment
+ */
+int fc_binlog_reader_open(FCBinlogReader *reader, const char *base_path);
+
+/** seek to the record by the segment headers and the sparse index,
+ *  O(log n) and scan index_interval records at most. seek to the next
+ *  record number of the writer to wait for the new records
+ *  parameters:
+ *      reader: the binlog reader
+ *      record_no: the record number to seek
+ *  return: error no, 0 for success, ENOENT for the record not exist
+ */
+int fc_binlog_reader_seek(FCBinlogReader *reader, const int64_t record_no);
+
+/** get the next record without copy, the segment which is being written
+ *  is remapped when it grows
+ *  parameters:
+ *      reader: the binlog reader
+ *      record: return the record
+ *  return: error no, 0 for success, ENOENT for the end,
+ *          EBADMSG for the broken record or the records lost
+ *          between the segments
+ */
+int fc_binlog_reader_next(FCBinlogReader *reader, FCBinlogRecord *record);
+
+/** close the binlog reader
+ *  parameters:
+ *      reader: the binlog reader
+ *  return: none
+ */
+void fc_binlog_reader_close(FCBinlogReader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_compress.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#include "shared_func.h"
+#include "pthread_func.h"
+#include "fc_compress.h"
+
+#define FC_COMPRESS_OUT_BUFF_SIZE  (128 * 1024)
+#define FC_COMPRESS_READ_BUFF_SIZE (256 * 1024)
+#define FC_COMPRESS_MAX_SLEEP_US   (1000 * 1000)
+
+typedef struct fc_compress_task {
+    struct fc_compress_task *next;
+    int method;
+    int level;
+    char filename[0];
+} FCCompressTask;
+
+typedef struct fc_compress_worker {
+    pthread_lock_cond_pair_t lcp;
+    bool started;
+    FCCompressWorkerConfig config;
+    FCCompressTask *head;
+    FCCompressTask *tail;
+    FCCompressTask *current;   //the compressing task
+    FCCompressWorkerStats stats;
+} FCCompressWorker;
+
+static FCCompressWorker compress_worker = {
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER}, false,
+    {FC_COMPRESS_DEFAULT_QUEUE_SIZE, FC_COMPRESS_DEFAULT_LEVEL,
+        {FC_COMPRESS_DEFAULT_BYTES_PER_SECOND,
+            FC_COMPRESS_DEFAULT_CPU_PERCENT}}};
+
+bool fc_compress_method_supported(const int method)
+{
+    switch (method) {
+#ifdef USE_ZLIB
+        case FC_COMPRESS_METHOD_GZIP:
+            return true;
+#endif
+#ifdef USE_ZSTD
+        case FC_COMPRESS_METHOD_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static int fc_compress_init_ctx(FCCompressStream *stream, const int level)
+{
+    switch (stream->method) {
+#ifdef USE_ZLIB
+        case FC_COMPRESS_METHOD_GZIP:
+        {
+            z_stream *zs;
+
+            if ((zs=(z_stream *)fc_calloc(1, sizeof(z_stream))) == NULL) {
+                return ENOMEM;
+            }
+            //the window bits 15 + 16 for the gzip header and trailer
+            if (deflateInit2(zs, level >= 0 ? level : Z_DEFAULT_COMPRESSION,
+                        Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                free(zs);
+                return ENOMEM;
+            }
+            stream->ctx = zs;
+            return 0;
+        }
+#endif
+#ifdef USE_ZSTD
+        case FC_COMPRESS_METHOD_ZSTD:
+        {
+            ZSTD_CStream *cs;
+
+            if ((cs=ZSTD_createCStream()) == NULL) {
+                return ENOMEM;
+            }
+            if (ZSTD_isError(ZSTD_initCStream(cs, level >= 0 ?
+                            level : ZSTD_CLEVEL_DEFAULT)))
+            {
+                ZSTD_freeCStream(cs);
+                return EINVAL;
+            }
+            stream->ctx = cs;
+            return 0;
+        }
+#endif
+        default:
+            return EOPNOTSUPP;
+    }
+}
+
+static void fc_compress_free_ctx(FCCompressStream *stream)
+{
+    if (stream->ctx == NULL) {
+        return;
+    }
+
+    switch (stream->method) {
+#ifdef USE_ZLIB
+        case FC_COMPRESS_METHOD_GZIP:
+            deflateEnd((z_stream *)stream->ctx);
+            free(stream->ctx);
+            break;
+#endif
+#ifdef USE_ZSTD
+        case FC_COMPRESS_METHOD_ZSTD:
+            ZSTD_freeCStream((ZSTD_CStream *)stream->ctx);
+            break;
+#endif
+        default:
+            break;
+    }
+    stream->ctx = NULL;
+}
+
+int fc_compress_stream_open(FCCompressStream *stream, const char *filename,
+        const int method, const int level)
+{
+    int result;
+
+    memset(stream, 0, sizeof(FCCompressStream));
+    stream->fd = -1;
+    stream->method = method;
+    if (!fc_compress_method_supported(method)) {
+        return EOPNOTSUPP;
+    }
+
+    stream->out_size = FC_COMPRESS_OUT_BUFF_SIZE;
+    if ((stream->out_buff=(char *)fc_malloc(stream->out_size)) == NULL) {
+        return ENOMEM;
+    }
+    if ((result=fc_compress_init_ctx(stream, level)) != 0) {
+        fc_compress_stream_abort(stream);
+        return result;
+    }
+
+    if ((stream->fd=open(filename, O_WRONLY | O_CREAT | O_TRUNC |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        result = errno != 0 ? errno : EACCES;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s\n",
+                __LINE__, filename, result, STRERROR(result));
+        fc_compress_stream_abort(stream);
+        return result;
+    }
+
+    return 0;
+}
+
+static int fc_compress_write_out(FCCompressStream *stream, const int len)
+{
+    int result;
+
+    if (len == 0) {
+        return 0;
+    }
+    if (fc_safe_write(stream->fd, stream->out_buff, len) != len) {
+        result = errno != 0 ? errno : EIO;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "write compressed data fail, errno: %d, error info: %s\n",
+                __LINE__, result, STRERROR(result));
+        return result;
+    }
+
+    stream->out_bytes += len;
+    return 0;
+}
+
+static int fc_compress_do(FCCompressStream *stream, const char *buff,
+        const int len, const bool finish)
+{
+    int result;
+
+    stream->in_bytes += len;
+    switch (stream->method) {
+#ifdef USE_ZLIB
+        case FC_COMPRESS_METHOD_GZIP:
+        {
+            z_stream *zs;
+            int ret;
+
+            zs = (z_stream *)stream->ctx;
+            zs->next_in = (Bytef *)buff;
+            zs->avail_in = len;
+            while (1) {
+                zs->next_out = (Bytef *)stream->out_buff;
+                zs->avail_out = stream->out_size;
+                ret = deflate(zs, finish ? Z_FINISH : Z_NO_FLUSH);
+                if (ret == Z_STREAM_ERROR) {
+                    return EIO;
+                }
+                if ((result=fc_compress_write_out(stream, stream->out_size -
+                                zs->avail_out)) != 0)
+                {
+                    return result;
+                }
+
+                if (finish) {
+                    if (ret == Z_STREAM_END) {
+                        break;
+                    }
+                } else if (zs->avail_out != 0) {
+                    break;
+                }
+            }
+            return 0;
+        }
+#endif
+#ifdef USE_ZSTD
+        case FC_COMPRESS_METHOD_ZSTD:
+        {
+            ZSTD_inBuffer input;
+            ZSTD_outBuffer output;
+            size_t remaining;
+
+            input.src = buff;
+            input.size = len;
+            input.pos = 0;
+            while (input.pos < input.size) {
+                output.dst = stream->out_buff;
+                output.size = stream->out_size;
+                output.pos = 0;
+                if (ZSTD_isError(ZSTD_compressStream((ZSTD_CStream *)
+                                stream->ctx, &output, &input)))
+                {
+                    return EIO;
+                }
+                if ((result=fc_compress_write_out(stream, output.pos)) != 0) {
+                    return result;
+                }
+            }
+
+            if (finish) {
+                do {
+                    output.dst = stream->out_buff;
+                    output.size = stream->out_size;
+                    output.pos = 0;
+                    remaining = ZSTD_endStream((ZSTD_CStream *)
+                            stream->ctx, &output);
+                    if (ZSTD_isError(remaining)) {
+                        return EIO;
+                    }
+                    if ((result=fc_compress_write_out(stream,
+                                    output.pos)) != 0)
+                    {
+                        return result;
+                    }
+                } while (remaining > 0);
+            }
+            return 0;
+        }
+#endif
+        default:
+            return EOPNOTSUPP;
+    }
+}
+
+int fc_compress_stream_write(FCCompressStream *stream,
+        const char *buff, const int len)
+{
+    if (stream->ctx == NULL) {
+        return EINVAL;
+    }
+    return fc_compress_do(stream, buff, len, false);
+}
+
+int fc_compress_stream_writev(FCCompressStream *stream,
+        const struct iovec *iov, const int iovcnt)
+{
+    int result;
+    int i;
+
+    for (i=0; i<iovcnt; i++) {
+        if ((result=fc_compress_stream_write(stream, (const char *)
+                        iov[i].iov_base, iov[i].iov_len)) != 0)
+        {
+            return result;
+        }
+    }
+    return 0;
+}
+
+int fc_compress_stream_close(FCCompressStream *stream)
+{
+    int result;
+
+    if (stream->ctx == NULL) {
+        fc_compress_stream_abort(stream);
+        return EINVAL;
+    }
+
+    result = fc_compress_do(stream, NULL, 0, true);
+    if (result == 0 && close(stream->fd) != 0) {
+        result = errno != 0 ? errno : EIO;
+    }
+    if (result == 0) {
+        stream->fd = -1;
+    }
+    fc_compress_stream_abort(stream);
+    return result;
+}
+
+void fc_compress_stream_abort(FCCompressStream *stream)
+{
+    fc_compress_free_ctx(stream);
+    if (stream->fd >= 0) {
+        close(stream->fd);
+        stream->fd = -1;
+    }
+    if (stream->out_buff != NULL) {
+        free(stream->out_buff);
+        stream->out_buff = NULL;
+    }
+}
+
+static int64_t fc_compress_thread_cpu_us()
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* sleep for the throughput and the CPU time limits */
+static void fc_compress_throttle(const FCCompressThrottle *throttle,
+        const int64_t start_us, const int64_t start_cpu_us,
+        const int64_t in_bytes)
+{
+    int64_t elapsed;
+    int64_t expect;
+    int64_t sleep_us;
+
+    elapsed = get_current_time_us() - start_us;
+    sleep_us = 0;
+    if (throttle->max_bytes_per_second > 0) {
+        expect = in_bytes * 1000000 / throttle->max_bytes_per_second;
+        if (expect > elapsed) {
+            sleep_us = expect - elapsed;
+        }
+    }
+
+    if (throttle->max_cpu_percent > 0 && throttle->max_cpu_percent < 100) {
+        expect = (fc_compress_thread_cpu_us() - start_cpu_us) *
+            100 / throttle->max_cpu_percent;
+        if (expect - elapsed > sleep_us) {
+            sleep_us = expect - elapsed;
+        }
+    }
+
+    if (sleep_us > 0) {
+        fc_sleep_us(sleep_us < FC_COMPRESS_MAX_SLEEP_US ?
+                sleep_us : FC_COMPRESS_MAX_SLEEP_US);
+    }
+}
+
+int fc_compress_file(const char *src_filename, const char *dest_filename,
+        const int method, const int level,
+        const FCCompressThrottle *throttle)
+{
+    FCCompressStream stream;
+    char tmp_filename[PATH_MAX];
+    struct stat st;
+    struct timeval times[2];
+    char *buff;
+    int64_t start_us;
+    int64_t start_cpu_us;
+    int fd;
+    int bytes;
+    int result;
+
+    if ((fd=open(src_filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s\n",
+                __LINE__, src_filename, result, STRERROR(result));
+        return result;
+    }
+    if (fstat(fd, &st) != 0 || (buff=(char *)fc_malloc(
+                    FC_COMPRESS_READ_BUFF_SIZE)) == NULL)
+    {
+        result = errno != 0 ? errno : ENOMEM;
+        close(fd);
+        return result;
+    }
+
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s%s",
+            dest_filename, FC_COMPRESS_TMP_EXT_STR);
+    if ((result=fc_compress_stream_open(&stream, tmp_filename,
+                    method, level)) != 0)
+    {
+        free(buff);
+        close(fd);
+        return result;
+    }
+
+    start_us = get_current_time_us();
+    start_cpu_us = fc_compress_thread_cpu_us();
+    while ((bytes=read(fd, buff, FC_COMPRESS_READ_BUFF_SIZE)) != 0) {
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = errno != 0 ? errno : EIO;
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "read file %s fail, errno: %d, error info: %s\n",
+                    __LINE__, src_filename, result, STRERROR(result));
+            break;
+        }
+
+        if ((result=fc_compress_stream_write(&stream, buff, bytes)) != 0) {
+            break;
+        }
+        if (throttle != NULL) {
+            fc_compress_throttle(throttle, start_us,
+                    start_cpu_us, stream.in_bytes);
+        }
+    }
+    free(buff);
+    close(fd);
+
+    if (result == 0) {
+        result = fc_compress_stream_close(&stream);
+    } else {
+        fc_compress_stream_abort(&stream);
+    }
+
+    if (result == 0) {
+        times[0].tv_sec = st.st_atime;
+        times[0].tv_usec = 0;
+        times[1].tv_sec = st.st_mtime;
+        times[1].tv_usec = 0;
+        utimes(tmp_filename, times);
+        if (rename(tmp_filename, dest_filename) != 0) {
+            result = errno != 0 ? errno : EPERM;
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "rename %s to %s fail, errno: %d, error info: %s\n",
+                    __LINE__, tmp_filename, dest_filename,
+                    result, STRERROR(result));
+        }
+    }
+
+    if (result != 0) {
+        unlink(tmp_filename);
+    }
+    return result;
+}
+
+int fc_compress_worker_set_config(const FCCompressWorkerConfig *config)
+{
+    int result;
+
+    pthread_mutex_lock(&compress_worker.lcp.lock);
+    if (compress_worker.started) {
+        result = EBUSY;
+    } else {
+        compress_worker.config = *config;
+        if (compress_worker.config.queue_size <= 0) {
+            compress_worker.config.queue_size =
+                FC_COMPRESS_DEFAULT_QUEUE_SIZE;
+        }
+        result = 0;
+    }
+    pthread_mutex_unlock(&compress_worker.lcp.lock);
+    return result;
+}
+
+static void fc_compress_worker_do(FCCompressTask *task)
+{
+    char dest_filename[PATH_MAX];
+    struct stat st;
+    int64_t in_bytes;
+    int result;
+
+    in_bytes = (stat(task->filename, &st) == 0) ? st.st_size : 0;
+    snprintf(dest_filename, sizeof(dest_filename), "%s%s",
+            task->filename, fc_compress_get_ext(task->method));
+    result = fc_compress_file(task->filename, dest_filename,
+            task->method, task->level,
+            &compress_worker.config.throttle);
+    if (result == 0) {
+        unlink(task->filename);
+    }
+
+    pthread_mutex_lock(&compress_worker.lcp.lock);
+    if (result == 0) {
+        compress_worker.stats.success_count++;
+        compress_worker.stats.in_bytes += in_bytes;
+        if (stat(dest_filename, &st) == 0) {
+            compress_worker.stats.out_bytes += st.st_size;
+        }
+    } else {
+        compress_worker.stats.fail_count++;
+    }
+    compress_worker.current = NULL;
+    compress_worker.stats.pending_count--;
+    pthread_cond_broadcast(&compress_worker.lcp.cond);
+    pthread_mutex_unlock(&compress_worker.lcp.lock);
+}
+
+static void *fc_compress_worker_func(void *arg)
+{
+    FCCompressTask *task;
+
+    while (1) {
+        pthread_mutex_lock(&compress_worker.lcp.lock);
+        while (compress_worker.head == NULL) {
+            pthread_cond_wait(&compress_worker.lcp.cond,
+                    &compress_worker.lcp.lock);
+        }
+        task = compress_worker.head;
+        compress_worker.head = task->next;
+        if (compress_worker.head == NULL) {
+            compress_worker.tail = NULL;
+        }
+        compress_worker.current = task;
+        pthread_mutex_unlock(&compress_worker.lcp.lock);
+
+        fc_compress_worker_do(task);
+        free(task);
+    }
+
+    return NULL;
+}
+
+static bool fc_compress_worker_exists(const char *filename)
+{
+    FCCompressTask *task;
+
+    if (compress_worker.current != NULL && strcmp(compress_worker.
+                current->filename, filename) == 0)
+    {
+        return true;
+    }
+
+    for (task=compress_worker.head; task!=NULL; task=task->next) {
+        if (strcmp(task->filename, filename) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int fc_compress_worker_submit(const char *filename, const int method)
+{
+    return fc_compress_worker_submit_ex(filename, method,
+            compress_worker.config.level);
+}
+
+int fc_compress_worker_submit_ex(const char *filename,
+        const int method, const int level)
+{
+    FCCompressTask *task;
+    pthread_t tid;
+    pthread_attr_t thread_attr;
+    int result;
+    int len;
+
+    if (!fc_compress_method_supported(method)) {
+        return EOPNOTSUPP;
+    }
+
+    pthread_mutex_lock(&compress_worker.lcp.lock);
+    do {
+        if (compress_worker.stats.pending_count >=
+                compress_worker.config.queue_size)
+        {
+            result = EAGAIN;
+            break;
+        }
+        if (fc_compress_worker_exists(filename)) {
+            result = EEXIST;
+            break;
+        }
+
+        if (!compress_worker.started) {
+            if ((result=init_pthread_attr(&thread_attr, 0)) != 0) {
+                break;
+            }
+            if ((result=pthread_create(&tid, &thread_attr,
+                            fc_compress_worker_func, NULL)) != 0)
+            {
+                fprintf(stderr, "file: "__FILE__", line: %d, "
+                        "create thread failed, errno: %d, error info: %s\n",
+                        __LINE__, result, STRERROR(result));
+                pthread_attr_destroy(&thread_attr);
+                break;
+            }
+            pthread_attr_destroy(&thread_attr);
+            compress_worker.started = true;
+        }
+
+        len = strlen(filename);
+        if ((task=(FCCompressTask *)fc_malloc(sizeof(FCCompressTask) +
+                        len + 1)) == NULL)
+        {
+            result = ENOMEM;
+            break;
+        }
+        task->next = NULL;
+        task->method = method;
+        task->level = level;
+        memcpy(task->filename, filename, len + 1);
+        if (compress_worker.tail == NULL) {
+            compress_worker.head = task;
+        } else {
+            compress_worker.tail->next = task;
+        }
+        compress_worker.tail = task;
+        compress_worker.stats.submit_count++;
+        compress_worker.stats.pending_count++;
+        pthread_cond_broadcast(&compress_worker.lcp.cond);
+        result = 0;
+    } while (0);
+    pthread_mutex_unlock(&compress_worker.lcp.lock);
+
+    return result;
+}
+
+int fc_compress_worker_wait(const int timeout_ms)
+{
+    struct timespec ts;
+    int64_t expire_us;
+    int result;
+
+    expire_us = get_current_time_us() + (int64_t)timeout_ms * 1000;
+    ts.tv_sec = expire_us / 1000000;
+    ts.tv_nsec = (expire_us % 1000000) * 1000;
+
+    result = 0;
+    pthread_mutex_lock(&compress_worker.lcp.lock);
+    while (compress_worker.stats.pending_count > 0) {
+        if ((result=pthread_cond_timedwait(&compress_worker.lcp.cond,
+                        &compress_worker.lcp.lock, &ts)) == ETIMEDOUT)
+        {
+            break;
+        }
+        result = 0;
+    }
+    pthread_mutex_unlock(&compress_worker.lcp.lock);
+
+    return result;
+}
+
+void fc_compress_worker_get_stats(FCCompressWorkerStats *stats)
+{
+    pthread_mutex_lock(&compress_worker.lcp.lock);
+    *stats = compress_worker.stats;
+    pthread_mutex_unlock(&compress_worker.lcp.lock);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_compress.h: in-process streaming compression by zlib (gzip format)
+//               and zstd, and the throttled background compress worker
+
+#ifndef _FC_COMPRESS_H
+#define _FC_COMPRESS_H
+
+#include <sys/uio.h>
+#include "common_define.h"
+
+#define FC_COMPRESS_METHOD_GZIP  1
+#define FC_COMPRESS_METHOD_ZSTD  2
+
+#define FC_COMPRESS_GZIP_EXT_STR  ".gz"
+#define FC_COMPRESS_ZSTD_EXT_STR  ".zst"
+#define FC_COMPRESS_TMP_EXT_STR   ".tmp"
+
+#define FC_COMPRESS_DEFAULT_LEVEL  -1   //the default level of the method
+
+#define FC_COMPRESS_DEFAULT_QUEUE_SIZE        256
+#define FC_COMPRESS_DEFAULT_BYTES_PER_SECOND  (64 * 1024 * 1024)
+#define FC_COMPRESS_DEFAULT_CPU_PERCENT       50
+
+typedef struct fc_compress_stream {
+    int method;
+    int fd;
+    void *ctx;         //z_stream or ZSTD_CStream
+    char *out_buff;
+    int out_size;
+    int64_t in_bytes;
+    int64_t out_bytes;
+} FCCompressStream;
+
+typedef struct fc_compress_throttle {
+    int64_t max_bytes_per_second;  //0 for no limit
+    int max_cpu_percent;           //the CPU time of the thread, 0 for no limit
+} FCCompressThrottle;
+
+typedef struct fc_compress_worker_config {
+    int queue_size;    //the max pending files
+    int level;         //the level of fc_compress_worker_submit
+    FCCompressThrottle throttle;
+} FCCompressWorkerConfig;
+
+typedef struct fc_compress_worker_stats {
+    int64_t submit_count;
+    int64_t success_count;
+    int64_t fail_count;
+    int64_t in_bytes;
+    int64_t out_bytes;
+    int pending_count;
+} FCCompressWorkerStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** check if the compress method is built in
+ *  parameters:
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *  return: true for supported
+ */
+bool fc_compress_method_supported(const int method);
+
+/** get the filename extension of the compress method
+ *  parameters:
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *  return: the extension such as ".gz"
+ */
+static inline const char *fc_compress_get_ext(const int method)
+{
+    return (method == FC_COMPRESS_METHOD_ZSTD) ?
+        FC_COMPRESS_ZSTD_EXT_STR : FC_COMPRESS_GZIP_EXT_STR;
+}
+
+/** open the compress stream to write the compressed file
+ *  parameters:
+ *      stream: the compress stream
+ *      filename: the compressed filename to create
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *      level: the compress level, FC_COMPRESS_DEFAULT_LEVEL for default
+ *  return: error no, 0 for success, EOPNOTSUPP for the method not built in
+ */
+int fc_compress_stream_open(FCCompressStream *stream, const char *filename,
+        const int method, const int level);
+
+/** compress and write the data
+ *  parameters:
+ *      stream: the compress stream
+ *      buff: the data buffer
+ *      len: the data length
+ *  return: error no, 0 for success
+ */
+int fc_compress_stream_write(FCCompressStream *stream,
+        const char *buff, const int len);
+
+/** compress and write the data of the iovec array
+ *  parameters:
+ *      stream: the compress stream
+ *      iov: the iovec array
+ *      iovcnt: the iovec count
+ *  return: error no, 0 for success
+ */
+int fc_compress_stream_writev(FCCompressStream *stream,
+        const struct iovec *iov, const int iovcnt);
+
+/** finish the compressed data and close the file
+ *  parameters:
+ *      stream: the compress stream
+ *  return: error no, 0 for success
+ */
+int fc_compress_stream_close(FCCompressStream *stream);
+
+/** close the stream without finishing, the file is incomplete
+ *  parameters:
+ *      stream: the compress stream
+ *  return: none
+ */
+void fc_compress_stream_abort(FCCompressStream *stream);
+
+/** compress the file to the dest file by the temp file and rename,
+ *  keep the modify time of the source file
+ *  parameters:
+ *      src_filename: the source filename
+ *      dest_filename: the dest filename
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *      level: the compress level, FC_COMPRESS_DEFAULT_LEVEL for default
+ *      throttle: the throttle, NULL for no limit
+ *  return: error no, 0 for success
+ */
+int fc_compress_file(const char *src_filename, const char *dest_filename,
+        const int method, const int level,
+        const FCCompressThrottle *throttle);
+
+/** set the config of the compress worker, must be called before
+ *  the first submit
+ *  parameters:
+ *      config: the worker config
+ *  return: error no, 0 for success, EBUSY for the worker started
+ */
+int fc_compress_worker_set_config(const FCCompressWorkerConfig *config);
+
+/** submit the file to the compress worker, the worker thread starts
+ *  on the first submit, the file is removed after compressed
+ *  parameters:
+ *      filename: the file to compress
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *  return: error no, 0 for success, EAGAIN for the queue full,
+ *          EEXIST for the file already in the queue
+ */
+int fc_compress_worker_submit(const char *filename, const int method);
+
+/** submit the file to the compress worker with the compress level
+ *  parameters:
+ *      filename: the file to compress
+ *      method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *      level: the compress level, FC_COMPRESS_DEFAULT_LEVEL for default
+ *  return: error no, 0 for success, EAGAIN for the queue full,
+ *          EEXIST for the file already in the queue
+ */
+int fc_compress_worker_submit_ex(const char *filename,
+        const int method, const int level);
+
+/** wait for the pending files done
+ *  parameters:
+ *      timeout_ms: the timeout in milliseconds
+ *  return: error no, 0 for success, ETIMEDOUT for timeout
+ */
+int fc_compress_worker_wait(const int timeout_ms);
+
+/** get the stats of the compress worker
+ *  parameters:
+ *      stats: store the stats
+ *  return: none
+ */
+void fc_compress_worker_get_stats(FCCompressWorkerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
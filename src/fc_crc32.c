@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "fc_crc32.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FC_CRC32_X86_KERNELS  1
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define FC_CRC32_SLICING_KERNELS  1
+#endif
+
+#define CRC32_POLY   0xEDB88320   //reflected 0x04C11DB7
+#define CRC32C_POLY  0x82F63B78   //reflected 0x1EDC6F41
+
+/* the slicing-by-N algorithm from Intel: tables[k][n] is the crc of
+ * the byte n followed by k zero bytes */
+typedef uint32_t CRC32Tables[16][256];
+
+static CRC32Tables crc32_tables;
+static CRC32Tables crc32c_tables;
+
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+static fc_crc32_kernel_func crc32_kernel = NULL;
+static fc_crc32_kernel_func crc32c_kernel = NULL;
+static int crc32_kernel_id = FC_CRC32_KERNEL_BYTE;
+static int crc32c_kernel_id = FC_CRC32_KERNEL_BYTE;
+
+static void crc32_init_tables(CRC32Tables tables, const uint32_t poly)
+{
+    uint32_t crc;
+    int n;
+    int k;
+
+    for (n=0; n<256; n++) {
+        crc = n;
+        for (k=0; k<8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1);
+        }
+        tables[0][n] = crc;
+    }
+
+    for (n=0; n<256; n++) {
+        crc = tables[0][n];
+        for (k=1; k<16; k++) {
+            crc = (crc >> 8) ^ tables[0][crc & 0xFF];
+            tables[k][n] = crc;
+        }
+    }
+}
+
+static inline uint32_t crc32_byte_loop(CRC32Tables tables, uint32_t crc,
+        const unsigned char *p, const unsigned char *end)
+{
+    while (p < end) {
+        crc = tables[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef FC_CRC32_SLICING_KERNELS
+static inline uint32_t crc32_load32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#define CRC32_SLICE4(tables, base, v) \
+    (tables[base + 3][(v) & 0xFF] ^ tables[base + 2][((v) >> 8) & 0xFF] ^ \
+     tables[base + 1][((v) >> 16) & 0xFF] ^ tables[base][(v) >> 24])
+
+static inline uint32_t crc32_slicing8(CRC32Tables tables, uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    uint32_t one;
+    uint32_t two;
+
+    p = (const unsigned char *)buff;
+    end = p + len;
+    while (end - p >= 8) {
+        one = crc32_load32(p) ^ crc;
+        two = crc32_load32(p + 4);
+        crc = CRC32_SLICE4(tables, 4, one) ^ CRC32_SLICE4(tables, 0, two);
+        p += 8;
+    }
+    return crc32_byte_loop(tables, crc, p, end);
+}
+
+static inline uint32_t crc32_slicing16(CRC32Tables tables, uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    uint32_t one;
+    uint32_t two;
+    uint32_t three;
+    uint32_t four;
+
+    p = (const unsigned char *)buff;
+    end = p + len;
+    while (end - p >= 16) {
+        one = crc32_load32(p) ^ crc;
+        two = crc32_load32(p + 4);
+        three = crc32_load32(p + 8);
+        four = crc32_load32(p + 12);
+        crc = CRC32_SLICE4(tables, 12, one) ^ CRC32_SLICE4(tables, 8, two) ^
+            CRC32_SLICE4(tables, 4, three) ^ CRC32_SLICE4(tables, 0, four);
+        p += 16;
+    }
+    return crc32_byte_loop(tables, crc, p, end);
+}
+
+static uint32_t crc32_kernel_slicing8(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_slicing8(crc32_tables, crc, buff, len);
+}
+
+static uint32_t crc32_kernel_slicing16(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_slicing16(crc32_tables, crc, buff, len);
+}
+
+static uint32_t crc32c_kernel_slicing8(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_slicing8(crc32c_tables, crc, buff, len);
+}
+
+static uint32_t crc32c_kernel_slicing16(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_slicing16(crc32c_tables, crc, buff, len);
+}
+
+#define CRC32_TAIL_KERNEL   crc32_kernel_slicing16
+#else
+#define CRC32_TAIL_KERNEL   crc32_kernel_byte
+#endif
+
+static uint32_t crc32_kernel_byte(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_byte_loop(crc32_tables, crc, (const unsigned char *)buff,
+            (const unsigned char *)buff + len);
+}
+
+static uint32_t crc32c_kernel_byte(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    return crc32_byte_loop(crc32c_tables, crc, (const unsigned char *)buff,
+            (const unsigned char *)buff + len);
+}
+
+#ifdef FC_CRC32_X86_KERNELS
+
+/* fold 64 bytes per round with carry-less multiplication, then reduce
+ * by Barrett, refer to Intel white paper "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction".
+ * len MUST be a multiple of 16 and >= 64 */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t crc,
+        const unsigned char *buf, int64_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(
+                    (const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(
+                    (const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(
+                    (const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(
+                    (const __m128i *)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    //fold 4 x 128 bits into 128 bits
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    //fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    //Barrett reduce to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_kernel_pclmul(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    int64_t fold_len;
+
+    if (len < 64) {
+        return CRC32_TAIL_KERNEL(crc, buff, len);
+    }
+
+    fold_len = len & ~((int64_t)15);
+    crc = crc32_pclmul_fold(crc, (const unsigned char *)buff, fold_len);
+    return CRC32_TAIL_KERNEL(crc, (const unsigned char *)buff +
+            fold_len, len - fold_len);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_kernel_sse42(uint32_t crc,
+        const void *buff, const int64_t len)
+{
+    const unsigned char *p;
+    const unsigned char *end;
+
+    p = (const unsigned char *)buff;
+    end = p + len;
+    while (p < end && ((uintptr_t)p & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+
+#if defined(__x86_64__)
+    {
+        uint64_t crc64;
+        crc64 = crc;
+        while (end - p >= 32) {
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)p);
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)(p + 8));
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)(p + 16));
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)(p + 24));
+            p += 32;
+        }
+        while (end - p >= 8) {
+            crc64 = _mm_crc32_u64(crc64, *(const uint64_t *)p);
+            p += 8;
+        }
+        crc = (uint32_t)crc64;
+    }
+#else
+    while (end - p >= 4) {
+        crc = _mm_crc32_u32(crc, *(const uint32_t *)p);
+        p += 4;
+    }
+#endif
+
+    while (p < end) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+#endif
+
+static fc_crc32_kernel_func crc32_get_kernel(const bool castagnoli,
+        const int kernel)
+{
+    switch (kernel) {
+        case FC_CRC32_KERNEL_BYTE:
+            return castagnoli ? crc32c_kernel_byte : crc32_kernel_byte;
+#ifdef FC_CRC32_SLICING_KERNELS
+        case FC_CRC32_KERNEL_SLICING8:
+            return castagnoli ? crc32c_kernel_slicing8 :
+                crc32_kernel_slicing8;
+        case FC_CRC32_KERNEL_SLICING16:
+            return castagnoli ? crc32c_kernel_slicing16 :
+                crc32_kernel_slicing16;
+#endif
+#ifdef FC_CRC32_X86_KERNELS
+        case FC_CRC32_KERNEL_PCLMUL:
+            if (!castagnoli && __builtin_cpu_supports("pclmul") &&
+                    __builtin_cpu_supports("sse4.1"))
+            {
+                return crc32_kernel_pclmul;
+            }
+            return NULL;
+        case FC_CRC32_KERNEL_SSE42:
+            if (castagnoli && __builtin_cpu_supports("sse4.2")) {
+                return crc32c_kernel_sse42;
+            }
+            return NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+static int crc32_choose_kernel(const bool castagnoli)
+{
+    const int kernels[] = {FC_CRC32_KERNEL_PCLMUL, FC_CRC32_KERNEL_SSE42,
+        FC_CRC32_KERNEL_SLICING16, FC_CRC32_KERNEL_BYTE};
+    int i;
+
+    for (i=0; i<sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (crc32_get_kernel(castagnoli, kernels[i]) != NULL) {
+            return kernels[i];
+        }
+    }
+    return FC_CRC32_KERNEL_BYTE;
+}
+
+static void crc32_global_init()
+{
+    crc32_init_tables(crc32_tables, CRC32_POLY);
+    crc32_init_tables(crc32c_tables, CRC32C_POLY);
+
+#ifdef FC_CRC32_X86_KERNELS
+    __builtin_cpu_init();
+#endif
+    crc32_kernel_id = crc32_choose_kernel(false);
+    crc32c_kernel_id = crc32_choose_kernel(true);
+    __atomic_store_n(&crc32c_kernel, crc32_get_kernel(
+                true, crc32c_kernel_id), __ATOMIC_RELEASE);
+    __atomic_store_n(&crc32_kernel, crc32_get_kernel(
+                false, crc32_kernel_id), __ATOMIC_RELEASE);
+}
+
+static inline fc_crc32_kernel_func crc32_load_kernel(
+        fc_crc32_kernel_func *kernel)
+{
+    fc_crc32_kernel_func func;
+
+    if ((func=__atomic_load_n(kernel, __ATOMIC_ACQUIRE)) == NULL) {
+        pthread_once(&crc32_once, crc32_global_init);
+        func = *kernel;
+    }
+    return func;
+}
+
+uint32_t fc_crc32_extend(uint32_t crc, const void *buff, const int64_t len)
+{
+    return crc32_load_kernel(&crc32_kernel)(crc, buff, len);
+}
+
+uint32_t fc_crc32c_extend(uint32_t crc, const void *buff, const int64_t len)
+{
+    return crc32_load_kernel(&crc32c_kernel)(crc, buff, len);
+}
+
+fc_crc32_kernel_func fc_crc32_get_kernel(const bool castagnoli,
+        const int kernel)
+{
+    pthread_once(&crc32_once, crc32_global_init);
+    return crc32_get_kernel(castagnoli, kernel);
+}
+
+int fc_crc32_current_kernel(const bool castagnoli)
+{
+    pthread_once(&crc32_once, crc32_global_init);
+    return castagnoli ? crc32c_kernel_id : crc32_kernel_id;
+}
+
+const char *fc_crc32_kernel_name(const int kernel)
+{
+    switch (kernel) {
+        case FC_CRC32_KERNEL_BYTE:
+            return "byte";
+        case FC_CRC32_KERNEL_SLICING8:
+            return "slicing-by-8";
+        case FC_CRC32_KERNEL_SLICING16:
+            return "slicing-by-16";
+        case FC_CRC32_KERNEL_PCLMUL:
+            return "pclmulqdq";
+        case FC_CRC32_KERNEL_SSE42:
+            return "sse4.2";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_crc32.h: CRC32 (IEEE 802.3) and CRC32C (Castagnoli) with the
+//            fastest kernel chosen at runtime by the CPU features
+
+#ifndef _FC_CRC32_H
+#define _FC_CRC32_H
+
+#include <stdint.h>
+#include "common_define.h"
+
+#define FC_CRC32_KERNEL_BYTE       0  //byte at a time table lookup
+#define FC_CRC32_KERNEL_SLICING8   1
+#define FC_CRC32_KERNEL_SLICING16  2
+#define FC_CRC32_KERNEL_PCLMUL     3  //CRC32 only, x86 PCLMULQDQ folding
+#define FC_CRC32_KERNEL_SSE42      4  //CRC32C only, x86 SSE4.2 crc32 instruction
+#define FC_CRC32_KERNEL_COUNT      5
+
+#define FC_CRC32_INIT_VALUE  0xFFFFFFFF
+#define FC_CRC32_XOR_VALUE   0xFFFFFFFF
+
+/* the kernel calculates the crc register without the init and final xor */
+typedef uint32_t (*fc_crc32_kernel_func)(uint32_t crc,
+        const void *buff, const int64_t len);
+
+typedef struct fc_crc32_context
+{
+    uint32_t crc;
+} FCCRC32Context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** update the crc register of CRC32 (IEEE 802.3, the same as CRC32_ex)
+ *  parameters:
+ *      crc: the crc register
+ *      buff: the data buffer
+ *      len: the data length
+ *  return: the new crc register
+ */
+uint32_t fc_crc32_extend(uint32_t crc, const void *buff, const int64_t len);
+
+/** update the crc register of CRC32C (Castagnoli)
+ *  parameters:
+ *      crc: the crc register
+ *      buff: the data buffer
+ *      len: the data length
+ *  return: the new crc register
+ */
+uint32_t fc_crc32c_extend(uint32_t crc, const void *buff, const int64_t len);
+
+/** get the kernel for benchmark and test
+ *  parameters:
+ *      castagnoli: true for CRC32C, false for CRC32
+ *      kernel: the kernel id, FC_CRC32_KERNEL_xxx
+ *  return: the kernel function, NULL when the CPU does not support
+ */
+fc_crc32_kernel_func fc_crc32_get_kernel(const bool castagnoli,
+        const int kernel);
+
+/** get the kernel id chosen at runtime
+ *  parameters:
+ *      castagnoli: true for CRC32C, false for CRC32
+ *  return: the kernel id, FC_CRC32_KERNEL_xxx
+ */
+int fc_crc32_current_kernel(const bool castagnoli);
+
+const char *fc_crc32_kernel_name(const int kernel);
+
+static inline uint32_t fc_crc32(const void *buff, const int64_t len)
+{
+    return fc_crc32_extend(FC_CRC32_INIT_VALUE, buff, len) ^
+        FC_CRC32_XOR_VALUE;
+}
+
+static inline uint32_t fc_crc32c(const void *buff, const int64_t len)
+{
+    return fc_crc32c_extend(FC_CRC32_INIT_VALUE, buff, len) ^
+        FC_CRC32_XOR_VALUE;
+}
+
+/* streaming CRC32 */
+static inline void fc_crc32_init(FCCRC32Context *ctx)
+{
+    ctx->crc = FC_CRC32_INIT_VALUE;
+}
+
+static inline void fc_crc32_update(FCCRC32Context *ctx,
+        const void *buff, const int64_t len)
+{
+    ctx->crc = fc_crc32_extend(ctx->crc, buff, len);
+}
+
+static inline uint32_t fc_crc32_final(FCCRC32Context *ctx)
+{
+    return ctx->crc ^ FC_CRC32_XOR_VALUE;
+}
+
+/* streaming CRC32C */
+static inline void fc_crc32c_init(FCCRC32Context *ctx)
+{
+    ctx->crc = FC_CRC32_INIT_VALUE;
+}
+
+static inline void fc_crc32c_update(FCCRC32Context *ctx,
+        const void *buff, const int64_t len)
+{
+    ctx->crc = fc_crc32c_extend(ctx->crc, buff, len);
+}
+
+static inline uint32_t fc_crc32c_final(FCCRC32Context *ctx)
+{
+    return ctx->crc ^ FC_CRC32_XOR_VALUE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
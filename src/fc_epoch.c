@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "logger.h"
+#include "pthread_func.h"
+#include "fc_memory.h"
+#include "fc_epoch.h"
+
+static void fc_epoch_thread_destroy(void *ptr)
+{
+    FCEpochThread *thread;
+
+    thread = (FCEpochThread *)ptr;
+    thread->nesting = 0;
+    __atomic_store_n(&thread->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&thread->in_use, false, __ATOMIC_RELEASE);
+}
+
+int fc_epoch_init(FCEpochContext *ctx, const int max_threads,
+        fc_epoch_free_func free_func, void *free_arg)
+{
+    int result;
+    int bytes;
+
+    memset(ctx, 0, sizeof(FCEpochContext));
+    if (max_threads <= 0) {
+        return EINVAL;
+    }
+
+    bytes = sizeof(FCEpochThread) * max_threads;
+    if ((ctx->threads=(FCEpochThread *)fc_malloc(bytes)) == NULL) {
+        return ENOMEM;
+    }
+    memset(ctx->threads, 0, bytes);
+
+    if ((result=fast_mblock_init_ex1(&ctx->retired_allocator,
+                    "epoch-retired", sizeof(FCEpochRetired), 4096,
+                    0, NULL, NULL, false)) != 0)
+    {
+        free(ctx->threads);
+        ctx->threads = NULL;
+        return result;
+    }
+
+    if ((result=init_pthread_lock(&ctx->lock)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "init_pthread_lock fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        fast_mblock_destroy(&ctx->retired_allocator);
+        free(ctx->threads);
+        ctx->threads = NULL;
+        return result;
+    }
+
+    if ((result=pthread_key_create(&ctx->tls_key,
+                    fc_epoch_thread_destroy)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "pthread_key_create fail, errno: %d, error info: %s",
+                __LINE__, result, STRERROR(result));
+        pthread_mutex_destroy(&ctx->lock);
+        fast_mblock_destroy(&ctx->retired_allocator);
+        free(ctx->threads);
+        ctx->threads = NULL;
+        return result;
+    }
+
+    ctx->max_threads = max_threads;
+    ctx->reclaim_threshold = FC_EPOCH_DEFAULT_RECLAIM_THRESHOLD;
+    ctx->free_func = free_func;
+    ctx->free_arg = free_arg;
+    ctx->global_epoch = 1;
+    return 0;
+}
+
+FCEpochThread *fc_epoch_register_thread(FCEpochContext *ctx)
+{
+    FCEpochThread *thread;
+    FCEpochThread *end;
+
+    end = ctx->threads + ctx->max_threads;
+    for (thread=ctx->threads; thread<end; thread++) {
+        if (!thread->in_use && __sync_bool_compare_and_swap(
+                    &thread->in_use, false, true))
+        {
+            thread->nesting = 0;
+            thread->state = 0;
+            pthread_setspecific(ctx->tls_key, thread);
+            return thread;
+        }
+    }
+
+    logError("file: "__FILE__", line: %d, "
+            "too many threads, exceeds max threads: %d",
+            __LINE__, ctx->max_threads);
+    return NULL;
+}
+
+static void fc_epoch_free_chain(FCEpochContext *ctx, FCEpochRetired *head)
+{
+    FCEpochRetired *retired;
+
+    while (head != NULL) {
+        retired = head;
+        head = head->next;
+        ctx->free_func(retired->ptr, ctx->free_arg);
+        fast_mblock_free_object(&ctx->retired_allocator, retired);
+        ctx->retired_count--;
+    }
+}
+
+/* the caller MUST hold the lock */
+static bool fc_epoch_try_advance(FCEpochContext *ctx)
+{
+    FCEpochThread *thread;
+    FCEpochThread *end;
+    int64_t epoch;
+    int64_t state;
+    int index;
+
+    epoch = ctx->global_epoch;
+    end = ctx->threads + ctx->max_threads;
+    for (thread=ctx->threads; thread<end; thread++) {
+        state = __atomic_load_n(&thread->state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return false;
+        }
+    }
+
+    __atomic_store_n(&ctx->global_epoch, epoch + 1, __ATOMIC_RELEASE);
+
+    /* all active readers entered at epoch, so the objects retired
+     * at epoch - 1 can't be referenced any more */
+    index = (epoch + 2) % FC_EPOCH_LIMBO_COUNT;
+    fc_epoch_free_chain(ctx, ctx->limbo[index]);
+    ctx->limbo[index] = NULL;
+    return true;
+}
+
+int fc_epoch_retire(FCEpochContext *ctx, void *ptr)
+{
+    FCEpochRetired *retired;
+    int index;
+
+    PTHREAD_MUTEX_LOCK(&ctx->lock);
+    if ((retired=(FCEpochRetired *)fast_mblock_alloc_object(
+                    &ctx->retired_allocator)) == NULL)
+    {
+        PTHREAD_MUTEX_UNLOCK(&ctx->lock);
+        return ENOMEM;
+    }
+
+    index = ctx->global_epoch % FC_EPOCH_LIMBO_COUNT;
+    retired->ptr = ptr;
+    retired->next = ctx->limbo[index];
+    ctx->limbo[index] = retired;
+    if (++ctx->retired_count >= ctx->reclaim_threshold) {
+        fc_epoch_try_advance(ctx);
+    }
+    PTHREAD_MUTEX_UNLOCK(&ctx->lock);
+    return 0;
+}
+
+bool fc_epoch_reclaim(FCEpochContext *ctx)
+{
+    bool advanced;
+
+    PTHREAD_MUTEX_LOCK(&ctx->lock);
+    advanced = fc_epoch_try_advance(ctx);
+    PTHREAD_MUTEX_UNLOCK(&ctx->lock);
+    return advanced;
+}
+
+void fc_epoch_destroy(FCEpochContext *ctx)
+{
+    int i;
+
+    if (ctx->threads == NULL) {
+        return;
+    }
+
+    for (i=0; i<FC_EPOCH_LIMBO_COUNT; i++) {
+        fc_epoch_free_chain(ctx, ctx->limbo[i]);
+        ctx->limbo[i] = NULL;
+    }
+
+    pthread_key_delete(ctx->tls_key);
+    pthread_mutex_destroy(&ctx->lock);
+    fast_mblock_destroy(&ctx->retired_allocator);
+    free(ctx->threads);
+    ctx->threads = NULL;
+}
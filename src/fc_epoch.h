@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_epoch.h: epoch based reclamation for lock-free readers
+
+#ifndef _FC_EPOCH_H
+#define _FC_EPOCH_H
+
+#include <pthread.h>
+#include "common_define.h"
+#include "fast_mblock.h"
+
+#define FC_EPOCH_LIMBO_COUNT  3
+#define FC_EPOCH_DEFAULT_RECLAIM_THRESHOLD  64
+
+typedef void (*fc_epoch_free_func)(void *ptr, void *arg);
+
+typedef struct fc_epoch_thread
+{
+    volatile int64_t state;  //epoch * 2 + 1 when active, 0 for quiescent
+    int nesting;             //the nesting level of the read side section
+    volatile bool in_use;
+    char padding[64 - sizeof(int64_t) - sizeof(int) - sizeof(bool)];
+} FCEpochThread;
+
+typedef struct fc_epoch_retired
+{
+    void *ptr;
+    struct fc_epoch_retired *next;
+} FCEpochRetired;
+
+typedef struct fc_epoch_context
+{
+    volatile int64_t global_epoch;
+    int max_threads;
+    int reclaim_threshold;  //try to advance the epoch when exceeds
+    int retired_count;
+    FCEpochThread *threads;
+    pthread_key_t tls_key;
+    pthread_mutex_t lock;   //for the limbo lists and epoch advance
+    FCEpochRetired *limbo[FC_EPOCH_LIMBO_COUNT];
+    struct fast_mblock_man retired_allocator;
+    fc_epoch_free_func free_func;
+    void *free_arg;
+} FCEpochContext;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** init the epoch context
+ *  parameters:
+ *      ctx: the epoch context
+ *      max_threads: the max reader and writer threads
+ *      free_func: the function to free the retired object
+ *      free_arg: the extra argument of free_func
+ *  return: 0 for success, != 0 for error
+ */
+int fc_epoch_init(FCEpochContext *ctx, const int max_threads,
+        fc_epoch_free_func free_func, void *free_arg);
+
+/** destroy the epoch context and free all retired objects,
+ *  there MUST be no active reader
+ *  parameters:
+ *      ctx: the epoch context
+ *  return: none
+ */
+void fc_epoch_destroy(FCEpochContext *ctx);
+
+FCEpochThread *fc_epoch_register_thread(FCEpochContext *ctx);
+
+static inline FCEpochThread *fc_epoch_get_thread(FCEpochContext *ctx)
+{
+    FCEpochThread *thread;
+
+    if ((thread=(FCEpochThread *)pthread_getspecific(
+                    ctx->tls_key)) != NULL)
+    {
+        return thread;
+    }
+    return fc_epoch_register_thread(ctx);
+}
+
+/** enter the read side critical section (can be nested), the objects
+ *  retired after entering are NOT freed until fc_epoch_exit
+ *  parameters:
+ *      ctx: the epoch context
+ *  return: 0 for success, ENOSPC for too many threads
+ */
+static inline int fc_epoch_enter(FCEpochContext *ctx)
+{
+    FCEpochThread *thread;
+
+    if ((thread=fc_epoch_get_thread(ctx)) == NULL) {
+        return ENOSPC;
+    }
+
+    if (thread->nesting++ == 0) {
+        thread->state = __atomic_load_n(&ctx->global_epoch,
+                __ATOMIC_ACQUIRE) * 2 + 1;
+        //the announcement MUST be visible before reading the shared data
+        __sync_synchronize();
+    }
+    return 0;
+}
+
+/** exit the read side critical section
+ *  parameters:
+ *      ctx: the epoch context
+ *  return: none
+ */
+static inline void fc_epoch_exit(FCEpochContext *ctx)
+{
+    FCEpochThread *thread;
+
+    thread = (FCEpochThread *)pthread_getspecific(ctx->tls_key);
+    if (--thread->nesting == 0) {
+        __atomic_store_n(&thread->state, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/** retire the object which is unlinked from the shared data structure,
+ *  it will be freed after all the readers which maybe access it exit
+ *  parameters:
+ *      ctx: the epoch context
+ *      ptr: the object to retire
+ *  return: 0 for success, != 0 for error
+ */
+int fc_epoch_retire(FCEpochContext *ctx, void *ptr);
+
+/** try to advance the global epoch and free the safe objects
+ *  parameters:
+ *      ctx: the epoch context
+ *  return: true for advanced, false when some reader lags behind
+ */
+bool fc_epoch_reclaim(FCEpochContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
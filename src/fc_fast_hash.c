@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "fc_fast_hash.h"
+
+#define PRIME32_1  0x9E3779B1U
+#define PRIME32_2  0x85EBCA77U
+#define PRIME32_3  0xC2B2AE3DU
+#define PRIME32_4  0x27D4EB2FU
+#define PRIME32_5  0x165667B1U
+
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+
+#define PRIME_MX1  0x165667919E3779F9ULL
+#define PRIME_MX2  0x9FB21C651E98DF25ULL
+
+#define XXH3_SECRET_SIZE      192
+#define XXH3_STRIPE_LEN        64
+#define XXH3_ACC_NB             8
+#define XXH3_MIDSIZE_MAX      240
+#define XXH3_SECRET_CONSUME_RATE  8
+
+#define ROTL32(x, r)  (((x) << (r)) | ((x) >> (32 - (r))))
+#define ROTL64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+static const unsigned char xxh3_secret[XXH3_SECRET_SIZE]
+__attribute__((aligned(64))) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint32_t read_le32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t read_le64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline void write_le64(unsigned char *p, uint64_t v)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+/* the full 128 bits product of two 64 bits integers */
+static inline void mul128(const uint64_t a, const uint64_t b,
+        uint64_t *lo, uint64_t *hi)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r;
+    r = (__uint128_t)a * b;
+    *lo = (uint64_t)r;
+    *hi = (uint64_t)(r >> 64);
+#else
+    uint64_t lo_lo;
+    uint64_t hi_lo;
+    uint64_t lo_hi;
+    uint64_t hi_hi;
+    uint64_t cross;
+
+    lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    hi_hi = (a >> 32) * (b >> 32);
+    cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    *hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    *lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+}
+
+static inline uint64_t mul128_fold64(const uint64_t a, const uint64_t b)
+{
+    uint64_t lo;
+    uint64_t hi;
+    mul128(a, b, &lo, &hi);
+    return lo ^ hi;
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, const uint64_t len)
+{
+    h ^= ROTL64(h, 49) ^ ROTL64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t xxh3_mix16B(const unsigned char *input,
+        const unsigned char *secret, const uint64_t seed)
+{
+    return mul128_fold64(read_le64(input) ^ (read_le64(secret) + seed),
+            read_le64(input + 8) ^ (read_le64(secret + 8) - seed));
+}
+
+static inline uint64_t xxh3_len_1to3(const unsigned char *input,
+        const int len, const uint64_t seed)
+{
+    uint32_t combined;
+    uint64_t bitflip;
+
+    combined = ((uint32_t)input[0] << 16) | ((uint32_t)input[len >> 1] << 24)
+        | (uint32_t)input[len - 1] | ((uint32_t)len << 8);
+    bitflip = (read_le32(xxh3_secret) ^ read_le32(xxh3_secret + 4)) + seed;
+    return xxh64_avalanche((uint64_t)combined ^ bitflip);
+}
+
+static inline uint64_t xxh3_len_4to8(const unsigned char *input,
+        const int len, uint64_t seed)
+{
+    uint64_t bitflip;
+    uint64_t input64;
+
+    seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+    bitflip = (read_le64(xxh3_secret + 8) ^
+            read_le64(xxh3_secret + 16)) - seed;
+    input64 = read_le32(input + len - 4) +
+        ((uint64_t)read_le32(input) << 32);
+    return xxh3_rrmxmx(input64 ^ bitflip, len);
+}
+
+static inline uint64_t xxh3_len_9to16(const unsigned char *input,
+        const int len, const uint64_t seed)
+{
+    uint64_t input_lo;
+    uint64_t input_hi;
+    uint64_t acc;
+
+    input_lo = read_le64(input) ^ ((read_le64(xxh3_secret + 24) ^
+                read_le64(xxh3_secret + 32)) + seed);
+    input_hi = read_le64(input + len - 8) ^ ((read_le64(xxh3_secret + 40) ^
+                read_le64(xxh3_secret + 48)) - seed);
+    acc = len + __builtin_bswap64(input_lo) + input_hi +
+        mul128_fold64(input_lo, input_hi);
+    return xxh3_avalanche(acc);
+}
+
+static inline uint64_t xxh3_len_17to128(const unsigned char *input,
+        const int len, const uint64_t seed)
+{
+    uint64_t acc;
+
+    acc = len * PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += xxh3_mix16B(input + 48, xxh3_secret + 96, seed);
+                acc += xxh3_mix16B(input + len - 64, xxh3_secret + 112, seed);
+            }
+            acc += xxh3_mix16B(input + 32, xxh3_secret + 64, seed);
+            acc += xxh3_mix16B(input + len - 48, xxh3_secret + 80, seed);
+        }
+        acc += xxh3_mix16B(input + 16, xxh3_secret + 32, seed);
+        acc += xxh3_mix16B(input + len - 32, xxh3_secret + 48, seed);
+    }
+    acc += xxh3_mix16B(input, xxh3_secret, seed);
+    acc += xxh3_mix16B(input + len - 16, xxh3_secret + 16, seed);
+    return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_129to240(const unsigned char *input,
+        const int len, const uint64_t seed)
+{
+#define XXH3_MIDSIZE_STARTOFFSET  3
+#define XXH3_MIDSIZE_LASTOFFSET  17
+    uint64_t acc;
+    int rounds;
+    int i;
+
+    acc = len * PRIME64_1;
+    for (i=0; i<8; i++) {
+        acc += xxh3_mix16B(input + 16 * i, xxh3_secret + 16 * i, seed);
+    }
+    acc = xxh3_avalanche(acc);
+
+    rounds = len / 16;
+    for (i=8; i<rounds; i++) {
+        acc += xxh3_mix16B(input + 16 * i, xxh3_secret + 16 * (i - 8) +
+                XXH3_MIDSIZE_STARTOFFSET, seed);
+    }
+    acc += xxh3_mix16B(input + len - 16, xxh3_secret + 136 -
+            XXH3_MIDSIZE_LASTOFFSET, seed);
+    return xxh3_avalanche(acc);
+}
+
+#if defined(__SSE2__)
+static inline void xxh3_accumulate_512(uint64_t *acc,
+        const unsigned char *input, const unsigned char *secret)
+{
+    __m128i *xacc;
+    __m128i data_vec;
+    __m128i data_key;
+    __m128i product;
+    __m128i sum;
+    int i;
+
+    xacc = (__m128i *)acc;
+    for (i=0; i<XXH3_STRIPE_LEN / 16; i++) {
+        data_vec = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+        data_key = _mm_xor_si128(data_vec, _mm_loadu_si128(
+                    (const __m128i *)(secret + 16 * i)));
+        //the low 32 bits multiply the high 32 bits of each lane
+        product = _mm_mul_epu32(data_key, _mm_shuffle_epi32(
+                    data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+        //add the input to the swapped lane
+        sum = _mm_add_epi64(xacc[i], _mm_shuffle_epi32(
+                    data_vec, _MM_SHUFFLE(1, 0, 3, 2)));
+        xacc[i] = _mm_add_epi64(product, sum);
+    }
+}
+
+static inline void xxh3_scramble_acc(uint64_t *acc,
+        const unsigned char *secret)
+{
+    __m128i *xacc;
+    __m128i prime32;
+    __m128i data_key;
+    __m128i prod_lo;
+    __m128i prod_hi;
+    int i;
+
+    xacc = (__m128i *)acc;
+    prime32 = _mm_set1_epi32((int)PRIME32_1);
+    for (i=0; i<XXH3_STRIPE_LEN / 16; i++) {
+        data_key = _mm_xor_si128(_mm_xor_si128(xacc[i],
+                    _mm_srli_epi64(xacc[i], 47)), _mm_loadu_si128(
+                        (const __m128i *)(secret + 16 * i)));
+        prod_lo = _mm_mul_epu32(data_key, prime32);
+        prod_hi = _mm_mul_epu32(_mm_shuffle_epi32(data_key,
+                    _MM_SHUFFLE(0, 3, 0, 1)), prime32);
+        xacc[i] = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+    }
+}
+#else
+static inline void xxh3_accumulate_512(uint64_t *acc,
+        const unsigned char *input, const unsigned char *secret)
+{
+    uint64_t data_val;
+    uint64_t data_key;
+    int i;
+
+    for (i=0; i<XXH3_ACC_NB; i++) {
+        data_val = read_le64(input + 8 * i);
+        data_key = data_val ^ read_le64(secret + 8 * i);
+        acc[i ^ 1] += data_val;
+        acc[i] += (uint32_t)data_key * (data_key >> 32);
+    }
+}
+
+static inline void xxh3_scramble_acc(uint64_t *acc,
+        const unsigned char *secret)
+{
+    uint64_t acc64;
+    int i;
+
+    for (i=0; i<XXH3_ACC_NB; i++) {
+        acc64 = acc[i];
+        acc64 ^= acc64 >> 47;
+        acc64 ^= read_le64(secret + 8 * i);
+        acc[i] = acc64 * PRIME32_1;
+    }
+}
+#endif
+
+static inline void xxh3_accumulate(uint64_t *acc, const unsigned char *input,
+        const unsigned char *secret, const int stripes)
+{
+    int n;
+
+    for (n=0; n<stripes; n++) {
+        xxh3_accumulate_512(acc, input + n * XXH3_STRIPE_LEN,
+                secret + n * XXH3_SECRET_CONSUME_RATE);
+    }
+}
+
+static uint64_t xxh3_hash_long(const unsigned char *input,
+        const int len, const uint64_t seed)
+{
+#define XXH3_SECRET_LASTACC_START    7
+#define XXH3_SECRET_MERGEACCS_START 11
+    uint64_t acc[XXH3_ACC_NB] __attribute__((aligned(16))) = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+    unsigned char custom_secret[XXH3_SECRET_SIZE]
+        __attribute__((aligned(16)));
+    const unsigned char *secret;
+    const int stripes_per_block = (XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) /
+        XXH3_SECRET_CONSUME_RATE;
+    const int block_len = XXH3_STRIPE_LEN * stripes_per_block;
+    uint64_t result;
+    int blocks;
+    int stripes;
+    int n;
+
+    if (seed == 0) {
+        secret = xxh3_secret;
+    } else {
+        for (n=0; n<XXH3_SECRET_SIZE; n+=16) {
+            write_le64(custom_secret + n, read_le64(xxh3_secret + n) + seed);
+            write_le64(custom_secret + n + 8,
+                    read_le64(xxh3_secret + n + 8) - seed);
+        }
+        secret = custom_secret;
+    }
+
+    blocks = (len - 1) / block_len;
+    for (n=0; n<blocks; n++) {
+        xxh3_accumulate(acc, input + n * block_len,
+                secret, stripes_per_block);
+        xxh3_scramble_acc(acc, secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+    }
+
+    //the last partial block and the last stripe
+    stripes = ((len - 1) - block_len * blocks) / XXH3_STRIPE_LEN;
+    xxh3_accumulate(acc, input + blocks * block_len, secret, stripes);
+    xxh3_accumulate_512(acc, input + len - XXH3_STRIPE_LEN, secret +
+            XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - XXH3_SECRET_LASTACC_START);
+
+    result = len * PRIME64_1;
+    for (n=0; n<4; n++) {
+        result += mul128_fold64(acc[2 * n] ^ read_le64(secret +
+                    XXH3_SECRET_MERGEACCS_START + 16 * n), acc[2 * n + 1] ^
+                read_le64(secret + XXH3_SECRET_MERGEACCS_START + 16 * n + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+uint64_t fc_xxh3_64(const void *key, const int key_len, const uint64_t seed)
+{
+    const unsigned char *input;
+
+    input = (const unsigned char *)key;
+    if (key_len <= 16) {
+        if (key_len > 8) {
+            return xxh3_len_9to16(input, key_len, seed);
+        } else if (key_len >= 4) {
+            return xxh3_len_4to8(input, key_len, seed);
+        } else if (key_len > 0) {
+            return xxh3_len_1to3(input, key_len, seed);
+        } else {
+            return xxh64_avalanche(seed ^ (read_le64(xxh3_secret + 56) ^
+                        read_le64(xxh3_secret + 64)));
+        }
+    } else if (key_len <= 128) {
+        return xxh3_len_17to128(input, key_len, seed);
+    } else if (key_len <= XXH3_MIDSIZE_MAX) {
+        return xxh3_len_129to240(input, key_len, seed);
+    } else {
+        return xxh3_hash_long(input, key_len, seed);
+    }
+}
+
+static inline uint32_t xxh32_round(uint32_t acc, const uint32_t input)
+{
+    acc += input * PRIME32_2;
+    acc = ROTL32(acc, 13);
+    return acc * PRIME32_1;
+}
+
+uint32_t fc_xxh32(const void *key, const int key_len, const uint32_t seed)
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    uint32_t v1;
+    uint32_t v2;
+    uint32_t v3;
+    uint32_t v4;
+    uint32_t h;
+
+    p = (const unsigned char *)key;
+    end = p + key_len;
+    if (key_len >= 16) {
+        v1 = seed + PRIME32_1 + PRIME32_2;
+        v2 = seed + PRIME32_2;
+        v3 = seed;
+        v4 = seed - PRIME32_1;
+        do {
+            v1 = xxh32_round(v1, read_le32(p));
+            v2 = xxh32_round(v2, read_le32(p + 4));
+            v3 = xxh32_round(v3, read_le32(p + 8));
+            v4 = xxh32_round(v4, read_le32(p + 12));
+            p += 16;
+        } while (end - p >= 16);
+        h = ROTL32(v1, 1) + ROTL32(v2, 7) + ROTL32(v3, 12) + ROTL32(v4, 18);
+    } else {
+        h = seed + PRIME32_5;
+    }
+
+    h += (uint32_t)key_len;
+    while (end - p >= 4) {
+        h += read_le32(p) * PRIME32_3;
+        h = ROTL32(h, 17) * PRIME32_4;
+        p += 4;
+    }
+    while (p < end) {
+        h += (*p++) * PRIME32_5;
+        h = ROTL32(h, 11) * PRIME32_1;
+    }
+
+    h ^= h >> 15;
+    h *= PRIME32_2;
+    h ^= h >> 13;
+    h *= PRIME32_3;
+    h ^= h >> 16;
+    return h;
+}
+
+static const uint64_t wyhash_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline uint64_t wyhash_mix(uint64_t a, uint64_t b)
+{
+    mul128(a, b, &a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t wyhash_read3(const unsigned char *p, const int k)
+{
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t fc_wyhash64(const void *key, const int key_len, uint64_t seed)
+{
+    const unsigned char *p;
+    uint64_t a;
+    uint64_t b;
+    uint64_t see1;
+    uint64_t see2;
+    int i;
+
+    p = (const unsigned char *)key;
+    seed ^= wyhash_mix(seed ^ wyhash_secret[0], wyhash_secret[1]);
+    if (key_len <= 16) {
+        if (key_len >= 4) {
+            a = ((uint64_t)read_le32(p) << 32) |
+                read_le32(p + ((key_len >> 3) << 2));
+            b = ((uint64_t)read_le32(p + key_len - 4) << 32) |
+                read_le32(p + key_len - 4 - ((key_len >> 3) << 2));
+        } else if (key_len > 0) {
+            a = wyhash_read3(p, key_len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        i = key_len;
+        if (i >= 48) {
+            see1 = see2 = seed;
+            do {
+                seed = wyhash_mix(read_le64(p) ^ wyhash_secret[1],
+                        read_le64(p + 8) ^ seed);
+                see1 = wyhash_mix(read_le64(p + 16) ^ wyhash_secret[2],
+                        read_le64(p + 24) ^ see1);
+                see2 = wyhash_mix(read_le64(p + 32) ^ wyhash_secret[3],
+                        read_le64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wyhash_mix(read_le64(p) ^ wyhash_secret[1],
+                    read_le64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read_le64(p + i - 16);
+        b = read_le64(p + i - 8);
+    }
+
+    a ^= wyhash_secret[1];
+    b ^= seed;
+    mul128(a, b, &a, &b);
+    return wyhash_mix(a ^ wyhash_secret[0] ^ (uint64_t)key_len,
+            b ^ wyhash_secret[1]);
+}
+
+int XXH3Hash(const void *key, const int key_len)
+{
+    return (int)fc_xxh3_32(key, key_len, 0);
+}
+
+int XXH3Hash_ex(const void *key, const int key_len, const int init_value)
+{
+    return (int)fc_xxh3_32(key, key_len, (uint32_t)init_value);
+}
+
+int XXH32Hash(const void *key, const int key_len)
+{
+    return (int)fc_xxh32(key, key_len, 0);
+}
+
+int XXH32Hash_ex(const void *key, const int key_len, const int init_value)
+{
+    return (int)fc_xxh32(key, key_len, (uint32_t)init_value);
+}
+
+int WyHash(const void *key, const int key_len)
+{
+    return (int)fc_wyhash32(key, key_len, 0);
+}
+
+int WyHash_ex(const void *key, const int key_len, const int init_value)
+{
+    return (int)fc_wyhash32(key, key_len, (uint32_t)init_value);
+}
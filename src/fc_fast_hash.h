@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_fast_hash.h: word at a time hash functions (XXH3, XXH32 and wyhash)
+//                with the drop-in HashFunc implementations
+
+#ifndef _FC_FAST_HASH_H
+#define _FC_FAST_HASH_H
+
+#include <stdint.h>
+#include "common_define.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** XXH3 64 bits, the same result as XXH3_64bits_withSeed of xxHash 0.8
+ *  parameters:
+ *      key: the key to hash
+ *      key_len: the length of the key
+ *      seed: the seed
+ *  return: the 64 bits hash code
+ */
+uint64_t fc_xxh3_64(const void *key, const int key_len, const uint64_t seed);
+
+/** XXH32, the same result as XXH32 of xxHash
+ *  parameters:
+ *      key: the key to hash
+ *      key_len: the length of the key
+ *      seed: the seed
+ *  return: the 32 bits hash code
+ */
+uint32_t fc_xxh32(const void *key, const int key_len, const uint32_t seed);
+
+/** wyhash final4 with the default secret
+ *  parameters:
+ *      key: the key to hash
+ *      key_len: the length of the key
+ *      seed: the seed
+ *  return: the 64 bits hash code
+ */
+uint64_t fc_wyhash64(const void *key, const int key_len, const uint64_t seed);
+
+/* fold the 64 bits hash code to 32 bits */
+#define FC_HASH_FOLD64(h)  ((uint32_t)((h) ^ ((h) >> 32)))
+
+static inline uint32_t fc_xxh3_32(const void *key,
+        const int key_len, const uint64_t seed)
+{
+    uint64_t h;
+    h = fc_xxh3_64(key, key_len, seed);
+    return FC_HASH_FOLD64(h);
+}
+
+static inline uint32_t fc_wyhash32(const void *key,
+        const int key_len, const uint64_t seed)
+{
+    uint64_t h;
+    h = fc_wyhash64(key, key_len, seed);
+    return FC_HASH_FOLD64(h);
+}
+
+/* the drop-in HashFunc implementations, the init_value of the _ex
+ * functions is the seed */
+int XXH3Hash(const void *key, const int key_len);
+int XXH3Hash_ex(const void *key, const int key_len, const int init_value);
+
+int XXH32Hash(const void *key, const int key_len);
+int XXH32Hash_ex(const void *key, const int key_len, const int init_value);
+
+int WyHash(const void *key, const int key_len);
+int WyHash_ex(const void *key, const int key_len, const int init_value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
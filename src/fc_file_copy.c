@@ -0,0 +1,609 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_file_copy.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "fc_memory.h"
+#include "pthread_func.h"
+#include "fc_file_copy.h"
+#ifdef OS_LINUX
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+#if defined(OS_LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || \
+        (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define FC_HAVE_COPY_FILE_RANGE  1
+#endif
+
+#if defined(OS_LINUX) && defined(FICLONE) && defined(FICLONERANGE)
+#define FC_HAVE_REFLINK  1
+#endif
+
+#define FC_FILE_COPY_STEP_SIZE    (8 * 1024 * 1024)  //for the progress
+#define FC_FILE_COPY_BUFFER_SIZE  (256 * 1024)
+#define FC_FILE_COPY_MAX_THREADS  64
+
+typedef struct fc_file_copy_context {
+    int src_fd;
+    int dest_fd;
+    int flags;
+    bool parallel;
+    volatile bool no_copy_file_range;
+    volatile bool no_sendfile;
+    int64_t src_size;
+    int64_t src_offset;
+    int64_t dest_offset;
+    int64_t length;
+    int64_t chunk_size;
+    int chunk_count;
+    volatile int next_chunk;
+    volatile int result;     //the first error
+    volatile int method;
+    volatile int64_t copied_bytes;
+    volatile int64_t hole_bytes;
+    int64_t done_bytes;      //include the holes, protected by the lock
+    fc_file_copy_progress_func progress;
+    void *progress_args;
+    pthread_mutex_t lock;
+} FCFileCopyContext;
+
+typedef struct fc_file_copy_worker {
+    FCFileCopyContext *ctx;
+    char *buff;   //for the buffered copy, allocated when used
+} FCFileCopyWorker;
+
+const char *fc_file_copy_method_caption(const FCFileCopyMethod method)
+{
+    switch (method) {
+        case fc_file_copy_method_none:
+            return "none";
+        case fc_file_copy_method_reflink:
+            return "reflink";
+        case fc_file_copy_method_copy_file_range:
+            return "copy_file_range";
+        case fc_file_copy_method_sendfile:
+            return "sendfile";
+        case fc_file_copy_method_buffered:
+            return "buffered";
+        default:
+            return "unknown";
+    }
+}
+
+static inline void fc_file_copy_set_method(FCFileCopyContext *ctx,
+        const FCFileCopyMethod method)
+{
+    int old_method;
+
+    //keep the last fallback method
+    while ((old_method=ctx->method) < (int)method) {
+        if (__sync_bool_compare_and_swap(&ctx->method,
+                    old_method, method))
+        {
+            break;
+        }
+    }
+}
+
+static inline void fc_file_copy_set_error(FCFileCopyContext *ctx,
+        const int result)
+{
+    __sync_bool_compare_and_swap(&ctx->result, 0, result);
+}
+
+static int fc_file_copy_report(FCFileCopyContext *ctx,
+        const int64_t data_bytes, const int64_t hole_bytes)
+{
+    int result;
+
+    if (data_bytes > 0) {
+        __sync_add_and_fetch(&ctx->copied_bytes, data_bytes);
+    }
+    if (hole_bytes > 0) {
+        __sync_add_and_fetch(&ctx->hole_bytes, hole_bytes);
+    }
+    if (ctx->progress == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->done_bytes += data_bytes + hole_bytes;
+    if (ctx->result != 0) {
+        result = ctx->result;
+    } else if (ctx->progress(ctx->progress_args,
+                ctx->done_bytes, ctx->length) != 0)
+    {
+        result = ECANCELED;
+        fc_file_copy_set_error(ctx, result);
+    } else {
+        result = 0;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return result;
+}
+
+static inline bool fc_file_copy_unsupported(const int err_no)
+{
+    return (err_no == EXDEV || err_no == EINVAL || err_no == ENOSYS ||
+            err_no == EOPNOTSUPP || err_no == EBADF || err_no == EPERM ||
+            err_no == ETXTBSY);
+}
+
+/* copy one step, *copied is 0 at the end of the source */
+static int fc_file_copy_step(FCFileCopyWorker *worker,
+        const int64_t src_offset, const int64_t dest_offset,
+        const int64_t bytes, int64_t *copied)
+{
+    FCFileCopyContext *ctx;
+    ssize_t n;
+    int result;
+
+    ctx = worker->ctx;
+#ifdef FC_HAVE_COPY_FILE_RANGE
+    if (!ctx->no_copy_file_range && (ctx->flags &
+                FC_FILE_COPY_FLAGS_BUFFERED_ONLY) == 0)
+    {
+        loff_t in_offset;
+        loff_t out_offset;
+
+        in_offset = src_offset;
+        out_offset = dest_offset;
+        do {
+            n = copy_file_range(ctx->src_fd, &in_offset,
+                    ctx->dest_fd, &out_offset, bytes, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n > 0) {
+            *copied = n;
+            fc_file_copy_set_method(ctx,
+                    fc_file_copy_method_copy_file_range);
+            return 0;
+        } else if (n < 0) {
+            result = errno != 0 ? errno : EIO;
+            if (!fc_file_copy_unsupported(result)) {
+                return result;
+            }
+            ctx->no_copy_file_range = true;
+        }
+        //some file systems return 0 such as procfs, try the next method
+    }
+#endif
+
+#ifdef OS_LINUX
+    //the dest offset is shared by the worker threads
+    if (!ctx->parallel && !ctx->no_sendfile && (ctx->flags &
+                FC_FILE_COPY_FLAGS_BUFFERED_ONLY) == 0)
+    {
+        off_t in_offset;
+
+        if (lseek(ctx->dest_fd, dest_offset, SEEK_SET) < 0) {
+            ctx->no_sendfile = true;
+        } else {
+            in_offset = src_offset;
+            do {
+                n = sendfile(ctx->dest_fd, ctx->src_fd, &in_offset, bytes);
+            } while (n < 0 && errno == EINTR);
+
+            if (n > 0) {
+                *copied = n;
+                fc_file_copy_set_method(ctx, fc_file_copy_method_sendfile);
+                return 0;
+            } else if (n < 0) {
+                result = errno != 0 ? errno : EIO;
+                if (!fc_file_copy_unsupported(result)) {
+                    return result;
+                }
+            }
+            ctx->no_sendfile = true;
+        }
+    }
+#endif
+
+    if (worker->buff == NULL) {
+        worker->buff = (char *)fc_malloc(FC_FILE_COPY_BUFFER_SIZE);
+        if (worker->buff == NULL) {
+            return ENOMEM;
+        }
+    }
+
+    do {
+        n = pread(ctx->src_fd, worker->buff, (bytes < FC_FILE_COPY_BUFFER_SIZE
+                    ? bytes : FC_FILE_COPY_BUFFER_SIZE), src_offset);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return errno != 0 ? errno : EIO;
+    }
+
+    *copied = n;
+    fc_file_copy_set_method(ctx, fc_file_copy_method_buffered);
+    while (n > 0) {
+        ssize_t written;
+
+        written = pwrite(ctx->dest_fd, worker->buff + (*copied - n),
+                n, dest_offset + (*copied - n));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno != 0 ? errno : EIO;
+        }
+        n -= written;
+    }
+    return 0;
+}
+
+static int fc_file_copy_data(FCFileCopyWorker *worker, int64_t src_offset,
+        int64_t dest_offset, int64_t length)
+{
+    int64_t bytes;
+    int64_t copied;
+    int result;
+
+    while (length > 0) {
+        if (worker->ctx->result != 0) {
+            return worker->ctx->result;
+        }
+
+        bytes = (length < FC_FILE_COPY_STEP_SIZE) ?
+            length : FC_FILE_COPY_STEP_SIZE;
+        while (bytes > 0) {
+            if ((result=fc_file_copy_step(worker, src_offset,
+                            dest_offset, bytes, &copied)) != 0)
+            {
+                return result;
+            }
+            if (copied == 0) {   //the source file is truncated
+                return ENODATA;
+            }
+            src_offset += copied;
+            dest_offset += copied;
+            length -= copied;
+            bytes -= copied;
+            if ((result=fc_file_copy_report(worker->ctx,
+                            copied, 0)) != 0)
+            {
+                return result;
+            }
+        }
+    }
+    return 0;
+}
+
+/* copy the data segments and skip the holes by SEEK_DATA / SEEK_HOLE */
+static int fc_file_copy_range(FCFileCopyWorker *worker,
+        const int64_t src_offset, const int64_t length)
+{
+    FCFileCopyContext *ctx;
+    int64_t delta;
+    int64_t end;
+    int64_t pos;
+    int64_t data;
+    int64_t hole;
+    int result;
+
+    ctx = worker->ctx;
+    delta = ctx->dest_offset - ctx->src_offset;
+    if ((ctx->flags & FC_FILE_COPY_FLAGS_FILL_HOLES) != 0) {
+        return fc_file_copy_data(worker, src_offset,
+                src_offset + delta, length);
+    }
+
+    end = src_offset + length;
+    pos = src_offset;
+    while (pos < end) {
+        hole = end;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        if ((data=lseek(ctx->src_fd, pos, SEEK_DATA)) < 0) {
+            if (errno == ENXIO) {   //the tail is a hole
+                data = end;
+            } else {   //not supported, as the data
+                data = pos;
+            }
+        } else if (data < end) {
+            if ((hole=lseek(ctx->src_fd, data, SEEK_HOLE)) < 0 ||
+                    hole > end)
+            {
+                hole = end;
+            }
+        }
+        if (data > end) {
+            data = end;
+        }
+#else
+        data = pos;
+#endif
+
+        if (data > pos) {
+            if ((result=fc_file_copy_report(ctx, 0, data - pos)) != 0) {
+                return result;
+            }
+        }
+        if (data == end) {
+            break;
+        }
+
+        if ((result=fc_file_copy_data(worker, data, data + delta,
+                        hole - data)) != 0)
+        {
+            return result;
+        }
+        pos = hole;
+    }
+
+    return 0;
+}
+
+static void *fc_file_copy_thread_func(void *arg)
+{
+    FCFileCopyWorker *worker;
+    FCFileCopyContext *ctx;
+    int64_t offset;
+    int64_t length;
+    int chunk;
+    int result;
+
+    worker = (FCFileCopyWorker *)arg;
+    ctx = worker->ctx;
+    while (ctx->result == 0 && (chunk=__sync_fetch_and_add(
+                    &ctx->next_chunk, 1)) < ctx->chunk_count)
+    {
+        offset = ctx->src_offset + chunk * ctx->chunk_size;
+        length = ctx->src_offset + ctx->length - offset;
+        if (length > ctx->chunk_size) {
+            length = ctx->chunk_size;
+        }
+        if ((result=fc_file_copy_range(worker, offset, length)) != 0) {
+            fc_file_copy_set_error(ctx, result);
+        }
+    }
+
+    if (worker->buff != NULL) {
+        free(worker->buff);
+        worker->buff = NULL;
+    }
+    return NULL;
+}
+
+#ifdef FC_HAVE_REFLINK
+/* share the extents on the same file system such as btrfs and xfs */
+static int fc_file_copy_reflink(FCFileCopyContext *ctx)
+{
+    struct file_clone_range range;
+    struct stat st;
+    int result;
+
+    if (ctx->src_offset == 0 && ctx->dest_offset == 0 &&
+            ctx->length == ctx->src_size && fstat(ctx->dest_fd, &st) == 0 && st.st_size == 0)
+    {
+        result = ioctl(ctx->dest_fd, FICLONE, ctx->src_fd);
+    } else {
+        range.src_fd = ctx->src_fd;
+        range.src_offset = ctx->src_offset;
+        range.src_length = ctx->length;
+        range.dest_offset = ctx->dest_offset;
+        result = ioctl(ctx->dest_fd, FICLONERANGE, &range);
+    }
+
+    if (result != 0) {
+        return errno != 0 ? errno : EOPNOTSUPP;
+    }
+    ctx->method = fc_file_copy_method_reflink;
+    return fc_file_copy_report(ctx, ctx->length, 0);
+}
+#endif
+
+static int fc_file_copy_parallel(FCFileCopyContext *ctx,
+        const int thread_count)
+{
+    FCFileCopyWorker workers[FC_FILE_COPY_MAX_THREADS];
+    pthread_t tids[FC_FILE_COPY_MAX_THREADS];
+    int count;
+    int result;
+    int i;
+
+    ctx->parallel = true;
+    count = 0;
+    for (i=1; i<thread_count; i++) {
+        workers[i].ctx = ctx;
+        workers[i].buff = NULL;
+        if ((result=pthread_create(tids + i, NULL,
+                        fc_file_copy_thread_func, workers + i)) != 0)
+        {
+            logWarning("file: "__FILE__", line: %d, "
+                    "create thread fail, errno: %d, error info: %s",
+                    __LINE__, result, STRERROR(result));
+            break;
+        }
+        count++;
+    }
+
+    //the caller thread works too
+    workers[0].ctx = ctx;
+    workers[0].buff = NULL;
+    fc_file_copy_thread_func(workers + 0);
+    for (i=1; i<=count; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return ctx->result;
+}
+
+int fc_file_copy_fd(const int src_fd, const int dest_fd,
+        const FCFileCopyOptions *options, FCFileCopyResult *result)
+{
+    const FCFileCopyOptions default_options = {0, 0, -1};
+    FCFileCopyContext ctx;
+    FCFileCopyWorker worker;
+    struct stat st;
+    int64_t parallel_threshold;
+    int thread_count;
+    int ret;
+
+    if (options == NULL) {
+        options = &default_options;
+    }
+    if (options->src_offset < 0 || options->dest_offset < 0) {
+        return EINVAL;
+    }
+    if (fstat(src_fd, &st) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+    if (options->src_offset > st.st_size) {
+        return EINVAL;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.src_fd = src_fd;
+    ctx.dest_fd = dest_fd;
+    ctx.flags = options->flags;
+    ctx.src_size = st.st_size;
+    ctx.src_offset = options->src_offset;
+    ctx.dest_offset = options->dest_offset;
+    ctx.length = st.st_size - options->src_offset;
+    if (options->length >= 0 && options->length < ctx.length) {
+        ctx.length = options->length;
+    }
+    ctx.progress = options->progress;
+    ctx.progress_args = options->progress_args;
+    if ((ret=init_pthread_lock(&ctx.lock)) != 0) {
+        return ret;
+    }
+
+    ret = ctx.length > 0 ? EOPNOTSUPP : 0;
+#ifdef FC_HAVE_REFLINK
+    if (ret != 0 && (ctx.flags & (FC_FILE_COPY_FLAGS_NO_REFLINK |
+                    FC_FILE_COPY_FLAGS_BUFFERED_ONLY)) == 0)
+    {
+        ret = fc_file_copy_reflink(&ctx);
+        if (ret != 0 && ret != ECANCELED) {
+            ret = EOPNOTSUPP;   //fallback
+        }
+    }
+#endif
+
+    if (ret == EOPNOTSUPP) {
+        thread_count = options->thread_count;
+        if (thread_count > FC_FILE_COPY_MAX_THREADS) {
+            thread_count = FC_FILE_COPY_MAX_THREADS;
+        }
+        parallel_threshold = options->parallel_threshold > 0 ?
+            options->parallel_threshold :
+            FC_FILE_COPY_DEFAULT_PARALLEL_THRESHOLD;
+        ctx.chunk_size = options->chunk_size > 0 ? options->chunk_size :
+            FC_FILE_COPY_DEFAULT_CHUNK_SIZE;
+        ctx.chunk_count = (ctx.length + ctx.chunk_size - 1) / ctx.chunk_size;
+        if (thread_count > ctx.chunk_count) {
+            thread_count = ctx.chunk_count;
+        }
+
+        if (thread_count > 1 && ctx.length >= parallel_threshold) {
+            ret = fc_file_copy_parallel(&ctx, thread_count);
+        } else {
+            worker.ctx = &ctx;
+            worker.buff = NULL;
+            ret = fc_file_copy_range(&worker, ctx.src_offset, ctx.length);
+            if (worker.buff != NULL) {
+                free(worker.buff);
+            }
+        }
+    }
+
+    //extend the dest file for the trailing holes
+    if (ret == 0 && ctx.length > 0 && fstat(dest_fd, &st) == 0 &&
+            st.st_size < ctx.dest_offset + ctx.length)
+    {
+        if (ftruncate(dest_fd, ctx.dest_offset + ctx.length) != 0) {
+            ret = errno != 0 ? errno : EIO;
+        }
+    }
+    if (ret == 0 && (ctx.flags & FC_FILE_COPY_FLAGS_NO_FSYNC) == 0) {
+        if (fsync(dest_fd) != 0) {
+            ret = errno != 0 ? errno : EIO;
+        }
+    }
+
+    if (result != NULL) {
+        result->copied_bytes = ctx.copied_bytes;
+        result->hole_bytes = ctx.hole_bytes;
+        result->method = ctx.method;
+    }
+    pthread_mutex_destroy(&ctx.lock);
+    return ret;
+}
+
+int fc_file_copy_ex(const char *src_filename, const char *dest_filename,
+        const FCFileCopyOptions *options, FCFileCopyResult *result)
+{
+    FCFileCopyOptions range_options;
+    int src_fd;
+    int dest_fd;
+    int flags;
+    int ret;
+
+    src_fd = open(src_filename, O_RDONLY | O_CLOEXEC);
+    if (src_fd < 0) {
+        ret = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, src_filename, ret, STRERROR(ret));
+        return ret;
+    }
+
+    flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (options == NULL || (options->src_offset == 0 &&
+                options->dest_offset == 0 && options->length < 0))
+    {
+        flags |= O_TRUNC;
+    } else {
+        //the existing content of the range should be overwritten
+        range_options = *options;
+        range_options.flags |= FC_FILE_COPY_FLAGS_FILL_HOLES;
+        options = &range_options;
+    }
+
+    dest_fd = open(dest_filename, flags, 0644);
+    if (dest_fd < 0) {
+        ret = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, dest_filename, ret, STRERROR(ret));
+        close(src_fd);
+        return ret;
+    }
+
+    if ((ret=fc_file_copy_fd(src_fd, dest_fd, options, result)) != 0) {
+        if (ret != ECANCELED) {
+            logError("file: "__FILE__", line: %d, "
+                    "copy file %s to %s fail, errno: %d, error info: %s",
+                    __LINE__, src_filename, dest_filename,
+                    ret, STRERROR(ret));
+        }
+    }
+
+    close(src_fd);
+    close(dest_fd);
+    return ret;
+}
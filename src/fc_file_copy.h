@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_file_copy.h: the local file copy engine, try the reflink first, then
+//                copy_file_range, sendfile and the buffered read / write
+
+#ifndef _FC_FILE_COPY_H
+#define _FC_FILE_COPY_H
+
+#include "common_define.h"
+
+#define FC_FILE_COPY_FLAGS_NO_REFLINK     1  //do NOT share the extents
+#define FC_FILE_COPY_FLAGS_FILL_HOLES     2  //write the holes as zeros
+#define FC_FILE_COPY_FLAGS_NO_FSYNC       4
+#define FC_FILE_COPY_FLAGS_BUFFERED_ONLY  8  //the read / write loop only
+
+#define FC_FILE_COPY_DEFAULT_PARALLEL_THRESHOLD  (256 * 1024 * 1024)
+#define FC_FILE_COPY_DEFAULT_CHUNK_SIZE          (64 * 1024 * 1024)
+
+/* the methods in the order of the fallback */
+typedef enum fc_file_copy_method {
+    fc_file_copy_method_none = 0,   //nothing to copy
+    fc_file_copy_method_reflink,
+    fc_file_copy_method_copy_file_range,
+    fc_file_copy_method_sendfile,
+    fc_file_copy_method_buffered
+} FCFileCopyMethod;
+
+/* return 0 to continue, others to cancel the copy with ECANCELED.
+ * called by the worker threads serially in the parallel copy */
+typedef int (*fc_file_copy_progress_func)(void *args,
+        const int64_t copied_bytes, const int64_t total_bytes);
+
+typedef struct fc_file_copy_options {
+    int64_t src_offset;
+    int64_t dest_offset;
+    int64_t length;     //less than 0 for to the end of the source file
+    int flags;
+    int thread_count;   //more than 1 for the parallel chunked copy
+    int64_t parallel_threshold;  //the min length of the parallel copy
+    int64_t chunk_size;
+    fc_file_copy_progress_func progress;
+    void *progress_args;
+} FCFileCopyOptions;
+
+typedef struct fc_file_copy_result {
+    int64_t copied_bytes;   //the data bytes, exclude the skipped holes
+    int64_t hole_bytes;     //the skipped holes
+    FCFileCopyMethod method;  //the last fallback method used
+} FCFileCopyResult;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** get the caption of the copy method
+ *  parameters:
+ *      method: the copy method
+ *  return: the caption
+ */
+const char *fc_file_copy_method_caption(const FCFileCopyMethod method);
+
+/** copy the range of the file descriptors with the positional I/O,
+ *  the file offsets are not used except sendfile which changes the
+ *  offset of the dest fd. the holes of the source are skipped unless
+ *  FC_FILE_COPY_FLAGS_FILL_HOLES, so the dest range should be zeros or
+ *  holes, and the dest file is extended to the end of the range
+ *  parameters:
+ *      src_fd: the source file descriptor
+ *      dest_fd: the dest file descriptor
+ *      options: the copy options, NULL for the whole file
+ *      result: return the copy result, can be NULL
+ *  return: error no, 0 for success, ECANCELED by the progress callback
+ */
+int fc_file_copy_fd(const int src_fd, const int dest_fd,
+        const FCFileCopyOptions *options, FCFileCopyResult *result);
+
+/** copy the file. the dest file is truncated when copy the whole file,
+ *  otherwise the existing content out of the range is kept and the
+ *  holes of the range are filled with zeros
+ *  parameters:
+ *      src_filename: the source filename
+ *      dest_filename: the dest filename
+ *      options: the copy options, NULL for the whole file
+ *      result: return the copy result, can be NULL
+ *  return: error no, 0 for success
+ */
+int fc_file_copy_ex(const char *src_filename, const char *dest_filename,
+        const FCFileCopyOptions *options, FCFileCopyResult *result);
+
+static inline int fc_file_copy(const char *src_filename,
+        const char *dest_filename)
+{
+    return fc_file_copy_ex(src_filename, dest_filename, NULL, NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,708 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FC_FILTER_X86_KERNELS  1
+#include <immintrin.h>
+#endif
+#include "logger.h"
+#include "shared_func.h"
+#include "pthread_func.h"
+#include "fc_memory.h"
+#include "fc_crc32.h"
+#include "fc_filter.h"
+
+#define FC_BLOOM_FILE_MAGIC   "FCBF"
+#define FC_CUCKOO_FILE_MAGIC  "FCCF"
+#define FC_FILTER_FILE_VERSION  1
+
+typedef struct fc_filter_file_header
+{
+    char magic[4];
+    int version;
+    uint64_t seed;
+    int64_t element_count;   //the block or bucket count
+    int64_t count;           //the item count
+    int element_size;
+    uint32_t data_crc32;
+} FCFilterFileHeader;
+
+/* the odd constants of the split block bloom filter of Apache Parquet */
+static const uint32_t bloom_salts[FC_BLOOM_BLOCK_WORDS]
+__attribute__((aligned(32))) = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+typedef bool (*bloom_block_test_func)(const uint64_t *block,
+        const uint32_t h32);
+
+static pthread_once_t bloom_once = PTHREAD_ONCE_INIT;
+static bloom_block_test_func bloom_block_test = NULL;
+
+#define BLOOM_BLOCK(filter, hash) ((filter)->blocks + FC_BLOOM_BLOCK_WORDS * \
+        (uint32_t)((((hash) >> 32) * (filter)->block_count) >> 32))
+
+#define BLOOM_BIT_MASK(h32, i)  (1ULL << (((h32) * bloom_salts[i]) >> 26))
+
+static bool bloom_block_test_scalar(const uint64_t *block, const uint32_t h32)
+{
+    int i;
+
+    for (i=0; i<FC_BLOOM_BLOCK_WORDS; i++) {
+        if ((__atomic_load_n(block + i, __ATOMIC_RELAXED) &
+                    BLOOM_BIT_MASK(h32, i)) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef FC_FILTER_X86_KERNELS
+/* calculate the 8 bit masks and test them with two 256 bits registers */
+__attribute__((target("avx2")))
+static bool bloom_block_test_avx2(const uint64_t *block, const uint32_t h32)
+{
+    __m256i bits;
+    __m256i one;
+    __m256i mask_lo;
+    __m256i mask_hi;
+
+    bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(h32),
+                _mm256_load_si256((const __m256i *)bloom_salts)), 26);
+    one = _mm256_set1_epi64x(1);
+    mask_lo = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(
+                _mm256_castsi256_si128(bits)));
+    mask_hi = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(
+                _mm256_extracti128_si256(bits, 1)));
+    return _mm256_testc_si256(_mm256_load_si256(
+                (const __m256i *)block), mask_lo) &&
+        _mm256_testc_si256(_mm256_load_si256(
+                    (const __m256i *)(block + 4)), mask_hi);
+}
+#endif
+
+static void bloom_global_init()
+{
+#ifdef FC_FILTER_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        bloom_block_test = bloom_block_test_avx2;
+        return;
+    }
+#endif
+    bloom_block_test = bloom_block_test_scalar;
+}
+
+static int bloom_alloc_blocks(FCBloomFilter *filter)
+{
+    int64_t bytes;
+    int result;
+
+    pthread_once(&bloom_once, bloom_global_init);
+    bytes = (int64_t)FC_BLOOM_BLOCK_BYTES * filter->block_count;
+    if ((result=posix_memalign((void **)&filter->blocks,
+                    FC_BLOOM_BLOCK_BYTES, bytes)) != 0)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "posix_memalign %"PRId64" bytes fail, "
+                "errno: %d, error info: %s", __LINE__,
+                bytes, result, STRERROR(result));
+        filter->blocks = NULL;
+        return result;
+    }
+
+    memset(filter->blocks, 0, bytes);
+    return 0;
+}
+
+int fc_bloom_filter_init(FCBloomFilter *filter, const int64_t expected_items,
+        const double fpp, const uint64_t seed)
+{
+    double bits_per_key;
+    int64_t block_count;
+
+    memset(filter, 0, sizeof(FCBloomFilter));
+    if (expected_items <= 0 || fpp <= 0.00 || fpp >= 1.00) {
+        return EINVAL;
+    }
+
+    /* the bits of the standard bloom filter is n * ln(1/p) / (ln2 ^ 2),
+     * the blocked one needs more bits for the uneven load of the blocks */
+    bits_per_key = log(1.0 / fpp) / (M_LN2 * M_LN2);
+    bits_per_key *= FC_MAX(0.90 + 0.10 * log10(1.0 / fpp), 1.00);
+    block_count = (int64_t)ceil(expected_items * bits_per_key /
+            (FC_BLOOM_BLOCK_BYTES * 8));
+    if (block_count > UINT32_MAX) {
+        return EOVERFLOW;
+    }
+
+    filter->block_count = FC_MAX(block_count, 1);
+    filter->seed = seed;
+    return bloom_alloc_blocks(filter);
+}
+
+void fc_bloom_filter_destroy(FCBloomFilter *filter)
+{
+    if (filter->blocks != NULL) {
+        free(filter->blocks);
+        filter->blocks = NULL;
+    }
+}
+
+void fc_bloom_filter_clear(FCBloomFilter *filter)
+{
+    memset(filter->blocks, 0, (int64_t)FC_BLOOM_BLOCK_BYTES *
+            filter->block_count);
+    filter->count = 0;
+}
+
+bool fc_bloom_filter_add_by_hash(FCBloomFilter *filter, const uint64_t hash)
+{
+    uint64_t *block;
+    uint64_t mask;
+    uint32_t h32;
+    bool changed;
+    int i;
+
+    block = BLOOM_BLOCK(filter, hash);
+    h32 = (uint32_t)hash;
+    changed = false;
+    for (i=0; i<FC_BLOOM_BLOCK_WORDS; i++) {
+        mask = BLOOM_BIT_MASK(h32, i);
+        if ((__atomic_load_n(block + i, __ATOMIC_RELAXED) & mask) == 0) {
+            __atomic_fetch_or(block + i, mask, __ATOMIC_RELAXED);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        __sync_add_and_fetch(&filter->count, 1);
+    }
+    return changed;
+}
+
+bool fc_bloom_filter_contains_by_hash(FCBloomFilter *filter,
+        const uint64_t hash)
+{
+    return bloom_block_test(BLOOM_BLOCK(filter, hash), (uint32_t)hash);
+}
+
+static int filter_save_to_file(const char *filename, const char *magic,
+        const uint64_t seed, const int64_t count, const void *data,
+        const int element_size, const int64_t element_count)
+{
+    FCFilterFileHeader header;
+    char tmp_filename[PATH_MAX];
+    struct iovec iov[2];
+    int64_t bytes;
+    int result;
+    int fd;
+
+    bytes = element_size * element_count;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = FC_FILTER_FILE_VERSION;
+    header.seed = seed;
+    header.element_count = element_count;
+    header.element_size = element_size;
+    header.count = count;
+    header.data_crc32 = fc_crc32(data, bytes);
+
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+    if ((fd=open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, tmp_filename, result, STRERROR(result));
+        return result;
+    }
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = bytes;
+    if (fc_safe_writev(fd, iov, 2) != sizeof(header) + bytes ||
+            fsync(fd) != 0)
+    {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "write to file %s fail, errno: %d, error info: %s",
+                __LINE__, tmp_filename, result, STRERROR(result));
+        close(fd);
+        return result;
+    }
+    close(fd);
+
+    if (rename(tmp_filename, filename) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "rename file \"%s\" to \"%s\" fail, "
+                "errno: %d, error info: %s", __LINE__,
+                tmp_filename, filename, result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+static int filter_open_file(const char *filename, const char *magic,
+        const int element_size, FCFilterFileHeader *header, int *fd)
+{
+    int64_t file_size;
+    int result;
+
+    if ((*fd=open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+
+    if (fc_safe_read(*fd, (char *)header, sizeof(*header)) !=
+            sizeof(*header))
+    {
+        result = EINVAL;
+    } else if (memcmp(header->magic, magic, sizeof(header->magic)) != 0 ||
+            header->version != FC_FILTER_FILE_VERSION ||
+            header->element_size != element_size ||
+            header->element_count <= 0 || header->element_count > UINT32_MAX)
+    {
+        result = EINVAL;
+    } else {
+        file_size = lseek(*fd, 0, SEEK_END);
+        result = (file_size == sizeof(*header) + header->element_size *
+                header->element_count) ? 0 : EINVAL;
+        lseek(*fd, sizeof(*header), SEEK_SET);
+    }
+
+    if (result != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid filter file: %s", __LINE__, filename);
+        close(*fd);
+    }
+    return result;
+}
+
+static int filter_read_data(const char *filename, const int fd,
+        const FCFilterFileHeader *header, void *data)
+{
+    int64_t bytes;
+
+    bytes = header->element_size * header->element_count;
+    if (fc_safe_read(fd, (char *)data, bytes) != bytes) {
+        logError("file: "__FILE__", line: %d, "
+                "read file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, errno, STRERROR(errno));
+        return errno != 0 ? errno : EIO;
+    }
+
+    if (fc_crc32(data, bytes) != header->data_crc32) {
+        logError("file: "__FILE__", line: %d, "
+                "filter file: %s, checksum mismatch", __LINE__, filename);
+        return EINVAL;
+    }
+    return 0;
+}
+
+int fc_bloom_filter_save(FCBloomFilter *filter, const char *filename)
+{
+    return filter_save_to_file(filename, FC_BLOOM_FILE_MAGIC, filter->seed,
+            filter->count, filter->blocks, FC_BLOOM_BLOCK_BYTES,
+            filter->block_count);
+}
+
+int fc_bloom_filter_load(FCBloomFilter *filter, const char *filename)
+{
+    FCFilterFileHeader header;
+    int result;
+    int fd;
+
+    memset(filter, 0, sizeof(FCBloomFilter));
+    if ((result=filter_open_file(filename, FC_BLOOM_FILE_MAGIC,
+                    FC_BLOOM_BLOCK_BYTES, &header, &fd)) != 0)
+    {
+        return result;
+    }
+
+    filter->block_count = header.element_count;
+    filter->seed = header.seed;
+    filter->count = header.count;
+    if ((result=bloom_alloc_blocks(filter)) == 0) {
+        if ((result=filter_read_data(filename, fd, &header,
+                        filter->blocks)) != 0)
+        {
+            fc_bloom_filter_destroy(filter);
+        }
+    }
+
+    close(fd);
+    return result;
+}
+
+
+#define CUCKOO_LANE_MASK   0xFFFFULL
+#define CUCKOO_LSB_LANES   0x0001000100010001ULL
+#define CUCKOO_MSB_LANES   0x8000800080008000ULL
+
+#define CUCKOO_LANE(word, slot) \
+    ((uint16_t)(((word) >> (16 * (slot))) & CUCKOO_LANE_MASK))
+
+#define CUCKOO_SET_LANE(word, slot, fp) (((word) & ~(CUCKOO_LANE_MASK << \
+            (16 * (slot)))) | ((uint64_t)(fp) << (16 * (slot))))
+
+static inline uint16_t cuckoo_fingerprint(const uint64_t hash)
+{
+    uint16_t fp;
+    fp = (uint16_t)(hash >> 48);
+    return (fp != 0 ? fp : 1);
+}
+
+/* partial-key cuckoo hashing, the alternate bucket is calculated
+ * by the fingerprint only */
+static inline uint32_t cuckoo_alt_index(FCCuckooFilter *filter,
+        const uint32_t index, const uint16_t fp)
+{
+    return (index ^ (fp * 0x5bd1e995U)) & filter->bucket_mask;
+}
+
+static inline bool cuckoo_bucket_has(const uint64_t word, const uint16_t fp)
+{
+    uint64_t x;
+
+    //test zero lane of the SWAR xor
+    x = word ^ (fp * CUCKOO_LSB_LANES);
+    return ((x - CUCKOO_LSB_LANES) & ~x & CUCKOO_MSB_LANES) != 0;
+}
+
+static inline int cuckoo_find_slot(const uint64_t word, const uint16_t fp)
+{
+    int slot;
+
+    for (slot=0; slot<FC_CUCKOO_SLOTS_PER_BUCKET; slot++) {
+        if (CUCKOO_LANE(word, slot) == fp) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static bool cuckoo_try_insert(FCCuckooFilter *filter,
+        const uint32_t index, const uint16_t fp)
+{
+    volatile uint64_t *bucket;
+    uint64_t old_word;
+    int slot;
+
+    bucket = filter->buckets + index;
+    old_word = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    while ((slot=cuckoo_find_slot(old_word, 0)) >= 0) {
+        if (__atomic_compare_exchange_n(bucket, &old_word,
+                    CUCKOO_SET_LANE(old_word, slot, fp), false,
+                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* replace the lane of the bucket when it equals to the expected value */
+static bool cuckoo_replace(FCCuckooFilter *filter, const uint32_t index,
+        const int slot, const uint16_t expect, const uint16_t fp)
+{
+    volatile uint64_t *bucket;
+    uint64_t old_word;
+
+    bucket = filter->buckets + index;
+    old_word = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    do {
+        if (CUCKOO_LANE(old_word, slot) != expect) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(bucket, &old_word,
+                CUCKOO_SET_LANE(old_word, slot, fp), false,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return true;
+}
+
+typedef struct {
+    uint32_t index;
+    int slot;
+    uint16_t fp;
+} CuckooPathEntry;
+
+/* find a path to an empty slot by random walk, then move the fingerprints
+ * from the end of the path. the fingerprint is copied to the new slot
+ * before its old slot is overwritten, so the concurrent readers never
+ * miss it. the caller MUST hold the lock
+ *
+ * return: 0 for success, EAGAIN for the path changed by the concurrent
+ *         writers, ENOSPC for no path
+ */
+static int cuckoo_kick(FCCuckooFilter *filter, CuckooPathEntry *path,
+        const uint32_t i1, const uint32_t i2, const uint16_t fp,
+        uint64_t *rand_state)
+{
+    uint32_t index;
+    uint32_t dest_index;
+    uint64_t word;
+    int dest_slot;
+    int depth;
+    int max_kicks;
+    int j;
+
+    max_kicks = FC_MIN(filter->max_kicks, FC_CUCKOO_DEFAULT_MAX_KICKS);
+    index = ((*rand_state) & 1) ? i1 : i2;
+    for (depth=0; depth<max_kicks; depth++) {
+        //xorshift64
+        *rand_state ^= *rand_state << 13;
+        *rand_state ^= *rand_state >> 7;
+        *rand_state ^= *rand_state << 17;
+
+        word = __atomic_load_n(filter->buckets + index, __ATOMIC_RELAXED);
+        path[depth].index = index;
+        path[depth].slot = (*rand_state >> 32) % FC_CUCKOO_SLOTS_PER_BUCKET;
+        path[depth].fp = CUCKOO_LANE(word, path[depth].slot);
+        if (path[depth].fp == 0) {  //freed by the concurrent deleter
+            return EAGAIN;
+        }
+
+        dest_index = cuckoo_alt_index(filter, index, path[depth].fp);
+        word = __atomic_load_n(filter->buckets + dest_index,
+                __ATOMIC_RELAXED);
+        if ((dest_slot=cuckoo_find_slot(word, 0)) < 0) {
+            index = dest_index;
+            continue;
+        }
+
+        for (j=depth; j>=0; j--) {
+            if (!cuckoo_replace(filter, dest_index, dest_slot,
+                        (j == depth ? 0 : path[j + 1].fp), path[j].fp))
+            {
+                return EAGAIN;
+            }
+            dest_index = path[j].index;
+            dest_slot = path[j].slot;
+        }
+        return cuckoo_replace(filter, dest_index, dest_slot,
+                path[0].fp, fp) ? 0 : EAGAIN;
+    }
+
+    return ENOSPC;
+}
+
+int fc_cuckoo_filter_init(FCCuckooFilter *filter,
+        const int64_t capacity, const uint64_t seed)
+{
+    int64_t bucket_count;
+    int result;
+
+    memset(filter, 0, sizeof(FCCuckooFilter));
+    if (capacity <= 0) {
+        return EINVAL;
+    }
+
+    //the load factor of 4 way buckets can reach 95%
+    bucket_count = 1;
+    while (bucket_count * FC_CUCKOO_SLOTS_PER_BUCKET * 0.95 < capacity) {
+        bucket_count *= 2;
+    }
+    if (bucket_count > (1LL << 32)) {
+        return EOVERFLOW;
+    }
+
+    filter->buckets = (volatile uint64_t *)fc_malloc(
+            sizeof(uint64_t) * bucket_count);
+    if (filter->buckets == NULL) {
+        return ENOMEM;
+    }
+    memset((void *)filter->buckets, 0, sizeof(uint64_t) * bucket_count);
+
+    if ((result=init_pthread_lock(&filter->lock)) != 0) {
+        free((void *)filter->buckets);
+        filter->buckets = NULL;
+        return result;
+    }
+
+    filter->bucket_mask = bucket_count - 1;
+    filter->seed = seed;
+    filter->max_kicks = FC_CUCKOO_DEFAULT_MAX_KICKS;
+    return 0;
+}
+
+void fc_cuckoo_filter_destroy(FCCuckooFilter *filter)
+{
+    if (filter->buckets != NULL) {
+        free((void *)filter->buckets);
+        filter->buckets = NULL;
+        pthread_mutex_destroy(&filter->lock);
+    }
+}
+
+int fc_cuckoo_filter_add_by_hash(FCCuckooFilter *filter, const uint64_t hash)
+{
+#define CUCKOO_MAX_RETRIES  16
+    CuckooPathEntry path[FC_CUCKOO_DEFAULT_MAX_KICKS];
+    uint64_t rand_state;
+    uint32_t i1;
+    uint32_t i2;
+    uint16_t fp;
+    int result;
+    int i;
+
+    fp = cuckoo_fingerprint(hash);
+    i1 = (uint32_t)hash & filter->bucket_mask;
+    i2 = cuckoo_alt_index(filter, i1, fp);
+    if (cuckoo_try_insert(filter, i1, fp) ||
+            cuckoo_try_insert(filter, i2, fp))
+    {
+        __sync_add_and_fetch(&filter->count, 1);
+        return 0;
+    }
+
+    rand_state = hash | 1;
+    result = ENOSPC;
+    PTHREAD_MUTEX_LOCK(&filter->lock);
+    for (i=0; i<CUCKOO_MAX_RETRIES; i++) {
+        if (cuckoo_try_insert(filter, i1, fp) ||
+                cuckoo_try_insert(filter, i2, fp))
+        {
+            result = 0;
+            break;
+        }
+
+        if ((result=cuckoo_kick(filter, path, i1, i2, fp,
+                        &rand_state)) != EAGAIN)
+        {
+            break;
+        }
+    }
+    PTHREAD_MUTEX_UNLOCK(&filter->lock);
+
+    if (result == 0) {
+        __sync_add_and_fetch(&filter->count, 1);
+    } else if (result == EAGAIN) {
+        result = ENOSPC;
+    }
+    return result;
+}
+
+bool fc_cuckoo_filter_contains_by_hash(FCCuckooFilter *filter,
+        const uint64_t hash)
+{
+    uint32_t i1;
+    uint16_t fp;
+
+    fp = cuckoo_fingerprint(hash);
+    i1 = (uint32_t)hash & filter->bucket_mask;
+    return cuckoo_bucket_has(__atomic_load_n(filter->buckets + i1,
+                __ATOMIC_ACQUIRE), fp) || cuckoo_bucket_has(
+                __atomic_load_n(filter->buckets + cuckoo_alt_index(
+                        filter, i1, fp), __ATOMIC_ACQUIRE), fp);
+}
+
+static bool cuckoo_try_delete(FCCuckooFilter *filter,
+        const uint32_t index, const uint16_t fp)
+{
+    volatile uint64_t *bucket;
+    uint64_t old_word;
+    int slot;
+
+    bucket = filter->buckets + index;
+    old_word = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+    while ((slot=cuckoo_find_slot(old_word, fp)) >= 0) {
+        if (__atomic_compare_exchange_n(bucket, &old_word,
+                    CUCKOO_SET_LANE(old_word, slot, 0), false,
+                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int fc_cuckoo_filter_delete_by_hash(FCCuckooFilter *filter,
+        const uint64_t hash)
+{
+    uint32_t i1;
+    uint16_t fp;
+
+    fp = cuckoo_fingerprint(hash);
+    i1 = (uint32_t)hash & filter->bucket_mask;
+    if (cuckoo_try_delete(filter, i1, fp) || cuckoo_try_delete(filter,
+                cuckoo_alt_index(filter, i1, fp), fp))
+    {
+        __sync_sub_and_fetch(&filter->count, 1);
+        return 0;
+    }
+    return ENOENT;
+}
+
+int fc_cuckoo_filter_save(FCCuckooFilter *filter, const char *filename)
+{
+    return filter_save_to_file(filename, FC_CUCKOO_FILE_MAGIC, filter->seed,
+            filter->count, (const void *)filter->buckets, sizeof(uint64_t),
+            (int64_t)filter->bucket_mask + 1);
+}
+
+int fc_cuckoo_filter_load(FCCuckooFilter *filter, const char *filename)
+{
+    FCFilterFileHeader header;
+    int result;
+    int fd;
+
+    memset(filter, 0, sizeof(FCCuckooFilter));
+    if ((result=filter_open_file(filename, FC_CUCKOO_FILE_MAGIC,
+                    sizeof(uint64_t), &header, &fd)) != 0)
+    {
+        return result;
+    }
+
+    if ((header.element_count & (header.element_count - 1)) != 0) {
+        logError("file: "__FILE__", line: %d, "
+                "invalid filter file: %s, bucket count: %"PRId64" is not "
+                "power of 2", __LINE__, filename, header.element_count);
+        close(fd);
+        return EINVAL;
+    }
+
+    //init with the max capacity of the bucket count
+    if ((result=fc_cuckoo_filter_init(filter, header.element_count *
+                    FC_CUCKOO_SLOTS_PER_BUCKET * 0.95, header.seed)) == 0)
+    {
+        if ((result=filter_read_data(filename, fd, &header,
+                        (void *)filter->buckets)) == 0)
+        {
+            filter->count = header.count;
+        } else {
+            fc_cuckoo_filter_destroy(filter);
+        }
+    }
+
+    close(fd);
+    return result;
+}
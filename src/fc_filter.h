@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_filter.h: approximate membership filters as the negative cache,
+//             the blocked bloom filter and the cuckoo filter
+
+#ifndef _FC_FILTER_H
+#define _FC_FILTER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "common_define.h"
+#include "fc_fast_hash.h"
+
+/* the bloom filter block is a cache line of 8 words, the key sets one bit
+ * in each word, so the lookup accesses only one cache line */
+#define FC_BLOOM_BLOCK_WORDS   8
+#define FC_BLOOM_BLOCK_BYTES  (FC_BLOOM_BLOCK_WORDS * sizeof(uint64_t))
+
+/* the cuckoo filter bucket is a 64 bits word of four 16 bits fingerprints,
+ * 0 for empty slot. the bucket is updated by CAS for concurrent insert */
+#define FC_CUCKOO_SLOTS_PER_BUCKET  4
+#define FC_CUCKOO_DEFAULT_MAX_KICKS 500
+
+typedef struct fc_bloom_filter
+{
+    uint64_t *blocks;
+    uint32_t block_count;
+    uint64_t seed;
+    volatile int64_t count;   //the inserted keys which set at least one bit
+} FCBloomFilter;
+
+typedef struct fc_cuckoo_filter
+{
+    volatile uint64_t *buckets;
+    uint32_t bucket_mask;     //bucket count - 1, the count is power of 2
+    uint64_t seed;
+    int max_kicks;            //up to FC_CUCKOO_DEFAULT_MAX_KICKS
+    volatile int64_t count;
+    pthread_mutex_t lock;     //serialize the kick out (relocation)
+} FCCuckooFilter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** init the blocked bloom filter
+ *  parameters:
+ *      filter: the bloom filter
+ *      expected_items: the expected item count
+ *      fpp: the expected false positive probability, such as 0.01
+ *      seed: the hash seed
+ *  return: 0 for success, != 0 for error
+ */
+int fc_bloom_filter_init(FCBloomFilter *filter, const int64_t expected_items,
+        const double fpp, const uint64_t seed);
+
+void fc_bloom_filter_destroy(FCBloomFilter *filter);
+
+void fc_bloom_filter_clear(FCBloomFilter *filter);
+
+/** add the key by the 64 bits hash code, thread safe
+ *  return: true for new bits set, false when the key maybe exist
+ */
+bool fc_bloom_filter_add_by_hash(FCBloomFilter *filter, const uint64_t hash);
+
+/** test the key by the 64 bits hash code, thread safe
+ *  return: false for the key NOT exist, true for the key maybe exist
+ */
+bool fc_bloom_filter_contains_by_hash(FCBloomFilter *filter,
+        const uint64_t hash);
+
+static inline bool fc_bloom_filter_add(FCBloomFilter *filter,
+        const void *key, const int key_len)
+{
+    return fc_bloom_filter_add_by_hash(filter,
+            fc_xxh3_64(key, key_len, filter->seed));
+}
+
+static inline bool fc_bloom_filter_contains(FCBloomFilter *filter,
+        const void *key, const int key_len)
+{
+    return fc_bloom_filter_contains_by_hash(filter,
+            fc_xxh3_64(key, key_len, filter->seed));
+}
+
+/** save the bloom filter to the file (write to the temp file then rename)
+ *  parameters:
+ *      filter: the bloom filter
+ *      filename: the filename to save
+ *  return: 0 for success, != 0 for error
+ */
+int fc_bloom_filter_save(FCBloomFilter *filter, const char *filename);
+
+/** init the bloom filter from the file saved by fc_bloom_filter_save
+ *  parameters:
+ *      filter: the bloom filter to init
+ *      filename: the filename to load
+ *  return: 0 for success, != 0 for error
+ */
+int fc_bloom_filter_load(FCBloomFilter *filter, const char *filename);
+
+
+/** init the cuckoo filter
+ *  parameters:
+ *      filter: the cuckoo filter
+ *      capacity: the max item count
+ *      seed: the hash seed
+ *  return: 0 for success, != 0 for error
+ */
+int fc_cuckoo_filter_init(FCCuckooFilter *filter,
+        const int64_t capacity, const uint64_t seed);
+
+void fc_cuckoo_filter_destroy(FCCuckooFilter *filter);
+
+/** add the key by the 64 bits hash code, thread safe. the same key can be
+ *  added more than once and MUST be deleted the same times
+ *  return: 0 for success, ENOSPC for the filter is full
+ */
+int fc_cuckoo_filter_add_by_hash(FCCuckooFilter *filter, const uint64_t hash);
+
+/** test the key by the 64 bits hash code, thread safe
+ *  return: false for the key NOT exist, true for the key maybe exist
+ */
+bool fc_cuckoo_filter_contains_by_hash(FCCuckooFilter *filter,
+        const uint64_t hash);
+
+/** delete the key by the 64 bits hash code, thread safe. the key MUST be
+ *  added before, otherwise the other key with the same fingerprint
+ *  maybe deleted
+ *  return: 0 for success, ENOENT for not exist
+ */
+int fc_cuckoo_filter_delete_by_hash(FCCuckooFilter *filter,
+        const uint64_t hash);
+
+static inline int fc_cuckoo_filter_add(FCCuckooFilter *filter,
+        const void *key, const int key_len)
+{
+    return fc_cuckoo_filter_add_by_hash(filter,
+            fc_xxh3_64(key, key_len, filter->seed));
+}
+
+static inline bool fc_cuckoo_filter_contains(FCCuckooFilter *filter,
+        const void *key, const int key_len)
+{
+    return fc_cuckoo_filter_contains_by_hash(filter,
+            fc_xxh3_64(key, key_len, filter->seed));
+}
+
+static inline int fc_cuckoo_filter_delete(FCCuckooFilter *filter,
+        const void *key, const int key_len)
+{
+    return fc_cuckoo_filter_delete_by_hash(filter,
+            fc_xxh3_64(key, key_len, filter->seed));
+}
+
+static inline int64_t fc_cuckoo_filter_count(FCCuckooFilter *filter)
+{
+    return __atomic_load_n(&filter->count, __ATOMIC_RELAXED);
+}
+
+int fc_cuckoo_filter_save(FCCuckooFilter *filter, const char *filename);
+
+int fc_cuckoo_filter_load(FCCuckooFilter *filter, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_line_scan.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "system_info.h"
+#include "fc_line_scan.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FC_LINE_SCAN_X86_SIMD  1
+#endif
+
+typedef int64_t (*fc_count_lines_func)(const char *buff, const int64_t len);
+
+typedef struct fc_line_count_task {
+    const char *buff;
+    int64_t len;
+    int64_t count;
+} FCLineCountTask;
+
+static int64_t fc_count_lines_scalar(const char *buff, const int64_t len)
+{
+    const char *p;
+    const char *end;
+    int64_t count;
+
+    count = 0;
+    p = buff;
+    end = buff + len;
+    while (p < end && (p=(const char *)memchr(p, '\n', end - p)) != NULL) {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+#ifdef FC_LINE_SCAN_X86_SIMD
+/* the byte counters of the compare results are summed by psadbw
+ * every 255 loops at most to avoid the overflow */
+static int64_t fc_count_lines_sse2(const char *buff, const int64_t len)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    const char *p;
+    const char *end;
+    __m128i acc;
+    __m128i sum;
+    int loops;
+    int64_t count;
+
+    count = 0;
+    p = buff;
+    end = buff + (len & ~((int64_t)15));
+    sum = zero;
+    while (p < end) {
+        acc = zero;
+        for (loops=0; loops<255 && p<end; loops++, p+=16) {
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *)p), newline));
+        }
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(acc, zero));
+    }
+    count = _mm_cvtsi128_si64(sum) + _mm_cvtsi128_si64(
+            _mm_unpackhi_epi64(sum, sum));
+    return count + fc_count_lines_scalar(end, buff + len - end);
+}
+
+__attribute__((target("avx2")))
+static int64_t fc_count_lines_avx2(const char *buff, const int64_t len)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    const char *p;
+    const char *end;
+    __m256i acc;
+    __m256i sum;
+    int loops;
+    int64_t count;
+
+    p = buff;
+    end = buff + (len & ~((int64_t)63));
+    sum = zero;
+    while (p < end) {
+        acc = zero;
+        for (loops=0; loops<127 && p<end; loops++, p+=64) {
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(
+                        _mm256_loadu_si256((const __m256i *)p), newline));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(
+                        _mm256_loadu_si256((const __m256i *)(p + 32)),
+                        newline));
+        }
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(acc, zero));
+    }
+    count = _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) +
+        _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+    return count + fc_count_lines_sse2(end, buff + len - end);
+}
+#endif
+
+static fc_count_lines_func fc_get_count_lines_func()
+{
+    static fc_count_lines_func count_func = NULL;
+
+    if (count_func == NULL) {
+#ifdef FC_LINE_SCAN_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            count_func = fc_count_lines_avx2;
+        } else {
+            count_func = fc_count_lines_sse2;
+        }
+#else
+        count_func = fc_count_lines_scalar;
+#endif
+    }
+    return count_func;
+}
+
+int64_t fc_count_lines(const char *buff, const int64_t len)
+{
+    if (len <= 0) {
+        return 0;
+    }
+    return fc_get_count_lines_func()(buff, len);
+}
+
+int fc_mapped_file_open(FCMappedFile *mf, const char *filename,
+        const bool sequential)
+{
+    struct stat st;
+    int result;
+
+    mf->map = NULL;
+    mf->size = 0;
+    if ((mf->fd=open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : EACCES;
+        logError("file: "__FILE__", line: %d, "
+                "open file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        return result;
+    }
+    if (fstat(mf->fd, &st) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "stat file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        close(mf->fd);
+        mf->fd = -1;
+        return result;
+    }
+
+    mf->size = st.st_size;
+    if (mf->size == 0) {
+        return 0;
+    }
+
+    mf->map = (char *)mmap(NULL, mf->size, PROT_READ,
+            MAP_SHARED, mf->fd, 0);
+    if (mf->map == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        logError("file: "__FILE__", line: %d, "
+                "mmap file \"%s\" fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        mf->map = NULL;
+        close(mf->fd);
+        mf->fd = -1;
+        return result;
+    }
+    if (sequential) {
+        madvise(mf->map, mf->size, MADV_SEQUENTIAL);
+    }
+    return 0;
+}
+
+void fc_mapped_file_close(FCMappedFile *mf)
+{
+    if (mf->map != NULL) {
+        munmap(mf->map, mf->size);
+        mf->map = NULL;
+    }
+    if (mf->fd >= 0) {
+        close(mf->fd);
+        mf->fd = -1;
+    }
+}
+
+static void *fc_line_count_thread_func(void *arg)
+{
+    FCLineCountTask *task;
+
+    task = (FCLineCountTask *)arg;
+    task->count = fc_count_lines(task->buff, task->len);
+    return NULL;
+}
+
+static int64_t fc_count_lines_parallel(const char *buff,
+        const int64_t len, int thread_count)
+{
+    FCLineCountTask tasks[FC_LINE_SCAN_MAX_THREADS];
+    pthread_t tids[FC_LINE_SCAN_MAX_THREADS];
+    bool created[FC_LINE_SCAN_MAX_THREADS];
+    int64_t chunk_size;
+    int64_t offset;
+    int64_t count;
+    int i;
+
+    if (thread_count == 0) {
+        thread_count = get_sys_cpu_count();
+    }
+    if (thread_count > len / FC_LINE_SCAN_PARALLEL_CHUNK_SIZE) {
+        thread_count = len / FC_LINE_SCAN_PARALLEL_CHUNK_SIZE;
+    }
+    if (thread_count > FC_LINE_SCAN_MAX_THREADS) {
+        thread_count = FC_LINE_SCAN_MAX_THREADS;
+    }
+    if (thread_count <= 1) {
+        return fc_count_lines(buff, len);
+    }
+
+    chunk_size = len / thread_count;
+    offset = 0;
+    for (i=0; i<thread_count; i++) {
+        tasks[i].buff = buff + offset;
+        tasks[i].len = (i == thread_count - 1) ? len - offset : chunk_size;
+        tasks[i].count = 0;
+        offset += tasks[i].len;
+    }
+
+    //the caller thread counts the first chunk
+    for (i=1; i<thread_count; i++) {
+        created[i] = (pthread_create(tids + i, NULL,
+                    fc_line_count_thread_func, tasks + i) == 0);
+        if (!created[i]) {
+            fc_line_count_thread_func(tasks + i);
+        }
+    }
+    fc_line_count_thread_func(tasks + 0);
+
+    count = tasks[0].count;
+    for (i=1; i<thread_count; i++) {
+        if (created[i]) {
+            pthread_join(tids[i], NULL);
+        }
+        count += tasks[i].count;
+    }
+    return count;
+}
+
+int fc_count_file_lines(const char *filename, const int64_t until_offset,
+        const int thread_count, int64_t *line_count)
+{
+    FCMappedFile mf;
+    int64_t len;
+    int result;
+
+    *line_count = 0;
+    if ((result=fc_mapped_file_open(&mf, filename, true)) != 0) {
+        return result;
+    }
+
+    len = mf.size;
+    if (until_offset >= 0 && until_offset < len) {
+        len = until_offset;
+    }
+    if (len > 0) {
+        if (thread_count == 1) {
+            *line_count = fc_count_lines(mf.map, len);
+        } else {
+            *line_count = fc_count_lines_parallel(mf.map, len, thread_count);
+        }
+    }
+    fc_mapped_file_close(&mf);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//fc_line_scan.h: the mmap backed line iterator and the SIMD line counter
+
+#ifndef _FC_LINE_SCAN_H
+#define _FC_LINE_SCAN_H
+
+#include <string.h>
+#include "common_define.h"
+
+//the min bytes per thread of the parallel count
+#define FC_LINE_SCAN_PARALLEL_CHUNK_SIZE  (64 * 1024 * 1024)
+#define FC_LINE_SCAN_MAX_THREADS          16
+
+typedef struct fc_mapped_file {
+    int fd;
+    char *map;      //NULL for the empty file
+    int64_t size;
+} FCMappedFile;
+
+typedef struct fc_line_iterator {
+    const char *current;
+    const char *end;
+    int64_t line_no;   //the line number of the last line, start from 1
+} FCLineIterator;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** map the file readonly
+ *  parameters:
+ *      mf: the mapped file
+ *      filename: the filename
+ *      sequential: madvise MADV_SEQUENTIAL for the sequential scan
+ *  return: error no, 0 for success
+ */
+int fc_mapped_file_open(FCMappedFile *mf, const char *filename,
+        const bool sequential);
+
+/** unmap and close the file
+ *  parameters:
+ *      mf: the mapped file
+ *  return: none
+ */
+void fc_mapped_file_close(FCMappedFile *mf);
+
+/** count the new line chars by SSE2 / AVX2 when supported
+ *  parameters:
+ *      buff: the buffer
+ *      len: the buffer length
+ *  return: the count of '\n'
+ */
+int64_t fc_count_lines(const char *buff, const int64_t len);
+
+/** count the new line chars of the file by the mmap, the large file is
+ *  counted by the threads in chunks
+ *  parameters:
+ *      filename: the filename
+ *      until_offset: until the file offset, -1 for the file end
+ *      thread_count: the max threads, 0 for auto, 1 for no thread
+ *      line_count: return the line count
+ *  return: error no, 0 for success
+ */
+int fc_count_file_lines(const char *filename, const int64_t until_offset,
+        const int thread_count, int64_t *line_count);
+
+static inline void fc_line_iterator_init(FCLineIterator *it,
+        const char *buff, const int64_t len)
+{
+    it->current = buff;
+    it->end = buff + len;
+    it->line_no = 0;
+}
+
+/** get the next line include the '\n', the last line maybe without '\n'
+ *  parameters:
+ *      it: the line iterator
+ *      line: return the line which points to the buffer
+ *  return: true for got a line, false for the end
+ */
+static inline bool fc_line_iterator_next(FCLineIterator *it, string_t *line)
+{
+    const char *line_end;
+
+    if (it->current >= it->end) {
+        return false;
+    }
+
+    //glibc memchr is vectorized already
+    line_end = (const char *)memchr(it->current, '\n',
+            it->end - it->current);
+    line->str = (char *)it->current;
+    it->current = (line_end != NULL) ? line_end + 1 : it->end;
+    line->len = it->current - line->str;
+    it->line_no++;
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "fc_memory.h"
+#include "flat_hash.h"
+
+#if FLAT_HASH_GROUP_WIDTH == 8
+#define FLAT_HASH_BITMASK_SHIFT  3
+#define FLAT_HASH_LSB_BYTES  0x0101010101010101ULL
+#define FLAT_HASH_MSB_BYTES  0x8080808080808080ULL
+#else
+#define FLAT_HASH_BITMASK_SHIFT  0
+#endif
+
+#define FLAT_HASH_H1(table, hash_code)  ((hash_code) & (table)->mask)
+#define FLAT_HASH_H2(hash_code)  ((unsigned char)((hash_code) >> 25))
+
+#if FLAT_HASH_GROUP_WIDTH == 8
+typedef uint64_t flat_hash_bitmask_t;
+
+static inline uint64_t group_load(const unsigned char *ctrl)
+{
+    uint64_t word;
+    memcpy(&word, ctrl, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+static inline flat_hash_bitmask_t group_match(
+        const unsigned char *ctrl, const unsigned char h2)
+{
+    uint64_t x;
+
+    //may report false positive, the caller MUST compare the key
+    x = group_load(ctrl) ^ (FLAT_HASH_LSB_BYTES * h2);
+    return (x - FLAT_HASH_LSB_BYTES) & ~x & FLAT_HASH_MSB_BYTES;
+}
+
+static inline flat_hash_bitmask_t group_match_empty(
+        const unsigned char *ctrl)
+{
+    return group_load(ctrl) & FLAT_HASH_MSB_BYTES;
+}
+
+#define BITMASK_LOWEST(mask) (__builtin_ctzll(mask) >> FLAT_HASH_BITMASK_SHIFT)
+
+#else
+typedef uint32_t flat_hash_bitmask_t;
+
+static inline flat_hash_bitmask_t group_match(
+        const unsigned char *ctrl, const unsigned char h2)
+{
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)ctrl),
+                _mm256_set1_epi8((char)h2)));
+#else
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)ctrl),
+                _mm_set1_epi8((char)h2)));
+#endif
+}
+
+static inline flat_hash_bitmask_t group_match_empty(
+        const unsigned char *ctrl)
+{
+    //only the empty control byte has the high bit
+#if defined(__AVX2__)
+    return (uint32_t)_mm256_movemask_epi8(
+            _mm256_loadu_si256((const __m256i *)ctrl));
+#else
+    return (uint32_t)_mm_movemask_epi8(
+            _mm_loadu_si128((const __m128i *)ctrl));
+#endif
+}
+
+#define BITMASK_LOWEST(mask) __builtin_ctz(mask)
+
+#endif
+
+static inline unsigned int flat_hash_mix(const unsigned int h)
+{
+    unsigned int hash_code;
+
+    //murmur3 finalizer, let weak hash functions fill the high bits
+    hash_code = h;
+    hash_code ^= hash_code >> 16;
+    hash_code *= 0x85ebca6b;
+    hash_code ^= hash_code >> 13;
+    hash_code *= 0xc2b2ae35;
+    hash_code ^= hash_code >> 16;
+    return hash_code;
+}
+
+static inline void flat_hash_set_ctrl(FlatHashTable *table,
+        const uint32_t index, const unsigned char value)
+{
+    table->ctrl[index] = value;
+
+    //the cloned bytes after the end for the group wrapped around
+    table->ctrl[((index - FLAT_HASH_GROUP_WIDTH) & table->mask) +
+        FLAT_HASH_GROUP_WIDTH] = value;
+}
+
+static int flat_hash_alloc(FlatHashTable *table, const uint32_t capacity)
+{
+    int64_t ctrl_bytes;
+    int64_t slot_bytes;
+
+    ctrl_bytes = MEM_ALIGN(capacity + FLAT_HASH_GROUP_WIDTH);
+    slot_bytes = (int64_t)sizeof(FlatHashEntry) * capacity;
+    if ((table->ctrl=(unsigned char *)fc_malloc(ctrl_bytes +
+                    slot_bytes)) == NULL)
+    {
+        return ENOMEM;
+    }
+    memset(table->ctrl, FLAT_HASH_CTRL_EMPTY,
+            capacity + FLAT_HASH_GROUP_WIDTH);
+    table->slots = (FlatHashEntry *)(table->ctrl + ctrl_bytes);
+
+    table->capacity = capacity;
+    table->mask = capacity - 1;
+    table->grow_threshold = capacity - capacity / 8;
+    table->bytes_used += ctrl_bytes + slot_bytes;
+    return 0;
+}
+
+static inline uint32_t flat_hash_find_empty(FlatHashTable *table,
+        const unsigned int hash_code)
+{
+    uint32_t pos;
+    flat_hash_bitmask_t mask;
+
+    pos = FLAT_HASH_H1(table, hash_code);
+    while (1) {
+        if ((mask=group_match_empty(table->ctrl + pos)) != 0) {
+            return (pos + BITMASK_LOWEST(mask)) & table->mask;
+        }
+        pos = (pos + FLAT_HASH_GROUP_WIDTH) & table->mask;
+    }
+}
+
+int flat_hash_init(FlatHashTable *table, HashFunc hash_func,
+        const int capacity)
+{
+    uint32_t alloc_capacity;
+
+    memset(table, 0, sizeof(FlatHashTable));
+    if (capacity < 0 || capacity > (1 << 30)) {
+        return EINVAL;
+    }
+
+    alloc_capacity = FLAT_HASH_MIN_CAPACITY;
+    while (alloc_capacity - alloc_capacity / 8 < capacity) {
+        alloc_capacity *= 2;
+    }
+
+    table->hash_func = hash_func;
+    return flat_hash_alloc(table, alloc_capacity);
+}
+
+void flat_hash_destroy(FlatHashTable *table)
+{
+    uint32_t i;
+
+    if (table->ctrl == NULL) {
+        return;
+    }
+
+    for (i=0; i<table->capacity; i++) {
+        if (table->ctrl[i] != FLAT_HASH_CTRL_EMPTY &&
+                table->slots[i].key_len > FLAT_HASH_INLINE_KEY_SIZE)
+        {
+            free(table->slots[i].key.ptr);
+        }
+    }
+
+    free(table->ctrl);
+    table->ctrl = NULL;
+    table->slots = NULL;
+    table->item_count = 0;
+    table->bytes_used = 0;
+}
+
+static int flat_hash_grow(FlatHashTable *table)
+{
+    unsigned char *old_ctrl;
+    FlatHashEntry *old_slots;
+    uint32_t old_capacity;
+    uint32_t index;
+    uint32_t i;
+    int result;
+
+    if (table->capacity >= (1U << 30)) {
+        return ENOSPC;
+    }
+
+    old_ctrl = table->ctrl;
+    old_slots = table->slots;
+    old_capacity = table->capacity;
+    table->bytes_used -= MEM_ALIGN(old_capacity + FLAT_HASH_GROUP_WIDTH) +
+        sizeof(FlatHashEntry) * old_capacity;
+    if ((result=flat_hash_alloc(table, old_capacity * 2)) != 0) {
+        table->bytes_used += MEM_ALIGN(old_capacity + FLAT_HASH_GROUP_WIDTH) +
+            sizeof(FlatHashEntry) * old_capacity;
+        table->ctrl = old_ctrl;
+        table->slots = old_slots;
+        return result;
+    }
+
+    for (i=0; i<old_capacity; i++) {
+        if (old_ctrl[i] == FLAT_HASH_CTRL_EMPTY) {
+            continue;
+        }
+
+        index = flat_hash_find_empty(table, old_slots[i].hash_code);
+        flat_hash_set_ctrl(table, index, old_ctrl[i]);
+        table->slots[index] = old_slots[i];
+    }
+
+    free(old_ctrl);
+    return 0;
+}
+
+#define FLAT_HASH_ENTRY_EQUALS(entry, hcode, key, key_len) \
+    ((entry)->hash_code == hcode && (entry)->key_len == key_len && \
+     memcmp(FLAT_HASH_ENTRY_KEY(entry), key, key_len) == 0)
+
+static inline int flat_hash_lookup(FlatHashTable *table,
+        const unsigned int hash_code, const void *key,
+        const int key_len, uint32_t *empty_index)
+{
+    uint32_t pos;
+    uint32_t index;
+    unsigned char h2;
+    flat_hash_bitmask_t mask;
+    flat_hash_bitmask_t empty;
+
+    h2 = FLAT_HASH_H2(hash_code);
+    pos = FLAT_HASH_H1(table, hash_code);
+    while (1) {
+        mask = group_match(table->ctrl + pos, h2);
+        while (mask != 0) {
+            index = (pos + BITMASK_LOWEST(mask)) & table->mask;
+            if (FLAT_HASH_ENTRY_EQUALS(table->slots + index,
+                        hash_code, key, key_len))
+            {
+                return index;
+            }
+            mask &= mask - 1;
+        }
+
+        //the probe chain ends at the first empty slot
+        if ((empty=group_match_empty(table->ctrl + pos)) != 0) {
+            if (empty_index != NULL) {
+                *empty_index = (pos + BITMASK_LOWEST(empty)) & table->mask;
+            }
+            return -1;
+        }
+        pos = (pos + FLAT_HASH_GROUP_WIDTH) & table->mask;
+    }
+}
+
+FlatHashEntry *flat_hash_find_ex(FlatHashTable *table,
+        const void *key, const int key_len)
+{
+    int index;
+
+    index = flat_hash_lookup(table, flat_hash_mix(table->hash_func(
+                    key, key_len)), key, key_len, NULL);
+    return (index >= 0 ? table->slots + index : NULL);
+}
+
+int flat_hash_insert(FlatHashTable *table, const void *key,
+        const int key_len, void *value, const int value_len)
+{
+    unsigned int hash_code;
+    uint32_t empty_index;
+    int index;
+    int result;
+    FlatHashEntry *entry;
+
+    hash_code = flat_hash_mix(table->hash_func(key, key_len));
+    empty_index = 0;
+    if ((index=flat_hash_lookup(table, hash_code, key,
+                    key_len, &empty_index)) >= 0)
+    {
+        entry = table->slots + index;
+        entry->value = value;
+        entry->value_len = value_len;
+        return 0;
+    }
+
+    if (table->item_count >= table->grow_threshold) {
+        if ((result=flat_hash_grow(table)) != 0) {
+            return -1 * result;
+        }
+        empty_index = flat_hash_find_empty(table, hash_code);
+    }
+
+    entry = table->slots + empty_index;
+    if (key_len > FLAT_HASH_INLINE_KEY_SIZE) {
+        if ((entry->key.ptr=(char *)fc_malloc(key_len)) == NULL) {
+            return -ENOMEM;
+        }
+        memcpy(entry->key.ptr, key, key_len);
+        table->bytes_used += key_len;
+    } else {
+        memcpy(entry->key.buff, key, key_len);
+    }
+    entry->hash_code = hash_code;
+    entry->key_len = key_len;
+    entry->value = value;
+    entry->value_len = value_len;
+    flat_hash_set_ctrl(table, empty_index, FLAT_HASH_H2(hash_code));
+    table->item_count++;
+    return 1;
+}
+
+int flat_hash_delete(FlatHashTable *table, const void *key,
+        const int key_len)
+{
+    FlatHashEntry *entry;
+    uint32_t hole;
+    uint32_t home;
+    uint32_t next;
+    int index;
+
+    if ((index=flat_hash_lookup(table, flat_hash_mix(table->hash_func(
+                        key, key_len)), key, key_len, NULL)) < 0)
+    {
+        return ENOENT;
+    }
+
+    entry = table->slots + index;
+    if (entry->key_len > FLAT_HASH_INLINE_KEY_SIZE) {
+        free(entry->key.ptr);
+        table->bytes_used -= entry->key_len;
+    }
+
+    /* backward shift deletion: move the following entries of the
+     * probe chain to the hole, so the chain has no empty gap */
+    hole = index;
+    next = hole;
+    while (1) {
+        next = (next + 1) & table->mask;
+        if (table->ctrl[next] == FLAT_HASH_CTRL_EMPTY) {
+            break;
+        }
+
+        home = FLAT_HASH_H1(table, table->slots[next].hash_code);
+        if (((next - home) & table->mask) >= ((next - hole) & table->mask)) {
+            table->slots[hole] = table->slots[next];
+            flat_hash_set_ctrl(table, hole, table->ctrl[next]);
+            hole = next;
+        }
+    }
+
+    flat_hash_set_ctrl(table, hole, FLAT_HASH_CTRL_EMPTY);
+    table->item_count--;
+    return 0;
+}
+
+int flat_hash_walk(FlatHashTable *table, FlatHashWalkFunc walk_func,
+        void *args)
+{
+    uint32_t i;
+    int index;
+    int result;
+
+    index = 0;
+    for (i=0; i<table->capacity; i++) {
+        if (table->ctrl[i] == FLAT_HASH_CTRL_EMPTY) {
+            continue;
+        }
+
+        if ((result=walk_func(index++, table->slots + i, args)) != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
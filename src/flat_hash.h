@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//flat_hash.h: open addressing hash table (swiss table alike)
+
+#ifndef _FLAT_HASH_H
+#define _FLAT_HASH_H
+
+#include <stdint.h>
+#include "common_define.h"
+#include "hash.h"
+
+/* one control byte per slot:
+ *   FLAT_HASH_CTRL_EMPTY for empty slot,
+ *   the 7 high bits of the hash code for used slot
+ *
+ * the control bytes of a group are probed by SSE2 / AVX2 when available
+ */
+#if defined(__AVX2__)
+#define FLAT_HASH_GROUP_WIDTH  32
+#elif defined(__SSE2__)
+#define FLAT_HASH_GROUP_WIDTH  16
+#else
+#define FLAT_HASH_GROUP_WIDTH   8
+#endif
+
+#define FLAT_HASH_CTRL_EMPTY     ((unsigned char)0x80)
+
+#define FLAT_HASH_INLINE_KEY_SIZE  16
+#define FLAT_HASH_MIN_CAPACITY     FLAT_HASH_GROUP_WIDTH
+
+typedef struct flat_hash_entry
+{
+    unsigned int hash_code;
+    int key_len;
+    union {
+        char buff[FLAT_HASH_INLINE_KEY_SIZE];  //inline key
+        char *ptr;  //malloced key when key_len > FLAT_HASH_INLINE_KEY_SIZE
+    } key;
+    void *value;
+    int value_len;
+} FlatHashEntry;
+
+typedef struct flat_hash_table
+{
+    HashFunc hash_func;
+    unsigned char *ctrl;   //capacity + FLAT_HASH_GROUP_WIDTH cloned bytes
+    FlatHashEntry *slots;
+    uint32_t capacity;     //power of 2
+    uint32_t mask;         //capacity - 1
+    int item_count;
+    int grow_threshold;    //7/8 of capacity
+    int64_t bytes_used;
+} FlatHashTable;
+
+/**
+ * flat hash walk function
+ * parameters:
+ *         index: item index based 0
+ *         entry: the hash entry, including key and value
+ *         args: passed by flat_hash_walk function
+ * return 0 for success, != 0 for error
+*/
+typedef int (*FlatHashWalkFunc)(const int index,
+        const FlatHashEntry *entry, void *args);
+
+#define FLAT_HASH_ENTRY_KEY(entry) ((entry)->key_len <= \
+        FLAT_HASH_INLINE_KEY_SIZE ? (entry)->key.buff : (entry)->key.ptr)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * flat hash init function
+ * parameters:
+ *         table: the hash table
+ *         hash_func: hash function
+ *         capacity: init capacity, round up to power of 2
+ * return 0 for success, != 0 for error
+*/
+int flat_hash_init(FlatHashTable *table, HashFunc hash_func,
+        const int capacity);
+
+/**
+ * flat hash destroy function
+ * parameters:
+ *         table: the hash table
+ * return none
+*/
+void flat_hash_destroy(FlatHashTable *table);
+
+/**
+ * flat hash insert key
+ * parameters:
+ *         table: the hash table
+ *         key: the key to insert
+ *         key_len: length of th key
+ *         value: the value (the pointer is stored, NOT copied)
+ *         value_len: length of the value
+ * return >= 0 for success, 0 for key already exist (update),
+ *        1 for new key (insert), < 0 for error
+*/
+int flat_hash_insert(FlatHashTable *table, const void *key,
+        const int key_len, void *value, const int value_len);
+
+/**
+ * flat hash find key
+ * parameters:
+ *         table: the hash table
+ *         key: the key to find
+ *         key_len: length of th key
+ * return hash entry, return NULL when the key not exist
+*/
+FlatHashEntry *flat_hash_find_ex(FlatHashTable *table,
+        const void *key, const int key_len);
+
+/**
+ * flat hash find key
+ * parameters:
+ *         table: the hash table
+ *         key: the key to find
+ *         key_len: length of th key
+ * return user data, return NULL when the key not exist
+*/
+static inline void *flat_hash_find(FlatHashTable *table,
+        const void *key, const int key_len)
+{
+    FlatHashEntry *entry;
+    if ((entry=flat_hash_find_ex(table, key, key_len)) != NULL) {
+        return entry->value;
+    } else {
+        return NULL;
+    }
+}
+
+static inline void *flat_hash_find1(FlatHashTable *table,
+        const string_t *key)
+{
+    return flat_hash_find(table, key->str, key->len);
+}
+
+/**
+ * flat hash delete key, the following entries of the probe chain are
+ * shifted backward so no tombstone is left
+ * parameters:
+ *         table: the hash table
+ *         key: the key to delete
+ *         key_len: length of th key
+ * return 0 for success, != 0 fail (errno)
+*/
+int flat_hash_delete(FlatHashTable *table, const void *key,
+        const int key_len);
+
+/**
+ * flat hash walk (iterator)
+ * parameters:
+ *         table: the hash table
+ *         walk_func: walk (interator) function
+ *         args: extra args which will be passed to walk_func
+ * return 0 for success, != 0 fail (errno)
+*/
+int flat_hash_walk(FlatHashTable *table, FlatHashWalkFunc walk_func,
+        void *args);
+
+static inline int flat_hash_count(FlatHashTable *table)
+{
+    return table->item_count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
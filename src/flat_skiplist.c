@@ -76,7 +76,8 @@ int flat_skiplist_init_ex(FlatSkiplist *sl, const int level_count,
     for (i=level_count-1; i>=0; i--) {
         sprintf(name, "flat-sl-level%02d", i);
         element_size = sizeof(FlatSkiplistNode) +
-            sizeof(FlatSkiplistNode *) * (i + 1);
+            sizeof(FlatSkiplistNode *) * (i + 1) +
+            sizeof(int) * (i + 1);  //the span widths
         if ((result=fast_mblock_init_ex1(sl->mblocks + i, name,
             element_size, alloc_elements_once, alloc_elements_limit,
             NULL, NULL, false)) != 0)
@@ -95,6 +96,7 @@ int flat_skiplist_init_ex(FlatSkiplist *sl, const int level_count,
         return ENOMEM;
     }
     memset(sl->top, 0, top_mblock->info.element_size);
+    sl->top->level_index = sl->top_level_index;
 
     sl->tail = (FlatSkiplistNode *)fast_mblock_alloc_object(sl->mblocks + 0);
     if (sl->tail == NULL) {
@@ -105,13 +107,14 @@ int flat_skiplist_init_ex(FlatSkiplist *sl, const int level_count,
     sl->tail->prev = sl->top;
     for (i=0; i<level_count; i++) {
         sl->top->links[i] = sl->tail;
+        FLAT_SKIPLIST_WIDTHS(sl->top)[i] = 1;
     }
 
     sl->level_count = level_count;
+    sl->element_count = 0;
     sl->compare_func = compare_func;
     sl->free_func = free_func;
-
-    srand(time(NULL));
+    sl->rand_state = skiplist_rand_seed(sl);
     return 0;
 }
 
@@ -144,21 +147,17 @@ void flat_skiplist_destroy(FlatSkiplist *sl)
 
 static inline int flat_skiplist_get_level_index(FlatSkiplist *sl)
 {
-    int i;
-
-    for (i=0; i<sl->top_level_index; i++) {
-        if (rand() < RAND_MAX / 2) {
-            break;
-        }
-    }
-
-    return i;
+    return skiplist_rand_level_index(&sl->rand_state, sl->top_level_index);
 }
 
 int flat_skiplist_insert(FlatSkiplist *sl, void *data)
 {
     int i;
     int level_index;
+    int rank;
+    int position;
+    int *widths;
+    int ranks[SKIPLIST_MAX_LEVEL_COUNT];
     FlatSkiplistNode *node;
     FlatSkiplistNode *previous;
 
@@ -168,25 +167,21 @@ int flat_skiplist_insert(FlatSkiplist *sl, void *data)
         return ENOMEM;
     }
     node->data = data;
+    node->level_index = level_index;
 
+    //the ranks are the positions of the predecessors, the top node is 0
     previous = sl->top;
-    for (i=sl->top_level_index; i>level_index; i--) {
-        while (previous->links[i] != sl->tail && sl->compare_func(data,
-                    previous->links[i]->data) < 0)
-        {
-            previous = previous->links[i];
-        }
-    }
-
-    while (i >= 0) {
+    rank = 0;
+    for (i=sl->top_level_index; i>=0; i--) {
         while (previous->links[i] != sl->tail && sl->compare_func(data,
                     previous->links[i]->data) < 0)
         {
+            rank += FLAT_SKIPLIST_WIDTHS(previous)[i];
             previous = previous->links[i];
         }
 
         sl->tmp_previous[i] = previous;
-        i--;
+        ranks[i] = rank;
     }
 
     //set previous links of level 0
@@ -194,16 +189,27 @@ int flat_skiplist_insert(FlatSkiplist *sl, void *data)
     previous->links[0]->prev = node;
 
     //thread safe for one write with many read model
+    position = rank + 1;
     for (i=0; i<=level_index; i++) {
+        widths = FLAT_SKIPLIST_WIDTHS(sl->tmp_previous[i]);
+        FLAT_SKIPLIST_WIDTHS(node)[i] = ranks[i] + widths[i] + 1 - position;
+        widths[i] = position - ranks[i];
+
         node->links[i] = sl->tmp_previous[i]->links[i];
         sl->tmp_previous[i]->links[i] = node;
     }
+    for (; i<=sl->top_level_index; i++) {
+        FLAT_SKIPLIST_WIDTHS(sl->tmp_previous[i])[i]++;
+    }
 
+    sl->element_count++;
     return 0;
 }
 
-static FlatSkiplistNode *flat_skiplist_get_previous(FlatSkiplist *sl, void *data,
-        int *level_index)
+/* the update records the predecessors of the levels above the level
+ * of the found node when not NULL */
+static FlatSkiplistNode *flat_skiplist_get_previous_ex(FlatSkiplist *sl,
+        void *data, int *level_index, FlatSkiplistNode **update)
 {
     int i;
     int cmp;
@@ -223,11 +229,18 @@ static FlatSkiplistNode *flat_skiplist_get_previous(FlatSkiplist *sl, void *data
 
             previous = previous->links[i];
         }
+
+        if (update != NULL) {
+            update[i] = previous;
+        }
     }
 
     return NULL;
 }
 
+#define flat_skiplist_get_previous(sl, data, level_index) \
+    flat_skiplist_get_previous_ex(sl, data, level_index, NULL)
+
 static FlatSkiplistNode *flat_skiplist_get_first_larger_or_equal(
         FlatSkiplist *sl, void *data)
 {
@@ -299,11 +312,17 @@ int flat_skiplist_delete(FlatSkiplist *sl, void *data)
     FlatSkiplistNode *previous;
     FlatSkiplistNode *deleted;
 
-    previous = flat_skiplist_get_previous(sl, data, &level_index);
+    previous = flat_skiplist_get_previous_ex(sl, data,
+            &level_index, sl->tmp_previous);
     if (previous == NULL) {
         return ENOENT;
     }
 
+    //the levels above the deleted node
+    for (i=level_index+1; i<=sl->top_level_index; i++) {
+        FLAT_SKIPLIST_WIDTHS(sl->tmp_previous[i])[i]--;
+    }
+
     deleted = previous->links[level_index];
     for (i=level_index; i>=0; i--) {
         while (previous->links[i] != sl->tail && previous->links[i] != deleted) {
@@ -311,10 +330,13 @@ int flat_skiplist_delete(FlatSkiplist *sl, void *data)
         }
 
         assert(previous->links[i] == deleted);
+        FLAT_SKIPLIST_WIDTHS(previous)[i] +=
+            FLAT_SKIPLIST_WIDTHS(deleted)[i] - 1;
         previous->links[i] = previous->links[i]->links[i];
     }
 
     deleted->links[0]->prev = previous;
+    sl->element_count--;
 
     if (sl->free_func != NULL) {
         sl->free_func(deleted->data);
@@ -398,3 +420,85 @@ int flat_skiplist_find_range(FlatSkiplist *sl, void *start_data, void *end_data,
     iterator->top = flat_skiplist_get_first_larger(sl, end_data);
     return iterator->current != iterator->top ? 0 : ENOENT;
 }
+
+/* the count of the data which greater than (or equal to) the data,
+ * they are before the data in the links */
+static int flat_skiplist_count_greater(FlatSkiplist *sl,
+        void *data, const bool or_equal)
+{
+    int i;
+    int cmp;
+    int count;
+    FlatSkiplistNode *previous;
+
+    count = 0;
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        while (previous->links[i] != sl->tail) {
+            cmp = sl->compare_func(data, previous->links[i]->data);
+            if (cmp > 0 || (cmp == 0 && !or_equal)) {
+                break;
+            }
+
+            count += FLAT_SKIPLIST_WIDTHS(previous)[i];
+            previous = previous->links[i];
+        }
+    }
+
+    return count;
+}
+
+int flat_skiplist_rank(FlatSkiplist *sl, void *data, int *rank)
+{
+    int ge_count;
+
+    ge_count = flat_skiplist_count_greater(sl, data, true);
+    if (ge_count == flat_skiplist_count_greater(sl, data, false)) {
+        *rank = -1;
+        return ENOENT;
+    }
+
+    //the iteration is in the reverse order of the links
+    *rank = sl->element_count - ge_count;
+    return 0;
+}
+
+void *flat_skiplist_nth(FlatSkiplist *sl, const int index)
+{
+    int i;
+    int position;
+    int target;
+    FlatSkiplistNode *previous;
+
+    if (index < 0 || index >= sl->element_count) {
+        return NULL;
+    }
+
+    target = sl->element_count - index;
+    position = 0;
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        while (position + FLAT_SKIPLIST_WIDTHS(previous)[i] <= target) {
+            position += FLAT_SKIPLIST_WIDTHS(previous)[i];
+            previous = previous->links[i];
+        }
+        if (position == target) {
+            return previous->data;
+        }
+    }
+
+    return NULL;
+}
+
+int flat_skiplist_count_range(FlatSkiplist *sl, void *start_data,
+        void *end_data, int *count)
+{
+    if (sl->compare_func(start_data, end_data) > 0) {
+        *count = 0;
+        return EINVAL;
+    }
+
+    *count = flat_skiplist_count_greater(sl, start_data, true) -
+        flat_skiplist_count_greater(sl, end_data, false);
+    return 0;
+}
@@ -26,10 +26,13 @@
 #include "skiplist_common.h"
 #include "fast_mblock.h"
 
+/* the links are followed by the span widths: the width of the level i
+ * is the level 0 distance to links[i] */
 typedef struct flat_skiplist_node
 {
     void *data;
     struct flat_skiplist_node *prev;   //for stable sort
+    int level_index;
     struct flat_skiplist_node *links[0];
 } FlatSkiplistNode;
 
@@ -37,6 +40,8 @@ typedef struct flat_skiplist
 {
     int level_count;
     int top_level_index;
+    int element_count;
+    uint64_t rand_state;  //for the level of the new node
     skiplist_compare_func compare_func;
     skiplist_free_func free_func;
     struct fast_mblock_man *mblocks;  //node allocators
@@ -54,6 +59,11 @@ typedef struct flat_skiplist_iterator {
 extern "C" {
 #endif
 
+#define FLAT_SKIPLIST_WIDTHS(node) \
+    ((int *)((node)->links + (node)->level_index + 1))
+
+#define flat_skiplist_count(sl) (sl)->element_count
+
 #define flat_skiplist_init(sl, level_count, compare_func, free_func) \
     flat_skiplist_init_ex(sl, level_count, compare_func, free_func,  \
     SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE)
@@ -73,6 +83,28 @@ int flat_skiplist_find_range(FlatSkiplist *sl, void *start_data, void *end_data,
         FlatSkiplistIterator *iterator);
 void *flat_skiplist_find_ge(FlatSkiplist *sl, void *data);
 
+/**
+ * get the rank of the data in O(log n) by the span widths
+ * parameters:
+ *         sl: the skiplist
+ *         data: the data to find
+ *         rank: return the index (base 0) of the first equal data
+ *               in the iteration order
+ * return 0 for success, ENOENT for not exist
+*/
+int flat_skiplist_rank(FlatSkiplist *sl, void *data, int *rank);
+
+/* return the data of the index (base 0) in the iteration order in
+ * O(log n), NULL for out of range */
+void *flat_skiplist_nth(FlatSkiplist *sl, const int index);
+
+/**
+ * count the data in [start_data, end_data] in O(log n)
+ * return 0 for success, EINVAL for invalid range
+*/
+int flat_skiplist_count_range(FlatSkiplist *sl, void *start_data,
+        void *end_data, int *count);
+
 static inline void flat_skiplist_iterator(FlatSkiplist *sl, FlatSkiplistIterator *iterator)
 {
     iterator->top = sl->top;
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include "pthread_func.h"
 #include "fc_memory.h"
+#include "fc_crc32.h"
 #include "hash.h"
 
 static unsigned int prime_array[] = {
@@ -79,6 +80,12 @@ static int _hash_alloc_buckets(HashArray *pHash, const unsigned int old_capacity
 	return 0;
 }
 
+#define HASH_OVER_LOAD_FACTOR(pHash) ((double)pHash->item_count / \
+		(double)*pHash->capacity >= pHash->load_factor)
+
+static int _hash_align_capacity(HashArray *pHash);
+static void _hash_rehash_check_done(HashArray *pHash);
+
 unsigned int *fc_hash_get_prime_capacity(const int capacity)
 {
 	unsigned int *pprime;
@@ -145,8 +152,8 @@ int fc_hash_set_locks(HashArray *pHash, const int lock_count)
 		return EINVAL;
 	}
 
-    //do NOT support rehash
-	if (pHash->load_factor >= 0.10)
+    //do NOT support stop-the-world rehash
+	if (pHash->load_factor >= 0.10 && pHash->rehash_step <= 0)
 	{
 		return EINVAL;
 	}
@@ -165,35 +172,83 @@ int fc_hash_set_locks(HashArray *pHash, const int lock_count)
 		init_pthread_lock(lock);
 	}
 
+	if (pHash->rehash_step > 0)
+	{
+		return _hash_align_capacity(pHash);
+	}
 	return 0;
 }
 
-void fc_hash_destroy(HashArray *pHash)
+int fc_hash_set_incremental_rehash(HashArray *pHash, const int rehash_step)
+{
+	if (rehash_step <= 0 || pHash->epoch != NULL)
+	{
+		return EINVAL;
+	}
+
+	pHash->rehash_step = rehash_step;
+	if (pHash->lock_count > 0)
+	{
+		return _hash_align_capacity(pHash);
+	}
+	return 0;
+}
+
+static void _hash_free_buckets(HashArray *pHash, HashData **buckets,
+		const unsigned int capacity)
 {
 	HashData **ppBucket;
 	HashData **bucket_end;
 	HashData *pNode;
 	HashData *pDelete;
 
-	if (pHash == NULL || pHash->buckets == NULL)
-	{
-		return;
-	}
-
-	bucket_end = pHash->buckets + (*pHash->capacity);
-	for (ppBucket=pHash->buckets; ppBucket<bucket_end; ppBucket++)
+	bucket_end = buckets + capacity;
+	for (ppBucket=buckets; ppBucket<bucket_end; ppBucket++)
 	{
 		pNode = *ppBucket;
 		while (pNode != NULL)
 		{
 			pDelete = pNode;
 			pNode = pNode->next;
-			free(pDelete);
+			fc_hash_free_node_memory(pHash, pDelete);
 		}
 	}
 
-	free(pHash->buckets);
+	free(buckets);
+}
+
+void fc_hash_destroy(HashArray *pHash)
+{
+	if (pHash == NULL || pHash->buckets == NULL)
+	{
+		return;
+	}
+
+	_hash_free_buckets(pHash, pHash->buckets, *pHash->capacity);
 	pHash->buckets = NULL;
+	if (pHash->old_buckets != NULL)
+	{
+		_hash_free_buckets(pHash, pHash->old_buckets,
+				pHash->old_capacity);
+		pHash->old_buckets = NULL;
+	}
+	if (pHash->rehash_cursors != NULL)
+	{
+		free(pHash->rehash_cursors);
+		pHash->rehash_cursors = NULL;
+	}
+	if (pHash->epoch != NULL)
+	{
+		fc_epoch_destroy(pHash->epoch);
+		free(pHash->epoch);
+		pHash->epoch = NULL;
+	}
+	if (pHash->allocator != NULL)
+	{
+		fast_allocator_destroy(pHash->allocator);
+		free(pHash->allocator);
+		pHash->allocator = NULL;
+	}
 	if (pHash->is_malloc_capacity)
 	{
 		free(pHash->capacity);
@@ -205,25 +260,104 @@ void fc_hash_destroy(HashArray *pHash)
 	pHash->bytes_used = 0;
 }
 
+/* publish the node with release store for the lock-free readers */
 #define ADD_TO_BUCKET(pHash, ppBucket, hash_data) \
 	hash_data->next = *ppBucket; \
-	*ppBucket = hash_data; \
+	__atomic_store_n(ppBucket, hash_data, __ATOMIC_RELEASE); \
 	pHash->item_count++;
 
 
 #define DELETE_FROM_BUCKET(pHash, ppBucket, previous, hash_data) \
 	if (previous == NULL) \
 	{ \
-		*ppBucket = hash_data->next; \
+		__atomic_store_n(ppBucket, hash_data->next, __ATOMIC_RELEASE); \
 	} \
 	else \
 	{ \
-		previous->next = hash_data->next; \
+		__atomic_store_n(&previous->next, hash_data->next, \
+				__ATOMIC_RELEASE); \
 	} \
 	pHash->item_count--; \
-	pHash->bytes_used -= CALC_NODE_MALLOC_BYTES(hash_data->key_len, \
-				hash_data->malloc_value_size); \
-	free(hash_data);
+	pHash->bytes_used -= HASH_NODE_BYTES(pHash, hash_data); \
+	_hash_free_node(pHash, hash_data);
+
+static inline void _hash_free_node(HashArray *pHash, HashData *hash_data)
+{
+	if (pHash->epoch == NULL)
+	{
+		fc_hash_free_node_memory(pHash, hash_data);
+	}
+	else
+	{
+		//the lock-free readers maybe access the node, leak when fail
+		fc_epoch_retire(pHash->epoch, hash_data);
+	}
+}
+
+static void _hash_free_retired(void *ptr, void *arg)
+{
+	fc_hash_free_node_memory((HashArray *)arg, (HashData *)ptr);
+}
+
+int fc_hash_set_slab_allocator(HashArray *pHash)
+{
+	int result;
+
+	if (pHash->allocator != NULL)
+	{
+		return EEXIST;
+	}
+	if (pHash->item_count > 0)
+	{
+		return EBUSY;
+	}
+
+	pHash->allocator = (struct fast_allocator_context *)fc_malloc(
+			sizeof(struct fast_allocator_context));
+	if (pHash->allocator == NULL)
+	{
+		return ENOMEM;
+	}
+
+	//the nodes maybe freed by the other thread (bucket lock or epoch)
+	if ((result=fast_allocator_init(pHash->allocator, "hash-node",
+					0, 0.0, -1, true)) != 0)
+	{
+		free(pHash->allocator);
+		pHash->allocator = NULL;
+	}
+	return result;
+}
+
+int fc_hash_set_lockfree_read(HashArray *pHash, const int max_threads)
+{
+	int result;
+
+	if (pHash->epoch != NULL)
+	{
+		return EEXIST;
+	}
+
+	//the bucket array can NOT be replaced under the lock-free readers
+	if (pHash->load_factor >= 0.10 || pHash->rehash_step > 0)
+	{
+		return EINVAL;
+	}
+
+	pHash->epoch = (FCEpochContext *)fc_malloc(sizeof(FCEpochContext));
+	if (pHash->epoch == NULL)
+	{
+		return ENOMEM;
+	}
+
+	if ((result=fc_epoch_init(pHash->epoch, max_threads,
+					_hash_free_retired, pHash)) != 0)
+	{
+		free(pHash->epoch);
+		pHash->epoch = NULL;
+	}
+	return result;
+}
 
 #define HASH_LOCK(pHash, index) \
 	if (pHash->lock_count > 0) \
@@ -235,8 +369,20 @@ void fc_hash_destroy(HashArray *pHash)
 	if (pHash->lock_count > 0) \
 	{ \
 		pthread_mutex_unlock(pHash->locks + (index) % pHash->lock_count); \
+		if (pHash->old_buckets != NULL && pHash->rehash_stripes_done == \
+				(int)pHash->lock_count) \
+		{ \
+			_hash_rehash_check_done(pHash); \
+		} \
 	}
 
+/* the lock index of incremental rehash is the hash code because the capacity
+ * is aligned to the lock count: hash_code % capacity % lock_count is equal to
+ * hash_code % lock_count for both old and new bucket arrays */
+#define HASH_LOCK_INDEX(pHash, hash_code) \
+	(pHash->rehash_step > 0 ? (hash_code) : \
+	 (hash_code) % (*pHash->capacity))
+
 
 int fc_hash_stat(HashArray *pHash, HashStat *pStat, \
 		int *stat_by_lens, const int stat_size)
@@ -249,6 +395,11 @@ int fc_hash_stat(HashArray *pHash, HashStat *pStat, \
 	int count;
 	int i;
 
+	if (pHash->old_buckets != NULL)
+	{
+		fc_hash_rehash_finish(pHash);
+	}
+
 	memset(stat_by_lens, 0, sizeof(int) * stat_size);
 	pStat->bucket_max_length = 0;
 	pStat->bucket_used = 0;
@@ -337,6 +488,12 @@ static int _rehash1(HashArray *pHash, const int old_capacity, \
 	HashData *pNext;
 	int result;
 
+	//the nodes are relinked and the old bucket array is freed at once
+	if (pHash->epoch != NULL)
+	{
+		return EOPNOTSUPP;
+	}
+
 	old_buckets = pHash->buckets;
 	pHash->capacity = new_capacity;
 	if ((result=_hash_alloc_buckets(pHash, old_capacity)) != 0)
@@ -407,6 +564,288 @@ static int _rehash(HashArray *pHash)
 	return result;
 }
 
+static void _hash_lock_all(HashArray *pHash)
+{
+	unsigned int i;
+	for (i=0; i<pHash->lock_count; i++)
+	{
+		pthread_mutex_lock(pHash->locks + i);
+	}
+}
+
+static void _hash_unlock_all(HashArray *pHash)
+{
+	unsigned int i;
+	for (i=0; i<pHash->lock_count; i++)
+	{
+		pthread_mutex_unlock(pHash->locks + i);
+	}
+}
+
+static inline void _hash_migrate_bucket(HashArray *pHash,
+		HashData **ppOldBucket)
+{
+	HashData **ppBucket;
+	HashData *hash_data;
+	HashData *pNext;
+
+	hash_data = *ppOldBucket;
+	*ppOldBucket = NULL;
+	while (hash_data != NULL)
+	{
+		pNext = hash_data->next;
+		ppBucket = pHash->buckets + (HASH_CODE(pHash, hash_data) %
+				(*pHash->capacity));
+		hash_data->next = *ppBucket;
+		*ppBucket = hash_data;
+		hash_data = pNext;
+	}
+}
+
+static void _hash_rehash_free_old(HashArray *pHash)
+{
+	free(pHash->old_buckets);
+	pHash->old_buckets = NULL;
+	pHash->bytes_used -= sizeof(HashData *) * pHash->old_capacity;
+	pHash->old_capacity = 0;
+
+	free(pHash->rehash_cursors);
+	pHash->rehash_cursors = NULL;
+}
+
+static void _hash_migrate_all(HashArray *pHash)
+{
+	HashData **ppBucket;
+	HashData **bucket_end;
+
+	bucket_end = pHash->old_buckets + pHash->old_capacity;
+	for (ppBucket=pHash->old_buckets; ppBucket<bucket_end; ppBucket++)
+	{
+		if (*ppBucket != NULL)
+		{
+			_hash_migrate_bucket(pHash, ppBucket);
+		}
+	}
+	_hash_rehash_free_old(pHash);
+}
+
+/* migrate the bucket of the key and rehash_step buckets of the lock stripe,
+ * the caller MUST hold the lock of the hash code */
+static void _hash_rehash_step(HashArray *pHash, const unsigned int hash_code)
+{
+	unsigned int stripe_count;
+	unsigned int *cursor;
+	HashData **ppOldBucket;
+	int i;
+
+	ppOldBucket = pHash->old_buckets + hash_code % pHash->old_capacity;
+	if (*ppOldBucket != NULL)
+	{
+		_hash_migrate_bucket(pHash, ppOldBucket);
+	}
+
+	stripe_count = pHash->lock_count > 0 ? pHash->lock_count : 1;
+	cursor = pHash->rehash_cursors + hash_code % stripe_count;
+	if (*cursor >= pHash->old_capacity)
+	{
+		return;
+	}
+
+	for (i=0; i<pHash->rehash_step && *cursor<pHash->old_capacity; i++)
+	{
+		ppOldBucket = pHash->old_buckets + *cursor;
+		if (*ppOldBucket != NULL)
+		{
+			_hash_migrate_bucket(pHash, ppOldBucket);
+		}
+		*cursor += stripe_count;
+	}
+
+	if (*cursor >= pHash->old_capacity)
+	{
+		if (__sync_add_and_fetch(&pHash->rehash_stripes_done, 1) ==
+				(int)stripe_count && pHash->lock_count == 0)
+		{
+			_hash_rehash_free_old(pHash);
+		}
+	}
+}
+
+static inline HashData **_hash_locate_bucket(HashArray *pHash,
+		const unsigned int hash_code)
+{
+	if (pHash->old_buckets != NULL)
+	{
+		_hash_rehash_step(pHash, hash_code);
+	}
+	return pHash->buckets + (hash_code % (*pHash->capacity));
+}
+
+static void _hash_rehash_check_done(HashArray *pHash)
+{
+	_hash_lock_all(pHash);
+	if (pHash->old_buckets != NULL && pHash->rehash_stripes_done ==
+			(int)pHash->lock_count)
+	{
+		_hash_rehash_free_old(pHash);
+	}
+	_hash_unlock_all(pHash);
+}
+
+static unsigned int *_hash_calc_aligned_capacity(HashArray *pHash,
+		unsigned int *pprime, bool *is_malloc)
+{
+	unsigned int *new_capacity;
+	int64_t aligned;
+
+	*is_malloc = false;
+	if (pHash->lock_count <= 1 || *pprime % pHash->lock_count == 0)
+	{
+		return pprime;
+	}
+
+	aligned = ((int64_t)*pprime + pHash->lock_count - 1) /
+		pHash->lock_count * pHash->lock_count;
+	if (aligned > INT32_MAX)
+	{
+		return NULL;
+	}
+
+	new_capacity = (unsigned int *)fc_malloc(sizeof(unsigned int));
+	if (new_capacity == NULL)
+	{
+		return NULL;
+	}
+	*new_capacity = aligned;
+	*is_malloc = true;
+	return new_capacity;
+}
+
+/* start the incremental rehash, the caller MUST hold all the locks */
+static int _hash_rehash_start(HashArray *pHash)
+{
+	unsigned int *pprime;
+	unsigned int *new_capacity;
+	unsigned int *old_capacity;
+	unsigned int stripe_count;
+	unsigned int i;
+	bool old_is_malloc;
+	bool is_malloc;
+	int result;
+
+	if (pHash->old_buckets != NULL)
+	{
+		_hash_migrate_all(pHash);
+	}
+
+	if ((pprime=fc_hash_get_prime_capacity(*pHash->capacity)) == NULL)
+	{
+		return ENOSPC;
+	}
+	if ((new_capacity=_hash_calc_aligned_capacity(pHash,
+					pprime, &is_malloc)) == NULL)
+	{
+		return ENOMEM;
+	}
+
+	stripe_count = pHash->lock_count > 0 ? pHash->lock_count : 1;
+	pHash->rehash_cursors = (unsigned int *)fc_malloc(
+			sizeof(unsigned int) * stripe_count);
+	if (pHash->rehash_cursors == NULL)
+	{
+		if (is_malloc)
+		{
+			free(new_capacity);
+		}
+		return ENOMEM;
+	}
+
+	old_capacity = pHash->capacity;
+	old_is_malloc = pHash->is_malloc_capacity;
+	pHash->old_buckets = pHash->buckets;
+	pHash->old_capacity = *old_capacity;
+	pHash->capacity = new_capacity;
+	if ((result=_hash_alloc_buckets(pHash, 0)) != 0)
+	{
+		pHash->buckets = pHash->old_buckets;
+		pHash->capacity = old_capacity;
+		pHash->old_buckets = NULL;
+		pHash->old_capacity = 0;
+		free(pHash->rehash_cursors);
+		pHash->rehash_cursors = NULL;
+		if (is_malloc)
+		{
+			free(new_capacity);
+		}
+		return result;
+	}
+
+	if (old_is_malloc)
+	{
+		free(old_capacity);
+	}
+	pHash->is_malloc_capacity = is_malloc;
+
+	pHash->rehash_stripes_done = 0;
+	for (i=0; i<stripe_count; i++)
+	{
+		pHash->rehash_cursors[i] = i;
+		if (i >= pHash->old_capacity)
+		{
+			pHash->rehash_stripes_done++;
+		}
+	}
+	return 0;
+}
+
+static int _hash_align_capacity(HashArray *pHash)
+{
+	unsigned int *new_capacity;
+	unsigned int *old_capacity;
+	bool is_malloc;
+	int result;
+
+	if (pHash->old_buckets != NULL)
+	{
+		_hash_migrate_all(pHash);
+	}
+
+	if ((new_capacity=_hash_calc_aligned_capacity(pHash,
+					pHash->capacity, &is_malloc)) == NULL)
+	{
+		return ENOMEM;
+	}
+	if (!is_malloc)
+	{
+		return 0;
+	}
+
+	old_capacity = pHash->capacity;
+	if ((result=_rehash1(pHash, *old_capacity, new_capacity)) != 0)
+	{
+		pHash->capacity = old_capacity;
+		free(new_capacity);
+		return result;
+	}
+
+	if (pHash->is_malloc_capacity)
+	{
+		free(old_capacity);
+	}
+	pHash->is_malloc_capacity = true;
+	return 0;
+}
+
+void fc_hash_rehash_finish(HashArray *pHash)
+{
+	_hash_lock_all(pHash);
+	if (pHash->old_buckets != NULL)
+	{
+		_hash_migrate_all(pHash);
+	}
+	_hash_unlock_all(pHash);
+}
+
 static int _hash_conflict_count(HashArray *pHash)
 {
 	HashData **ppBucket;
@@ -460,9 +899,21 @@ int fc_hash_best_op(HashArray *pHash, const int suggest_capacity)
 {
 	int old_capacity;
 	int conflict_count;
+	unsigned int candidate;
 	unsigned int *new_capacity;
 	int result;
 
+	//the lock-free readers maybe walk the bucket array and the chains
+	if (pHash->epoch != NULL)
+	{
+		return -EOPNOTSUPP;
+	}
+
+	if (pHash->old_buckets != NULL)
+	{
+		fc_hash_rehash_finish(pHash);
+	}
+
 	if ((conflict_count=_hash_conflict_count(pHash)) == 0)
 	{
 		return 0;
@@ -477,24 +928,39 @@ int fc_hash_best_op(HashArray *pHash, const int suggest_capacity)
 
 	if ((suggest_capacity > 2) && (suggest_capacity >= pHash->item_count))
 	{
-		*new_capacity = suggest_capacity - 2;
-		if (*new_capacity % 2 == 0)
+		candidate = suggest_capacity - 2;
+		if (candidate % 2 == 0)
 		{
-			++(*new_capacity);
+			++candidate;
 		}
 	}
 	else
 	{
-		*new_capacity = 2 * (pHash->item_count - 1) + 1;
+		candidate = 2 * (pHash->item_count - 1) + 1;
 	}
 
 	do
 	{
 		do
 		{
-			*new_capacity += 2;
-		} while ((*new_capacity % 3 == 0) || (*new_capacity % 5 == 0) \
-			 || (*new_capacity % 7 == 0));
+			candidate += 2;
+		} while ((candidate % 3 == 0) || (candidate % 5 == 0) \
+			 || (candidate % 7 == 0));
+
+		//keep the lock of the key unchanged for incremental rehash
+		if (pHash->rehash_step > 0 && pHash->lock_count > 1)
+		{
+			*new_capacity = (candidate + pHash->lock_count - 1) /
+				pHash->lock_count * pHash->lock_count;
+			if (*new_capacity == old_capacity)
+			{
+				continue;
+			}
+		}
+		else
+		{
+			*new_capacity = candidate;
+		}
 
 		if ((result=_rehash1(pHash, old_capacity, new_capacity)) != 0)
 		{
@@ -522,7 +988,8 @@ static HashData *_chain_find_entry(HashData **ppBucket, const void *key, \
 {
 	HashData *hash_data;
 
-	hash_data = *ppBucket;
+	//acquire loads pair with the release stores of the writers
+	hash_data = __atomic_load_n(ppBucket, __ATOMIC_ACQUIRE);
 	while (hash_data != NULL)
 	{
 		if (key_len == hash_data->key_len && \
@@ -531,24 +998,45 @@ static HashData *_chain_find_entry(HashData **ppBucket, const void *key, \
 			return hash_data;
 		}
 
-		hash_data = hash_data->next;
+		hash_data = __atomic_load_n(&hash_data->next, __ATOMIC_ACQUIRE);
 	}
 
 	return NULL;
 }
 
+#define HASH_LOCKFREE_READ_ENTER(pHash) \
+	(pHash->epoch != NULL && fc_epoch_enter(pHash->epoch) == 0)
+
+/* the caller MUST be in the epoch read side critical section */
+static inline HashData *_hash_lockfree_find(HashArray *pHash,
+		const void *key, const int key_len, const unsigned int hash_code)
+{
+	return _chain_find_entry(pHash->buckets + (hash_code %
+				(*pHash->capacity)), key, key_len, hash_code);
+}
+
 HashData *fc_hash_find_ex(HashArray *pHash, const void *key, const int key_len)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	HashData **ppBucket;
 	HashData *hash_data;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	if (HASH_LOCKFREE_READ_ENTER(pHash))
+	{
+		/* the node keeps valid while the caller holds fc_hash_read_lock */
+		hash_data = _hash_lockfree_find(pHash, key, key_len, hash_code);
+		fc_epoch_exit(pHash->epoch);
+		return hash_data;
+	}
 
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
+
+	HASH_LOCK(pHash, lock_index)
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = _chain_find_entry(ppBucket, key, key_len, hash_code);
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+	HASH_UNLOCK(pHash, lock_index)
 
 	return hash_data;
 }
@@ -556,15 +1044,26 @@ HashData *fc_hash_find_ex(HashArray *pHash, const void *key, const int key_len)
 void *fc_hash_find(HashArray *pHash, const void *key, const int key_len)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	HashData **ppBucket;
 	HashData *hash_data;
+	void *value;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	if (HASH_LOCKFREE_READ_ENTER(pHash))
+	{
+		hash_data = _hash_lockfree_find(pHash, key, key_len, hash_code);
+		value = (hash_data != NULL ? hash_data->value : NULL);
+		fc_epoch_exit(pHash->epoch);
+		return value;
+	}
+
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
 
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
+	HASH_LOCK(pHash, lock_index)
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = _chain_find_entry(ppBucket, key, key_len, hash_code);
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+	HASH_UNLOCK(pHash, lock_index)
 
 	if (hash_data != NULL)
 	{
@@ -579,14 +1078,25 @@ void *fc_hash_find(HashArray *pHash, const void *key, const int key_len)
 int fc_hash_find2(HashArray *pHash, const string_t *key, string_t *value)
 {
     HashData *hdata;
+    bool locked;
+    int result;
+
+    locked = (fc_hash_read_lock(pHash) == 0);
     if ((hdata=fc_hash_find1_ex(pHash, key)) == NULL)
     {
-        return ENOENT;
+        result = ENOENT;
     }
-
-    value->str = hdata->value;
-    value->len = hdata->value_len;
-    return 0;
+    else
+    {
+        value->str = hdata->value;
+        value->len = hdata->value_len;
+        result = 0;
+    }
+    if (locked)
+    {
+        fc_hash_read_unlock(pHash);
+    }
+    return result;
 }
 
 HashData *fc_hash_find1_ex(HashArray *pHash, const string_t *key)
@@ -598,14 +1108,25 @@ int fc_hash_get(HashArray *pHash, const void *key, const int key_len,
 	void *value, int *value_len)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	int result;
+	bool lockfree;
 	HashData **ppBucket;
 	HashData *hash_data;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
+
+	if ((lockfree=HASH_LOCKFREE_READ_ENTER(pHash)))
+	{
+		ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	}
+	else
+	{
+		HASH_LOCK(pHash, lock_index)
+		ppBucket = _hash_locate_bucket(pHash, hash_code);
+	}
 
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
 	hash_data = _chain_find_entry(ppBucket, key, key_len, hash_code);
 	if (hash_data != NULL)
 	{
@@ -624,7 +1145,156 @@ int fc_hash_get(HashArray *pHash, const void *key, const int key_len,
 	{
 		result = ENOENT;
 	}
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+
+	if (lockfree)
+	{
+		fc_epoch_exit(pHash->epoch);
+	}
+	else
+	{
+		HASH_UNLOCK(pHash, lock_index)
+	}
+	return result;
+}
+
+static int _hash_alloc_node(HashArray *pHash, const void *key,
+		const int key_len, void *value, const int value_len,
+		const unsigned int hash_code, HashData **node)
+{
+	HashData *hash_data;
+	int bytes;
+	int malloc_value_size;
+
+	if (!pHash->is_malloc_value)
+	{
+		malloc_value_size = 0;
+	}
+	else
+	{
+		malloc_value_size = MEM_ALIGN(value_len);
+	}
+
+	bytes = CALC_NODE_MALLOC_BYTES(key_len, malloc_value_size);
+	if (pHash->allocator != NULL)
+	{
+		hash_data = (HashData *)fast_allocator_alloc(pHash->allocator, bytes);
+		if (hash_data == NULL)
+		{
+			return -ENOMEM;
+		}
+
+		bytes = fast_allocator_alloc_size(hash_data);
+		if (pHash->max_bytes > 0 && pHash->bytes_used+bytes > pHash->max_bytes)
+		{
+			fast_allocator_free(pHash->allocator, hash_data);
+			return -ENOSPC;
+		}
+	}
+	else
+	{
+		if (pHash->max_bytes > 0 && pHash->bytes_used+bytes > pHash->max_bytes)
+		{
+			return -ENOSPC;
+		}
+
+		hash_data = (HashData *)fc_malloc(bytes);
+		if (hash_data == NULL)
+		{
+			return -ENOMEM;
+		}
+	}
+
+	pHash->bytes_used += bytes;
+	hash_data->malloc_value_size = malloc_value_size;
+
+	hash_data->key_len = key_len;
+	memcpy(hash_data->key, key, key_len);
+#ifdef HASH_STORE_HASH_CODE
+	hash_data->hash_code = hash_code;
+#endif
+	hash_data->value_len = value_len;
+
+	if (!pHash->is_malloc_value)
+	{
+		hash_data->value = (char *)value;
+	}
+	else
+	{
+		hash_data->value = hash_data->key + hash_data->key_len;
+		memcpy(hash_data->value, value, value_len);
+	}
+
+	*node = hash_data;
+	return 0;
+}
+
+/* the nodes are immutable for the lock-free readers, so the existing node
+ * is replaced by a new one instead of modifying in place */
+static int _hash_lockfree_insert(HashArray *pHash, const void *key,
+		const int key_len, void *value, const int value_len,
+		const unsigned int hash_code, const bool needLock)
+{
+	unsigned int lock_index;
+	HashData **ppBucket;
+	HashData *hash_data;
+	HashData *previous;
+	HashData *new_data;
+	int result;
+
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
+	if (needLock)
+	{
+		HASH_LOCK(pHash, lock_index)
+	}
+
+	do
+	{
+		if ((result=_hash_alloc_node(pHash, key, key_len, value,
+						value_len, hash_code, &new_data)) != 0)
+		{
+			break;
+		}
+
+		ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+		previous = NULL;
+		hash_data = *ppBucket;
+		while (hash_data != NULL)
+		{
+			if (key_len == hash_data->key_len &&
+				memcmp(key, hash_data->key, key_len) == 0)
+			{
+				break;
+			}
+
+			previous = hash_data;
+			hash_data = hash_data->next;
+		}
+
+		if (hash_data == NULL)
+		{
+			ADD_TO_BUCKET(pHash, ppBucket, new_data)
+			result = 1;
+			break;
+		}
+
+		new_data->next = hash_data->next;
+		if (previous == NULL)
+		{
+			__atomic_store_n(ppBucket, new_data, __ATOMIC_RELEASE);
+		}
+		else
+		{
+			__atomic_store_n(&previous->next, new_data, __ATOMIC_RELEASE);
+		}
+		pHash->bytes_used -= HASH_NODE_BYTES(pHash, hash_data);
+		_hash_free_node(pHash, hash_data);
+		result = 0;
+	} while (0);
+
+	if (needLock)
+	{
+		HASH_UNLOCK(pHash, lock_index)
+	}
 	return result;
 }
 
@@ -632,23 +1302,28 @@ int fc_hash_insert_ex(HashArray *pHash, const void *key, const int key_len,
 		void *value, const int value_len, const bool needLock)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	HashData **ppBucket;
 	HashData *hash_data;
 	HashData *previous;
-	char *pBuff;
-	int bytes;
-	int malloc_value_size;
+	int result;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	if (pHash->epoch != NULL)
+	{
+		return _hash_lockfree_insert(pHash, key, key_len,
+				value, value_len, hash_code, needLock);
+	}
 
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
 	previous = NULL;
 
 	if (needLock)
 	{
-		HASH_LOCK(pHash, ppBucket - pHash->buckets)
+		HASH_LOCK(pHash, lock_index)
 	}
 
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = *ppBucket;
 	while (hash_data != NULL)
 	{
@@ -670,7 +1345,7 @@ int fc_hash_insert_ex(HashArray *pHash, const void *key, const int key_len,
 			hash_data->value = (char *)value;
 			if (needLock)
 			{
-				HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+				HASH_UNLOCK(pHash, lock_index)
 			}
 			return 0;
 		}
@@ -684,7 +1359,7 @@ int fc_hash_insert_ex(HashArray *pHash, const void *key, const int key_len,
 				memcpy(hash_data->value, value, value_len);
 				if (needLock)
 				{
-					HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+					HASH_UNLOCK(pHash, lock_index)
 				}
 				return 0;
 			}
@@ -694,67 +1369,47 @@ int fc_hash_insert_ex(HashArray *pHash, const void *key, const int key_len,
 	}
 	if (needLock)
 	{
-		HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+		HASH_UNLOCK(pHash, lock_index)
 	}
 
-	if (!pHash->is_malloc_value)
-	{
-		malloc_value_size = 0;
-	}
-	else
-	{
-		malloc_value_size = MEM_ALIGN(value_len);
-	}
-
-	bytes = CALC_NODE_MALLOC_BYTES(key_len, malloc_value_size);
-	if (pHash->max_bytes > 0 && pHash->bytes_used+bytes > pHash->max_bytes)
-	{
-		return -ENOSPC;
-	}
-
-	pBuff = (char *)fc_malloc(bytes);
-	if (pBuff == NULL)
-	{
-		return -ENOMEM;
-	}
-
-	pHash->bytes_used += bytes;
-
-	hash_data = (HashData *)pBuff;
-	hash_data->malloc_value_size = malloc_value_size;
-
-	hash_data->key_len = key_len;
-	memcpy(hash_data->key, key, key_len);
-#ifdef HASH_STORE_HASH_CODE
-	hash_data->hash_code = hash_code;
-#endif
-	hash_data->value_len = value_len;
-
-	if (!pHash->is_malloc_value)
+	if ((result=_hash_alloc_node(pHash, key, key_len, value,
+					value_len, hash_code, &hash_data)) != 0)
 	{
-		hash_data->value = (char *)value;
-	}
-	else
-	{
-		hash_data->value = hash_data->key + hash_data->key_len;
-		memcpy(hash_data->value, value, value_len);
+		return result;
 	}
 
 	if (needLock)
 	{
-		HASH_LOCK(pHash, ppBucket - pHash->buckets)
+		HASH_LOCK(pHash, lock_index)
+		ppBucket = _hash_locate_bucket(pHash, hash_code);
 		ADD_TO_BUCKET(pHash, ppBucket, hash_data)
-		HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+		HASH_UNLOCK(pHash, lock_index)
 	}
 	else
 	{
+		ppBucket = _hash_locate_bucket(pHash, hash_code);
 		ADD_TO_BUCKET(pHash, ppBucket, hash_data)
 	}
 
-	if (pHash->load_factor >= 0.10 && (double)pHash->item_count /
-		(double)*pHash->capacity >= pHash->load_factor)
+	if (pHash->load_factor >= 0.10 && HASH_OVER_LOAD_FACTOR(pHash))
 	{
-		_rehash(pHash);
+		if (pHash->rehash_step <= 0)
+		{
+			_rehash(pHash);
+		}
+		else if (pHash->lock_count == 0)
+		{
+			_hash_rehash_start(pHash);
+		}
+		else if (needLock)  //the caller holds one lock when needLock is false
+		{
+			_hash_lock_all(pHash);
+			if (HASH_OVER_LOAD_FACTOR(pHash))
+			{
+				_hash_rehash_start(pHash);
+			}
+			_hash_unlock_all(pHash);
+		}
 	}
 
 	return 1;
@@ -793,23 +1448,25 @@ int fc_hash_inc_ex(HashArray *pHash, const void *key, const int key_len,
 		ConvertValueFunc convert_func, void *arg)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	int result;
 	HashData **ppBucket;
 	HashData *hash_data;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
 
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
+	HASH_LOCK(pHash, lock_index)
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = _chain_find_entry(ppBucket, key, key_len, hash_code);
 	convert_func(hash_data, inc, value, value_len, arg);
-	if (hash_data != NULL)
+	if (hash_data != NULL && pHash->epoch == NULL)
 	{
 		if (!pHash->is_malloc_value)
 		{
 			hash_data->value_len = *value_len;
 			hash_data->value = (char *)value;
-			HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+			HASH_UNLOCK(pHash, lock_index)
 			return 0;
 		}
 		else
@@ -818,7 +1475,7 @@ int fc_hash_inc_ex(HashArray *pHash, const void *key, const int key_len,
 			{
 				hash_data->value_len = *value_len;
 				memcpy(hash_data->value, value, *value_len);
-				HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+				HASH_UNLOCK(pHash, lock_index)
 				return 0;
 			}
 		}
@@ -834,7 +1491,7 @@ int fc_hash_inc_ex(HashArray *pHash, const void *key, const int key_len,
 	{
 		result = 0;
 	}
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+	HASH_UNLOCK(pHash, lock_index)
 
 	return result;
 }
@@ -843,15 +1500,18 @@ int fc_hash_partial_set(HashArray *pHash, const void *key, const int key_len,
 		const char *value, const int offset, const int value_len)
 {
 	unsigned int hash_code;
+	unsigned int lock_index;
 	int result;
 	HashData **ppBucket;
 	HashData *hash_data;
 	char *pNewBuff;
+	int new_len;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
 
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
+	HASH_LOCK(pHash, lock_index)
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = _chain_find_entry(ppBucket, key, key_len, hash_code);
 	do
 	{
@@ -862,27 +1522,27 @@ int fc_hash_partial_set(HashArray *pHash, const void *key, const int key_len,
 				result = EINVAL;
 				break;
 			}
-			if (offset + value_len <= hash_data->value_len)
+			if (offset + value_len <= hash_data->value_len &&
+				pHash->epoch == NULL)
 			{
 				memcpy(hash_data->value+offset, value, value_len);
 				result = 0;
 				break;
 			}
 
-			pNewBuff = (char *)fc_malloc(offset + value_len);
+			//copy on write for the lock-free readers
+			new_len = FC_MAX(offset + value_len, hash_data->value_len);
+			pNewBuff = (char *)fc_malloc(new_len);
 			if (pNewBuff == NULL)
 			{
 				result = errno != 0 ? errno : ENOMEM;
 				break;
 			}
 
-			if (offset > 0)
-			{
-				memcpy(pNewBuff, hash_data->value, offset);
-			}
+			memcpy(pNewBuff, hash_data->value, hash_data->value_len);
 			memcpy(pNewBuff + offset, value, value_len);
 			result = fc_hash_insert_ex(pHash, key, key_len, pNewBuff,
-				offset + value_len, false);
+				new_len, false);
 			free(pNewBuff);
 		}
 		else
@@ -906,7 +1566,7 @@ int fc_hash_partial_set(HashArray *pHash, const void *key, const int key_len,
 		}
 	} while (0);
 
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+	HASH_UNLOCK(pHash, lock_index)
 	return result;
 }
 
@@ -916,14 +1576,16 @@ int fc_hash_delete(HashArray *pHash, const void *key, const int key_len)
 	HashData *hash_data;
 	HashData *previous;
 	unsigned int hash_code;
+	unsigned int lock_index;
 	int result;
 
 	hash_code = pHash->hash_func(key, key_len);
-	ppBucket = pHash->buckets + (hash_code % (*pHash->capacity));
+	lock_index = HASH_LOCK_INDEX(pHash, hash_code);
 
 	result = ENOENT;
 	previous = NULL;
-	HASH_LOCK(pHash, ppBucket - pHash->buckets)
+	HASH_LOCK(pHash, lock_index)
+	ppBucket = _hash_locate_bucket(pHash, hash_code);
 	hash_data = *ppBucket;
 	while (hash_data != NULL)
 	{
@@ -938,33 +1600,32 @@ int fc_hash_delete(HashArray *pHash, const void *key, const int key_len)
 		previous = hash_data;
 		hash_data = hash_data->next;
 	}
-	HASH_UNLOCK(pHash, ppBucket - pHash->buckets)
+	HASH_UNLOCK(pHash, lock_index)
 
 	return result;
 }
 
-int fc_hash_walk(HashArray *pHash, HashWalkFunc walkFunc, void *args)
+static int _hash_walk_buckets(HashData **buckets, const unsigned int capacity,
+		HashWalkFunc walkFunc, void *args, int *index)
 {
 	HashData **ppBucket;
 	HashData **bucket_end;
 	HashData *hash_data;
-	int index;
 	int result;
 
-	index = 0;
-	bucket_end = pHash->buckets + (*pHash->capacity);
-	for (ppBucket=pHash->buckets; ppBucket<bucket_end; ppBucket++)
+	bucket_end = buckets + capacity;
+	for (ppBucket=buckets; ppBucket<bucket_end; ppBucket++)
 	{
 		hash_data = *ppBucket;
 		while (hash_data != NULL)
 		{
-			result = walkFunc(index, hash_data, args);
+			result = walkFunc(*index, hash_data, args);
 			if (result != 0)
 			{
 				return result;
 			}
 
-			index++;
+			(*index)++;
 			hash_data = hash_data->next;
 		}
 	}
@@ -972,6 +1633,25 @@ int fc_hash_walk(HashArray *pHash, HashWalkFunc walkFunc, void *args)
 	return 0;
 }
 
+int fc_hash_walk(HashArray *pHash, HashWalkFunc walkFunc, void *args)
+{
+	int index;
+	int result;
+
+	index = 0;
+	if (pHash->old_buckets != NULL)
+	{
+		if ((result=_hash_walk_buckets(pHash->old_buckets,
+						pHash->old_capacity, walkFunc, args, &index)) != 0)
+		{
+			return result;
+		}
+	}
+
+	return _hash_walk_buckets(pHash->buckets, *pHash->capacity,
+			walkFunc, args, &index);
+}
+
 int fc_hash_count(HashArray *pHash)
 {
 	return pHash->item_count;
@@ -1326,96 +2006,13 @@ int fc_simple_hash_ex(const void* key, const int key_len, \
 	SIMPLE_HASH_FUNC(init_value)
 }
 
-static unsigned int crc_table[256] = {
-	0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
-	0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
-	0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
-	0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
-	0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE,
-	0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
-	0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC,
-	0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
-	0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
-	0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
-	0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940,
-	0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
-	0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116,
-	0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
-	0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
-	0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
-	0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A,
-	0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
-	0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818,
-	0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
-	0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
-	0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
-	0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C,
-	0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
-	0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2,
-	0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
-	0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
-	0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
-	0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086,
-	0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
-	0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4,
-	0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
-	0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
-	0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
-	0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8,
-	0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
-	0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE,
-	0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
-	0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
-	0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
-	0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252,
-	0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
-	0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60,
-	0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
-	0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
-	0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
-	0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04,
-	0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
-	0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A,
-	0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
-	0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
-	0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
-	0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E,
-	0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
-	0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C,
-	0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
-	0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
-	0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
-	0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0,
-	0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
-	0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6,
-	0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
-	0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
-	0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
-};
-
-#define CRC32_BODY(init_value) \
-	unsigned char *pKey; \
-	unsigned char *pEnd; \
-	int64_t crc; \
- \
-	crc = init_value; \
-	pEnd = (unsigned char *)key + key_len; \
-	for (pKey = (unsigned char *)key; pKey != pEnd; pKey++) \
-	{ \
-		crc = crc_table[(crc ^ *pKey) & 0xFF] ^ (crc >> 8); \
-	} \
-
 int CRC32(const void *key, const int key_len)
 {
-	CRC32_BODY(CRC32_XINIT)
-
-	return (int)(crc ^ CRC32_XOROT);
+	return (int)fc_crc32(key, key_len);
 }
 
 int64_t CRC32_ex(const void *key, const int key_len, \
 	const int64_t init_value)
 {
-	CRC32_BODY(init_value)
-
-	return crc;
+	return fc_crc32_extend((uint32_t)init_value, key, key_len);
 }
@@ -19,6 +19,8 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include "common_define.h"
+#include "fc_epoch.h"
+#include "fast_allocator.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,11 +41,16 @@ typedef int (*HashFunc) (const void *key, const int key_len);
 #define CALC_NODE_MALLOC_BYTES(key_len, value_size) \
 		sizeof(HashData) + key_len + value_size
 
+/* the real bytes of the node */
+#define HASH_NODE_BYTES(pHash, hash_data) \
+	((pHash)->allocator != NULL ? fast_allocator_alloc_size(hash_data) : \
+	 (int)(CALC_NODE_MALLOC_BYTES((hash_data)->key_len, \
+		(hash_data)->malloc_value_size)))
+
 #define FREE_HASH_DATA(pHash, hash_data) \
 	pHash->item_count--; \
-	pHash->bytes_used -= CALC_NODE_MALLOC_BYTES(hash_data->key_len, \
-				hash_data->malloc_value_size); \
-	free(hash_data);
+	pHash->bytes_used -= HASH_NODE_BYTES(pHash, hash_data); \
+	fc_hash_free_node_memory(pHash, hash_data);
 
 
 typedef struct tagHashData
@@ -77,6 +84,19 @@ typedef struct tagHashArray
 	bool is_malloc_value;
 	unsigned int lock_count;
 	pthread_mutex_t *locks;
+
+	/* for incremental rehash */
+	int rehash_step;              //buckets to migrate per operation
+	unsigned int old_capacity;
+	HashData **old_buckets;       //the buckets being migrated
+	unsigned int *rehash_cursors; //next old bucket to migrate per lock
+	volatile int rehash_stripes_done;
+
+	/* for lock-free read, the removed nodes are freed by epoch */
+	FCEpochContext *epoch;
+
+	/* the nodes are allocated from it instead of malloc when not NULL */
+	struct fast_allocator_context *allocator;
 } HashArray;
 
 typedef struct tagHashStat
@@ -121,12 +141,105 @@ int fc_hash_init_ex(HashArray *pHash, HashFunc hash_func, \
 
 /**
  * set hash locks function
+ * NOTE: the stop-the-world rehash (load_factor >= 0.10) is NOT supported
+ *       with locks, call fc_hash_set_incremental_rehash for auto rehash
  * parameters:
  *         lock_count: the lock count
  * return 0 for success, != 0 for error
 */
 int fc_hash_set_locks(HashArray *pHash, const int lock_count);
 
+/**
+ * enable incremental rehash: when the item count exceeds the load factor,
+ * a new bucket array is allocated and the old buckets are migrated
+ * rehash_step buckets each insert, find or delete instead of once for all.
+ * during migration, an operation first migrates the old bucket of its key
+ * (plus rehash_step buckets of the rehash cursor) to the new bucket array,
+ * then looks up the key in the new bucket array only.
+ * this mode can be combined with fc_hash_set_locks, the capacity is
+ * aligned to the lock count so the lock of a key is the same for the
+ * old and new bucket arrays.
+ * parameters:
+ *         pHash: the hash table
+ *         rehash_step: the bucket count to migrate per operation
+ * return 0 for success, != 0 for error
+*/
+int fc_hash_set_incremental_rehash(HashArray *pHash, const int rehash_step);
+
+/**
+ * enable lock-free read: the find functions traverse the bucket chain
+ * without lock, the writers (insert, delete etc.) still use the locks
+ * set by fc_hash_set_locks and publish the nodes with release stores.
+ * the removed or replaced nodes are freed by epoch based reclamation.
+ * NOTE: auto rehash and fc_hash_best_op are NOT supported in this mode
+ * parameters:
+ *         pHash: the hash table
+ *         max_threads: the max reader and writer threads
+ * return 0 for success, != 0 for error
+*/
+int fc_hash_set_lockfree_read(HashArray *pHash, const int max_threads);
+
+/**
+ * allocate the nodes (including the key and the value when bMallocValue
+ * is true) from the slab allocator owned by the hash table instead of malloc,
+ * the bytes_used and max_bytes count the real bytes of the slab objects.
+ * NOTE: MUST be called before inserting any item
+ * parameters:
+ *         pHash: the hash table
+ * return 0 for success, != 0 for error
+*/
+int fc_hash_set_slab_allocator(HashArray *pHash);
+
+static inline void fc_hash_free_node_memory(HashArray *pHash,
+		HashData *hash_data)
+{
+	if (pHash->allocator != NULL)
+	{
+		fast_allocator_free(pHash->allocator, hash_data);
+	}
+	else
+	{
+		free(hash_data);
+	}
+}
+
+/**
+ * enter the read side critical section for lock-free read mode, the nodes
+ * (and the values when bMallocValue is true) returned by the find functions
+ * keep valid until fc_hash_read_unlock. in lock-free read mode the caller
+ * MUST hold this lock while accessing the node returned by fc_hash_find_ex
+ * and fc_hash_find1_ex, and the value of fc_hash_find2 (and fc_hash_find
+ * when bMallocValue is true), the lock can be nested
+ * parameters:
+ *         pHash: the hash table
+ * return 0 for success, != 0 for error
+*/
+static inline int fc_hash_read_lock(HashArray *pHash)
+{
+	return (pHash->epoch != NULL ? fc_epoch_enter(pHash->epoch) : 0);
+}
+
+static inline void fc_hash_read_unlock(HashArray *pHash)
+{
+	if (pHash->epoch != NULL)
+	{
+		fc_epoch_exit(pHash->epoch);
+	}
+}
+
+/**
+ * finish the pending incremental rehash (migrate all old buckets)
+ * parameters:
+ *         pHash: the hash table
+ * return none
+*/
+void fc_hash_rehash_finish(HashArray *pHash);
+
+static inline bool fc_hash_is_rehashing(HashArray *pHash)
+{
+	return pHash->old_buckets != NULL;
+}
+
 /**
  * convert the value
  * parameters:
@@ -196,7 +309,8 @@ int fc_hash_insert_ex(HashArray *pHash, const void *key, const int key_len, \
 void *fc_hash_find(HashArray *pHash, const void *key, const int key_len);
 
 /**
- * hash find key
+ * hash find key, in lock-free read mode the returned node MUST be
+ * accessed between fc_hash_read_lock and fc_hash_read_unlock
  * parameters:
  *         pHash: the hash table
  *         key: the key to find
@@ -298,7 +412,8 @@ int fc_hash_count(HashArray *pHash);
  * parameters:
  *         pHash: the hash table
  *         suggest_capacity: suggest init capacity for speed
- * return >0 for success, < 0 fail (errno)
+ * return >0 for success, < 0 fail (errno), -EOPNOTSUPP for
+ *        the lock-free read mode
 */
 int fc_hash_best_op(HashArray *pHash, const int suggest_capacity);
 
@@ -387,6 +502,7 @@ int fc_simple_hash(const void* key, const int key_len);
 int fc_simple_hash_ex(const void* key, const int key_len, \
 	const int init_value);
 
+/* CRC32 of IEEE 802.3, refer to fc_crc32.h for CRC32C and streaming API */
 int CRC32(const void *key, const int key_len);
 int64_t CRC32_ex(const void *key, const int key_len, \
 	const int64_t init_value);
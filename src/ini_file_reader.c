@@ -22,12 +22,14 @@
 #include <errno.h>
 #include <limits.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
 #include "shared_func.h"
 #include "logger.h"
 #include "http_func.h"
 #include "local_ip_func.h"
 #include "pthread_func.h"
 #include "fc_memory.h"
+#include "fc_crc32.h"
 #include "ini_file_reader.h"
 
 #define _LINE_BUFFER_SIZE	   512
@@ -85,12 +87,19 @@ typedef struct {
     AnnotationEntry *annotations;
 } DynamicAnnotations;
 
+typedef struct {
+    int count;
+    int alloc;
+    IniSourceFile *files;
+} DynamicSources;
+
 typedef struct {
     bool used;
     IniContext *context;
     DynamicContents dynamicContents;
     SetDirectiveVars set;
     DynamicAnnotations dynamicAnnotations;
+    DynamicSources sources;
 } CDCPair;
 
 typedef struct {
@@ -114,6 +123,8 @@ static DynamicAnnotations *iniAllocAnnotations(IniContext *pContext,
         const int annotation_count);
 static AnnotationEntry *iniGetAnnotations(IniContext *pContext);
 static SetDirectiveVars *iniGetVars(IniContext *pContext);
+static int iniAddSourceFile(IniContext *pContext, const char *szFilename,
+        const struct stat *st, const char *content, const int64_t content_len);
 
 #define RETRY_FETCH_GLOBAL(szSectionName, bRetryGlobal) \
         ((szSectionName != NULL && *szSectionName != '\0') && bRetryGlobal)
@@ -754,6 +765,7 @@ static int iniDoLoadFromFile(const char *szFilename, \
 	int http_status;
 	int content_len;
 	int64_t file_size;
+	struct stat st;
 	char error_info[512];
 
 	if (IS_URL_RESOURCE(szFilename))
@@ -776,14 +788,36 @@ static int iniDoLoadFromFile(const char *szFilename, \
 				__LINE__, http_status, szFilename);
 			return EINVAL;
 		}
+		file_size = content_len;
+		result = iniAddSourceFile(pContext, szFilename,
+				NULL, content, file_size);
 	}
 	else
 	{
+		//stat before read, the content is newer when changed between
+		if (stat(szFilename, &st) != 0)
+		{
+			result = errno != 0 ? errno : ENOENT;
+			logError("file: "__FILE__", line: %d, " \
+				"stat file \"%s\" fail, " \
+				"errno: %d, error info: %s", \
+				__LINE__, szFilename, result, STRERROR(result));
+			return result;
+		}
+
 		if ((result=getFileContent(szFilename, &content, \
 				&file_size)) != 0)
 		{
 			return result;
 		}
+		result = iniAddSourceFile(pContext, szFilename,
+				&st, content, file_size);
+	}
+
+	if (result != 0)
+	{
+		free(content);
+		return result;
 	}
 
 	result = iniLoadItemsFromBuffer(content, pContext);
@@ -1510,6 +1544,70 @@ static AnnotationEntry *iniGetAnnotations(IniContext *pContext)
     return pair->dynamicAnnotations.annotations;
 }
 
+static int iniAddSourceFile(IniContext *pContext, const char *szFilename,
+        const struct stat *st, const char *content, const int64_t content_len)
+{
+    CDCPair *pair;
+    DynamicSources *sources;
+    IniSourceFile *files;
+    IniSourceFile *file;
+    int alloc;
+
+    pair = iniAllocCDCPair(pContext);
+    if (pair == NULL)
+    {
+        return ENOMEM;
+    }
+
+    sources = &pair->sources;
+    if (sources->count >= sources->alloc)
+    {
+        alloc = (sources->alloc == 0) ? 4 : sources->alloc * 2;
+        files = (IniSourceFile *)fc_realloc(sources->files,
+                sizeof(IniSourceFile) * alloc);
+        if (files == NULL)
+        {
+            return ENOMEM;
+        }
+        sources->files = files;
+        sources->alloc = alloc;
+    }
+
+    file = sources->files + sources->count;
+    if ((file->filename=fc_strdup(szFilename)) == NULL)
+    {
+        return ENOMEM;
+    }
+    if (st != NULL)
+    {
+        file->file_size = content_len;
+        file->mtime_ns = FAST_INI_STAT_MTIME_NS(*st);
+    }
+    else
+    {
+        file->file_size = -1;
+        file->mtime_ns = 0;
+    }
+    file->crc32 = fc_crc32c(content, content_len);
+    sources->count++;
+    return 0;
+}
+
+const IniSourceFile *iniGetSourceFiles(IniContext *pContext, int *nCount)
+{
+    CDCPair *pair;
+
+    pair = iniGetCDCPair(pContext);
+    if (pair == NULL || pair->sources.count == 0)
+    {
+        *nCount = 0;
+        return NULL;
+    }
+
+    *nCount = pair->sources.count;
+    return pair->sources.files;
+}
+
 static SetDirectiveVars *iniAllocVars(IniContext *pContext, const bool initVars)
 {
     CDCPair *pair;
@@ -1549,6 +1647,7 @@ static void iniFreeDynamicContent(IniContext *pContext)
     CDCPair *pCDCPair;
     DynamicContents *pDynamicContents;
     DynamicAnnotations *pDynamicAnnotations;
+    DynamicSources *pDynamicSources;
     int i;
 
     if (checkInitDynamicContentArray() != 0)
@@ -1612,6 +1711,19 @@ static void iniFreeDynamicContent(IniContext *pContext)
             pDynamicAnnotations->count = 0;
         }
 
+        pDynamicSources = &pCDCPair->sources;
+        if (pDynamicSources->files != NULL)
+        {
+            for (i=0; i<pDynamicSources->count; i++)
+            {
+                free(pDynamicSources->files[i].filename);
+            }
+            free(pDynamicSources->files);
+            pDynamicSources->files = NULL;
+            pDynamicSources->alloc = 0;
+            pDynamicSources->count = 0;
+        }
+
         pCDCPair->used = false;
         pCDCPair->context = NULL;
         g_dynamic_content_array.count--;
@@ -2783,12 +2895,15 @@ void iniFreeContext(IniContext *pContext)
 	fc_hash_destroy(&pContext->sections);
 
     set = iniGetVars(pContext);
-    if (set != NULL && set->vars != NULL)
+    if (set != NULL)
     {
-        fc_hash_destroy(set->vars);
-        free(set->vars);
-        set->vars = NULL;
-        set->offset = 0;
+        if (set->vars != NULL)
+        {
+            fc_hash_destroy(set->vars);
+            free(set->vars);
+            set->vars = NULL;
+        }
+        set->offset = 0;  //the pair is reused by the other context
     }
     iniFreeDynamicContent(pContext);
 }
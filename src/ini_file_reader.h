@@ -79,6 +79,14 @@ typedef struct ini_context
     char flags;
 } IniContext;
 
+typedef struct ini_source_file
+{
+    char *filename;
+    int64_t file_size;  //-1 for the URL
+    int64_t mtime_ns;   //the modify time in nanoseconds
+    uint32_t crc32;     //CRC32C of the content
+} IniSourceFile;
+
 typedef struct ini_full_context
 {
     const char *filename;
@@ -104,6 +112,13 @@ typedef struct ini_annotation_entry {
     bool inited;
 } AnnotationEntry;
 
+#ifdef st_mtimensec
+#define FAST_INI_STAT_MTIME_NS(st) \
+    ((int64_t)(st).st_mtime * 1000000000LL + (st).st_mtimensec)
+#else
+#define FAST_INI_STAT_MTIME_NS(st) ((int64_t)(st).st_mtime * 1000000000LL)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -245,6 +260,15 @@ int iniLoadFromBuffer1(char *content, IniContext *pContext, const char flags);
 */
 void iniFreeContext(IniContext *pContext);
 
+/** return the files loaded by the context, the config file first then
+ *  the #include files, used to check if the loaded items are outdated
+ *  parameters:
+ *           pContext:   the ini context
+ *           nCount:     return the file count
+ *  return: the source files, NULL for none (such as load from buffer)
+*/
+const IniSourceFile *iniGetSourceFiles(IniContext *pContext, int *nCount);
+
 /** get item string value
  *  parameters:
  *           szSectionName: the section name, NULL or empty string for
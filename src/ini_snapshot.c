@@ -0,0 +1,988 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//ini_snapshot.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "shared_func.h"
+#include "http_func.h"
+#include "fc_memory.h"
+#include "fast_buffer.h"
+#include "fc_crc32.h"
+#include "fc_fast_hash.h"
+#include "ini_snapshot.h"
+
+#define INI_SNAPSHOT_EMPTY_SLOT     0xFFFFFFFF
+#define INI_SNAPSHOT_SECTION_SEED   0x5EC7105EC7105EC7ULL
+#define INI_SNAPSHOT_MAX_SEED       (1 << 20)
+#define INI_SNAPSHOT_BUILD_TRIES    8
+
+#define INI_SNAPSHOT_ALIGN(n)  (((n) + 7) & (~((int64_t)7)))
+
+typedef struct ini_snapshot_phash {
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t *seeds;
+    uint32_t *slots;
+} IniSnapshotPHash;
+
+typedef struct ini_snapshot_bucket {
+    uint32_t bucket;
+    uint32_t count;
+} IniSnapshotBucket;
+
+typedef struct ini_snapshot_builder {
+    IniContext *context;
+    IniSnapshotHeader header;
+    IniSnapshotSource *sources;
+    IniSnapshotSection *sections;
+    IniSnapshotItem *items;
+    IniSnapshotKey *keys;
+    uint64_t *section_hashes;
+    uint64_t *key_hashes;
+    IniSnapshotPHash section_phash;
+    IniSnapshotPHash key_phash;
+    FastBuffer strings;
+    uint32_t section_index;  //for the hash walk
+    uint32_t item_index;
+    int result;
+} IniSnapshotBuilder;
+
+static inline uint64_t ini_snapshot_mix64(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static inline uint64_t ini_snapshot_section_hash(
+        const char *name, const int len)
+{
+    return fc_xxh3_64(name, len, INI_SNAPSHOT_SECTION_SEED);
+}
+
+static inline uint64_t ini_snapshot_key_hash(const uint32_t section_index,
+        const char *name, const int len)
+{
+    return fc_xxh3_64(name, len, section_index);
+}
+
+/* hash and displace: the high 32 bits select the bucket, the seed of the
+ * bucket displaces the keys of the bucket to the distinct free slots */
+static inline uint32_t ini_snapshot_phash_bucket(const uint64_t hash,
+        const uint32_t bucket_count)
+{
+    return (uint32_t)(hash >> 32) % bucket_count;
+}
+
+static inline uint32_t ini_snapshot_phash_slot(const uint64_t hash,
+        const uint32_t seed, const uint32_t slot_count)
+{
+    return ini_snapshot_mix64(hash ^ ((uint64_t)seed *
+                0x9E3779B97F4A7C15ULL)) % slot_count;
+}
+
+static inline uint32_t ini_snapshot_phash_find(const uint64_t hash,
+        const uint32_t bucket_count, const uint32_t slot_count,
+        const uint32_t *seeds, const uint32_t *slots)
+{
+    return slots[ini_snapshot_phash_slot(hash, seeds[
+            ini_snapshot_phash_bucket(hash, bucket_count)], slot_count)];
+}
+
+static int ini_snapshot_compare_bucket(const void *p1, const void *p2)
+{
+    return (int)((const IniSnapshotBucket *)p2)->count -
+        (int)((const IniSnapshotBucket *)p1)->count;
+}
+
+static bool ini_snapshot_place_bucket(IniSnapshotPHash *phash,
+        const uint64_t *hashes, const uint32_t *members,
+        const uint32_t count, const uint32_t bucket)
+{
+    uint32_t seed;
+    uint32_t slot;
+    uint32_t i;
+    uint32_t k;
+
+    for (seed=1; seed<INI_SNAPSHOT_MAX_SEED; seed++) {
+        for (i=0; i<count; i++) {
+            slot = ini_snapshot_phash_slot(hashes[members[i]],
+                    seed, phash->slot_count);
+            if (phash->slots[slot] != INI_SNAPSHOT_EMPTY_SLOT) {
+                break;
+            }
+            phash->slots[slot] = members[i];
+        }
+
+        if (i == count) {
+            phash->seeds[bucket] = seed;
+            return true;
+        }
+
+        for (k=0; k<i; k++) {   //rollback
+            phash->slots[ini_snapshot_phash_slot(hashes[members[k]],
+                    seed, phash->slot_count)] = INI_SNAPSHOT_EMPTY_SLOT;
+        }
+    }
+
+    return false;
+}
+
+static bool ini_snapshot_phash_try(IniSnapshotPHash *phash,
+        const uint64_t *hashes, const uint32_t count,
+        IniSnapshotBucket *buckets, uint32_t *starts, uint32_t *members)
+{
+    uint32_t b;
+    uint32_t i;
+
+    memset(buckets, 0, sizeof(IniSnapshotBucket) * phash->bucket_count);
+    for (b=0; b<phash->bucket_count; b++) {
+        buckets[b].bucket = b;
+    }
+    for (i=0; i<count; i++) {
+        buckets[ini_snapshot_phash_bucket(hashes[i],
+                phash->bucket_count)].count++;
+    }
+
+    starts[0] = 0;
+    for (b=0; b<phash->bucket_count; b++) {
+        starts[b + 1] = starts[b] + buckets[b].count;
+    }
+    for (i=0; i<count; i++) {
+        b = ini_snapshot_phash_bucket(hashes[i], phash->bucket_count);
+        members[starts[b]++] = i;
+    }
+    for (b=0; b<phash->bucket_count; b++) {
+        starts[b] -= buckets[b].count;
+    }
+
+    //place the large buckets first when the slots are free
+    qsort(buckets, phash->bucket_count, sizeof(IniSnapshotBucket),
+            ini_snapshot_compare_bucket);
+    memset(phash->seeds, 0, sizeof(uint32_t) * phash->bucket_count);
+    memset(phash->slots, 0xFF, sizeof(uint32_t) * phash->slot_count);
+    for (b=0; b<phash->bucket_count && buckets[b].count > 0; b++) {
+        if (!ini_snapshot_place_bucket(phash, hashes, members +
+                    starts[buckets[b].bucket], buckets[b].count,
+                    buckets[b].bucket))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int ini_snapshot_phash_build(IniSnapshotPHash *phash,
+        const uint64_t *hashes, const uint32_t count)
+{
+    IniSnapshotBucket *buckets;
+    uint32_t *starts;
+    uint32_t *members;
+    int tries;
+    int result;
+
+    phash->bucket_count = count / 4 + 1;
+    phash->slot_count = count + count / 4 + 1;   //load factor 0.8
+    phash->seeds = NULL;
+    phash->slots = NULL;
+    buckets = NULL;
+    starts = NULL;
+    members = NULL;
+
+    result = ENOMEM;
+    for (tries=0; tries<INI_SNAPSHOT_BUILD_TRIES; tries++) {
+        free(phash->seeds);
+        free(phash->slots);
+        free(buckets);
+        free(starts);
+        phash->seeds = (uint32_t *)fc_malloc(sizeof(uint32_t) *
+                phash->bucket_count);
+        phash->slots = (uint32_t *)fc_malloc(sizeof(uint32_t) *
+                phash->slot_count);
+        buckets = (IniSnapshotBucket *)fc_malloc(sizeof(IniSnapshotBucket) *
+                phash->bucket_count);
+        starts = (uint32_t *)fc_malloc(sizeof(uint32_t) *
+                (phash->bucket_count + 1));
+        if (members == NULL) {
+            members = (uint32_t *)fc_malloc(sizeof(uint32_t) *
+                    (count > 0 ? count : 1));
+        }
+        if (phash->seeds == NULL || phash->slots == NULL ||
+                buckets == NULL || starts == NULL || members == NULL)
+        {
+            result = ENOMEM;
+            break;
+        }
+
+        if (ini_snapshot_phash_try(phash, hashes, count,
+                    buckets, starts, members))
+        {
+            result = 0;
+            break;
+        }
+
+        //more room for the next try
+        phash->slot_count += phash->slot_count / 4 + 1;
+        phash->bucket_count += phash->bucket_count / 2 + 1;
+        result = EOVERFLOW;
+    }
+
+    free(buckets);
+    free(starts);
+    free(members);
+    if (result != 0) {
+        if (result == EOVERFLOW) {
+            logError("file: "__FILE__", line: %d, "
+                    "build the perfect hash of %u keys fail",
+                    __LINE__, count);
+        }
+        free(phash->seeds);
+        free(phash->slots);
+        phash->seeds = NULL;
+        phash->slots = NULL;
+    }
+    return result;
+}
+
+static int ini_snapshot_add_string(IniSnapshotBuilder *builder,
+        const char *str, const int len, uint32_t *offset)
+{
+    int result;
+
+    *offset = fast_buffer_length(&builder->strings);
+    if ((result=fast_buffer_append_binary(&builder->strings,
+                    str, len)) != 0)
+    {
+        return result;
+    }
+    return fast_buffer_append_binary(&builder->strings, "", 1);
+}
+
+static int ini_snapshot_add_section(IniSnapshotBuilder *builder,
+        const char *name, const int name_len, const IniSection *pSection)
+{
+    IniSnapshotSection *section;
+    IniSnapshotItem *item;
+    IniSnapshotKey *key;
+    const IniItem *pItem;
+    const IniItem *pEnd;
+    int result;
+
+    section = builder->sections + builder->section_index;
+    section->name_len = name_len;
+    section->item_start = builder->item_index;
+    section->item_count = pSection->count;
+    if ((result=ini_snapshot_add_string(builder, name,
+                    name_len, &section->name)) != 0)
+    {
+        return result;
+    }
+    builder->section_hashes[builder->section_index] =
+        ini_snapshot_section_hash(name, name_len);
+
+    pEnd = pSection->items + pSection->count;
+    for (pItem=pSection->items; pItem<pEnd; pItem++) {
+        item = builder->items + builder->item_index;
+        item->name_len = strlen(pItem->name);
+        item->value_len = strlen(pItem->value);
+        if ((result=ini_snapshot_add_string(builder, pItem->name,
+                        item->name_len, &item->name)) != 0)
+        {
+            return result;
+        }
+        if ((result=ini_snapshot_add_string(builder, pItem->value,
+                        item->value_len, &item->value)) != 0)
+        {
+            return result;
+        }
+
+        //the items of the same name are adjacent after sorted
+        if (pItem > pSection->items && strcmp(pItem->name,
+                    (pItem - 1)->name) == 0)
+        {
+            builder->keys[builder->header.key_count - 1].value_count++;
+        } else {
+            key = builder->keys + builder->header.key_count;
+            key->section_index = builder->section_index;
+            key->item_index = builder->item_index;
+            key->value_count = 1;
+            key->padding = 0;
+            builder->key_hashes[builder->header.key_count++] =
+                ini_snapshot_key_hash(builder->section_index,
+                        pItem->name, item->name_len);
+        }
+        builder->item_index++;
+    }
+
+    builder->section_index++;
+    return 0;
+}
+
+static int ini_snapshot_count_items_walk(const int index,
+        const HashData *data, void *args)
+{
+    if (data->value != NULL) {
+        ((IniSnapshotBuilder *)args)->header.section_count++;
+        ((IniSnapshotBuilder *)args)->header.item_count +=
+            ((IniSection *)data->value)->count;
+    }
+    return 0;
+}
+
+static int ini_snapshot_add_section_walk(const int index,
+        const HashData *data, void *args)
+{
+    IniSnapshotBuilder *builder;
+
+    if (data->value == NULL) {
+        return 0;
+    }
+    builder = (IniSnapshotBuilder *)args;
+    return ini_snapshot_add_section(builder, data->key,
+            data->key_len, (IniSection *)data->value);
+}
+
+static int ini_snapshot_build(IniSnapshotBuilder *builder,
+        const IniSourceFile *files, const int file_count)
+{
+    IniContext *pContext;
+    uint32_t alloc;
+    int result;
+    int i;
+
+    pContext = builder->context;
+    builder->header.source_count = file_count;
+    builder->header.section_count = 1;   //the global section
+    builder->header.item_count = pContext->global.count;
+    fc_hash_walk(&pContext->sections, ini_snapshot_count_items_walk, builder);
+
+    alloc = builder->header.item_count > 0 ? builder->header.item_count : 1;
+    builder->sources = (IniSnapshotSource *)fc_calloc(file_count,
+            sizeof(IniSnapshotSource));
+    builder->sections = (IniSnapshotSection *)fc_calloc(
+            builder->header.section_count, sizeof(IniSnapshotSection));
+    builder->section_hashes = (uint64_t *)fc_malloc(sizeof(uint64_t) *
+            builder->header.section_count);
+    builder->items = (IniSnapshotItem *)fc_calloc(alloc,
+            sizeof(IniSnapshotItem));
+    builder->keys = (IniSnapshotKey *)fc_calloc(alloc,
+            sizeof(IniSnapshotKey));
+    builder->key_hashes = (uint64_t *)fc_malloc(sizeof(uint64_t) * alloc);
+    if (builder->sources == NULL || builder->sections == NULL ||
+            builder->section_hashes == NULL || builder->items == NULL ||
+            builder->keys == NULL || builder->key_hashes == NULL)
+    {
+        return ENOMEM;
+    }
+
+    if ((result=fast_buffer_init_ex(&builder->strings, 64 * 1024)) != 0) {
+        return result;
+    }
+    if ((result=ini_snapshot_add_string(builder, pContext->config_path,
+                    strlen(pContext->config_path),
+                    &builder->header.config_path)) != 0)
+    {
+        return result;
+    }
+    for (i=0; i<file_count; i++) {
+        builder->sources[i].crc32 = files[i].crc32;
+        builder->sources[i].file_size = files[i].file_size;
+        builder->sources[i].mtime_ns = files[i].mtime_ns;
+        if ((result=ini_snapshot_add_string(builder, files[i].filename,
+                        strlen(files[i].filename),
+                        &builder->sources[i].filename)) != 0)
+        {
+            return result;
+        }
+    }
+
+    if ((result=ini_snapshot_add_section(builder, "", 0,
+                    &pContext->global)) != 0)
+    {
+        return result;
+    }
+    if ((result=fc_hash_walk(&pContext->sections,
+                    ini_snapshot_add_section_walk, builder)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=ini_snapshot_phash_build(&builder->section_phash,
+                    builder->section_hashes,
+                    builder->header.section_count)) != 0)
+    {
+        return result;
+    }
+    return ini_snapshot_phash_build(&builder->key_phash,
+            builder->key_hashes, builder->header.key_count);
+}
+
+#define INI_SNAPSHOT_SET_REGION(offset_field, count, size) \
+    do { \
+        header->offset_field = offset;  \
+        offset = INI_SNAPSHOT_ALIGN(offset + (int64_t)(count) * (size)); \
+    } while (0)
+
+#define INI_SNAPSHOT_COPY_REGION(offset_field, src, count, size) \
+    memcpy(buff + header->offset_field, src, (int64_t)(count) * (size))
+
+static int ini_snapshot_write(IniSnapshotBuilder *builder,
+        const char *szSnapshotFilename)
+{
+    IniSnapshotHeader *header;
+    char *buff;
+    int64_t offset;
+    int result;
+
+    header = &builder->header;
+    memcpy(header->magic, INI_SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = INI_SNAPSHOT_VERSION;
+    header->header_size = sizeof(IniSnapshotHeader);
+    header->annotation_type = builder->context->annotation_type;
+    header->flags = builder->context->flags;
+    header->section_bucket_count = builder->section_phash.bucket_count;
+    header->section_slot_count = builder->section_phash.slot_count;
+    header->key_bucket_count = builder->key_phash.bucket_count;
+    header->key_slot_count = builder->key_phash.slot_count;
+    header->strings_size = fast_buffer_length(&builder->strings);
+
+    offset = INI_SNAPSHOT_ALIGN(sizeof(IniSnapshotHeader));
+    INI_SNAPSHOT_SET_REGION(sources_offset, header->source_count,
+            sizeof(IniSnapshotSource));
+    INI_SNAPSHOT_SET_REGION(sections_offset, header->section_count,
+            sizeof(IniSnapshotSection));
+    INI_SNAPSHOT_SET_REGION(items_offset, header->item_count,
+            sizeof(IniSnapshotItem));
+    INI_SNAPSHOT_SET_REGION(keys_offset, header->key_count,
+            sizeof(IniSnapshotKey));
+    INI_SNAPSHOT_SET_REGION(section_seeds_offset,
+            header->section_bucket_count, sizeof(uint32_t));
+    INI_SNAPSHOT_SET_REGION(section_slots_offset,
+            header->section_slot_count, sizeof(uint32_t));
+    INI_SNAPSHOT_SET_REGION(key_seeds_offset,
+            header->key_bucket_count, sizeof(uint32_t));
+    INI_SNAPSHOT_SET_REGION(key_slots_offset,
+            header->key_slot_count, sizeof(uint32_t));
+    INI_SNAPSHOT_SET_REGION(strings_offset, header->strings_size, 1);
+    header->file_size = offset;
+    if (header->file_size > INT32_MAX) {
+        logError("file: "__FILE__", line: %d, "
+                "snapshot file \"%s\" is too large, size: %"PRId64,
+                __LINE__, szSnapshotFilename, header->file_size);
+        return EOVERFLOW;
+    }
+
+    if ((buff=(char *)fc_calloc(1, header->file_size)) == NULL) {
+        return ENOMEM;
+    }
+    INI_SNAPSHOT_COPY_REGION(sources_offset, builder->sources,
+            header->source_count, sizeof(IniSnapshotSource));
+    INI_SNAPSHOT_COPY_REGION(sections_offset, builder->sections,
+            header->section_count, sizeof(IniSnapshotSection));
+    INI_SNAPSHOT_COPY_REGION(items_offset, builder->items,
+            header->item_count, sizeof(IniSnapshotItem));
+    INI_SNAPSHOT_COPY_REGION(keys_offset, builder->keys,
+            header->key_count, sizeof(IniSnapshotKey));
+    INI_SNAPSHOT_COPY_REGION(section_seeds_offset, builder->section_phash.
+            seeds, header->section_bucket_count, sizeof(uint32_t));
+    INI_SNAPSHOT_COPY_REGION(section_slots_offset, builder->section_phash.
+            slots, header->section_slot_count, sizeof(uint32_t));
+    INI_SNAPSHOT_COPY_REGION(key_seeds_offset, builder->key_phash.seeds,
+            header->key_bucket_count, sizeof(uint32_t));
+    INI_SNAPSHOT_COPY_REGION(key_slots_offset, builder->key_phash.slots,
+            header->key_slot_count, sizeof(uint32_t));
+    INI_SNAPSHOT_COPY_REGION(strings_offset, fast_buffer_data(
+                &builder->strings), header->strings_size, 1);
+
+    header->body_crc32 = fc_crc32c(buff + sizeof(IniSnapshotHeader),
+            header->file_size - sizeof(IniSnapshotHeader));
+    memcpy(buff, header, sizeof(IniSnapshotHeader));
+
+    result = safeWriteToFile(szSnapshotFilename, buff, header->file_size);
+    free(buff);
+    return result;
+}
+
+int iniSnapshotSave(IniContext *pContext, const char *szSnapshotFilename)
+{
+    IniSnapshotBuilder builder;
+    const IniSourceFile *files;
+    int file_count;
+    int result;
+    int i;
+
+    files = iniGetSourceFiles(pContext, &file_count);
+    for (i=0; i<file_count; i++) {
+        if (files[i].file_size < 0) {
+            break;
+        }
+    }
+    if (file_count == 0 || i < file_count) {
+        logError("file: "__FILE__", line: %d, "
+                "the ini context is not loaded from the local files, "
+                "can't save to snapshot \"%s\"", __LINE__,
+                szSnapshotFilename);
+        return EOPNOTSUPP;
+    }
+
+    memset(&builder, 0, sizeof(builder));
+    builder.context = pContext;
+    if ((result=ini_snapshot_build(&builder, files, file_count)) == 0) {
+        result = ini_snapshot_write(&builder, szSnapshotFilename);
+    }
+
+    free(builder.sources);
+    free(builder.sections);
+    free(builder.items);
+    free(builder.keys);
+    free(builder.section_hashes);
+    free(builder.key_hashes);
+    free(builder.section_phash.seeds);
+    free(builder.section_phash.slots);
+    free(builder.key_phash.seeds);
+    free(builder.key_phash.slots);
+    fast_buffer_destroy(&builder.strings);
+    return result;
+}
+
+#define INI_SNAPSHOT_CHECK_REGION(offset_field, count, size) \
+    (header->offset_field >= (int64_t)sizeof(IniSnapshotHeader) && \
+     header->offset_field + (int64_t)(count) * (size) <= header->file_size)
+
+static bool ini_snapshot_check_header(const IniSnapshotHeader *header,
+        const char *buff, const int64_t size)
+{
+    if (size < (int64_t)sizeof(IniSnapshotHeader) ||
+            memcmp(header->magic, INI_SNAPSHOT_MAGIC,
+                sizeof(header->magic)) != 0 ||
+            header->version != INI_SNAPSHOT_VERSION ||
+            header->header_size != sizeof(IniSnapshotHeader) ||
+            header->file_size != size)
+    {
+        return false;
+    }
+
+    if (!(INI_SNAPSHOT_CHECK_REGION(sources_offset, header->source_count,
+                    sizeof(IniSnapshotSource)) &&
+            INI_SNAPSHOT_CHECK_REGION(sections_offset, header->
+                section_count, sizeof(IniSnapshotSection)) &&
+            INI_SNAPSHOT_CHECK_REGION(items_offset, header->item_count,
+                sizeof(IniSnapshotItem)) &&
+            INI_SNAPSHOT_CHECK_REGION(keys_offset, header->key_count,
+                sizeof(IniSnapshotKey)) &&
+            INI_SNAPSHOT_CHECK_REGION(section_seeds_offset, header->
+                section_bucket_count, sizeof(uint32_t)) &&
+            INI_SNAPSHOT_CHECK_REGION(section_slots_offset, header->
+                section_slot_count, sizeof(uint32_t)) &&
+            INI_SNAPSHOT_CHECK_REGION(key_seeds_offset, header->
+                key_bucket_count, sizeof(uint32_t)) &&
+            INI_SNAPSHOT_CHECK_REGION(key_slots_offset, header->
+                key_slot_count, sizeof(uint32_t)) &&
+            INI_SNAPSHOT_CHECK_REGION(strings_offset,
+                header->strings_size, 1)))
+    {
+        return false;
+    }
+
+    if (header->section_count == 0 || header->section_bucket_count == 0 ||
+            header->section_slot_count == 0 || header->key_bucket_count == 0
+            || header->key_slot_count == 0 || header->strings_size == 0 ||
+            buff[header->strings_offset + header->strings_size - 1] != '\0')
+    {
+        return false;
+    }
+
+    return fc_crc32c(buff + sizeof(IniSnapshotHeader), size -
+            sizeof(IniSnapshotHeader)) == header->body_crc32;
+}
+
+int iniSnapshotOpen(IniSnapshot *pSnapshot, const char *szSnapshotFilename)
+{
+    const IniSnapshotHeader *header;
+    const char *buff;
+    int result;
+
+    memset(pSnapshot, 0, sizeof(IniSnapshot));
+    if ((result=fc_mapped_file_open(&pSnapshot->mf,
+                    szSnapshotFilename, false)) != 0)
+    {
+        return result;
+    }
+
+    buff = pSnapshot->mf.map;
+    header = (const IniSnapshotHeader *)buff;
+    if (buff == NULL || !ini_snapshot_check_header(header,
+                buff, pSnapshot->mf.size))
+    {
+        logError("file: "__FILE__", line: %d, "
+                "invalid snapshot file \"%s\", file size: %"PRId64,
+                __LINE__, szSnapshotFilename, pSnapshot->mf.size);
+        fc_mapped_file_close(&pSnapshot->mf);
+        return EINVAL;
+    }
+
+    pSnapshot->header = header;
+    pSnapshot->sources = (const IniSnapshotSource *)
+        (buff + header->sources_offset);
+    pSnapshot->sections = (const IniSnapshotSection *)
+        (buff + header->sections_offset);
+    pSnapshot->items = (const IniSnapshotItem *)
+        (buff + header->items_offset);
+    pSnapshot->keys = (const IniSnapshotKey *)(buff + header->keys_offset);
+    pSnapshot->section_seeds = (const uint32_t *)
+        (buff + header->section_seeds_offset);
+    pSnapshot->section_slots = (const uint32_t *)
+        (buff + header->section_slots_offset);
+    pSnapshot->key_seeds = (const uint32_t *)
+        (buff + header->key_seeds_offset);
+    pSnapshot->key_slots = (const uint32_t *)
+        (buff + header->key_slots_offset);
+    pSnapshot->strings = buff + header->strings_offset;
+    return 0;
+}
+
+void iniSnapshotClose(IniSnapshot *pSnapshot)
+{
+    fc_mapped_file_close(&pSnapshot->mf);
+    pSnapshot->header = NULL;
+}
+
+static bool ini_snapshot_source_changed(IniSnapshot *pSnapshot,
+        const IniSnapshotSource *source)
+{
+    const char *filename;
+    struct stat st;
+    char *content;
+    int64_t file_size;
+    bool changed;
+
+    filename = pSnapshot->strings + source->filename;
+    if (stat(filename, &st) != 0 || st.st_size != source->file_size) {
+        return true;
+    }
+    if (FAST_INI_STAT_MTIME_NS(st) == source->mtime_ns) {
+        return false;
+    }
+
+    //touched only or rewritten with the same content
+    if (getFileContent(filename, &content, &file_size) != 0) {
+        return true;
+    }
+    changed = (file_size != source->file_size || fc_crc32c(
+                content, file_size) != source->crc32);
+    free(content);
+    return changed;
+}
+
+int iniSnapshotCheckSources(IniSnapshot *pSnapshot)
+{
+    const IniSnapshotSource *source;
+    const IniSnapshotSource *end;
+
+    end = pSnapshot->sources + pSnapshot->header->source_count;
+    for (source=pSnapshot->sources; source<end; source++) {
+        if (ini_snapshot_source_changed(pSnapshot, source)) {
+            logDebug("file: "__FILE__", line: %d, "
+                    "the source file \"%s\" of the snapshot changed",
+                    __LINE__, pSnapshot->strings + source->filename);
+            return ESTALE;
+        }
+    }
+    return 0;
+}
+
+/* the same full filename as iniLoadFromFileEx */
+static int ini_snapshot_get_full_filename(const char *szFilename,
+        char *full_filename, const int size)
+{
+    char cwd[MAX_PATH_SIZE];
+    int len;
+
+    if (IS_FILE_RESOURCE(szFilename)) {
+        szFilename += FILE_RESOURCE_TAG_LEN;
+    }
+    if (*szFilename == '/') {
+        snprintf(full_filename, size, "%s", szFilename);
+        return 0;
+    }
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return errno != 0 ? errno : EPERM;
+    }
+    len = strlen(cwd);
+    if (len > 0 && cwd[len - 1] == '/') {
+        cwd[len - 1] = '\0';
+    }
+    snprintf(full_filename, size, "%s/%s", cwd, szFilename);
+    return 0;
+}
+
+static bool ini_snapshot_is_valid(IniSnapshot *pSnapshot,
+        const char *full_filename, const char annotation_type,
+        const char flags)
+{
+    const IniSnapshotHeader *header;
+
+    header = pSnapshot->header;
+    return header->annotation_type == annotation_type &&
+        header->flags == flags && header->source_count > 0 &&
+        strcmp(pSnapshot->strings + pSnapshot->sources[0].filename,
+                full_filename) == 0 &&
+        iniSnapshotCheckSources(pSnapshot) == 0;
+}
+
+int iniSnapshotLoadEx(IniSnapshot *pSnapshot, const char *szFilename,
+        const char *szSnapshotFilename, const char annotation_type,
+        AnnotationEntry *annotations, const int count, const char flags)
+{
+    IniContext context;
+    char full_filename[PATH_MAX];
+    int result;
+
+    if (IS_URL_RESOURCE(szFilename)) {
+        logError("file: "__FILE__", line: %d, "
+                "the snapshot of the URL \"%s\" is not supported",
+                __LINE__, szFilename);
+        return EOPNOTSUPP;
+    }
+    if ((result=ini_snapshot_get_full_filename(szFilename,
+                    full_filename, sizeof(full_filename))) != 0)
+    {
+        return result;
+    }
+
+    if (fileExists(szSnapshotFilename) && iniSnapshotOpen(
+                pSnapshot, szSnapshotFilename) == 0)
+    {
+        if (ini_snapshot_is_valid(pSnapshot, full_filename,
+                    annotation_type, flags))
+        {
+            return 0;
+        }
+        iniSnapshotClose(pSnapshot);
+    }
+
+    if ((result=iniLoadFromFileEx(szFilename, &context, annotation_type,
+                    annotations, count, flags)) != 0)
+    {
+        return result;
+    }
+    result = iniSnapshotSave(&context, szSnapshotFilename);
+    iniFreeContext(&context);
+    if (result != 0) {
+        return result;
+    }
+
+    return iniSnapshotOpen(pSnapshot, szSnapshotFilename);
+}
+
+static uint32_t ini_snapshot_find_section(IniSnapshot *pSnapshot,
+        const char *szSectionName)
+{
+    const IniSnapshotHeader *header;
+    const IniSnapshotSection *section;
+    uint32_t index;
+    int len;
+
+    if (szSectionName == NULL || *szSectionName == '\0') {
+        return 0;
+    }
+
+    header = pSnapshot->header;
+    len = strlen(szSectionName);
+    index = ini_snapshot_phash_find(ini_snapshot_section_hash(
+                szSectionName, len), header->section_bucket_count,
+            header->section_slot_count, pSnapshot->section_seeds,
+            pSnapshot->section_slots);
+    if (index >= header->section_count) {
+        return INI_SNAPSHOT_EMPTY_SLOT;
+    }
+
+    section = pSnapshot->sections + index;
+    if (section->name_len == len && memcmp(pSnapshot->strings +
+                section->name, szSectionName, len) == 0)
+    {
+        return index;
+    }
+    return INI_SNAPSHOT_EMPTY_SLOT;
+}
+
+static const IniSnapshotKey *ini_snapshot_find_key(IniSnapshot *pSnapshot,
+        const char *szSectionName, const char *szItemName)
+{
+    const IniSnapshotHeader *header;
+    const IniSnapshotKey *key;
+    const IniSnapshotItem *item;
+    uint32_t section_index;
+    uint32_t index;
+    int len;
+
+    header = pSnapshot->header;
+    if (header->key_count == 0 || (section_index=ini_snapshot_find_section(
+                    pSnapshot, szSectionName)) == INI_SNAPSHOT_EMPTY_SLOT)
+    {
+        return NULL;
+    }
+
+    len = strlen(szItemName);
+    index = ini_snapshot_phash_find(ini_snapshot_key_hash(section_index,
+                szItemName, len), header->key_bucket_count,
+            header->key_slot_count, pSnapshot->key_seeds,
+            pSnapshot->key_slots);
+    if (index >= header->key_count) {
+        return NULL;
+    }
+
+    key = pSnapshot->keys + index;
+    item = pSnapshot->items + key->item_index;
+    if (key->section_index == section_index && item->name_len == len &&
+            memcmp(pSnapshot->strings + item->name, szItemName, len) == 0)
+    {
+        return key;
+    }
+    return NULL;
+}
+
+const IniSnapshotItem *iniSnapshotGetValuesEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot, int *nTargetCount)
+{
+    const IniSnapshotKey *key;
+
+    if ((key=ini_snapshot_find_key(pSnapshot, szSectionName,
+                    szItemName)) == NULL)
+    {
+        *nTargetCount = 0;
+        return NULL;
+    }
+
+    *nTargetCount = key->value_count;
+    return pSnapshot->items + key->item_index;
+}
+
+const char *iniSnapshotGetStrValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const bool bRetryGlobal)
+{
+    const IniSnapshotKey *key;
+
+    key = ini_snapshot_find_key(pSnapshot, szSectionName, szItemName);
+    if (key == NULL) {
+        if ((szSectionName != NULL && *szSectionName != '\0') &&
+                bRetryGlobal)
+        {
+            key = ini_snapshot_find_key(pSnapshot, NULL, szItemName);
+        }
+        if (key == NULL) {
+            return NULL;
+        }
+    }
+
+    return pSnapshot->strings + pSnapshot->items[key->item_index +
+        key->value_count - 1].value;
+}
+
+int iniSnapshotGetValues(const char *szSectionName, const char *szItemName,
+        IniSnapshot *pSnapshot, const char **szValues, const int max_values)
+{
+    const IniSnapshotItem *item;
+    int count;
+    int i;
+
+    if (max_values <= 0) {
+        return 0;
+    }
+
+    item = iniSnapshotGetValuesEx(szSectionName, szItemName,
+            pSnapshot, &count);
+    if (count > max_values) {
+        count = max_values;
+    }
+    for (i=0; i<count; i++) {
+        szValues[i] = pSnapshot->strings + item[i].value;
+    }
+    return count;
+}
+
+int iniSnapshotGetIntValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const int nDefaultValue, const bool bRetryGlobal)
+{
+    const char *pValue;
+
+    pValue = iniSnapshotGetStrValueEx(szSectionName, szItemName,
+            pSnapshot, bRetryGlobal);
+    return (pValue != NULL) ? atoi(pValue) : nDefaultValue;
+}
+
+int64_t iniSnapshotGetInt64ValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const int64_t nDefaultValue, const bool bRetryGlobal)
+{
+    const char *pValue;
+
+    pValue = iniSnapshotGetStrValueEx(szSectionName, szItemName,
+            pSnapshot, bRetryGlobal);
+    return (pValue != NULL) ? strtoll(pValue, NULL, 10) : nDefaultValue;
+}
+
+double iniSnapshotGetDoubleValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const double dbDefaultValue, const bool bRetryGlobal)
+{
+    const char *pValue;
+
+    pValue = iniSnapshotGetStrValueEx(szSectionName, szItemName,
+            pSnapshot, bRetryGlobal);
+    return (pValue != NULL) ? strtod(pValue, NULL) : dbDefaultValue;
+}
+
+bool iniSnapshotGetBoolValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const bool bDefaultValue, const bool bRetryGlobal)
+{
+    const char *pValue;
+
+    pValue = iniSnapshotGetStrValueEx(szSectionName, szItemName,
+            pSnapshot, bRetryGlobal);
+    return (pValue != NULL) ? FAST_INI_STRING_IS_TRUE(pValue) :
+        bDefaultValue;
+}
+
+const IniSnapshotItem *iniSnapshotGetSectionItems(const char *szSectionName,
+        IniSnapshot *pSnapshot, int *nCount)
+{
+    const IniSnapshotSection *section;
+    uint32_t index;
+
+    index = ini_snapshot_find_section(pSnapshot, szSectionName);
+    if (index == INI_SNAPSHOT_EMPTY_SLOT) {
+        *nCount = 0;
+        return NULL;
+    }
+
+    section = pSnapshot->sections + index;
+    *nCount = section->item_count;
+    return pSnapshot->items + section->item_start;
+}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//ini_snapshot.h: the compiled binary snapshot of the loaded IniContext,
+//                mmap the snapshot file and lookup by the perfect hash
+
+#ifndef _INI_SNAPSHOT_H
+#define _INI_SNAPSHOT_H
+
+#include "common_define.h"
+#include "fc_line_scan.h"
+#include "ini_file_reader.h"
+
+#define INI_SNAPSHOT_MAGIC    "FCINISNP"
+#define INI_SNAPSHOT_VERSION  1
+
+/* the file layout: the header, the source files, the sections, the items,
+ * the keys, the perfect hash seeds and slots of the sections and keys,
+ * then the NUL terminated strings. the offsets are from the file begin,
+ * the string offsets are from the strings begin */
+typedef struct ini_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int64_t file_size;
+    uint32_t body_crc32;      //CRC32C of the bytes after the header
+    uint32_t config_path;     //the string offset of the config path
+    char annotation_type;
+    char flags;
+    char padding[6];
+
+    uint32_t source_count;
+    uint32_t section_count;   //including the global section as index 0
+    uint32_t item_count;
+    uint32_t key_count;       //the distinct (section, item name) count
+    uint32_t section_bucket_count;
+    uint32_t section_slot_count;
+    uint32_t key_bucket_count;
+    uint32_t key_slot_count;
+
+    int64_t sources_offset;
+    int64_t sections_offset;
+    int64_t items_offset;
+    int64_t keys_offset;
+    int64_t section_seeds_offset;
+    int64_t section_slots_offset;
+    int64_t key_seeds_offset;
+    int64_t key_slots_offset;
+    int64_t strings_offset;
+    int64_t strings_size;
+} IniSnapshotHeader;
+
+typedef struct ini_snapshot_source {
+    uint32_t filename;
+    uint32_t crc32;
+    int64_t file_size;
+    int64_t mtime_ns;
+} IniSnapshotSource;
+
+typedef struct ini_snapshot_section {
+    uint32_t name;
+    uint32_t name_len;
+    uint32_t item_start;     //the items are sorted by name as IniContext
+    uint32_t item_count;
+} IniSnapshotSection;
+
+typedef struct ini_snapshot_item {
+    uint32_t name;
+    uint32_t name_len;
+    uint32_t value;
+    uint32_t value_len;
+} IniSnapshotItem;
+
+typedef struct ini_snapshot_key {
+    uint32_t section_index;
+    uint32_t item_index;     //the first item of the same name
+    uint32_t value_count;
+    uint32_t padding;
+} IniSnapshotKey;
+
+typedef struct ini_snapshot {
+    FCMappedFile mf;
+    const IniSnapshotHeader *header;
+    const IniSnapshotSource *sources;
+    const IniSnapshotSection *sections;
+    const IniSnapshotItem *items;
+    const IniSnapshotKey *keys;
+    const uint32_t *section_seeds;
+    const uint32_t *section_slots;
+    const uint32_t *key_seeds;
+    const uint32_t *key_slots;
+    const char *strings;
+} IniSnapshot;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** compile the loaded context to the snapshot file, the file is written
+ *  to a temp file then renamed. the values of the @function annotations
+ *  and the #@set shell commands are saved as loaded, rebuild the
+ *  snapshot when the environment changed
+ *  parameters:
+ *           pContext: the ini context loaded by iniLoadFromFileEx
+ *           szSnapshotFilename: the snapshot filename
+ *  return: error no, 0 for success, EOPNOTSUPP when load from the URL
+ *          or the buffer (no source files to check)
+*/
+int iniSnapshotSave(IniContext *pContext, const char *szSnapshotFilename);
+
+/** map the snapshot file and check the format and the checksum
+ *  parameters:
+ *           pSnapshot: the snapshot
+ *           szSnapshotFilename: the snapshot filename
+ *  return: error no, 0 for success, EINVAL for the invalid snapshot
+*/
+int iniSnapshotOpen(IniSnapshot *pSnapshot, const char *szSnapshotFilename);
+
+/** unmap the snapshot file
+ *  parameters:
+ *           pSnapshot: the snapshot
+ *  return: none
+*/
+void iniSnapshotClose(IniSnapshot *pSnapshot);
+
+/** check the source files by the file size and the modify time, the file
+ *  content is checked by CRC32C when the modify time changed only
+ *  parameters:
+ *           pSnapshot: the snapshot
+ *  return: error no, 0 for up to date, ESTALE for outdated
+*/
+int iniSnapshotCheckSources(IniSnapshot *pSnapshot);
+
+/** open the snapshot when it is up to date and built from the config file
+ *  with the same annotation type and flags, otherwise load the config file
+ *  by iniLoadFromFileEx, save and open the snapshot
+ *  parameters:
+ *           pSnapshot: the snapshot
+ *           szFilename: the config filename
+ *           szSnapshotFilename: the snapshot filename
+ *           annotation_type: the annotation type
+ *           annotations: the annotations, can be NULL
+ *           count: the annotation count
+ *           flags: the flags
+ *  return: error no, 0 for success
+*/
+int iniSnapshotLoadEx(IniSnapshot *pSnapshot, const char *szFilename,
+        const char *szSnapshotFilename, const char annotation_type,
+        AnnotationEntry *annotations, const int count, const char flags);
+
+static inline int iniSnapshotLoad(IniSnapshot *pSnapshot,
+        const char *szFilename, const char *szSnapshotFilename)
+{
+    return iniSnapshotLoadEx(pSnapshot, szFilename, szSnapshotFilename,
+            FAST_INI_ANNOTATION_WITH_BUILTIN, NULL, 0, FAST_INI_FLAGS_NONE);
+}
+
+/** get the items of the same name
+ *  parameters:
+ *           szSectionName: the section name, NULL or empty string for
+ *                          global section
+ *           szItemName: the item name
+ *           pSnapshot: the snapshot
+ *           nTargetCount: store the item count
+ *  return: the first item, NULL when the item not exist
+*/
+const IniSnapshotItem *iniSnapshotGetValuesEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot, int *nTargetCount);
+
+/** get item string value, the last one of the same name as IniContext
+ *  parameters:
+ *           szSectionName: the section name, NULL or empty string for
+ *                          global section
+ *           szItemName: the item name
+ *           pSnapshot: the snapshot
+ *           bRetryGlobal: if fetch from global section when the item not exist
+ *  return: item value, return NULL when the item not exist
+*/
+const char *iniSnapshotGetStrValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const bool bRetryGlobal);
+
+/** get item string values
+ *  parameters:
+ *           szSectionName: the section name, NULL or empty string for
+ *                          global section
+ *           szItemName: the item name
+ *           pSnapshot: the snapshot
+ *           szValues: string array to store the values
+ *           max_values: max string array elements
+ *  return: item value count
+*/
+int iniSnapshotGetValues(const char *szSectionName, const char *szItemName,
+        IniSnapshot *pSnapshot, const char **szValues, const int max_values);
+
+int iniSnapshotGetIntValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const int nDefaultValue, const bool bRetryGlobal);
+
+int64_t iniSnapshotGetInt64ValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const int64_t nDefaultValue, const bool bRetryGlobal);
+
+double iniSnapshotGetDoubleValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const double dbDefaultValue, const bool bRetryGlobal);
+
+bool iniSnapshotGetBoolValueEx(const char *szSectionName,
+        const char *szItemName, IniSnapshot *pSnapshot,
+        const bool bDefaultValue, const bool bRetryGlobal);
+
+/** return the section items
+ *  parameters:
+ *           szSectionName: the section name, NULL or empty string for
+ *                          global section
+ *           pSnapshot: the snapshot
+ *           nCount: return the item count
+ *  return: the section items, NULL for not exist
+*/
+const IniSnapshotItem *iniSnapshotGetSectionItems(const char *szSectionName,
+        IniSnapshot *pSnapshot, int *nCount);
+
+#define iniSnapshotGetStrValue(szSectionName, szItemName, pSnapshot) \
+    iniSnapshotGetStrValueEx(szSectionName, szItemName, pSnapshot, false)
+
+#define iniSnapshotGetIntValue(szSectionName, szItemName, \
+        pSnapshot, nDefaultValue) \
+    iniSnapshotGetIntValueEx(szSectionName, szItemName, \
+            pSnapshot, nDefaultValue, false)
+
+#define iniSnapshotGetInt64Value(szSectionName, szItemName, \
+        pSnapshot, nDefaultValue) \
+    iniSnapshotGetInt64ValueEx(szSectionName, szItemName, \
+            pSnapshot, nDefaultValue, false)
+
+#define iniSnapshotGetDoubleValue(szSectionName, szItemName, \
+        pSnapshot, dbDefaultValue) \
+    iniSnapshotGetDoubleValueEx(szSectionName, szItemName, \
+            pSnapshot, dbDefaultValue, false)
+
+#define iniSnapshotGetBoolValue(szSectionName, szItemName, \
+        pSnapshot, bDefaultValue) \
+    iniSnapshotGetBoolValueEx(szSectionName, szItemName, \
+            pSnapshot, bDefaultValue, false)
+
+static inline const char *iniSnapshotGetString(IniSnapshot *pSnapshot,
+        const uint32_t offset)
+{
+    return pSnapshot->strings + offset;
+}
+
+static inline const char *iniSnapshotGetItemName(IniSnapshot *pSnapshot,
+        const IniSnapshotItem *item)
+{
+    return pSnapshot->strings + item->name;
+}
+
+static inline const char *iniSnapshotGetItemValue(IniSnapshot *pSnapshot,
+        const IniSnapshotItem *item)
+{
+    return pSnapshot->strings + item->value;
+}
+
+static inline const char *iniSnapshotGetConfigPath(IniSnapshot *pSnapshot)
+{
+    return pSnapshot->strings + pSnapshot->header->config_path;
+}
+
+/** get section count, excluding the global section
+ *  parameters:
+ *           pSnapshot: the snapshot
+ *  return: section count
+*/
+static inline int iniSnapshotGetSectionCount(IniSnapshot *pSnapshot)
+{
+    return pSnapshot->header->section_count - 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1005 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//log_recorder.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef OS_LINUX
+#include <sys/syscall.h>
+#endif
+#include "shared_func.h"
+#include "logger.h"
+#include "binary_logger.h"
+#include "log_recorder.h"
+
+#define LOG_RECORDER_ALIGN_SIZE    64
+#define LOG_RECORDER_ALIGN(size) (((size) + LOG_RECORDER_ALIGN_SIZE - 1) & \
+        ~(LOG_RECORDER_ALIGN_SIZE - 1))
+#define LOG_RECORDER_SEGMENT_HEADER_SIZE \
+    LOG_RECORDER_ALIGN(sizeof(LogRecorderSegment))
+
+#define LOG_RECORDER_MAX_SIGNALS   8
+#define LOG_RECORDER_DUMP_BUFF_SIZE  (8 * 1024)
+
+#define LOG_RECORDER_FORMAT_STRING_SIZE  128  //the average of the formats
+#define LOG_RECORDER_FORMAT_MAX_PROBES   16
+
+//the states of the format entry
+#define LOG_RECORDER_FORMAT_FILLING  0
+#define LOG_RECORDER_FORMAT_READY    1
+#define LOG_RECORDER_FORMAT_INVALID  2  //unsupported or no string space
+
+/* the layout of the memory: the segment header, then max_threads rings,
+ * every ring is the ring header followed by slot_count slots, then the
+ * format table and the string area of the format copies */
+typedef struct log_recorder_segment {
+    char magic[LOG_RECORDER_MAGIC_LEN];
+    int version;
+    int max_threads;
+    int slot_count;
+    int slot_size;
+    int gmtoff;      //the offset of the local time in seconds
+    int pid;
+    int max_formats;
+    int strings_size;
+    volatile int strings_used;
+    int padding;
+    int64_t create_time;
+} LogRecorderSegment;
+
+typedef struct log_recorder_ring {
+    volatile int owner;     //the thread id, 0 for free
+    int padding1;
+    volatile int64_t seq;   //the seq of the last record, start from 1
+    char padding2[LOG_RECORDER_ALIGN_SIZE - 2 * sizeof(int64_t)];
+} LogRecorderRing;
+
+/* the slot is followed by the text or the encoded args of the format,
+ * the seq is 0 while writing */
+typedef struct log_recorder_slot {
+    volatile int64_t seq;
+    int64_t timestamp;   //in microseconds
+    int tid;
+    int format_id;       //the index of the format table + 1, 0 for the text
+    short priority;
+    short length;        //the text length or the encoded args length
+    int padding;
+} LogRecorderSlot;
+
+/* the entry of the format table, the key is the address of the format
+ * which is compared with the copy in the string area when found */
+typedef struct log_recorder_format {
+    volatile int state;
+    int offset;          //the format copy in the string area
+    BinaryLogFormat parsed;
+} LogRecorderFormat;
+
+typedef struct log_recorder_cursor {
+    LogRecorderRing *ring;
+    int64_t next;
+    int64_t end;
+} LogRecorderCursor;
+
+typedef struct log_recorder_writer {
+    int fd;
+    int length;
+    int result;
+    char buff[LOG_RECORDER_DUMP_BUFF_SIZE];
+} LogRecorderWriter;
+
+typedef struct log_recorder_signal_entry {
+    int signum;
+    bool crash;
+    char filename[MAX_PATH_SIZE];
+} LogRecorderSignalEntry;
+
+static LogRecorder *signal_recorder = NULL;
+static LogRecorderSignalEntry signal_entries[LOG_RECORDER_MAX_SIGNALS];
+static int signal_entry_count = 0;
+
+#define RECORDER_RING_PTR(segment, ring_size, index) \
+    ((LogRecorderRing *)((char *)(segment) + \
+        LOG_RECORDER_SEGMENT_HEADER_SIZE + (ring_size) * (index)))
+
+#define RECORDER_SLOT_PTR(ring, slot_size, slot_count, seq) \
+    ((LogRecorderSlot *)((char *)((ring) + 1) + (int64_t)(slot_size) * \
+        ((seq) & ((slot_count) - 1))))
+
+#define RECORDER_RINGS_SIZE(slot_size, slot_count, max_threads) \
+    ((sizeof(LogRecorderRing) + (int64_t)(slot_count) * (slot_size)) * \
+     (max_threads))
+
+#define RECORDER_FORMATS_PTR(segment) \
+    ((LogRecorderFormat *)((char *)(segment) + \
+        LOG_RECORDER_SEGMENT_HEADER_SIZE + RECORDER_RINGS_SIZE( \
+            (segment)->slot_size, (segment)->slot_count, \
+            (segment)->max_threads)))
+
+#define RECORDER_STRINGS_PTR(segment) \
+    ((char *)(RECORDER_FORMATS_PTR(segment) + (segment)->max_formats))
+
+static inline int log_recorder_get_tid()
+{
+#ifdef OS_LINUX
+    return (int)syscall(SYS_gettid);
+#else
+    static volatile int thread_seq = 0;
+    return __sync_add_and_fetch(&thread_seq, 1);
+#endif
+}
+
+static void log_recorder_ring_destructor(void *arg)
+{
+    __atomic_store_n(&((LogRecorderRing *)arg)->owner, 0, __ATOMIC_RELEASE);
+}
+
+static int log_recorder_get_gmtoff()
+{
+    time_t now;
+    struct tm tm;
+
+    now = time(NULL);
+    localtime_r(&now, &tm);
+    return tm.tm_gmtoff;
+}
+
+int log_recorder_init(LogRecorder *recorder, const LogRecorderConfig *config)
+{
+    LogRecorderSegment *segment;
+    char prev_filename[MAX_PATH_SIZE + 8];
+    void *addr;
+    int fd;
+    int result;
+
+    memset(recorder, 0, sizeof(LogRecorder));
+    recorder->max_threads = LOG_RECORDER_DEFAULT_MAX_THREADS;
+    recorder->slot_count = LOG_RECORDER_DEFAULT_SLOT_COUNT;
+    recorder->slot_size = LOG_RECORDER_DEFAULT_SLOT_SIZE;
+    recorder->max_formats = LOG_RECORDER_DEFAULT_MAX_FORMATS;
+    if (config != NULL) {
+        if (config->max_threads > 0) {
+            recorder->max_threads = config->max_threads;
+        }
+        if (config->slot_count > 0) {
+            recorder->slot_count = 16;
+            while (recorder->slot_count < config->slot_count) {
+                recorder->slot_count *= 2;
+            }
+        }
+        if (config->slot_size > 0) {
+            if (config->slot_size < LOG_RECORDER_MIN_SLOT_SIZE) {
+                recorder->slot_size = LOG_RECORDER_MIN_SLOT_SIZE;
+            } else if (config->slot_size > LOG_RECORDER_MAX_SLOT_SIZE) {
+                recorder->slot_size = LOG_RECORDER_MAX_SLOT_SIZE;
+            } else {
+                recorder->slot_size = config->slot_size & (~7);
+            }
+        }
+        if (config->max_formats > 0) {
+            recorder->max_formats = 16;
+            while (recorder->max_formats < config->max_formats) {
+                recorder->max_formats *= 2;
+            }
+        }
+        if (config->shm_filename != NULL) {
+            snprintf(recorder->shm_filename, sizeof(recorder->shm_filename),
+                    "%s", config->shm_filename);
+        }
+    }
+
+    recorder->ring_size = sizeof(LogRecorderRing) +
+        (int64_t)recorder->slot_count * recorder->slot_size;
+    recorder->segment_size = LOG_RECORDER_SEGMENT_HEADER_SIZE +
+        recorder->ring_size * recorder->max_threads +
+        (int64_t)recorder->max_formats * (sizeof(LogRecorderFormat) +
+                LOG_RECORDER_FORMAT_STRING_SIZE);
+    if (*recorder->shm_filename != '\0') {
+        //keep the recorder of the previous process for the dump
+        if (access(recorder->shm_filename, F_OK) == 0) {
+            snprintf(prev_filename, sizeof(prev_filename), "%s%s",
+                    recorder->shm_filename, LOG_RECORDER_SHM_PREV_EXT_STR);
+            rename(recorder->shm_filename, prev_filename);
+        }
+
+        if ((fd=open(recorder->shm_filename, O_RDWR | O_CREAT |
+                        O_TRUNC | O_CLOEXEC, 0644)) < 0)
+        {
+            result = errno != 0 ? errno : EACCES;
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "open file %s fail, errno: %d, error info: %s\n",
+                    __LINE__, recorder->shm_filename, result,
+                    STRERROR(result));
+            return result;
+        }
+        if (ftruncate(fd, recorder->segment_size) != 0) {
+            result = errno != 0 ? errno : ENOSPC;
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "ftruncate file %s to %"PRId64" fail, errno: %d, "
+                    "error info: %s\n", __LINE__, recorder->shm_filename,
+                    recorder->segment_size, result, STRERROR(result));
+            close(fd);
+            return result;
+        }
+        addr = mmap(NULL, recorder->segment_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        addr = mmap(NULL, recorder->segment_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        result = errno != 0 ? errno : ENOMEM;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "mmap %"PRId64" bytes fail, errno: %d, error info: %s\n",
+                __LINE__, recorder->segment_size, result, STRERROR(result));
+        return result;
+    }
+
+    recorder->cursors = (LogRecorderCursor *)calloc(recorder->max_threads,
+            sizeof(LogRecorderCursor));
+    if (recorder->cursors == NULL) {
+        munmap(addr, recorder->segment_size);
+        return ENOMEM;
+    }
+    if ((result=pthread_key_create(&recorder->ring_key,
+                    log_recorder_ring_destructor)) != 0)
+    {
+        free(recorder->cursors);
+        munmap(addr, recorder->segment_size);
+        return result;
+    }
+
+    segment = (LogRecorderSegment *)addr;
+    segment->version = LOG_RECORDER_VERSION;
+    segment->max_threads = recorder->max_threads;
+    segment->slot_count = recorder->slot_count;
+    segment->slot_size = recorder->slot_size;
+    segment->gmtoff = log_recorder_get_gmtoff();
+    segment->pid = getpid();
+    segment->max_formats = recorder->max_formats;
+    segment->strings_size = recorder->max_formats *
+        LOG_RECORDER_FORMAT_STRING_SIZE;
+    segment->create_time = time(NULL);
+    memcpy(segment->magic, LOG_RECORDER_MAGIC, LOG_RECORDER_MAGIC_LEN);
+    recorder->formats = RECORDER_FORMATS_PTR(segment);
+    recorder->strings = RECORDER_STRINGS_PTR(segment);
+    recorder->segment = segment;
+    return 0;
+}
+
+void log_recorder_destroy(LogRecorder *recorder)
+{
+    if (recorder->segment == NULL) {
+        return;
+    }
+
+    if (signal_recorder == recorder) {
+        signal_recorder = NULL;
+    }
+    pthread_key_delete(recorder->ring_key);
+    munmap(recorder->segment, recorder->segment_size);
+    recorder->segment = NULL;
+    recorder->formats = NULL;
+    recorder->strings = NULL;
+    free(recorder->cursors);
+    recorder->cursors = NULL;
+}
+
+static LogRecorderRing *log_recorder_get_ring(LogRecorder *recorder)
+{
+    LogRecorderRing *ring;
+    int tid;
+    int i;
+
+    if ((ring=(LogRecorderRing *)pthread_getspecific(
+                    recorder->ring_key)) != NULL)
+    {
+        return ring;
+    }
+
+    tid = log_recorder_get_tid();
+    for (i=0; i<recorder->max_threads; i++) {
+        ring = RECORDER_RING_PTR(recorder->segment, recorder->ring_size, i);
+        if (ring->owner == 0 && __sync_bool_compare_and_swap(
+                    &ring->owner, 0, tid))
+        {
+            if (pthread_setspecific(recorder->ring_key, ring) != 0) {
+                __atomic_store_n(&ring->owner, 0, __ATOMIC_RELEASE);
+                return NULL;
+            }
+            return ring;
+        }
+    }
+
+    return NULL;
+}
+
+static inline LogRecorderSlot *log_recorder_begin(LogRecorder *recorder,
+        LogRecorderRing *ring, const int priority, int64_t *seq)
+{
+    LogRecorderSlot *slot;
+
+    *seq = ring->seq + 1;
+    slot = RECORDER_SLOT_PTR(ring, recorder->slot_size,
+            recorder->slot_count, *seq);
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->timestamp = get_current_time_us();
+    slot->tid = ring->owner;
+    slot->priority = priority;
+    return slot;
+}
+
+static inline void log_recorder_commit(LogRecorderRing *ring,
+        LogRecorderSlot *slot, const int64_t seq, const int length)
+{
+    slot->length = length;
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->seq, seq, __ATOMIC_RELEASE);
+}
+
+/* parse and copy the format to the entry owned by the caller */
+static void log_recorder_fill_format(LogRecorder *recorder,
+        LogRecorderFormat *entry, const char *format)
+{
+    int length;
+    int offset;
+    int state;
+
+    state = LOG_RECORDER_FORMAT_INVALID;
+    do {
+        if (binary_log_parse_format_ex(format, entry->parsed.arg_types,
+                    entry->parsed.arg_precisions,
+                    &entry->parsed.arg_count) != 0)
+        {
+            break;
+        }
+
+        length = strlen(format) + 1;
+        offset = __sync_fetch_and_add(&recorder->segment->
+                strings_used, length);
+        if (offset + length > recorder->segment->strings_size) {
+            break;
+        }
+        memcpy(recorder->strings + offset, format, length);
+        entry->offset = offset;
+        state = LOG_RECORDER_FORMAT_READY;
+    } while (0);
+
+    __atomic_store_n(&entry->state, state, __ATOMIC_RELEASE);
+}
+
+/* find or add the format in the table by the address of the format,
+ * return NULL for the table full or the format not ready */
+static LogRecorderFormat *log_recorder_get_format(LogRecorder *recorder,
+        const char *format)
+{
+    LogRecorderFormat *entry;
+    const char *key;
+    int64_t hash_code;
+    int i;
+
+    hash_code = ((uint64_t)(uintptr_t)format * 11400714819323198485ULL) >> 32;
+    for (i=0; i<LOG_RECORDER_FORMAT_MAX_PROBES; i++) {
+        entry = recorder->formats + ((hash_code + i) &
+                (recorder->max_formats - 1));
+        key = __atomic_load_n(&entry->parsed.format, __ATOMIC_ACQUIRE);
+        if (key == NULL) {
+            if (__sync_bool_compare_and_swap(&entry->parsed.format,
+                        NULL, format))
+            {
+                log_recorder_fill_format(recorder, entry, format);
+                return (entry->state == LOG_RECORDER_FORMAT_READY ?
+                        entry : NULL);
+            }
+            key = __atomic_load_n(&entry->parsed.format, __ATOMIC_ACQUIRE);
+        }
+        if (key != format) {
+            continue;
+        }
+
+        //the format buffer may be reused with the other content
+        if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) ==
+                LOG_RECORDER_FORMAT_READY && strcmp(recorder->strings +
+                    entry->offset, format) == 0)
+        {
+            return entry;
+        }
+        return NULL;
+    }
+
+    return NULL;
+}
+
+void log_recorder_vwrite(LogRecorder *recorder, const int priority,
+        const char *format, va_list ap)
+{
+    LogRecorderRing *ring;
+    LogRecorderSlot *slot;
+    LogRecorderFormat *entry;
+    va_list args;
+    int64_t seq;
+    int err_no;
+    int size;
+    int len;
+
+    err_no = errno;
+    if ((ring=log_recorder_get_ring(recorder)) == NULL) {
+        __sync_add_and_fetch(&recorder->no_ring_count, 1);
+        return;
+    }
+
+    slot = log_recorder_begin(recorder, ring, priority, &seq);
+    size = recorder->slot_size - sizeof(LogRecorderSlot);
+    if ((entry=log_recorder_get_format(recorder, format)) != NULL) {
+        va_copy(args, ap);
+        len = binary_log_encode_args(&entry->parsed, err_no,
+                args, (char *)(slot + 1), size);
+        va_end(args);
+        if (len >= 0) {
+            slot->format_id = (entry - recorder->formats) + 1;
+            log_recorder_commit(ring, slot, seq, len);
+            return;
+        }
+    }
+
+    //format here when the format is not in the table or the args overflow
+    errno = err_no;
+    len = vsnprintf((char *)(slot + 1), size, format, ap);
+    if (len >= size) {
+        len = size - 1;
+    } else if (len < 0) {
+        len = 0;
+    }
+    slot->format_id = 0;
+    log_recorder_commit(ring, slot, seq, len);
+}
+
+void log_recorder_write(LogRecorder *recorder, const int priority,
+        const char *text, const int text_len)
+{
+    LogRecorderRing *ring;
+    LogRecorderSlot *slot;
+    int64_t seq;
+    int size;
+    int len;
+
+    if ((ring=log_recorder_get_ring(recorder)) == NULL) {
+        __sync_add_and_fetch(&recorder->no_ring_count, 1);
+        return;
+    }
+
+    slot = log_recorder_begin(recorder, ring, priority, &seq);
+    size = recorder->slot_size - sizeof(LogRecorderSlot);
+    len = text_len < size ? text_len : size;
+    memcpy(slot + 1, text, len);
+    slot->format_id = 0;
+    log_recorder_commit(ring, slot, seq, len);
+}
+
+/* the functions of the dump must be async-signal-safe:
+ * no malloc, no stdio and no localtime, except the snprintf of the
+ * recorded args which allocates no memory for the usual conversions */
+static void log_recorder_flush_writer(LogRecorderWriter *writer)
+{
+    int offset;
+    int bytes;
+
+    offset = 0;
+    while (offset < writer->length) {
+        bytes = write(writer->fd, writer->buff + offset,
+                writer->length - offset);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            writer->result = errno != 0 ? errno : EIO;
+            break;
+        }
+        offset += bytes;
+    }
+    writer->length = 0;
+}
+
+static void log_recorder_append(LogRecorderWriter *writer,
+        const char *str, const int len)
+{
+    if (writer->length + len > sizeof(writer->buff)) {
+        log_recorder_flush_writer(writer);
+    }
+    memcpy(writer->buff + writer->length, str, len);
+    writer->length += len;
+}
+
+static char *log_recorder_format_int(char *p, int64_t n, const int width)
+{
+    char digits[32];
+    int count;
+
+    if (n < 0) {
+        *p++ = '-';
+        n = -n;
+    }
+    count = 0;
+    do {
+        digits[count++] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0);
+    while (count < width) {
+        digits[count++] = '0';
+    }
+    while (count > 0) {
+        *p++ = digits[--count];
+    }
+    return p;
+}
+
+/* the days since 1970-01-01 to the civil date */
+static void log_recorder_civil_from_days(int64_t days,
+        int *year, int *month, int *day)
+{
+    int64_t era;
+    int64_t doe;
+    int64_t yoe;
+    int64_t doy;
+    int64_t mp;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2 ? 1 : 0);
+}
+
+/* format as: [YYYY-mm-dd HH:MM:SS.uuuuuu] */
+static int log_recorder_format_time(const int64_t timestamp,
+        const int gmtoff, char *buff)
+{
+    int64_t seconds;
+    int64_t days;
+    int secs_of_day;
+    int year;
+    int month;
+    int day;
+    char *p;
+
+    seconds = timestamp / 1000000 + gmtoff;
+    days = seconds / 86400;
+    secs_of_day = seconds % 86400;
+    if (secs_of_day < 0) {
+        secs_of_day += 86400;
+        days--;
+    }
+    log_recorder_civil_from_days(days, &year, &month, &day);
+
+    p = buff;
+    *p++ = '[';
+    p = log_recorder_format_int(p, year, 4);
+    *p++ = '-';
+    p = log_recorder_format_int(p, month, 2);
+    *p++ = '-';
+    p = log_recorder_format_int(p, day, 2);
+    *p++ = ' ';
+    p = log_recorder_format_int(p, secs_of_day / 3600, 2);
+    *p++ = ':';
+    p = log_recorder_format_int(p, secs_of_day / 60 % 60, 2);
+    *p++ = ':';
+    p = log_recorder_format_int(p, secs_of_day % 60, 2);
+    *p++ = '.';
+    p = log_recorder_format_int(p, timestamp % 1000000, 6);
+    *p++ = ']';
+    return p - buff;
+}
+
+static void log_recorder_append_str(LogRecorderWriter *writer,
+        const char *str)
+{
+    log_recorder_append(writer, str, strlen(str));
+}
+
+static void log_recorder_append_int(LogRecorderWriter *writer,
+        const int64_t n)
+{
+    char buff[32];
+    char *p;
+
+    p = log_recorder_format_int(buff, n, 0);
+    log_recorder_append(writer, buff, p - buff);
+}
+
+/* peek the next valid slot of the ring, return NULL for the end */
+static LogRecorderSlot *log_recorder_peek(const LogRecorderSegment *segment,
+        LogRecorderCursor *cursor)
+{
+    LogRecorderSlot *slot;
+
+    while (cursor->next <= cursor->end) {
+        slot = RECORDER_SLOT_PTR(cursor->ring, segment->slot_size,
+                segment->slot_count, cursor->next);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == cursor->next) {
+            return slot;
+        }
+        cursor->next++;   //overwritten by the owner thread
+    }
+    return NULL;
+}
+
+/* format the encoded args by the format copy in the string area,
+ * return the text length, < 0 for the invalid record */
+static int log_recorder_format_message(const LogRecorderSegment *segment,
+        const LogRecorderSlot *slot, char *text, const int size)
+{
+    const LogRecorderFormat *entry;
+    const char *strings;
+    BinaryLogFormat format;
+
+    if (slot->format_id > segment->max_formats) {
+        return -EINVAL;
+    }
+    entry = RECORDER_FORMATS_PTR(segment) + (slot->format_id - 1);
+    if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) !=
+            LOG_RECORDER_FORMAT_READY || entry->offset < 0 ||
+            entry->offset >= segment->strings_size)
+    {
+        return -EINVAL;
+    }
+    strings = RECORDER_STRINGS_PTR(segment) + entry->offset;
+    if (memchr(strings, '\0', segment->strings_size -
+                entry->offset) == NULL)
+    {
+        return -EINVAL;
+    }
+
+    //only the format string is used by the formatting
+    memset(&format, 0, sizeof(format));
+    format.format = strings;
+    return binary_log_format_args(&format, (const char *)(slot + 1),
+            slot->length, text, size);
+}
+
+static int log_recorder_do_dump(const LogRecorderSegment *segment,
+        LogRecorderCursor *cursors, const int fd)
+{
+    LogRecorderWriter writer;
+    LogRecorderCursor *cursor;
+    LogRecorderCursor *best;
+    LogRecorderSlot *slot;
+    int64_t best_timestamp;
+    int64_t ring_size;
+    int64_t seq;
+    int64_t message_count;
+    char record[sizeof(LogRecorderSlot) + LOG_RECORDER_MAX_SLOT_SIZE];
+    char text[LOG_RECORDER_MAX_SLOT_SIZE];
+    char time_buff[64];
+    LogRecorderSlot *copied;
+    const char *caption;
+    int max_text_len;
+    int len;
+    int i;
+
+    writer.fd = fd;
+    writer.length = 0;
+    writer.result = 0;
+    ring_size = sizeof(LogRecorderRing) + (int64_t)segment->slot_count *
+        segment->slot_size;
+    max_text_len = segment->slot_size - sizeof(LogRecorderSlot);
+
+    len = log_recorder_format_time(get_current_time_us(),
+            segment->gmtoff, time_buff);
+    log_recorder_append_str(&writer, "==== flight recorder dump, pid: ");
+    log_recorder_append_int(&writer, segment->pid);
+    log_recorder_append_str(&writer, ", dump time: ");
+    log_recorder_append(&writer, time_buff, len);
+    log_recorder_append_str(&writer, " ====\n");
+
+    for (i=0; i<segment->max_threads; i++) {
+        cursors[i].ring = RECORDER_RING_PTR(segment, ring_size, i);
+        seq = __atomic_load_n(&cursors[i].ring->seq, __ATOMIC_ACQUIRE);
+        cursors[i].end = seq;
+        cursors[i].next = seq - segment->slot_count + 1;
+        if (cursors[i].next < 1) {
+            cursors[i].next = 1;
+        }
+    }
+
+    copied = (LogRecorderSlot *)record;
+    message_count = 0;
+    while (1) {
+        best = NULL;
+        best_timestamp = 0;
+        for (i=0; i<segment->max_threads; i++) {
+            cursor = cursors + i;
+            if ((slot=log_recorder_peek(segment, cursor)) == NULL) {
+                continue;
+            }
+            if (best == NULL || slot->timestamp < best_timestamp) {
+                best = cursor;
+                best_timestamp = slot->timestamp;
+            }
+        }
+        if (best == NULL) {
+            break;
+        }
+
+        //copy the slot then check the seq again as the seqlock
+        slot = RECORDER_SLOT_PTR(best->ring, segment->slot_size,
+                segment->slot_count, best->next);
+        memcpy(record, slot, segment->slot_size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+        best->next++;
+        if (seq != copied->seq || seq != best->next - 1) {
+            continue;
+        }
+
+        len = copied->length;
+        if (len < 0 || len > max_text_len || copied->format_id < 0) {
+            continue;
+        }
+        if (copied->format_id > 0 && (len=log_recorder_format_message(
+                        segment, copied, text, max_text_len + 1)) < 0)
+        {
+            continue;
+        }
+        log_recorder_append(&writer, time_buff, log_recorder_format_time(
+                    copied->timestamp, segment->gmtoff, time_buff));
+        caption = log_get_priority_caption(copied->priority);
+        log_recorder_append_str(&writer, " ");
+        log_recorder_append_str(&writer, caption);
+        log_recorder_append_str(&writer, " - [tid: ");
+        log_recorder_append_int(&writer, copied->tid);
+        log_recorder_append_str(&writer, "] ");
+        log_recorder_append(&writer, copied->format_id > 0 ?
+                text : (char *)(copied + 1), len);
+        log_recorder_append_str(&writer, "\n");
+        message_count++;
+    }
+
+    log_recorder_append_str(&writer, "==== dumped messages: ");
+    log_recorder_append_int(&writer, message_count);
+    log_recorder_append_str(&writer, " ====\n");
+    log_recorder_flush_writer(&writer);
+    return writer.result;
+}
+
+int log_recorder_dump_fd(LogRecorder *recorder, const int fd)
+{
+    int result;
+
+    if (recorder->segment == NULL) {
+        return ENOENT;
+    }
+    if (!__sync_bool_compare_and_swap(&recorder->dumping, 0, 1)) {
+        return EBUSY;
+    }
+    result = log_recorder_do_dump(recorder->segment, recorder->cursors, fd);
+    __atomic_store_n(&recorder->dumping, 0, __ATOMIC_RELEASE);
+    return result;
+}
+
+int log_recorder_dump(LogRecorder *recorder, const char *filename)
+{
+    int fd;
+    int result;
+
+    if ((fd=open(filename, O_WRONLY | O_CREAT | O_APPEND |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        return errno != 0 ? errno : EACCES;
+    }
+    result = log_recorder_dump_fd(recorder, fd);
+    close(fd);
+    return result;
+}
+
+int log_recorder_dump_shm(const char *shm_filename, const char *filename)
+{
+    LogRecorderSegment *segment;
+    LogRecorderCursor *cursors;
+    struct stat st;
+    void *addr;
+    int fd;
+    int out_fd;
+    int result;
+
+    if ((fd=open(shm_filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s\n",
+                __LINE__, shm_filename, result, STRERROR(result));
+        return result;
+    }
+    if (fstat(fd, &st) != 0) {
+        result = errno != 0 ? errno : EIO;
+        close(fd);
+        return result;
+    }
+    if (st.st_size < LOG_RECORDER_SEGMENT_HEADER_SIZE) {
+        close(fd);
+        return EINVAL;
+    }
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return errno != 0 ? errno : ENOMEM;
+    }
+
+    segment = (LogRecorderSegment *)addr;
+    if (memcmp(segment->magic, LOG_RECORDER_MAGIC,
+                LOG_RECORDER_MAGIC_LEN) != 0 ||
+            segment->version != LOG_RECORDER_VERSION ||
+            segment->max_threads <= 0 || segment->slot_count <= 0 ||
+            segment->slot_size < LOG_RECORDER_MIN_SLOT_SIZE ||
+            segment->slot_size > LOG_RECORDER_MAX_SLOT_SIZE ||
+            segment->max_formats < 0 || segment->strings_size < 0 ||
+            LOG_RECORDER_SEGMENT_HEADER_SIZE + RECORDER_RINGS_SIZE(
+                segment->slot_size, segment->slot_count,
+                segment->max_threads) + (int64_t)segment->max_formats *
+            sizeof(LogRecorderFormat) + segment->strings_size > st.st_size)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "file %s is not a valid log recorder file\n",
+                __LINE__, shm_filename);
+        munmap(addr, st.st_size);
+        return EINVAL;
+    }
+
+    cursors = (LogRecorderCursor *)calloc(segment->max_threads,
+            sizeof(LogRecorderCursor));
+    if (cursors == NULL) {
+        munmap(addr, st.st_size);
+        return ENOMEM;
+    }
+    if ((out_fd=open(filename, O_WRONLY | O_CREAT | O_APPEND |
+                    O_CLOEXEC, 0644)) < 0)
+    {
+        result = errno != 0 ? errno : EACCES;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s\n",
+                __LINE__, filename, result, STRERROR(result));
+    } else {
+        result = log_recorder_do_dump(segment, cursors, out_fd);
+        close(out_fd);
+    }
+
+    free(cursors);
+    munmap(addr, st.st_size);
+    return result;
+}
+
+static LogRecorderSignalEntry *log_recorder_get_signal_entry(
+        const int signum)
+{
+    int i;
+
+    for (i=0; i<signal_entry_count; i++) {
+        if (signal_entries[i].signum == signum) {
+            return signal_entries + i;
+        }
+    }
+    return NULL;
+}
+
+static void log_recorder_signal_handler(int signum)
+{
+    LogRecorderSignalEntry *entry;
+    LogRecorder *recorder;
+    int old_errno;
+
+    old_errno = errno;
+    recorder = signal_recorder;
+    entry = log_recorder_get_signal_entry(signum);
+    if (recorder != NULL && entry != NULL) {
+        log_recorder_dump(recorder, entry->filename);
+    }
+
+    if (entry != NULL && entry->crash) {
+        //the signal is delivered with the default action after return
+        signal(signum, SIG_DFL);
+        raise(signum);
+    }
+    errno = old_errno;
+}
+
+static int log_recorder_install_signal(LogRecorder *recorder,
+        const int signum, const char *filename, const bool crash)
+{
+    LogRecorderSignalEntry *entry;
+    struct sigaction act;
+    int result;
+
+    if ((entry=log_recorder_get_signal_entry(signum)) == NULL) {
+        if (signal_entry_count >= LOG_RECORDER_MAX_SIGNALS) {
+            return ENOSPC;
+        }
+        entry = signal_entries + signal_entry_count;
+    }
+    entry->crash = crash;
+    snprintf(entry->filename, sizeof(entry->filename), "%s", filename);
+    entry->signum = signum;
+    if (entry == signal_entries + signal_entry_count) {
+        signal_entry_count++;
+    }
+    signal_recorder = recorder;
+
+    memset(&act, 0, sizeof(act));
+    sigemptyset(&act.sa_mask);
+    act.sa_handler = log_recorder_signal_handler;
+    act.sa_flags = crash ? SA_RESETHAND : SA_RESTART;
+    if (sigaction(signum, &act, NULL) < 0) {
+        result = errno != 0 ? errno : EINVAL;
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "call sigaction for signal %d fail, "
+                "errno: %d, error info: %s\n",
+                __LINE__, signum, result, STRERROR(result));
+        return result;
+    }
+    return 0;
+}
+
+int log_recorder_set_dump_signal(LogRecorder *recorder,
+        const int signum, const char *filename)
+{
+    return log_recorder_install_signal(recorder, signum, filename, false);
+}
+
+int log_recorder_set_crash_dump(LogRecorder *recorder, const char *filename)
+{
+    int signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    int result;
+    int i;
+
+    for (i=0; i<sizeof(signals) / sizeof(signals[0]); i++) {
+        if ((result=log_recorder_install_signal(recorder,
+                        signals[i], filename, true)) != 0)
+        {
+            return result;
+        }
+    }
+    return 0;
+}
+
+void log_recorder_get_stats(LogRecorder *recorder, LogRecorderStats *stats)
+{
+    LogRecorderRing *ring;
+    int i;
+
+    memset(stats, 0, sizeof(LogRecorderStats));
+    if (recorder->segment == NULL) {
+        return;
+    }
+
+    stats->no_ring_count = recorder->no_ring_count;
+    for (i=0; i<recorder->max_threads; i++) {
+        ring = RECORDER_RING_PTR(recorder->segment, recorder->ring_size, i);
+        stats->record_count += __atomic_load_n(&ring->seq, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&ring->owner, __ATOMIC_RELAXED) != 0) {
+            stats->thread_count++;
+        }
+    }
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//log_recorder.h: the flight recorder, keep the recent messages in the
+//                per thread rings of the memory and dump them on demand
+
+#ifndef _LOG_RECORDER_H
+#define _LOG_RECORDER_H
+
+#include <stdarg.h>
+#include <pthread.h>
+#include "common_define.h"
+
+#define LOG_RECORDER_MAGIC      "FCLOGREC"
+#define LOG_RECORDER_MAGIC_LEN  8
+#define LOG_RECORDER_VERSION    2
+
+#define LOG_RECORDER_DEFAULT_MAX_THREADS  64
+#define LOG_RECORDER_DEFAULT_SLOT_COUNT   1024  //per thread
+#define LOG_RECORDER_DEFAULT_SLOT_SIZE    256   //include the slot header
+#define LOG_RECORDER_DEFAULT_MAX_FORMATS  1024  //the distinct formats
+
+#define LOG_RECORDER_MIN_SLOT_SIZE        64
+#define LOG_RECORDER_MAX_SLOT_SIZE        4096
+
+#define LOG_RECORDER_SHM_PREV_EXT_STR     ".prev"
+
+typedef struct log_recorder_config {
+    int max_threads;  //the max threads recording at the same time
+    int slot_count;   //the slot count of every thread, round up to power 2
+    int slot_size;    //the message longer than the slot is truncated
+    int max_formats;  //the distinct formats, round up to power 2
+    const char *shm_filename;  //the memory mapped file such as one in
+                               //the /dev/shm, NULL for the private memory
+} LogRecorderConfig;
+
+typedef struct log_recorder_stats {
+    int64_t record_count;
+    int64_t no_ring_count;  //discarded for all rings are in use
+    int thread_count;       //the threads owning the rings
+} LogRecorderStats;
+
+struct log_recorder_segment;
+struct log_recorder_cursor;
+struct log_recorder_format;
+
+typedef struct log_recorder {
+    int max_threads;
+    int slot_count;
+    int slot_size;
+    int max_formats;
+    int64_t ring_size;       //the bytes of a ring include the ring header
+    int64_t segment_size;
+    struct log_recorder_segment *segment;  //the mapped memory
+    struct log_recorder_format *formats;   //the format table in the segment
+    char *strings;           //the copies of the format strings
+    pthread_key_t ring_key;
+    volatile int64_t no_ring_count;
+    volatile int dumping;    //avoid the concurrent dumps
+    struct log_recorder_cursor *cursors;   //for the dump without malloc
+    char shm_filename[MAX_PATH_SIZE];
+} LogRecorder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** init the flight recorder
+ *  parameters:
+ *      recorder: the recorder to init
+ *      config: the recorder config, NULL for the default
+ *  return: error no, 0 for success
+ */
+int log_recorder_init(LogRecorder *recorder, const LogRecorderConfig *config);
+
+/** destroy the flight recorder, the shm file is kept for the dump later,
+ *  no thread should record any more
+ *  parameters:
+ *      recorder: the recorder
+ *  return: none
+ */
+void log_recorder_destroy(LogRecorder *recorder);
+
+/** record the format and the encoded args into the ring of the current
+ *  thread without lock, the message is formatted when dumped. the format
+ *  is parsed and copied to the format table when first used, the message
+ *  is formatted here when the table is full or the args exceed the slot.
+ *  the oldest message of the ring is overwritten
+ *  parameters:
+ *      recorder: the recorder
+ *      priority: unix priority
+ *      format: printf format
+ *      ap: the args of the format
+ *  return: none
+ */
+void log_recorder_vwrite(LogRecorder *recorder, const int priority,
+        const char *format, va_list ap);
+
+/** record the text which is already formatted
+ *  parameters:
+ *      recorder: the recorder
+ *      priority: unix priority
+ *      text: the text to record
+ *      text_len: the text length
+ *  return: none
+ */
+void log_recorder_write(LogRecorder *recorder, const int priority,
+        const char *text, const int text_len);
+
+/** dump the messages of all rings to the fd in timestamp order,
+ *  async-signal-safe
+ *  parameters:
+ *      recorder: the recorder
+ *      fd: the fd to write
+ *  return: error no, 0 for success, EBUSY for dumping by another thread
+ */
+int log_recorder_dump_fd(LogRecorder *recorder, const int fd);
+
+/** dump the messages of all rings, append to the file,
+ *  async-signal-safe
+ *  parameters:
+ *      recorder: the recorder
+ *      filename: the dump filename
+ *  return: error no, 0 for success
+ */
+int log_recorder_dump(LogRecorder *recorder, const char *filename);
+
+/** dump the shm file left by the recorder of the dead process
+ *  parameters:
+ *      shm_filename: the shm filename of the recorder
+ *      filename: the dump filename, append to it
+ *  return: error no, 0 for success, EINVAL for not a recorder file
+ */
+int log_recorder_dump_shm(const char *shm_filename, const char *filename);
+
+/** install the signal handler to dump the recorder, only one recorder
+ *  can be dumped by the signals
+ *  parameters:
+ *      recorder: the recorder
+ *      signum: the signal such as SIGUSR2
+ *      filename: the dump filename, append to it
+ *  return: error no, 0 for success
+ */
+int log_recorder_set_dump_signal(LogRecorder *recorder,
+        const int signum, const char *filename);
+
+/** install the handlers of the crash signals (SIGSEGV, SIGBUS, SIGFPE,
+ *  SIGILL and SIGABRT) to dump the recorder, then the signal is raised
+ *  again with the default action
+ *  parameters:
+ *      recorder: the recorder
+ *      filename: the dump filename, append to it
+ *  return: error no, 0 for success
+ */
+int log_recorder_set_crash_dump(LogRecorder *recorder, const char *filename);
+
+/** get the stats of the recorder
+ *  parameters:
+ *      recorder: the recorder
+ *      stats: store the stats
+ *  return: none
+ */
+void log_recorder_get_stats(LogRecorder *recorder, LogRecorderStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include "shared_func.h"
 #include "pthread_func.h"
@@ -44,9 +45,82 @@
 #define GZIP_EXT_NAME_STR  ".gz"
 #define GZIP_EXT_NAME_LEN  (sizeof(GZIP_EXT_NAME_STR) - 1)
 
+#define LOG_STREAM_EXT_NAME_STR  ".zstream"
+
+#define COMPRESS_BUILTIN(pContext) \
+    fc_compress_method_supported((pContext)->compress_method)
+#define COMPRESS_EXT_NAME(pContext) (COMPRESS_BUILTIN(pContext) ? \
+    fc_compress_get_ext((pContext)->compress_method) : GZIP_EXT_NAME_STR)
+#define NEED_STREAMING_COMPRESS(pContext) \
+    (NEED_COMPRESS_LOG((pContext)->compress_log_flags) && \
+     ((pContext)->compress_log_flags & LOG_COMPRESS_FLAGS_STREAMING) != 0 \
+     && COMPRESS_BUILTIN(pContext))
+
+#define LOG_ASYNC_MIN_RING_SIZE     (16 * 1024)
+#define LOG_ASYNC_MAX_PREFIX_LEN    64   //the time and the caption
+#define LOG_ASYNC_IOV_COUNT         256
+#define LOG_ASYNC_RECORD_ALIGN      16
+#define LOG_ASYNC_ALIGN(size) (((size) + LOG_ASYNC_RECORD_ALIGN - 1) & \
+        ~(LOG_ASYNC_RECORD_ALIGN - 1))
+
+//record the message below the log level by the flight recorder
+#define LOG_RECORD_VA_ARGS(pContext, priority) \
+	if (priority <= pContext->record_level && pContext->recorder != NULL) \
+	{ \
+		va_list ap; \
+		va_start(ap, format); \
+		log_recorder_vwrite(pContext->recorder, priority, format, ap); \
+		va_end(ap); \
+	}
+
+typedef struct log_async_record_header
+{
+    int64_t timestamp;  //in microseconds, for the merge
+    int length;         //the line length, -1 for skip to the buffer end
+    int padding;
+} LogAsyncRecordHeader;
+
+/* the single producer single consumer ring buffer of the logging thread */
+typedef struct log_async_ring
+{
+    volatile int64_t head;   //advanced by the flusher thread
+    char padding1[64 - sizeof(int64_t)];
+    volatile int64_t tail;   //advanced by the owner thread
+    char padding2[64 - sizeof(int64_t)];
+    volatile int64_t dropped_count;  //changed by the owner thread
+    volatile int64_t blocked_count;  //changed by the owner thread
+    volatile bool closed;    //the owner thread exited
+    int size;
+    int64_t mask;
+    int64_t read_pos;        //the read position of the flusher thread
+    int64_t tail_snapshot;   //the tail of the current flush round
+    char *buff;
+    struct log_async_ring *next;
+} LogAsyncRing;
+
+typedef struct log_async_context
+{
+    LogContext *log_context;
+    int ring_size;
+    int flush_interval_ms;
+    int overflow_policy;
+    volatile bool running;
+    bool lock_held;          //the flusher thread holds log_thread_lock
+    pthread_t flusher_tid;
+    pthread_key_t ring_key;
+    pthread_lock_cond_pair_t lcp;  //for the ring list and the flusher wakeup
+    LogAsyncRing *rings;
+    LogAsyncStats stats;     //include the counters of the freed rings
+    int64_t reported_dropped;
+    char dropped_line[256];
+    struct iovec iov[LOG_ASYNC_IOV_COUNT];
+} LogAsyncContext;
+
 LogContext g_log_context = {LOG_INFO, STDERR_FILENO, NULL};
 
 static int log_fsync(LogContext *pContext, const bool bNeedLock);
+static int log_check_rotate(LogContext *pContext);
+static void log_async_destroy(LogContext *pContext);
 
 static int check_and_mk_log_dir(const char *base_path)
 {
@@ -100,6 +174,8 @@ int log_init_ex(LogContext *pContext)
 	pContext->log_fd = STDERR_FILENO;
 	pContext->time_precision = LOG_TIME_PRECISION_SECOND;
     pContext->compress_log_days_before = 1;
+    pContext->compress_method = FC_COMPRESS_METHOD_GZIP;
+    pContext->compress_level = FC_COMPRESS_DEFAULT_LEVEL;
  	strcpy(pContext->rotate_time_format, "%Y%m%d_%H%M%S");
 
 	pContext->log_buff = (char *)malloc(LOG_BUFF_SIZE);
@@ -155,6 +231,110 @@ static int log_print_header(LogContext *pContext)
     return result;
 }
 
+static void log_get_stream_filename(LogContext *pContext, char *filename,
+        const int size)
+{
+    snprintf(filename, size, "%s%s", pContext->log_filename,
+            LOG_STREAM_EXT_NAME_STR);
+}
+
+static void log_abort_compress_stream(LogContext *pContext)
+{
+    char stream_filename[MAX_PATH_SIZE + 32];
+
+    if (pContext->compress_stream == NULL)
+    {
+        return;
+    }
+
+    fc_compress_stream_abort(pContext->compress_stream);
+    free(pContext->compress_stream);
+    pContext->compress_stream = NULL;
+
+    log_get_stream_filename(pContext, stream_filename,
+            sizeof(stream_filename));
+    unlink(stream_filename);
+}
+
+/* the streaming compression starts with the new log file only,
+ * the appended log file is compressed after rotated */
+static void log_open_compress_stream(LogContext *pContext)
+{
+    char stream_filename[MAX_PATH_SIZE + 32];
+
+    log_abort_compress_stream(pContext);
+    if (!NEED_STREAMING_COMPRESS(pContext))
+    {
+        return;
+    }
+
+    log_get_stream_filename(pContext, stream_filename,
+            sizeof(stream_filename));
+    if (pContext->current_size > 0)
+    {
+        unlink(stream_filename);
+        return;
+    }
+
+    pContext->compress_stream = (struct fc_compress_stream *)
+        malloc(sizeof(struct fc_compress_stream));
+    if (pContext->compress_stream == NULL)
+    {
+        return;
+    }
+    if (fc_compress_stream_open(pContext->compress_stream, stream_filename,
+                pContext->compress_method, pContext->compress_level) != 0)
+    {
+        free(pContext->compress_stream);
+        pContext->compress_stream = NULL;
+    }
+}
+
+/* finish the compressed file of the rotated log file,
+ * remove the rotated log file when success */
+static void log_finish_compress_stream(LogContext *pContext,
+        const char *old_filename)
+{
+    char stream_filename[MAX_PATH_SIZE + 32];
+    char compressed_filename[MAX_PATH_SIZE + 64];
+    int result;
+
+    result = fc_compress_stream_close(pContext->compress_stream);
+    free(pContext->compress_stream);
+    pContext->compress_stream = NULL;
+
+    log_get_stream_filename(pContext, stream_filename,
+            sizeof(stream_filename));
+    if (result != 0)
+    {
+        unlink(stream_filename);
+        return;
+    }
+
+    snprintf(compressed_filename, sizeof(compressed_filename), "%s%s",
+            old_filename, COMPRESS_EXT_NAME(pContext));
+    if (rename(stream_filename, compressed_filename) != 0)
+    {
+		fprintf(stderr, "file: "__FILE__", line: %d, " \
+			"rename %s to %s fail, errno: %d, error info: %s\n", \
+			__LINE__, stream_filename, compressed_filename, \
+			errno, STRERROR(errno));
+        unlink(stream_filename);
+        return;
+    }
+    unlink(old_filename);
+}
+
+static void log_compress_stream_write(LogContext *pContext,
+        const char *buff, const int len)
+{
+    if (fc_compress_stream_write(pContext->compress_stream, buff, len) != 0)
+    {
+        //the log file will be compressed after rotated
+        log_abort_compress_stream(pContext);
+    }
+}
+
 static int log_open(LogContext *pContext)
 {
     int result;
@@ -200,6 +380,7 @@ static int log_open(LogContext *pContext)
 			pContext->log_filename, errno, STRERROR(errno));
 		return errno != 0 ? errno : EACCES;
 	}
+    log_open_compress_stream(pContext);
     if (pContext->current_size == 0 && pContext->print_header_callback != NULL)
     {
         log_print_header(pContext);
@@ -333,6 +514,54 @@ void log_set_compress_log_days_before_ex(LogContext *pContext, const int days_be
     }
 }
 
+int log_set_compress_method_ex(LogContext *pContext, const int method,
+        const int level)
+{
+    if (!fc_compress_method_supported(method))
+    {
+        return EOPNOTSUPP;
+    }
+
+    pContext->compress_method = method;
+    pContext->compress_level = level;
+    return 0;
+}
+
+int log_set_flight_recorder_ex(LogContext *pContext, const int record_level,
+        const LogRecorderConfig *config)
+{
+    LogRecorder *recorder;
+    int result;
+
+    if (pContext->recorder != NULL)
+    {
+        return EEXIST;
+    }
+
+    if ((recorder=(LogRecorder *)malloc(sizeof(LogRecorder))) == NULL)
+    {
+        return ENOMEM;
+    }
+    if ((result=log_recorder_init(recorder, config)) != 0)
+    {
+        free(recorder);
+        return result;
+    }
+
+    pContext->recorder = recorder;
+    __atomic_store_n(&pContext->record_level, record_level, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int log_dump_flight_recorder_ex(LogContext *pContext, const char *filename)
+{
+    if (pContext->recorder == NULL)
+    {
+        return ENOENT;
+    }
+    return log_recorder_dump(pContext->recorder, filename);
+}
+
 void log_set_fd_flags(LogContext *pContext, const int flags)
 {
     pContext->fd_flags = flags;
@@ -340,9 +569,23 @@ void log_set_fd_flags(LogContext *pContext, const int flags)
 
 void log_destroy_ex(LogContext *pContext)
 {
+	if (pContext->async != NULL)
+	{
+		log_async_destroy(pContext);
+	}
+
+	if (pContext->recorder != NULL)
+	{
+		pContext->record_level = 0;
+		log_recorder_destroy(pContext->recorder);
+		free(pContext->recorder);
+		pContext->recorder = NULL;
+	}
+
 	if (pContext->log_fd >= 0 && pContext->log_fd != STDERR_FILENO)
 	{
 		log_fsync(pContext, true);
+        log_abort_compress_stream(pContext);
 
 		close(pContext->log_fd);
 		pContext->log_fd = STDERR_FILENO;
@@ -365,6 +608,10 @@ int log_sync_func(void *args)
 		return EINVAL;
 	}
 
+	if (((LogContext *)args)->async != NULL)
+	{
+		pthread_cond_signal(&((LogContext *)args)->async->lcp.cond);
+	}
 	return log_fsync((LogContext *)args, true);
 }
 
@@ -386,7 +633,7 @@ static int log_delete_old_file(LogContext *pContext,
     if (NEED_COMPRESS_LOG(pContext->compress_log_flags))
     {
         snprintf(full_filename, sizeof(full_filename), "%s%s",
-                old_filename, GZIP_EXT_NAME_STR);
+                old_filename, COMPRESS_EXT_NAME(pContext));
     }
     else
     {
@@ -725,6 +972,51 @@ int log_delete_old_files(void *args)
     }
 }
 
+static bool log_is_compressed_file(const char *filename)
+{
+    const char *exts[] = {GZIP_EXT_NAME_STR, FC_COMPRESS_ZSTD_EXT_STR,
+        FC_COMPRESS_TMP_EXT_STR};
+    int len;
+    int ext_len;
+    int i;
+
+    len = strlen(filename);
+    for (i=0; i<sizeof(exts) / sizeof(exts[0]); i++)
+    {
+        ext_len = strlen(exts[i]);
+        if (len > ext_len && memcmp(filename + len - ext_len,
+                    exts[i], ext_len) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int log_compress_file(LogContext *pContext, const char *filename)
+{
+    char compressed_filename[MAX_PATH_SIZE + 64];
+    int result;
+
+    //compress by the throttled worker thread instead of the gzip process
+    if (COMPRESS_IN_NEW_THREAD(pContext->compress_log_flags))
+    {
+        result = fc_compress_worker_submit_ex(filename,
+                pContext->compress_method, pContext->compress_level);
+        return (result == EEXIST) ? 0 : result;
+    }
+
+    snprintf(compressed_filename, sizeof(compressed_filename), "%s%s",
+            filename, COMPRESS_EXT_NAME(pContext));
+    if ((result=fc_compress_file(filename, compressed_filename,
+                    pContext->compress_method, pContext->compress_level,
+                    NULL)) == 0)
+    {
+        unlink(filename);
+    }
+    return result;
+}
+
 static void *log_gzip_func(void *args)
 {
     LogContext *pContext;
@@ -751,17 +1043,23 @@ static void *log_gzip_func(void *args)
     log_get_file_path(pContext, log_filepath);
     for (i=0; i<filename_array.count; i++)
     {
-        int len;
-        len = strlen(filename_array.filenames[i]);
-        if ((len > GZIP_EXT_NAME_LEN) && memcmp(filename_array.filenames[i]
-                    + len - GZIP_EXT_NAME_LEN, GZIP_EXT_NAME_STR,
-                    GZIP_EXT_NAME_LEN) == 0)
+        //skip the compressed and the compressing files
+        if (log_is_compressed_file(filename_array.filenames[i]))
         {
             continue;
         }
 
         snprintf(full_filename, sizeof(full_filename), "%s%s",
                 log_filepath, filename_array.filenames[i]);
+        if (COMPRESS_BUILTIN(pContext))
+        {
+            if (log_compress_file(pContext, full_filename) == EAGAIN)
+            {
+                break;  //the queue is full, retry at the next rotation
+            }
+            continue;
+        }
+
         snprintf(cmd, sizeof(cmd), "%s %s",
                 get_gzip_command_filename(), full_filename);
 
@@ -788,7 +1086,8 @@ static void *log_gzip_func(void *args)
 
 static void log_gzip(LogContext *pContext)
 {
-    if (COMPRESS_IN_NEW_THREAD(pContext->compress_log_flags))
+    if (COMPRESS_IN_NEW_THREAD(pContext->compress_log_flags) &&
+            !COMPRESS_BUILTIN(pContext))
     {
         int result;
         pthread_t tid;
@@ -814,7 +1113,7 @@ static void log_gzip(LogContext *pContext)
     }
 }
 
-int log_rotate(LogContext *pContext)
+static int log_rotate_file(LogContext *pContext)
 {
 	struct tm tm;
 	time_t current_time;
@@ -822,6 +1121,7 @@ int log_rotate(LogContext *pContext)
     int result;
 	char old_filename[MAX_PATH_SIZE + 32];
     bool exist;
+    bool renamed;
 
 	if (*(pContext->log_filename) == '\0')
 	{
@@ -852,6 +1152,7 @@ int log_rotate(LogContext *pContext)
 			"file: %s already exist, rotate file fail\n",
 			__LINE__, old_filename);
         exist = true;
+        renamed = false;
     }
     else if (rename(pContext->log_filename, old_filename) != 0)
 	{
@@ -860,10 +1161,24 @@ int log_rotate(LogContext *pContext)
 			__LINE__, pContext->log_filename, old_filename, \
 			errno, STRERROR(errno));
         exist = false;
+        renamed = false;
 	}
     else
     {
         exist = true;
+        renamed = true;
+    }
+
+    if (pContext->compress_stream != NULL)
+    {
+        if (renamed)
+        {
+            log_finish_compress_stream(pContext, old_filename);
+        }
+        else
+        {
+            log_abort_compress_stream(pContext);
+        }
     }
 
 	result = log_open(pContext);
@@ -876,6 +1191,22 @@ int log_rotate(LogContext *pContext)
     return result;
 }
 
+int log_rotate(LogContext *pContext)
+{
+    int result;
+
+    if (pContext->async == NULL)
+    {
+        return log_rotate_file(pContext);
+    }
+
+    //the flusher thread writes the log file with the lock
+    pthread_mutex_lock(&(pContext->log_thread_lock));
+    result = log_rotate_file(pContext);
+    pthread_mutex_unlock(&(pContext->log_thread_lock));
+    return result;
+}
+
 static int log_check_rotate(LogContext *pContext)
 {
 	if (pContext->log_fd == STDERR_FILENO)
@@ -890,7 +1221,7 @@ static int log_check_rotate(LogContext *pContext)
 	if (pContext->rotate_immediately)
 	{
 		pContext->rotate_immediately = false;
-		return log_rotate(pContext);
+		return log_rotate_file(pContext);
 	}
 
 	return 0;
@@ -945,6 +1276,10 @@ static int log_fsync(LogContext *pContext, const bool bNeedLock)
 	}
 
 	result = 0;
+    if (pContext->compress_stream != NULL)
+    {
+        log_compress_stream_write(pContext, pContext->log_buff, write_bytes);
+    }
     written = write(pContext->log_fd, pContext->log_buff, write_bytes);
 	pContext->pcurrent_buff = pContext->log_buff;
 	if (written != write_bytes)
@@ -972,29 +1307,563 @@ static int log_fsync(LogContext *pContext, const bool bNeedLock)
 	return result;
 }
 
-static void doLogEx(LogContext *pContext, struct timeval *tv, \
-		const char *caption, const char *text, const int text_len, \
-		const bool bNeedSync, const bool bNeedLock)
+static int log_format_prefix(LogContext *pContext, struct timeval *tv,
+        const char *caption, char *buff)
 {
 	struct tm tm;
 	int time_fragment;
-	int buff_len;
-	int result;
+	char *p;
+
+	p = buff;
+    if (pContext->time_precision != LOG_TIME_PRECISION_NONE)
+    {
+        localtime_r(&tv->tv_sec, &tm);
+        if (pContext->time_precision == LOG_TIME_PRECISION_SECOND)
+        {
+            p += sprintf(p, "[%04d-%02d-%02d %02d:%02d:%02d] ", \
+                    tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, \
+                    tm.tm_hour, tm.tm_min, tm.tm_sec);
+        }
+        else
+        {
+            if (pContext->time_precision == LOG_TIME_PRECISION_MSECOND)
+            {
+                time_fragment = tv->tv_usec / 1000;
+            }
+            else
+            {
+                time_fragment = tv->tv_usec;
+            }
+            p += sprintf(p, "[%04d-%02d-%02d %02d:%02d:%02d.%03d] ", \
+                    tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, \
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, time_fragment);
+        }
+    }
 
-	if ((pContext->time_precision == LOG_TIME_PRECISION_SECOND)
-            || (pContext->time_precision == LOG_TIME_PRECISION_NONE))
+	if (caption != NULL)
 	{
-		time_fragment = 0;
+		p += sprintf(p, "%s - ", caption);
 	}
-	else
+
+	return p - buff;
+}
+
+static LogAsyncRing *log_async_get_ring(LogAsyncContext *async)
+{
+    LogAsyncRing *ring;
+
+    if ((ring=(LogAsyncRing *)pthread_getspecific(async->ring_key)) != NULL)
+    {
+        return ring;
+    }
+
+    ring = (LogAsyncRing *)calloc(1, sizeof(LogAsyncRing));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    if ((ring->buff=(char *)malloc(async->ring_size)) == NULL)
+    {
+        free(ring);
+        return NULL;
+    }
+    ring->size = async->ring_size;
+    ring->mask = async->ring_size - 1;
+    if (pthread_setspecific(async->ring_key, ring) != 0)
+    {
+        free(ring->buff);
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    ring->next = async->rings;
+    async->rings = ring;
+    pthread_mutex_unlock(&async->lcp.lock);
+    return ring;
+}
+
+static void log_async_ring_destructor(void *arg)
+{
+    //the flusher thread frees the ring after all records written
+    __atomic_store_n(&((LogAsyncRing *)arg)->closed, true, __ATOMIC_RELEASE);
+}
+
+/* return 0 for appended or dropped, != 0 for the caller to log in sync mode */
+static int log_async_append(LogContext *pContext, struct timeval *tv,
+		const char *caption, const char *text, const int text_len,
+		const bool bNeedSync)
+{
+    LogAsyncContext *async;
+    LogAsyncRing *ring;
+    LogAsyncRecordHeader *header;
+    int64_t tail;
+    int64_t used;
+    int reserve;
+    int contiguous;
+    int need;
+    int len;
+    bool blocked;
+
+    async = pContext->async;
+    reserve = LOG_ASYNC_ALIGN(sizeof(LogAsyncRecordHeader) +
+            LOG_ASYNC_MAX_PREFIX_LEN + text_len + 1);
+    if (reserve > async->ring_size / 4)
+    {
+        return E2BIG;
+    }
+    if ((ring=log_async_get_ring(async)) == NULL)
+    {
+        return ENOMEM;
+    }
+
+    tail = ring->tail;
+    contiguous = ring->size - (tail & ring->mask);
+    need = (reserve > contiguous) ? contiguous + reserve : reserve;
+    blocked = false;
+    while ((used=tail - __atomic_load_n(&ring->head,
+                    __ATOMIC_ACQUIRE)) + need > ring->size)
+    {
+        if (async->overflow_policy != LOG_ASYNC_OVERFLOW_BLOCK ||
+                !async->running)
+        {
+            __atomic_store_n(&ring->dropped_count,
+                    ring->dropped_count + 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+
+        if (!blocked)
+        {
+            blocked = true;
+            __atomic_store_n(&ring->blocked_count,
+                    ring->blocked_count + 1, __ATOMIC_RELAXED);
+        }
+        pthread_cond_signal(&async->lcp.cond);
+        usleep(100);
+    }
+
+    if (reserve > contiguous)
+    {
+        header = (LogAsyncRecordHeader *)(ring->buff + (tail & ring->mask));
+        header->length = -1;
+        tail += contiguous;
+    }
+
+    header = (LogAsyncRecordHeader *)(ring->buff + (tail & ring->mask));
+    len = log_format_prefix(pContext, tv, caption, (char *)(header + 1));
+    memcpy((char *)(header + 1) + len, text, text_len);
+    len += text_len;
+    *((char *)(header + 1) + len++) = '\n';
+    header->timestamp = get_current_time_us();
+    header->length = len;
+    __atomic_store_n(&ring->tail, tail + LOG_ASYNC_ALIGN(
+                sizeof(LogAsyncRecordHeader) + len), __ATOMIC_RELEASE);
+
+    if (bNeedSync || used + need > ring->size / 2)
+    {
+        pthread_cond_signal(&async->lcp.cond);
+    }
+    return 0;
+}
+
+static int log_writev(LogContext *pContext, struct iovec *iov,
+        int iovcnt, const int write_bytes)
+{
+    int result;
+    ssize_t written;
+
+    result = 0;
+    pthread_mutex_lock(&(pContext->log_thread_lock));
+    pContext->async->lock_held = true;
+	if (pContext->rotate_size > 0 && pContext->current_size +
+            write_bytes > pContext->rotate_size)
 	{
-		if (pContext->time_precision == LOG_TIME_PRECISION_MSECOND)
+        pContext->rotate_immediately = true;
+        log_check_rotate(pContext);
+	}
+    //count after the rotation which resets the size for the new file
+    pContext->current_size += write_bytes;
+
+    if (pContext->compress_stream != NULL &&
+            fc_compress_stream_writev(pContext->compress_stream,
+                iov, iovcnt) != 0)
+    {
+        log_abort_compress_stream(pContext);
+    }
+    while (iovcnt > 0)
+    {
+        if ((written=writev(pContext->log_fd, iov, iovcnt)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            result = errno != 0 ? errno : EIO;
+            fprintf(stderr, "file: "__FILE__", line: %d, "
+                    "pid: %d, call writev fail, fd: %d, errno: %d, "
+                    "error info: %s\n", __LINE__, getpid(),
+                    pContext->log_fd, result, STRERROR(result));
+            break;
+        }
+
+        //skip the written iovecs for the partial write
+        while (iovcnt > 0 && written >= (ssize_t)iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+	if (pContext->rotate_immediately)
+	{
+		log_check_rotate(pContext);
+	}
+    pContext->async->lock_held = false;
+    pthread_mutex_unlock(&(pContext->log_thread_lock));
+    return result;
+}
+
+static inline LogAsyncRecordHeader *log_async_peek(LogAsyncRing *ring)
+{
+    LogAsyncRecordHeader *header;
+
+    while (ring->read_pos < ring->tail_snapshot)
+    {
+        header = (LogAsyncRecordHeader *)(ring->buff +
+                (ring->read_pos & ring->mask));
+        if (header->length >= 0)
+        {
+            return header;
+        }
+
+        //skip the padding to the buffer end
+        ring->read_pos += ring->size - (ring->read_pos & ring->mask);
+    }
+
+    return NULL;
+}
+
+static void log_async_commit(LogAsyncRing *rings)
+{
+    LogAsyncRing *ring;
+
+    for (ring=rings; ring!=NULL; ring=ring->next)
+    {
+        if (ring->head != ring->read_pos)
+        {
+            __atomic_store_n(&ring->head, ring->read_pos, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/* merge the records of the rings in timestamp order and write them,
+ * return the written message count.
+ * the lock is NOT held when writing and rotating because the logging in
+ * the header callback calls log_async_get_ring which acquires the lock.
+ * the new rings are inserted before the list head and only this thread
+ * removes the rings, so the list from the snapshot head is stable */
+static int log_async_flush(LogAsyncContext *async)
+{
+    LogContext *pContext;
+    LogAsyncRing *rings;
+    LogAsyncRing *ring;
+    LogAsyncRing **pprev;
+    LogAsyncRecordHeader *header;
+    LogAsyncRecordHeader *best;
+    LogAsyncRing *best_ring;
+    struct timeval tv;
+    int64_t dropped;
+    int64_t total_bytes;
+    int message_count;
+    int write_bytes;
+    int iovcnt;
+    bool closed;
+
+    pContext = async->log_context;
+    message_count = 0;
+    total_bytes = 0;
+    write_bytes = 0;
+    iovcnt = 0;
+
+    pthread_mutex_lock(&async->lcp.lock);
+    rings = async->rings;
+    dropped = async->stats.dropped_count;
+    pthread_mutex_unlock(&async->lcp.lock);
+
+    for (ring=rings; ring!=NULL; ring=ring->next)
+    {
+        ring->tail_snapshot = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        ring->read_pos = ring->head;
+        dropped += __atomic_load_n(&ring->dropped_count, __ATOMIC_RELAXED);
+    }
+
+    if (async->overflow_policy == LOG_ASYNC_OVERFLOW_COUNT &&
+            dropped > async->reported_dropped)
+    {
+        gettimeofday(&tv, NULL);
+        write_bytes = log_format_prefix(pContext, &tv, "WARNING",
+                async->dropped_line);
+        write_bytes += sprintf(async->dropped_line + write_bytes,
+                "the async logger dropped %"PRId64" messages "
+                "for the full ring buffers\n",
+                dropped - async->reported_dropped);
+        async->iov[iovcnt].iov_base = async->dropped_line;
+        async->iov[iovcnt].iov_len = write_bytes;
+        iovcnt++;
+        async->reported_dropped = dropped;
+    }
+
+    while (1)
+    {
+        best = NULL;
+        best_ring = NULL;
+        for (ring=rings; ring!=NULL; ring=ring->next)
+        {
+            if ((header=log_async_peek(ring)) != NULL && (best == NULL ||
+                        header->timestamp < best->timestamp))
+            {
+                best = header;
+                best_ring = ring;
+            }
+        }
+        if (best == NULL)
+        {
+            break;
+        }
+
+        async->iov[iovcnt].iov_base = best + 1;
+        async->iov[iovcnt].iov_len = best->length;
+        iovcnt++;
+        write_bytes += best->length;
+        message_count++;
+        best_ring->read_pos += LOG_ASYNC_ALIGN(
+                sizeof(LogAsyncRecordHeader) + best->length);
+
+        if (iovcnt == LOG_ASYNC_IOV_COUNT)
+        {
+            log_writev(pContext, async->iov, iovcnt, write_bytes);
+            log_async_commit(rings);
+            total_bytes += write_bytes;
+            iovcnt = 0;
+            write_bytes = 0;
+        }
+    }
+
+    if (iovcnt > 0)
+    {
+        log_writev(pContext, async->iov, iovcnt, write_bytes);
+        log_async_commit(rings);
+        total_bytes += write_bytes;
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    async->stats.write_bytes += total_bytes;
+    async->stats.message_count += message_count;
+
+    //free the rings of the exited threads
+    pprev = &async->rings;
+    while ((ring=*pprev) != NULL)
+    {
+        closed = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+        if (closed && ring->head == __atomic_load_n(
+                    &ring->tail, __ATOMIC_ACQUIRE))
+        {
+            *pprev = ring->next;
+            async->stats.dropped_count += ring->dropped_count;
+            async->stats.blocked_count += ring->blocked_count;
+            free(ring->buff);
+            free(ring);
+        }
+        else
+        {
+            pprev = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&async->lcp.lock);
+
+    if (message_count == 0 && pContext->rotate_immediately)
+    {
+        pthread_mutex_lock(&(pContext->log_thread_lock));
+        async->lock_held = true;
+        log_check_rotate(pContext);
+        async->lock_held = false;
+        pthread_mutex_unlock(&(pContext->log_thread_lock));
+    }
+
+    return message_count;
+}
+
+static void *log_async_flusher_func(void *arg)
+{
+    LogAsyncContext *async;
+    struct timespec ts;
+    int64_t expire_us;
+
+    async = (LogAsyncContext *)arg;
+    while (async->running)
+    {
+        if (log_async_flush(async) > 0)
+        {
+            continue;
+        }
+
+        expire_us = get_current_time_us() + async->flush_interval_ms * 1000;
+        ts.tv_sec = expire_us / 1000000;
+        ts.tv_nsec = (expire_us % 1000000) * 1000;
+        pthread_mutex_lock(&async->lcp.lock);
+        if (async->running)
+        {
+            pthread_cond_timedwait(&async->lcp.cond, &async->lcp.lock, &ts);
+        }
+        pthread_mutex_unlock(&async->lcp.lock);
+    }
+
+    while (log_async_flush(async) > 0)
+    {
+    }
+    return NULL;
+}
+
+int log_set_async_ex(LogContext *pContext, const int ring_size,
+        const int flush_interval_ms, const int overflow_policy)
+{
+    LogAsyncContext *async;
+    int result;
+
+    if (pContext->async != NULL)
+    {
+        return EEXIST;
+    }
+    if (overflow_policy != LOG_ASYNC_OVERFLOW_BLOCK &&
+            overflow_policy != LOG_ASYNC_OVERFLOW_DROP &&
+            overflow_policy != LOG_ASYNC_OVERFLOW_COUNT)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "invalid overflow policy: %d\n", __LINE__, overflow_policy);
+        return EINVAL;
+    }
+
+    async = (LogAsyncContext *)calloc(1, sizeof(LogAsyncContext));
+    if (async == NULL)
+    {
+        return ENOMEM;
+    }
+
+    async->log_context = pContext;
+    async->ring_size = LOG_ASYNC_MIN_RING_SIZE;
+    while (async->ring_size < ring_size)
+    {
+        async->ring_size *= 2;
+    }
+    async->flush_interval_ms = flush_interval_ms > 0 ?
+        flush_interval_ms : LOG_ASYNC_DEFAULT_FLUSH_INTERVAL;
+    async->overflow_policy = overflow_policy;
+    async->running = true;
+
+    if ((result=init_pthread_lock_cond_pair(&async->lcp)) != 0)
+    {
+        free(async);
+        return result;
+    }
+    if ((result=pthread_key_create(&async->ring_key,
+                    log_async_ring_destructor)) != 0)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "pthread_key_create fail, errno: %d, error info: %s\n",
+                __LINE__, result, STRERROR(result));
+        destroy_pthread_lock_cond_pair(&async->lcp);
+        free(async);
+        return result;
+    }
+    if ((result=pthread_create(&async->flusher_tid, NULL,
+                    log_async_flusher_func, async)) != 0)
+    {
+        fprintf(stderr, "file: "__FILE__", line: %d, "
+                "create thread failed, errno: %d, error info: %s\n",
+                __LINE__, result, STRERROR(result));
+        pthread_key_delete(async->ring_key);
+        destroy_pthread_lock_cond_pair(&async->lcp);
+        free(async);
+        return result;
+    }
+
+    log_fsync(pContext, true);
+    __atomic_store_n(&pContext->async, async, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int log_get_async_stats(LogContext *pContext, LogAsyncStats *stats)
+{
+    LogAsyncContext *async;
+    LogAsyncRing *ring;
+
+    if ((async=pContext->async) == NULL)
+    {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock(&async->lcp.lock);
+    *stats = async->stats;
+    for (ring=async->rings; ring!=NULL; ring=ring->next)
+    {
+        stats->dropped_count += ring->dropped_count;
+        stats->blocked_count += ring->blocked_count;
+    }
+    pthread_mutex_unlock(&async->lcp.lock);
+    return 0;
+}
+
+static void log_async_destroy(LogContext *pContext)
+{
+    LogAsyncContext *async;
+    LogAsyncRing *ring;
+
+    async = pContext->async;
+    pthread_mutex_lock(&async->lcp.lock);
+    async->running = false;
+    pthread_cond_signal(&async->lcp.cond);
+    pthread_mutex_unlock(&async->lcp.lock);
+    pthread_join(async->flusher_tid, NULL);
+
+    __atomic_store_n(&pContext->async, NULL, __ATOMIC_RELEASE);
+    pthread_key_delete(async->ring_key);
+    while ((ring=async->rings) != NULL)
+    {
+        async->rings = ring->next;
+        free(ring->buff);
+        free(ring);
+    }
+    destroy_pthread_lock_cond_pair(&async->lcp);
+    free(async);
+}
+
+static void doLogEx(LogContext *pContext, struct timeval *tv, \
+		const char *caption, const char *text, const int text_len, \
+		const bool bNeedSync, bool bNeedLock)
+{
+	int result;
+
+	if (bNeedLock && pContext->async != NULL)
+	{
+		if (pthread_equal(pthread_self(), pContext->async->flusher_tid))
 		{
-			time_fragment = tv->tv_usec / 1000;
+			/* the flusher thread (such as the rotate header callback)
+			 * logs in sync mode because its own ring can't be drained */
+			if (pContext->async->lock_held)
+			{
+				bNeedLock = false;  //already locked by this thread
+			}
 		}
-		else
+		else if (log_async_append(pContext, tv, caption, text,
+                    text_len, bNeedSync) == 0)
 		{
-			time_fragment = tv->tv_usec;
+			return;
 		}
 	}
 
@@ -1024,31 +1893,8 @@ static void doLogEx(LogContext *pContext, struct timeval *tv, \
 		log_fsync(pContext, false);
 	}
 
-    if (pContext->time_precision != LOG_TIME_PRECISION_NONE)
-    {
-        localtime_r(&tv->tv_sec, &tm);
-        if (pContext->time_precision == LOG_TIME_PRECISION_SECOND)
-        {
-            buff_len = sprintf(pContext->pcurrent_buff, \
-                    "[%04d-%02d-%02d %02d:%02d:%02d] ", \
-                    tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, \
-                    tm.tm_hour, tm.tm_min, tm.tm_sec);
-        }
-        else
-        {
-            buff_len = sprintf(pContext->pcurrent_buff, \
-                    "[%04d-%02d-%02d %02d:%02d:%02d.%03d] ", \
-                    tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, \
-                    tm.tm_hour, tm.tm_min, tm.tm_sec, time_fragment);
-        }
-        pContext->pcurrent_buff += buff_len;
-    }
-
-	if (caption != NULL)
-	{
-		buff_len = sprintf(pContext->pcurrent_buff, "%s - ", caption);
-		pContext->pcurrent_buff += buff_len;
-	}
+	pContext->pcurrent_buff += log_format_prefix(pContext, tv,
+            caption, pContext->pcurrent_buff);
 	memcpy(pContext->pcurrent_buff, text, text_len);
 	pContext->pcurrent_buff += text_len;
 	*pContext->pcurrent_buff++ = '\n';
@@ -1086,6 +1932,13 @@ void log_it_ex2(LogContext *pContext, const char *caption, \
 	doLogEx(pContext, &tv, caption, text, text_len, bNeedSync, bNeedLock);
 }
 
+void log_it_ex3(LogContext *pContext, struct timeval *tv, \
+		const char *caption, const char *text, const int text_len, \
+		const bool bNeedSync, const bool bNeedLock)
+{
+	doLogEx(pContext, tv, caption, text, text_len, bNeedSync, bNeedLock);
+}
+
 void log_it_ex1(LogContext *pContext, const int priority, \
 		const char *text, const int text_len)
 {
@@ -1140,6 +1993,76 @@ void log_it_ex1(LogContext *pContext, const int priority, \
 	log_it_ex2(pContext, caption, text, text_len, bNeedSync, true);
 }
 
+static int log_rate_limit_suppress(LogRateLimit *limit,
+        const int64_t current_time, int64_t *suppressed)
+{
+    int64_t next_time;
+
+    __sync_add_and_fetch(&limit->suppressed, 1);
+    next_time = __atomic_load_n(&limit->next_summary_time, __ATOMIC_RELAXED);
+    if (next_time == 0) {  //the first suppression starts the summary timer
+        __sync_bool_compare_and_swap(&limit->next_summary_time, 0,
+                current_time + LOG_RATE_LIMIT_SUMMARY_INTERVAL);
+        return LOG_RATE_LIMIT_DROP;
+    }
+    if (current_time < next_time) {
+        return LOG_RATE_LIMIT_DROP;
+    }
+
+    //only one thread wins to log the summary and advances the summary time
+    if (!__sync_bool_compare_and_swap(&limit->next_summary_time, next_time,
+                current_time + LOG_RATE_LIMIT_SUMMARY_INTERVAL))
+    {
+        return LOG_RATE_LIMIT_DROP;
+    }
+
+    *suppressed = __atomic_load_n(&limit->suppressed, __ATOMIC_RELAXED);
+    __sync_sub_and_fetch(&limit->suppressed, *suppressed);
+    return LOG_RATE_LIMIT_SUMMARY;
+}
+
+int log_rate_limit_check(LogRateLimit *limit, int64_t *suppressed)
+{
+    int64_t current_time;
+    int64_t interval;
+    int64_t tolerance;
+    int64_t tat;
+    int64_t new_tat;
+
+    *suppressed = 0;
+    if (limit->sample > 1 && __sync_fetch_and_add(&limit->counter, 1) %
+            limit->sample != 0)
+    {
+        return LOG_RATE_LIMIT_DROP;
+    }
+
+    if (limit->rate > 0) {
+        current_time = get_current_time_us();
+        interval = 1000000 / limit->rate;
+        tolerance = (int64_t)(limit->burst > 0 ? limit->burst :
+                limit->rate) * interval;
+        while (1) {
+            tat = __atomic_load_n(&limit->tat, __ATOMIC_RELAXED);
+            new_tat = (tat > current_time ? tat : current_time) + interval;
+            if (new_tat - current_time > tolerance) {
+                return log_rate_limit_suppress(limit,
+                        current_time, suppressed);
+            }
+            if (__sync_bool_compare_and_swap(&limit->tat, tat, new_tat)) {
+                break;
+            }
+        }
+    }
+
+    if (__atomic_load_n(&limit->suppressed, __ATOMIC_RELAXED) > 0) {
+        *suppressed = __atomic_load_n(&limit->suppressed, __ATOMIC_RELAXED);
+        __sync_sub_and_fetch(&limit->suppressed, *suppressed);
+        //the suppression ended, the next one restarts the summary timer
+        __atomic_store_n(&limit->next_summary_time, 0, __ATOMIC_RELAXED);
+    }
+    return LOG_RATE_LIMIT_PASS;
+}
+
 void log_it_ex(LogContext *pContext, const int priority, const char *format, ...)
 {
 	bool bNeedSync;
@@ -1150,6 +2073,7 @@ void log_it_ex(LogContext *pContext, const int priority, const char *format, ...
 
 	if (pContext->log_level < priority)
 	{
+		LOG_RECORD_VA_ARGS(pContext, priority)
 		return;
 	}
 
@@ -1211,6 +2135,7 @@ void log_it_ex(LogContext *pContext, const int priority, const char *format, ...
 \
 	if (pContext->log_level < priority) \
 	{ \
+		LOG_RECORD_VA_ARGS(pContext, priority) \
 		return; \
 	} \
 \
@@ -1286,10 +2211,15 @@ void logAccess(LogContext *pContext, struct timeval *tvStart, \
 }
 
 const char *log_get_level_caption_ex(LogContext *pContext)
+{
+    return log_get_priority_caption(pContext->log_level);
+}
+
+const char *log_get_priority_caption(const int priority)
 {
 	const char *caption;
 
-	switch (pContext->log_level)
+	switch (priority)
 	{
 		case LOG_DEBUG:
 			caption = "DEBUG";
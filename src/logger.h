@@ -20,6 +20,8 @@
 #include <syslog.h>
 #include <sys/time.h>
 #include "common_define.h"
+#include "fc_compress.h"
+#include "log_recorder.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,16 +37,55 @@ extern "C" {
 #define LOG_COMPRESS_FLAGS_NONE       0
 #define LOG_COMPRESS_FLAGS_ENABLED    1
 #define LOG_COMPRESS_FLAGS_NEW_THREAD 2
+#define LOG_COMPRESS_FLAGS_STREAMING  4  //compress the log file while writing
 
 #define LOG_NOTHING    (LOG_DEBUG + 10)
 
+//the overflow policy of the async mode when the ring buffer is full
+#define LOG_ASYNC_OVERFLOW_BLOCK  'b'  //wait for the flusher thread
+#define LOG_ASYNC_OVERFLOW_DROP   'd'  //drop the message silently
+#define LOG_ASYNC_OVERFLOW_COUNT  'c'  //drop and log the dropped count
+
+#define LOG_ASYNC_DEFAULT_RING_SIZE       (256 * 1024)
+#define LOG_ASYNC_DEFAULT_FLUSH_INTERVAL  10   //milliseconds
+
 struct log_context;
+struct log_async_context;
+
+typedef struct log_async_stats
+{
+    int64_t message_count;  //the written messages
+    int64_t write_bytes;
+    int64_t dropped_count;
+    int64_t blocked_count;  //the times of waiting for the ring buffer
+} LogAsyncStats;
+
+//the result of log_rate_limit_check
+#define LOG_RATE_LIMIT_DROP     0
+#define LOG_RATE_LIMIT_PASS     1
+#define LOG_RATE_LIMIT_SUMMARY  2
+
+//the interval of the suppressed summary in microseconds
+#define LOG_RATE_LIMIT_SUMMARY_INTERVAL  (10 * 1000 * 1000)
+
+//the per call site rate limit state, see log_rate_limit_ex
+typedef struct log_rate_limit
+{
+    int rate;      //the messages per second, 0 for no limit
+    int burst;     //the max burst messages, 0 for the same as rate
+    int sample;    //log 1 in N messages, 0 or 1 for all
+    volatile int64_t tat;   //the theoretical arrival time of GCRA in us
+    volatile int64_t counter;      //for sampling
+    volatile int64_t suppressed;   //the suppressed count by the rate limit
+    volatile int64_t next_summary_time;  //in us
+} LogRateLimit;
 
 //log header line callback
 typedef void (*LogHeaderCallback)(struct log_context *pContext);
 
 #define FC_LOG_BY_LEVEL(level) \
-    (level <= g_log_context.log_level)
+    (level <= g_log_context.log_level || \
+     level <= g_log_context.record_level)
 
 typedef struct log_context
 {
@@ -118,6 +159,31 @@ typedef struct log_context
      * compress the log files before N days
      * */
     int compress_log_days_before;
+
+    /*
+     * the async mode context, NULL for the sync mode
+     * */
+    struct log_async_context *async;
+
+    /*
+     * the in-process compress method and level, see fc_compress.h
+     * */
+    int compress_method;
+    int compress_level;
+
+    /*
+     * compress the current log file while it is being written,
+     * NULL for the streaming compression disabled
+     * */
+    struct fc_compress_stream *compress_stream;
+
+    /*
+     * the flight recorder: the messages below the log level and
+     * not above the record level are kept in the memory rings
+     * NULL for the flight recorder disabled
+     * */
+    int record_level;
+    struct log_recorder *recorder;
 } LogContext;
 
 extern LogContext g_log_context;
@@ -163,6 +229,12 @@ int log_init2();
     log_set_compress_log_flags_ex(&g_log_context, flags)
 #define log_set_compress_log_days_before(days_before) \
     log_set_compress_log_days_before_ex(&g_log_context, days_before)
+#define log_set_compress_method(method, level) \
+    log_set_compress_method_ex(&g_log_context, method, level)
+#define log_set_flight_recorder(record_level, config) \
+    log_set_flight_recorder_ex(&g_log_context, record_level, config)
+#define log_dump_flight_recorder(filename) \
+    log_dump_flight_recorder_ex(&g_log_context, filename)
 
 #define log_set_use_file_write_lock(use_lock)  \
     log_set_use_file_write_lock_ex(&g_log_context, use_lock)
@@ -170,6 +242,10 @@ int log_init2();
 #define log_header(pContext, header, header_len) \
     log_it_ex2(pContext, NULL, header, header_len, false, false)
 
+#define log_set_async(ring_size, overflow_policy) \
+    log_set_async_ex(&g_log_context, ring_size, \
+            LOG_ASYNC_DEFAULT_FLUSH_INTERVAL, overflow_policy)
+
 #define log_destroy()  log_destroy_ex(&g_log_context)
 
 #define log_it1(priority, text, text_len) \
@@ -308,6 +384,62 @@ void log_set_compress_log_flags_ex(LogContext *pContext, const short flags);
 */
 void log_set_compress_log_days_before_ex(LogContext *pContext, const int days_before);
 
+/** set the in-process compress method, the gzip command is used
+ *  when the library is built without zlib
+ *  parameters:
+ *           pContext: the log context
+ *           method: FC_COMPRESS_METHOD_GZIP or FC_COMPRESS_METHOD_ZSTD
+ *           level: the compress level, FC_COMPRESS_DEFAULT_LEVEL for default
+ *  return: 0 for success, EOPNOTSUPP for the method not built in
+*/
+int log_set_compress_method_ex(LogContext *pContext, const int method,
+        const int level);
+
+/** enable the flight recorder: the messages below the log level are
+ *  recorded into the per thread rings of the memory without lock as the
+ *  format and the encoded args, formatted and dumped by log_dump_flight_recorder_ex or the signals
+ *  (see log_recorder_set_dump_signal and log_recorder_set_crash_dump)
+ *  parameters:
+ *           pContext: the log context
+ *           record_level: the max level to record, such as LOG_DEBUG
+ *           config: the recorder config, NULL for the default
+ *  return: 0 for success, != 0 fail, EEXIST for already enabled
+*/
+int log_set_flight_recorder_ex(LogContext *pContext, const int record_level,
+        const LogRecorderConfig *config);
+
+/** dump the messages of the flight recorder, append to the file
+ *  parameters:
+ *           pContext: the log context
+ *           filename: the dump filename
+ *  return: 0 for success, != 0 fail, ENOENT for the recorder disabled
+*/
+int log_dump_flight_recorder_ex(LogContext *pContext, const char *filename);
+
+/** enable the async mode: the logging threads format the messages into
+ *  their own ring buffers without lock, and a flusher thread merges the
+ *  ring buffers in timestamp order and writes them by writev.
+ *  the messages logged with bNeedLock false (such as the header lines)
+ *  are still written in the sync mode.
+ *  parameters:
+ *           pContext: the log context
+ *           ring_size: the ring buffer size of every thread
+ *           flush_interval_ms: the max interval to flush in milliseconds
+ *           overflow_policy: LOG_ASYNC_OVERFLOW_BLOCK, LOG_ASYNC_OVERFLOW_DROP
+ *                            or LOG_ASYNC_OVERFLOW_COUNT
+ *  return: 0 for success, != 0 fail
+*/
+int log_set_async_ex(LogContext *pContext, const int ring_size,
+        const int flush_interval_ms, const int overflow_policy);
+
+/** get the stats of the async mode
+ *  parameters:
+ *           pContext: the log context
+ *           stats: store the stats
+ *  return: 0 for success, ENOENT for NOT async mode
+*/
+int log_get_async_stats(LogContext *pContext, LogAsyncStats *stats);
+
 /** set log fd flags
  *  parameters:
  *           pContext: the log context
@@ -359,6 +491,20 @@ void log_it_ex2(LogContext *pContext, const char *caption, \
 		const char *text, const int text_len, \
         const bool bNeedSync, const bool bNeedLock);
 
+/** log to file with the specified time
+ *  parameters:
+ *           pContext: the log context
+ *           tv: the log time
+ *           caption: such as INFO, ERROR, NULL for no caption
+ *           text: text string to log
+ *           text_len: text string length (bytes)
+ *           bNeedSync: if sync to file immediatelly
+ *  return: none
+*/
+void log_it_ex3(LogContext *pContext, struct timeval *tv, \
+		const char *caption, const char *text, const int text_len, \
+		const bool bNeedSync, const bool bNeedLock);
+
 
 /** sync log buffer to log file
  *  parameters:
@@ -398,6 +544,13 @@ const char *log_get_level_caption_ex(LogContext *pContext);
 
 #define log_get_level_caption() log_get_level_caption_ex(&g_log_context)
 
+/** get the caption of the log level
+ *  parameters:
+ *           priority: unix priority
+ *  return: log level caption
+*/
+const char *log_get_priority_caption(const int priority);
+
 void logEmergEx(LogContext *pContext, const char *format, ...)
     __gcc_attribute__ ((format (printf, 2, 3)));
 
@@ -425,6 +578,90 @@ void logDebugEx(LogContext *pContext, const char *format, ...)
 void logAccess(LogContext *pContext, struct timeval *tvStart,
         const char *format, ...) __gcc_attribute__ ((format (printf, 3, 4)));
 
+/** check the rate limit and the sampling of the call site, called by
+ *  the macro log_rate_limit_ex. the token bucket is implemented as GCRA
+ *  with a CAS, no lock.
+ *  parameters:
+ *           limit: the rate limit state of the call site
+ *           suppressed: return the suppressed count to report
+ *  return: LOG_RATE_LIMIT_PASS to log the message with the suppressed
+ *          count, LOG_RATE_LIMIT_SUMMARY to log the suppressed summary only,
+ *          LOG_RATE_LIMIT_DROP to discard the message
+*/
+int log_rate_limit_check(LogRateLimit *limit, int64_t *suppressed);
+
+/* rate limited log keyed by the call site (__FILE__ and __LINE__), such as
+ * the error logs of the hot path when the dependency fails.
+ * the format must be a string literal and rate, burst and sample must be
+ * constant expressions.
+ *   rate:   the messages per second by the token bucket, 0 for no limit
+ *   burst:  the max burst messages, 0 for the same as rate
+ *   sample: log 1 in N messages, 0 or 1 for all. the sampled out messages
+ *           are not counted as suppressed
+ * the message logged after suppression is appended with the suppressed
+ * count, and when suppressing continuously, a summary line is logged every
+ * LOG_RATE_LIMIT_SUMMARY_INTERVAL.
+ */
+#define log_rate_limit_ex(pContext, priority, rate, burst, sample, \
+        format, ...) \
+    do { \
+        static LogRateLimit _log_rate_limit = {rate, burst, sample}; \
+        int64_t _log_suppressed; \
+        if ((priority) > (pContext)->log_level) { \
+            break; \
+        } \
+        switch (log_rate_limit_check(&_log_rate_limit, &_log_suppressed)) { \
+            case LOG_RATE_LIMIT_PASS: \
+                if (_log_suppressed == 0) { \
+                    log_it_ex(pContext, priority, format, ##__VA_ARGS__); \
+                } else { \
+                    log_it_ex(pContext, priority, format", %"PRId64 \
+                            " similar messages suppressed", \
+                            ##__VA_ARGS__, _log_suppressed); \
+                } \
+                break; \
+            case LOG_RATE_LIMIT_SUMMARY: \
+                log_it_ex(pContext, priority, "file: "__FILE__", line: %d, " \
+                        "%"PRId64" messages suppressed by the rate limit", \
+                        __LINE__, _log_suppressed); \
+                break; \
+            default: \
+                break; \
+        } \
+    } while (0)
+
+/* rate limited logs of the global log context */
+#define logCritRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_CRIT, rate, 0, 0, format, ##__VA_ARGS__)
+
+#define logErrorRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_ERR, rate, 0, 0, format, ##__VA_ARGS__)
+
+#define logWarningRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_WARNING, rate, 0, 0, format, ##__VA_ARGS__)
+
+#define logNoticeRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_NOTICE, rate, 0, 0, format, ##__VA_ARGS__)
+
+#define logInfoRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_INFO, rate, 0, 0, format, ##__VA_ARGS__)
+
+#define logDebugRL(rate, format, ...) log_rate_limit_ex(&g_log_context, \
+        LOG_DEBUG, rate, 0, 0, format, ##__VA_ARGS__)
+
+/* sampled logs of the global log context: log 1 in N messages */
+#define logErrorSampled(sample, format, ...) log_rate_limit_ex( \
+        &g_log_context, LOG_ERR, 0, 0, sample, format, ##__VA_ARGS__)
+
+#define logWarningSampled(sample, format, ...) log_rate_limit_ex( \
+        &g_log_context, LOG_WARNING, 0, 0, sample, format, ##__VA_ARGS__)
+
+#define logInfoSampled(sample, format, ...) log_rate_limit_ex( \
+        &g_log_context, LOG_INFO, 0, 0, sample, format, ##__VA_ARGS__)
+
+#define logDebugSampled(sample, format, ...) log_rate_limit_ex( \
+        &g_log_context, LOG_DEBUG, 0, 0, sample, format, ##__VA_ARGS__)
+
 //#define LOG_FORMAT_CHECK
 
 #ifdef LOG_FORMAT_CHECK  /*only for format check*/
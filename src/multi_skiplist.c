@@ -117,8 +117,7 @@ int multi_skiplist_init_ex(MultiSkiplist *sl, const int level_count,
     sl->level_count = level_count;
     sl->compare_func = compare_func;
     sl->free_func = free_func;
-
-    srand(time(NULL));
+    sl->rand_state = skiplist_rand_seed(sl);
     return 0;
 }
 
@@ -246,15 +245,7 @@ static inline void multi_skiplist_free_data_node(MultiSkiplist *sl,
 
 static inline int multi_skiplist_get_level_index(MultiSkiplist *sl)
 {
-    int i;
-
-    for (i=0; i<sl->top_level_index; i++) {
-        if (rand() < RAND_MAX / 2) {
-            break;
-        }
-    }
-
-    return i;
+    return skiplist_rand_level_index(&sl->rand_state, sl->top_level_index);
 }
 
 int multi_skiplist_insert(MultiSkiplist *sl, void *data)
@@ -36,6 +36,8 @@
 #include "fc_memory.h"
 #include "http_func.h"
 #include "shared_func.h"
+#include "fc_file_copy.h"
+#include "fc_line_scan.h"
 
 #ifdef OS_LINUX
 #include <sys/sysinfo.h>
@@ -723,58 +725,9 @@ int getOccurCount(const char *src, const char seperator)
 int fc_get_file_line_count_ex(const char *filename,
         const int64_t until_offset, int64_t *line_count)
 {
-#define READ_BUFFER_SIZE  (256 * 1024 * 1024)
-    int fd;
-    int result;
-    int read_bytes;
-    int64_t remain_bytes;
-    char *buff;
-
-    *line_count = 0;
-    buff = (char *)fc_malloc(READ_BUFFER_SIZE);
-    if (buff == NULL) {
-        return ENOMEM;
-    }
-
-    fd = open(filename, O_RDONLY | O_CLOEXEC);
-    if (fd < 0) {
-        result = errno != 0 ? errno : EACCES;
-        logError("file: "__FILE__", line: %d, "
-                "open file \"%s\" fail, errno: %d, error info: %s",
-                __LINE__, filename, result, STRERROR(result));
-        free(buff);
-        return result;
-    }
-
-    if (until_offset >= 0) {
-        remain_bytes = until_offset;
-    } else {
-        remain_bytes = lseek(fd, 0, SEEK_END);
-        lseek(fd, 0, SEEK_SET);
-    }
-
-    while (remain_bytes > 0) {
-        read_bytes = (remain_bytes >= READ_BUFFER_SIZE ?
-                (READ_BUFFER_SIZE - 1) : remain_bytes);
-        read_bytes = read(fd, buff, read_bytes);
-        if (read_bytes == 0) {
-            break;
-        } else if (read_bytes < 0) {
-            result = errno != 0 ? errno : EIO;
-            logError("file: "__FILE__", line: %d, "
-                    "read file \"%s\" fail, errno: %d, error info: %s",
-                    __LINE__, filename, result, STRERROR(result));
-            return result;
-        }
-
-        *(buff + read_bytes) = '\0';
-        *line_count += getOccurCount(buff, '\n');
-        remain_bytes -= read_bytes;
-    }
-
-    close(fd);
-    free(buff);
-    return 0;
+    const int thread_count = 0;  //auto
+    return fc_count_file_lines(filename, until_offset,
+            thread_count, line_count);
 }
 
 char **split(char *src, const char seperator, const int nMaxCols, int *nColCount)
@@ -1476,71 +1429,7 @@ int safeWriteToFile(const char *filename, const char *buff, \
 
 int fc_copy_file(const char *src_filename, const char *dest_filename)
 {
-	int result;
-	int src_fd;
-	int dest_fd;
-    int bytes;
-    char buff[16 * 1024];
-
-	src_fd = open(src_filename, O_RDONLY | O_CLOEXEC);
-	if (src_fd < 0)
-    {
-        result = errno != 0 ? errno : ENOENT;
-        logError("file: "__FILE__", line: %d, "
-                "open file %s fail, errno: %d, error info: %s",
-                __LINE__, src_filename, result, STRERROR(result));
-        return result;
-    }
-
-	dest_fd = open(dest_filename, O_WRONLY | O_CREAT |
-            O_TRUNC | O_CLOEXEC, 0644);
-	if (dest_fd < 0)
-    {
-        result = errno != 0 ? errno : EIO;
-        logError("file: "__FILE__", line: %d, "
-                "open file %s fail, errno: %d, error info: %s",
-                __LINE__, dest_filename, result, STRERROR(result));
-        close(src_fd);
-        return result;
-    }
-
-    result = 0;
-    while (1) {
-        bytes = fc_safe_read(src_fd, buff, sizeof(buff));
-        if (bytes < 0)
-        {
-            result = errno != 0 ? errno : EIO;
-            logError("file: "__FILE__", line: %d, "
-                    "read file %s fail, errno: %d, error info: %s",
-                    __LINE__, src_filename, result, STRERROR(result));
-            break;
-        }
-        else if (bytes == 0)
-        {
-            break;
-        }
-
-        if (fc_safe_write(dest_fd, buff, bytes) != bytes)
-        {
-            result = errno != 0 ? errno : EIO;
-            logError("file: "__FILE__", line: %d, "
-                    "write file %s fail, errno: %d, error info: %s",
-                    __LINE__, dest_filename, result, STRERROR(result));
-            break;
-        }
-    }
-
-    if (result == 0 && fsync(dest_fd) != 0)
-    {
-        result = errno != 0 ? errno : EIO;
-        logError("file: "__FILE__", line: %d, "
-                "fsync file %s fail, errno: %d, error info: %s",
-                __LINE__, dest_filename, result, STRERROR(result));
-    }
-
-    close(src_fd);
-    close(dest_fd);
-    return result;
+    return fc_file_copy(src_filename, dest_filename);
 }
 
 int fc_copy_to_path(const char *src_filename, const char *dest_path)
@@ -1657,15 +1546,7 @@ int fd_gets(int fd, char *buff, const int size, int once_bytes)
 		}
 
 		pEnd = pDest + read_bytes;
-		for (p=pDest; p<pEnd; p++)
-		{
-			if (*p == '\n')
-			{
-				break;
-			}
-		}
-
-		if (p < pEnd)
+		if ((p=(char *)memchr(pDest, '\n', read_bytes)) != NULL)
 		{
 			pDest = p + 1;  //find \n, skip \n
 			rewind_bytes = pEnd - pDest;
@@ -3329,6 +3210,13 @@ const char *fc_memmem(const string_t *str, const string_t *needle)
 
 const char *fc_memrchr(const char *str, const int ch, const int len)
 {
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+    if (len <= 0)
+    {
+        return NULL;
+    }
+    return (const char *)memrchr(str, ch, len);
+#else
     const char *p;
 
     p = str + len - 1;
@@ -3342,6 +3230,7 @@ const char *fc_memrchr(const char *str, const int ch, const int len)
     }
 
     return NULL;
+#endif
 }
 
 char *format_http_date(time_t t, BufferInfo *buffer)
@@ -3833,19 +3722,19 @@ int fc_get_first_line(const char *filename, char *buff,
 int fc_get_first_lines(const char *filename, char *buff,
         const int buff_size, string_t *lines, int *count)
 {
+    FCLineIterator it;
+    string_t line;
     int result;
     int target_count;
     int64_t read_bytes;
-    char *p;
-    char *end;
-    char *line_end;
 
     if (*count <= 0) {
         lines->len = 0;
         return EINVAL;
     }
 
-    read_bytes = buff_size - 1;
+    //pread the head window only, the whole file is not mapped
+    read_bytes = buff_size;
     if ((result=getFileContentEx(filename, buff, 0, &read_bytes)) != 0) {
         *count = 0;
         lines->len = 0;
@@ -3859,22 +3748,20 @@ int fc_get_first_lines(const char *filename, char *buff,
 
     target_count = *count;
     *count = 0;
-    p = buff;
-    end = buff + read_bytes;
-    while (p < end) {
-        line_end = (char *)memchr(p, '\n', end - p);
-        if (line_end == NULL) {
+    lines->len = 0;
+    fc_line_iterator_init(&it, buff, read_bytes);
+    while (fc_line_iterator_next(&it, &line)) {
+        if (line.str[line.len - 1] != '\n') {
             break;
         }
 
-        p = line_end + 1;
+        lines->len += line.len;
         if (++(*count) == target_count) {
             break;
         }
     }
 
     lines->str = buff;
-    lines->len = p - buff;
     return (*count > 0 ? 0 : ENOENT);
 }
 
@@ -3925,10 +3812,11 @@ int fc_get_last_line(const char *filename, char *buff,
 int fc_get_last_lines(const char *filename, char *buff,
         const int buff_size, string_t *lines, int *count)
 {
-    int64_t file_size;
+    struct stat st;
     int64_t offset;
     int64_t read_bytes;
     int remain_len;
+    int fd;
     int i;
     int result;
 
@@ -3937,27 +3825,42 @@ int fc_get_last_lines(const char *filename, char *buff,
         return EINVAL;
     }
 
-    if ((result=getFileSize(filename, &file_size)) != 0) {
+    if ((fd=open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+        result = errno != 0 ? errno : ENOENT;
+        logError("file: "__FILE__", line: %d, "
+                "open file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
         *count = 0;
         lines->len = 0;
         return result;
     }
-
-    if (file_size == 0) {
+    if (fstat(fd, &st) != 0) {
+        result = errno != 0 ? errno : EIO;
+        logError("file: "__FILE__", line: %d, "
+                "stat file %s fail, errno: %d, error info: %s",
+                __LINE__, filename, result, STRERROR(result));
+        close(fd);
+        *count = 0;
+        lines->len = 0;
+        return result;
+    }
+    if (st.st_size == 0) {
+        close(fd);
         *count = 0;
         lines->len = 0;
         return ENOENT;
     }
 
-    if (file_size >= buff_size) {
-        offset = (file_size - buff_size) + 1;
+    //pread the tail window only, the whole file is not mapped
+    if (st.st_size >= buff_size) {
+        offset = (st.st_size - buff_size) + 1;
     } else {
         offset = 0;
     }
-    read_bytes = (file_size - offset) + 1;
-    if ((result=getFileContentEx(filename, buff,
-                    offset, &read_bytes)) != 0)
-    {
+    read_bytes = (st.st_size - offset) + 1;
+    result = getFileContentEx1(fd, filename, buff, offset, &read_bytes);
+    close(fd);
+    if (result != 0) {
         *count = 0;
         lines->len = 0;
         return result;
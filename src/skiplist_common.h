@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "common_define.h"
 
 #define SKIPLIST_MAX_LEVEL_COUNT  30
@@ -53,6 +54,31 @@ static inline int skiplist_get_proper_level(const int target_count)
     }
 }
 
+/* the seed of the level generator of the skiplist, never be 0 */
+static inline uint64_t skiplist_rand_seed(const void *sl)
+{
+    return (((uint64_t)(long)sl * 0x9E3779B97F4A7C15ULL) ^
+            (uint64_t)time(NULL)) | 1;
+}
+
+/* xorshift64* level generator of the skiplist instead of rand() which
+ * holds the global lock of glibc. the level i is taken by the
+ * probability 1 / 2^(i+1) with the trailing ones of the high bits */
+static inline int skiplist_rand_level_index(uint64_t *rand_state,
+        const int max_level_index)
+{
+    uint64_t x;
+    int level_index;
+
+    x = *rand_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rand_state = x;
+    level_index = __builtin_ctzll(~((x * 0x2545F4914F6CDD1DULL) >> 32));
+    return FC_MIN(level_index, max_level_index);
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
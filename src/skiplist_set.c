@@ -109,8 +109,7 @@ int skiplist_set_init_ex(SkiplistSet *sl, const int level_count,
     sl->level_count = level_count;
     sl->compare_func = compare_func;
     sl->free_func = free_func;
-
-    srand(time(NULL));
+    sl->rand_state = skiplist_rand_seed(sl);
     return 0;
 }
 
@@ -143,15 +142,7 @@ void skiplist_set_destroy(SkiplistSet *sl)
 
 static inline int skiplist_set_get_level_index(SkiplistSet *sl)
 {
-    int i;
-
-    for (i=0; i<sl->top_level_index; i++) {
-        if (rand() < RAND_MAX / 2) {
-            break;
-        }
-    }
-
-    return i;
+    return skiplist_rand_level_index(&sl->rand_state, sl->top_level_index);
 }
 
 int skiplist_set_insert(SkiplistSet *sl, void *data)
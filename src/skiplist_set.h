@@ -35,6 +35,7 @@ typedef struct skiplist_set
 {
     int level_count;
     int top_level_index;
+    uint64_t rand_state;  //for the level of the new node
     skiplist_compare_func compare_func;
     skiplist_free_func free_func;
     struct fast_mblock_man *mblocks;  //node allocators
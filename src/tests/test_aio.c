@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fc_aio.h"
+
+#define BASE_PATH       "/tmp/fc_aio_test"
+#define FILENAME        BASE_PATH"/test.dat"
+#define BLOCK_SIZE      4096
+#define BLOCK_COUNT     1024
+#define BENCH_BLOCKS    65536
+
+static int done_count;
+static int error_count;
+
+static void complete_callback(FCAIORequest *req)
+{
+    if (req->result != 0) {
+        error_count++;
+    }
+    done_count++;
+}
+
+static void wait_all(FCAIOEngine *engine, const int count)
+{
+    while (done_count < count) {
+        fc_aio_wait(engine, 1000);
+    }
+    assert(engine->inflight == 0);
+}
+
+static void fill_block(char *buff, const int index)
+{
+    memset(buff, 'a' + index % 26, BLOCK_SIZE);
+    memcpy(buff, &index, sizeof(index));
+}
+
+static void test_engine(const bool disable_uring)
+{
+    FCAIOConfig config;
+    FCAIOEngine engine;
+    FCAIORequest *reqs;
+    FCAIORequest req;
+    char *buff;
+    char expect[BLOCK_SIZE];
+    struct stat st;
+    int fd;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    config.queue_depth = 64;   //less than the requests for the pending
+    config.disable_uring = disable_uring;
+    assert(fc_aio_init(&engine, &config) == 0);
+    printf("mode: %s\n", fc_aio_get_mode_caption(&engine));
+    assert(disable_uring ? engine.mode == FC_AIO_MODE_THREADS : true);
+
+    assert((fd=open(FILENAME, O_RDWR | O_CREAT | O_TRUNC, 0644)) >= 0);
+    assert((reqs=(FCAIORequest *)malloc(sizeof(FCAIORequest) *
+                    BLOCK_COUNT)) != NULL);
+    assert((buff=(char *)malloc(BLOCK_SIZE * BLOCK_COUNT)) != NULL);
+
+    //fallocate then write the blocks in the reverse order
+    done_count = error_count = 0;
+    assert(fc_aio_fallocate(&engine, &req, fd, 0, 0, (int64_t)BLOCK_SIZE *
+                BLOCK_COUNT, complete_callback, NULL) == 0);
+    wait_all(&engine, 1);
+    assert(fstat(fd, &st) == 0 && st.st_size == BLOCK_SIZE * BLOCK_COUNT);
+
+    done_count = 0;
+    for (i=BLOCK_COUNT-1; i>=0; i--) {
+        fill_block(buff + i * BLOCK_SIZE, i);
+        assert(fc_aio_write(&engine, reqs + i, fd, buff + i * BLOCK_SIZE,
+                    (int64_t)i * BLOCK_SIZE, BLOCK_SIZE,
+                    complete_callback, NULL) == 0);
+    }
+    wait_all(&engine, BLOCK_COUNT);
+    assert(error_count == 0);
+    for (i=0; i<BLOCK_COUNT; i++) {
+        assert(reqs[i].bytes == BLOCK_SIZE);
+    }
+
+    done_count = 0;
+    assert(fc_aio_fsync(&engine, &req, fd, true,
+                complete_callback, NULL) == 0);
+    wait_all(&engine, 1);
+    assert(error_count == 0);
+
+    //read back
+    memset(buff, 0, BLOCK_SIZE * BLOCK_COUNT);
+    done_count = 0;
+    for (i=0; i<BLOCK_COUNT; i++) {
+        assert(fc_aio_read(&engine, reqs + i, fd, buff + i * BLOCK_SIZE,
+                    (int64_t)i * BLOCK_SIZE, BLOCK_SIZE,
+                    complete_callback, NULL) == 0);
+    }
+    wait_all(&engine, BLOCK_COUNT);
+    assert(error_count == 0);
+    for (i=0; i<BLOCK_COUNT; i++) {
+        fill_block(expect, i);
+        assert(memcmp(buff + i * BLOCK_SIZE, expect, BLOCK_SIZE) == 0);
+    }
+
+    //the read stops at the end of the file
+    done_count = 0;
+    assert(fc_aio_read(&engine, &req, fd, buff, (int64_t)BLOCK_SIZE *
+                BLOCK_COUNT - 100, BLOCK_SIZE, complete_callback, NULL) == 0);
+    wait_all(&engine, 1);
+    assert(req.result == 0 && req.bytes == 100);
+
+    //the large read of the whole file at once
+    done_count = 0;
+    assert(fc_aio_read(&engine, &req, fd, buff, 0, BLOCK_SIZE * BLOCK_COUNT,
+                complete_callback, NULL) == 0);
+    wait_all(&engine, 1);
+    assert(req.result == 0 && req.bytes == BLOCK_SIZE * BLOCK_COUNT);
+
+    //the errors
+    done_count = 0;
+    assert(fc_aio_read(&engine, &req, -1, buff, 0, BLOCK_SIZE,
+                complete_callback, NULL) == 0);
+    wait_all(&engine, 1);
+    assert(error_count == 1 && req.result == EBADF);
+    req.op = 100;
+    assert(fc_aio_submit(&engine, &req) == EINVAL);
+
+    close(fd);
+    free(buff);
+    free(reqs);
+    fc_aio_destroy(&engine);
+    unlink(FILENAME);
+}
+
+static void test_ioevent()
+{
+    IOEventPoller ioevent;
+    IOEventEntry *entry;
+    FCAIOEngine engine;
+    FCAIORequest req;
+    char buff[BLOCK_SIZE];
+    int fd;
+    int count;
+    int i;
+
+    assert(ioevent_init(&ioevent, 16, 1000, 0) == 0);
+    assert(fc_aio_init(&engine, NULL) == 0);
+    assert(fc_aio_attach(&engine, &ioevent) == 0);
+    assert((fd=open(FILENAME, O_RDWR | O_CREAT | O_TRUNC, 0644)) >= 0);
+
+    done_count = error_count = 0;
+    fill_block(buff, 1);
+    assert(fc_aio_write(&engine, &req, fd, buff, 0, BLOCK_SIZE,
+                complete_callback, NULL) == 0);
+    while (done_count == 0) {
+        count = ioevent_poll(&ioevent);
+        for (i=0; i<count; i++) {
+            entry = (IOEventEntry *)IOEVENT_GET_DATA(&ioevent, i);
+            entry->callback(entry->fd, IOEVENT_GET_EVENTS(&ioevent, i), entry);
+        }
+    }
+    assert(error_count == 0 && req.bytes == BLOCK_SIZE);
+
+    close(fd);
+    fc_aio_destroy(&engine);
+    ioevent_destroy(&ioevent);
+    unlink(FILENAME);
+}
+
+static void bench(const bool disable_uring)
+{
+    FCAIOConfig config;
+    FCAIOEngine engine;
+    FCAIORequest *reqs;
+    char buff[BLOCK_SIZE];
+    int64_t start_time;
+    int64_t time_used;
+    int fd;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    config.disable_uring = disable_uring;
+    assert(fc_aio_init(&engine, &config) == 0);
+    assert((fd=open(FILENAME, O_RDWR | O_CREAT | O_TRUNC, 0644)) >= 0);
+    assert((reqs=(FCAIORequest *)malloc(sizeof(FCAIORequest) *
+                    BENCH_BLOCKS)) != NULL);
+    memset(buff, 'b', sizeof(buff));
+
+    done_count = error_count = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<BENCH_BLOCKS; i++) {
+        assert(fc_aio_write(&engine, reqs + i, fd, buff, (int64_t)
+                    ((i * 7919) % BENCH_BLOCKS) * BLOCK_SIZE, BLOCK_SIZE,
+                    complete_callback, NULL) == 0);
+        if (i % 256 == 255) {
+            fc_aio_reap(&engine);
+        }
+    }
+    wait_all(&engine, BENCH_BLOCKS);
+    time_used = get_current_time_us() - start_time;
+    assert(error_count == 0);
+    printf("%s, %d random writes of %d bytes, time used: %"PRId64" ms, "
+            "%"PRId64" IOPS\n", fc_aio_get_mode_caption(&engine),
+            BENCH_BLOCKS, BLOCK_SIZE, time_used / 1000, (int64_t)
+            BENCH_BLOCKS * 1000000 / (time_used > 0 ? time_used : 1));
+
+    close(fd);
+    free(reqs);
+    fc_aio_destroy(&engine);
+    unlink(FILENAME);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_engine(false);
+    test_engine(true);
+    test_ioevent();
+    bench(false);
+    bench(true);
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+#include "fastcommon/avl_tree.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT  1000000
+
+static int64_t *numbers;
+static int64_t free_count = 0;
+
+static int compare_func(void *p1, void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+static void free_func(void *ptr)
+{
+    free_count++;
+}
+
+static int sum_func(void *data, void *args)
+{
+    *((int64_t *)args) += *((int64_t *)data);
+    return 0;
+}
+
+static void shuffle(int64_t *array, const int count)
+{
+    int64_t tmp;
+    int i;
+    int j;
+
+    for (i=count-1; i>0; i--) {
+        j = rand() % (i + 1);
+        tmp = array[i];
+        array[i] = array[j];
+        array[j] = tmp;
+    }
+}
+
+//return the height of the subtree
+static int check_node(AVLTreeNode *node, AVLTreeNode *parent)
+{
+    int left_height;
+    int right_height;
+
+    if (node == NULL) {
+        return 0;
+    }
+
+    assert(node->parent == parent);
+    left_height = check_node(node->left, node);
+    right_height = check_node(node->right, node);
+    assert(node->balance == right_height - left_height);
+    assert(node->balance >= -1 && node->balance <= 1);
+    assert(node->size == (node->left != NULL ? node->left->size : 0) +
+            (node->right != NULL ? node->right->size : 0) + 1);
+    return (left_height > right_height ? left_height : right_height) + 1;
+}
+
+static void test_small()
+{
+    AVLTreeInfo tree;
+    AVLTreeIterator iterator;
+    int64_t values[1024];
+    int64_t target;
+    int64_t end;
+    int64_t *found;
+    int i;
+    int k;
+
+    assert(avl_tree_init_ex(&tree, NULL, compare_func, 64) == 0);
+    for (i=0; i<1024; i++) {
+        values[i] = 2 * i;
+    }
+    shuffle(values, 1024);
+
+    for (i=0; i<1024; i++) {
+        assert(avl_tree_insert(&tree, values + i) == 1);
+        check_node(tree.root, NULL);
+    }
+    assert(avl_tree_insert(&tree, values) == 0);
+    assert(avl_tree_count(&tree) == 1024);
+
+    for (i=0; i<1024; i++) {
+        target = 2 * i;
+        assert(*(int64_t *)avl_tree_nth(&tree, i) == target);
+        assert(avl_tree_rank(&tree, &target) == i);
+        target++;
+        assert(avl_tree_rank(&tree, &target) == i + 1);
+        found = avl_tree_find_ge(&tree, &target);
+        assert(i == 1023 ? found == NULL : *found == target + 1);
+    }
+    assert(avl_tree_nth(&tree, -1) == NULL);
+    assert(avl_tree_nth(&tree, 1024) == NULL);
+
+    target = 101;
+    end = 110;
+    assert(avl_tree_count_range(&tree, &target, &end) == 5);
+    assert(avl_tree_count_range(&tree, &end, &target) == 0);
+    assert(avl_tree_find_range(&tree, &target, &end, &iterator) == 0);
+    for (k=102; k<=110; k+=2) {
+        assert(*(int64_t *)avl_tree_next(&iterator) == k);
+    }
+    assert(avl_tree_next(&iterator) == NULL);
+    assert(avl_tree_find_range(&tree, &end, &target, &iterator) == EINVAL);
+    target = end = 101;
+    assert(avl_tree_find_range(&tree, &target, &end, &iterator) == ENOENT);
+    assert(avl_tree_next(&iterator) == NULL);
+
+    target = 2040;
+    assert(avl_tree_iterator_at(&tree, &target, &iterator) == 0);
+    for (k=2040; k<=2046; k+=2) {
+        assert(*(int64_t *)avl_tree_next(&iterator) == k);
+    }
+    assert(avl_tree_next(&iterator) == NULL);
+    target = 2047;
+    assert(avl_tree_iterator_at(&tree, &target, &iterator) == ENOENT);
+
+    for (i=0; i<1024; i+=2) {
+        target = values[i];
+        assert(avl_tree_delete(&tree, &target) == 1);
+        assert(avl_tree_delete(&tree, &target) == 0);
+        assert(avl_tree_find(&tree, &target) == NULL);
+        check_node(tree.root, NULL);
+    }
+    assert(avl_tree_count(&tree) == 512);
+
+    k = 0;
+    avl_tree_iterator(&tree, &iterator);
+    while ((found=avl_tree_next(&iterator)) != NULL) {
+        assert(avl_tree_rank(&tree, found) == k);
+        assert(avl_tree_nth(&tree, k) == found);
+        k++;
+    }
+    assert(k == 512);
+
+    for (i=1; i<1024; i+=2) {
+        assert(avl_tree_delete(&tree, values + i) == 1);
+    }
+    assert(tree.root == NULL && avl_tree_count(&tree) == 0);
+    avl_tree_iterator(&tree, &iterator);
+    assert(avl_tree_next(&iterator) == NULL);
+    avl_tree_destroy(&tree);
+}
+
+static void test_large()
+{
+    AVLTreeInfo tree;
+    AVLTreeIterator iterator;
+    int64_t *found;
+    int64_t start_time;
+    int64_t insert_time;
+    int64_t find_time;
+    int64_t delete_time;
+    int64_t sum;
+    int64_t target;
+    int i;
+
+    assert(avl_tree_init(&tree, free_func, compare_func) == 0);
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(avl_tree_insert(&tree, numbers + i) == 1);
+    }
+    insert_time = get_current_time_us() - start_time;
+    check_node(tree.root, NULL);
+    assert(avl_tree_count(&tree) == COUNT);
+    assert(avl_tree_depth(&tree) <= 29);
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(*(int64_t *)avl_tree_find(&tree, numbers + i) == numbers[i]);
+    }
+    find_time = get_current_time_us() - start_time;
+
+    sum = 0;
+    assert(avl_tree_walk(&tree, sum_func, &sum) == 0);
+    assert(sum == (int64_t)COUNT * (COUNT - 1) / 2);
+
+    assert(avl_tree_replace(&tree, numbers) == 0);
+    assert(free_count == 1);
+    free_count = 0;
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT / 2; i++) {
+        assert(avl_tree_delete(&tree, numbers + i) == 1);
+    }
+    delete_time = get_current_time_us() - start_time;
+    assert(free_count == COUNT / 2);
+    check_node(tree.root, NULL);
+
+    i = 0;
+    avl_tree_iterator(&tree, &iterator);
+    while ((found=avl_tree_next(&iterator)) != NULL) {
+        assert(avl_tree_rank(&tree, found) == i);
+        assert(avl_tree_nth(&tree, i) == found);
+        i++;
+    }
+    assert(i == COUNT - COUNT / 2);
+    target = -1;
+    assert(avl_tree_count_range(&tree, &target, numbers +
+                COUNT - 1) == avl_tree_rank(&tree, numbers + COUNT - 1) + 1);
+
+    avl_tree_destroy(&tree);
+    assert(free_count == COUNT);
+
+    //the destroyed tree can be reused without avl_tree_init
+    free_count = 0;
+    for (i=0; i<1000; i++) {
+        assert(avl_tree_insert(&tree, numbers + i) == 1);
+    }
+    assert(avl_tree_count(&tree) == 1000);
+    check_node(tree.root, NULL);
+    avl_tree_destroy(&tree);
+    assert(free_count == 1000);
+    assert(avl_tree_count(&tree) == 0);
+    avl_tree_destroy(&tree);
+
+    printf("%d random int64, avl_tree insert: %"PRId64" ms, "
+            "find: %"PRId64" ms, delete half: %"PRId64" ms\n", COUNT,
+            insert_time / 1000, find_time / 1000, delete_time / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    log_init();
+    srand(time(NULL));
+    numbers = (int64_t *)malloc(sizeof(int64_t) * COUNT);
+    assert(numbers != NULL);
+    for (i=0; i<COUNT; i++) {
+        numbers[i] = i;
+    }
+    shuffle(numbers, COUNT);
+
+    test_small();
+    test_large();
+
+    free(numbers);
+    printf("pass OK\n");
+    return 0;
+}
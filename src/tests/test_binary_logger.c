@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <wchar.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/binary_logger.h"
+#include "fastcommon/shared_func.h"
+
+#define BASE_PATH     "/tmp/fc_binary_logger_test"
+#define BINARY_FILENAME  BASE_PATH"/test.blog"
+#define TEXT_FILENAME    BASE_PATH"/test.log"
+#define PLAIN_FILENAME   BASE_PATH"/plain.txt"
+#define MAX_LINES     64
+#define LINE_SIZE     1024
+#define LOOP_COUNT    1000000
+
+static BinaryLogContext blog_context;
+static char expected[MAX_LINES][LINE_SIZE];
+static int expected_count = 0;
+
+#define LOG_AND_EXPECT(fmt, ...) \
+    do { \
+        blog_it_ex(&blog_context, LOG_INFO, fmt, ##__VA_ARGS__); \
+        snprintf(expected[expected_count++], LINE_SIZE, \
+                "INFO - "fmt, ##__VA_ARGS__); \
+    } while (0)
+
+static void log_messages(const int round)
+{
+    short sh = -12;
+    unsigned char uc = 250;
+    size_t size = 123456789012345ULL;
+    ssize_t ssize = -9876543210LL;
+    intmax_t imax = INT64_MIN;
+    ptrdiff_t diff = -1;
+    struct {
+        char chars[8];
+        char guard[8];
+    } raw;
+
+    memcpy(raw.chars, "abcdefgh", sizeof(raw.chars));
+    memcpy(raw.guard, "GUARDXXX", sizeof(raw.guard));
+
+    LOG_AND_EXPECT("round: %d, no other args", round);
+    LOG_AND_EXPECT("int: %d %i %u %x %X %o %c %5d|%-5d|%05d %+d",
+            -1, 2, 3000000000U, 255, 255, 8, 'A', 12, 12, 12, 12);
+    LOG_AND_EXPECT("long: %ld %lu %lld %llu %#llx", -1234567890123L,
+            (unsigned long)-1, (long long)INT64_MIN,
+            (unsigned long long)UINT64_MAX, 0xabcdefULL);
+    LOG_AND_EXPECT("other ints: %zu %zd %jd %td %hd %hhu %"PRId64,
+            size, ssize, imax, diff, sh, uc, (int64_t)-5);
+    LOG_AND_EXPECT("double: %f %.2f %e %g %10.3f %Lf", 3.14159, 2.5,
+            1.0e-10, 0.0001, -7.25, (long double)1.5);
+    LOG_AND_EXPECT("string: %s|%10s|%-10s|%.3s|%s", "hello", "right",
+            "left", "truncated", "");
+    LOG_AND_EXPECT("star: %*d|%-*.*s|%.*f", 6, 42, 8, 2, "abcdef",
+            3, 1.23456);
+    LOG_AND_EXPECT("percent: 100%%, pointer: %p", (void *)0x1234);
+    LOG_AND_EXPECT("wide char: %lc|%c", (wint_t)'W', 'n');
+
+    //the string of the precision need not be NUL terminated
+    LOG_AND_EXPECT("not terminated: %.*s|%.4s|%.*s", 3, raw.chars,
+            raw.chars, -1, "negative");
+
+    errno = ENOENT;
+    blog_it_ex(&blog_context, LOG_INFO, "errno: %m, seq: %d", round);
+    errno = ENOENT;
+    snprintf(expected[expected_count++], LINE_SIZE,
+            "INFO - errno: %m, seq: %d", round);
+}
+
+static int64_t get_file_size(const char *filename)
+{
+    struct stat st;
+
+    assert(stat(filename, &st) == 0);
+    return st.st_size;
+}
+
+static int read_lines(const char *filename, char lines[][LINE_SIZE])
+{
+    FILE *fp;
+    int count;
+    int len;
+
+    assert((fp=fopen(filename, "r")) != NULL);
+    count = 0;
+    while (count < MAX_LINES && fgets(lines[count], LINE_SIZE, fp) != NULL) {
+        len = strlen(lines[count]);
+        if (len > 0 && lines[count][len - 1] == '\n') {
+            lines[count][len - 1] = '\0';
+        }
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static void check_text_file(const char *filename)
+{
+    char lines[MAX_LINES][LINE_SIZE];
+    int count;
+    int i;
+
+    count = read_lines(filename, lines);
+    if (count != expected_count) {
+        fprintf(stderr, "line count: %d != expected: %d\n",
+                count, expected_count);
+        assert(count == expected_count);
+    }
+    for (i=0; i<count; i++) {
+        if (strcmp(lines[i], expected[i]) != 0) {
+            fprintf(stderr, "line %d\n  decoded: %s\n expected: %s\n",
+                    i + 1, lines[i], expected[i]);
+            assert(0);
+        }
+    }
+}
+
+static void open_text_context(LogContext *text_context)
+{
+    unlink(TEXT_FILENAME);
+    assert(log_init_ex(text_context) == 0);
+    assert(log_set_filename_ex(text_context, TEXT_FILENAME) == 0);
+    log_set_time_precision(text_context, LOG_TIME_PRECISION_NONE);
+    log_set_cache_ex(text_context, true);
+}
+
+static void test_binary_file()
+{
+    LogContext text_context;
+    int64_t message_count;
+
+    unlink(BINARY_FILENAME);
+    expected_count = 0;
+
+    //two writers append to the same file, the decoder resets the ids
+    assert(binary_log_init_ex(&blog_context, BINARY_FILENAME,
+                NULL, 0, 10) == 0);
+    log_messages(1);
+    blog_it_ex(&blog_context, LOG_DEBUG, "filtered by the log level: %d", 1);
+    binary_log_destroy_ex(&blog_context);
+
+    assert(binary_log_init_ex(&blog_context, BINARY_FILENAME,
+                NULL, 0, 10) == 0);
+    log_messages(2);
+    assert(binary_log_flush(&blog_context) == 0);
+    binary_log_destroy_ex(&blog_context);
+
+    open_text_context(&text_context);
+    assert(binary_log_decode_file(BINARY_FILENAME, &text_context,
+                &message_count) == 0);
+    log_destroy_ex(&text_context);
+    assert(message_count == expected_count);
+    check_text_file(TEXT_FILENAME);
+
+    //not a binary log file
+    assert(writeToFile(PLAIN_FILENAME, "plain text file\n", 16) == 0);
+    open_text_context(&text_context);
+    assert(binary_log_decode_file(PLAIN_FILENAME, &text_context,
+                &message_count) == EINVAL);
+    log_destroy_ex(&text_context);
+    unlink(PLAIN_FILENAME);
+
+    //the truncated record is ignored
+    assert(truncate(BINARY_FILENAME, get_file_size(BINARY_FILENAME) - 3) == 0);
+    open_text_context(&text_context);
+    assert(binary_log_decode_file(BINARY_FILENAME, &text_context,
+                &message_count) == 0);
+    log_destroy_ex(&text_context);
+    assert(message_count == expected_count - 1);
+}
+
+static void test_text_mode()
+{
+    LogContext text_context;
+
+    expected_count = 0;
+    open_text_context(&text_context);
+    assert(binary_log_init_ex(&blog_context, NULL,
+                &text_context, 0, 10) == 0);
+    log_messages(3);
+    assert(binary_log_flush(&blog_context) == 0);
+    binary_log_destroy_ex(&blog_context);
+    log_destroy_ex(&text_context);
+    check_text_file(TEXT_FILENAME);
+}
+
+static void bench()
+{
+    LogContext text_context;
+    int64_t start_time;
+    int64_t text_time;
+    int64_t binary_time;
+    int i;
+
+    open_text_context(&text_context);
+    start_time = get_current_time_us();
+    for (i=0; i<LOOP_COUNT; i++) {
+        logInfoEx(&text_context, "seq: %d, value: %.3f, name: %s, "
+                "some text to make the line a little longer",
+                i, i * 0.5, "bench");
+    }
+    text_time = get_current_time_us() - start_time;
+    log_destroy_ex(&text_context);
+
+    unlink(BINARY_FILENAME);
+    assert(binary_log_init_ex(&blog_context, BINARY_FILENAME,
+                NULL, 1024 * 1024, 10) == 0);
+    start_time = get_current_time_us();
+    for (i=0; i<LOOP_COUNT; i++) {
+        blog_it_ex(&blog_context, LOG_INFO, "seq: %d, value: %.3f, "
+                "name: %s, some text to make the line a little longer",
+                i, i * 0.5, "bench");
+    }
+    binary_time = get_current_time_us() - start_time;
+    binary_log_destroy_ex(&blog_context);
+
+    printf("%d messages, text log: %"PRId64" ms, binary log: "
+            "%"PRId64" ms, binary file size: %"PRId64", text file size: "
+            "%"PRId64"\n", LOOP_COUNT, text_time / 1000, binary_time / 1000,
+            get_file_size(BINARY_FILENAME), get_file_size(TEXT_FILENAME));
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char arg_types[BINARY_LOG_MAX_ARGS];
+    short arg_precisions[BINARY_LOG_MAX_ARGS];
+    int arg_count;
+
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    assert(binary_log_parse_format("%d %-*.*s %lu %%", arg_types,
+                &arg_count) == 0);
+    assert(arg_count == 5);
+    assert(arg_types[1] == BINARY_LOG_ARG_INT);
+    assert(arg_types[3] == BINARY_LOG_ARG_STRING);
+    assert(arg_types[4] == (BINARY_LOG_ARG_LONG | BINARY_LOG_ARG_UNSIGNED));
+    assert(binary_log_parse_format("%y", arg_types, &arg_count) == EINVAL);
+    assert(binary_log_parse_format("%lc %m", arg_types, &arg_count) == 0);
+    assert(arg_count == 2);
+    assert(arg_types[0] == BINARY_LOG_ARG_INT);
+    assert(arg_types[1] == BINARY_LOG_ARG_ERRNO);
+    assert(binary_log_parse_format_ex("%.*s %.3s %s %d", arg_types,
+                arg_precisions, &arg_count) == 0);
+    assert(arg_count == 5);
+    assert(arg_precisions[1] == BINARY_LOG_PRECISION_STAR);
+    assert(arg_precisions[2] == 3);
+    assert(arg_precisions[3] == BINARY_LOG_PRECISION_NONE);
+    assert(arg_precisions[4] == BINARY_LOG_PRECISION_NONE);
+
+    test_binary_file();
+    test_text_mode();
+    bench();
+
+    unlink(BINARY_FILENAME);
+    unlink(TEXT_FILENAME);
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
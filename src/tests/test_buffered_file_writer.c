@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/buffered_file_writer.h"
+
+#define BASE_PATH       "/tmp/fc_buffered_file_writer_test"
+#define FILENAME        BASE_PATH"/test.dat"
+#define THREAD_COUNT    8
+#define RECORD_COUNT    20000
+#define COMMIT_INTERVAL 100
+
+static BufferedFileWriter writer;
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool async_mode;
+
+static void *thread_func(void *arg)
+{
+    char buff[128];
+    int thread_index;
+    int len;
+    int i;
+
+    thread_index = (long)arg;
+    for (i=0; i<RECORD_COUNT; i++) {
+        if (i % 2 == 0) {
+            len = sprintf(buff, "thread: %d, seq: %d\n", thread_index, i);
+            if (async_mode) {
+                assert(buffered_file_writer_append_buff(
+                            &writer, buff, len) == 0);
+            } else {
+                pthread_mutex_lock(&sync_lock);
+                assert(buffered_file_writer_append_buff(
+                            &writer, buff, len) == 0);
+                pthread_mutex_unlock(&sync_lock);
+            }
+        } else {
+            if (async_mode) {
+                assert(buffered_file_writer_append(&writer,
+                            "thread: %d, seq: %d\n", thread_index, i) == 0);
+            } else {
+                pthread_mutex_lock(&sync_lock);
+                assert(buffered_file_writer_append(&writer,
+                            "thread: %d, seq: %d\n", thread_index, i) == 0);
+                pthread_mutex_unlock(&sync_lock);
+            }
+        }
+
+        if ((i + 1) % COMMIT_INTERVAL == 0) {
+            if (async_mode) {
+                assert(buffered_file_writer_commit(&writer) == 0);
+            } else {
+                //the caller has to flush and fdatasync itself
+                pthread_mutex_lock(&sync_lock);
+                assert(buffered_file_writer_commit(&writer) == 0);
+                pthread_mutex_unlock(&sync_lock);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void check_file()
+{
+    FILE *fp;
+    char line[128];
+    int next_seq[THREAD_COUNT];
+    int thread_index;
+    int seq;
+    int count;
+
+    memset(next_seq, 0, sizeof(next_seq));
+    count = 0;
+    assert((fp=fopen(FILENAME, "r")) != NULL);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (*line == 'h') {   //the header lines
+            continue;
+        }
+        assert(sscanf(line, "thread: %d, seq: %d",
+                    &thread_index, &seq) == 2);
+        assert(thread_index >= 0 && thread_index < THREAD_COUNT);
+        assert(seq == next_seq[thread_index]);
+        next_seq[thread_index]++;
+        count++;
+    }
+    fclose(fp);
+    assert(count == THREAD_COUNT * RECORD_COUNT);
+}
+
+static int64_t run_threads()
+{
+    pthread_t tids[THREAD_COUNT];
+    int64_t start_time;
+    int i;
+
+    start_time = get_current_time_us();
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, thread_func,
+                    (void *)(long)i) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return get_current_time_us() - start_time;
+}
+
+static void test_sync_mode()
+{
+    BufferedFileWriterStats stats;
+    int64_t time_used;
+
+    async_mode = false;
+    assert(buffered_file_writer_open(&writer, FILENAME) == 0);
+    assert(buffered_file_writer_get_stats(&writer, &stats) == ENOENT);
+    time_used = run_threads();
+    assert(buffered_file_writer_close(&writer) == 0);
+    check_file();
+    printf("sync mode, %d commits, time used: %"PRId64" ms\n",
+            THREAD_COUNT * RECORD_COUNT / COMMIT_INTERVAL, time_used / 1000);
+}
+
+static void test_async_mode(const int buffer_count,
+        const int sync_max_delay_us, const int sync_bytes_threshold)
+{
+    BufferedFileWriterAsyncConfig config;
+    BufferedFileWriterStats stats;
+    char large_buff[10 * 1024];
+    int64_t time_used;
+
+    async_mode = true;
+    assert(buffered_file_writer_open_ex(&writer, FILENAME,
+                4 * 1024, 128, 0644) == 0);
+    assert(buffered_file_writer_append(&writer, "%s",
+                "header\n") == 0);   //the pending data
+    config.buffer_count = buffer_count;
+    config.sync_max_delay_us = sync_max_delay_us;
+    config.sync_bytes_threshold = sync_bytes_threshold;
+    assert(buffered_file_writer_start_async(&writer, &config) == 0);
+    assert(buffered_file_writer_start_async(&writer, &config) == EEXIST);
+
+    //the pending data is written by the writer thread
+    assert(buffered_file_writer_flush(&writer) == 0);
+    assert(getFileSize(FILENAME, &time_used) == 0 && time_used == 7);
+    assert(buffered_file_writer_get_stats(&writer, &stats) == 0);
+    assert(stats.batch_count == 1);
+
+    //the buffer larger than the buffer size is written directly
+    memset(large_buff, 'h', sizeof(large_buff) - 1);
+    large_buff[sizeof(large_buff) - 1] = '\n';
+    assert(buffered_file_writer_append_buff(&writer, large_buff,
+                sizeof(large_buff)) == 0);
+    assert(buffered_file_writer_commit(&writer) == 0);
+    assert(getFileSize(FILENAME, &time_used) == 0 &&
+            time_used == 7 + sizeof(large_buff));
+
+    time_used = run_threads();
+    assert(buffered_file_writer_get_stats(&writer, &stats) == 0);
+    assert(buffered_file_writer_close(&writer) == 0);
+    check_file();
+    assert(stats.commit_count <= THREAD_COUNT *
+            RECORD_COUNT / COMMIT_INTERVAL + 1);
+    assert(stats.sync_count <= stats.commit_count);
+    printf("async mode, buffers: %d, max delay: %d us, commits: %"PRId64
+            ", fdatasync: %"PRId64", batches: %"PRId64", avg batch bytes: "
+            "%"PRId64", max batch bytes: %"PRId64", avg flush: %"PRId64
+            " us, max flush: %"PRId64" us, buffer waits: %"PRId64
+            ", time used: %"PRId64" ms\n", buffer_count, sync_max_delay_us,
+            stats.commit_count, stats.sync_count, stats.batch_count,
+            stats.write_bytes / stats.batch_count, stats.max_batch_bytes,
+            stats.total_flush_us / stats.batch_count, stats.max_flush_us,
+            stats.buffer_wait_count, time_used / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_sync_mode();
+    test_async_mode(2, 0, 0);
+    test_async_mode(4, 200, 64 * 1024);
+
+    unlink(FILENAME);
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
@@ -19,16 +19,139 @@
 #include <math.h>
 #include <time.h>
 #include <inttypes.h>
+#include <assert.h>
 #include <sys/time.h>
 #include "fastcommon/logger.h"
 #include "fastcommon/shared_func.h"
+#include "fastcommon/hash.h"
+#include "fastcommon/fc_crc32.h"
+
+#define BENCH_TOTAL_BYTES  (256 * 1024 * 1024)
 
 static void usage(const char *program)
 {
-    fprintf(stderr, "Usage: %s [-o offset=0] [-s size=0] <filename>\n",
+    fprintf(stderr, "Usage: %s [-o offset=0] [-s size=0] [filename]\n"
+            "\twithout filename for the kernel test and benchmark\n",
             program);
 }
 
+static void test_kernels(const bool castagnoli, const char *buff,
+        const int size)
+{
+    fc_crc32_kernel_func byte_kernel;
+    fc_crc32_kernel_func kernel;
+    uint32_t expect;
+    int k;
+    int len;
+    int offset;
+
+    byte_kernel = fc_crc32_get_kernel(castagnoli, FC_CRC32_KERNEL_BYTE);
+    for (k=0; k<FC_CRC32_KERNEL_COUNT; k++) {
+        if ((kernel=fc_crc32_get_kernel(castagnoli, k)) == NULL) {
+            continue;
+        }
+
+        //all the lengths and alignments around the block sizes
+        for (len=0; len<=300; len++) {
+            for (offset=0; offset<16; offset++) {
+                expect = byte_kernel(0x12345678, buff + offset, len);
+                assert(kernel(0x12345678, buff + offset, len) == expect);
+            }
+        }
+        assert(kernel(FC_CRC32_INIT_VALUE, buff, size) ==
+                byte_kernel(FC_CRC32_INIT_VALUE, buff, size));
+    }
+}
+
+static void test_streaming(const char *buff, const int size)
+{
+    FCCRC32Context ctx;
+    int64_t crc;
+    int pos;
+    int len;
+
+    crc = CRC32_XINIT;
+    fc_crc32_init(&ctx);
+    for (pos=0; pos<size; pos+=len) {
+        len = FC_MIN(rand() % 5000, size - pos);
+        fc_crc32_update(&ctx, buff + pos, len);
+        crc = CRC32_ex(buff + pos, len, crc);
+    }
+    assert(fc_crc32_final(&ctx) == fc_crc32(buff, size));
+    assert((uint32_t)CRC32_FINAL(crc) == fc_crc32(buff, size));
+    assert((uint32_t)CRC32(buff, size) == fc_crc32(buff, size));
+
+    fc_crc32c_init(&ctx);
+    for (pos=0; pos<size; pos+=len) {
+        len = FC_MIN(rand() % 5000, size - pos);
+        fc_crc32c_update(&ctx, buff + pos, len);
+    }
+    assert(fc_crc32c_final(&ctx) == fc_crc32c(buff, size));
+}
+
+static void benchmark(const bool castagnoli, const char *buff)
+{
+    const int sizes[] = {64, 1024, 64 * 1024, 1024 * 1024};
+    fc_crc32_kernel_func kernel;
+    volatile uint32_t crc;
+    int64_t start_time;
+    int64_t time_used;
+    int loop;
+    int i;
+    int k;
+    int s;
+
+    printf("\n%s current kernel: %s\n", castagnoli ? "crc32c" : "crc32",
+            fc_crc32_kernel_name(fc_crc32_current_kernel(castagnoli)));
+    for (k=0; k<FC_CRC32_KERNEL_COUNT; k++) {
+        if ((kernel=fc_crc32_get_kernel(castagnoli, k)) == NULL) {
+            continue;
+        }
+        printf("%-14s", fc_crc32_kernel_name(k));
+        for (s=0; s<sizeof(sizes) / sizeof(int); s++) {
+            loop = BENCH_TOTAL_BYTES / sizes[s];
+            if (k == FC_CRC32_KERNEL_BYTE) {
+                loop /= 8;
+            }
+            crc = 0;
+            start_time = get_current_time_us();
+            for (i=0; i<loop; i++) {
+                crc = kernel(crc, buff, sizes[s]);
+            }
+            time_used = get_current_time_us() - start_time;
+            printf("  %7d B: %6.0f MB/s", sizes[s], (double)loop *
+                    sizes[s] / (time_used > 0 ? time_used : 1));
+        }
+        printf("\n");
+    }
+}
+
+static int test_and_benchmark()
+{
+#define TEST_BUFF_SIZE  (1024 * 1024 + 16)
+    char *buff;
+    int i;
+
+    buff = (char *)malloc(TEST_BUFF_SIZE);
+    assert(buff != NULL);
+    for (i=0; i<TEST_BUFF_SIZE; i++) {
+        buff[i] = rand();
+    }
+
+    assert(fc_crc32("123456789", 9) == 0xCBF43926);
+    assert(fc_crc32c("123456789", 9) == 0xE3069283);
+    test_kernels(false, buff, TEST_BUFF_SIZE);
+    test_kernels(true, buff, TEST_BUFF_SIZE);
+    test_streaming(buff, TEST_BUFF_SIZE);
+
+    benchmark(false, buff);
+    benchmark(true, buff);
+    free(buff);
+
+    printf("\npass OK\n");
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     int result;
@@ -40,11 +163,6 @@ int main(int argc, char *argv[])
     int64_t crc32;
     int byte1, byte2;
 
-    if (argc < 2) {
-        usage(argv[0]);
-        return EINVAL;
-    }
-
     offset = 0;
     file_size = 0;
     while ((ch=getopt(argc, argv, "ho:s:")) != -1) {
@@ -64,13 +182,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    log_init();
     if (optind >= argc) {
-        usage(argv[0]);
-        return EINVAL;
+        return test_and_benchmark();
     }
 
     filename = argv[optind];
-    log_init();
 
     if (file_size == 0) {
         if ((result=getFileSize(filename, &file_size)) != 0) {
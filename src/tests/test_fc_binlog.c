@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fc_binlog.h"
+
+#define BASE_PATH       "/tmp/fc_binlog_test"
+#define RECORD_COUNT    100000
+#define BENCH_COUNT     1000000
+
+static void remove_binlogs()
+{
+    char cmd[256];
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", BASE_PATH);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "execute %s fail\n", cmd);
+    }
+}
+
+static int make_record(const int64_t record_no, char *buff)
+{
+    //the variable length records
+    return sprintf(buff, "record: %"PRId64", %.*s", record_no,
+            (int)(record_no % 64), "abcdefghijklmnopqrstuvwxyz"
+            "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+}
+
+static void write_records(const FCBinlogConfig *config,
+        const int64_t start_no, const int count)
+{
+    FCBinlogWriter writer;
+    char buff[256];
+    int64_t record_no;
+    int len;
+    int i;
+
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, config) == 0);
+    assert(writer.next_record_no == start_no);
+    for (i=0; i<count; i++) {
+        len = make_record(start_no + i, buff);
+        assert(fc_binlog_writer_append(&writer, buff,
+                    len, &record_no) == 0);
+        assert(record_no == start_no + i);
+        if (i % 1000 == 999) {
+            assert(fc_binlog_writer_commit(&writer) == 0);
+        }
+    }
+    assert(fc_binlog_writer_close(&writer) == 0);
+}
+
+static void check_record(const FCBinlogRecord *record,
+        const int64_t record_no)
+{
+    char buff[256];
+    int len;
+
+    assert(record->record_no == record_no);
+    len = make_record(record_no, buff);
+    assert(record->length == len);
+    assert(memcmp(record->data, buff, len) == 0);
+}
+
+static void read_records(const int64_t start_no, const int64_t end_no)
+{
+    FCBinlogReader reader;
+    FCBinlogRecord record;
+    int64_t record_no;
+
+    assert(fc_binlog_reader_open(&reader, BASE_PATH) == 0);
+    if (start_no > 0) {
+        assert(fc_binlog_reader_seek(&reader, start_no) == 0);
+    }
+    for (record_no=start_no; record_no<end_no; record_no++) {
+        assert(fc_binlog_reader_next(&reader, &record) == 0);
+        check_record(&record, record_no);
+    }
+    assert(fc_binlog_reader_next(&reader, &record) == ENOENT);
+    fc_binlog_reader_close(&reader);
+}
+
+static void test_write_and_seek()
+{
+    FCBinlogConfig config;
+    FCBinlogReader reader;
+    FCBinlogRecord record;
+    FCBinlogWriter writer;
+    int64_t seeks[] = {0, 1, 255, 256, 257, 12345, 65535,
+        RECORD_COUNT - 1};
+    int i;
+
+    remove_binlogs();
+    memset(&config, 0, sizeof(config));
+    config.segment_size = 1024 * 1024;   //rollover
+    config.preallocate = true;
+    write_records(&config, 0, RECORD_COUNT / 2);
+    write_records(&config, RECORD_COUNT / 2, RECORD_COUNT / 2);
+    read_records(0, RECORD_COUNT);
+    read_records(RECORD_COUNT - 10, RECORD_COUNT);
+
+    assert(fc_binlog_reader_open(&reader, BASE_PATH) == 0);
+    assert(reader.segment_count > 1);
+    for (i=0; i<sizeof(seeks)/sizeof(seeks[0]); i++) {
+        assert(fc_binlog_reader_seek(&reader, seeks[i]) == 0);
+        assert(fc_binlog_reader_next(&reader, &record) == 0);
+        check_record(&record, seeks[i]);
+    }
+    assert(fc_binlog_reader_seek(&reader, RECORD_COUNT + 1) == ENOENT);
+    assert(fc_binlog_reader_seek(&reader, RECORD_COUNT) == 0);
+    assert(fc_binlog_reader_next(&reader, &record) == ENOENT);
+
+    //the reader follows the writer, include the rollover
+    assert(fc_binlog_reader_seek(&reader, RECORD_COUNT - 1) == 0);
+    assert(fc_binlog_reader_next(&reader, &record) == 0);
+    assert(fc_binlog_reader_next(&reader, &record) == ENOENT);
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    for (i=0; i<RECORD_COUNT / 4; i++) {
+        char buff[256];
+        int len;
+
+        len = make_record(RECORD_COUNT + i, buff);
+        assert(fc_binlog_writer_append(&writer, buff, len, NULL) == 0);
+    }
+    assert(fc_binlog_writer_commit(&writer) == 0);
+    for (i=0; i<RECORD_COUNT / 4; i++) {
+        assert(fc_binlog_reader_next(&reader, &record) == 0);
+        check_record(&record, RECORD_COUNT + i);
+    }
+    assert(fc_binlog_reader_next(&reader, &record) == ENOENT);
+    assert(fc_binlog_writer_close(&writer) == 0);
+    fc_binlog_reader_close(&reader);
+}
+
+static void truncate_tail(const char *filename, const int bytes)
+{
+    int64_t file_size;
+
+    assert(getFileSize(filename, &file_size) == 0);
+    assert(truncate(filename, file_size - bytes) == 0);
+}
+
+static void test_recovery()
+{
+    FCBinlogConfig config;
+    FCBinlogWriter writer;
+    char filename[MAX_PATH_SIZE];
+    int fd;
+
+    remove_binlogs();
+    memset(&config, 0, sizeof(config));
+    write_records(&config, 0, RECORD_COUNT);
+    snprintf(filename, sizeof(filename), "%s/%s.%06d", BASE_PATH,
+            FC_BINLOG_FILENAME_PREFIX, 1);
+
+    //the torn record
+    truncate_tail(filename, 5);
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    assert(writer.next_record_no == RECORD_COUNT - 1);
+    assert(writer.recovery.truncated_bytes > 0);
+    assert(writer.recovery.scanned_bytes < 64 * 1024);
+    assert(fc_binlog_writer_close(&writer) == 0);
+    read_records(0, RECORD_COUNT - 1);
+
+    //the garbage after the last record
+    assert((fd=open(filename, O_WRONLY | O_APPEND)) >= 0);
+    assert(write(fd, "garbage data of the torn write", 30) == 30);
+    close(fd);
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    assert(writer.next_record_no == RECORD_COUNT - 1);
+    assert(writer.recovery.truncated_bytes == 30);
+    assert(fc_binlog_writer_close(&writer) == 0);
+
+    //the lost index file is rebuilt by the full scan
+    snprintf(filename, sizeof(filename), "%s/%s.%06d%s", BASE_PATH,
+            FC_BINLOG_FILENAME_PREFIX, 1, FC_BINLOG_INDEX_EXT_STR);
+    assert(unlink(filename) == 0);
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    assert(writer.next_record_no == RECORD_COUNT - 1);
+    assert(writer.recovery.truncated_bytes == 0);
+    assert(fc_binlog_writer_close(&writer) == 0);
+    truncate_tail(filename, 3);   //the torn index entry
+    write_records(&config, RECORD_COUNT - 1, 1);
+    read_records(RECORD_COUNT / 3, RECORD_COUNT);
+}
+
+static void test_segment_gap()
+{
+    FCBinlogConfig config;
+    FCBinlogReader reader;
+    FCBinlogRecord record;
+    char filename[MAX_PATH_SIZE];
+    int64_t record_no;
+    int result;
+
+    remove_binlogs();
+    memset(&config, 0, sizeof(config));
+    config.segment_size = 1024 * 1024;
+    write_records(&config, 0, RECORD_COUNT / 2);
+    snprintf(filename, sizeof(filename), "%s/%s.%06d", BASE_PATH,
+            FC_BINLOG_FILENAME_PREFIX, 1);
+
+    //the tail record of the first segment is lost
+    truncate_tail(filename, 5);
+    assert(fc_binlog_reader_open(&reader, BASE_PATH) == 0);
+    assert(reader.segment_count > 1);
+    record_no = 0;
+    while ((result=fc_binlog_reader_next(&reader, &record)) == 0) {
+        check_record(&record, record_no++);
+    }
+    assert(result == EBADMSG);
+    assert(record_no == reader.segments[reader.current + 1].
+            first_record_no - 1);
+    fc_binlog_reader_close(&reader);
+}
+
+static void bench()
+{
+    FCBinlogConfig config;
+    FCBinlogWriter writer;
+    FCBinlogReader reader;
+    FCBinlogRecord record;
+    char buff[100];
+    int64_t start_time;
+    int64_t write_time;
+    int64_t scan_time;
+    int64_t bytes;
+    int i;
+
+    remove_binlogs();
+    memset(&config, 0, sizeof(config));
+    config.preallocate = true;
+    memset(buff, 'b', sizeof(buff));
+    start_time = get_current_time_us();
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    for (i=0; i<BENCH_COUNT; i++) {
+        assert(fc_binlog_writer_append(&writer, buff,
+                    sizeof(buff), NULL) == 0);
+    }
+    assert(fc_binlog_writer_close(&writer) == 0);
+    write_time = get_current_time_us() - start_time;
+    bytes = (int64_t)BENCH_COUNT * (sizeof(buff) +
+            sizeof(FCBinlogRecordHeader));
+
+    assert(fc_binlog_writer_open(&writer, BASE_PATH, &config) == 0);
+    assert(writer.next_record_no == BENCH_COUNT);
+    printf("recovery of %d records, scanned bytes: %"PRId64", "
+            "time used: %"PRId64" us\n", BENCH_COUNT,
+            writer.recovery.scanned_bytes, writer.recovery.time_used_us);
+    assert(fc_binlog_writer_close(&writer) == 0);
+
+    start_time = get_current_time_us();
+    assert(fc_binlog_reader_open(&reader, BASE_PATH) == 0);
+    for (i=0; i<BENCH_COUNT; i++) {
+        assert(fc_binlog_reader_next(&reader, &record) == 0);
+    }
+    fc_binlog_reader_close(&reader);
+    scan_time = get_current_time_us() - start_time;
+    printf("write %d records of %d bytes, time used: %"PRId64" ms, "
+            "%"PRId64" MB/s; scan time used: %"PRId64" ms\n", BENCH_COUNT,
+            (int)sizeof(buff), write_time / 1000, bytes / (write_time > 0 ?
+                write_time : 1), scan_time / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    test_write_and_seek();
+    test_recovery();
+    test_segment_gap();
+    bench();
+
+    remove_binlogs();
+    printf("pass OK\n");
+    return 0;
+}
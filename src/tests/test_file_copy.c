@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fc_file_copy.h"
+
+#define BASE_PATH       "/tmp/fc_file_copy_test"
+#define SRC_FILENAME    BASE_PATH"/src.dat"
+#define DEST_FILENAME   BASE_PATH"/dest.dat"
+#define BENCH_FILE_SIZE (256 * 1024 * 1024)
+
+typedef struct {
+    int64_t last_bytes;
+    int call_count;
+    int cancel_count;   //cancel when call_count reaches
+} ProgressArgs;
+
+static int progress_callback(void *args, const int64_t copied_bytes,
+        const int64_t total_bytes)
+{
+    ProgressArgs *progress;
+
+    progress = (ProgressArgs *)args;
+    assert(copied_bytes > progress->last_bytes);
+    assert(copied_bytes <= total_bytes);
+    progress->last_bytes = copied_bytes;
+    progress->call_count++;
+    return (progress->call_count == progress->cancel_count) ? 1 : 0;
+}
+
+static void write_file(const char *filename, const int64_t file_size,
+        const bool sparse)
+{
+    char buff[64 * 1024];
+    int64_t offset;
+    int fd;
+    int i;
+
+    assert((fd=open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0);
+    for (offset=0, i=0; offset<file_size; offset+=sizeof(buff), i++) {
+        //the sparse file: 1 data block every 16 blocks
+        if (sparse && i % 16 != 0) {
+            continue;
+        }
+        memset(buff, 'a' + i % 26, sizeof(buff));
+        memcpy(buff, &offset, sizeof(offset));
+        assert(pwrite(fd, buff, sizeof(buff), offset) == sizeof(buff));
+    }
+    assert(ftruncate(fd, file_size) == 0);
+    close(fd);
+}
+
+static void compare_range(const char *src_filename, const int64_t src_offset,
+        const char *dest_filename, const int64_t dest_offset,
+        const int64_t length)
+{
+    char buff1[64 * 1024];
+    char buff2[64 * 1024];
+    int64_t offset;
+    int bytes;
+    int fd1;
+    int fd2;
+
+    assert((fd1=open(src_filename, O_RDONLY)) >= 0);
+    assert((fd2=open(dest_filename, O_RDONLY)) >= 0);
+    for (offset=0; offset<length; offset+=bytes) {
+        bytes = (length - offset < sizeof(buff1)) ?
+            length - offset : sizeof(buff1);
+        assert(pread(fd1, buff1, bytes, src_offset + offset) == bytes);
+        assert(pread(fd2, buff2, bytes, dest_offset + offset) == bytes);
+        assert(memcmp(buff1, buff2, bytes) == 0);
+    }
+    close(fd1);
+    close(fd2);
+}
+
+static void compare_file(const char *src_filename,
+        const char *dest_filename)
+{
+    int64_t src_size;
+    int64_t dest_size;
+
+    assert(getFileSize(src_filename, &src_size) == 0);
+    assert(getFileSize(dest_filename, &dest_size) == 0);
+    assert(src_size == dest_size);
+    compare_range(src_filename, 0, dest_filename, 0, src_size);
+}
+
+static void test_whole_file()
+{
+    const int flags[] = {0, FC_FILE_COPY_FLAGS_NO_REFLINK,
+        FC_FILE_COPY_FLAGS_BUFFERED_ONLY};
+    FCFileCopyOptions options;
+    FCFileCopyResult result;
+    int i;
+
+    write_file(SRC_FILENAME, 10 * 1024 * 1024 + 123, false);
+    for (i=0; i<sizeof(flags)/sizeof(flags[0]); i++) {
+        memset(&options, 0, sizeof(options));
+        options.length = -1;
+        options.flags = flags[i];
+        assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                    &options, &result) == 0);
+        compare_file(SRC_FILENAME, DEST_FILENAME);
+        assert(result.copied_bytes == 10 * 1024 * 1024 + 123);
+        printf("copy method: %s\n", fc_file_copy_method_caption(
+                    result.method));
+    }
+    assert(result.method == fc_file_copy_method_buffered);
+
+    //the compatible API
+    assert(fc_copy_file(SRC_FILENAME, DEST_FILENAME) == 0);
+    compare_file(SRC_FILENAME, DEST_FILENAME);
+
+    //the empty file
+    write_file(SRC_FILENAME, 0, false);
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                NULL, &result) == 0);
+    assert(result.copied_bytes == 0);
+    assert(result.method == fc_file_copy_method_none);
+    compare_file(SRC_FILENAME, DEST_FILENAME);
+}
+
+static void test_sparse_file()
+{
+    FCFileCopyOptions options;
+    FCFileCopyResult result;
+    struct stat st;
+    const int64_t file_size = 32 * 1024 * 1024;
+
+    write_file(SRC_FILENAME, file_size, true);
+    memset(&options, 0, sizeof(options));
+    options.length = -1;
+    options.flags = FC_FILE_COPY_FLAGS_NO_REFLINK;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == 0);
+    compare_file(SRC_FILENAME, DEST_FILENAME);
+    assert(stat(DEST_FILENAME, &st) == 0);
+    printf("sparse file, copied bytes: %"PRId64", hole bytes: %"PRId64
+            ", dest allocated: %"PRId64"\n", result.copied_bytes,
+            result.hole_bytes, (int64_t)st.st_blocks * 512);
+    assert(result.copied_bytes + result.hole_bytes == file_size);
+}
+
+static void test_range()
+{
+    FCFileCopyOptions options;
+    FCFileCopyResult result;
+    const int64_t file_size = 4 * 1024 * 1024;
+    int64_t dest_size;
+
+    write_file(SRC_FILENAME, file_size, true);
+    write_file(DEST_FILENAME, file_size, false);
+    memset(&options, 0, sizeof(options));
+    options.src_offset = 100 * 1024 + 7;
+    options.dest_offset = 1024 * 1024 + 3;
+    options.length = 2 * 1024 * 1024;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == 0);
+    assert(result.copied_bytes == options.length);
+    compare_range(SRC_FILENAME, options.src_offset, DEST_FILENAME,
+            options.dest_offset, options.length);
+
+    //the head of the dest file is kept
+    write_file(SRC_FILENAME, file_size, false);
+    compare_range(SRC_FILENAME, 0, DEST_FILENAME, 0, options.dest_offset);
+    assert(getFileSize(DEST_FILENAME, &dest_size) == 0);
+    assert(dest_size == file_size);
+
+    //extend the dest file
+    options.src_offset = file_size - 1000;
+    options.dest_offset = file_size + 5000;
+    options.length = -1;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == 0);
+    assert(result.copied_bytes == 1000);
+    assert(getFileSize(DEST_FILENAME, &dest_size) == 0);
+    assert(dest_size == file_size + 6000);
+    compare_range(SRC_FILENAME, options.src_offset, DEST_FILENAME,
+            options.dest_offset, 1000);
+
+    options.src_offset = file_size + 1;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == EINVAL);
+}
+
+static void test_parallel_and_progress()
+{
+    FCFileCopyOptions options;
+    FCFileCopyResult result;
+    ProgressArgs progress;
+    const int64_t file_size = 64 * 1024 * 1024 + 4321;
+
+    write_file(SRC_FILENAME, file_size, false);
+    memset(&options, 0, sizeof(options));
+    memset(&progress, 0, sizeof(progress));
+    options.length = -1;
+    options.flags = FC_FILE_COPY_FLAGS_NO_REFLINK;
+    options.thread_count = 4;
+    options.parallel_threshold = 1024 * 1024;
+    options.chunk_size = 4 * 1024 * 1024;
+    options.progress = progress_callback;
+    options.progress_args = &progress;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == 0);
+    compare_file(SRC_FILENAME, DEST_FILENAME);
+    assert(progress.last_bytes == file_size);
+    assert(progress.call_count >= 17);
+    assert(result.method != fc_file_copy_method_sendfile);
+
+    memset(&progress, 0, sizeof(progress));
+    progress.cancel_count = 3;
+    assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                &options, &result) == ECANCELED);
+    assert(progress.call_count == 3);
+    assert(result.copied_bytes < file_size);
+}
+
+static void bench()
+{
+    const int flags[] = {FC_FILE_COPY_FLAGS_BUFFERED_ONLY,
+        FC_FILE_COPY_FLAGS_NO_REFLINK, FC_FILE_COPY_FLAGS_NO_REFLINK, 0};
+    const int thread_counts[] = {1, 1, 4, 1};
+    FCFileCopyOptions options;
+    FCFileCopyResult result;
+    int64_t start_time;
+    int64_t time_used;
+    int i;
+
+    write_file(SRC_FILENAME, BENCH_FILE_SIZE, false);
+    for (i=0; i<sizeof(flags)/sizeof(flags[0]); i++) {
+        unlink(DEST_FILENAME);
+        memset(&options, 0, sizeof(options));
+        options.length = -1;
+        options.flags = flags[i] | FC_FILE_COPY_FLAGS_NO_FSYNC;
+        options.thread_count = thread_counts[i];
+        start_time = get_current_time_us();
+        assert(fc_file_copy_ex(SRC_FILENAME, DEST_FILENAME,
+                    &options, &result) == 0);
+        time_used = get_current_time_us() - start_time;
+        printf("copy %d MB, method: %s, threads: %d, time used: %"PRId64
+                " ms, %"PRId64" MB/s\n", BENCH_FILE_SIZE / (1024 * 1024),
+                fc_file_copy_method_caption(result.method), thread_counts[i],
+                time_used / 1000, (int64_t)BENCH_FILE_SIZE /
+                (time_used > 0 ? time_used : 1));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_whole_file();
+    test_sparse_file();
+    test_range();
+    test_parallel_and_progress();
+    bench();
+
+    unlink(SRC_FILENAME);
+    unlink(DEST_FILENAME);
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
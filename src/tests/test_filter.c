@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "fastcommon/fc_filter.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define ITEM_COUNT    1000000
+#define THREAD_COUNT  4
+#define FILTER_FILENAME  "/tmp/test_filter.dat"
+
+static FCBloomFilter bloom;
+static FCCuckooFilter cuckoo;
+
+static void test_bloom_fpp(const double fpp)
+{
+    int64_t start_time;
+    int64_t add_time;
+    int64_t query_time;
+    int64_t n;
+    int false_positives;
+
+    assert(fc_bloom_filter_init(&bloom, ITEM_COUNT, fpp, 12345) == 0);
+    start_time = get_current_time_us();
+    for (n=0; n<ITEM_COUNT; n++) {
+        fc_bloom_filter_add(&bloom, &n, sizeof(n));
+    }
+    add_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    for (n=0; n<ITEM_COUNT; n++) {
+        assert(fc_bloom_filter_contains(&bloom, &n, sizeof(n)));
+    }
+    false_positives = 0;
+    for (n=ITEM_COUNT; n<2 * ITEM_COUNT; n++) {
+        if (fc_bloom_filter_contains(&bloom, &n, sizeof(n))) {
+            false_positives++;
+        }
+    }
+    query_time = get_current_time_us() - start_time;
+
+    printf("bloom  expect fpp: %.4f, real fpp: %.4f, bits/key: %.2f, "
+            "add: %.1f ns, query: %.1f ns\n", fpp,
+            (double)false_positives / ITEM_COUNT, (double)bloom.block_count *
+            FC_BLOOM_BLOCK_BYTES * 8 / ITEM_COUNT, (double)add_time *
+            1000 / ITEM_COUNT, (double)query_time * 1000 / (2 * ITEM_COUNT));
+    assert((double)false_positives / ITEM_COUNT <= fpp);
+    fc_bloom_filter_destroy(&bloom);
+}
+
+static void test_cuckoo_fpp()
+{
+    int64_t start_time;
+    int64_t add_time;
+    int64_t query_time;
+    int64_t n;
+    int false_positives;
+
+    assert(fc_cuckoo_filter_init(&cuckoo, ITEM_COUNT, 12345) == 0);
+    start_time = get_current_time_us();
+    for (n=0; n<ITEM_COUNT; n++) {
+        assert(fc_cuckoo_filter_add(&cuckoo, &n, sizeof(n)) == 0);
+    }
+    add_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    for (n=0; n<ITEM_COUNT; n++) {
+        assert(fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n)));
+    }
+    false_positives = 0;
+    for (n=ITEM_COUNT; n<2 * ITEM_COUNT; n++) {
+        if (fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n))) {
+            false_positives++;
+        }
+    }
+    query_time = get_current_time_us() - start_time;
+
+    /* the fpp of 16 bits fingerprints and 4 way buckets is
+     * about 2 * 4 * load factor / 65536 */
+    printf("cuckoo load factor: %.2f, real fpp: %.5f, "
+            "add: %.1f ns, query: %.1f ns\n", (double)ITEM_COUNT /
+            ((cuckoo.bucket_mask + 1.0) * FC_CUCKOO_SLOTS_PER_BUCKET),
+            (double)false_positives / ITEM_COUNT, (double)add_time *
+            1000 / ITEM_COUNT, (double)query_time * 1000 / (2 * ITEM_COUNT));
+    assert((double)false_positives / ITEM_COUNT <= 0.0002);
+
+    //delete the half
+    for (n=0; n<ITEM_COUNT; n+=2) {
+        assert(fc_cuckoo_filter_delete(&cuckoo, &n, sizeof(n)) == 0);
+    }
+    assert(fc_cuckoo_filter_count(&cuckoo) == ITEM_COUNT / 2);
+    for (n=1; n<ITEM_COUNT; n+=2) {
+        assert(fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n)));
+    }
+    false_positives = 0;
+    for (n=0; n<ITEM_COUNT; n+=2) {
+        if (fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n))) {
+            false_positives++;
+        }
+    }
+    assert((double)false_positives / (ITEM_COUNT / 2) <= 0.0002);
+    fc_cuckoo_filter_destroy(&cuckoo);
+}
+
+static void test_cuckoo_full()
+{
+    int64_t n;
+    int result;
+
+    assert(fc_cuckoo_filter_init(&cuckoo, 1000, 0) == 0);
+    for (n=0; ; n++) {
+        if ((result=fc_cuckoo_filter_add(&cuckoo, &n, sizeof(n))) != 0) {
+            break;
+        }
+    }
+    assert(result == ENOSPC);
+    assert(fc_cuckoo_filter_count(&cuckoo) == n);
+    printf("cuckoo full, items: %"PRId64", load factor: %.3f\n", n,
+            (double)n / ((cuckoo.bucket_mask + 1.0) *
+                FC_CUCKOO_SLOTS_PER_BUCKET));
+    assert(n >= (cuckoo.bucket_mask + 1) * FC_CUCKOO_SLOTS_PER_BUCKET * 0.9);
+
+    //no false negative after the failed kicks
+    while (--n >= 0) {
+        assert(fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n)));
+    }
+    fc_cuckoo_filter_destroy(&cuckoo);
+}
+
+static void *insert_thread_func(void *arg)
+{
+    int64_t thread_index;
+    int64_t n;
+
+    thread_index = (long)arg;
+    for (n=thread_index; n<ITEM_COUNT; n+=THREAD_COUNT) {
+        fc_bloom_filter_add(&bloom, &n, sizeof(n));
+        assert(fc_cuckoo_filter_add(&cuckoo, &n, sizeof(n)) == 0);
+    }
+    return NULL;
+}
+
+static void test_concurrent_insert()
+{
+    pthread_t tids[THREAD_COUNT];
+    int64_t n;
+    long i;
+
+    assert(fc_bloom_filter_init(&bloom, ITEM_COUNT, 0.01, 0) == 0);
+    assert(fc_cuckoo_filter_init(&cuckoo, ITEM_COUNT, 0) == 0);
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, insert_thread_func,
+                    (void *)i) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    assert(fc_cuckoo_filter_count(&cuckoo) == ITEM_COUNT);
+    for (n=0; n<ITEM_COUNT; n++) {
+        assert(fc_bloom_filter_contains(&bloom, &n, sizeof(n)));
+        assert(fc_cuckoo_filter_contains(&cuckoo, &n, sizeof(n)));
+    }
+}
+
+static void test_save_load()
+{
+    FCBloomFilter bloom2;
+    FCCuckooFilter cuckoo2;
+    int64_t n;
+
+    //the filters of test_concurrent_insert
+    assert(fc_bloom_filter_save(&bloom, FILTER_FILENAME) == 0);
+    assert(fc_bloom_filter_load(&bloom2, FILTER_FILENAME) == 0);
+    assert(bloom2.block_count == bloom.block_count);
+    assert(bloom2.count == bloom.count);
+    assert(memcmp(bloom2.blocks, bloom.blocks, (int64_t)
+                FC_BLOOM_BLOCK_BYTES * bloom.block_count) == 0);
+    assert(fc_cuckoo_filter_load(&cuckoo2, FILTER_FILENAME) == EINVAL);
+
+    assert(fc_cuckoo_filter_save(&cuckoo, FILTER_FILENAME) == 0);
+    assert(fc_cuckoo_filter_load(&cuckoo2, FILTER_FILENAME) == 0);
+    assert(fc_cuckoo_filter_count(&cuckoo2) == ITEM_COUNT);
+    for (n=0; n<ITEM_COUNT; n++) {
+        assert(fc_bloom_filter_contains(&bloom2, &n, sizeof(n)));
+        assert(fc_cuckoo_filter_contains(&cuckoo2, &n, sizeof(n)));
+    }
+    n = 0;
+    assert(fc_cuckoo_filter_delete(&cuckoo2, &n, sizeof(n)) == 0);
+
+    //the corrupted file
+    assert(truncate(FILTER_FILENAME, 1024) == 0);
+    assert(fc_cuckoo_filter_load(&cuckoo2, FILTER_FILENAME) != 0);
+    unlink(FILTER_FILENAME);
+
+    fc_bloom_filter_destroy(&bloom2);
+    fc_cuckoo_filter_destroy(&cuckoo2);
+    fc_bloom_filter_destroy(&bloom);
+    fc_cuckoo_filter_destroy(&cuckoo);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    test_bloom_fpp(0.01);
+    test_bloom_fpp(0.001);
+    test_cuckoo_fpp();
+    test_cuckoo_full();
+    test_concurrent_insert();
+    test_save_load();
+
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "fastcommon/hash.h"
+#include "fastcommon/flat_hash.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT 1000000
+#define STRING_KEY_SIZE 32
+
+typedef struct {
+    char str[STRING_KEY_SIZE];
+    int len;
+} StringKey;
+
+static StringKey *string_keys;
+static int64_t *int_keys;
+
+static void shuffle_index(int *indexes)
+{
+    int i;
+    int k;
+    int tmp;
+
+    for (i=0; i<COUNT; i++) {
+        indexes[i] = i;
+    }
+    for (i=COUNT-1; i>0; i--) {
+        k = (int)((int64_t)rand() * (i + 1) / ((int64_t)RAND_MAX + 1));
+        tmp = indexes[i];
+        indexes[i] = indexes[k];
+        indexes[k] = tmp;
+    }
+}
+
+static int walk_count_func(const int index,
+        const FlatHashEntry *entry, void *args)
+{
+    (*(int *)args)++;
+    return 0;
+}
+
+static void test_flat_hash(const char *caption, const void **keys,
+        const int *key_lens, const int *indexes)
+{
+    FlatHashTable table;
+    int64_t start_time;
+    int i;
+    int count;
+    int result;
+
+    assert(flat_hash_init(&table, Time33Hash, 0) == 0);
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i++) {
+        result = flat_hash_insert(&table, keys[i], key_lens[i],
+                (void *)(long)(i + 1), 0);
+        assert(result == 1);
+    }
+    printf("flat_hash %s insert time used: %"PRId64" ms\n",
+            caption, get_current_time_ms() - start_time);
+    assert(flat_hash_count(&table) == COUNT);
+    assert(flat_hash_insert(&table, keys[0], key_lens[0],
+                (void *)1, 0) == 0);
+
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i++) {
+        assert(flat_hash_find(&table, keys[indexes[i]],
+                    key_lens[indexes[i]]) == (void *)(long)(indexes[i] + 1));
+    }
+    printf("flat_hash %s find time used: %"PRId64" ms, "
+            "bytes used: %"PRId64"\n", caption,
+            get_current_time_ms() - start_time, table.bytes_used);
+
+    count = 0;
+    flat_hash_walk(&table, walk_count_func, &count);
+    assert(count == COUNT);
+
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i+=2) {
+        assert(flat_hash_delete(&table, keys[indexes[i]],
+                    key_lens[indexes[i]]) == 0);
+    }
+    printf("flat_hash %s delete time used: %"PRId64" ms\n",
+            caption, get_current_time_ms() - start_time);
+    for (i=0; i<COUNT; i++) {
+        if (i % 2 == 0) {
+            assert(flat_hash_find(&table, keys[indexes[i]],
+                        key_lens[indexes[i]]) == NULL);
+        } else {
+            assert(flat_hash_find(&table, keys[indexes[i]],
+                        key_lens[indexes[i]]) != NULL);
+        }
+    }
+    assert(flat_hash_count(&table) == COUNT / 2);
+    flat_hash_destroy(&table);
+}
+
+static void test_hash_array(const char *caption, const void **keys,
+        const int *key_lens, const int *indexes)
+{
+    HashArray hash;
+    int64_t start_time;
+    int i;
+
+    assert(fc_hash_init(&hash, Time33Hash, 1024, 0.75) == 0);
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i++) {
+        assert(fc_hash_insert_ex(&hash, keys[i], key_lens[i],
+                    (void *)(long)(i + 1), 0, false) == 1);
+    }
+    printf("HashArray %s insert time used: %"PRId64" ms\n",
+            caption, get_current_time_ms() - start_time);
+
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i++) {
+        assert(fc_hash_find(&hash, keys[indexes[i]], key_lens[indexes[i]])
+                == (void *)(long)(indexes[i] + 1));
+    }
+    printf("HashArray %s find time used: %"PRId64" ms, "
+            "bytes used: %"PRId64"\n", caption,
+            get_current_time_ms() - start_time, hash.bytes_used);
+
+    start_time = get_current_time_ms();
+    for (i=0; i<COUNT; i+=2) {
+        assert(fc_hash_delete(&hash, keys[indexes[i]],
+                    key_lens[indexes[i]]) == 0);
+    }
+    printf("HashArray %s delete time used: %"PRId64" ms\n",
+            caption, get_current_time_ms() - start_time);
+    fc_hash_destroy(&hash);
+}
+
+int main(int argc, char *argv[])
+{
+    const void **keys;
+    int *key_lens;
+    int *indexes;
+    int i;
+
+    log_init();
+    srand(time(NULL));
+    string_keys = (StringKey *)malloc(sizeof(StringKey) * COUNT);
+    int_keys = (int64_t *)malloc(sizeof(int64_t) * COUNT);
+    keys = (const void **)malloc(sizeof(void *) * COUNT);
+    key_lens = (int *)malloc(sizeof(int) * COUNT);
+    indexes = (int *)malloc(sizeof(int) * COUNT);
+    assert(string_keys != NULL && int_keys != NULL && keys != NULL &&
+            key_lens != NULL && indexes != NULL);
+    shuffle_index(indexes);
+
+    for (i=0; i<COUNT; i++) {
+        //short keys are inline, the long keys are malloced
+        string_keys[i].len = sprintf(string_keys[i].str,
+                (i % 4 == 0) ? "/data/file/path-%010d" : "key-%d", i);
+        keys[i] = string_keys[i].str;
+        key_lens[i] = string_keys[i].len;
+    }
+    test_flat_hash("string", keys, key_lens, indexes);
+    test_hash_array("string", keys, key_lens, indexes);
+
+    for (i=0; i<COUNT; i++) {
+        int_keys[i] = (int64_t)i * 7919;
+        keys[i] = int_keys + i;
+        key_lens[i] = sizeof(int64_t);
+    }
+    test_flat_hash("integer", keys, key_lens, indexes);
+    test_hash_array("integer", keys, key_lens, indexes);
+
+    printf("pass OK\n");
+    return 0;
+}
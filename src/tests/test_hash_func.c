@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "fastcommon/hash.h"
+#include "fastcommon/fc_fast_hash.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define KEY_COUNT     200000
+#define MAX_KEY_SIZE  128
+#define SPEED_LOOP    10
+#define PRIME_CAPACITY  262147
+
+typedef struct {
+    const char *name;
+    HashFunc func;
+    bool fast;   //word at a time
+} HashFuncEntry;
+
+typedef struct {
+    char buff[MAX_KEY_SIZE];
+    int len;
+} TestKey;
+
+static HashFuncEntry hash_funcs[] = {
+    {"RSHash", RSHash, false},
+    {"JSHash", JSHash, false},
+    {"PJWHash", PJWHash, false},
+    {"ELFHash", ELFHash, false},
+    {"BKDRHash", BKDRHash, false},
+    {"SDBMHash", SDBMHash, false},
+    {"Time33Hash", Time33Hash, false},
+    {"DJBHash", DJBHash, false},
+    {"APHash", APHash, false},
+    {"calc_hashnr", calc_hashnr, false},
+    {"calc_hashnr1", calc_hashnr1, false},
+    {"fc_simple_hash", fc_simple_hash, false},
+    {"CRC32", CRC32, false},
+    {"XXH32Hash", XXH32Hash, true},
+    {"XXH3Hash", XXH3Hash, true},
+    {"WyHash", WyHash, true}
+};
+
+static TestKey *keys;
+static unsigned int *hash_codes;
+static unsigned int *bucket_counts;
+
+static void gen_keys(const char *keyset)
+{
+    int64_t n;
+    int i;
+
+    for (i=0; i<KEY_COUNT; i++) {
+        if (strcmp(keyset, "integer") == 0) {
+            n = (int64_t)i * 4096;
+            memcpy(keys[i].buff, &n, sizeof(n));
+            keys[i].len = sizeof(n);
+        } else if (strcmp(keyset, "short") == 0) {
+            keys[i].len = sprintf(keys[i].buff, "key-%d", i);
+        } else if (strcmp(keyset, "ip_port") == 0) {
+            keys[i].len = sprintf(keys[i].buff, "10.%d.%d.%d:%d",
+                    (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF,
+                    23000 + i % 4);
+        } else if (strcmp(keyset, "path") == 0) {
+            keys[i].len = sprintf(keys[i].buff, "/data/storage/data/"
+                    "%02X/%02X/rBEBCmKz%08X_big.jpg", (i >> 8) & 0xFF,
+                    i & 0xFF, i);
+        } else {  //long
+            keys[i].len = sprintf(keys[i].buff, "/home/fastdfs/storage/"
+                    "data/group%d/M00/%02X/%02X/wKgBh%010d-%08X.tar.gz",
+                    i % 3, (i >> 8) & 0xFF, i & 0xFF, i, i * 7);
+        }
+    }
+}
+
+/* the ratio of the probes to the probes of the uniform random hash,
+ * 1.00 is ideal, refer to the "Red Dragon Book" */
+static double calc_quality(const int capacity, const bool pow2,
+        int *max_chain)
+{
+    double probes;
+    double expect;
+    unsigned int index;
+    int i;
+
+    memset(bucket_counts, 0, sizeof(unsigned int) * capacity);
+    for (i=0; i<KEY_COUNT; i++) {
+        index = pow2 ? (hash_codes[i] & (capacity - 1)) :
+            (hash_codes[i] % capacity);
+        bucket_counts[index]++;
+    }
+
+    probes = 0.00;
+    *max_chain = 0;
+    for (i=0; i<capacity; i++) {
+        probes += (double)bucket_counts[i] * (bucket_counts[i] + 1) / 2;
+        if (bucket_counts[i] > *max_chain) {
+            *max_chain = bucket_counts[i];
+        }
+    }
+
+    expect = ((double)KEY_COUNT / (2.0 * capacity)) *
+        (KEY_COUNT + 2.0 * capacity - 1);
+    return probes / expect;
+}
+
+static void test_keyset(const char *keyset)
+{
+    HashFuncEntry *entry;
+    HashFuncEntry *end;
+    int64_t start_time;
+    int64_t time_used;
+    double prime_quality;
+    double pow2_quality;
+    int prime_max_chain;
+    int pow2_max_chain;
+    int loop;
+    int i;
+
+    gen_keys(keyset);
+    end = hash_funcs + sizeof(hash_funcs) / sizeof(hash_funcs[0]);
+    for (entry=hash_funcs; entry<end; entry++) {
+        for (i=0; i<KEY_COUNT; i++) {
+            hash_codes[i] = entry->func(keys[i].buff, keys[i].len);
+        }
+
+        start_time = get_current_time_us();
+        for (loop=0; loop<SPEED_LOOP; loop++) {
+            for (i=0; i<KEY_COUNT; i++) {
+                hash_codes[i] += entry->func(keys[i].buff, keys[i].len);
+            }
+        }
+        time_used = get_current_time_us() - start_time;
+        for (i=0; i<KEY_COUNT; i++) {
+            hash_codes[i] = entry->func(keys[i].buff, keys[i].len);
+        }
+
+        prime_quality = calc_quality(PRIME_CAPACITY,
+                false, &prime_max_chain);
+        pow2_quality = calc_quality(1 << 18, true, &pow2_max_chain);
+        printf("%-8s %-15s %8.2f %10.3f %6d %10.3f %6d\n",
+                keyset, entry->name, (double)time_used * 1000.0 /
+                (SPEED_LOOP * KEY_COUNT), prime_quality, prime_max_chain,
+                pow2_quality, pow2_max_chain);
+
+        if (entry->fast) {
+            assert(prime_quality < 1.05 && pow2_quality < 1.05);
+        }
+    }
+}
+
+static void test_vectors()
+{
+    int64_t key;
+
+    assert(fc_xxh32("", 0, 0) == 0x02CC5D05);
+    assert(fc_xxh3_64("", 0, 0) == 0x2D06800538D394C2ULL);
+    assert(fc_xxh3_64("abc", 3, 0) == 0x78AF5F94892F3950ULL);
+    assert(fc_wyhash64("", 0, 0) == 0x93228A4DE0EEC5A2ULL);
+    assert(fc_wyhash64("a", 1, 1) == 0xC5BAC3DB178713C4ULL);
+    assert(fc_wyhash64("abc", 3, 2) == 0xA97F2F7B1D9B3314ULL);
+
+    //the seed MUST change the hash code
+    key = 12345;
+    assert(XXH3Hash_ex(&key, sizeof(key), 1) !=
+            XXH3Hash_ex(&key, sizeof(key), 2));
+    assert(WyHash_ex(&key, sizeof(key), 1) != WyHash_ex(&key, sizeof(key), 2));
+    assert(XXH3Hash(&key, sizeof(key)) == XXH3Hash_ex(&key, sizeof(key), 0));
+}
+
+int main(int argc, char *argv[])
+{
+    const char *keysets[] = {"integer", "short", "ip_port", "path", "long"};
+    HashArray hash;
+    int i;
+
+    log_init();
+    test_vectors();
+
+    keys = (TestKey *)malloc(sizeof(TestKey) * KEY_COUNT);
+    hash_codes = (unsigned int *)malloc(sizeof(unsigned int) * KEY_COUNT);
+    bucket_counts = (unsigned int *)malloc(
+            sizeof(unsigned int) * PRIME_CAPACITY);
+    assert(keys != NULL && hash_codes != NULL && bucket_counts != NULL);
+
+    printf("%-8s %-15s %8s %10s %6s %10s %6s\n", "#keyset", "function",
+            "ns/key", "prime_q", "max", "pow2_q", "max");
+    for (i=0; i<sizeof(keysets) / sizeof(keysets[0]); i++) {
+        test_keyset(keysets[i]);
+    }
+
+    //as a drop-in HashFunc of HashArray
+    assert(fc_hash_init(&hash, XXH3Hash, 1024, 0.75) == 0);
+    for (i=0; i<KEY_COUNT; i++) {
+        assert(fc_hash_insert(&hash, keys[i].buff, keys[i].len,
+                    keys + i) == 1);
+    }
+    for (i=0; i<KEY_COUNT; i++) {
+        assert(fc_hash_find(&hash, keys[i].buff, keys[i].len) == keys + i);
+    }
+    fc_hash_destroy(&hash);
+
+    printf("pass OK\n");
+    return 0;
+}
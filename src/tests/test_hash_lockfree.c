@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include "fastcommon/hash.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define KEY_COUNT     100000
+#define READ_COUNT    1000000
+#define MAX_READERS   64
+#define LOCK_COUNT    163
+
+typedef struct {
+    int64_t key;
+    int64_t check;   //MUST be key * 3 for a consistent value
+} TestValue;
+
+static HashArray hash;
+static volatile bool writer_done;
+static volatile int64_t writer_ops;
+
+static void *writer_func(void *arg)
+{
+    TestValue value;
+    int64_t ops;
+    int i;
+
+    ops = 0;
+    while (!writer_done) {
+        for (i=0; i<KEY_COUNT && !writer_done; i+=7) {
+            value.key = i;
+            value.check = value.key * 3;
+            if (i % 2 == 0) {
+                //replace the existing node
+                assert(fc_hash_insert_ex(&hash, &value.key, sizeof(int64_t),
+                            &value, sizeof(value), true) == 0);
+            } else {
+                assert(fc_hash_delete(&hash, &value.key,
+                            sizeof(int64_t)) == 0);
+                assert(fc_hash_insert_ex(&hash, &value.key, sizeof(int64_t),
+                            &value, sizeof(value), true) == 1);
+            }
+            ops++;
+        }
+    }
+
+    writer_ops = ops;
+    return NULL;
+}
+
+static void *reader_func(void *arg)
+{
+    TestValue value;
+    int64_t key;
+    int value_len;
+    int result;
+    int i;
+
+    key = (long)arg;
+    for (i=0; i<READ_COUNT; i++) {
+        key = (key * 1103515245 + 12345) % KEY_COUNT;
+        value_len = sizeof(value);
+        result = fc_hash_get(&hash, &key, sizeof(key), &value, &value_len);
+        if (result == 0) {
+            assert(value_len == sizeof(value));
+            assert(value.key == key && value.check == key * 3);
+        } else {
+            //the odd keys are deleted then inserted by the writer
+            assert(result == ENOENT && key % 2 == 1);
+        }
+    }
+
+    return NULL;
+}
+
+static void test_readers(const bool lockfree, const int reader_count)
+{
+    pthread_t writer;
+    pthread_t readers[MAX_READERS];
+    TestValue value;
+    int64_t start_time;
+    int64_t time_used;
+    long i;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, KEY_COUNT * 2,
+                0.00, 0, true) == 0);
+    assert(fc_hash_set_locks(&hash, LOCK_COUNT) == 0);
+    if (lockfree) {
+        assert(fc_hash_set_lockfree_read(&hash,
+                    MAX_READERS + 1) == 0);
+    }
+    for (i=0; i<KEY_COUNT; i++) {
+        value.key = i;
+        value.check = value.key * 3;
+        assert(fc_hash_insert_ex(&hash, &value.key, sizeof(int64_t),
+                    &value, sizeof(value), true) == 1);
+    }
+
+    writer_done = false;
+    start_time = get_current_time_ms();
+    assert(pthread_create(&writer, NULL, writer_func, NULL) == 0);
+    for (i=0; i<reader_count; i++) {
+        assert(pthread_create(readers + i, NULL,
+                    reader_func, (void *)(i + 1)) == 0);
+    }
+    for (i=0; i<reader_count; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    time_used = get_current_time_ms() - start_time;
+    writer_done = true;
+    pthread_join(writer, NULL);
+
+    printf("%s readers: %d, time used: %"PRId64" ms, "
+            "read ops/s: %"PRId64", writer ops: %"PRId64"\n",
+            lockfree ? "lock-free" : "locked", reader_count, time_used,
+            (int64_t)reader_count * READ_COUNT * 1000 /
+            (time_used > 0 ? time_used : 1), writer_ops);
+
+    assert(fc_hash_count(&hash) == KEY_COUNT);
+    for (value.key=0; value.key<KEY_COUNT; value.key++) {
+        assert(fc_hash_find_ex(&hash, &value.key, sizeof(int64_t)) != NULL);
+    }
+    fc_hash_destroy(&hash);
+}
+
+static void test_read_lock()
+{
+    HashData *hash_data;
+    TestValue value;
+    int64_t key;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, 1024, 0.00, 0, true) == 0);
+    assert(fc_hash_set_lockfree_read(&hash, 4) == 0);
+    assert(fc_hash_set_lockfree_read(&hash, 4) == EEXIST);
+    assert(fc_hash_set_incremental_rehash(&hash, 1) == EINVAL);
+    assert(fc_hash_best_op(&hash, 0) == -EOPNOTSUPP);
+
+    key = 1;
+    value.key = key;
+    value.check = 3;
+    assert(fc_hash_insert_ex(&hash, &key, sizeof(key),
+                &value, sizeof(value), true) == 1);
+
+    //the node MUST keep valid in the read side section after deleted
+    assert(fc_hash_read_lock(&hash) == 0);
+    hash_data = fc_hash_find_ex(&hash, &key, sizeof(key));
+    assert(hash_data != NULL);
+    assert(fc_hash_delete(&hash, &key, sizeof(key)) == 0);
+    fc_epoch_reclaim(hash.epoch);
+    assert(!fc_epoch_reclaim(hash.epoch));
+    assert(((TestValue *)hash_data->value)->check == 3);
+    fc_hash_read_unlock(&hash);
+
+    assert(fc_hash_find_ex(&hash, &key, sizeof(key)) == NULL);
+    fc_hash_destroy(&hash);
+}
+
+#define STRESS_KEY_COUNT    64
+#define STRESS_READ_COUNT   200000
+
+static void *stress_writer_func(void *arg)
+{
+    TestValue value;
+    int64_t ops;
+    int i;
+
+    ops = 0;
+    while (!writer_done) {
+        for (i=0; i<STRESS_KEY_COUNT; i++) {
+            value.key = i;
+            value.check = value.key * 3;
+            assert(fc_hash_delete(&hash, &value.key,
+                        sizeof(int64_t)) == 0);
+            assert(fc_hash_insert_ex(&hash, &value.key, sizeof(int64_t),
+                        &value, sizeof(value), true) == 1);
+            ops++;
+        }
+        sched_yield();
+    }
+
+    writer_ops = ops;
+    return NULL;
+}
+
+static void *stress_reader_func(void *arg)
+{
+    HashData *hash_data;
+    TestValue *pv;
+    string_t skey;
+    string_t svalue;
+    int64_t key;
+    int i;
+
+    key = (long)arg;
+    skey.str = (char *)&key;
+    skey.len = sizeof(key);
+    for (i=0; i<STRESS_READ_COUNT; i++) {
+        key = (key * 1103515245 + 12345) % STRESS_KEY_COUNT;
+        assert(fc_hash_read_lock(&hash) == 0);
+        if ((hash_data=fc_hash_find_ex(&hash, &key, sizeof(key))) != NULL) {
+            //the deleted node MUST NOT be freed and reused by others
+            pv = (TestValue *)hash_data->value;
+            assert(pv->key == key && pv->check == key * 3);
+            sched_yield();
+            assert(pv->key == key && pv->check == key * 3);
+        }
+        if ((pv=(TestValue *)fc_hash_find(&hash, &key,
+                        sizeof(key))) != NULL)
+        {
+            assert(pv->key == key && pv->check == key * 3);
+        }
+        if (fc_hash_find2(&hash, &skey, &svalue) == 0) {
+            pv = (TestValue *)svalue.str;
+            assert(svalue.len == sizeof(TestValue));
+            assert(pv->key == key && pv->check == key * 3);
+        }
+        fc_hash_read_unlock(&hash);
+    }
+
+    return NULL;
+}
+
+static void test_delete_while_reading(const int reader_count)
+{
+    pthread_t writer;
+    pthread_t readers[MAX_READERS];
+    TestValue value;
+    long i;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, 1024, 0.00, 0, true) == 0);
+    assert(fc_hash_set_locks(&hash, 7) == 0);
+    assert(fc_hash_set_lockfree_read(&hash, MAX_READERS + 1) == 0);
+    hash.epoch->reclaim_threshold = 1;  //free the removed nodes ASAP
+    for (i=0; i<STRESS_KEY_COUNT; i++) {
+        value.key = i;
+        value.check = value.key * 3;
+        assert(fc_hash_insert_ex(&hash, &value.key, sizeof(int64_t),
+                    &value, sizeof(value), true) == 1);
+    }
+
+    writer_done = false;
+    assert(pthread_create(&writer, NULL, stress_writer_func, NULL) == 0);
+    for (i=0; i<reader_count; i++) {
+        assert(pthread_create(readers + i, NULL,
+                    stress_reader_func, (void *)(i + 1)) == 0);
+    }
+    for (i=0; i<reader_count; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    writer_done = true;
+    pthread_join(writer, NULL);
+
+    printf("delete while reading, readers: %d, writer ops: %"PRId64"\n",
+            reader_count, writer_ops);
+    assert(fc_hash_count(&hash) == STRESS_KEY_COUNT);
+    fc_hash_destroy(&hash);
+}
+
+int main(int argc, char *argv[])
+{
+    int reader_counts[] = {1, 4, 16, 64};
+    int i;
+
+    log_init();
+    test_read_lock();
+    test_delete_while_reading(4);
+    for (i=0; i<sizeof(reader_counts) / sizeof(int); i++) {
+        test_readers(false, reader_counts[i]);
+        test_readers(true, reader_counts[i]);
+    }
+
+    printf("pass OK\n");
+    return 0;
+}
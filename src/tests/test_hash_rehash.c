@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "fastcommon/hash.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT 2000000
+#define THREAD_COUNT 4
+#define LOCK_COUNT 163
+
+static int64_t *keys;
+
+static void test_single_thread(const int rehash_step)
+{
+    HashArray hash;
+    int64_t start_time;
+    int64_t op_start;
+    int64_t op_time;
+    int64_t max_op_time;
+    int i;
+
+    assert(fc_hash_init(&hash, Time33Hash, 16, 0.75) == 0);
+    if (rehash_step > 0) {
+        assert(fc_hash_set_incremental_rehash(&hash, rehash_step) == 0);
+    }
+
+    max_op_time = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        op_start = get_current_time_us();
+        assert(fc_hash_insert_ex(&hash, keys + i, sizeof(int64_t),
+                    keys + i, sizeof(int64_t), true) == 1);
+        op_time = get_current_time_us() - op_start;
+        if (op_time > max_op_time) {
+            max_op_time = op_time;
+        }
+
+        //the key inserted before MUST be found during migration
+        if (i > 0) {
+            assert(fc_hash_find(&hash, keys + i / 2,
+                        sizeof(int64_t)) == keys + i / 2);
+        }
+    }
+    printf("rehash_step: %d, insert time used: %"PRId64" ms, "
+            "max insert time: %"PRId64" us, capacity: %u\n", rehash_step,
+            (get_current_time_us() - start_time) / 1000,
+            max_op_time, *hash.capacity);
+
+    assert(fc_hash_count(&hash) == COUNT);
+    for (i=0; i<COUNT; i+=2) {
+        assert(fc_hash_delete(&hash, keys + i, sizeof(int64_t)) == 0);
+    }
+    for (i=0; i<COUNT; i++) {
+        assert((fc_hash_find(&hash, keys + i, sizeof(int64_t)) == NULL)
+                == (i % 2 == 0));
+    }
+
+    fc_hash_rehash_finish(&hash);
+    assert(!fc_hash_is_rehashing(&hash));
+    fc_hash_destroy(&hash);
+
+#ifdef __GLIBC__
+    //consolidate the freed nodes now, avoid the stall of the next test
+    malloc_trim(0);
+#endif
+}
+
+static void test_best_op()
+{
+#define BEST_OP_COUNT 1000
+    HashArray hash;
+    int i;
+
+    assert(fc_hash_init(&hash, Time33Hash, 16, 0.75) == 0);
+    assert(fc_hash_set_incremental_rehash(&hash, 1) == 0);
+    assert(fc_hash_set_locks(&hash, 7) == 0);
+    for (i=0; i<BEST_OP_COUNT; i++) {
+        assert(fc_hash_insert(&hash, keys + i, sizeof(int64_t),
+                    keys + i) == 1);
+    }
+    assert(fc_hash_best_op(&hash, BEST_OP_COUNT) >= 0);
+    assert(*hash.capacity % 7 == 0);
+    for (i=0; i<BEST_OP_COUNT; i++) {
+        assert(fc_hash_find(&hash, keys + i, sizeof(int64_t)) == keys + i);
+    }
+    printf("best op capacity: %u\n", *hash.capacity);
+    fc_hash_destroy(&hash);
+}
+
+static HashArray shared_hash;
+
+static void *thread_func(void *arg)
+{
+    long index;
+    int i;
+
+    index = (long)arg;
+    for (i=index; i<COUNT; i+=THREAD_COUNT) {
+        assert(fc_hash_insert_ex(&shared_hash, keys + i, sizeof(int64_t),
+                    keys + i, sizeof(int64_t), true) == 1);
+        assert(fc_hash_find(&shared_hash, keys + i,
+                    sizeof(int64_t)) == keys + i);
+    }
+    return NULL;
+}
+
+static void test_multi_threads()
+{
+    pthread_t tids[THREAD_COUNT];
+    int64_t start_time;
+    long i;
+
+    assert(fc_hash_init(&shared_hash, Time33Hash, 16, 0.75) == 0);
+    assert(fc_hash_set_incremental_rehash(&shared_hash, 4) == 0);
+    assert(fc_hash_set_locks(&shared_hash, LOCK_COUNT) == 0);
+    assert(*shared_hash.capacity % LOCK_COUNT == 0);
+
+    start_time = get_current_time_ms();
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, thread_func, (void *)i) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    printf("%d threads insert time used: %"PRId64" ms, capacity: %u\n",
+            THREAD_COUNT, get_current_time_ms() - start_time,
+            *shared_hash.capacity);
+
+    for (i=0; i<COUNT; i++) {
+        assert(fc_hash_find(&shared_hash, keys + i,
+                    sizeof(int64_t)) == keys + i);
+    }
+    assert(fc_hash_count(&shared_hash) == COUNT);
+    fc_hash_destroy(&shared_hash);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    log_init();
+    keys = (int64_t *)malloc(sizeof(int64_t) * COUNT);
+    assert(keys != NULL);
+    for (i=0; i<COUNT; i++) {
+        keys[i] = (int64_t)i * 7919 + 1;
+    }
+
+    test_single_thread(1);
+    test_single_thread(8);
+    test_single_thread(0);  //stop-the-world rehash for comparison
+    test_best_op();
+    test_multi_threads();
+
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "fastcommon/hash.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT 1000000
+
+static void test_perf(const bool slab, const int value_len)
+{
+    HashArray hash;
+    char key[32];
+    char value[256];
+    char buff[256];
+    int64_t start_time;
+    int64_t insert_time;
+    int64_t find_time;
+    int key_len;
+    int len;
+    int i;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, COUNT, 0.75, 0, true) == 0);
+    if (slab) {
+        assert(fc_hash_set_slab_allocator(&hash) == 0);
+    }
+    memset(value, 'v', sizeof(value));
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        key_len = sprintf(key, "key-%d", i);
+        assert(fc_hash_insert_ex(&hash, key, key_len,
+                    value, value_len, false) == 1);
+    }
+    insert_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        key_len = sprintf(key, "key-%d", i);
+        len = sizeof(buff);
+        assert(fc_hash_get(&hash, key, key_len, buff, &len) == 0);
+        assert(len == value_len);
+    }
+    find_time = get_current_time_us() - start_time;
+
+    if (slab) {
+        //the node bytes are exactly the bytes of the slab objects
+        assert(hash.bytes_used - sizeof(HashData *) * (*hash.capacity) ==
+                hash.allocator->alloc_bytes);
+    }
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        key_len = sprintf(key, "key-%d", i);
+        assert(fc_hash_delete(&hash, key, key_len) == 0);
+    }
+    printf("%-6s value len: %3d, insert: %4"PRId64" ms, get: %4"PRId64" ms, "
+            "delete: %4"PRId64" ms\n", slab ? "slab" : "malloc", value_len,
+            insert_time / 1000, find_time / 1000,
+            (get_current_time_us() - start_time) / 1000);
+    assert(hash.bytes_used == sizeof(HashData *) * (*hash.capacity));
+    fc_hash_destroy(&hash);
+
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+static void test_max_bytes()
+{
+    HashArray hash;
+    int64_t bytes_used;
+    char value[100];
+    int key;
+    int i;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, 1024, 0.75,
+                64 * 1024, true) == 0);
+    assert(fc_hash_set_slab_allocator(&hash) == 0);
+    assert(fc_hash_set_slab_allocator(&hash) == EEXIST);
+    memset(value, 0, sizeof(value));
+
+    for (i=0; ; i++) {
+        bytes_used = hash.bytes_used;
+        if (fc_hash_insert_ex(&hash, &i, sizeof(i), value,
+                    sizeof(value), true) != 1)
+        {
+            break;
+        }
+    }
+    assert(fc_hash_insert_ex(&hash, &i, sizeof(i), value,
+                sizeof(value), true) == -ENOSPC);
+    assert(hash.bytes_used == bytes_used);
+    assert(hash.bytes_used <= hash.max_bytes);
+    printf("max bytes: %"PRId64", items: %d\n", hash.max_bytes, i);
+
+    //the space of the deleted node is reusable
+    key = 0;
+    assert(fc_hash_delete(&hash, &key, sizeof(key)) == 0);
+    assert(fc_hash_insert_ex(&hash, &i, sizeof(i), value,
+                sizeof(value), true) == 1);
+    assert(hash.bytes_used == bytes_used);
+    fc_hash_destroy(&hash);
+
+    //must be empty
+    assert(fc_hash_init_ex(&hash, Time33Hash, 1024, 0.75, 0, true) == 0);
+    assert(fc_hash_insert_ex(&hash, &i, sizeof(i), value, 8, true) == 1);
+    assert(fc_hash_set_slab_allocator(&hash) == EBUSY);
+    fc_hash_destroy(&hash);
+}
+
+static void test_lockfree()
+{
+    HashArray hash;
+    int value;
+    int len;
+    int i;
+
+    assert(fc_hash_init_ex(&hash, Time33Hash, 1024, 0.00, 0, true) == 0);
+    assert(fc_hash_set_slab_allocator(&hash) == 0);
+    assert(fc_hash_set_lockfree_read(&hash, 4) == 0);
+    for (i=0; i<10000; i++) {
+        assert(fc_hash_insert_ex(&hash, &i, sizeof(i),
+                    &i, sizeof(i), true) == 1);
+        assert(fc_hash_insert_ex(&hash, &i, sizeof(i),
+                    &i, sizeof(i), true) == 0);
+    }
+    for (i=0; i<10000; i++) {
+        len = sizeof(value);
+        assert(fc_hash_get(&hash, &i, sizeof(i), &value, &len) == 0);
+        assert(value == i);
+        assert(fc_hash_delete(&hash, &i, sizeof(i)) == 0);
+    }
+    fc_hash_destroy(&hash);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    test_max_bytes();
+    test_lockfree();
+
+    test_perf(false, 8);
+    test_perf(true, 8);
+    test_perf(false, 100);
+    test_perf(true, 100);
+
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/ini_snapshot.h"
+
+#define BASE_PATH       "/tmp/ini_snapshot_test"
+#define MAIN_FILENAME   BASE_PATH"/main.conf"
+#define SUB_FILENAME    BASE_PATH"/sub.conf"
+#define SNAP_FILENAME   BASE_PATH"/main.snapshot"
+#define BENCH_FILENAME  BASE_PATH"/bench.conf"
+#define BENCH_SNAPSHOT  BASE_PATH"/bench.snapshot"
+#define BENCH_SECTIONS  2000
+#define BENCH_ITEMS     20
+
+static const char *main_content =
+    "#@set base_port = 8000\n"
+    "name = main\n"
+    "#@function REPLACE_VARS\n"
+    "port = %{base_port}\n"
+    "#include sub.conf\n"
+    "[store]\n"
+    "path = /data/1\n"
+    "path = /data/2\n"
+    "path = /data/3\n"
+    "size = 64MB\n"
+    "enabled = yes\n"
+    "ratio = 0.75\n"
+    "[empty]\n";
+
+static const char *sub_content =
+    "timeout = 30\n"
+    "[sub]\n"
+    "key = value\n";
+
+struct compare_walk_arg {
+    IniContext *context;
+    IniSnapshot *snapshot;
+};
+
+static void compare_section(const char *section_name, IniContext *context,
+        IniSnapshot *snapshot)
+{
+    IniItem *items;
+    IniItem *item;
+    const IniSnapshotItem *sitems;
+    const char *values[16];
+    char *expect_values[16];
+    int count;
+    int scount;
+    int vcount;
+    int i;
+    int k;
+
+    items = iniGetSectionItems(section_name, context, &count);
+    sitems = iniSnapshotGetSectionItems(section_name, snapshot, &scount);
+    assert(count == scount);
+    for (i=0; i<count; i++) {
+        item = items + i;
+        assert(strcmp(item->name, iniSnapshotGetItemName(
+                        snapshot, sitems + i)) == 0);
+        assert(strcmp(item->value, iniSnapshotGetItemValue(
+                        snapshot, sitems + i)) == 0);
+        assert(strcmp(iniGetStrValue(section_name, item->name, context),
+                    iniSnapshotGetStrValue(section_name,
+                        item->name, snapshot)) == 0);
+
+        vcount = iniGetValues(section_name, item->name, context,
+                expect_values, 16);
+        assert(iniSnapshotGetValues(section_name, item->name, snapshot,
+                    values, 16) == vcount);
+        for (k=0; k<vcount; k++) {
+            assert(strcmp(values[k], expect_values[k]) == 0);
+        }
+    }
+}
+
+static int compare_walk(const int index, const HashData *data, void *args)
+{
+    struct compare_walk_arg *walk_arg;
+    char section_name[FAST_INI_ITEM_NAME_SIZE];
+
+    walk_arg = (struct compare_walk_arg *)args;
+    snprintf(section_name, sizeof(section_name), "%.*s",
+            data->key_len, data->key);
+    compare_section(section_name, walk_arg->context, walk_arg->snapshot);
+    return 0;
+}
+
+static void compare_all(IniContext *context, IniSnapshot *snapshot)
+{
+    struct compare_walk_arg walk_arg;
+
+    assert(iniSnapshotGetSectionCount(snapshot) ==
+            iniGetSectionCount(context));
+    assert(strcmp(iniSnapshotGetConfigPath(snapshot),
+                iniGetConfigPath(context)) == 0);
+    compare_section(NULL, context, snapshot);
+    walk_arg.context = context;
+    walk_arg.snapshot = snapshot;
+    fc_hash_walk(&context->sections, compare_walk, &walk_arg);
+}
+
+static void test_snapshot()
+{
+    IniContext context;
+    IniSnapshot snapshot;
+    const IniSourceFile *files;
+    const IniSnapshotItem *item;
+    struct stat st;
+    struct utimbuf times;
+    char buff[64];
+    int count;
+
+    assert(writeToFile(MAIN_FILENAME, main_content,
+                strlen(main_content)) == 0);
+    assert(writeToFile(SUB_FILENAME, sub_content,
+                strlen(sub_content)) == 0);
+    unlink(SNAP_FILENAME);
+
+    assert(iniLoadFromFile(MAIN_FILENAME, &context) == 0);
+    files = iniGetSourceFiles(&context, &count);
+    assert(count == 2);
+    assert(strcmp(files[0].filename, MAIN_FILENAME) == 0);
+    assert(strcmp(files[1].filename, SUB_FILENAME) == 0);
+    assert(files[1].file_size == strlen(sub_content));
+
+    assert(iniSnapshotSave(&context, SNAP_FILENAME) == 0);
+    assert(iniSnapshotOpen(&snapshot, SNAP_FILENAME) == 0);
+    assert(iniSnapshotCheckSources(&snapshot) == 0);
+    compare_all(&context, &snapshot);
+
+    assert(strcmp(iniSnapshotGetStrValue(NULL, "port", &snapshot),
+                "8000") == 0);
+    assert(iniSnapshotGetIntValue("", "timeout", &snapshot, 0) == 30);
+    assert(iniSnapshotGetIntValue("sub", "timeout", &snapshot, 0) == 0);
+    assert(iniSnapshotGetIntValueEx("sub", "timeout",
+                &snapshot, 0, true) == 30);
+    assert(iniSnapshotGetBoolValue("store", "enabled", &snapshot, false));
+    assert(iniSnapshotGetDoubleValue("store", "ratio",
+                &snapshot, 0.0) == 0.75);
+    assert(iniSnapshotGetInt64Value("store", "none", &snapshot, 9) == 9);
+    assert(iniSnapshotGetStrValue("none", "path", &snapshot) == NULL);
+    assert(iniSnapshotGetStrValue("store", "path", &snapshot) != NULL);
+    item = iniSnapshotGetValuesEx("store", "path", &snapshot, &count);
+    assert(item != NULL && count == 3);
+    assert(iniSnapshotGetSectionItems("empty", &snapshot,
+                &count) != NULL && count == 0);
+    iniSnapshotClose(&snapshot);
+    iniFreeContext(&context);
+
+    //the snapshot is reused when up to date
+    assert(iniSnapshotLoad(&snapshot, MAIN_FILENAME, SNAP_FILENAME) == 0);
+    assert(stat(SNAP_FILENAME, &st) == 0);
+    iniSnapshotClose(&snapshot);
+
+    //touch only, checked by CRC32C
+    times.actime = times.modtime = time(NULL) + 10;
+    assert(utime(SUB_FILENAME, &times) == 0);
+    assert(iniSnapshotOpen(&snapshot, SNAP_FILENAME) == 0);
+    assert(iniSnapshotCheckSources(&snapshot) == 0);
+    iniSnapshotClose(&snapshot);
+
+    //the include file changed
+    assert(writeToFile(SUB_FILENAME, "timeout = 60\n", 13) == 0);
+    assert(iniSnapshotOpen(&snapshot, SNAP_FILENAME) == 0);
+    assert(iniSnapshotCheckSources(&snapshot) == ESTALE);
+    iniSnapshotClose(&snapshot);
+    assert(iniSnapshotLoad(&snapshot, MAIN_FILENAME, SNAP_FILENAME) == 0);
+    assert(iniSnapshotCheckSources(&snapshot) == 0);
+    assert(iniSnapshotGetIntValue(NULL, "timeout", &snapshot, 0) == 60);
+    assert(iniSnapshotGetStrValue("sub", "key", &snapshot) == NULL);
+    iniSnapshotClose(&snapshot);
+
+    //the corrupted snapshot
+    assert(writeToFile(SNAP_FILENAME, "FCINISNP", 8) == 0);
+    assert(iniSnapshotOpen(&snapshot, SNAP_FILENAME) == EINVAL);
+    assert(iniSnapshotLoad(&snapshot, MAIN_FILENAME, SNAP_FILENAME) == 0);
+    assert(iniSnapshotGetIntValue(NULL, "timeout", &snapshot, 0) == 60);
+    iniSnapshotClose(&snapshot);
+
+    //load from buffer has no source files
+    strcpy(buff, "a = 1\n");   //the buffer is modified by the parser
+    assert(iniLoadFromBuffer(buff, &context) == 0);
+    assert(iniGetSourceFiles(&context, &count) == NULL && count == 0);
+    assert(iniSnapshotSave(&context, SNAP_FILENAME) == EOPNOTSUPP);
+    iniFreeContext(&context);
+
+    unlink(MAIN_FILENAME);
+    unlink(SUB_FILENAME);
+    unlink(SNAP_FILENAME);
+}
+
+static void bench()
+{
+    FILE *fp;
+    IniContext context;
+    IniSnapshot snapshot;
+    char section_name[32];
+    char item_name[32];
+    int64_t start_time;
+    int64_t parse_time;
+    int64_t open_time;
+    int64_t context_lookup_time;
+    int64_t snapshot_lookup_time;
+    int64_t sum1;
+    int64_t sum2;
+    int i;
+    int k;
+
+    assert((fp=fopen(BENCH_FILENAME, "w")) != NULL);
+    fprintf(fp, "#@set prefix = /data/storage\n");
+    for (i=0; i<BENCH_SECTIONS; i++) {
+        fprintf(fp, "[section-%d]\n", i);
+        for (k=0; k<BENCH_ITEMS; k++) {
+            fprintf(fp, "item_%d = %d\n", k, i * BENCH_ITEMS + k);
+        }
+        fprintf(fp, "#@function REPLACE_VARS\npath = %%{prefix}/%d\n", i);
+    }
+    fclose(fp);
+    unlink(BENCH_SNAPSHOT);
+
+    start_time = get_current_time_us();
+    assert(iniLoadFromFile(BENCH_FILENAME, &context) == 0);
+    parse_time = get_current_time_us() - start_time;
+
+    assert(iniSnapshotLoad(&snapshot, BENCH_FILENAME, BENCH_SNAPSHOT) == 0);
+    iniSnapshotClose(&snapshot);
+    start_time = get_current_time_us();
+    assert(iniSnapshotLoad(&snapshot, BENCH_FILENAME, BENCH_SNAPSHOT) == 0);
+    open_time = get_current_time_us() - start_time;
+    compare_all(&context, &snapshot);
+
+    sum1 = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<BENCH_SECTIONS; i++) {
+        sprintf(section_name, "section-%d", i);
+        for (k=0; k<BENCH_ITEMS; k++) {
+            sprintf(item_name, "item_%d", k);
+            sum1 += iniGetIntValue(section_name, item_name, &context, 0);
+        }
+    }
+    context_lookup_time = get_current_time_us() - start_time;
+
+    sum2 = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<BENCH_SECTIONS; i++) {
+        sprintf(section_name, "section-%d", i);
+        for (k=0; k<BENCH_ITEMS; k++) {
+            sprintf(item_name, "item_%d", k);
+            sum2 += iniSnapshotGetIntValue(section_name,
+                    item_name, &snapshot, 0);
+        }
+    }
+    snapshot_lookup_time = get_current_time_us() - start_time;
+    assert(sum1 == sum2);
+
+    printf("%d sections, %d items, parse: %"PRId64" us, snapshot open "
+            "and check: %"PRId64" us, lookup context: %"PRId64" us, "
+            "lookup snapshot: %"PRId64" us\n", BENCH_SECTIONS,
+            BENCH_SECTIONS * (BENCH_ITEMS + 1), parse_time, open_time,
+            context_lookup_time, snapshot_lookup_time);
+
+    iniSnapshotClose(&snapshot);
+    iniFreeContext(&context);
+    unlink(BENCH_FILENAME);
+    unlink(BENCH_SNAPSHOT);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_snapshot();
+    bench();
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/fc_line_scan.h"
+
+#define BASE_PATH       "/tmp/fc_line_scan_test"
+#define FILENAME        BASE_PATH"/test.txt"
+#define BENCH_SIZE      (256 * 1024 * 1024)
+
+static int64_t naive_count(const char *buff, const int64_t len)
+{
+    int64_t count;
+    int64_t i;
+
+    count = 0;
+    for (i=0; i<len; i++) {
+        if (buff[i] == '\n') {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void fill_lines(char *buff, const int64_t len, const int max_line)
+{
+    int64_t i;
+
+    for (i=0; i<len; i++) {
+        buff[i] = (rand() % max_line == 0) ? '\n' : 'a' + i % 26;
+    }
+}
+
+static void test_count_lines()
+{
+    char buff[4096 + 64];
+    int offset;
+    int len;
+
+    fill_lines(buff, sizeof(buff), 8);
+    for (offset=0; offset<64; offset++) {
+        for (len=0; len<=4096; len+=(len < 256 ? 1 : 97)) {
+            assert(fc_count_lines(buff + offset, len) ==
+                    naive_count(buff + offset, len));
+        }
+    }
+
+    //the byte counters overflow check
+    memset(buff, '\n', sizeof(buff));
+    assert(fc_count_lines(buff, sizeof(buff)) == sizeof(buff));
+}
+
+static void test_file_functions()
+{
+    const char *content = "line 1\nline 22\n\nline 4444\nno new line";
+    FCLineIterator it;
+    string_t line;
+    string_t lines;
+    char buff[64];
+    int64_t line_count;
+    int count;
+
+    assert(writeToFile(FILENAME, content, strlen(content)) == 0);
+    assert(fc_get_file_line_count(FILENAME, &line_count) == 0);
+    assert(line_count == 4);
+    assert(fc_get_file_line_count_ex(FILENAME, 15, &line_count) == 0);
+    assert(line_count == 2);
+    assert(fc_count_file_lines(FILENAME, -1, 1, &line_count) == 0);
+    assert(line_count == 4);
+
+    fc_line_iterator_init(&it, content, strlen(content));
+    assert(fc_line_iterator_next(&it, &line) && line.len == 7);
+    assert(fc_line_iterator_next(&it, &line) && line.len == 8);
+    assert(fc_line_iterator_next(&it, &line) && line.len == 1);
+    assert(fc_line_iterator_next(&it, &line) && line.len == 10);
+    assert(fc_line_iterator_next(&it, &line) && line.len == 11);
+    assert(memcmp(line.str, "no new line", 11) == 0);
+    assert(!fc_line_iterator_next(&it, &line));
+    assert(it.line_no == 5);
+
+    count = 2;
+    assert(fc_get_first_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == 0);
+    assert(count == 2 && lines.len == 15);
+    assert(memcmp(lines.str, "line 1\nline 22\n", 15) == 0);
+    count = 10;
+    assert(fc_get_first_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == 0);
+    assert(count == 4 && lines.len == 26);
+    count = 10;
+    assert(fc_get_first_lines(FILENAME, buff, 12, &lines, &count) == 0);
+    assert(count == 1 && lines.len == 7);
+
+    count = 2;
+    assert(fc_get_last_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == 0);
+    assert(count == 2);
+    assert(lines.len == 21 && memcmp(lines.str,
+                "line 4444\nno new line", 21) == 0);
+    count = 10;
+    assert(fc_get_last_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == 0);
+    assert(count == 5 && lines.len == strlen(content));
+    count = 10;
+    assert(fc_get_last_lines(FILENAME, buff, 16, &lines, &count) == 0);
+    assert(count == 2 && lines.len == 15);   //the partial line in front
+
+    assert(writeToFile(FILENAME, "", 0) == 0);
+    count = 1;
+    assert(fc_get_first_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == ENOENT);
+    count = 1;
+    assert(fc_get_last_lines(FILENAME, buff, sizeof(buff),
+                &lines, &count) == ENOENT);
+    assert(fc_get_file_line_count(FILENAME, &line_count) == 0);
+    assert(line_count == 0);
+    unlink(FILENAME);
+}
+
+static void bench()
+{
+    char *buff;
+    int64_t start_time;
+    int64_t naive_time;
+    int64_t simd_time;
+    int64_t file_time;
+    int64_t count1;
+    int64_t count2;
+    int64_t count3;
+
+    assert((buff=(char *)malloc(BENCH_SIZE)) != NULL);
+    fill_lines(buff, BENCH_SIZE, 80);
+
+    start_time = get_current_time_us();
+    count1 = naive_count(buff, BENCH_SIZE);
+    naive_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    count2 = fc_count_lines(buff, BENCH_SIZE);
+    simd_time = get_current_time_us() - start_time;
+    assert(count1 == count2);
+
+    assert(writeToFile(FILENAME, buff, BENCH_SIZE) == 0);
+    free(buff);
+    start_time = get_current_time_us();
+    assert(fc_get_file_line_count(FILENAME, &count3) == 0);
+    file_time = get_current_time_us() - start_time;
+    assert(count1 == count3);
+    unlink(FILENAME);
+
+    printf("count %d MB, %"PRId64" lines, byte loop: %"PRId64" ms, "
+            "fc_count_lines: %"PRId64" ms, file (page cache): %"PRId64
+            " ms\n", BENCH_SIZE / (1024 * 1024), count1, naive_time / 1000,
+            simd_time / 1000, file_time / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    srand(time(NULL));
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_count_lines();
+    test_file_functions();
+    bench();
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
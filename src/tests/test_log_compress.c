@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/fc_compress.h"
+#include "fastcommon/shared_func.h"
+
+#define BASE_PATH     "/tmp/fc_log_compress_test"
+#define LINE_COUNT    100000
+
+static int64_t get_file_size(const char *filename)
+{
+    struct stat st;
+
+    assert(stat(filename, &st) == 0);
+    return st.st_size;
+}
+
+/* decompress by the gzip command to check the compatibility */
+static void check_gzip_file(const char *gz_filename, const char *filename)
+{
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd), "gzip -dc %s | cmp -s - %s",
+            gz_filename, filename);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "check %s fail\n", gz_filename);
+        assert(0);
+    }
+}
+
+static void write_text_file(const char *filename, const int line_count)
+{
+    FILE *fp;
+    int i;
+
+    assert((fp=fopen(filename, "w")) != NULL);
+    for (i=0; i<line_count; i++) {
+        fprintf(fp, "[2026-10-19 12:00:00] INFO - line: %d, value: %d, "
+                "some text to compress\n", i, rand() % 1000);
+    }
+    fclose(fp);
+}
+
+static void test_compress_file()
+{
+#define PLAIN_FILENAME  BASE_PATH"/plain.txt"
+    const char *filename = PLAIN_FILENAME;
+    const char *gz_filename = PLAIN_FILENAME".gz";
+
+    write_text_file(filename, LINE_COUNT);
+    assert(fc_compress_file(filename, gz_filename, FC_COMPRESS_METHOD_GZIP,
+                FC_COMPRESS_DEFAULT_LEVEL, NULL) == 0);
+    assert(access(PLAIN_FILENAME".gz"FC_COMPRESS_TMP_EXT_STR, F_OK) != 0);
+    check_gzip_file(gz_filename, filename);
+    printf("compress file, size: %"PRId64" => %"PRId64"\n",
+            get_file_size(filename), get_file_size(gz_filename));
+
+    assert(fc_compress_file(BASE_PATH"/not_exist", gz_filename,
+                FC_COMPRESS_METHOD_GZIP, 1, NULL) == ENOENT);
+    if (!fc_compress_method_supported(FC_COMPRESS_METHOD_ZSTD)) {
+        assert(fc_compress_file(filename, gz_filename,
+                    FC_COMPRESS_METHOD_ZSTD, 1, NULL) == EOPNOTSUPP);
+    }
+    unlink(filename);
+    unlink(gz_filename);
+}
+
+static void test_worker()
+{
+    FCCompressWorkerConfig config;
+    FCCompressWorkerStats stats;
+    char filename[512];
+    char gz_filename[600];
+    unsigned char header[10];
+    int64_t start_time;
+    int64_t total_size;
+    int64_t time_used;
+    int fd;
+    int i;
+
+    //the throttled worker: 2MB per second
+    config.queue_size = 2;
+    config.level = 1;
+    config.throttle.max_bytes_per_second = 2 * 1024 * 1024;
+    config.throttle.max_cpu_percent = 50;
+    assert(fc_compress_worker_set_config(&config) == 0);
+
+    total_size = 0;
+    for (i=0; i<3; i++) {
+        sprintf(filename, "%s/worker.log.%d", BASE_PATH, i);
+        write_text_file(filename, LINE_COUNT / 4);
+        total_size += get_file_size(filename);
+    }
+
+    start_time = get_current_time_us();
+    assert(fc_compress_worker_submit(BASE_PATH"/worker.log.0",
+                FC_COMPRESS_METHOD_GZIP) == 0);
+    assert(fc_compress_worker_submit(BASE_PATH"/worker.log.0",
+                FC_COMPRESS_METHOD_GZIP) == EEXIST);
+    assert(fc_compress_worker_set_config(&config) == EBUSY);
+    assert(fc_compress_worker_submit(BASE_PATH"/worker.log.1",
+                FC_COMPRESS_METHOD_GZIP) == 0);
+    assert(fc_compress_worker_submit(BASE_PATH"/worker.log.2",
+                FC_COMPRESS_METHOD_GZIP) == EAGAIN);
+    assert(fc_compress_worker_wait(30 * 1000) == 0);
+    //the level of the task instead of the config level
+    assert(fc_compress_worker_submit_ex(BASE_PATH"/worker.log.2",
+                FC_COMPRESS_METHOD_GZIP, 9) == 0);
+    assert(fc_compress_worker_wait(30 * 1000) == 0);
+    time_used = get_current_time_us() - start_time;
+
+    fc_compress_worker_get_stats(&stats);
+    assert(stats.success_count == 3);
+    assert(stats.fail_count == 0);
+    assert(stats.pending_count == 0);
+    assert(stats.in_bytes == total_size);
+    assert(time_used >= total_size * 1000000 /
+            config.throttle.max_bytes_per_second * 9 / 10);
+    printf("throttled worker, compress %"PRId64" bytes to %"PRId64
+            " bytes, time used: %"PRId64" ms\n", stats.in_bytes,
+            stats.out_bytes, time_used / 1000);
+
+    for (i=0; i<3; i++) {
+        sprintf(filename, "%s/worker.log.%d", BASE_PATH, i);
+        sprintf(gz_filename, "%s.gz", filename);
+        assert(access(filename, F_OK) != 0);
+        assert(access(gz_filename, F_OK) == 0);
+
+        //the XFL of the gzip header: 4 for the fastest, 2 for the best
+        assert((fd=open(gz_filename, O_RDONLY)) >= 0);
+        assert(read(fd, header, sizeof(header)) == sizeof(header));
+        close(fd);
+        assert(header[8] == (i < 2 ? 4 : 2));
+        unlink(gz_filename);
+    }
+}
+
+static int find_rotated_file(char *filename, const int size)
+{
+    DIR *dir;
+    struct dirent *ent;
+    int count;
+
+    count = 0;
+    assert((dir=opendir(BASE_PATH)) != NULL);
+    while ((ent=readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, "stream.log.", 11) == 0) {
+            snprintf(filename, size, "%s/%s", BASE_PATH, ent->d_name);
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static void test_streaming()
+{
+    LogContext context;
+    char rotated_filename[512];
+    char expected_filename[256];
+    int i;
+
+    assert(log_init_ex(&context) == 0);
+    log_set_time_precision(&context, LOG_TIME_PRECISION_NONE);
+    log_set_compress_log_flags_ex(&context, LOG_COMPRESS_FLAGS_ENABLED |
+            LOG_COMPRESS_FLAGS_STREAMING);
+    assert(log_set_compress_method_ex(&context, 100, 1) == EOPNOTSUPP);
+    assert(log_set_compress_method_ex(&context,
+                FC_COMPRESS_METHOD_GZIP, 1) == 0);
+    assert(log_set_filename_ex(&context, BASE_PATH"/stream.log") == 0);
+    assert(context.compress_stream != NULL);
+    assert(access(BASE_PATH"/stream.log.zstream", F_OK) == 0);
+
+    for (i=0; i<LINE_COUNT; i++) {
+        logInfoEx(&context, "line: %d, some text to compress", i);
+    }
+    assert(log_rotate(&context) == 0);
+    logInfoEx(&context, "the first line of the new file");
+    log_destroy_ex(&context);
+    assert(access(BASE_PATH"/stream.log.zstream", F_OK) != 0);
+
+    //only the compressed rotated file, no plain one
+    assert(find_rotated_file(rotated_filename,
+                sizeof(rotated_filename)) == 1);
+    assert(strcmp(rotated_filename + strlen(rotated_filename) - 3,
+                ".gz") == 0);
+
+    snprintf(expected_filename, sizeof(expected_filename),
+            "%s/expected.log", BASE_PATH);
+    assert(log_init_ex(&context) == 0);
+    log_set_time_precision(&context, LOG_TIME_PRECISION_NONE);
+    assert(log_set_filename_ex(&context, expected_filename) == 0);
+    for (i=0; i<LINE_COUNT; i++) {
+        logInfoEx(&context, "line: %d, some text to compress", i);
+    }
+    log_destroy_ex(&context);
+    check_gzip_file(rotated_filename, expected_filename);
+    printf("streaming compression, size: %"PRId64" => %"PRId64"\n",
+            get_file_size(expected_filename),
+            get_file_size(rotated_filename));
+
+    //the appended log file is not compressed by stream
+    assert(log_init_ex(&context) == 0);
+    log_set_compress_log_flags_ex(&context, LOG_COMPRESS_FLAGS_ENABLED |
+            LOG_COMPRESS_FLAGS_STREAMING);
+    assert(log_set_filename_ex(&context, BASE_PATH"/stream.log") == 0);
+    assert(context.compress_stream == NULL);
+    log_destroy_ex(&context);
+
+    unlink(rotated_filename);
+    unlink(expected_filename);
+    unlink(BASE_PATH"/stream.log");
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    srand(time(NULL));
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    if (!fc_compress_method_supported(FC_COMPRESS_METHOD_GZIP)) {
+        printf("built without zlib, skip the test\n");
+        return 0;
+    }
+
+    test_compress_file();
+    test_worker();
+    test_streaming();
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
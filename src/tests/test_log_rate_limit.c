@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define BASE_PATH     "/tmp/fc_log_rate_limit_test"
+#define LOG_FILENAME  BASE_PATH"/test.log"
+#define LOOP_COUNT    1000000
+
+static void test_token_bucket()
+{
+    LogRateLimit limit = {10, 5, 0};
+    int64_t suppressed;
+    int pass_count;
+    int i;
+
+    pass_count = 0;
+    for (i=0; i<100; i++) {
+        if (log_rate_limit_check(&limit, &suppressed) ==
+                LOG_RATE_LIMIT_PASS)
+        {
+            assert(suppressed == 0);
+            pass_count++;
+        }
+    }
+    assert(pass_count == 5);
+    assert(limit.suppressed == 95);
+
+    //the tokens refill at 10 per second
+    usleep(250 * 1000);
+    assert(log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_PASS);
+    assert(suppressed == 95);
+    assert(log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_PASS);
+    assert(suppressed == 0);
+
+    //the summary when suppressing continuously
+    while (log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_PASS);
+    limit.next_summary_time = 1;   //the summary time expired
+    assert(log_rate_limit_check(&limit, &suppressed) ==
+            LOG_RATE_LIMIT_SUMMARY);
+    assert(suppressed == 2);
+    assert(limit.next_summary_time >= get_current_time_us() +
+            LOG_RATE_LIMIT_SUMMARY_INTERVAL - 1000000);
+    for (i=0; i<100; i++) {
+        assert(log_rate_limit_check(&limit, &suppressed) ==
+                LOG_RATE_LIMIT_DROP);
+    }
+    assert(limit.suppressed == 100);
+
+    //the pass reports the suppressed and restarts the summary timer
+    limit.tat = 0;
+    assert(log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_PASS);
+    assert(suppressed == 100);
+    assert(limit.next_summary_time == 0);
+    while (log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_PASS);
+    assert(limit.next_summary_time > 0);
+    assert(log_rate_limit_check(&limit, &suppressed) == LOG_RATE_LIMIT_DROP);
+}
+
+static void test_sampling()
+{
+    LogRateLimit limit = {0, 0, 4};
+    int64_t suppressed;
+    int pass_count;
+    int i;
+
+    pass_count = 0;
+    for (i=0; i<100; i++) {
+        if (log_rate_limit_check(&limit, &suppressed) ==
+                LOG_RATE_LIMIT_PASS)
+        {
+            pass_count++;
+        }
+        assert(suppressed == 0);
+    }
+    assert(pass_count == 25);
+}
+
+static int get_line_count(const char *filename, int *suppressed_lines)
+{
+    FILE *fp;
+    char line[1024];
+    int count;
+
+    *suppressed_lines = 0;
+    assert((fp=fopen(filename, "r")) != NULL);
+    count = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strstr(line, "similar messages suppressed") != NULL) {
+            (*suppressed_lines)++;
+        }
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static void log_connect_fail(LogContext *context, const int i)
+{
+    log_rate_limit_ex(context, LOG_ERR, 100, 20, 0, "file: "__FILE__
+            ", line: %d, connect to server 127.0.0.1:%d fail, errno: %d, "
+            "error info: %s", __LINE__, 10000 + i % 10, ECONNREFUSED,
+            STRERROR(ECONNREFUSED));
+}
+
+static void test_macro()
+{
+    LogContext context;
+    int64_t start_time;
+    int64_t time_used;
+    int line_count;
+    int suppressed_lines;
+    int i;
+
+    unlink(LOG_FILENAME);
+    assert(log_init_ex(&context) == 0);
+    assert(log_set_filename_ex(&context, LOG_FILENAME) == 0);
+
+    start_time = get_current_time_us();
+    for (i=0; i<LOOP_COUNT; i++) {
+        log_connect_fail(&context, i);
+    }
+    time_used = get_current_time_us() - start_time;
+    usleep(20 * 1000);
+    log_connect_fail(&context, 0);
+
+    //filtered by the log level, the tokens are not consumed
+    for (i=0; i<LOOP_COUNT; i++) {
+        log_rate_limit_ex(&context, LOG_DEBUG, 1, 0, 0,
+                "debug message: %d", i);
+    }
+    log_destroy_ex(&context);
+
+    line_count = get_line_count(LOG_FILENAME, &suppressed_lines);
+    assert(line_count >= 21);
+    assert(line_count <= 21 + time_used * 100 / 1000000 + 1);
+    assert(suppressed_lines >= 1);
+    printf("%d rate limited messages, logged: %d, time used: %"PRId64
+            " ms, %"PRId64" ns per call\n", LOOP_COUNT, line_count,
+            time_used / 1000, time_used * 1000 / LOOP_COUNT);
+    unlink(LOG_FILENAME);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_token_bucket();
+    test_sampling();
+    test_macro();
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <inttypes.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/log_recorder.h"
+#include "fastcommon/shared_func.h"
+
+#define BASE_PATH       "/tmp/fc_log_recorder_test"
+#define LOG_FILENAME    BASE_PATH"/test.log"
+#define DUMP_FILENAME   BASE_PATH"/dump.log"
+#define SHM_FILENAME    BASE_PATH"/recorder.shm"
+#define THREAD_COUNT    4
+#define SLOT_COUNT      1024
+#define LOOP_COUNT      100000
+
+static LogContext context;
+
+typedef struct {
+    int line_count;
+    int message_count;
+    int info_count;
+    int last_seq[THREAD_COUNT];
+    bool ordered;
+} DumpResult;
+
+static void parse_dump_file(const char *filename, DumpResult *result)
+{
+    FILE *fp;
+    char line[1024];
+    char last_time[64];
+    char *p;
+    int thread_index;
+    int seq;
+
+    memset(result, 0, sizeof(DumpResult));
+    result->ordered = true;
+    *last_time = '\0';
+    assert((fp=fopen(filename, "r")) != NULL);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        result->line_count++;
+        if (*line != '[') {
+            continue;
+        }
+        result->message_count++;
+        if (strncmp(line, last_time, 28) < 0) {
+            result->ordered = false;
+        }
+        memcpy(last_time, line, 28);
+        if (strstr(line, "] INFO - ") != NULL) {
+            result->info_count++;
+        }
+        if ((p=strstr(line, "thread: ")) != NULL && sscanf(p,
+                    "thread: %d, seq: %d", &thread_index, &seq) == 2)
+        {
+            result->last_seq[thread_index] = seq;
+        }
+    }
+    fclose(fp);
+}
+
+static void *thread_func(void *arg)
+{
+    int thread_index;
+    int i;
+
+    thread_index = (long)arg;
+    for (i=0; i<LOOP_COUNT; i++) {
+        logDebugEx(&context, "thread: %d, seq: %d, some debug context",
+                thread_index, i);
+    }
+    return NULL;
+}
+
+static void test_threads()
+{
+    pthread_t tids[THREAD_COUNT];
+    LogRecorderConfig config;
+    LogRecorderStats stats;
+    DumpResult result;
+    int i;
+
+    unlink(LOG_FILENAME);
+    unlink(DUMP_FILENAME);
+    assert(log_init_ex(&context) == 0);
+    assert(log_set_filename_ex(&context, LOG_FILENAME) == 0);
+    assert(log_dump_flight_recorder_ex(&context, DUMP_FILENAME) == ENOENT);
+
+    memset(&config, 0, sizeof(config));
+    config.max_threads = THREAD_COUNT + 1;
+    config.slot_count = SLOT_COUNT;
+    assert(log_set_flight_recorder_ex(&context, LOG_DEBUG, &config) == 0);
+    assert(log_set_flight_recorder_ex(&context, LOG_DEBUG,
+                &config) == EEXIST);
+
+    logInfoEx(&context, "the info message to the log file");
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, thread_func,
+                    (void *)(long)i) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    log_recorder_get_stats(context.recorder, &stats);
+    assert(stats.record_count == THREAD_COUNT * LOOP_COUNT);
+    assert(stats.no_ring_count == 0);
+    assert(stats.thread_count == 0);   //the rings are released
+
+    assert(log_dump_flight_recorder_ex(&context, DUMP_FILENAME) == 0);
+    parse_dump_file(DUMP_FILENAME, &result);
+    assert(result.message_count == THREAD_COUNT * SLOT_COUNT);
+    assert(result.line_count == result.message_count + 2);
+    assert(result.info_count == 0);
+    assert(result.ordered);
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(result.last_seq[i] == LOOP_COUNT - 1);
+    }
+
+    //the debug messages are not written to the log file
+    parse_dump_file(LOG_FILENAME, &result);
+    assert(result.message_count == 1);
+    assert(result.info_count == 1);
+    log_destroy_ex(&context);
+    unlink(LOG_FILENAME);
+    unlink(DUMP_FILENAME);
+}
+
+static void test_signal()
+{
+    DumpResult result;
+
+    unlink(DUMP_FILENAME);
+    assert(log_init_ex(&context) == 0);
+    assert(log_set_flight_recorder_ex(&context, LOG_DEBUG, NULL) == 0);
+    assert(log_recorder_set_dump_signal(context.recorder,
+                SIGUSR2, DUMP_FILENAME) == 0);
+    thread_func((void *)0);
+    raise(SIGUSR2);
+    parse_dump_file(DUMP_FILENAME, &result);
+    assert(result.message_count == LOG_RECORDER_DEFAULT_SLOT_COUNT);
+    assert(result.last_seq[0] == LOOP_COUNT - 1);
+    signal(SIGUSR2, SIG_DFL);
+    log_destroy_ex(&context);
+    unlink(DUMP_FILENAME);
+}
+
+/* the child process aborts, the crash dump and the shm file are left */
+static void test_crash()
+{
+    LogRecorderConfig config;
+    DumpResult result;
+    pid_t pid;
+    int status;
+
+    unlink(DUMP_FILENAME);
+    unlink(SHM_FILENAME);
+    unlink(SHM_FILENAME LOG_RECORDER_SHM_PREV_EXT_STR);
+    if ((pid=fork()) == 0) {
+        memset(&config, 0, sizeof(config));
+        config.shm_filename = SHM_FILENAME;
+        assert(log_init_ex(&context) == 0);
+        assert(log_set_flight_recorder_ex(&context, LOG_DEBUG, &config) == 0);
+        assert(log_recorder_set_crash_dump(context.recorder,
+                    DUMP_FILENAME) == 0);
+        thread_func((void *)1);
+        abort();
+    }
+
+    assert(pid > 0);
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    parse_dump_file(DUMP_FILENAME, &result);
+    assert(result.message_count == LOG_RECORDER_DEFAULT_SLOT_COUNT);
+    assert(result.last_seq[1] == LOOP_COUNT - 1);
+    unlink(DUMP_FILENAME);
+
+    assert(log_recorder_dump_shm(SHM_FILENAME, DUMP_FILENAME) == 0);
+    parse_dump_file(DUMP_FILENAME, &result);
+    assert(result.message_count == LOG_RECORDER_DEFAULT_SLOT_COUNT);
+    assert(result.last_seq[1] == LOOP_COUNT - 1);
+    assert(writeToFile(LOG_FILENAME, "plain text file\n", 16) == 0);
+    assert(log_recorder_dump_shm(LOG_FILENAME, DUMP_FILENAME) == EINVAL);
+    unlink(LOG_FILENAME);
+    unlink(DUMP_FILENAME);
+
+    //the shm file of the previous process is kept
+    memset(&config, 0, sizeof(config));
+    config.shm_filename = SHM_FILENAME;
+    assert(log_init_ex(&context) == 0);
+    assert(log_set_flight_recorder_ex(&context, LOG_DEBUG, &config) == 0);
+    log_destroy_ex(&context);
+    assert(access(SHM_FILENAME LOG_RECORDER_SHM_PREV_EXT_STR, F_OK) == 0);
+    unlink(SHM_FILENAME);
+    unlink(SHM_FILENAME LOG_RECORDER_SHM_PREV_EXT_STR);
+}
+
+static void record(LogRecorder *recorder, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    log_recorder_vwrite(recorder, LOG_DEBUG, format, ap);
+    va_end(ap);
+}
+
+static void read_dump_messages(char messages[][256], const int count)
+{
+    FILE *fp;
+    char line[1024];
+    char *p;
+    int len;
+    int i;
+
+    assert((fp=fopen(DUMP_FILENAME, "r")) != NULL);
+    i = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (*line != '[') {
+            continue;
+        }
+        assert(i < count);
+        assert((p=strstr(line, "[tid: ")) != NULL);
+        assert((p=strstr(p, "] ")) != NULL);
+        p += 2;
+        len = strlen(p) - 1;  //remove \n
+        assert(len < 256);
+        memcpy(messages[i], p, len);
+        messages[i++][len] = '\0';
+    }
+    fclose(fp);
+    assert(i == count);
+}
+
+/* the args are encoded when recorded and formatted when dumped */
+static void test_deferred_format()
+{
+    LogRecorderConfig config;
+    LogRecorder recorder;
+    char messages[5][256];
+    char expect[256];
+    char format[32];
+    char long_str[200];
+    struct {
+        char chars[4];
+        char guard[4];
+    } raw = {{'a', 'b', 'c', 'd'}, {'x', 'x', 'x', 'x'}};
+
+    unlink(DUMP_FILENAME);
+    memset(&config, 0, sizeof(config));
+    config.slot_size = 128;
+    config.max_formats = 16;
+    assert(log_recorder_init(&recorder, &config) == 0);
+
+    errno = ENOENT;
+    record(&recorder, "int: %d, str: %.*s, %s, err: %m", -5,
+            (int)sizeof(raw.chars), raw.chars, "hello");
+
+    //the format buffer is reused with the other content
+    strcpy(format, "first: %d");
+    record(&recorder, format, 1);
+    strcpy(format, "second: %s");
+    record(&recorder, format, "two");
+
+    //the args exceed the slot, formatted when recorded
+    memset(long_str, 'a', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+    record(&recorder, "long: %s", long_str);
+    record(&recorder, "double: %.2f, int64: %"PRId64, 3.14159,
+            (int64_t)-1234567890123LL);
+
+    assert(log_recorder_dump(&recorder, DUMP_FILENAME) == 0);
+    read_dump_messages(messages, 5);
+    sprintf(expect, "int: -5, str: abcd, hello, err: %s", STRERROR(ENOENT));
+    assert(strcmp(messages[0], expect) == 0);
+    assert(strcmp(messages[1], "first: 1") == 0);
+    assert(strcmp(messages[2], "second: two") == 0);
+    sprintf(expect, "long: %.*s", (int)(128 - 32 - 1 - 6), long_str);
+    assert(strcmp(messages[3], expect) == 0);
+    assert(strcmp(messages[4], "double: 3.14, int64: -1234567890123") == 0);
+
+    log_recorder_destroy(&recorder);
+    unlink(DUMP_FILENAME);
+}
+
+static void bench()
+{
+    int64_t start_time;
+    int64_t time_used;
+    int i;
+
+    assert(log_init_ex(&context) == 0);
+    assert(log_set_flight_recorder_ex(&context, LOG_DEBUG, NULL) == 0);
+    start_time = get_current_time_us();
+    for (i=0; i<LOOP_COUNT * 10; i++) {
+        logDebugEx(&context, "seq: %d", i);
+    }
+    time_used = get_current_time_us() - start_time;
+    printf("record %d short messages, time used: %"PRId64" ms, "
+            "%"PRId64" ns per message\n", LOOP_COUNT * 10, time_used / 1000,
+            time_used * 1000 / (LOOP_COUNT * 10));
+    log_destroy_ex(&context);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+
+    test_threads();
+    test_deferred_format();
+    test_signal();
+    test_crash();
+    bench();
+
+    rmdir(BASE_PATH);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define BASE_PATH     "/tmp/fc_logger_async_test"
+#define THREAD_COUNT  4
+#define LOOP_COUNT    100000
+
+static LogContext log_context;
+
+static void *log_thread_func(void *arg)
+{
+    long thread_index;
+    int i;
+
+    thread_index = (long)arg;
+    for (i=0; i<LOOP_COUNT; i++) {
+        logInfoEx(&log_context, "thread: %ld, seq: %d, some text to make "
+                "the line a little longer", thread_index, i);
+    }
+    return NULL;
+}
+
+static int64_t run_threads()
+{
+    pthread_t tids[THREAD_COUNT];
+    int64_t start_time;
+    long i;
+
+    start_time = get_current_time_us();
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, log_thread_func,
+                    (void *)i) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return get_current_time_us() - start_time;
+}
+
+static void remove_log_files()
+{
+    char cmd[256];
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s/logs", BASE_PATH);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "exec %s fail\n", cmd);
+    }
+}
+
+//check the line count and the order of the lines of every thread
+static int check_log_file(const char *filename, int *last_seqs)
+{
+    FILE *fp;
+    char line[1024];
+    char *p;
+    long thread_index;
+    int seq;
+    int count;
+
+    assert((fp=fopen(filename, "r")) != NULL);
+    count = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        assert((p=strstr(line, "INFO - thread: ")) != NULL);
+        assert(sscanf(p, "INFO - thread: %ld, seq: %d",
+                    &thread_index, &seq) == 2);
+        assert(thread_index >= 0 && thread_index < THREAD_COUNT);
+        assert(seq > last_seqs[thread_index]);
+        last_seqs[thread_index] = seq;
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static int check_log_files()
+{
+    char filename[512];
+    int last_seqs[THREAD_COUNT];
+    DIR *dir;
+    struct dirent *ent;
+    int rotated_count;
+    int count;
+    int i;
+
+    for (i=0; i<THREAD_COUNT; i++) {
+        last_seqs[i] = -1;
+    }
+
+    //the rotated file first
+    count = 0;
+    rotated_count = 0;
+    assert((dir=opendir(BASE_PATH"/logs")) != NULL);
+    while ((ent=readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, "async.log.", 10) == 0) {
+            snprintf(filename, sizeof(filename), "%s/logs/%s",
+                    BASE_PATH, ent->d_name);
+            count += check_log_file(filename, last_seqs);
+            rotated_count++;
+        }
+    }
+    closedir(dir);
+    assert(rotated_count == 1);
+
+    count += check_log_file(BASE_PATH"/logs/async.log", last_seqs);
+    return count;
+}
+
+static void *rotate_thread_func(void *arg)
+{
+    usleep(20 * 1000);
+    log_notify_rotate(&log_context);
+    return NULL;
+}
+
+static void test_async_and_rotate()
+{
+    LogAsyncStats stats;
+    pthread_t tid;
+    int64_t sync_time;
+    int64_t async_time;
+
+    remove_log_files();
+    assert(log_init_ex(&log_context) == 0);
+    log_set_time_precision(&log_context, LOG_TIME_PRECISION_USECOND);
+    assert(log_set_prefix_ex(&log_context, BASE_PATH, "sync") == 0);
+    sync_time = run_threads();
+    log_destroy_ex(&log_context);
+
+    assert(log_init_ex(&log_context) == 0);
+    log_set_time_precision(&log_context, LOG_TIME_PRECISION_USECOND);
+    assert(log_set_prefix_ex(&log_context, BASE_PATH, "async") == 0);
+    assert(log_set_async_ex(&log_context, 1024 * 1024, 10,
+                LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+    assert(log_set_async_ex(&log_context, 1024 * 1024, 10,
+                LOG_ASYNC_OVERFLOW_BLOCK) == EEXIST);
+
+    assert(pthread_create(&tid, NULL, rotate_thread_func, NULL) == 0);
+    async_time = run_threads();
+    pthread_join(tid, NULL);
+
+    assert(log_get_async_stats(&log_context, &stats) == 0);
+    log_destroy_ex(&log_context);
+
+    assert(check_log_files() == THREAD_COUNT * LOOP_COUNT);
+    printf("%d threads log %d lines, sync mode: %"PRId64" ms, "
+            "async mode: %"PRId64" ms, blocked count: %"PRId64"\n",
+            THREAD_COUNT, THREAD_COUNT * LOOP_COUNT, sync_time / 1000,
+            async_time / 1000, stats.blocked_count);
+}
+
+static void test_overflow()
+{
+    LogAsyncStats stats;
+
+    remove_log_files();
+    assert(log_init_ex(&log_context) == 0);
+    assert(log_set_prefix_ex(&log_context, BASE_PATH, "count") == 0);
+    assert(log_set_async_ex(&log_context, 0, 1000, 'x') == EINVAL);
+    assert(log_set_async_ex(&log_context, 0, 1000,
+                LOG_ASYNC_OVERFLOW_COUNT) == 0);
+    run_threads();
+
+    //wait for the flusher thread
+    do {
+        usleep(10 * 1000);
+        assert(log_get_async_stats(&log_context, &stats) == 0);
+    } while (stats.message_count + stats.dropped_count <
+            THREAD_COUNT * LOOP_COUNT);
+    assert(stats.message_count + stats.dropped_count ==
+            THREAD_COUNT * LOOP_COUNT);
+    printf("overflow count policy, written: %"PRId64", "
+            "dropped: %"PRId64"\n", stats.message_count,
+            stats.dropped_count);
+    log_destroy_ex(&log_context);
+}
+
+static int header_count;
+
+//called by the flusher thread when rotating
+static void header_callback(LogContext *pContext)
+{
+    header_count++;
+    logInfoEx(pContext, "the header line: %d", header_count);
+}
+
+//the size of the batch written after the rotation MUST be counted
+static void test_rotate_size()
+{
+    LogAsyncStats stats;
+    struct stat st;
+    int i;
+
+    remove_log_files();
+    assert(log_init_ex(&log_context) == 0);
+    assert(log_set_prefix_ex(&log_context, BASE_PATH, "size") == 0);
+    log_context.rotate_size = 512 * 1024;  //rotate once
+    log_set_header_callback(&log_context, header_callback);
+    header_count = 0;
+    assert(log_set_async_ex(&log_context, 0, 10,
+                LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+    for (i=0; i<LOOP_COUNT / 10; i++) {
+        logInfoEx(&log_context, "seq: %d, some text to make "
+                "the line a little longer", i);
+    }
+
+    do {
+        usleep(10 * 1000);
+        assert(log_get_async_stats(&log_context, &stats) == 0);
+    } while (stats.message_count < LOOP_COUNT / 10);
+
+    pthread_mutex_lock(&log_context.log_thread_lock);
+    assert(fstat(log_context.log_fd, &st) == 0);
+    assert(log_context.current_size == st.st_size);
+    assert(st.st_size <= log_context.rotate_size);
+    pthread_mutex_unlock(&log_context.log_thread_lock);
+    assert(header_count == 1);
+    log_destroy_ex(&log_context);
+}
+
+int main(int argc, char *argv[])
+{
+    log_init();
+    if (access(BASE_PATH, F_OK) != 0) {
+        assert(mkdir(BASE_PATH, 0755) == 0);
+    }
+    test_async_and_rotate();
+    test_overflow();
+    test_rotate_size();
+    remove_log_files();
+
+    printf("pass OK\n");
+    return 0;
+}
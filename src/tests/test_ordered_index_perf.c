@@ -0,0 +1,1079 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//benchmark of the ordered indexes: the skiplists, the avl tree and the B+tree
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#endif
+#include "fastcommon/common_define.h"
+#ifdef OS_LINUX
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/uniq_skiplist.h"
+#include "fastcommon/flat_skiplist.h"
+#include "fastcommon/multi_skiplist.h"
+#include "fastcommon/skiplist_set.h"
+#include "fastcommon/typed_skiplist.h"
+#include "fastcommon/avl_tree.h"
+#include "fastcommon/uniq_bptree.h"
+
+#define LEVEL_COUNT         20
+#define LATENCY_SAMPLE_MASK  7   //sample one of every 8 operations
+#define KEY_SCRAMBLE    0x9E3779B97F4A7C15ULL
+
+typedef enum {
+    DISTRIBUTION_SEQUENTIAL,
+    DISTRIBUTION_RANDOM,
+    DISTRIBUTION_ZIPFIAN,
+    DISTRIBUTION_COUNT
+} KeyDistribution;
+
+typedef struct {
+    const char *name;
+    int find_percent;
+    int scan_percent;  //the remain are the writes
+} WorkloadMix;
+
+static const char *distribution_names[DISTRIBUTION_COUNT] = {
+    "sequential", "random", "zipfian"
+};
+
+static const WorkloadMix workload_mixes[] = {
+    {"read_heavy",  95,  0},
+    {"write_heavy", 50,  0},
+    {"range_scan",   0, 95}
+};
+
+#define WORKLOAD_COUNT (sizeof(workload_mixes) / sizeof(workload_mixes[0]))
+
+struct ordered_index;
+
+typedef struct {
+    const char *name;
+    bool lock_free;  //the operations need not the rwlock
+    int (*create)(struct ordered_index *index);
+    void (*destroy)(struct ordered_index *index);
+    int (*insert)(struct ordered_index *index, int64_t *data);  //0 or EEXIST
+    int (*delete)(struct ordered_index *index, int64_t *data);  //0 or ENOENT
+    void *(*find)(struct ordered_index *index, int64_t *data);
+    int (*scan)(struct ordered_index *index, int64_t *start, const int limit);
+} OrderedIndexOps;
+
+typedef struct ordered_index {
+    const OrderedIndexOps *ops;
+    pthread_rwlock_t rwlock;
+    union {
+        struct {
+            UniqSkiplistFactory factory;
+            UniqSkiplist *sl;
+        } uniq;
+        struct {
+            UniqBPTreeFactory factory;
+            UniqBPTree *tree;
+        } bptree;
+        FlatSkiplist flat;
+        MultiSkiplist multi;
+        SkiplistSet set;
+        Int64Skiplist typed;
+        AVLTreeInfo avl;
+    };
+} OrderedIndex;
+
+typedef struct {
+    OrderedIndex *index;
+    int64_t *keys;     //the pregenerated keys
+    int64_t *latencies;
+    int latency_count;
+    int op_count;
+    int scan_length;
+    const WorkloadMix *mix;
+    uint64_t rand_state;
+} BenchThread;
+
+typedef struct {
+    int64_t element_count;
+    int64_t key_mask;     //the key space is key_mask + 1, a power of 2
+    int ops_per_thread;
+    int max_threads;
+    int scan_length;
+    FILE *output;
+} BenchConfig;
+
+static BenchConfig config;
+static int64_t *key_values;  //key_values[k] == k, the data of the indexes
+static double *zipf_cdf;     //the cdf of zipf(s = 1) over the key space
+static volatile bool start_flag = false;
+
+static int compare_int64(const void *p1, const void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+static int compare_int64_avl(void *p1, void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+static inline uint64_t bench_rand(uint64_t *state)
+{
+    uint64_t x;
+
+    x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* ---------------------------- uniq_skiplist ---------------------------- */
+static int uniq_create_ex(OrderedIndex *index, const bool concurrent)
+{
+    int result;
+
+    if ((result=uniq_skiplist_init_ex2(&index->uniq.factory, LEVEL_COUNT,
+                    compare_int64, NULL, 16,
+                    SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE, 0,
+                    false, concurrent, NULL)) != 0)
+    {
+        return result;
+    }
+    if ((index->uniq.sl=uniq_skiplist_new(&index->uniq.factory,
+                    concurrent ? LEVEL_COUNT : 8)) == NULL)
+    {
+        return ENOMEM;
+    }
+    if (concurrent) {
+        return uniq_skiplist_set_concurrent(index->uniq.sl,
+                config.max_threads + 1);
+    }
+    return 0;
+}
+
+static int uniq_create(OrderedIndex *index)
+{
+    return uniq_create_ex(index, false);
+}
+
+static int uniq_cas_create(OrderedIndex *index)
+{
+    return uniq_create_ex(index, true);
+}
+
+static void uniq_destroy(OrderedIndex *index)
+{
+    uniq_skiplist_free(index->uniq.sl);
+    uniq_skiplist_destroy(&index->uniq.factory);
+}
+
+static int uniq_insert(OrderedIndex *index, int64_t *data)
+{
+    return uniq_skiplist_insert(index->uniq.sl, data);
+}
+
+static int uniq_delete(OrderedIndex *index, int64_t *data)
+{
+    return uniq_skiplist_delete(index->uniq.sl, data);
+}
+
+static void *uniq_find(OrderedIndex *index, int64_t *data)
+{
+    void *found;
+
+    uniq_skiplist_read_lock(index->uniq.sl);
+    found = uniq_skiplist_find(index->uniq.sl, data);
+    uniq_skiplist_read_unlock(index->uniq.sl);
+    return found;
+}
+
+static int uniq_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    UniqSkiplistIterator iterator;
+    int count;
+
+    //find_range is NOT supported in the concurrent mode
+    uniq_skiplist_read_lock(index->uniq.sl);
+    iterator.tail = index->uniq.factory.tail;
+    iterator.current = uniq_skiplist_find_ge_node(index->uniq.sl, start);
+    if (iterator.current == NULL) {
+        iterator.current = iterator.tail;
+    }
+    count = 0;
+    while (count < limit && uniq_skiplist_next(&iterator) != NULL) {
+        count++;
+    }
+    uniq_skiplist_read_unlock(index->uniq.sl);
+    return count;
+}
+
+/* ---------------------------- flat_skiplist ---------------------------- */
+static int flat_create(OrderedIndex *index)
+{
+    return flat_skiplist_init(&index->flat, LEVEL_COUNT,
+            compare_int64, NULL);
+}
+
+static void flat_destroy(OrderedIndex *index)
+{
+    flat_skiplist_destroy(&index->flat);
+}
+
+static int flat_insert(OrderedIndex *index, int64_t *data)
+{
+    return flat_skiplist_insert(&index->flat, data);
+}
+
+static int flat_delete(OrderedIndex *index, int64_t *data)
+{
+    return flat_skiplist_delete(&index->flat, data);
+}
+
+static void *flat_find(OrderedIndex *index, int64_t *data)
+{
+    return flat_skiplist_find(&index->flat, data);
+}
+
+static int flat_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    FlatSkiplistIterator iterator;
+    int count;
+
+    if (flat_skiplist_find_range(&index->flat, start, key_values +
+                config.key_mask, &iterator) != 0)
+    {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && flat_skiplist_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- multi_skiplist ---------------------------- */
+static int multi_create(OrderedIndex *index)
+{
+    return multi_skiplist_init(&index->multi, LEVEL_COUNT,
+            compare_int64, NULL);
+}
+
+static void multi_destroy(OrderedIndex *index)
+{
+    multi_skiplist_destroy(&index->multi);
+}
+
+static int multi_insert(OrderedIndex *index, int64_t *data)
+{
+    return multi_skiplist_insert(&index->multi, data);
+}
+
+static int multi_delete(OrderedIndex *index, int64_t *data)
+{
+    return multi_skiplist_delete(&index->multi, data);
+}
+
+static void *multi_find(OrderedIndex *index, int64_t *data)
+{
+    return multi_skiplist_find(&index->multi, data);
+}
+
+static int multi_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    MultiSkiplistIterator iterator;
+    int count;
+
+    if (multi_skiplist_find_range(&index->multi, start, key_values +
+                config.key_mask, &iterator) != 0)
+    {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && multi_skiplist_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- skiplist_set ---------------------------- */
+static int set_create(OrderedIndex *index)
+{
+    return skiplist_set_init(&index->set, LEVEL_COUNT,
+            compare_int64, NULL);
+}
+
+static void set_destroy(OrderedIndex *index)
+{
+    skiplist_set_destroy(&index->set);
+}
+
+static int set_insert(OrderedIndex *index, int64_t *data)
+{
+    return skiplist_set_insert(&index->set, data);
+}
+
+static int set_delete(OrderedIndex *index, int64_t *data)
+{
+    return skiplist_set_delete(&index->set, data);
+}
+
+static void *set_find(OrderedIndex *index, int64_t *data)
+{
+    return skiplist_set_find(&index->set, data);
+}
+
+static int set_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    SkiplistSetIterator iterator;
+    int count;
+
+    if (skiplist_set_find_range(&index->set, start, key_values +
+                config.key_mask, &iterator) != 0)
+    {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && skiplist_set_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- int64_skiplist ---------------------------- */
+static int typed_create(OrderedIndex *index)
+{
+    return int64_skiplist_init(&index->typed, LEVEL_COUNT, NULL);
+}
+
+static void typed_destroy(OrderedIndex *index)
+{
+    int64_skiplist_destroy(&index->typed);
+}
+
+static int typed_insert(OrderedIndex *index, int64_t *data)
+{
+    return int64_skiplist_insert(&index->typed, *data, data);
+}
+
+static int typed_delete(OrderedIndex *index, int64_t *data)
+{
+    return int64_skiplist_delete(&index->typed, *data);
+}
+
+static void *typed_find(OrderedIndex *index, int64_t *data)
+{
+    return int64_skiplist_find(&index->typed, *data);
+}
+
+static int typed_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    Int64SkiplistIterator iterator;
+    int count;
+
+    if (int64_skiplist_find_range(&index->typed, *start,
+                config.key_mask, &iterator) != 0)
+    {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && int64_skiplist_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- avl_tree ---------------------------- */
+static int avl_create(OrderedIndex *index)
+{
+    return avl_tree_init(&index->avl, NULL, compare_int64_avl);
+}
+
+static void avl_destroy(OrderedIndex *index)
+{
+    avl_tree_destroy(&index->avl);
+}
+
+static int avl_insert(OrderedIndex *index, int64_t *data)
+{
+    int result;
+
+    result = avl_tree_insert(&index->avl, data);
+    return (result == 1) ? 0 : (result == 0 ? EEXIST : -1 * result);
+}
+
+static int avl_delete(OrderedIndex *index, int64_t *data)
+{
+    return avl_tree_delete(&index->avl, data) == 1 ? 0 : ENOENT;
+}
+
+static void *avl_find(OrderedIndex *index, int64_t *data)
+{
+    return avl_tree_find(&index->avl, data);
+}
+
+static int avl_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    AVLTreeIterator iterator;
+    int count;
+
+    if (avl_tree_iterator_at(&index->avl, start, &iterator) != 0) {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && avl_tree_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+/* ---------------------------- uniq_bptree ---------------------------- */
+static int bptree_create(OrderedIndex *index)
+{
+    int result;
+
+    if ((result=uniq_bptree_init_int64(&index->bptree.factory,
+                    0, NULL)) != 0)
+    {
+        return result;
+    }
+    if ((index->bptree.tree=uniq_bptree_new(
+                    &index->bptree.factory)) == NULL)
+    {
+        return ENOMEM;
+    }
+    return 0;
+}
+
+static void bptree_destroy(OrderedIndex *index)
+{
+    uniq_bptree_free(index->bptree.tree);
+    uniq_bptree_destroy(&index->bptree.factory);
+}
+
+static int bptree_insert(OrderedIndex *index, int64_t *data)
+{
+    return uniq_bptree_insert(index->bptree.tree, data);
+}
+
+static int bptree_delete(OrderedIndex *index, int64_t *data)
+{
+    return uniq_bptree_delete(index->bptree.tree, data);
+}
+
+static void *bptree_find(OrderedIndex *index, int64_t *data)
+{
+    return uniq_bptree_find(index->bptree.tree, data);
+}
+
+static int bptree_scan(OrderedIndex *index, int64_t *start, const int limit)
+{
+    UniqBPTreeIterator iterator;
+    int count;
+
+    if (uniq_bptree_find_range(index->bptree.tree, start, key_values +
+                config.key_mask, &iterator) != 0)
+    {
+        return 0;
+    }
+    count = 0;
+    while (count < limit && uniq_bptree_next(&iterator) != NULL) {
+        count++;
+    }
+    return count;
+}
+
+static const OrderedIndexOps index_ops_array[] = {
+    {"uniq_skiplist", false, uniq_create, uniq_destroy,
+        uniq_insert, uniq_delete, uniq_find, uniq_scan},
+    {"uniq_skiplist_cas", true, uniq_cas_create, uniq_destroy,
+        uniq_insert, uniq_delete, uniq_find, uniq_scan},
+    {"flat_skiplist", false, flat_create, flat_destroy,
+        flat_insert, flat_delete, flat_find, flat_scan},
+    {"multi_skiplist", false, multi_create, multi_destroy,
+        multi_insert, multi_delete, multi_find, multi_scan},
+    {"skiplist_set", false, set_create, set_destroy,
+        set_insert, set_delete, set_find, set_scan},
+    {"int64_skiplist", false, typed_create, typed_destroy,
+        typed_insert, typed_delete, typed_find, typed_scan},
+    {"avl_tree", false, avl_create, avl_destroy,
+        avl_insert, avl_delete, avl_find, avl_scan},
+    {"uniq_bptree", false, bptree_create, bptree_destroy,
+        bptree_insert, bptree_delete, bptree_find, bptree_scan}
+};
+
+#define INDEX_OPS_COUNT (sizeof(index_ops_array) / sizeof(index_ops_array[0]))
+
+/* ---------------------------- the measurements ---------------------------- */
+static inline int64_t get_time_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t get_allocated_bytes()
+{
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info;
+
+    info = mallinfo2();
+    return (int64_t)(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+#ifdef OS_LINUX
+static int cache_misses_open()
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;   //count the worker threads created after
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void cache_misses_start(const int fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static int64_t cache_misses_stop(const int fd)
+{
+    uint64_t count;
+
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return (int64_t)count;
+}
+#else
+#define cache_misses_open() -1
+#define cache_misses_start(fd)
+#define cache_misses_stop(fd) -1
+#endif
+
+static int compare_latency(const void *p1, const void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+/* ---------------------------- the key generators ---------------------------- */
+static inline int64_t scramble_key(const int64_t rank)
+{
+    //multiply by an odd constant is a bijection in the power of 2 key space
+    return (int64_t)(((uint64_t)rank * KEY_SCRAMBLE) & config.key_mask);
+}
+
+static int zipf_init()
+{
+    double sum;
+    int64_t i;
+
+    zipf_cdf = (double *)malloc(sizeof(double) * (config.key_mask + 1));
+    if (zipf_cdf == NULL) {
+        return ENOMEM;
+    }
+
+    sum = 0.0;
+    for (i=0; i<=config.key_mask; i++) {
+        sum += 1.0 / (double)(i + 1);
+        zipf_cdf[i] = sum;
+    }
+    for (i=0; i<=config.key_mask; i++) {
+        zipf_cdf[i] /= sum;
+    }
+    return 0;
+}
+
+static int64_t zipf_next(uint64_t *rand_state)
+{
+    double u;
+    int64_t low;
+    int64_t high;
+    int64_t mid;
+
+    u = (double)(bench_rand(rand_state) >> 11) / (double)(1ULL << 53);
+    low = 0;
+    high = config.key_mask;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (zipf_cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    //scramble the hot keys over the key space
+    return scramble_key(low);
+}
+
+static void generate_keys(BenchThread *thread, const int thread_index,
+        const int thread_count, const KeyDistribution distribution)
+{
+    int64_t key;
+    int i;
+
+    key = (config.key_mask + 1) / thread_count * thread_index;
+    for (i=0; i<thread->op_count; i++) {
+        switch (distribution) {
+            case DISTRIBUTION_SEQUENTIAL:
+                thread->keys[i] = key++ & config.key_mask;
+                break;
+            case DISTRIBUTION_RANDOM:
+                thread->keys[i] = bench_rand(&thread->rand_state)
+                    & config.key_mask;
+                break;
+            default:
+                thread->keys[i] = zipf_next(&thread->rand_state);
+                break;
+        }
+    }
+}
+
+/* ---------------------------- the runner ---------------------------- */
+static inline void do_write(OrderedIndex *index, int64_t *data)
+{
+    //toggle the key to keep the element count stable
+    if (index->ops->lock_free) {
+        if (index->ops->insert(index, data) == EEXIST) {
+            index->ops->delete(index, data);
+        }
+        return;
+    }
+
+    pthread_rwlock_wrlock(&index->rwlock);
+    if (index->ops->find(index, data) != NULL) {
+        index->ops->delete(index, data);
+    } else {
+        index->ops->insert(index, data);
+    }
+    pthread_rwlock_unlock(&index->rwlock);
+}
+
+static inline void do_read(OrderedIndex *index, int64_t *data,
+        const bool scan, const int scan_length)
+{
+    bool need_lock;
+
+    need_lock = !index->ops->lock_free;
+    if (need_lock) {
+        pthread_rwlock_rdlock(&index->rwlock);
+    }
+    if (scan) {
+        index->ops->scan(index, data, scan_length);
+    } else {
+        index->ops->find(index, data);
+    }
+    if (need_lock) {
+        pthread_rwlock_unlock(&index->rwlock);
+    }
+}
+
+static void *bench_thread_func(void *arg)
+{
+    BenchThread *thread;
+    OrderedIndex *index;
+    int64_t start_time;
+    int64_t *data;
+    int percent;
+    int i;
+
+    thread = (BenchThread *)arg;
+    index = thread->index;
+    while (!start_flag) {
+        sched_yield();
+    }
+
+    for (i=0; i<thread->op_count; i++) {
+        data = key_values + thread->keys[i];
+        percent = bench_rand(&thread->rand_state) % 100;
+        if ((i & LATENCY_SAMPLE_MASK) == 0) {
+            start_time = get_time_ns();
+        } else {
+            start_time = 0;
+        }
+
+        if (percent < thread->mix->find_percent) {
+            do_read(index, data, false, 0);
+        } else if (percent < thread->mix->find_percent +
+                thread->mix->scan_percent)
+        {
+            do_read(index, data, true, thread->scan_length);
+        } else {
+            do_write(index, data);
+        }
+
+        if (start_time != 0) {
+            thread->latencies[thread->latency_count++] =
+                get_time_ns() - start_time;
+        }
+    }
+
+    return NULL;
+}
+
+static void output_result(const char *index_name, const char *workload,
+        const char *distribution, const int thread_count,
+        const int64_t op_count, const int64_t time_used_ns,
+        const int64_t p50, const int64_t p99,
+        const double bytes_per_element, const int64_t cache_misses)
+{
+    double ops_per_second;
+    double misses_per_op;
+
+    ops_per_second = (double)op_count * 1000000000.0 /
+        (time_used_ns > 0 ? time_used_ns : 1);
+    misses_per_op = (cache_misses >= 0) ?
+        (double)cache_misses / op_count : -1.0;
+
+    printf("%-18s %-12s %-11s %3d %12.0f %8"PRId64" %8"PRId64
+            " %9.1f %9.2f\n", index_name, workload, distribution,
+            thread_count, ops_per_second, p50, p99,
+            bytes_per_element, misses_per_op);
+
+    if (config.output != NULL) {
+        fprintf(config.output, "%s,%s,%s,%d,%"PRId64",%.0f,%"PRId64
+                ",%"PRId64",%.1f,%.2f\n", index_name, workload,
+                distribution, thread_count, op_count, ops_per_second,
+                p50, p99, bytes_per_element, misses_per_op);
+        fflush(config.output);
+    }
+}
+
+static int run_workload(OrderedIndex *index, const WorkloadMix *mix,
+        const KeyDistribution distribution, const int thread_count,
+        const double bytes_per_element, const int perf_fd)
+{
+    BenchThread *threads;
+    pthread_t *tids;
+    int64_t *all_latencies;
+    int64_t latency_count;
+    int64_t start_time;
+    int64_t time_used;
+    int64_t cache_misses;
+    int64_t p50;
+    int64_t p99;
+    int result;
+    int i;
+
+    threads = (BenchThread *)calloc(thread_count, sizeof(BenchThread));
+    tids = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+    all_latencies = (int64_t *)malloc(sizeof(int64_t) * thread_count *
+            (config.ops_per_thread / (LATENCY_SAMPLE_MASK + 1) + 1));
+    if (threads == NULL || tids == NULL || all_latencies == NULL) {
+        return ENOMEM;
+    }
+
+    latency_count = 0;
+    for (i=0; i<thread_count; i++) {
+        threads[i].index = index;
+        threads[i].mix = mix;
+        threads[i].op_count = config.ops_per_thread;
+        threads[i].scan_length = config.scan_length;
+        threads[i].rand_state = get_current_time_us() * (i + 1) | 1;
+        threads[i].latencies = all_latencies + latency_count;
+        latency_count += config.ops_per_thread /
+            (LATENCY_SAMPLE_MASK + 1) + 1;
+        threads[i].keys = (int64_t *)malloc(sizeof(int64_t) *
+                config.ops_per_thread);
+        if (threads[i].keys == NULL) {
+            return ENOMEM;
+        }
+        generate_keys(threads + i, i, thread_count, distribution);
+    }
+
+    start_flag = false;
+    cache_misses_start(perf_fd);
+    for (i=0; i<thread_count; i++) {
+        if ((result=pthread_create(tids + i, NULL, bench_thread_func,
+                        threads + i)) != 0)
+        {
+            fprintf(stderr, "pthread_create fail, errno: %d\n", result);
+            return result;
+        }
+    }
+
+    start_time = get_time_ns();
+    start_flag = true;
+    for (i=0; i<thread_count; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    time_used = get_time_ns() - start_time;
+    cache_misses = cache_misses_stop(perf_fd);
+
+    //compact the latency samples of all threads
+    latency_count = 0;
+    for (i=0; i<thread_count; i++) {
+        memmove(all_latencies + latency_count, threads[i].latencies,
+                sizeof(int64_t) * threads[i].latency_count);
+        latency_count += threads[i].latency_count;
+        free(threads[i].keys);
+    }
+    qsort(all_latencies, latency_count, sizeof(int64_t), compare_latency);
+    p50 = latency_count > 0 ? all_latencies[latency_count / 2] : 0;
+    p99 = latency_count > 0 ? all_latencies[latency_count * 99 / 100] : 0;
+
+    output_result(index->ops->name, mix->name,
+            distribution_names[distribution], thread_count,
+            (int64_t)config.ops_per_thread * thread_count,
+            time_used, p50, p99, bytes_per_element, cache_misses);
+
+    free(all_latencies);
+    free(tids);
+    free(threads);
+    return 0;
+}
+
+static int bench_index(const OrderedIndexOps *ops, const int perf_fd)
+{
+    OrderedIndex index;
+    int64_t alloc_bytes;
+    int64_t start_time;
+    int64_t cache_misses;
+    double bytes_per_element;
+    int thread_count;
+    int distribution;
+    int workload;
+    int result;
+    int64_t i;
+
+    memset(&index, 0, sizeof(index));
+    index.ops = ops;
+    if ((result=pthread_rwlock_init(&index.rwlock, NULL)) != 0) {
+        return result;
+    }
+
+    alloc_bytes = get_allocated_bytes();
+    if ((result=ops->create(&index)) != 0) {
+        fprintf(stderr, "create %s fail, errno: %d\n", ops->name, result);
+        return result;
+    }
+
+    //load the elements in the random order
+    cache_misses_start(perf_fd);
+    start_time = get_time_ns();
+    for (i=0; i<config.element_count; i++) {
+        if ((result=ops->insert(&index, key_values +
+                        scramble_key(i))) != 0)
+        {
+            fprintf(stderr, "%s insert fail, errno: %d\n",
+                    ops->name, result);
+            return result;
+        }
+    }
+    start_time = get_time_ns() - start_time;
+    cache_misses = cache_misses_stop(perf_fd);
+
+    if (alloc_bytes >= 0) {
+        bytes_per_element = (double)(get_allocated_bytes() -
+                alloc_bytes) / config.element_count;
+    } else {
+        bytes_per_element = -1.0;
+    }
+    output_result(ops->name, "load", "random", 1, config.element_count,
+            start_time, 0, 0, bytes_per_element, cache_misses);
+
+    for (workload=0; workload<WORKLOAD_COUNT; workload++) {
+        for (distribution=0; distribution<DISTRIBUTION_COUNT;
+                distribution++)
+        {
+            thread_count = 1;
+            while (1) {
+                if ((result=run_workload(&index, workload_mixes + workload,
+                                distribution, thread_count,
+                                bytes_per_element, perf_fd)) != 0)
+                {
+                    return result;
+                }
+
+                if (thread_count >= config.max_threads) {
+                    break;
+                }
+                thread_count *= 2;
+                if (thread_count > config.max_threads) {
+                    thread_count = config.max_threads;
+                }
+            }
+        }
+    }
+
+    ops->destroy(&index);
+    pthread_rwlock_destroy(&index.rwlock);
+    return 0;
+}
+
+static void usage(const char *program)
+{
+    int i;
+
+    fprintf(stderr, "Usage: %s [-n elements=%"PRId64"] "
+            "[-c ops per thread=%d] [-t max threads=%d] "
+            "[-l scan length=%d] [-o csv output filename] "
+            "[index name ...]\n\tthe index names:", program,
+            config.element_count, config.ops_per_thread,
+            config.max_threads, config.scan_length);
+    for (i=0; i<INDEX_OPS_COUNT; i++) {
+        fprintf(stderr, " %s", index_ops_array[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_filename;
+    bool selected;
+    int64_t key_space;
+    int perf_fd;
+    int result;
+    int ch;
+    int i;
+    int k;
+
+    config.element_count = 1000000;
+    config.ops_per_thread = 200000;
+    config.max_threads = 4;
+    config.scan_length = 100;
+    output_filename = NULL;
+    while ((ch=getopt(argc, argv, "hn:c:t:l:o:")) != -1) {
+        switch (ch) {
+            case 'n':
+                config.element_count = strtoll(optarg, NULL, 10);
+                break;
+            case 'c':
+                config.ops_per_thread = atoi(optarg);
+                break;
+            case 't':
+                config.max_threads = atoi(optarg);
+                break;
+            case 'l':
+                config.scan_length = atoi(optarg);
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : EINVAL;
+        }
+    }
+    if (config.element_count <= 0 || config.ops_per_thread <= 0 ||
+            config.max_threads <= 0 || config.scan_length <= 0)
+    {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    log_init();
+
+    //the key space is a power of 2 and at least twice of the elements
+    key_space = 2;
+    while (key_space < 2 * config.element_count) {
+        key_space *= 2;
+    }
+    config.key_mask = key_space - 1;
+    key_values = (int64_t *)malloc(sizeof(int64_t) * key_space);
+    if (key_values == NULL) {
+        return ENOMEM;
+    }
+    for (i=0; i<key_space; i++) {
+        key_values[i] = i;
+    }
+    if ((result=zipf_init()) != 0) {
+        return result;
+    }
+
+    if (output_filename != NULL) {
+        if ((config.output=fopen(output_filename, "w")) == NULL) {
+            result = errno != 0 ? errno : EIO;
+            fprintf(stderr, "open file %s fail, errno: %d, error info: %s\n",
+                    output_filename, result, STRERROR(result));
+            return result;
+        }
+        fprintf(config.output, "index,workload,distribution,threads,ops,"
+                "ops_per_second,p50_ns,p99_ns,bytes_per_element,"
+                "cache_misses_per_op\n");
+    }
+
+    if ((perf_fd=cache_misses_open()) < 0) {
+        fprintf(stderr, "perf_event_open fail, the cache misses "
+                "are reported as -1\n");
+    }
+
+    printf("elements: %"PRId64", key space: %"PRId64", ops per thread: %d, "
+            "max threads: %d, scan length: %d\n\n", config.element_count,
+            key_space, config.ops_per_thread, config.max_threads,
+            config.scan_length);
+    printf("%-18s %-12s %-11s %3s %12s %8s %8s %9s %9s\n", "index",
+            "workload", "keys", "thr", "ops/s", "p50(ns)", "p99(ns)",
+            "bytes/elt", "miss/op");
+
+    for (i=0; i<INDEX_OPS_COUNT; i++) {
+        selected = (optind >= argc);
+        for (k=optind; k<argc; k++) {
+            if (strcmp(argv[k], index_ops_array[i].name) == 0) {
+                selected = true;
+                break;
+            }
+        }
+        if (!selected) {
+            continue;
+        }
+
+        if ((result=bench_index(index_ops_array + i, perf_fd)) != 0) {
+            return result;
+        }
+    }
+
+    if (perf_fd >= 0) {
+        close(perf_fd);
+    }
+    if (config.output != NULL) {
+        fclose(config.output);
+    }
+    free(zipf_cdf);
+    free(key_values);
+    return 0;
+}
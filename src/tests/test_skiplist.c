@@ -385,6 +385,86 @@ static void test_find_range()
     printf("count: %d\n\n", i);
 }
 
+static void check_flat_ranks(FlatSkiplist *flat)
+{
+    FlatSkiplistIterator it;
+    Record *record;
+    Record *previous;
+    int index;
+    int rank;
+    int count;
+
+    index = 0;
+    previous = NULL;
+    flat_skiplist_iterator(flat, &it);
+    while ((record=(Record *)flat_skiplist_next(&it)) != NULL) {
+        assert(flat_skiplist_nth(flat, index) == record);
+        if (previous == NULL || previous->key != record->key) {
+            assert(flat_skiplist_rank(flat, record, &rank) == 0);
+            assert(rank == index);
+        }
+        previous = record;
+        index++;
+    }
+    assert(index == flat_skiplist_count(flat));
+    assert(flat_skiplist_nth(flat, index) == NULL);
+    if (previous != NULL) {
+        assert(flat_skiplist_count_range(flat, flat_skiplist_nth(flat, 0),
+                    previous, &count) == 0);
+        assert(count == index);
+    }
+}
+
+static void test_flat_rank()
+{
+#define FLAT_RECORD_COUNT  100000
+#define FLAT_KEY_COUNT       1000
+    FlatSkiplist flat;
+    Record *records;
+    Record start;
+    Record end;
+    int64_t start_time;
+    int count;
+    int rank;
+    int i;
+
+    records = (Record *)malloc(sizeof(Record) * FLAT_RECORD_COUNT);
+    assert(flat_skiplist_init_ex(&flat, LEVEL_COUNT, compare_record,
+                NULL, MIN_ALLOC_ONCE) == 0);
+    for (i=0; i<FLAT_RECORD_COUNT; i++) {
+        records[i].line = i;
+        records[i].key = rand() % FLAT_KEY_COUNT;
+        assert(flat_skiplist_insert(&flat, records + i) == 0);
+    }
+    check_flat_ranks(&flat);
+
+    start.key = -1;
+    assert(flat_skiplist_rank(&flat, &start, &rank) == ENOENT);
+    start.key = 10;
+    end.key = 9;
+    assert(flat_skiplist_count_range(&flat, &start, &end, &count) == EINVAL);
+
+    start_time = get_current_time_us();
+    for (i=0; i<FLAT_RECORD_COUNT; i++) {
+        start.key = records[i].key;
+        end.key = start.key + 10;
+        assert(flat_skiplist_count_range(&flat, &start, &end, &count) == 0);
+        assert(count > 0);
+    }
+    printf("flat skiplist count_range time used: %"PRId64" ns\n",
+            (get_current_time_us() - start_time) * 1000 / FLAT_RECORD_COUNT);
+
+    //delete the half and check the span widths
+    for (i=0; i<FLAT_RECORD_COUNT; i+=2) {
+        assert(flat_skiplist_delete(&flat, records + i) == 0);
+    }
+    assert(flat_skiplist_count(&flat) == FLAT_RECORD_COUNT / 2);
+    check_flat_ranks(&flat);
+
+    flat_skiplist_destroy(&flat);
+    free(records);
+}
+
 int main(int argc, char *argv[])
 {
     int result;
@@ -428,6 +508,7 @@ int main(int argc, char *argv[])
     assert(instance_count == 0);
 
     test_stable_sort();
+    test_flat_rank();
 
     printf("pass OK\n");
     return 0;
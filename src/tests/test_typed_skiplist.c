@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "fastcommon/typed_skiplist.h"
+#include "fastcommon/uniq_skiplist.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT         1000000
+#define LEVEL_COUNT   20
+#define THREAD_COUNT  4
+
+static int64_t *numbers;
+static int64_t free_count = 0;
+
+static int compare_func(const void *p1, const void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+static void free_func(void *ptr)
+{
+    free_count++;
+}
+
+static void shuffle(int64_t *array, const int count)
+{
+    int64_t tmp;
+    int i;
+    int j;
+
+    for (i=count-1; i>0; i--) {
+        j = rand() % (i + 1);
+        tmp = array[i];
+        array[i] = array[j];
+        array[j] = tmp;
+    }
+}
+
+static void test_int64()
+{
+    Int64Skiplist sl;
+    Int64SkiplistIterator iterator;
+    Int64SkiplistNode *node;
+    int64_t i;
+
+    assert(int64_skiplist_init(&sl, 0, NULL) == EINVAL);
+    assert(int64_skiplist_init(&sl, LEVEL_COUNT, free_func) == 0);
+    assert(int64_skiplist_empty(&sl));
+    for (i=0; i<COUNT; i++) {
+        assert(int64_skiplist_insert(&sl, numbers[i], numbers + i) == 0);
+    }
+    assert(int64_skiplist_insert(&sl, 0, NULL) == EEXIST);
+    assert(int64_skiplist_count(&sl) == COUNT);
+
+    for (i=0; i<COUNT; i++) {
+        assert(*(int64_t *)int64_skiplist_find(&sl, numbers[i]) == numbers[i]);
+    }
+    assert(int64_skiplist_find(&sl, COUNT) == NULL);
+    assert(int64_skiplist_find(&sl, -1) == NULL);
+
+    i = 0;
+    int64_skiplist_iterator(&sl, &iterator);
+    while ((node=int64_skiplist_next_node(&iterator)) != NULL) {
+        assert(node->key == i);
+        i++;
+    }
+    assert(i == COUNT);
+
+    for (i=0; i<COUNT; i+=2) {
+        assert(int64_skiplist_delete(&sl, i) == 0);
+        assert(int64_skiplist_delete(&sl, i) == ENOENT);
+    }
+    assert(free_count == COUNT / 2);
+    assert(int64_skiplist_count(&sl) == COUNT / 2);
+    assert(int64_skiplist_find_ge(&sl, 100)->key == 101);
+
+    assert(int64_skiplist_find_range(&sl, 100, 107, &iterator) == 0);
+    for (i=101; i<=107; i+=2) {
+        assert(*(int64_t *)int64_skiplist_next(&iterator) == i);
+    }
+    assert(int64_skiplist_next(&iterator) == NULL);
+    assert(int64_skiplist_find_range(&sl, 100, 100, &iterator) == ENOENT);
+    assert(int64_skiplist_find_range(&sl, 100, 99, &iterator) == EINVAL);
+    assert(int64_skiplist_find_range(&sl, COUNT - 1,
+                COUNT + 10, &iterator) == 0);
+    assert(int64_skiplist_next_node(&iterator)->key == COUNT - 1);
+    assert(int64_skiplist_next_node(&iterator) == NULL);
+
+    int64_skiplist_destroy(&sl);
+    assert(free_count == COUNT);
+}
+
+static void test_uint32_and_string()
+{
+    const char *words[] = {"delta", "alpha", "echo", "charlie", "bravo"};
+    const char *sorted[] = {"alpha", "bravo", "charlie", "delta", "echo"};
+    UInt32Skiplist u32;
+    StringSkiplist strs;
+    StringSkiplistIterator iterator;
+    StringSkiplistNode *node;
+    string_t key;
+    string_t end;
+    int i;
+
+    assert(uint32_skiplist_init(&u32, 8, NULL) == 0);
+    assert(uint32_skiplist_insert(&u32, UINT32_MAX, NULL) == 0);
+    assert(uint32_skiplist_insert(&u32, 0, NULL) == 0);
+    assert(uint32_skiplist_insert(&u32, 1U << 31, NULL) == 0);
+    assert(uint32_skiplist_find_ge(&u32, 1)->key == 1U << 31);
+    assert(uint32_skiplist_find_ge(&u32, (1U << 31) + 1)->key == UINT32_MAX);
+    uint32_skiplist_destroy(&u32);
+
+    assert(string_skiplist_init(&strs, 8, NULL) == 0);
+    for (i=0; i<sizeof(words) / sizeof(words[0]); i++) {
+        FC_SET_STRING(key, (char *)words[i]);
+        assert(string_skiplist_insert(&strs, key, (void *)words[i]) == 0);
+    }
+    FC_SET_STRING(key, "echo");
+    assert(string_skiplist_insert(&strs, key, NULL) == EEXIST);
+    assert(string_skiplist_find(&strs, key) == words[2]);
+
+    i = 0;
+    string_skiplist_iterator(&strs, &iterator);
+    while ((node=string_skiplist_next_node(&iterator)) != NULL) {
+        assert(strcmp(node->data, sorted[i++]) == 0);
+    }
+    assert(i == 5);
+
+    FC_SET_STRING(key, "b");
+    FC_SET_STRING(end, "d");
+    assert(string_skiplist_find_range(&strs, key, end, &iterator) == 0);
+    assert(strcmp(string_skiplist_next(&iterator), "bravo") == 0);
+    assert(strcmp(string_skiplist_next(&iterator), "charlie") == 0);
+    assert(string_skiplist_next(&iterator) == NULL);
+
+    FC_SET_STRING(key, "alpha");
+    assert(string_skiplist_delete(&strs, key) == 0);
+    assert(string_skiplist_find(&strs, key) == NULL);
+    string_skiplist_destroy(&strs);
+}
+
+static void bench_single_thread()
+{
+    UniqSkiplistFactory factory;
+    UniqSkiplist *usl;
+    Int64Skiplist sl;
+    int64_t start_time;
+    int64_t generic_insert;
+    int64_t generic_find;
+    int64_t typed_insert;
+    int64_t typed_find;
+    int i;
+
+    assert(uniq_skiplist_init_ex(&factory, LEVEL_COUNT, compare_func,
+                NULL, 16, SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE,
+                0, NULL) == 0);
+    assert((usl=uniq_skiplist_new(&factory, LEVEL_COUNT)) != NULL);
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_skiplist_insert(usl, numbers + i) == 0);
+    }
+    generic_insert = get_current_time_us() - start_time;
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_skiplist_find(usl, numbers + i) != NULL);
+    }
+    generic_find = get_current_time_us() - start_time;
+    uniq_skiplist_free(usl);
+    uniq_skiplist_destroy(&factory);
+
+    assert(int64_skiplist_init(&sl, LEVEL_COUNT, NULL) == 0);
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(int64_skiplist_insert(&sl, numbers[i], numbers + i) == 0);
+    }
+    typed_insert = get_current_time_us() - start_time;
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(int64_skiplist_find(&sl, numbers[i]) != NULL);
+    }
+    typed_find = get_current_time_us() - start_time;
+    int64_skiplist_destroy(&sl);
+
+    printf("%d random int64, uniq_skiplist insert: %"PRId64" ms, "
+            "find: %"PRId64" ms; int64_skiplist insert: %"PRId64" ms, "
+            "find: %"PRId64" ms\n", COUNT, generic_insert / 1000,
+            generic_find / 1000, typed_insert / 1000, typed_find / 1000);
+}
+
+static void *insert_thread_func(void *arg)
+{
+    Int64Skiplist sl;
+    int i;
+
+    //every thread inserts into its own skiplist
+    assert(int64_skiplist_init(&sl, LEVEL_COUNT, NULL) == 0);
+    for (i=0; i<COUNT / THREAD_COUNT; i++) {
+        assert(int64_skiplist_insert(&sl, numbers[i], NULL) == 0);
+    }
+    int64_skiplist_destroy(&sl);
+    return NULL;
+}
+
+static void bench_multi_thread()
+{
+    pthread_t tids[THREAD_COUNT];
+    int64_t start_time;
+    int i;
+
+    start_time = get_current_time_us();
+    for (i=0; i<THREAD_COUNT; i++) {
+        assert(pthread_create(tids + i, NULL, insert_thread_func, NULL) == 0);
+    }
+    for (i=0; i<THREAD_COUNT; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    printf("%d threads insert %d int64 into the separate skiplists, "
+            "time used: %"PRId64" ms\n", THREAD_COUNT, COUNT / THREAD_COUNT,
+            (get_current_time_us() - start_time) / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    log_init();
+    srand(time(NULL));
+    numbers = (int64_t *)malloc(sizeof(int64_t) * COUNT);
+    assert(numbers != NULL);
+    for (i=0; i<COUNT; i++) {
+        numbers[i] = i;
+    }
+    shuffle(numbers, COUNT);
+
+    test_int64();
+    test_uint32_and_string();
+    bench_single_thread();
+    bench_multi_thread();
+
+    free(numbers);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+#include "fastcommon/uniq_bptree.h"
+#include "fastcommon/uniq_skiplist.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+
+#define COUNT        1000000
+#define RANGE_COUNT  100000
+#define RANGE_SIZE   100
+
+typedef struct {
+    int64_t key;
+    int64_t value;
+} Record;
+
+static Record *records;
+static Record **shuffled;
+static int64_t free_count = 0;
+
+static int compare_func(const void *p1, const void *p2)
+{
+    return fc_compare_int64(((Record *)p1)->key, ((Record *)p2)->key);
+}
+
+static void free_func(UniqBPTree *tree, void *ptr)
+{
+    free_count++;
+}
+
+static void shuffle()
+{
+    Record *tmp;
+    int i;
+    int j;
+
+    for (i=COUNT-1; i>0; i--) {
+        j = rand() % (i + 1);
+        tmp = shuffled[i];
+        shuffled[i] = shuffled[j];
+        shuffled[j] = tmp;
+    }
+}
+
+/* return the element count of the subtree */
+static int check_node(UniqBPTree *tree, UniqBPTreeNode *node,
+        const int depth, Record *low, Record *high, UniqBPTreeNode **leaf)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeNode **children;
+    UniqBPTreeKey *keys;
+    Record **datas;
+    Record *sep;
+    int count;
+    int i;
+
+    factory = tree->factory;
+    if (node != tree->root) {
+        assert(node->count >= (node->leaf ? factory->leaf_capacity :
+                    factory->internal_capacity) / 2);
+    }
+
+    if (node->leaf) {
+        assert(depth == tree->height);
+        assert(node->prev == *leaf);
+        assert(*leaf == NULL ? tree->head == node : (*leaf)->next == node);
+        *leaf = node;
+        datas = (Record **)UNIQ_BPTREE_DATAS(factory, node);
+        for (i=0; i<node->count; i++) {
+            if (factory->key_offset >= 0) {
+                assert(UNIQ_BPTREE_KEYS(node)[i].n == datas[i]->key);
+            }
+            assert(i == 0 || datas[i - 1]->key < datas[i]->key);
+            assert(low == NULL || low->key <= datas[i]->key);
+            assert(high == NULL || datas[i]->key < high->key);
+        }
+        return node->count;
+    }
+
+    keys = UNIQ_BPTREE_KEYS(node);
+    children = UNIQ_BPTREE_CHILDREN(factory, node);
+    count = 0;
+    for (i=0; i<=node->count; i++) {
+        if (i < node->count) {
+            if (factory->key_offset >= 0) {
+                sep = records + keys[i].n;
+            } else {
+                //the separator must be the live data
+                sep = (Record *)keys[i].data;
+                assert(uniq_bptree_find(tree, sep) == sep);
+            }
+        } else {
+            sep = high;
+        }
+        count += check_node(tree, children[i], depth + 1, low, sep, leaf);
+        low = sep;
+    }
+    return count;
+}
+
+static void check_tree(UniqBPTree *tree)
+{
+    UniqBPTreeNode *leaf;
+
+    leaf = NULL;
+    assert(check_node(tree, tree->root, 1, NULL, NULL, &leaf) ==
+            uniq_bptree_count(tree));
+    assert(tree->tail == leaf);
+}
+
+static void test_tree(const int node_size, const bool int_mode)
+{
+    UniqBPTreeFactory factory;
+    UniqBPTree *tree;
+    UniqBPTreeIterator iterator;
+    Record target;
+    Record end;
+    Record *record;
+    Record copy;
+    int64_t start_time;
+    int64_t insert_time;
+    int64_t find_time;
+    int64_t delete_time;
+    int count;
+    int i;
+
+    assert(uniq_bptree_init_ex(&factory, node_size, int_mode ? NULL :
+                compare_func, free_func, int_mode ? (int)offsetof(
+                    Record, key) : -1, 1024, false, NULL) == 0);
+    assert((tree=uniq_bptree_new(&factory)) != NULL);
+    assert(uniq_bptree_get_first(tree) == NULL);
+    uniq_bptree_iterator(tree, &iterator);
+    assert(uniq_bptree_next(&iterator) == NULL);
+
+    shuffle();
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_bptree_insert(tree, shuffled[i]) == 0);
+    }
+    insert_time = get_current_time_us() - start_time;
+    assert(uniq_bptree_insert(tree, records) == EEXIST);
+    assert(uniq_bptree_count(tree) == COUNT);
+    check_tree(tree);
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        target.key = shuffled[i]->key;
+        assert(uniq_bptree_find(tree, &target) == shuffled[i]);
+    }
+    find_time = get_current_time_us() - start_time;
+
+    target.key = COUNT;
+    assert(uniq_bptree_find(tree, &target) == NULL);
+    assert(uniq_bptree_find_ge(tree, &target) == NULL);
+    assert(uniq_bptree_get_first(tree) == records);
+    assert(uniq_bptree_get_last(tree) == records + COUNT - 1);
+
+    count = 0;
+    uniq_bptree_iterator(tree, &iterator);
+    while ((record=(Record *)uniq_bptree_next(&iterator)) != NULL) {
+        assert(record == records + count);
+        count++;
+    }
+    assert(count == COUNT);
+
+    //the replace keeps the separators valid
+    for (i=0; i<COUNT; i+=3) {
+        copy = records[i];
+        assert(uniq_bptree_replace_ex(tree, &copy, false) == 0);
+        assert(uniq_bptree_find(tree, records + i) == &copy);
+        assert(uniq_bptree_replace_ex(tree, records + i, false) == 0);
+    }
+
+    //delete the odd
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        if (shuffled[i]->key % 2 == 1) {
+            assert(uniq_bptree_delete(tree, shuffled[i]) == 0);
+        }
+    }
+    delete_time = get_current_time_us() - start_time;
+    assert(free_count == COUNT / 2);
+    assert(uniq_bptree_delete(tree, records + 1) == ENOENT);
+    assert(uniq_bptree_count(tree) == COUNT / 2);
+    check_tree(tree);
+
+    target.key = 101;
+    assert(uniq_bptree_find(tree, &target) == NULL);
+    assert(uniq_bptree_find_ge(tree, &target) == records + 102);
+
+    target.key = 101;
+    end.key = 109;
+    assert(uniq_bptree_find_range(tree, &target, &end, &iterator) == 0);
+    for (i=102; i<=108; i+=2) {
+        assert(uniq_bptree_next(&iterator) == records + i);
+    }
+    assert(uniq_bptree_next(&iterator) == NULL);
+
+    target.key = 100;
+    end.key = 100;
+    assert(uniq_bptree_find_range(tree, &target, &end, &iterator) == 0);
+    assert(uniq_bptree_next(&iterator) == records + 100);
+    assert(uniq_bptree_next(&iterator) == NULL);
+
+    target.key = 101;
+    end.key = 101;
+    assert(uniq_bptree_find_range(tree, &target, &end, &iterator) == ENOENT);
+    assert(uniq_bptree_next(&iterator) == NULL);
+    end.key = 99;
+    assert(uniq_bptree_find_range(tree, &target, &end, &iterator) == EINVAL);
+    end.key = COUNT + 100;
+    target.key = COUNT - 2;
+    assert(uniq_bptree_find_range(tree, &target, &end, &iterator) == 0);
+    assert(uniq_bptree_next(&iterator) == records + COUNT - 2);
+    assert(uniq_bptree_next(&iterator) == NULL);
+
+    //delete all, the tree shrinks to a leaf
+    for (i=0; i<COUNT; i++) {
+        if (shuffled[i]->key % 2 == 0) {
+            assert(uniq_bptree_delete_ex(tree, shuffled[i], false) == 0);
+            if (i % 100000 == 0) {
+                check_tree(tree);
+            }
+        }
+    }
+    assert(uniq_bptree_count(tree) == 0);
+    assert(tree->height == 1);
+    check_tree(tree);
+
+    for (i=0; i<1000; i++) {
+        assert(uniq_bptree_insert(tree, records + i) == 0);
+    }
+    uniq_bptree_clear(tree);
+    assert(uniq_bptree_count(tree) == 0);
+    assert(uniq_bptree_insert(tree, records) == 0);
+    uniq_bptree_free(tree);
+    uniq_bptree_destroy(&factory);
+
+    printf("bptree %-7s node size: %4d, insert: %4"PRId64" ms, "
+            "find: %4"PRId64" ms, delete: %4"PRId64" ms\n", int_mode ?
+            "int64" : "compare", node_size, insert_time / 1000,
+            find_time / 1000, delete_time / 1000);
+    free_count = 0;
+}
+
+static void bench_range_scan()
+{
+    UniqBPTreeFactory bptree_factory;
+    UniqSkiplistFactory skiplist_factory;
+    UniqBPTree *tree;
+    UniqSkiplist *sl;
+    UniqBPTreeIterator bpt_iterator;
+    UniqSkiplistIterator sl_iterator;
+    Record start;
+    Record end;
+    int64_t start_time;
+    int64_t bptree_time;
+    int64_t skiplist_time;
+    int64_t sum1;
+    int64_t sum2;
+    int i;
+    void *data;
+
+    assert(uniq_bptree_init_int64(&bptree_factory,
+                offsetof(Record, key), NULL) == 0);
+    assert((tree=uniq_bptree_new(&bptree_factory)) != NULL);
+    assert(uniq_skiplist_init_ex(&skiplist_factory, 20,
+                compare_func, NULL, 1024,
+                SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE, 0, NULL) == 0);
+    assert((sl=uniq_skiplist_new(&skiplist_factory, 20)) != NULL);
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_bptree_insert(tree, shuffled[i]) == 0);
+        assert(uniq_skiplist_insert(sl, shuffled[i]) == 0);
+    }
+
+    sum1 = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<RANGE_COUNT; i++) {
+        start.key = shuffled[i]->key;
+        end.key = start.key + RANGE_SIZE - 1;
+        uniq_bptree_find_range(tree, &start, &end, &bpt_iterator);
+        while ((data=uniq_bptree_next(&bpt_iterator)) != NULL) {
+            sum1 += ((Record *)data)->value;
+        }
+    }
+    bptree_time = get_current_time_us() - start_time;
+
+    sum2 = 0;
+    start_time = get_current_time_us();
+    for (i=0; i<RANGE_COUNT; i++) {
+        start.key = shuffled[i]->key;
+        end.key = start.key + RANGE_SIZE - 1;
+        uniq_skiplist_find_range(sl, &start, &end, &sl_iterator);
+        while ((data=uniq_skiplist_next(&sl_iterator)) != NULL) {
+            sum2 += ((Record *)data)->value;
+        }
+    }
+    skiplist_time = get_current_time_us() - start_time;
+    assert(sum1 == sum2);
+
+    printf("range scan of %d items, bptree: %"PRId64" ms, "
+            "skiplist: %"PRId64" ms\n", RANGE_SIZE, bptree_time / 1000,
+            skiplist_time / 1000);
+
+    uniq_bptree_free(tree);
+    uniq_bptree_destroy(&bptree_factory);
+    uniq_skiplist_free(sl);
+    uniq_skiplist_destroy(&skiplist_factory);
+}
+
+int main(int argc, char *argv[])
+{
+    const int node_sizes[] = {128, 512, 4096};
+    UniqBPTreeFactory factory;
+    int i;
+
+    log_init();
+    srand(time(NULL));
+    records = (Record *)malloc(sizeof(Record) * COUNT);
+    shuffled = (Record **)malloc(sizeof(Record *) * COUNT);
+    assert(records != NULL && shuffled != NULL);
+    for (i=0; i<COUNT; i++) {
+        records[i].key = i;
+        records[i].value = i * 3;
+        shuffled[i] = records + i;
+    }
+
+    assert(uniq_bptree_init_ex(&factory, 64, NULL, NULL,
+                0, 0, false, NULL) == EINVAL);
+    for (i=0; i<sizeof(node_sizes) / sizeof(node_sizes[0]); i++) {
+        test_tree(node_sizes[i], true);
+        test_tree(node_sizes[i], false);
+    }
+    bench_range_scan();
+
+    free(records);
+    free(shuffled);
+    printf("pass OK\n");
+    return 0;
+}
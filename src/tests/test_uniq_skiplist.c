@@ -124,9 +124,20 @@ static void test_delete()
     int64_t start_time;
     int64_t end_time;
     void *value;
+    UniqSkiplistNode stale;
+    UniqSkiplistNode *previous;
+    UniqSkiplistNode *node;
+
+    //the stale node which is not in the skiplist
+    memset(&stale, 0, sizeof(stale));
+    stale.data = numbers;
+    assert(uniq_skiplist_delete_node(sl, NULL, &stale) == ENOENT);
+    assert((node=uniq_skiplist_find_node_ex(sl, numbers,
+                    &previous)) != NULL);
+    assert(uniq_skiplist_delete_node(sl, previous, node) == 0);
 
     start_time = get_current_time_ms();
-    for (i=0; i<COUNT; i++) {
+    for (i=1; i<COUNT; i++) {
         assert(uniq_skiplist_delete(sl, numbers + i) == 0);
     }
     assert(instance_count == 0);
@@ -273,6 +284,193 @@ static void test_reverse_iterator()
     }
 }
 
+static void check_order(const int expect_count)
+{
+    UniqSkiplistNode *node;
+    int *value;
+    int *previous;
+    int count;
+    int rank;
+
+    count = 0;
+    previous = NULL;
+    uniq_skiplist_iterator(sl, &iterator);
+    while ((value=(int *)uniq_skiplist_next(&iterator)) != NULL) {
+        assert(previous == NULL || *previous < *value);
+        if (count % 97 == 0) {  //check the span widths
+            assert(uniq_skiplist_nth(sl, count) == value);
+            assert(uniq_skiplist_rank(sl, value, &rank) == 0);
+            assert(rank == count);
+        }
+        previous = value;
+        count++;
+    }
+    assert(uniq_skiplist_nth(sl, count) == NULL);
+    assert(count == expect_count);
+    assert(uniq_skiplist_count(sl) == expect_count);
+
+    //the reverse chain
+    count = 0;
+    node = UNIQ_SKIPLIST_LEVEL0_TAIL_NODE(sl);
+    while (node != sl->top) {
+        count++;
+        node = UNIQ_SKIPLIST_LEVEL0_PREV_NODE(node);
+    }
+    assert(count == expect_count);
+}
+
+static void test_batch()
+{
+    void **data_array;
+    int inserted_count;
+    int deleted_count;
+    int64_t start_time;
+    int i;
+
+    data_array = (void **)malloc(sizeof(void *) * COUNT);
+    for (i=0; i<COUNT; i++) {
+        numbers[i] = i + 1;
+        data_array[i] = numbers + i;
+    }
+
+    start_time = get_current_time_ms();
+    assert(uniq_skiplist_bulk_build(sl, data_array, COUNT) == 0);
+    printf("bulk build time used: %"PRId64" ms\n",
+            get_current_time_ms() - start_time);
+    instance_count += COUNT;
+    assert(uniq_skiplist_bulk_build(sl, data_array, COUNT) == EBUSY);
+    check_order(COUNT);
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_skiplist_find(sl, numbers + i) == numbers + i);
+    }
+
+    //delete the odd positions
+    for (i=0; i<COUNT / 2; i++) {
+        data_array[i] = numbers + 2 * i;
+    }
+    start_time = get_current_time_ms();
+    assert(uniq_skiplist_batch_delete(sl, data_array,
+                COUNT / 2, &deleted_count) == 0);
+    printf("batch delete time used: %"PRId64" ms\n",
+            get_current_time_ms() - start_time);
+    assert(deleted_count == COUNT / 2);
+    assert(instance_count == COUNT - COUNT / 2);
+    check_order(COUNT - COUNT / 2);
+
+    //insert all, the existing ones are skipped
+    for (i=0; i<COUNT; i++) {
+        data_array[i] = numbers + i;
+    }
+    start_time = get_current_time_ms();
+    assert(uniq_skiplist_batch_insert(sl, data_array,
+                COUNT, &inserted_count) == 0);
+    printf("batch insert time used: %"PRId64" ms\n",
+            get_current_time_ms() - start_time);
+    assert(inserted_count == COUNT / 2);
+    instance_count += inserted_count;
+    check_order(COUNT);
+
+    //NOT in ascending order
+    data_array[0] = numbers + 100;
+    data_array[1] = numbers + 10;
+    data_array[2] = numbers + 50;
+    assert(uniq_skiplist_batch_delete(sl, data_array,
+                3, &deleted_count) == 0);
+    assert(deleted_count == 3);
+    check_order(COUNT - 3);
+    assert(uniq_skiplist_find(sl, numbers + 10) == NULL);
+    assert(uniq_skiplist_batch_insert(sl, data_array,
+                3, &inserted_count) == 0);
+    assert(inserted_count == 3);
+    instance_count += inserted_count;
+    check_order(COUNT);
+
+    uniq_skiplist_clear(sl);
+    assert(instance_count == 0);
+    free(data_array);
+}
+
+static void test_rank()
+{
+    UniqSkiplistIterator it;
+    int64_t start_time;
+    int64_t rank_time;
+    int64_t nth_time;
+    int64_t count_time;
+    int64_t walk_time;
+    int start;
+    int end;
+    int count;
+    int expect;
+    int rank;
+    int i;
+
+    set_rand_numbers(2);  //the odd numbers
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_skiplist_insert(sl, numbers + i) == 0);
+    }
+    instance_count += COUNT;
+    check_order(COUNT);
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(uniq_skiplist_rank(sl, numbers + i, &rank) == 0);
+        assert(rank == (numbers[i] - 1) / 2);
+    }
+    rank_time = get_current_time_us() - start_time;
+    start = 2;
+    assert(uniq_skiplist_rank(sl, &start, &rank) == ENOENT);
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        assert(*(int *)uniq_skiplist_nth(sl, i) == 2 * i + 1);
+    }
+    nth_time = get_current_time_us() - start_time;
+
+    start_time = get_current_time_us();
+    for (i=0; i<COUNT; i++) {
+        start = numbers[i] - 3;
+        end = start + (numbers[(i + 1) % COUNT] % 1000);
+        assert(uniq_skiplist_count_range(sl, &start, &end, &count) == 0);
+        expect = (FC_MIN(end, 2 * COUNT - 1) + 1) / 2 -
+            (FC_MAX(start, 1) - 1 + 1) / 2;
+        assert(count == FC_MAX(expect, 0));
+    }
+    count_time = get_current_time_us() - start_time;
+    start = 10;
+    end = 9;
+    assert(uniq_skiplist_count_range(sl, &start, &end, &count) == EINVAL);
+
+    //the linear walk for comparison
+    start_time = get_current_time_us();
+    for (i=0; i<1000; i++) {
+        start = numbers[i];
+        end = start + 20000;
+        uniq_skiplist_find_range(sl, &start, &end, &it);
+        count = uniq_skiplist_iterator_count(&it);
+        assert(uniq_skiplist_count_range(sl, &start, &end, &expect) == 0);
+        assert(count == expect);
+    }
+    walk_time = get_current_time_us() - start_time;
+
+    printf("rank: %"PRId64" ns, nth: %"PRId64" ns, count_range: "
+            "%"PRId64" ns, count by iterator of 10000 items: %"PRId64" ns\n",
+            rank_time * 1000 / COUNT, nth_time * 1000 / COUNT,
+            count_time * 1000 / COUNT, walk_time);
+
+    uniq_skiplist_iterator_at(sl, COUNT / 2, &it);
+    assert(*(int *)uniq_skiplist_next(&it) == COUNT + 1);
+
+    //the widths after the deletion
+    for (i=0; i<COUNT; i+=3) {
+        assert(uniq_skiplist_delete(sl, numbers + i) == 0);
+    }
+    check_order(COUNT - (COUNT + 2) / 3);
+    uniq_skiplist_clear(sl);
+    check_order(0);
+    assert(instance_count == 0);
+}
+
 int main(int argc, char *argv[])
 {
     const bool allocator_use_lock = false;
@@ -326,6 +524,16 @@ int main(int argc, char *argv[])
     test_insert();
     printf("\n");
 
+    test_clear();
+    test_batch();
+    printf("\n");
+
+    test_rank();
+    printf("\n");
+
+    test_insert();
+    printf("\n");
+
     uniq_skiplist_free(sl);
     fast_mblock_manager_stat_print(false);
 
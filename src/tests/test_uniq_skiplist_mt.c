@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include "fastcommon/uniq_skiplist.h"
+#include "fastcommon/logger.h"
+#include "fastcommon/shared_func.h"
+#include "fastcommon/pthread_func.h"
+
+#define LEVEL_COUNT   20
+#define KEY_COUNT     (256 * 1024)
+#define OP_COUNT      (1024 * 1024)
+#define MAX_THREADS   16
+
+typedef struct {
+    int thread_index;
+    int64_t found_count;
+} ThreadContext;
+
+static UniqSkiplistFactory factory;
+static UniqSkiplist *sl;
+static bool concurrent;
+static int thread_count;
+static int write_percent;
+static pthread_mutex_t lock;
+static int64_t *keys;
+static volatile int64_t free_count = 0;
+
+static int compare_func(const void *p1, const void *p2)
+{
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+static void free_func(UniqSkiplist *sl, void *ptr, const int delay_seconds)
+{
+    __sync_add_and_fetch(&free_count, 1);
+}
+
+static void *thread_func(void *arg)
+{
+    ThreadContext *ctx;
+    UniqSkiplistIterator iterator;
+    int64_t *key;
+    uint64_t rand_state;
+    int64_t index;
+    int op;
+    int i;
+
+    ctx = (ThreadContext *)arg;
+    rand_state = ctx->thread_index * 2654435761U + 1;
+    for (i=0; i<OP_COUNT / thread_count; i++) {
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 7;
+        rand_state ^= rand_state << 17;
+        index = (rand_state >> 16) % KEY_COUNT;
+        op = (rand_state >> 48) % 100;
+
+        key = keys + index;
+        if (!concurrent) {
+            PTHREAD_MUTEX_LOCK(&lock);
+        }
+        if (op < write_percent / 2) {
+            uniq_skiplist_insert(sl, key);
+        } else if (op < write_percent) {
+            uniq_skiplist_delete(sl, key);
+        } else if (op == 99 && write_percent <= 10) {
+            //short scan
+            uniq_skiplist_read_lock(sl);
+            uniq_skiplist_iterator_at(sl, index % 64, &iterator);
+            if (uniq_skiplist_next(&iterator) != NULL) {
+                ctx->found_count++;
+            }
+            uniq_skiplist_read_unlock(sl);
+        } else {
+            uniq_skiplist_read_lock(sl);
+            key = (int64_t *)uniq_skiplist_find(sl, key);
+            if (key != NULL) {
+                assert(*key == index);
+                ctx->found_count++;
+            }
+            uniq_skiplist_read_unlock(sl);
+        }
+        if (!concurrent) {
+            PTHREAD_MUTEX_UNLOCK(&lock);
+        }
+    }
+
+    return NULL;
+}
+
+static void check_skiplist()
+{
+    UniqSkiplistIterator iterator;
+    int64_t *key;
+    int64_t *previous;
+    int count;
+
+    count = 0;
+    previous = NULL;
+    uniq_skiplist_iterator(sl, &iterator);
+    while ((key=(int64_t *)uniq_skiplist_next(&iterator)) != NULL) {
+        assert(previous == NULL || *previous < *key);
+        assert(uniq_skiplist_find(sl, key) == key);
+        previous = key;
+        count++;
+    }
+    assert(count == uniq_skiplist_count(sl));
+}
+
+static void run_bench()
+{
+    pthread_t tids[MAX_THREADS];
+    ThreadContext contexts[MAX_THREADS];
+    int64_t start_time;
+    int64_t time_used;
+    int64_t found_count;
+    int64_t i;
+
+    assert((sl=uniq_skiplist_new(&factory, concurrent ?
+                    LEVEL_COUNT : 8)) != NULL);
+    if (concurrent) {
+        assert(uniq_skiplist_set_concurrent(sl, MAX_THREADS + 1) == 0);
+    }
+
+    //half of the keys
+    for (i=0; i<KEY_COUNT; i+=2) {
+        assert(uniq_skiplist_insert(sl, keys + i) == 0);
+    }
+
+    start_time = get_current_time_us();
+    for (i=0; i<thread_count; i++) {
+        contexts[i].thread_index = i;
+        contexts[i].found_count = 0;
+        assert(pthread_create(tids + i, NULL, thread_func,
+                    contexts + i) == 0);
+    }
+    found_count = 0;
+    for (i=0; i<thread_count; i++) {
+        pthread_join(tids[i], NULL);
+        found_count += contexts[i].found_count;
+    }
+    time_used = get_current_time_us() - start_time;
+
+    check_skiplist();
+    printf("%-10s threads: %2d, write: %3d%%, count: %6d, found: %7"PRId64", "
+            "time used: %5"PRId64" ms, %6.2f Mops/s\n", concurrent ?
+            "concurrent" : "mutex", thread_count, write_percent,
+            uniq_skiplist_count(sl), found_count, time_used / 1000,
+            (double)OP_COUNT / time_used);
+
+    uniq_skiplist_free(sl);
+}
+
+static void test_basic()
+{
+    UniqSkiplistIterator iterator;
+    UniqSkiplistNode stale;
+    UniqSkiplistNode *previous;
+    UniqSkiplistNode *node;
+    int64_t key;
+    int64_t i;
+
+    assert((sl=uniq_skiplist_new(&factory, 2)) != NULL);
+    assert(uniq_skiplist_set_concurrent(sl, 4) == 0);
+    assert(uniq_skiplist_set_concurrent(sl, 4) == EEXIST);
+    assert(sl->top_level_index == LEVEL_COUNT - 1);
+
+    free_count = 0;
+    for (i=KEY_COUNT-1; i>=0; i--) {
+        assert(uniq_skiplist_insert(sl, keys + i) == 0);
+        assert(uniq_skiplist_insert(sl, keys + i) == EEXIST);
+    }
+    assert(uniq_skiplist_count(sl) == KEY_COUNT);
+    check_skiplist();
+
+    key = 100;
+    assert(*(int64_t *)uniq_skiplist_find_ge(sl, &key) == 100);
+    assert(uniq_skiplist_find_range(sl, &key, &key,
+                &iterator) == EOPNOTSUPP);
+    assert(uniq_skiplist_replace(sl, &key) == EOPNOTSUPP);
+
+    for (i=0; i<KEY_COUNT; i+=2) {
+        assert(uniq_skiplist_delete(sl, keys + i) == 0);
+        assert(uniq_skiplist_delete(sl, keys + i) == ENOENT);
+        assert(uniq_skiplist_find(sl, keys + i) == NULL);
+    }
+    assert(uniq_skiplist_count(sl) == KEY_COUNT / 2);
+    key = 100;
+    assert(*(int64_t *)uniq_skiplist_find_ge(sl, &key) == 101);
+    check_skiplist();
+
+    key = 101;
+    memset(&stale, 0, sizeof(stale));
+    stale.data = &key;
+    assert(uniq_skiplist_delete_node(sl, NULL, &stale) == ENOENT);
+    assert((node=uniq_skiplist_find_node_ex(sl, &key, &previous)) != NULL);
+    assert(uniq_skiplist_delete_node(sl, previous, node) == 0);
+    assert(uniq_skiplist_find(sl, &key) == NULL);
+
+    uniq_skiplist_free(sl);
+    assert(free_count == KEY_COUNT);
+}
+
+#define SAME_KEY_COUNT  4
+#define SAME_KEY_ROUNDS 64
+#define SAME_KEY_LOOPS  (4 * 1024)
+
+typedef struct same_key_record {
+    int64_t key;   //the first field as the compared int64
+    volatile bool freed;
+    struct same_key_record *next;
+} SameKeyRecord;
+
+static UniqSkiplistFactory same_key_factory;
+static SameKeyRecord *volatile freed_records = NULL;
+
+static int same_key_compare_func(const void *p1, const void *p2)
+{
+    static __thread unsigned int compare_count = 0;
+
+    //widen the race windows between the levels of the search
+    if ((++compare_count % 4) == 0) {
+        sched_yield();
+    }
+    return fc_compare_int64(*((int64_t *)p1), *((int64_t *)p2));
+}
+
+/* mark the record freed and keep it for the check of the scanners */
+static void same_key_free_func(UniqSkiplist *sl,
+        void *ptr, const int delay_seconds)
+{
+    SameKeyRecord *record;
+
+    record = (SameKeyRecord *)ptr;
+    record->freed = true;
+    do {
+        record->next = freed_records;
+    } while (!__sync_bool_compare_and_swap(&freed_records,
+                record->next, record));
+}
+
+/* no node reachable from any level is reclaimed under the epoch, and
+ * the live nodes of every level are in order */
+static void scan_levels()
+{
+    UniqSkiplistNode *node;
+    UniqSkiplistNode *succ;
+    int64_t *previous;
+    int i;
+
+    for (i=sl->top_level_index; i>=0; i--) {
+        previous = NULL;
+        node = UNIQ_SKIPLIST_LINK_NODE(sl->top->links[i]);
+        while (node != sl->factory->tail) {
+            assert(!((SameKeyRecord *)node->data)->freed);
+            succ = (UniqSkiplistNode *)node->links[i];
+            if (!UNIQ_SKIPLIST_LINK_MARKED(succ)) {
+                assert(previous == NULL ||
+                        *previous < *(int64_t *)node->data);
+                previous = (int64_t *)node->data;
+            }
+            node = UNIQ_SKIPLIST_LINK_NODE(succ);
+        }
+    }
+}
+
+static void *same_key_thread_func(void *arg)
+{
+    ThreadContext *ctx;
+    SameKeyRecord *record;
+    int64_t *key;
+    uint64_t rand_state;
+    int64_t index;
+    int i;
+
+    ctx = (ThreadContext *)arg;
+    rand_state = ctx->thread_index * 2654435761U + 1;
+    for (i=0; i<SAME_KEY_LOOPS; i++) {
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 7;
+        rand_state ^= rand_state << 17;
+        index = (rand_state >> 16) % SAME_KEY_COUNT;
+
+        switch ((rand_state >> 48) % 4) {
+            case 0:
+                record = (SameKeyRecord *)malloc(sizeof(SameKeyRecord));
+                assert(record != NULL);
+                record->key = index;
+                record->freed = false;
+                if (uniq_skiplist_insert(sl, record) != 0) {
+                    free(record);
+                }
+                break;
+            case 1:
+                uniq_skiplist_delete(sl, keys + index);
+                break;
+            case 2:
+                uniq_skiplist_read_lock(sl);
+                key = (int64_t *)uniq_skiplist_find(sl, keys + index);
+                if (key != NULL) {
+                    assert(*key == index);
+                    ctx->found_count++;
+                }
+                uniq_skiplist_read_unlock(sl);
+                break;
+            default:
+                uniq_skiplist_read_lock(sl);
+                scan_levels();
+                uniq_skiplist_read_unlock(sl);
+                break;
+        }
+    }
+
+    return NULL;
+}
+
+/* every node reachable at any level should be a live node of level 0 */
+static void check_levels()
+{
+    volatile UniqSkiplistNode *link;
+    UniqSkiplistNode *node;
+    int i;
+
+    for (i=sl->top_level_index; i>=0; i--) {
+        link = sl->top->links[i];
+        while (!UNIQ_SKIPLIST_LINK_MARKED(link) &&
+                (node=(UniqSkiplistNode *)link) != sl->factory->tail)
+        {
+            assert(i <= node->level_index);
+            assert(uniq_skiplist_find_node(sl, node->data) == node);
+            link = node->links[i];
+        }
+        assert(!UNIQ_SKIPLIST_LINK_MARKED(link));
+    }
+}
+
+/* delete and insert the same keys again and again, the node of the key
+ * inserted again may be linked ahead of the deleted one being unlinked */
+static void test_same_key()
+{
+    pthread_t tids[MAX_THREADS];
+    ThreadContext contexts[MAX_THREADS];
+    SameKeyRecord *record;
+    int64_t found_count;
+    int64_t deleted_count;
+    int live_count;
+    int r;
+    int i;
+
+    assert(uniq_skiplist_init_ex2(&same_key_factory, LEVEL_COUNT,
+                same_key_compare_func, same_key_free_func, 64,
+                SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE,
+                0, false, true, NULL) == 0);
+    assert((sl=uniq_skiplist_new(&same_key_factory, LEVEL_COUNT)) != NULL);
+    assert(uniq_skiplist_set_concurrent(sl, MAX_THREADS + 1) == 0);
+    sl->epoch->reclaim_threshold = 1;  //reclaim the retired node ASAP
+
+    found_count = 0;
+    for (r=0; r<SAME_KEY_ROUNDS; r++) {
+        for (i=0; i<MAX_THREADS; i++) {
+            contexts[i].thread_index = r * MAX_THREADS + i;
+            contexts[i].found_count = 0;
+            assert(pthread_create(tids + i, NULL, same_key_thread_func,
+                        contexts + i) == 0);
+        }
+        for (i=0; i<MAX_THREADS; i++) {
+            pthread_join(tids[i], NULL);
+            found_count += contexts[i].found_count;
+        }
+
+        check_levels();
+        check_skiplist();
+    }
+
+    live_count = uniq_skiplist_count(sl);
+    uniq_skiplist_free(sl);
+    uniq_skiplist_destroy(&same_key_factory);
+
+    deleted_count = -live_count;
+    while (freed_records != NULL) {
+        record = freed_records;
+        freed_records = record->next;
+        free(record);
+        deleted_count++;
+    }
+    printf("same key   threads: %2d, count: %6d, found: %7"PRId64", "
+            "deleted: %"PRId64"\n", MAX_THREADS, live_count,
+            found_count, deleted_count);
+}
+
+int main(int argc, char *argv[])
+{
+    const int thread_counts[] = {1, 4, 16};
+    const int write_percents[] = {0, 10, 50};
+    int64_t i;
+    int t;
+    int w;
+
+    log_init();
+    keys = (int64_t *)malloc(sizeof(int64_t) * KEY_COUNT);
+    assert(keys != NULL);
+    for (i=0; i<KEY_COUNT; i++) {
+        keys[i] = i;
+    }
+
+    //the concurrent mode requires the allocators with lock
+    assert(uniq_skiplist_init_ex2(&factory, LEVEL_COUNT, compare_func,
+                free_func, 64, SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE,
+                0, false, true, NULL) == 0);
+    assert(init_pthread_lock(&lock) == 0);
+
+    test_basic();
+    test_same_key();
+    for (w=0; w<sizeof(write_percents) / sizeof(write_percents[0]); w++) {
+        write_percent = write_percents[w];
+        for (t=0; t<sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            thread_count = thread_counts[t];
+            concurrent = false;
+            run_bench();
+            concurrent = true;
+            run_bench();
+        }
+    }
+
+    uniq_skiplist_destroy(&factory);
+    printf("pass OK\n");
+    return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//typed_skiplist.c
+
+#include "typed_skiplist.h"
+
+TYPED_SKIPLIST_DEFINE(Int64Skiplist, int64_skiplist, int64_t,
+        TYPED_SKIPLIST_COMPARE_NUMBER)
+
+TYPED_SKIPLIST_DEFINE(UInt32Skiplist, uint32_skiplist, uint32_t,
+        TYPED_SKIPLIST_COMPARE_NUMBER)
+
+TYPED_SKIPLIST_DEFINE(StringSkiplist, string_skiplist, string_t,
+        TYPED_SKIPLIST_COMPARE_STRING)
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//typed_skiplist.h: the macro templates of the unique skiplist specialized
+//                  for the key type, the key is stored in the node and
+//                  compared by the inline expression instead of the
+//                  compare function pointer
+//
+//usage:
+//  in the header: TYPED_SKIPLIST_DECLARE(MySkiplist, my_skiplist, key_type)
+//  in the source: TYPED_SKIPLIST_DEFINE(MySkiplist, my_skiplist, key_type,
+//                                       compare)
+//  the compare is a function-like macro: compare(k1, k2) returns < 0, 0
+//  or > 0 as strcmp, such as TYPED_SKIPLIST_COMPARE_NUMBER
+//
+//the predefined skiplists: Int64Skiplist, UInt32Skiplist and StringSkiplist
+
+#ifndef _TYPED_SKIPLIST_H
+#define _TYPED_SKIPLIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "common_define.h"
+#include "skiplist_common.h"
+#include "fast_mblock.h"
+#include "logger.h"
+
+#define TYPED_SKIPLIST_COMPARE_NUMBER(k1, k2) (((k1) > (k2)) - ((k1) < (k2)))
+
+/* the string key is NOT copied, the caller should keep the string */
+#define TYPED_SKIPLIST_COMPARE_STRING(k1, k2) fc_string_compare(&(k1), &(k2))
+
+#define TYPED_SKIPLIST_DECLARE(TypeName, name, key_type) \
+\
+typedef struct name##_node \
+{ \
+    key_type key; \
+    void *data; \
+    int level_index; \
+    struct name##_node *links[0]; \
+} TypeName##Node; \
+\
+typedef struct name \
+{ \
+    int level_count; \
+    int top_level_index; \
+    int element_count; \
+    uint64_t rand_state;  /* for the level of the new node */ \
+    skiplist_free_func free_func; \
+    struct fast_mblock_man *mblocks;  /* node allocators */ \
+    TypeName##Node *top;   /* the top node, the links end with NULL */ \
+} TypeName; \
+\
+typedef struct name##_iterator { \
+    TypeName##Node *current; \
+    TypeName##Node *end; \
+} TypeName##Iterator; \
+\
+int name##_init_ex(TypeName *sl, const int level_count, \
+        skiplist_free_func free_func, const int min_alloc_elements_once); \
+\
+void name##_destroy(TypeName *sl); \
+\
+/* return 0 for success, EEXIST for the key exists, ENOMEM for no memory */ \
+int name##_insert(TypeName *sl, const key_type key, void *data); \
+\
+/* return 0 for success, ENOENT for not exist */ \
+int name##_delete(TypeName *sl, const key_type key); \
+\
+/* return the data of the key, NULL for not exist */ \
+void *name##_find(TypeName *sl, const key_type key); \
+\
+/* return the first node which key is greater than or equal to the key */ \
+TypeName##Node *name##_find_ge(TypeName *sl, const key_type key); \
+\
+/* the nodes in [start_key, end_key], \
+ * return 0 for success, ENOENT for not found, EINVAL for invalid range */ \
+int name##_find_range(TypeName *sl, const key_type start_key, \
+        const key_type end_key, TypeName##Iterator *iterator); \
+\
+static inline void name##_iterator(TypeName *sl, \
+        TypeName##Iterator *iterator) \
+{ \
+    iterator->current = sl->top->links[0]; \
+    iterator->end = NULL; \
+} \
+\
+static inline TypeName##Node *name##_next_node( \
+        TypeName##Iterator *iterator) \
+{ \
+    TypeName##Node *node; \
+\
+    if (iterator->current == iterator->end) { \
+        return NULL; \
+    } \
+    node = iterator->current; \
+    iterator->current = node->links[0]; \
+    return node; \
+} \
+\
+static inline void *name##_next(TypeName##Iterator *iterator) \
+{ \
+    TypeName##Node *node; \
+    return (node=name##_next_node(iterator)) != NULL ? node->data : NULL; \
+} \
+\
+static inline int name##_count(TypeName *sl) \
+{ \
+    return sl->element_count; \
+} \
+\
+static inline bool name##_empty(TypeName *sl) \
+{ \
+    return sl->top->links[0] == NULL; \
+}
+
+
+#define TYPED_SKIPLIST_DEFINE(TypeName, name, key_type, compare) \
+\
+int name##_init_ex(TypeName *sl, const int level_count, \
+        skiplist_free_func free_func, const int min_alloc_elements_once) \
+{ \
+    const int64_t alloc_elements_limit = 0; \
+    char mblock_name[64]; \
+    int element_size; \
+    int alloc_elements_once; \
+    int bytes; \
+    int result; \
+    int i; \
+\
+    if (level_count <= 0 || level_count > SKIPLIST_MAX_LEVEL_COUNT) { \
+        logError("file: "__FILE__", line: %d, " \
+                "invalid level count: %d, which not in [1, %d]", __LINE__, \
+                level_count, SKIPLIST_MAX_LEVEL_COUNT); \
+        return EINVAL; \
+    } \
+\
+    bytes = sizeof(struct fast_mblock_man) * level_count; \
+    sl->mblocks = (struct fast_mblock_man *)fc_malloc(bytes); \
+    if (sl->mblocks == NULL) { \
+        return ENOMEM; \
+    } \
+    memset(sl->mblocks, 0, bytes); \
+\
+    alloc_elements_once = min_alloc_elements_once; \
+    if (alloc_elements_once <= 0) { \
+        alloc_elements_once = SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE; \
+    } else if (alloc_elements_once > 1024) { \
+        alloc_elements_once = 1024; \
+    } \
+\
+    for (i=level_count-1; i>=0; i--) { \
+        sprintf(mblock_name, "%s-level%02d", #name, i); \
+        element_size = sizeof(TypeName##Node) + \
+            sizeof(TypeName##Node *) * (i + 1); \
+        if ((result=fast_mblock_init_ex1(sl->mblocks + i, mblock_name, \
+                        element_size, alloc_elements_once, \
+                        alloc_elements_limit, NULL, NULL, false)) != 0) \
+        { \
+            while (++i < level_count) { \
+                fast_mblock_destroy(sl->mblocks + i); \
+            } \
+            free(sl->mblocks); \
+            sl->mblocks = NULL; \
+            return result; \
+        } \
+        if (i % 2 == 0 && alloc_elements_once < 64 * 1024) { \
+            alloc_elements_once *= 2; \
+        } \
+    } \
+\
+    sl->top = (TypeName##Node *)fast_mblock_alloc_object( \
+            sl->mblocks + level_count - 1); \
+    if (sl->top == NULL) { \
+        for (i=0; i<level_count; i++) { \
+            fast_mblock_destroy(sl->mblocks + i); \
+        } \
+        free(sl->mblocks); \
+        sl->mblocks = NULL; \
+        return ENOMEM; \
+    } \
+    memset(sl->top, 0, sl->mblocks[level_count - 1].info.element_size); \
+    sl->top->level_index = level_count - 1; \
+\
+    sl->level_count = level_count; \
+    sl->top_level_index = 0; \
+    sl->element_count = 0; \
+    sl->rand_state = skiplist_rand_seed(sl); \
+    sl->free_func = free_func; \
+    return 0; \
+} \
+\
+void name##_destroy(TypeName *sl) \
+{ \
+    TypeName##Node *node; \
+    TypeName##Node *deleted; \
+    int i; \
+\
+    if (sl->mblocks == NULL) { \
+        return; \
+    } \
+\
+    if (sl->free_func != NULL) { \
+        node = sl->top->links[0]; \
+        while (node != NULL) { \
+            deleted = node; \
+            node = node->links[0]; \
+            sl->free_func(deleted->data); \
+        } \
+    } \
+\
+    for (i=0; i<sl->level_count; i++) { \
+        fast_mblock_destroy(sl->mblocks + i); \
+    } \
+    free(sl->mblocks); \
+    sl->mblocks = NULL; \
+} \
+\
+static inline TypeName##Node *name##_get_previous(TypeName *sl, \
+        const key_type key, TypeName##Node **update) \
+{ \
+    TypeName##Node *previous; \
+    TypeName##Node *current; \
+    int i; \
+\
+    previous = sl->top; \
+    for (i=sl->top_level_index; i>=0; i--) { \
+        while ((current=previous->links[i]) != NULL && \
+                compare(current->key, key) < 0) \
+        { \
+            previous = current; \
+        } \
+        update[i] = previous; \
+    } \
+    return previous; \
+} \
+\
+int name##_insert(TypeName *sl, const key_type key, void *data) \
+{ \
+    TypeName##Node *update[SKIPLIST_MAX_LEVEL_COUNT]; \
+    TypeName##Node *current; \
+    TypeName##Node *node; \
+    int level_index; \
+    int i; \
+\
+    current = name##_get_previous(sl, key, update)->links[0]; \
+    if (current != NULL && compare(current->key, key) == 0) { \
+        return EEXIST; \
+    } \
+\
+    level_index = skiplist_rand_level_index(&sl->rand_state, \
+            sl->level_count - 1); \
+    node = (TypeName##Node *)fast_mblock_alloc_object( \
+            sl->mblocks + level_index); \
+    if (node == NULL) { \
+        return ENOMEM; \
+    } \
+    node->key = key; \
+    node->data = data; \
+    node->level_index = level_index; \
+\
+    while (sl->top_level_index < level_index) { \
+        update[++sl->top_level_index] = sl->top; \
+    } \
+    for (i=0; i<=level_index; i++) { \
+        node->links[i] = update[i]->links[i]; \
+        update[i]->links[i] = node; \
+    } \
+    sl->element_count++; \
+    return 0; \
+} \
+\
+int name##_delete(TypeName *sl, const key_type key) \
+{ \
+    TypeName##Node *update[SKIPLIST_MAX_LEVEL_COUNT]; \
+    TypeName##Node *deleted; \
+    int i; \
+\
+    deleted = name##_get_previous(sl, key, update)->links[0]; \
+    if (deleted == NULL || compare(deleted->key, key) != 0) { \
+        return ENOENT; \
+    } \
+\
+    for (i=0; i<=deleted->level_index; i++) { \
+        update[i]->links[i] = deleted->links[i]; \
+    } \
+    while (sl->top_level_index > 0 && \
+            sl->top->links[sl->top_level_index] == NULL) \
+    { \
+        sl->top_level_index--; \
+    } \
+    sl->element_count--; \
+\
+    if (sl->free_func != NULL) { \
+        sl->free_func(deleted->data); \
+    } \
+    fast_mblock_free_object(sl->mblocks + deleted->level_index, deleted); \
+    return 0; \
+} \
+\
+void *name##_find(TypeName *sl, const key_type key) \
+{ \
+    TypeName##Node *previous; \
+    TypeName##Node *current; \
+    int cmp; \
+    int i; \
+\
+    previous = sl->top; \
+    for (i=sl->top_level_index; i>=0; i--) { \
+        while ((current=previous->links[i]) != NULL) { \
+            if ((cmp=compare(current->key, key)) >= 0) { \
+                if (cmp == 0) { \
+                    return current->data; \
+                } \
+                break; \
+            } \
+            previous = current; \
+        } \
+    } \
+    return NULL; \
+} \
+\
+TypeName##Node *name##_find_ge(TypeName *sl, const key_type key) \
+{ \
+    TypeName##Node *update[SKIPLIST_MAX_LEVEL_COUNT]; \
+    return name##_get_previous(sl, key, update)->links[0]; \
+} \
+\
+int name##_find_range(TypeName *sl, const key_type start_key, \
+        const key_type end_key, TypeName##Iterator *iterator) \
+{ \
+    TypeName##Node *previous; \
+    TypeName##Node *current; \
+    int i; \
+\
+    if (compare(start_key, end_key) > 0) { \
+        iterator->current = iterator->end = NULL; \
+        return EINVAL; \
+    } \
+\
+    iterator->current = name##_find_ge(sl, start_key); \
+    previous = sl->top; \
+    for (i=sl->top_level_index; i>=0; i--) { \
+        while ((current=previous->links[i]) != NULL && \
+                compare(current->key, end_key) <= 0) \
+        { \
+            previous = current; \
+        } \
+    } \
+    iterator->end = previous->links[0]; \
+    return (iterator->current != iterator->end) ? 0 : ENOENT; \
+}
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+TYPED_SKIPLIST_DECLARE(Int64Skiplist, int64_skiplist, int64_t)
+TYPED_SKIPLIST_DECLARE(UInt32Skiplist, uint32_skiplist, uint32_t)
+TYPED_SKIPLIST_DECLARE(StringSkiplist, string_skiplist, string_t)
+
+#define int64_skiplist_init(sl, level_count, free_func) \
+    int64_skiplist_init_ex(sl, level_count, free_func, \
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE)
+
+#define uint32_skiplist_init(sl, level_count, free_func) \
+    uint32_skiplist_init_ex(sl, level_count, free_func, \
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE)
+
+#define string_skiplist_init(sl, level_count, free_func) \
+    string_skiplist_init_ex(sl, level_count, free_func, \
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,997 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//uniq_bptree.c
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define UNIQ_BPTREE_X86_KERNELS  1
+#include <immintrin.h>
+#endif
+#include "logger.h"
+#include "uniq_bptree.h"
+
+/* the window size of the linear search after the binary search */
+#define INT64_SEARCH_WINDOW  16
+
+typedef struct {
+    UniqBPTreeNode *node;
+    int index;   //the child index
+} BPTreePathEntry;
+
+typedef int (*int64_search_func)(const int64_t *keys,
+        const int count, const int64_t key);
+
+static pthread_once_t search_once = PTHREAD_ONCE_INIT;
+
+/* the count of the keys less than the key */
+static int64_search_func int64_lower_bound = NULL;
+
+/* the count of the keys less than or equal to the key */
+static int64_search_func int64_upper_bound = NULL;
+
+#define BPT_INT_MODE(factory)  ((factory)->key_offset >= 0)
+#define BPT_DATA_KEY(factory, data) \
+    (*(int64_t *)((char *)(data) + (factory)->key_offset))
+
+#define BPT_LEAF_MIN_COUNT(factory)      ((factory)->leaf_capacity / 2)
+#define BPT_INTERNAL_MIN_COUNT(factory)  ((factory)->internal_capacity / 2)
+
+static int int64_lower_bound_scalar(const int64_t *keys,
+        const int count, const int64_t key)
+{
+    int low;
+    int high;
+    int mid;
+
+    low = 0;
+    high = count;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int int64_upper_bound_scalar(const int64_t *keys,
+        const int count, const int64_t key)
+{
+    int low;
+    int high;
+    int mid;
+
+    low = 0;
+    high = count;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (keys[mid] <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+#ifdef UNIQ_BPTREE_X86_KERNELS
+/* narrow by binary search, then compare 4 keys once */
+__attribute__((target("avx2")))
+static int int64_lower_bound_avx2(const int64_t *keys,
+        const int count, const int64_t key)
+{
+    __m256i target;
+    int low;
+    int high;
+    int mid;
+    int mask;
+
+    low = 0;
+    high = count;
+    while (high - low > INT64_SEARCH_WINDOW) {
+        mid = (low + high) / 2;
+        if (keys[mid] < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    target = _mm256_set1_epi64x(key);
+    for (; low + 4 <= high; low += 4) {
+        mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(
+                        target, _mm256_loadu_si256((const __m256i *)
+                            (keys + low)))));
+        if (mask != 0xF) {
+            return low + __builtin_popcount(mask);
+        }
+    }
+    while (low < high && keys[low] < key) {
+        low++;
+    }
+    return low;
+}
+
+__attribute__((target("avx2")))
+static int int64_upper_bound_avx2(const int64_t *keys,
+        const int count, const int64_t key)
+{
+    __m256i target;
+    int low;
+    int high;
+    int mid;
+    int mask;
+
+    low = 0;
+    high = count;
+    while (high - low > INT64_SEARCH_WINDOW) {
+        mid = (low + high) / 2;
+        if (keys[mid] <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    target = _mm256_set1_epi64x(key);
+    for (; low + 4 <= high; low += 4) {
+        //the mask of the keys greater than the key
+        mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(
+                        _mm256_loadu_si256((const __m256i *)(keys + low)),
+                        target)));
+        if (mask != 0) {
+            return low + __builtin_ctz(mask);
+        }
+    }
+    while (low < high && keys[low] <= key) {
+        low++;
+    }
+    return low;
+}
+#endif
+
+static void search_global_init()
+{
+#ifdef UNIQ_BPTREE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        int64_lower_bound = int64_lower_bound_avx2;
+        int64_upper_bound = int64_upper_bound_avx2;
+        return;
+    }
+#endif
+    int64_lower_bound = int64_lower_bound_scalar;
+    int64_upper_bound = int64_upper_bound_scalar;
+}
+
+int uniq_bptree_init_ex(UniqBPTreeFactory *factory, const int node_size,
+        skiplist_compare_func compare_func, uniq_bptree_free_func free_func,
+        const int key_offset, const int min_alloc_nodes_once,
+        const bool allocator_use_lock, void *arg)
+{
+    const int64_t alloc_elements_limit = 0;
+    int alloc_nodes_once;
+    int result;
+
+    memset(factory, 0, sizeof(UniqBPTreeFactory));
+    if (node_size < UNIQ_BPTREE_MIN_NODE_SIZE ||
+            node_size > UNIQ_BPTREE_MAX_NODE_SIZE)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "invalid node size: %d, which not in [%d, %d]", __LINE__,
+                node_size, UNIQ_BPTREE_MIN_NODE_SIZE,
+                UNIQ_BPTREE_MAX_NODE_SIZE);
+        return EINVAL;
+    }
+
+    if (key_offset < 0 && compare_func == NULL) {
+        logError("file: "__FILE__", line: %d, "
+                "the compare function is required when key offset < 0",
+                __LINE__);
+        return EINVAL;
+    }
+
+    pthread_once(&search_once, search_global_init);
+    factory->node_size = node_size;
+    factory->key_offset = key_offset;
+    factory->internal_capacity = (node_size - sizeof(UniqBPTreeNode) -
+            sizeof(UniqBPTreeNode *)) / (sizeof(UniqBPTreeKey) +
+                sizeof(UniqBPTreeNode *));
+    factory->children_offset = sizeof(UniqBPTreeKey) *
+        factory->internal_capacity;
+    if (key_offset >= 0) {
+        factory->leaf_capacity = (node_size - sizeof(UniqBPTreeNode)) /
+            (sizeof(UniqBPTreeKey) + sizeof(void *));
+        factory->leaf_data_offset = sizeof(UniqBPTreeKey) *
+            factory->leaf_capacity;
+    } else {
+        factory->leaf_capacity = (node_size - sizeof(UniqBPTreeNode)) /
+            sizeof(void *);
+        factory->leaf_data_offset = 0;
+    }
+    factory->leaf_capacity = FC_MIN(factory->leaf_capacity, SHRT_MAX);
+    factory->compare_func = compare_func;
+    factory->free_func = free_func;
+    factory->arg = arg;
+
+    alloc_nodes_once = (min_alloc_nodes_once > 0 ? min_alloc_nodes_once :
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE);
+    if ((result=fast_mblock_init_ex1(&factory->leaf_allocator,
+                    "bptree-leaf", node_size, alloc_nodes_once,
+                    alloc_elements_limit, NULL, NULL,
+                    allocator_use_lock)) != 0)
+    {
+        return result;
+    }
+
+    if ((result=fast_mblock_init_ex1(&factory->internal_allocator,
+                    "bptree-internal", node_size, FC_MAX(
+                        alloc_nodes_once / 8, 4), alloc_elements_limit,
+                    NULL, NULL, allocator_use_lock)) != 0)
+    {
+        return result;
+    }
+
+    return fast_mblock_init_ex1(&factory->tree_allocator, "bptree",
+            sizeof(UniqBPTree), 64, alloc_elements_limit,
+            NULL, NULL, allocator_use_lock);
+}
+
+void uniq_bptree_destroy(UniqBPTreeFactory *factory)
+{
+    fast_mblock_destroy(&factory->leaf_allocator);
+    fast_mblock_destroy(&factory->internal_allocator);
+    fast_mblock_destroy(&factory->tree_allocator);
+}
+
+static inline UniqBPTreeNode *alloc_node(UniqBPTreeFactory *factory,
+        const bool leaf)
+{
+    UniqBPTreeNode *node;
+
+    node = (UniqBPTreeNode *)fast_mblock_alloc_object(leaf ?
+            &factory->leaf_allocator : &factory->internal_allocator);
+    if (node != NULL) {
+        node->leaf = leaf;
+        node->count = 0;
+        node->prev = node->next = NULL;
+    }
+    return node;
+}
+
+static inline void free_node(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *node)
+{
+    fast_mblock_free_object(node->leaf ? &factory->leaf_allocator :
+            &factory->internal_allocator, node);
+}
+
+UniqBPTree *uniq_bptree_new(UniqBPTreeFactory *factory)
+{
+    UniqBPTree *tree;
+
+    tree = (UniqBPTree *)fast_mblock_alloc_object(&factory->tree_allocator);
+    if (tree == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if ((tree->root=alloc_node(factory, true)) == NULL) {
+        fast_mblock_free_object(&factory->tree_allocator, tree);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    tree->factory = factory;
+    tree->height = 1;
+    tree->element_count = 0;
+    tree->head = tree->tail = tree->root;
+    return tree;
+}
+
+static void free_subtree(UniqBPTree *tree, UniqBPTreeNode *node)
+{
+    UniqBPTreeNode **children;
+    void **datas;
+    int i;
+
+    if (node->leaf) {
+        if (tree->factory->free_func != NULL) {
+            datas = UNIQ_BPTREE_DATAS(tree->factory, node);
+            for (i=0; i<node->count; i++) {
+                tree->factory->free_func(tree, datas[i]);
+            }
+        }
+    } else {
+        children = UNIQ_BPTREE_CHILDREN(tree->factory, node);
+        for (i=0; i<=node->count; i++) {
+            free_subtree(tree, children[i]);
+        }
+    }
+
+    free_node(tree->factory, node);
+}
+
+void uniq_bptree_clear(UniqBPTree *tree)
+{
+    if (tree->height == 1 && tree->root->count == 0) {
+        return;
+    }
+
+    free_subtree(tree, tree->root);
+    tree->root = alloc_node(tree->factory, true);
+    tree->head = tree->tail = tree->root;
+    tree->height = 1;
+    tree->element_count = 0;
+}
+
+void uniq_bptree_free(UniqBPTree *tree)
+{
+    if (tree->root == NULL) {
+        return;
+    }
+
+    free_subtree(tree, tree->root);
+    tree->root = NULL;
+    fast_mblock_free_object(&tree->factory->tree_allocator, tree);
+}
+
+/* return the child index of the internal node for the data */
+static inline int internal_search(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *node, void *data, const int64_t key)
+{
+    UniqBPTreeKey *keys;
+    int low;
+    int high;
+    int mid;
+
+    keys = UNIQ_BPTREE_KEYS(node);
+    if (BPT_INT_MODE(factory)) {
+        return int64_upper_bound((const int64_t *)keys, node->count, key);
+    }
+
+    low = 0;
+    high = node->count;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (factory->compare_func(data, keys[mid].data) >= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* return the first position which data >= the data */
+static inline int leaf_search(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *node, void *data, const int64_t key, bool *found)
+{
+    void **datas;
+    int low;
+    int high;
+    int mid;
+    int cmp;
+
+    if (BPT_INT_MODE(factory)) {
+        low = int64_lower_bound((const int64_t *)
+                UNIQ_BPTREE_KEYS(node), node->count, key);
+        *found = (low < node->count && UNIQ_BPTREE_KEYS(node)[low].n == key);
+        return low;
+    }
+
+    datas = UNIQ_BPTREE_DATAS(factory, node);
+    *found = false;
+    low = 0;
+    high = node->count;
+    while (low < high) {
+        mid = (low + high) / 2;
+        cmp = factory->compare_func(data, datas[mid]);
+        if (cmp > 0) {
+            low = mid + 1;
+        } else {
+            if (cmp == 0) {
+                *found = true;
+                return mid;
+            }
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static inline UniqBPTreeNode *find_leaf(UniqBPTree *tree, void *data,
+        const int64_t key, BPTreePathEntry *path)
+{
+    UniqBPTreeNode *node;
+    int depth;
+
+    node = tree->root;
+    depth = 0;
+    while (!node->leaf) {
+        path[depth].node = node;
+        path[depth].index = internal_search(tree->factory, node, data, key);
+        node = UNIQ_BPTREE_CHILDREN(tree->factory, node)[path[depth].index];
+        depth++;
+    }
+    return node;
+}
+
+/* copy count items of the leaf src from src_pos to the leaf dest */
+static inline void leaf_move(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *dest, const int dest_pos, UniqBPTreeNode *src,
+        const int src_pos, const int count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    if (BPT_INT_MODE(factory)) {
+        memmove(UNIQ_BPTREE_KEYS(dest) + dest_pos, UNIQ_BPTREE_KEYS(src) +
+                src_pos, sizeof(UniqBPTreeKey) * count);
+    }
+    memmove(UNIQ_BPTREE_DATAS(factory, dest) + dest_pos,
+            UNIQ_BPTREE_DATAS(factory, src) + src_pos,
+            sizeof(void *) * count);
+}
+
+static inline void leaf_set(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *node, const int pos, void *data, const int64_t key)
+{
+    if (BPT_INT_MODE(factory)) {
+        UNIQ_BPTREE_KEYS(node)[pos].n = key;
+    }
+    UNIQ_BPTREE_DATAS(factory, node)[pos] = data;
+}
+
+static inline void leaf_insert(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *node, const int pos, void *data, const int64_t key)
+{
+    leaf_move(factory, node, pos + 1, node, pos, node->count - pos);
+    leaf_set(factory, node, pos, data, key);
+    node->count++;
+}
+
+/* the separator of the right node: the first key of the subtree */
+static inline UniqBPTreeKey leaf_first_key(UniqBPTreeFactory *factory,
+        UniqBPTreeNode *leaf)
+{
+    UniqBPTreeKey key;
+
+    if (BPT_INT_MODE(factory)) {
+        key.n = UNIQ_BPTREE_KEYS(leaf)[0].n;
+    } else {
+        key.data = UNIQ_BPTREE_DATAS(factory, leaf)[0];
+    }
+    return key;
+}
+
+static void leaf_split_insert(UniqBPTree *tree, UniqBPTreeNode *node,
+        UniqBPTreeNode *right, const int pos, void *data, const int64_t key)
+{
+    UniqBPTreeFactory *factory;
+    int capacity;
+    int left_count;
+
+    factory = tree->factory;
+    capacity = node->count;
+    left_count = (capacity + 1) / 2;
+    if (pos < left_count) {
+        leaf_move(factory, right, 0, node, left_count - 1,
+                capacity - left_count + 1);
+        node->count = left_count - 1;
+        leaf_insert(factory, node, pos, data, key);
+    } else {
+        leaf_move(factory, right, 0, node, left_count, pos - left_count);
+        leaf_set(factory, right, pos - left_count, data, key);
+        leaf_move(factory, right, pos - left_count + 1, node,
+                pos, capacity - pos);
+        node->count = left_count;
+    }
+    right->count = capacity + 1 - left_count;
+
+    right->prev = node;
+    right->next = node->next;
+    if (node->next != NULL) {
+        node->next->prev = right;
+    } else {
+        tree->tail = right;
+    }
+    node->next = right;
+}
+
+/* insert the separator and the right child after the child index of the
+ * internal node, split the node when full. the new nodes are preallocated */
+static void insert_into_parent(UniqBPTree *tree, BPTreePathEntry *path,
+        int depth, UniqBPTreeNode *right, UniqBPTreeKey separator,
+        UniqBPTreeNode **new_nodes)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeKey keys[UNIQ_BPTREE_MAX_CAPACITY + 1];
+    UniqBPTreeNode *children[UNIQ_BPTREE_MAX_CAPACITY + 2];
+    UniqBPTreeNode *node;
+    UniqBPTreeNode *new_node;
+    int index;
+    int count;
+    int mid;
+
+    factory = tree->factory;
+    while (--depth >= 0) {
+        node = path[depth].node;
+        index = path[depth].index;
+        if (node->count < factory->internal_capacity) {
+            memmove(UNIQ_BPTREE_KEYS(node) + index + 1,
+                    UNIQ_BPTREE_KEYS(node) + index,
+                    sizeof(UniqBPTreeKey) * (node->count - index));
+            memmove(UNIQ_BPTREE_CHILDREN(factory, node) + index + 2,
+                    UNIQ_BPTREE_CHILDREN(factory, node) + index + 1,
+                    sizeof(UniqBPTreeNode *) * (node->count - index));
+            UNIQ_BPTREE_KEYS(node)[index] = separator;
+            UNIQ_BPTREE_CHILDREN(factory, node)[index + 1] = right;
+            node->count++;
+            return;
+        }
+
+        count = node->count;
+        memcpy(keys, UNIQ_BPTREE_KEYS(node), sizeof(UniqBPTreeKey) * index);
+        keys[index] = separator;
+        memcpy(keys + index + 1, UNIQ_BPTREE_KEYS(node) + index,
+                sizeof(UniqBPTreeKey) * (count - index));
+        memcpy(children, UNIQ_BPTREE_CHILDREN(factory, node),
+                sizeof(UniqBPTreeNode *) * (index + 1));
+        children[index + 1] = right;
+        memcpy(children + index + 2, UNIQ_BPTREE_CHILDREN(factory, node) +
+                index + 1, sizeof(UniqBPTreeNode *) * (count - index));
+
+        //the keys count is count + 1, the middle one goes up
+        mid = (count + 1) / 2;
+        new_node = *new_nodes++;
+        memcpy(UNIQ_BPTREE_KEYS(node), keys, sizeof(UniqBPTreeKey) * mid);
+        memcpy(UNIQ_BPTREE_CHILDREN(factory, node), children,
+                sizeof(UniqBPTreeNode *) * (mid + 1));
+        node->count = mid;
+
+        new_node->count = count - mid;
+        memcpy(UNIQ_BPTREE_KEYS(new_node), keys + mid + 1,
+                sizeof(UniqBPTreeKey) * new_node->count);
+        memcpy(UNIQ_BPTREE_CHILDREN(factory, new_node), children + mid + 1,
+                sizeof(UniqBPTreeNode *) * (new_node->count + 1));
+
+        separator = keys[mid];
+        right = new_node;
+    }
+
+    //the root splits
+    new_node = *new_nodes;
+    new_node->count = 1;
+    UNIQ_BPTREE_KEYS(new_node)[0] = separator;
+    UNIQ_BPTREE_CHILDREN(factory, new_node)[0] = tree->root;
+    UNIQ_BPTREE_CHILDREN(factory, new_node)[1] = right;
+    tree->root = new_node;
+    tree->height++;
+}
+
+int uniq_bptree_insert(UniqBPTree *tree, void *data)
+{
+    UniqBPTreeFactory *factory;
+    BPTreePathEntry path[UNIQ_BPTREE_MAX_HEIGHT];
+    UniqBPTreeNode *new_nodes[UNIQ_BPTREE_MAX_HEIGHT + 1];
+    UniqBPTreeNode *leaf;
+    UniqBPTreeNode *right;
+    int64_t key;
+    bool found;
+    int depth;
+    int count;
+    int pos;
+    int i;
+
+    factory = tree->factory;
+    key = BPT_INT_MODE(factory) ? BPT_DATA_KEY(factory, data) : 0;
+    leaf = find_leaf(tree, data, key, path);
+    pos = leaf_search(factory, leaf, data, key, &found);
+    if (found) {
+        return EEXIST;
+    }
+
+    if (leaf->count < factory->leaf_capacity) {
+        leaf_insert(factory, leaf, pos, data, key);
+        tree->element_count++;
+        return 0;
+    }
+
+    //preallocate the internal nodes for the splits
+    depth = tree->height - 1;
+    if (depth >= UNIQ_BPTREE_MAX_HEIGHT) {
+        return E2BIG;
+    }
+    for (count=0; count<depth; count++) {
+        if (path[depth - 1 - count].node->count <
+                factory->internal_capacity)
+        {
+            break;
+        }
+    }
+    if (count == depth) {
+        count++;  //the new root
+    }
+    for (i=0; i<count; i++) {
+        if ((new_nodes[i]=alloc_node(factory, false)) == NULL) {
+            while (--i >= 0) {
+                free_node(factory, new_nodes[i]);
+            }
+            return ENOMEM;
+        }
+    }
+    if ((right=alloc_node(factory, true)) == NULL) {
+        for (i=0; i<count; i++) {
+            free_node(factory, new_nodes[i]);
+        }
+        return ENOMEM;
+    }
+
+    leaf_split_insert(tree, leaf, right, pos, data, key);
+    insert_into_parent(tree, path, depth, right,
+            leaf_first_key(factory, right), new_nodes);
+    tree->element_count++;
+    return 0;
+}
+
+static void leaf_rebalance(UniqBPTree *tree, UniqBPTreeNode *parent,
+        const int index, UniqBPTreeNode *node)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeNode **children;
+    UniqBPTreeNode *left;
+    UniqBPTreeNode *right;
+    int min_count;
+
+    factory = tree->factory;
+    children = UNIQ_BPTREE_CHILDREN(factory, parent);
+    left = (index > 0 ? children[index - 1] : NULL);
+    right = (index < parent->count ? children[index + 1] : NULL);
+    min_count = BPT_LEAF_MIN_COUNT(factory);
+
+    if (left != NULL && left->count > min_count) {  //borrow from left
+        leaf_move(factory, node, 1, node, 0, node->count);
+        leaf_move(factory, node, 0, left, left->count - 1, 1);
+        left->count--;
+        node->count++;
+        UNIQ_BPTREE_KEYS(parent)[index - 1] = leaf_first_key(factory, node);
+        return;
+    }
+
+    if (right != NULL && right->count > min_count) {  //borrow from right
+        leaf_move(factory, node, node->count, right, 0, 1);
+        node->count++;
+        leaf_move(factory, right, 0, right, 1, right->count - 1);
+        right->count--;
+        UNIQ_BPTREE_KEYS(parent)[index] = leaf_first_key(factory, right);
+        return;
+    }
+
+    if (left != NULL) {  //merge into the left
+        right = node;
+        node = left;
+    } else {
+        left = node;
+    }
+
+    //merge the right into the left
+    leaf_move(factory, left, left->count, right, 0, right->count);
+    left->count += right->count;
+    left->next = right->next;
+    if (right->next != NULL) {
+        right->next->prev = left;
+    } else {
+        tree->tail = left;
+    }
+}
+
+/* merge or borrow, return true for merged (the parent loses a key) */
+static bool rebalance(UniqBPTree *tree, UniqBPTreeNode *parent,
+        const int index, UniqBPTreeNode *node)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeNode **children;
+    UniqBPTreeNode *left;
+    UniqBPTreeNode *right;
+    UniqBPTreeKey *keys;
+    int old_count;
+    int sep_index;
+    int min_count;
+
+    factory = tree->factory;
+    children = UNIQ_BPTREE_CHILDREN(factory, parent);
+    keys = UNIQ_BPTREE_KEYS(parent);
+    if (node->leaf) {
+        old_count = parent->count;
+        left = (index > 0 ? children[index - 1] : NULL);
+        right = (index < parent->count ? children[index + 1] : NULL);
+        min_count = BPT_LEAF_MIN_COUNT(factory);
+        if ((left != NULL && left->count > min_count) ||
+                (right != NULL && right->count > min_count))
+        {
+            leaf_rebalance(tree, parent, index, node);
+            return false;
+        }
+
+        leaf_rebalance(tree, parent, index, node);
+        sep_index = (left != NULL ? index - 1 : index);
+        free_node(factory, children[sep_index + 1]);
+    } else {
+        left = (index > 0 ? children[index - 1] : NULL);
+        right = (index < parent->count ? children[index + 1] : NULL);
+        min_count = BPT_INTERNAL_MIN_COUNT(factory);
+        if (left != NULL && left->count > min_count) {  //borrow from left
+            memmove(UNIQ_BPTREE_KEYS(node) + 1, UNIQ_BPTREE_KEYS(node),
+                    sizeof(UniqBPTreeKey) * node->count);
+            memmove(UNIQ_BPTREE_CHILDREN(factory, node) + 1,
+                    UNIQ_BPTREE_CHILDREN(factory, node),
+                    sizeof(UniqBPTreeNode *) * (node->count + 1));
+            UNIQ_BPTREE_KEYS(node)[0] = keys[index - 1];
+            UNIQ_BPTREE_CHILDREN(factory, node)[0] = UNIQ_BPTREE_CHILDREN(
+                    factory, left)[left->count];
+            keys[index - 1] = UNIQ_BPTREE_KEYS(left)[left->count - 1];
+            left->count--;
+            node->count++;
+            return false;
+        }
+
+        if (right != NULL && right->count > min_count) {  //borrow from right
+            UNIQ_BPTREE_KEYS(node)[node->count] = keys[index];
+            UNIQ_BPTREE_CHILDREN(factory, node)[node->count + 1] =
+                UNIQ_BPTREE_CHILDREN(factory, right)[0];
+            node->count++;
+            keys[index] = UNIQ_BPTREE_KEYS(right)[0];
+            memmove(UNIQ_BPTREE_KEYS(right), UNIQ_BPTREE_KEYS(right) + 1,
+                    sizeof(UniqBPTreeKey) * (right->count - 1));
+            memmove(UNIQ_BPTREE_CHILDREN(factory, right),
+                    UNIQ_BPTREE_CHILDREN(factory, right) + 1,
+                    sizeof(UniqBPTreeNode *) * right->count);
+            right->count--;
+            return false;
+        }
+
+        if (left != NULL) {
+            right = node;
+            sep_index = index - 1;
+        } else {
+            left = node;
+            sep_index = index;
+        }
+
+        //pull down the separator and merge the right into the left
+        UNIQ_BPTREE_KEYS(left)[left->count] = keys[sep_index];
+        memcpy(UNIQ_BPTREE_KEYS(left) + left->count + 1,
+                UNIQ_BPTREE_KEYS(right), sizeof(UniqBPTreeKey) *
+                right->count);
+        memcpy(UNIQ_BPTREE_CHILDREN(factory, left) + left->count + 1,
+                UNIQ_BPTREE_CHILDREN(factory, right),
+                sizeof(UniqBPTreeNode *) * (right->count + 1));
+        left->count += right->count + 1;
+        free_node(factory, right);
+        old_count = parent->count;
+    }
+
+    //remove the separator and the right child from the parent
+    memmove(keys + sep_index, keys + sep_index + 1,
+            sizeof(UniqBPTreeKey) * (old_count - sep_index - 1));
+    memmove(children + sep_index + 1, children + sep_index + 2,
+            sizeof(UniqBPTreeNode *) * (old_count - sep_index - 1));
+    parent->count--;
+    return true;
+}
+
+/* the separators of the compare_func mode are the data, replace the
+ * separators which equal to the old data along the path */
+static void replace_separators(UniqBPTree *tree, BPTreePathEntry *path,
+        const int depth, void *old_data, void *new_data)
+{
+    UniqBPTreeKey *keys;
+    int index;
+    int i;
+
+    for (i=0; i<depth; i++) {
+        index = path[i].index;
+        if (index > 0) {
+            keys = UNIQ_BPTREE_KEYS(path[i].node);
+            if (keys[index - 1].data == old_data) {
+                keys[index - 1].data = new_data;
+            }
+        }
+    }
+}
+
+int uniq_bptree_delete_ex(UniqBPTree *tree, void *data,
+        const bool need_free)
+{
+    UniqBPTreeFactory *factory;
+    BPTreePathEntry path[UNIQ_BPTREE_MAX_HEIGHT];
+    UniqBPTreeNode *leaf;
+    UniqBPTreeNode *node;
+    UniqBPTreeNode *old_root;
+    void *deleted;
+    int64_t key;
+    bool found;
+    int depth;
+    int pos;
+
+    factory = tree->factory;
+    key = BPT_INT_MODE(factory) ? BPT_DATA_KEY(factory, data) : 0;
+    leaf = find_leaf(tree, data, key, path);
+    pos = leaf_search(factory, leaf, data, key, &found);
+    if (!found) {
+        return ENOENT;
+    }
+
+    deleted = UNIQ_BPTREE_DATAS(factory, leaf)[pos];
+    if (!BPT_INT_MODE(factory) && pos == 0 && tree->height > 1) {
+        /* the deleted data maybe the separator, replace it with the
+         * next data of the leaf (the non-root leaf has two data at least) */
+        replace_separators(tree, path, tree->height - 1, deleted,
+                UNIQ_BPTREE_DATAS(factory, leaf)[1]);
+    }
+
+    leaf_move(factory, leaf, pos, leaf, pos + 1, leaf->count - pos - 1);
+    leaf->count--;
+    tree->element_count--;
+
+    node = leaf;
+    depth = tree->height - 1;
+    while (depth > 0 && node->count < (node->leaf ?
+                BPT_LEAF_MIN_COUNT(factory) :
+                BPT_INTERNAL_MIN_COUNT(factory)))
+    {
+        depth--;
+        if (!rebalance(tree, path[depth].node, path[depth].index, node)) {
+            break;
+        }
+        node = path[depth].node;
+    }
+
+    if (!tree->root->leaf && tree->root->count == 0) {
+        old_root = tree->root;
+        tree->root = UNIQ_BPTREE_CHILDREN(factory, old_root)[0];
+        tree->height--;
+        free_node(factory, old_root);
+    }
+
+    if (need_free && factory->free_func != NULL) {
+        factory->free_func(tree, deleted);
+    }
+    return 0;
+}
+
+int uniq_bptree_replace_ex(UniqBPTree *tree, void *data,
+        const bool need_free_old)
+{
+    UniqBPTreeFactory *factory;
+    BPTreePathEntry path[UNIQ_BPTREE_MAX_HEIGHT];
+    UniqBPTreeNode *leaf;
+    void *old_data;
+    int64_t key;
+    bool found;
+    int pos;
+
+    factory = tree->factory;
+    key = BPT_INT_MODE(factory) ? BPT_DATA_KEY(factory, data) : 0;
+    leaf = find_leaf(tree, data, key, path);
+    pos = leaf_search(factory, leaf, data, key, &found);
+    if (!found) {
+        return ENOENT;
+    }
+
+    old_data = UNIQ_BPTREE_DATAS(factory, leaf)[pos];
+    UNIQ_BPTREE_DATAS(factory, leaf)[pos] = data;
+    if (!BPT_INT_MODE(factory) && pos == 0) {
+        replace_separators(tree, path, tree->height - 1, old_data, data);
+    }
+
+    if (need_free_old && factory->free_func != NULL) {
+        factory->free_func(tree, old_data);
+    }
+    return 0;
+}
+
+void *uniq_bptree_find(UniqBPTree *tree, void *data)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeNode *node;
+    int64_t key;
+    bool found;
+    int pos;
+
+    factory = tree->factory;
+    key = BPT_INT_MODE(factory) ? BPT_DATA_KEY(factory, data) : 0;
+    node = tree->root;
+    while (!node->leaf) {
+        node = UNIQ_BPTREE_CHILDREN(factory, node)[
+            internal_search(factory, node, data, key)];
+    }
+
+    pos = leaf_search(factory, node, data, key, &found);
+    return (found ? UNIQ_BPTREE_DATAS(factory, node)[pos] : NULL);
+}
+
+/* the position of the first data >= (or > when greater is true) the data,
+ * the position is (NULL, 0) for the end of the tree */
+static void find_position(UniqBPTree *tree, void *data,
+        const bool greater, UniqBPTreeNode **leaf, int *pos)
+{
+    UniqBPTreeFactory *factory;
+    UniqBPTreeNode *node;
+    int64_t key;
+    bool found;
+
+    factory = tree->factory;
+    key = BPT_INT_MODE(factory) ? BPT_DATA_KEY(factory, data) : 0;
+    node = tree->root;
+    while (!node->leaf) {
+        node = UNIQ_BPTREE_CHILDREN(factory, node)[
+            internal_search(factory, node, data, key)];
+    }
+
+    *pos = leaf_search(factory, node, data, key, &found);
+    if (found && greater) {
+        (*pos)++;
+    }
+    if (*pos == node->count) {
+        node = node->next;
+        *pos = 0;
+    }
+    *leaf = node;
+}
+
+void *uniq_bptree_find_ge(UniqBPTree *tree, void *data)
+{
+    UniqBPTreeNode *leaf;
+    int pos;
+
+    find_position(tree, data, false, &leaf, &pos);
+    return (leaf != NULL ? UNIQ_BPTREE_DATAS(tree->factory,
+                leaf)[pos] : NULL);
+}
+
+int uniq_bptree_find_range(UniqBPTree *tree, void *start_data,
+        void *end_data, UniqBPTreeIterator *iterator)
+{
+    UniqBPTreeFactory *factory;
+
+    factory = tree->factory;
+    iterator->data_offset = factory->leaf_data_offset;
+    if ((BPT_INT_MODE(factory) ? fc_compare_int64(BPT_DATA_KEY(factory,
+                        start_data), BPT_DATA_KEY(factory, end_data)) :
+                factory->compare_func(start_data, end_data)) > 0)
+    {
+        iterator->leaf = iterator->end_leaf = NULL;
+        iterator->index = iterator->end_index = 0;
+        return EINVAL;
+    }
+
+    find_position(tree, start_data, false,
+            &iterator->leaf, &iterator->index);
+    find_position(tree, end_data, true,
+            &iterator->end_leaf, &iterator->end_index);
+    return (iterator->leaf == iterator->end_leaf &&
+            iterator->index == iterator->end_index) ? ENOENT : 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2020 YuQing <384681@qq.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the Lesser GNU General Public License, version 3
+ * or later ("LGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the Lesser GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+//uniq_bptree.h: in-memory B+tree of unique data with the APIs of
+//               uniq_skiplist. the node is some cache lines or a page,
+//               the leaves are linked for the range iteration
+
+#ifndef _UNIQ_BPTREE_H
+#define _UNIQ_BPTREE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common_define.h"
+#include "skiplist_common.h"
+#include "fast_mblock.h"
+
+#define UNIQ_BPTREE_DEFAULT_NODE_SIZE  512
+#define UNIQ_BPTREE_MIN_NODE_SIZE      128
+#define UNIQ_BPTREE_MAX_NODE_SIZE     8192
+#define UNIQ_BPTREE_MAX_HEIGHT          32
+
+/* the capacity of the nodes, not exceeds the max node size / 8 */
+#define UNIQ_BPTREE_MAX_CAPACITY  (UNIQ_BPTREE_MAX_NODE_SIZE / 8)
+
+struct uniq_bptree;
+typedef void (*uniq_bptree_free_func)(struct uniq_bptree *tree, void *ptr);
+
+/* the key of the integer key mode or the separator data of internal node */
+typedef union uniq_bptree_key {
+    int64_t n;
+    void *data;
+} UniqBPTreeKey;
+
+/* the node is followed by the arrays:
+ *   leaf node: int64 keys (integer key mode only), data pointers
+ *   internal node: keys (int64 keys or the separator data),
+ *                  children (count + 1) */
+typedef struct uniq_bptree_node
+{
+    bool leaf;
+    short count;     //the data count of leaf, the separator count of internal
+    struct uniq_bptree_node *prev;  //the leaf chain
+    struct uniq_bptree_node *next;
+} UniqBPTreeNode;
+
+typedef struct uniq_bptree_factory
+{
+    int node_size;
+    int leaf_capacity;
+    int internal_capacity;
+    int leaf_data_offset;     //the offset of the data array of leaf node
+    int children_offset;      //the offset of the children of internal node
+    int key_offset;           //the int64 key offset of the data, -1 for none
+    skiplist_compare_func compare_func;
+    uniq_bptree_free_func free_func;
+    struct fast_mblock_man tree_allocator;
+    struct fast_mblock_man leaf_allocator;
+    struct fast_mblock_man internal_allocator;
+    void *arg;
+} UniqBPTreeFactory;
+
+typedef struct uniq_bptree
+{
+    UniqBPTreeFactory *factory;
+    int height;         //1 for the root is a leaf
+    int element_count;
+    UniqBPTreeNode *root;
+    UniqBPTreeNode *head;  //the first leaf
+    UniqBPTreeNode *tail;  //the last leaf
+} UniqBPTree;
+
+typedef struct uniq_bptree_iterator {
+    UniqBPTreeNode *leaf;      //NULL for the end of the tree
+    int index;
+    UniqBPTreeNode *end_leaf;  //the end position (excluded)
+    int end_index;
+    int data_offset;           //the leaf_data_offset of the factory
+} UniqBPTreeIterator;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNIQ_BPTREE_KEYS(node)  ((UniqBPTreeKey *)((node) + 1))
+#define UNIQ_BPTREE_DATAS(factory, node)  ((void **)((char *)((node) + 1) + \
+            (factory)->leaf_data_offset))
+#define UNIQ_BPTREE_CHILDREN(factory, node)  ((UniqBPTreeNode **) \
+        ((char *)((node) + 1) + (factory)->children_offset))
+
+#define uniq_bptree_count(tree) (tree)->element_count
+#define uniq_bptree_empty(tree) ((tree)->element_count == 0)
+
+#define uniq_bptree_init(factory, compare_func, free_func) \
+    uniq_bptree_init_ex(factory, UNIQ_BPTREE_DEFAULT_NODE_SIZE, \
+            compare_func, free_func, -1, \
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE, false, NULL)
+
+#define uniq_bptree_init_int64(factory, key_offset, free_func) \
+    uniq_bptree_init_ex(factory, UNIQ_BPTREE_DEFAULT_NODE_SIZE, \
+            NULL, free_func, key_offset, \
+            SKIPLIST_DEFAULT_MIN_ALLOC_ELEMENTS_ONCE, false, NULL)
+
+#define uniq_bptree_delete(tree, data)  \
+    uniq_bptree_delete_ex(tree, data, true)
+
+#define uniq_bptree_replace(tree, data) \
+    uniq_bptree_replace_ex(tree, data, true)
+
+/**
+ * init the factory of the B+trees
+ * parameters:
+ *         factory: the factory
+ *         node_size: the bytes of the node, such as 256 for 4 cache lines,
+ *                    or 4096 for a page
+ *         compare_func: the compare function of the data, can be NULL
+ *                       for the integer key mode
+ *         free_func: the function to free the data, can be NULL
+ *         key_offset: the offset of the int64 key in the data for the
+ *                     integer key mode, -1 for the compare_func mode.
+ *                     the keys are stored in the nodes and searched by SIMD
+ *         min_alloc_nodes_once: the min node count to allocate once
+ *         allocator_use_lock: if the allocators need lock
+ *         arg: the extra argument
+ * return 0 for success, != 0 for error
+*/
+int uniq_bptree_init_ex(UniqBPTreeFactory *factory, const int node_size,
+        skiplist_compare_func compare_func, uniq_bptree_free_func free_func,
+        const int key_offset, const int min_alloc_nodes_once,
+        const bool allocator_use_lock, void *arg);
+
+void uniq_bptree_destroy(UniqBPTreeFactory *factory);
+
+UniqBPTree *uniq_bptree_new(UniqBPTreeFactory *factory);
+
+void uniq_bptree_free(UniqBPTree *tree);
+
+void uniq_bptree_clear(UniqBPTree *tree);
+
+/**
+ * insert the data
+ * return 0 for success, EEXIST for the data exists, != 0 for error
+*/
+int uniq_bptree_insert(UniqBPTree *tree, void *data);
+
+/**
+ * delete the data
+ * parameters:
+ *         tree: the B+tree
+ *         data: the data to delete, only the key is used
+ *         need_free: if call the free_func of the factory
+ * return 0 for success, ENOENT for not exist
+*/
+int uniq_bptree_delete_ex(UniqBPTree *tree, void *data,
+        const bool need_free);
+
+/**
+ * replace the data with the same key
+ * return 0 for success, ENOENT for not exist
+*/
+int uniq_bptree_replace_ex(UniqBPTree *tree, void *data,
+        const bool need_free_old);
+
+void *uniq_bptree_find(UniqBPTree *tree, void *data);
+
+/* return the first data which is greater than or equal to the data */
+void *uniq_bptree_find_ge(UniqBPTree *tree, void *data);
+
+/**
+ * find the data in [start_data, end_data]
+ * return 0 for success, ENOENT for not found, EINVAL for invalid range
+*/
+int uniq_bptree_find_range(UniqBPTree *tree, void *start_data,
+        void *end_data, UniqBPTreeIterator *iterator);
+
+static inline void uniq_bptree_iterator(UniqBPTree *tree,
+        UniqBPTreeIterator *iterator)
+{
+    iterator->leaf = (tree->element_count > 0 ? tree->head : NULL);
+    iterator->index = 0;
+    iterator->end_leaf = NULL;
+    iterator->end_index = 0;
+    iterator->data_offset = tree->factory->leaf_data_offset;
+}
+
+static inline void *uniq_bptree_next(UniqBPTreeIterator *iterator)
+{
+    void *data;
+
+    if (iterator->leaf == iterator->end_leaf &&
+            iterator->index == iterator->end_index)
+    {
+        return NULL;
+    }
+
+    data = ((void **)((char *)(iterator->leaf + 1) +
+                iterator->data_offset))[iterator->index];
+    if (++iterator->index == iterator->leaf->count) {
+        iterator->leaf = iterator->leaf->next;
+        iterator->index = 0;
+    }
+    return data;
+}
+
+static inline void *uniq_bptree_get_first(UniqBPTree *tree)
+{
+    return (tree->element_count > 0 ? UNIQ_BPTREE_DATAS(
+                tree->factory, tree->head)[0] : NULL);
+}
+
+static inline void *uniq_bptree_get_last(UniqBPTree *tree)
+{
+    return (tree->element_count > 0 ? UNIQ_BPTREE_DATAS(tree->factory,
+                tree->tail)[tree->tail->count - 1] : NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
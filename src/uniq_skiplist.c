@@ -26,6 +26,16 @@
 
 static int best_element_counts[SKIPLIST_MAX_LEVEL_COUNT] = {0};
 
+#define USL_NODE_STATE_INSERTING  1
+#define USL_NODE_STATE_DELETED    2
+#define USL_NODE_STATE_NEED_FREE  4
+
+#define USL_LOAD_LINK(node, i) __atomic_load_n(&(node)->links[i], \
+        __ATOMIC_ACQUIRE)
+#define USL_MARKED_LINK(node)  ((UniqSkiplistNode *)((uintptr_t)(node) | 1))
+#define USL_CAS_LINK(node, i, old_value, new_value) \
+    __sync_bool_compare_and_swap(&(node)->links[i], old_value, new_value)
+
 #define UNIQ_SKIPLIST_FREE_MBLOCK_OBJECT(sl, level_index, deleted) \
     do { \
         if (sl->factory->delay_free_seconds > 0) { \
@@ -102,7 +112,8 @@ int uniq_skiplist_init_ex2(UniqSkiplistFactory *factory,
     for (i=max_level_count-1; i>=0; i--) {
         sprintf(name, "uniq-sl-level%02d", i);
         element_size = sizeof(UniqSkiplistNode) +
-            sizeof(UniqSkiplistNode *) * (i + 1 + extra_links_count);
+            sizeof(UniqSkiplistNode *) * (i + 1 + extra_links_count) +
+            sizeof(int) * (i + 1);  //the span widths
         if ((result=fast_mblock_init_ex1(factory->node_allocators + i,
                         name, element_size, alloc_elements_once,
                         alloc_elements_limit, NULL, NULL,
@@ -137,8 +148,6 @@ int uniq_skiplist_init_ex2(UniqSkiplistFactory *factory,
     factory->free_func = free_func;
     factory->delay_free_seconds = delay_free_seconds;
     factory->arg = arg;
-
-    srand(time(NULL));
     return 0;
 }
 
@@ -164,14 +173,17 @@ void uniq_skiplist_destroy(UniqSkiplistFactory *factory)
 
 static inline void init_chain(UniqSkiplist *sl)
 {
+    int *widths;
     int i;
 
     if (sl->factory->bidirection) {
         LEVEL0_DOUBLE_CHAIN_TAIL(sl) = sl->top;
     }
 
+    widths = UNIQ_SKIPLIST_WIDTHS(sl, sl->top);
     for (i=0; i<=sl->top_level_index; i++) {
         sl->top->links[i] = sl->factory->tail;
+        widths[i] = 1;
     }
 }
 
@@ -202,6 +214,8 @@ UniqSkiplist *uniq_skiplist_new(UniqSkiplistFactory *factory,
             &factory->skiplist_allocator);
     sl->element_count = 0;
     sl->factory = factory;
+    sl->epoch = NULL;
+    sl->rand_seq = skiplist_rand_seed(sl);
 
     sl->top_level_index = level_count - 1;
     top_mblock = sl->factory->node_allocators + sl->top_level_index;
@@ -243,8 +257,12 @@ static int uniq_skiplist_grow(UniqSkiplist *sl)
 
     for (i=0; i<=old_top_level_index; i++) {
         new_top->links[i] = old_top->links[i];
+        UNIQ_SKIPLIST_WIDTHS(sl, new_top)[i] =
+            UNIQ_SKIPLIST_WIDTHS(sl, old_top)[i];
     }
     new_top->links[top_level_index] = sl->factory->tail;
+    UNIQ_SKIPLIST_WIDTHS(sl, new_top)[top_level_index] =
+        sl->element_count + 1;
 
     if (sl->factory->bidirection) {
         if (new_top->links[0] != sl->factory->tail) {  //not empty
@@ -273,7 +291,7 @@ static void do_clear(UniqSkiplist *sl)
     if (sl->factory->free_func != NULL) {
         while (node != sl->factory->tail) {
             deleted = node;
-            node = node->links[0];
+            node = UNIQ_SKIPLIST_LINK_NODE(node->links[0]);
 
             sl->factory->free_func(sl, deleted->data, 0);
             fast_mblock_free_object(sl->factory->node_allocators +
@@ -282,7 +300,7 @@ static void do_clear(UniqSkiplist *sl)
     } else {
         while (node != sl->factory->tail) {
             deleted = node;
-            node = node->links[0];
+            node = UNIQ_SKIPLIST_LINK_NODE(node->links[0]);
 
             fast_mblock_free_object(sl->factory->node_allocators +
                     deleted->level_index, (void *)deleted);
@@ -306,6 +324,13 @@ void uniq_skiplist_free(UniqSkiplist *sl)
         return;
     }
 
+    if (sl->epoch != NULL) {
+        //free the retired nodes
+        fc_epoch_destroy(sl->epoch);
+        free(sl->epoch);
+        sl->epoch = NULL;
+    }
+
     if (!uniq_skiplist_empty(sl)) {
         do_clear(sl);
     }
@@ -317,45 +342,461 @@ void uniq_skiplist_free(UniqSkiplist *sl)
     fast_mblock_free_object(&sl->factory->skiplist_allocator, sl);
 }
 
+static inline int concurrent_get_level_index(UniqSkiplist *sl)
+{
+    uint64_t x;
+    int level_index;
+
+    //splitmix64 of the sequence, the trailing ones for the probability 1/2
+    x = __sync_add_and_fetch(&sl->rand_seq, 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    level_index = __builtin_ctzll(~x);
+    return FC_MIN(level_index, sl->top_level_index);
+}
+
+/* one random scheme per mode: the concurrent mode updates rand_seq by
+ * the atomic add only, the xorshift RMW is for the single writer mode */
 static inline int uniq_skiplist_get_level_index(UniqSkiplist *sl)
 {
+    uint64_t rand_state;
+    int level_index;
+
+    if (sl->epoch != NULL) {
+        return concurrent_get_level_index(sl);
+    }
+
+    rand_state = sl->rand_seq;
+    level_index = skiplist_rand_level_index(&rand_state,
+            sl->top_level_index);
+    sl->rand_seq = rand_state;
+    return level_index;
+}
+
+static void concurrent_free_node(void *ptr, void *arg)
+{
+    UniqSkiplist *sl;
+    UniqSkiplistNode *node;
+
+    sl = (UniqSkiplist *)arg;
+    node = (UniqSkiplistNode *)ptr;
+    if ((node->state & USL_NODE_STATE_NEED_FREE) &&
+            sl->factory->free_func != NULL)
+    {
+        sl->factory->free_func(sl, node->data, 0);
+    }
+    fast_mblock_free_object(sl->factory->node_allocators +
+            node->level_index, node);
+}
+
+int uniq_skiplist_set_concurrent(UniqSkiplist *sl, const int max_threads)
+{
+    int result;
+
+    if (sl->epoch != NULL) {
+        return EEXIST;
+    }
+
+    if (sl->factory->bidirection ||
+            !sl->factory->node_allocators[0].need_lock)
+    {
+        logError("file: "__FILE__", line: %d, "
+                "the concurrent mode requires the factory with "
+                "allocator_use_lock true and bidirection false", __LINE__);
+        return EINVAL;
+    }
+
+    if (!uniq_skiplist_empty(sl)) {
+        return EBUSY;
+    }
+
+    //the top node can NOT be replaced under the concurrent access
+    while (sl->top_level_index < sl->factory->max_level_count - 1) {
+        if ((result=uniq_skiplist_grow(sl)) != 0) {
+            return result;
+        }
+    }
+
+    sl->epoch = (FCEpochContext *)fc_malloc(sizeof(FCEpochContext));
+    if (sl->epoch == NULL) {
+        return ENOMEM;
+    }
+
+    if ((result=fc_epoch_init(sl->epoch, max_threads,
+                    concurrent_free_node, sl)) != 0)
+    {
+        free(sl->epoch);
+        sl->epoch = NULL;
+    }
+    return result;
+}
+
+/* search the predecessors and the successors of all levels, and unlink
+ * the deleted (marked) nodes along the way (Herlihy and Shavit) */
+static bool concurrent_search(UniqSkiplist *sl, void *data,
+        UniqSkiplistNode **preds, UniqSkiplistNode **succs)
+{
+    UniqSkiplistNode *pred;
+    UniqSkiplistNode *curr;
+    UniqSkiplistNode *succ;
+    int cmp;
     int i;
 
-    for (i=0; i<sl->top_level_index; i++) {
-        if (rand() < RAND_MAX / 2) {
-            break;
+retry:
+    cmp = 1;
+    pred = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        curr = UNIQ_SKIPLIST_LINK_NODE(USL_LOAD_LINK(pred, i));
+        cmp = 1;
+        while (curr != sl->factory->tail) {
+            succ = (UniqSkiplistNode *)USL_LOAD_LINK(curr, i);
+            if (UNIQ_SKIPLIST_LINK_MARKED(succ)) {
+                succ = UNIQ_SKIPLIST_LINK_NODE(succ);
+                if (!USL_CAS_LINK(pred, i, curr, succ)) {
+                    goto retry;
+                }
+                curr = succ;
+                continue;
+            }
+
+            cmp = sl->factory->compare_func(data, curr->data);
+            if (cmp <= 0) {
+                break;
+            }
+            pred = curr;
+            curr = succ;
         }
+
+        preds[i] = pred;
+        succs[i] = curr;
     }
 
-    return i;
+    return (succs[0] != sl->factory->tail && cmp == 0);
 }
 
-int uniq_skiplist_insert(UniqSkiplist *sl, void *data)
+/* the lock-free search without any modification, return the first
+ * node which is greater than or equal to the data */
+static UniqSkiplistNode *concurrent_find_ge(UniqSkiplist *sl,
+        void *data, int *cmp)
 {
+    UniqSkiplistNode *pred;
+    UniqSkiplistNode *curr;
+    UniqSkiplistNode *succ;
     int i;
-    int level_index;
+
+    pred = sl->top;
+    curr = sl->factory->tail;
+    for (i=sl->top_level_index; i>=0; i--) {
+        curr = UNIQ_SKIPLIST_LINK_NODE(USL_LOAD_LINK(pred, i));
+        *cmp = 1;
+        while (curr != sl->factory->tail) {
+            succ = (UniqSkiplistNode *)USL_LOAD_LINK(curr, i);
+            if (UNIQ_SKIPLIST_LINK_MARKED(succ)) {
+                curr = UNIQ_SKIPLIST_LINK_NODE(succ);
+                continue;
+            }
+
+            *cmp = sl->factory->compare_func(data, curr->data);
+            if (*cmp <= 0) {
+                break;
+            }
+            pred = curr;
+            curr = succ;
+        }
+
+        if (*cmp == 0 && !UNIQ_SKIPLIST_LINK_MARKED(
+                    USL_LOAD_LINK(curr, 0)))
+        {
+            return curr;
+        }
+    }
+
+    return curr;
+}
+
+static inline UniqSkiplistNode *concurrent_find(
+        UniqSkiplist *sl, void *data)
+{
+    UniqSkiplistNode *node;
+    int cmp;
+
+    node = concurrent_find_ge(sl, data, &cmp);
+    return (node != sl->factory->tail && cmp == 0) ? node : NULL;
+}
+
+/* unlink the deleted node from all levels by the node identity. the node
+ * of the same key inserted again may be linked ahead of the deleted one,
+ * so walk past all nodes of the key instead of stopping at the first one.
+ * the links of the deleted node are marked at all levels, it is unlinked
+ * as the marked one when reached, and can NOT be linked again after that */
+static void concurrent_unlink(UniqSkiplist *sl, UniqSkiplistNode *node)
+{
+    UniqSkiplistNode *pred;
+    UniqSkiplistNode *prev;
+    UniqSkiplistNode *curr;
+    UniqSkiplistNode *succ;
     int cmp;
+    int i;
+
+retry:
+    pred = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        prev = pred;
+        curr = UNIQ_SKIPLIST_LINK_NODE(USL_LOAD_LINK(prev, i));
+        while (curr != sl->factory->tail) {
+            succ = (UniqSkiplistNode *)USL_LOAD_LINK(curr, i);
+            if (UNIQ_SKIPLIST_LINK_MARKED(succ)) {
+                succ = UNIQ_SKIPLIST_LINK_NODE(succ);
+                if (!USL_CAS_LINK(prev, i, curr, succ)) {
+                    goto retry;
+                }
+                curr = succ;
+                continue;
+            }
+
+            cmp = sl->factory->compare_func(node->data, curr->data);
+            if (cmp < 0) {
+                break;
+            }
+            if (cmp > 0) {
+                pred = curr;  //the lower level starts before the key
+            }
+            prev = curr;
+            curr = succ;
+        }
+    }
+}
+
+static void concurrent_retire(UniqSkiplist *sl, UniqSkiplistNode *node)
+{
+    //reclaim only after unreachable from all levels
+    concurrent_unlink(sl, node);
+    fc_epoch_retire(sl->epoch, node);
+}
+
+/* the node is linked at level 0 first, it is in the skiplist after
+ * that, and then linked at the upper levels one by one. the deleted node
+ * is retired by the deleter or the inserter who finishes later */
+static int concurrent_insert(UniqSkiplist *sl, void *data)
+{
+    UniqSkiplistNode *preds[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *succs[SKIPLIST_MAX_LEVEL_COUNT];
     UniqSkiplistNode *node;
-    volatile UniqSkiplistNode *previous;
-    volatile UniqSkiplistNode *tmp_previous[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *old;
+    int level_index;
+    int state;
+    int i;
 
     level_index = uniq_skiplist_get_level_index(sl);
-    previous = sl->top;
-    for (i=sl->top_level_index; i>level_index; i--) {
-        while (previous->links[i] != sl->factory->tail) {
-            cmp = sl->factory->compare_func(data, previous->links[i]->data);
-            if (cmp < 0) {
+    node = NULL;
+    while (1) {
+        if (concurrent_search(sl, data, preds, succs)) {
+            if (node != NULL) {
+                fast_mblock_free_object(sl->factory->
+                        node_allocators + level_index, node);
+            }
+            return EEXIST;
+        }
+
+        if (node == NULL) {
+            node = (UniqSkiplistNode *)fast_mblock_alloc_object(
+                    sl->factory->node_allocators + level_index);
+            if (node == NULL) {
+                return ENOMEM;
+            }
+            node->level_index = level_index;
+            node->data = data;
+            node->state = USL_NODE_STATE_INSERTING;
+        }
+
+        for (i=0; i<=level_index; i++) {
+            node->links[i] = succs[i];
+        }
+        if (USL_CAS_LINK(preds[0], 0, succs[0], node)) {
+            break;
+        }
+    }
+    __sync_add_and_fetch(&sl->element_count, 1);
+
+    for (i=1; i<=level_index; i++) {
+        while (1) {
+            old = (UniqSkiplistNode *)USL_LOAD_LINK(node, i);
+            if (UNIQ_SKIPLIST_LINK_MARKED(old)) {  //deleting
+                goto done;
+            }
+            if (old != succs[i] && !USL_CAS_LINK(node, i, old, succs[i])) {
+                goto done;
+            }
+            if (USL_CAS_LINK(preds[i], i, succs[i], node)) {
                 break;
             }
-            else if (cmp == 0) {
-                return EEXIST;
+
+            concurrent_search(sl, data, preds, succs);
+            if (succs[0] != node) {  //deleted
+                goto done;
             }
+        }
+    }
 
-            previous = previous->links[i];
+done:
+    state = __sync_fetch_and_and(&node->state, ~USL_NODE_STATE_INSERTING);
+    if ((state & USL_NODE_STATE_DELETED)) {
+        concurrent_retire(sl, node);
+    }
+    return 0;
+}
+
+/* mark the links of the node from the top level to level 0,
+ * the node is deleted by the thread who marks the level 0 */
+static int concurrent_delete(UniqSkiplist *sl, void *data,
+        UniqSkiplistNode *expect, const bool need_free)
+{
+    UniqSkiplistNode *preds[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *succs[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *node;
+    UniqSkiplistNode *succ;
+    int state;
+    int i;
+
+    if (!concurrent_search(sl, data, preds, succs)) {
+        return ENOENT;
+    }
+
+    node = succs[0];
+    if (expect != NULL && node != expect) {  //the stale node
+        return ENOENT;
+    }
+    for (i=node->level_index; i>=1; i--) {
+        succ = (UniqSkiplistNode *)USL_LOAD_LINK(node, i);
+        while (!UNIQ_SKIPLIST_LINK_MARKED(succ)) {
+            USL_CAS_LINK(node, i, succ, USL_MARKED_LINK(succ));
+            succ = (UniqSkiplistNode *)USL_LOAD_LINK(node, i);
         }
     }
 
-    while (i >= 0) {
+    while (1) {
+        succ = (UniqSkiplistNode *)USL_LOAD_LINK(node, 0);
+        if (UNIQ_SKIPLIST_LINK_MARKED(succ)) {  //deleted by other thread
+            return ENOENT;
+        }
+        if (USL_CAS_LINK(node, 0, succ, USL_MARKED_LINK(succ))) {
+            break;
+        }
+    }
+    __sync_sub_and_fetch(&sl->element_count, 1);
+
+    state = __sync_fetch_and_or(&node->state, USL_NODE_STATE_DELETED |
+            (need_free ? USL_NODE_STATE_NEED_FREE : 0));
+    if (!(state & USL_NODE_STATE_INSERTING)) {
+        concurrent_retire(sl, node);
+    }
+    return 0;
+}
+
+/* link the node after the predecessors of all levels, the ranks are the
+ * positions of the predecessors (the top node is 0) for the span widths */
+static inline void uniq_skiplist_link_node(UniqSkiplist *sl,
+        UniqSkiplistNode *node, volatile UniqSkiplistNode **tmp_previous,
+        const int *ranks)
+{
+    int *widths;
+    int position;
+    int i;
+
+    //thread safe for one write with many read model
+    if (sl->factory->bidirection) {
+        LEVEL0_DOUBLE_CHAIN_PREV_LINK(node) = tmp_previous[0];
+        if (tmp_previous[0]->links[0] == sl->factory->tail) {
+            LEVEL0_DOUBLE_CHAIN_TAIL(sl) = node;
+        } else {
+            LEVEL0_DOUBLE_CHAIN_PREV_LINK(tmp_previous[0]->links[0]) = node;
+        }
+    }
+    position = ranks[0] + 1;
+    for (i=0; i<=node->level_index; i++) {
+        widths = UNIQ_SKIPLIST_WIDTHS(sl, tmp_previous[i]);
+        UNIQ_SKIPLIST_WIDTHS(sl, node)[i] = ranks[i] +
+            widths[i] + 1 - position;
+        widths[i] = position - ranks[i];
+
+        node->links[i] = tmp_previous[i]->links[i];
+        tmp_previous[i]->links[i] = node;
+    }
+    for (; i<=sl->top_level_index; i++) {
+        UNIQ_SKIPLIST_WIDTHS(sl, tmp_previous[i])[i]++;
+    }
+
+    sl->element_count++;
+}
+
+/* unlink the node from the predecessors of all levels */
+static inline void uniq_skiplist_unlink_node(UniqSkiplist *sl,
+        UniqSkiplistNode *deleted, volatile UniqSkiplistNode **update)
+{
+    int i;
+
+    for (i=deleted->level_index; i>=0; i--) {
+        UNIQ_SKIPLIST_WIDTHS(sl, update[i])[i] +=
+            UNIQ_SKIPLIST_WIDTHS(sl, deleted)[i] - 1;
+        update[i]->links[i] = deleted->links[i];
+    }
+    for (i=deleted->level_index+1; i<=sl->top_level_index; i++) {
+        UNIQ_SKIPLIST_WIDTHS(sl, update[i])[i]--;
+    }
+}
+
+/* the deleted node is unlinked from all levels */
+static inline void uniq_skiplist_free_unlinked(UniqSkiplist *sl,
+        UniqSkiplistNode *deleted, const bool need_free)
+{
+    if (sl->factory->bidirection) {
+        if (deleted->links[0] == sl->factory->tail) {
+            LEVEL0_DOUBLE_CHAIN_TAIL(sl) =
+                LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted);
+        } else {
+            LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted->links[0]) =
+                LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted);
+        }
+    }
+
+    if (need_free && sl->factory->free_func != NULL) {
+        sl->factory->free_func(sl, deleted->data,
+                sl->factory->delay_free_seconds);
+    }
+
+    UNIQ_SKIPLIST_FREE_MBLOCK_OBJECT(sl, deleted->level_index, deleted);
+    sl->element_count--;
+}
+
+#define CONCURRENT_CALL(sl, result, call) \
+    do { \
+        if ((result=fc_epoch_enter(sl->epoch)) == 0) { \
+            result = call; \
+            fc_epoch_exit(sl->epoch); \
+        } \
+    } while (0)
+
+int uniq_skiplist_insert(UniqSkiplist *sl, void *data)
+{
+    int i;
+    int level_index;
+    int cmp;
+    int rank;
+    UniqSkiplistNode *node;
+    volatile UniqSkiplistNode *previous;
+    volatile UniqSkiplistNode *tmp_previous[SKIPLIST_MAX_LEVEL_COUNT];
+    int ranks[SKIPLIST_MAX_LEVEL_COUNT];
+
+    if (sl->epoch != NULL) {
+        CONCURRENT_CALL(sl, cmp, concurrent_insert(sl, data));
+        return cmp;
+    }
+
+    level_index = uniq_skiplist_get_level_index(sl);
+    previous = sl->top;
+    rank = 0;
+    for (i=sl->top_level_index; i>=0; i--) {
         while (previous->links[i] != sl->factory->tail) {
             cmp = sl->factory->compare_func(data, previous->links[i]->data);
             if (cmp < 0) {
@@ -365,11 +806,12 @@ int uniq_skiplist_insert(UniqSkiplist *sl, void *data)
                 return EEXIST;
             }
 
+            rank += UNIQ_SKIPLIST_WIDTHS(sl, previous)[i];
             previous = previous->links[i];
         }
 
         tmp_previous[i] = previous;
-        i--;
+        ranks[i] = rank;
     }
 
     node = (UniqSkiplistNode *)fast_mblock_alloc_object(
@@ -381,22 +823,8 @@ int uniq_skiplist_insert(UniqSkiplist *sl, void *data)
     node->data = data;
 
     compile_barrier();
+    uniq_skiplist_link_node(sl, node, tmp_previous, ranks);
 
-    //thread safe for one write with many read model
-    if (sl->factory->bidirection) {
-        LEVEL0_DOUBLE_CHAIN_PREV_LINK(node) = tmp_previous[0];
-        if (tmp_previous[0]->links[0] == sl->factory->tail) {
-            LEVEL0_DOUBLE_CHAIN_TAIL(sl) = node;
-        } else {
-            LEVEL0_DOUBLE_CHAIN_PREV_LINK(tmp_previous[0]->links[0]) = node;
-        }
-    }
-    for (i=0; i<=level_index; i++) {
-        node->links[i] = tmp_previous[i]->links[i];
-        tmp_previous[i]->links[i] = node;
-    }
-
-    sl->element_count++;
     if (sl->element_count > best_element_counts[sl->top_level_index]) {
         uniq_skiplist_grow(sl);
     }
@@ -480,54 +908,78 @@ static UniqSkiplistNode *uniq_skiplist_get_first_larger(
     return (UniqSkiplistNode *)previous->links[0];
 }
 
-void uniq_skiplist_delete_node_ex(UniqSkiplist *sl,
-        UniqSkiplistNode *previous, UniqSkiplistNode *deleted,
-        const bool need_free)
+/* search the predecessors of all levels,
+ * return the node of the data, NULL for not exist */
+static UniqSkiplistNode *uniq_skiplist_get_update(UniqSkiplist *sl,
+        void *data, volatile UniqSkiplistNode **update)
 {
     int i;
-    for (i=deleted->level_index; i>=0; i--) {
+    volatile UniqSkiplistNode *previous;
+    volatile UniqSkiplistNode *next;
+
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
         while (previous->links[i] != sl->factory->tail &&
-                previous->links[i] != deleted)
+                sl->factory->compare_func(data,
+                    previous->links[i]->data) > 0)
         {
-            previous = (UniqSkiplistNode *)previous->links[i];
+            previous = previous->links[i];
         }
+        update[i] = previous;
+    }
 
-        previous->links[i] = previous->links[i]->links[i];
+    next = previous->links[0];
+    if (next != sl->factory->tail && sl->factory->compare_func(
+                data, next->data) == 0)
+    {
+        return (UniqSkiplistNode *)next;
     }
+    return NULL;
+}
 
-    if (sl->factory->bidirection) {
-        if (deleted->links[0] == sl->factory->tail) {
-            LEVEL0_DOUBLE_CHAIN_TAIL(sl) =
-                LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted);
-        } else {
-            LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted->links[0]) =
-                LEVEL0_DOUBLE_CHAIN_PREV_LINK(deleted);
-        }
+int uniq_skiplist_delete_node_ex(UniqSkiplist *sl,
+        UniqSkiplistNode *previous, UniqSkiplistNode *deleted,
+        const bool need_free)
+{
+    volatile UniqSkiplistNode *update[SKIPLIST_MAX_LEVEL_COUNT];
+    int result;
+
+    if (sl->epoch != NULL) {  //the previous node is useless
+        CONCURRENT_CALL(sl, result, concurrent_delete(sl,
+                    deleted->data, deleted, need_free));
+        return result;
     }
 
-    if (need_free && sl->factory->free_func != NULL) {
-        sl->factory->free_func(sl, deleted->data,
-                sl->factory->delay_free_seconds);
+    /* the span widths of the levels above the deleted node change too,
+     * so the predecessors of all levels are searched again */
+    if (uniq_skiplist_get_update(sl, deleted->data, update) != deleted) {
+        return ENOENT;
     }
 
-    UNIQ_SKIPLIST_FREE_MBLOCK_OBJECT(sl, deleted->level_index, deleted);
-    sl->element_count--;
+    uniq_skiplist_unlink_node(sl, deleted, update);
+    uniq_skiplist_free_unlinked(sl, deleted, need_free);
+    return 0;
 }
 
 int uniq_skiplist_delete_ex(UniqSkiplist *sl, void *data,
         const bool need_free)
 {
-    int level_index;
-    UniqSkiplistNode *previous;
+    volatile UniqSkiplistNode *update[SKIPLIST_MAX_LEVEL_COUNT];
     UniqSkiplistNode *deleted;
+    int result;
 
-    previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
-    if (previous == NULL) {
+    if (sl->epoch != NULL) {
+        CONCURRENT_CALL(sl, result, concurrent_delete(
+                    sl, data, NULL, need_free));
+        return result;
+    }
+
+    if ((deleted=uniq_skiplist_get_update(sl, data, update)) == NULL) {
         return ENOENT;
     }
 
-    deleted = (UniqSkiplistNode *)previous->links[level_index];
-    uniq_skiplist_delete_node_ex(sl, previous, deleted, need_free);
+    uniq_skiplist_unlink_node(sl, deleted, update);
+    uniq_skiplist_free_unlinked(sl, deleted, need_free);
     return 0;
 }
 
@@ -538,6 +990,10 @@ int uniq_skiplist_replace_ex(UniqSkiplist *sl, void *data,
     UniqSkiplistNode *previous;
     volatile UniqSkiplistNode *current;
 
+    if (sl->epoch != NULL) {
+        return EOPNOTSUPP;
+    }
+
     previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
     if (previous == NULL) {
         return ENOENT;
@@ -558,10 +1014,298 @@ int uniq_skiplist_replace_ex(UniqSkiplist *sl, void *data,
     return 0;
 }
 
+/* finger search: the update vector holds the predecessors of the previous
+ * data which is less than the current one, so the search climbs from
+ * level 0 until the next node is NOT less than the data, then goes down
+ * from there, the cost is O(log d) for the distance d */
+static int uniq_skiplist_finger_search(UniqSkiplist *sl, void *data,
+        volatile UniqSkiplistNode **update, int *ranks)
+{
+    volatile UniqSkiplistNode *previous;
+    volatile UniqSkiplistNode *next;
+    int cmp;
+    int rank;
+    int i;
+
+    for (i=0; i<sl->top_level_index; i++) {
+        next = update[i]->links[i];
+        if (next == sl->factory->tail || sl->factory->compare_func(
+                    data, next->data) <= 0)
+        {
+            break;
+        }
+    }
+
+    cmp = 1;
+    previous = update[i];
+    rank = ranks[i];
+    while (i >= 0) {
+        /* the predecessor of the upper level is also in this level,
+         * start from the greater one */
+        if (ranks[i] > rank) {
+            previous = update[i];
+            rank = ranks[i];
+        }
+
+        cmp = 1;
+        while (previous->links[i] != sl->factory->tail) {
+            cmp = sl->factory->compare_func(data, previous->links[i]->data);
+            if (cmp <= 0) {
+                break;
+            }
+            rank += UNIQ_SKIPLIST_WIDTHS(sl, previous)[i];
+            previous = previous->links[i];
+        }
+
+        update[i] = previous;
+        ranks[i] = rank;
+        i--;
+    }
+
+    return cmp;  //0 for the data exists
+}
+
+static inline void uniq_skiplist_init_update(UniqSkiplist *sl,
+        volatile UniqSkiplistNode **update, int *ranks)
+{
+    int i;
+    for (i=0; i<=sl->top_level_index; i++) {
+        update[i] = sl->top;
+        ranks[i] = 0;
+    }
+}
+
+int uniq_skiplist_batch_insert(UniqSkiplist *sl, void **data_array,
+        const int count, int *inserted_count)
+{
+    volatile UniqSkiplistNode *update[SKIPLIST_MAX_LEVEL_COUNT];
+    int ranks[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *node;
+    void **data;
+    void **end;
+    int level_index;
+    int position;
+    int result;
+    int i;
+
+    *inserted_count = 0;
+    if (sl->epoch != NULL) {
+        end = data_array + count;
+        for (data=data_array; data<end; data++) {
+            if ((result=uniq_skiplist_insert(sl, *data)) == 0) {
+                (*inserted_count)++;
+            } else if (result != EEXIST) {
+                return result;
+            }
+        }
+        return 0;
+    }
+
+    //grow before the insertion because the top node is in the update vector
+    while (sl->top_level_index < sl->factory->max_level_count - 1 &&
+            sl->element_count + count > best_element_counts[
+            sl->top_level_index])
+    {
+        if ((result=uniq_skiplist_grow(sl)) != 0) {
+            return result;
+        }
+    }
+
+    uniq_skiplist_init_update(sl, update, ranks);
+    end = data_array + count;
+    for (data=data_array; data<end; data++) {
+        if (data > data_array && sl->factory->compare_func(
+                    *data, *(data - 1)) <= 0)
+        {
+            //NOT in ascending order, restart from the top
+            uniq_skiplist_init_update(sl, update, ranks);
+        }
+
+        if (uniq_skiplist_finger_search(sl, *data, update, ranks) == 0) {
+            continue;  //already exists
+        }
+
+        level_index = uniq_skiplist_get_level_index(sl);
+        node = (UniqSkiplistNode *)fast_mblock_alloc_object(
+                sl->factory->node_allocators + level_index);
+        if (node == NULL) {
+            return ENOMEM;
+        }
+        node->level_index = level_index;
+        node->data = *data;
+
+        compile_barrier();
+        position = ranks[0] + 1;
+        uniq_skiplist_link_node(sl, node, update, ranks);
+        for (i=0; i<=level_index; i++) {
+            update[i] = node;
+            ranks[i] = position;
+        }
+        (*inserted_count)++;
+    }
+
+    return 0;
+}
+
+int uniq_skiplist_batch_delete_ex(UniqSkiplist *sl, void **data_array,
+        const int count, const bool need_free, int *deleted_count)
+{
+    volatile UniqSkiplistNode *update[SKIPLIST_MAX_LEVEL_COUNT];
+    int ranks[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *deleted;
+    void **data;
+    void **end;
+
+    *deleted_count = 0;
+    end = data_array + count;
+    if (sl->epoch != NULL) {
+        for (data=data_array; data<end; data++) {
+            if (uniq_skiplist_delete_ex(sl, *data, need_free) == 0) {
+                (*deleted_count)++;
+            }
+        }
+        return 0;
+    }
+
+    uniq_skiplist_init_update(sl, update, ranks);
+    for (data=data_array; data<end; data++) {
+        if (data > data_array && sl->factory->compare_func(
+                    *data, *(data - 1)) <= 0)
+        {
+            uniq_skiplist_init_update(sl, update, ranks);
+        }
+
+        if (uniq_skiplist_finger_search(sl, *data, update, ranks) != 0) {
+            continue;  //not exist
+        }
+
+        deleted = (UniqSkiplistNode *)update[0]->links[0];
+        uniq_skiplist_unlink_node(sl, deleted, update);
+        uniq_skiplist_free_unlinked(sl, deleted, need_free);
+        (*deleted_count)++;
+    }
+
+    return 0;
+}
+
+int uniq_skiplist_bulk_build(UniqSkiplist *sl, void **data_array,
+        const int count)
+{
+    UniqSkiplistNode *first[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *last[SKIPLIST_MAX_LEVEL_COUNT];
+    int first_positions[SKIPLIST_MAX_LEVEL_COUNT];
+    int last_positions[SKIPLIST_MAX_LEVEL_COUNT];
+    UniqSkiplistNode *node;
+    UniqSkiplistNode *previous;
+    int inserted_count;
+    int level_index;
+    int result;
+    int i;
+    int k;
+
+    if (!uniq_skiplist_empty(sl)) {
+        return EBUSY;
+    }
+    if (sl->epoch != NULL) {
+        return uniq_skiplist_batch_insert(sl, data_array,
+                count, &inserted_count);
+    }
+
+    for (i=1; i<count; i++) {
+        if (sl->factory->compare_func(data_array[i],
+                    data_array[i - 1]) <= 0)
+        {
+            logError("file: "__FILE__", line: %d, "
+                    "the data array is NOT in strictly ascending order, "
+                    "index: %d", __LINE__, i);
+            return EINVAL;
+        }
+    }
+
+    while (sl->top_level_index < sl->factory->max_level_count - 1 &&
+            count > best_element_counts[sl->top_level_index])
+    {
+        if ((result=uniq_skiplist_grow(sl)) != 0) {
+            return result;
+        }
+    }
+
+    for (k=0; k<=sl->top_level_index; k++) {
+        first[k] = last[k] = sl->factory->tail;
+    }
+
+    /* the perfect skiplist: the element of the position i (base 1)
+     * is in the levels of the trailing zeros of i */
+    previous = sl->top;
+    for (i=0; i<count; i++) {
+        level_index = FC_MIN(__builtin_ctz(i + 1), sl->top_level_index);
+        node = (UniqSkiplistNode *)fast_mblock_alloc_object(
+                sl->factory->node_allocators + level_index);
+        if (node == NULL) {
+            node = first[0];
+            while (node != sl->factory->tail) {
+                previous = (UniqSkiplistNode *)node->links[0];
+                fast_mblock_free_object(sl->factory->node_allocators +
+                        node->level_index, node);
+                node = previous;
+            }
+            return ENOMEM;
+        }
+
+        node->level_index = level_index;
+        node->data = data_array[i];
+        for (k=0; k<=level_index; k++) {
+            node->links[k] = sl->factory->tail;
+            if (last[k] == sl->factory->tail) {
+                first[k] = node;
+                first_positions[k] = i + 1;
+            } else {
+                last[k]->links[k] = node;
+                UNIQ_SKIPLIST_WIDTHS(sl, last[k])[k] =
+                    i + 1 - last_positions[k];
+            }
+            last[k] = node;
+            last_positions[k] = i + 1;
+        }
+
+        if (sl->factory->bidirection) {
+            LEVEL0_DOUBLE_CHAIN_PREV_LINK(node) = previous;
+        }
+        previous = node;
+    }
+
+    //publish from level 0 for the concurrent readers
+    if (sl->factory->bidirection && count > 0) {
+        LEVEL0_DOUBLE_CHAIN_TAIL(sl) = previous;
+    }
+    for (k=0; k<=sl->top_level_index; k++) {
+        if (last[k] == sl->factory->tail) {
+            UNIQ_SKIPLIST_WIDTHS(sl, sl->top)[k] = count + 1;
+        } else {
+            UNIQ_SKIPLIST_WIDTHS(sl, last[k])[k] =
+                count + 1 - last_positions[k];
+            UNIQ_SKIPLIST_WIDTHS(sl, sl->top)[k] = first_positions[k];
+        }
+    }
+    compile_barrier();
+    for (k=0; k<=sl->top_level_index; k++) {
+        sl->top->links[k] = first[k];
+    }
+    sl->element_count = count;
+    return 0;
+}
+
 UniqSkiplistNode *uniq_skiplist_find_node_ex(UniqSkiplist *sl, void *data,
         UniqSkiplistNode **previous)
 {
     int level_index;
+    UniqSkiplistNode *node;
+
+    if (sl->epoch != NULL) {
+        node = uniq_skiplist_find_node(sl, data);
+        *previous = (node != NULL ? sl->top : NULL);
+        return node;
+    }
 
     *previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
     return (*previous != NULL) ? (UniqSkiplistNode *)
@@ -573,6 +1317,15 @@ UniqSkiplistNode *uniq_skiplist_find_node(UniqSkiplist *sl, void *data)
     int level_index;
     UniqSkiplistNode *previous;
 
+    if (sl->epoch != NULL) {
+        if (fc_epoch_enter(sl->epoch) != 0) {
+            return NULL;
+        }
+        previous = concurrent_find(sl, data);
+        fc_epoch_exit(sl->epoch);
+        return previous;
+    }
+
     previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
     return (previous != NULL) ? (UniqSkiplistNode *)
         previous->links[level_index] : NULL;
@@ -583,6 +1336,16 @@ void *uniq_skiplist_find(UniqSkiplist *sl, void *data)
     int level_index;
     UniqSkiplistNode *previous;
 
+    if (sl->epoch != NULL) {
+        if (fc_epoch_enter(sl->epoch) != 0) {
+            return NULL;
+        }
+        previous = concurrent_find(sl, data);
+        data = (previous != NULL ? previous->data : NULL);
+        fc_epoch_exit(sl->epoch);
+        return data;
+    }
+
     previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
     return (previous != NULL) ? previous->links[level_index]->data : NULL;
 }
@@ -593,6 +1356,12 @@ int uniq_skiplist_find_all(UniqSkiplist *sl, void *data,
     int level_index;
     UniqSkiplistNode *previous;
 
+    if (sl->epoch != NULL) {
+        iterator->tail = sl->factory->tail;
+        iterator->current = sl->factory->tail;
+        return EOPNOTSUPP;
+    }
+
     previous = uniq_skiplist_get_equal_previous(sl, data, &level_index);
     if (previous == NULL) {
         iterator->tail = sl->factory->tail;
@@ -608,7 +1377,17 @@ int uniq_skiplist_find_all(UniqSkiplist *sl, void *data,
 UniqSkiplistNode *uniq_skiplist_find_ge_node(UniqSkiplist *sl, void *data)
 {
     UniqSkiplistNode *node;
-    node = uniq_skiplist_get_first_larger_or_equal(sl, data);
+    int cmp;
+
+    if (sl->epoch != NULL) {
+        if (fc_epoch_enter(sl->epoch) != 0) {
+            return NULL;
+        }
+        node = concurrent_find_ge(sl, data, &cmp);
+        fc_epoch_exit(sl->epoch);
+    } else {
+        node = uniq_skiplist_get_first_larger_or_equal(sl, data);
+    }
     if (node == sl->factory->tail) {
         return NULL;
     }
@@ -619,6 +1398,12 @@ UniqSkiplistNode *uniq_skiplist_find_ge_node(UniqSkiplist *sl, void *data)
 int uniq_skiplist_find_range(UniqSkiplist *sl, void *start_data,
         void *end_data, UniqSkiplistIterator *iterator)
 {
+    if (sl->epoch != NULL) {
+        iterator->current = sl->factory->tail;
+        iterator->tail = sl->factory->tail;
+        return EOPNOTSUPP;
+    }
+
     if (sl->factory->compare_func(start_data, end_data) > 0) {
         iterator->current = sl->factory->tail;
         iterator->tail = sl->factory->tail;
@@ -634,3 +1419,108 @@ int uniq_skiplist_find_range(UniqSkiplist *sl, void *start_data,
     iterator->tail = uniq_skiplist_get_first_larger(sl, end_data);
     return iterator->current != iterator->tail ? 0 : ENOENT;
 }
+
+int uniq_skiplist_rank(UniqSkiplist *sl, void *data, int *rank)
+{
+    int i;
+    int cmp;
+    volatile UniqSkiplistNode *previous;
+
+    *rank = -1;
+    if (sl->epoch != NULL) {
+        return EOPNOTSUPP;
+    }
+
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        while (previous->links[i] != sl->factory->tail) {
+            cmp = sl->factory->compare_func(data, previous->links[i]->data);
+            if (cmp < 0) {
+                break;
+            }
+            else if (cmp == 0) {
+                *rank += UNIQ_SKIPLIST_WIDTHS(sl, previous)[i];
+                return 0;
+            }
+
+            *rank += UNIQ_SKIPLIST_WIDTHS(sl, previous)[i];
+            previous = previous->links[i];
+        }
+    }
+
+    *rank = -1;
+    return ENOENT;
+}
+
+UniqSkiplistNode *uniq_skiplist_nth_node(UniqSkiplist *sl, const int index)
+{
+    int i;
+    int position;
+    int target;
+    int *widths;
+    volatile UniqSkiplistNode *previous;
+
+    if (sl->epoch != NULL || index < 0 || index >= sl->element_count) {
+        return NULL;
+    }
+
+    target = index + 1;
+    position = 0;
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        widths = UNIQ_SKIPLIST_WIDTHS(sl, previous);
+        while (position + widths[i] <= target) {
+            position += widths[i];
+            previous = previous->links[i];
+            if (position == target) {
+                return (UniqSkiplistNode *)previous;
+            }
+            widths = UNIQ_SKIPLIST_WIDTHS(sl, previous);
+        }
+    }
+
+    return NULL;
+}
+
+/* the count of the data less than (or equal to) the data */
+static int uniq_skiplist_count_less(UniqSkiplist *sl,
+        void *data, const bool or_equal)
+{
+    int i;
+    int cmp;
+    int count;
+    volatile UniqSkiplistNode *previous;
+
+    count = 0;
+    previous = sl->top;
+    for (i=sl->top_level_index; i>=0; i--) {
+        while (previous->links[i] != sl->factory->tail) {
+            cmp = sl->factory->compare_func(data, previous->links[i]->data);
+            if (cmp < 0 || (cmp == 0 && !or_equal)) {
+                break;
+            }
+
+            count += UNIQ_SKIPLIST_WIDTHS(sl, previous)[i];
+            previous = previous->links[i];
+        }
+    }
+
+    return count;
+}
+
+int uniq_skiplist_count_range(UniqSkiplist *sl, void *start_data,
+        void *end_data, int *count)
+{
+    *count = 0;
+    if (sl->epoch != NULL) {
+        return EOPNOTSUPP;
+    }
+
+    if (sl->factory->compare_func(start_data, end_data) > 0) {
+        return EINVAL;
+    }
+
+    *count = uniq_skiplist_count_less(sl, end_data, true) -
+        uniq_skiplist_count_less(sl, start_data, false);
+    return 0;
+}
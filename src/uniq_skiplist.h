@@ -24,15 +24,19 @@
 #include "common_define.h"
 #include "skiplist_common.h"
 #include "fast_mblock.h"
+#include "fc_epoch.h"
 
 struct uniq_skiplist;
 typedef void (*uniq_skiplist_free_func)(struct uniq_skiplist *skiplist,
         void *ptr, const int delay_seconds);
 
+/* the links are followed by the prev link (bidirection only) and the span
+ * widths: the width of the level i is the level 0 distance to links[i] */
 typedef struct uniq_skiplist_node
 {
     void *data;
     int level_index;
+    volatile int state;    //for the concurrent mode
     volatile struct uniq_skiplist_node *links[0];
 } UniqSkiplistNode;
 
@@ -53,8 +57,13 @@ typedef struct uniq_skiplist
 {
     UniqSkiplistFactory *factory;
     int top_level_index;
-    int element_count;
+    volatile int element_count;
     UniqSkiplistNode *top;  //the top node
+
+    /* for the concurrent mode, the removed nodes are freed by epoch */
+    FCEpochContext *epoch;
+    volatile uint64_t rand_seq;  //for the level of the new node, xorshift
+                                 //state or atomic sequence (concurrent)
 } UniqSkiplist;
 
 typedef struct uniq_skiplist_pair {
@@ -73,6 +82,14 @@ extern "C" {
 
 #define uniq_skiplist_count(sl) (sl)->element_count
 
+/* the lowest bit of the link is the deleted mark in the concurrent mode */
+#define UNIQ_SKIPLIST_LINK_MARKED(link)  ((uintptr_t)(link) & 1)
+#define UNIQ_SKIPLIST_LINK_NODE(link)    ((UniqSkiplistNode *) \
+        ((uintptr_t)(link) & ~(uintptr_t)1))
+
+#define UNIQ_SKIPLIST_WIDTHS(sl, node)  ((int *)((node)->links + \
+            (node)->level_index + ((sl)->factory->bidirection ? 2 : 1)))
+
 #define uniq_skiplist_init_ex(factory, max_level_count, compare_func, \
         free_func, alloc_skiplist_once, min_alloc_elements_once, \
         delay_free_seconds, arg) \
@@ -114,6 +131,42 @@ UniqSkiplist *uniq_skiplist_new(UniqSkiplistFactory *factory,
 
 void uniq_skiplist_free(UniqSkiplist *sl);
 
+/**
+ * enable the concurrent mode: insert and delete link and unlink the nodes
+ * by CAS (Fraser style lock-free skiplist), find, find_ge and iteration
+ * are lock-free. the removed nodes are freed by epoch based reclamation,
+ * the data is freed by free_func with delay_seconds 0 after reclamation.
+ * the skiplist grows to the max level count of the factory.
+ * NOTE: the factory MUST be inited with allocator_use_lock true and
+ *       bidirection false, the skiplist MUST be empty;
+ *       find_all, find_range and replace are NOT supported in this mode
+ * parameters:
+ *         sl: the skiplist
+ *         max_threads: the max reader and writer threads
+ * return 0 for success, != 0 for error
+*/
+int uniq_skiplist_set_concurrent(UniqSkiplist *sl, const int max_threads);
+
+/**
+ * enter the read side critical section for the concurrent mode, the data
+ * returned by the find functions and the iterator keep valid until
+ * uniq_skiplist_read_unlock
+ * parameters:
+ *         sl: the skiplist
+ * return 0 for success, != 0 for error
+*/
+static inline int uniq_skiplist_read_lock(UniqSkiplist *sl)
+{
+    return (sl->epoch != NULL ? fc_epoch_enter(sl->epoch) : 0);
+}
+
+static inline void uniq_skiplist_read_unlock(UniqSkiplist *sl)
+{
+    if (sl->epoch != NULL) {
+        fc_epoch_exit(sl->epoch);
+    }
+}
+
 static inline int uniq_skiplist_init_pair_ex(UniqSkiplistPair *pair,
         const int init_level_count, const int max_level_count,
         skiplist_compare_func compare_func, uniq_skiplist_free_func
@@ -173,15 +226,105 @@ int uniq_skiplist_find_range(UniqSkiplist *sl, void *start_data,
 
 UniqSkiplistNode *uniq_skiplist_find_node(UniqSkiplist *sl, void *data);
 
+/**
+ * insert the data array, the existing data are skipped. the search starts
+ * from the predecessors of the previous data (finger search), so the cost
+ * is amortized O(1) per data for the sequential data
+ * parameters:
+ *         sl: the skiplist
+ *         data_array: the data array, SHOULD be in ascending order,
+ *                     otherwise the search restarts from the top
+ *         count: the count of the data array
+ *         inserted_count: return the inserted count
+ * return 0 for success, != 0 for error
+*/
+int uniq_skiplist_batch_insert(UniqSkiplist *sl, void **data_array,
+        const int count, int *inserted_count);
+
+/**
+ * delete the data array by finger search, the non-existent data are skipped
+ * parameters:
+ *         sl: the skiplist
+ *         data_array: the data array, SHOULD be in ascending order
+ *         count: the count of the data array
+ *         need_free: if call the free_func of the factory
+ *         deleted_count: return the deleted count
+ * return 0 for success, != 0 for error
+*/
+int uniq_skiplist_batch_delete_ex(UniqSkiplist *sl, void **data_array,
+        const int count, const bool need_free, int *deleted_count);
+
+#define uniq_skiplist_batch_delete(sl, data_array, count, deleted_count) \
+    uniq_skiplist_batch_delete_ex(sl, data_array, count, true, deleted_count)
+
+/**
+ * build the balanced skiplist from the data array in O(n), the element of
+ * the position i (base 1) has the levels of the trailing zeros of i
+ * parameters:
+ *         sl: the skiplist, MUST be empty
+ *         data_array: the data array in strictly ascending order
+ *         count: the count of the data array
+ * return 0 for success, != 0 for error
+*/
+int uniq_skiplist_bulk_build(UniqSkiplist *sl, void **data_array,
+        const int count);
+
 UniqSkiplistNode *uniq_skiplist_find_node_ex(UniqSkiplist *sl, void *data,
         UniqSkiplistNode **previous);
 
-void uniq_skiplist_delete_node_ex(UniqSkiplist *sl,
+/**
+ * delete the node found by uniq_skiplist_find_node_ex, the predecessors
+ * are searched again for the span widths, the previous is ignored
+ * parameters:
+ *         sl: the skiplist
+ *         previous: the previous node, unused
+ *         deleted: the node to delete
+ *         need_free: if call the free function of the data
+ * return 0 for success, ENOENT for the node not in the skiplist
+*/
+int uniq_skiplist_delete_node_ex(UniqSkiplist *sl,
         UniqSkiplistNode *previous, UniqSkiplistNode *deleted,
         const bool need_free);
 
 UniqSkiplistNode *uniq_skiplist_find_ge_node(UniqSkiplist *sl, void *data);
 
+/**
+ * get the rank of the data in O(log n) by the span widths
+ * parameters:
+ *         sl: the skiplist
+ *         data: the data to find
+ *         rank: return the index (base 0) of the data in ascending order
+ * return 0 for success, ENOENT for not exist,
+ *        EOPNOTSUPP for the concurrent mode
+*/
+int uniq_skiplist_rank(UniqSkiplist *sl, void *data, int *rank);
+
+/**
+ * get the node of the index (base 0) in ascending order in O(log n)
+ * return the node, NULL for out of range or the concurrent mode
+*/
+UniqSkiplistNode *uniq_skiplist_nth_node(UniqSkiplist *sl, const int index);
+
+static inline void *uniq_skiplist_nth(UniqSkiplist *sl, const int index)
+{
+    UniqSkiplistNode *node;
+    node = uniq_skiplist_nth_node(sl, index);
+    return (node != NULL ? node->data : NULL);
+}
+
+/**
+ * count the data in [start_data, end_data] in O(log n)
+ * parameters:
+ *         sl: the skiplist
+ *         start_data: the start data
+ *         end_data: the end data
+ *         count: return the data count
+ * return 0 for success, EINVAL for invalid range,
+ *        EOPNOTSUPP for the concurrent mode
+*/
+int uniq_skiplist_count_range(UniqSkiplist *sl, void *start_data,
+        void *end_data, int *count);
+
 static inline void *uniq_skiplist_find_ge(UniqSkiplist *sl, void *data)
 {
     UniqSkiplistNode *node;
@@ -193,11 +336,29 @@ static inline void *uniq_skiplist_find_ge(UniqSkiplist *sl, void *data)
     return node->data;
 }
 
+/* skip the deleted nodes of the concurrent mode */
+static inline void uniq_skiplist_iterator_skip_deleted(
+        UniqSkiplistIterator *iterator)
+{
+    volatile UniqSkiplistNode *next;
+
+    while (iterator->current != iterator->tail) {
+        next = iterator->current->links[0];
+        if (!UNIQ_SKIPLIST_LINK_MARKED(next)) {
+            break;
+        }
+        iterator->current = UNIQ_SKIPLIST_LINK_NODE(next);
+    }
+}
+
+/* for the concurrent mode, the iteration MUST be between
+ * uniq_skiplist_read_lock and uniq_skiplist_read_unlock */
 static inline void uniq_skiplist_iterator(UniqSkiplist *sl,
         UniqSkiplistIterator *iterator)
 {
     iterator->current = sl->top->links[0];
     iterator->tail = sl->factory->tail;
+    uniq_skiplist_iterator_skip_deleted(iterator);
 }
 
 static inline void *uniq_skiplist_next(UniqSkiplistIterator *iterator)
@@ -209,21 +370,32 @@ static inline void *uniq_skiplist_next(UniqSkiplistIterator *iterator)
     }
 
     data = iterator->current->data;
-    iterator->current = iterator->current->links[0];
+    iterator->current = UNIQ_SKIPLIST_LINK_NODE(iterator->current->links[0]);
+    uniq_skiplist_iterator_skip_deleted(iterator);
     return data;
 }
 
 static inline void uniq_skiplist_iterator_at(UniqSkiplist *sl,
         const int offset, UniqSkiplistIterator *iterator)
 {
+    UniqSkiplistNode *node;
     int i;
 
-    iterator->current = sl->top->links[0];
     iterator->tail = sl->factory->tail;
+    if (sl->epoch == NULL) {  //seek by the span widths
+        node = uniq_skiplist_nth_node(sl, offset > 0 ? offset : 0);
+        iterator->current = (node != NULL ? node : sl->factory->tail);
+        return;
+    }
+
+    iterator->current = sl->top->links[0];
 
+    uniq_skiplist_iterator_skip_deleted(iterator);
     i = 0;
     while (i++ < offset && iterator->current != iterator->tail) {
-        iterator->current = iterator->current->links[0];
+        iterator->current = UNIQ_SKIPLIST_LINK_NODE(
+                iterator->current->links[0]);
+        uniq_skiplist_iterator_skip_deleted(iterator);
     }
 }
 
@@ -235,8 +407,10 @@ static inline int uniq_skiplist_iterator_count(UniqSkiplistIterator *iterator)
     count = 0;
     current = iterator->current;
     while (current != iterator->tail) {
-        ++count;
-        current = current->links[0];
+        if (!UNIQ_SKIPLIST_LINK_MARKED(current->links[0])) {
+            ++count;
+        }
+        current = UNIQ_SKIPLIST_LINK_NODE(current->links[0]);
     }
 
     return count;